@@ -0,0 +1,533 @@
+/**
+ *  \file bench_sofs13.c (implementation file)
+ *
+ *  \brief The SOFS13 internal operations benchmarking tool.
+ *
+ *  It times the file system internal operations on a freshly formatted storage device and reports, for each of them,
+ *  the number of operations, the throughput and the mean, the percentiles 50, 90 and 99 and the maximum of the
+ *  latency, in JSON, so that the results of successive runs may be compared.
+ *
+ *  The following operations are timed:
+ *     \li allocate and free inodes
+ *     \li allocate and free data clusters
+ *     \li write and read the data clusters of a file, in sequence
+ *     \li get entries by name in a large directory, in random order
+ *     \li get entries by path at the bottom of a deep hierarchy of directories.
+ *
+ *  SINOPSIS:
+ *  <P><PRE>                bench_sofs13 [OPTIONS] supp-file
+ *
+ *                OPTIONS:
+ *                 -n num   --- set number of operations of each benchmark (default: 2000)
+ *                 -e num   --- set number of entries of the large directory (default: 2000)
+ *                 -d num   --- set depth of the hierarchy of directories (default: 32)
+ *                 -c size  --- set buffercache size in MiB (default: 25 clusters)
+ *                 -o file  --- write the report into file (default: stdout)
+ *                 -m       --- map the storage device into memory (default: system calls)
+ *                 -u       --- use an unbuffered communication channel (default: buffered)
+ *                 -h       --- print this help.</PRE>
+ *
+ *  \remarks The storage device is changed: it should be formatted anew before each run (<em>make -C src bench</em>
+ *           does it). The number of operations is reduced, if there are not enough free inodes or data clusters.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <string.h>
+#include <errno.h>
+
+#include "sofs_stats.h"
+#include "sofs_const.h"
+#include "sofs_rawdisk.h"
+#include "sofs_buffercache.h"
+#include "sofs_superblock.h"
+#include "sofs_inode.h"
+#include "sofs_direntry.h"
+#include "sofs_datacluster.h"
+#include "sofs_basicoper.h"
+#include "sofs_basicconsist.h"
+#include "sofs_ifuncs_1.h"
+#include "sofs_ifuncs_2.h"
+#include "sofs_ifuncs_3.h"
+#include "sofs_ifuncs_4.h"
+#include "sofs_atime.h"
+
+/** \brief default number of operations of each benchmark */
+#define BENCH_OPS    2000
+/** \brief default number of entries of the large directory */
+#define BENCH_ENTS   2000
+/** \brief default depth of the hierarchy of directories */
+#define BENCH_DEPTH  32
+/** \brief seed of the sequence of random entries looked up */
+#define BENCH_SEED   13
+
+/*
+ *  Internal data structure
+ */
+
+/** \brief latencies of the operations of the benchmark being run, in nanoseconds */
+static uint64_t *lat = NULL;
+/** \brief report stream */
+static FILE *fo = NULL;
+/** \brief number of benchmarks reported so far */
+static uint32_t nReported = 0;
+
+/* Allusion to internal functions */
+
+static int benchInodes (SOSuperBlock *p_sb, uint32_t nOps);
+static int benchClusters (SOSuperBlock *p_sb, uint32_t nOps);
+static int benchFileClusters (SOSuperBlock *p_sb, uint32_t nOps);
+static int benchDirByName (SOSuperBlock *p_sb, uint32_t nOps, uint32_t nEnts);
+static int benchDirByPath (SOSuperBlock *p_sb, uint32_t nOps, uint32_t depth);
+static int makeEntry (uint32_t nInodeDir, const char *name, uint32_t type, uint32_t *p_nInode);
+static void report (const char *name, uint32_t nOps, uint64_t total);
+static int cmpLatency (const void *a, const void *b);
+static void printString (const char *str);
+static void printUsage (char *cmd_name);
+static void printError (int errcode, char *cmd_name);
+
+/* The main function */
+
+int main (int argc, char *argv[])
+{
+  uint32_t nOps = BENCH_OPS;                     /* number of operations of each benchmark */
+  uint32_t nEnts = BENCH_ENTS;                   /* number of entries of the large directory */
+  uint32_t depth = BENCH_DEPTH;                  /* depth of the hierarchy of directories */
+  uint32_t type = BUF;                           /* type of the communication channel */
+  int cache_size;                                /* buffercache size in MiB */
+  int val;                                       /* value of a numeric argument */
+
+  /* process command line options */
+
+  int opt;                                       /* selected option */
+
+  do
+  { switch ((opt = getopt (argc, argv, "n:e:d:c:o:muh")))
+    { case 'n': /* number of operations */
+                if ((sscanf (optarg, "%d", &val) != 1) || (val <= 0))
+                   { fprintf (stderr, "%s: Bad argument to n option.\n", basename (argv[0]));
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                nOps = (uint32_t) val;
+                break;
+      case 'e': /* number of entries of the large directory */
+                if ((sscanf (optarg, "%d", &val) != 1) || (val <= 0) || (val > 999999))
+                   { fprintf (stderr, "%s: Bad argument to e option.\n", basename (argv[0]));
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                nEnts = (uint32_t) val;
+                break;
+      case 'd': /* depth of the hierarchy of directories */
+                if ((sscanf (optarg, "%d", &val) != 1) || (val <= 0) || (4 * val + 5 > MAX_PATH))
+                   { fprintf (stderr, "%s: Bad argument to d option.\n", basename (argv[0]));
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                depth = (uint32_t) val;
+                break;
+      case 'c': /* buffercache size */
+                if ((sscanf (optarg, "%d", &cache_size) != 1) || (cache_size <= 0) ||
+                    (cache_size > (int) (UINT32_MAX / ((1024 * 1024) / BLOCK_SIZE))))
+                   { fprintf (stderr, "%s: Bad argument to c option.\n", basename (argv[0]));
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                soSetBufferCacheCapacity ((uint32_t) cache_size * ((1024 * 1024) / BLOCK_SIZE));
+                break;
+      case 'o': /* report file */
+                if ((fo = fopen (optarg, "w")) == NULL)
+                   { fprintf (stderr, "%s: Can't open report file \"%s\".\n", basename (argv[0]), optarg);
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                break;
+      case 'm': /* memory-mapped device */
+                soSetDeviceBackend (RAW_MMAP);   /* it falls back to system calls, if the mapping fails */
+                break;
+      case 'u': /* unbuffered communication channel */
+                type = UNBUF;
+                break;
+      case 'h': /* help mode */
+                printUsage (basename (argv[0]));
+                return EXIT_SUCCESS;
+      case -1:  break;
+      default:  fprintf (stderr, "%s: Wrong option.\n", basename (argv[0]));
+                printUsage (basename (argv[0]));
+                return EXIT_FAILURE;
+    }
+  } while (opt != -1);
+  if ((argc - optind) != 1)                      /* check existence of mandatory argument: storage device name */
+     { fprintf (stderr, "%s: Wrong number of mandatory arguments.\n", basename (argv[0]));
+       printUsage (basename (argv[0]));
+       return EXIT_FAILURE;
+     }
+  if (fo == NULL)
+     fo = stdout;                                /* if the switch -o was not used, set output to stdout */
+
+  /* check for storage device conformity */
+
+  char *devname;                                 /* path to the storage device in the Linux file system */
+  struct stat st;                                /* file attributes */
+
+  devname = argv[optind];
+  if (stat (devname, &st) == -1)                 /* get file attributes */
+     { printError (-errno, basename (argv[0]));
+       return EXIT_FAILURE;
+     }
+  if (st.st_size % BLOCK_SIZE != 0)              /* check file size: the storage device must have a size in bytes
+                                                    multiple of block size */
+     { fprintf (stderr, "%s: Bad size of support file.\n", basename (argv[0]));
+       return EXIT_FAILURE;
+     }
+
+  /* open a communication channel with the storage device and load the superblock */
+
+  SOSuperBlock *p_sb;                            /* pointer to the superblock */
+  int status;                                    /* status of operation */
+
+  if ((lat = malloc ((size_t) ((nOps > nEnts) ? nOps : nEnts) * sizeof (uint64_t))) == NULL)
+     { printError (-ENOMEM, basename (argv[0]));
+       return EXIT_FAILURE;
+     }
+  if ((status = soOpenBufferCache (devname, type)) != 0)
+     { printError (status, basename (argv[0]));
+       return EXIT_FAILURE;
+     }
+  if (((status = soLoadSuperBlock ()) != 0) || ((p_sb = soGetSuperBlock ()) == NULL) ||
+      ((status = soQCheckSuperBlock (p_sb)) != 0))
+     { printError ((status != 0) ? status : -ELIBBAD, basename (argv[0]));
+       soCloseBufferCache ();
+       return EXIT_FAILURE;
+     }
+
+  /* run the benchmarks */
+
+  fprintf (fo, "{\n  \"device\": ");
+  printString (devname);
+  fprintf (fo, ",\n  \"blocks\": %"PRIu32",\n  \"buffered\": %s,\n  \"benchmarks\": [\n", p_sb->ntotal,
+           (type == BUF) ? "true" : "false");
+  if (((status = benchInodes (p_sb, nOps)) != 0) || ((status = benchClusters (p_sb, nOps)) != 0) ||
+      ((status = benchFileClusters (p_sb, nOps)) != 0) || ((status = benchDirByName (p_sb, nOps, nEnts)) != 0) ||
+      ((status = benchDirByPath (p_sb, nOps, depth)) != 0))
+     { printError (status, basename (argv[0]));
+       soCloseBufferCache ();
+       return EXIT_FAILURE;
+     }
+  fprintf (fo, "\n  ]\n}\n");
+
+  /* write the times of last access still kept in internal storage and close the communication channel with the
+     storage device */
+
+  soAtimeSyncAll ();
+  if ((status = soCloseBufferCache ()) != 0)
+     { printError (status, basename (argv[0]));
+       return EXIT_FAILURE;
+     }
+  if (fo != stdout) fclose (fo);
+  free (lat);
+
+  /* that's all */
+
+  return EXIT_SUCCESS;
+
+} /* end of main */
+
+/*
+ *  Internal functions
+ */
+
+/*
+ *  Time the allocation of inodes and then the freeing of the same inodes.
+ */
+
+static int benchInodes (SOSuperBlock *p_sb, uint32_t nOps)
+{
+  uint32_t *nInode;                              /* numbers of the allocated inodes */
+  uint64_t t0, total;                            /* start time of the operation and total time */
+  uint32_t i;                                    /* counting variable */
+  int stat;                                      /* status of operation */
+
+  if (nOps > p_sb->ifree) nOps = p_sb->ifree;
+  if ((nInode = malloc ((size_t) nOps * sizeof (uint32_t) + 1)) == NULL) return -ENOMEM;
+
+  for (i = 0, total = 0; i < nOps; i++)
+  { t0 = soStatClock ();
+    stat = soAllocInode (INODE_FILE, &nInode[i]);
+    total += (lat[i] = soStatClock () - t0);
+    if (stat != 0)
+       { free (nInode);
+         return stat;
+       }
+  }
+  report ("soAllocInode", nOps, total);
+
+  for (i = 0, total = 0; i < nOps; i++)
+  { t0 = soStatClock ();
+    stat = soFreeInode (nInode[i]);
+    total += (lat[i] = soStatClock () - t0);
+    if (stat != 0)
+       { free (nInode);
+         return stat;
+       }
+  }
+  report ("soFreeInode", nOps, total);
+  free (nInode);
+
+  return 0;
+}
+
+/*
+ *  Time the allocation of data clusters and then the freeing of the same data clusters.
+ */
+
+static int benchClusters (SOSuperBlock *p_sb, uint32_t nOps)
+{
+  uint32_t *nClust;                              /* logical numbers of the allocated data clusters */
+  uint64_t t0, total;                            /* start time of the operation and total time */
+  uint32_t i;                                    /* counting variable */
+  int stat;                                      /* status of operation */
+
+  if (nOps > p_sb->dzone_free) nOps = p_sb->dzone_free;
+  if ((nClust = malloc ((size_t) nOps * sizeof (uint32_t) + 1)) == NULL) return -ENOMEM;
+
+  for (i = 0, total = 0; i < nOps; i++)
+  { t0 = soStatClock ();
+    stat = soAllocDataCluster (&nClust[i]);
+    total += (lat[i] = soStatClock () - t0);
+    if (stat != 0)
+       { free (nClust);
+         return stat;
+       }
+  }
+  report ("soAllocDataCluster", nOps, total);
+
+  for (i = 0, total = 0; i < nOps; i++)
+  { t0 = soStatClock ();
+    stat = soFreeDataCluster (nClust[i]);
+    total += (lat[i] = soStatClock () - t0);
+    if (stat != 0)
+       { free (nClust);
+         return stat;
+       }
+  }
+  report ("soFreeDataCluster", nOps, total);
+  free (nClust);
+
+  return 0;
+}
+
+/*
+ *  Time the writing of the data clusters of a new file, in sequence, and then the reading of the same data clusters.
+ *  The file is deleted afterwards.
+ */
+
+static int benchFileClusters (SOSuperBlock *p_sb, uint32_t nOps)
+{
+  SODataClust clust;                             /* contents of a data cluster */
+  uint64_t t0, total;                            /* start time of the operation and total time */
+  uint32_t nInode;                               /* number of the inode of the file */
+  uint32_t i;                                    /* counting variable */
+  int stat;                                      /* status of operation */
+
+  /* some of the free data clusters are taken by the clusters of references */
+
+  if (nOps > p_sb->dzone_free - p_sb->dzone_free / RPC - 2) nOps = p_sb->dzone_free - p_sb->dzone_free / RPC - 2;
+  if (nOps > MAX_FILE_CLUSTERS) nOps = MAX_FILE_CLUSTERS;
+  if ((stat = soAllocInode (INODE_FILE, &nInode)) != 0) return stat;
+
+  for (i = 0, total = 0; i < nOps; i++)
+  { memset (&clust, (int) (i & 0xff), sizeof (clust));
+    t0 = soStatClock ();
+    stat = soWriteFileCluster (nInode, i, &clust);
+    total += (lat[i] = soStatClock () - t0);
+    if (stat != 0) return stat;
+  }
+  report ("soWriteFileCluster", nOps, total);
+
+  for (i = 0, total = 0; i < nOps; i++)
+  { t0 = soStatClock ();
+    stat = soReadFileCluster (nInode, i, &clust);
+    total += (lat[i] = soStatClock () - t0);
+    if (stat != 0) return stat;
+  }
+  report ("soReadFileCluster", nOps, total);
+
+  if ((stat = soHandleFileClusters (nInode, 0, FREE_CLEAN)) != 0) return stat;
+
+  return soFreeInode (nInode);
+}
+
+/*
+ *  Time the look up of the entries of a large directory by name, in random order.
+ */
+
+static int benchDirByName (SOSuperBlock *p_sb, uint32_t nOps, uint32_t nEnts)
+{
+  char name[MAX_NAME+1];                         /* name of an entry */
+  uint64_t t0, total;                            /* start time of the operation and total time */
+  uint32_t nInodeDir, nInodeEnt, idx;            /* numbers of the inodes of the directory and of an entry, and index *
+                                                    of the entry */
+  unsigned int seed;                             /* state of the generator of random entries */
+  uint32_t i;                                    /* counting variable */
+  int stat;                                      /* status of operation */
+
+  if (p_sb->ifree < 2) return -ENOSPC;
+  if (nEnts > p_sb->ifree - 1) nEnts = p_sb->ifree - 1;
+  if ((stat = makeEntry (0, "large", INODE_DIR, &nInodeDir)) != 0) return stat;
+  for (i = 0; i < nEnts; i++)
+  { sprintf (name, "f%06"PRIu32, i);
+    if ((stat = makeEntry (nInodeDir, name, INODE_FILE, &nInodeEnt)) != 0) return stat;
+  }
+
+  seed = BENCH_SEED;
+  for (i = 0, total = 0; i < nOps; i++)
+  { sprintf (name, "f%06"PRIu32, (uint32_t) rand_r (&seed) % nEnts);
+    t0 = soStatClock ();
+    stat = soGetDirEntryByName (nInodeDir, name, &nInodeEnt, &idx);
+    total += (lat[i] = soStatClock () - t0);
+    if (stat != 0) return stat;
+  }
+  report ("soGetDirEntryByName", nOps, total);
+
+  return 0;
+}
+
+/*
+ *  Time the look up by path of an entry at the bottom of a deep hierarchy of directories.
+ */
+
+static int benchDirByPath (SOSuperBlock *p_sb, uint32_t nOps, uint32_t depth)
+{
+  char path[MAX_PATH+1];                         /* path of the entry */
+  char name[MAX_NAME+1];                         /* name of a component */
+  uint64_t t0, total;                            /* start time of the operation and total time */
+  uint32_t nInodeDir, nInodeEnt;                 /* numbers of the inodes of a directory and of an entry */
+  uint32_t i;                                    /* counting variable */
+  int stat;                                      /* status of operation */
+
+  if (p_sb->ifree < depth + 1) return -ENOSPC;
+  path[0] = '\0';
+  for (i = 0, nInodeDir = 0; i < depth; i++)
+  { sprintf (name, "d%02"PRIu32, i % 100);
+    if ((stat = makeEntry (nInodeDir, name, INODE_DIR, &nInodeDir)) != 0) return stat;
+    strcat (path, "/");
+    strcat (path, name);
+  }
+  if ((stat = makeEntry (nInodeDir, "leaf", INODE_FILE, &nInodeEnt)) != 0) return stat;
+  strcat (path, "/leaf");
+
+  for (i = 0, total = 0; i < nOps; i++)
+  { t0 = soStatClock ();
+    stat = soGetDirEntryByPath (path, &nInodeDir, &nInodeEnt);
+    total += (lat[i] = soStatClock () - t0);
+    if (stat != 0) return stat;
+  }
+  report ("soGetDirEntryByPath", nOps, total);
+
+  return 0;
+}
+
+/*
+ *  Create a file or a directory, with all the permissions of its owner, and add it to a directory.
+ */
+
+static int makeEntry (uint32_t nInodeDir, const char *name, uint32_t type, uint32_t *p_nInode)
+{
+  SOInode inode;                                 /* inode of the entry */
+  int stat;                                      /* status of operation */
+
+  if ((stat = soAllocInode (type, p_nInode)) != 0) return stat;
+  if ((stat = soReadInode (&inode, *p_nInode, IUIN)) != 0) return stat;
+  inode.mode |= INODE_RD_USR | INODE_WR_USR | INODE_EX_USR;
+  if ((stat = soWriteInode (&inode, *p_nInode, IUIN)) != 0) return stat;
+
+  return soAddAttDirEntry (nInodeDir, name, *p_nInode, ADD);
+}
+
+/*
+ *  Report a benchmark: the latencies of its operations are sorted to find the percentiles (nearest rank).
+ */
+
+static void report (const char *name, uint32_t nOps, uint64_t total)
+{
+  static const uint32_t pct[3] = { 50, 90, 99 }; /* percentiles */
+  uint32_t k;                                    /* counting variable */
+
+  if (nReported++ != 0) fprintf (fo, ",\n");
+  fprintf (fo, "    {\"name\": \"%s\", \"ops\": %"PRIu32, name, nOps);
+  if (nOps == 0)
+     { fprintf (fo, "}");
+       return;
+     }
+  qsort (lat, nOps, sizeof (uint64_t), cmpLatency);
+  fprintf (fo, ", \"ops_per_s\": %.1f, \"mean_us\": %.3f", (total != 0) ? 1e9 * (double) nOps / (double) total : 0.0,
+           (double) total / (1000.0 * (double) nOps));
+  for (k = 0; k < 3; k++)
+    fprintf (fo, ", \"p%"PRIu32"_us\": %.3f", pct[k],
+             (double) lat[((uint64_t) nOps * pct[k] + 99) / 100 - 1] / 1000.0);
+  fprintf (fo, ", \"max_us\": %.3f}", (double) lat[nOps-1] / 1000.0);
+  fflush (fo);
+}
+
+/*
+ *  Order of two latencies.
+ */
+
+static int cmpLatency (const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+  return (x > y) - (x < y);
+}
+
+/*
+ *  Print a string as a JSON string.
+ */
+
+static void printString (const char *str)
+{
+  fputc ('"', fo);
+  for (; *str != '\0'; str++)
+    if ((*str == '"') || (*str == '\\'))
+       fprintf (fo, "\\%c", *str);
+       else if ((unsigned char) *str < 0x20)
+               fprintf (fo, "\\u%04x", (unsigned int) (unsigned char) *str);
+               else fputc (*str, fo);
+  fputc ('"', fo);
+}
+
+/*
+ * print help message
+ */
+
+static void printUsage (char *cmd_name)
+{
+  printf ("Sinopsis: %s [OPTIONS] supp-file\n"
+          "  OPTIONS:\n"
+          "  -n num   --- set number of operations of each benchmark (default: 2000)\n"
+          "  -e num   --- set number of entries of the large directory (default: 2000)\n"
+          "  -d num   --- set depth of the hierarchy of directories (default: 32)\n"
+          "  -c size  --- set buffercache size in MiB (default: 25 clusters)\n"
+          "  -o file  --- write the report into file (default: stdout)\n"
+          "  -m       --- map the storage device into memory (default: system calls)\n"
+          "  -u       --- use an unbuffered communication channel (default: buffered)\n"
+          "  -h       --- print this help\n", cmd_name);
+}
+
+/*
+ * print error message
+ */
+
+static void printError (int errcode, char *cmd_name)
+{
+  fprintf(stderr, "%s: error #%d - %s\n", cmd_name, -errcode,
+          soGetErrorMessage (-errcode));
+}
@@ -0,0 +1,32 @@
+/**
+ *  \file bench_sofs13.h (interface file)
+ *
+ *  \brief The SOFS13 internal operations benchmarking tool.
+ *
+ *  It times the file system internal operations on a freshly formatted storage device and reports, for each of them,
+ *  the number of operations, the throughput and the mean, the percentiles 50, 90 and 99 and the maximum of the
+ *  latency, in JSON, so that the results of successive runs may be compared.
+ *
+ *  The following operations are timed:
+ *     \li allocate and free inodes
+ *     \li allocate and free data clusters
+ *     \li write and read the data clusters of a file, in sequence
+ *     \li get entries by name in a large directory, in random order
+ *     \li get entries by path at the bottom of a deep hierarchy of directories.
+ *
+ *  SINOPSIS:
+ *  <P><PRE>                bench_sofs13 [OPTIONS] supp-file
+ *
+ *                OPTIONS:
+ *                 -n num   --- set number of operations of each benchmark (default: 2000)
+ *                 -e num   --- set number of entries of the large directory (default: 2000)
+ *                 -d num   --- set depth of the hierarchy of directories (default: 32)
+ *                 -c size  --- set buffercache size in MiB (default: 25 clusters)
+ *                 -o file  --- write the report into file (default: stdout)
+ *                 -m       --- map the storage device into memory (default: system calls)
+ *                 -u       --- use an unbuffered communication channel (default: buffered)
+ *                 -h       --- print this help.</PRE>
+ *
+ *  \remarks The storage device is changed: it should be formatted anew before each run (<em>make -C src bench</em>
+ *           does it). The number of operations is reduced, if there are not enough free inodes or data clusters.
+ */
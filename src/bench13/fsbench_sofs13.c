@@ -0,0 +1,853 @@
+/**
+ *  \file fsbench_sofs13.c (implementation file)
+ *
+ *  \brief The SOFS13 mounted file system benchmarking tool.
+ *
+ *  It runs a fixed set of workloads through the system calls on a directory of a mounted file system, each one with
+ *  every number of threads asked for, and reports, for each run, the number of operations, the throughput and the
+ *  mean, the percentiles 50, 90 and 99 and the maximum of the latency, in JSON, so that the results of successive runs
+ *  may be compared.
+ *
+ *  The following workloads are run (each thread works on files and directories of its own, but for the large
+ *  directory and the deep hierarchy, which are shared):
+ *     \li write and read a file in sequence, with requests of 4 KiB, 64 KiB and 1 MiB
+ *     \li write and read blocks of 4 KiB of a file at random offsets
+ *     \li create, get the attributes of and delete empty files
+ *     \li list a large directory
+ *     \li get the attributes of a file at the bottom of a deep hierarchy of directories.
+ *
+ *  The threads of a run set up what they need, start their operations together and time each one of them; the
+ *  throughput is got from the time between the start of the first operation and the end of the last one of any thread.
+ *
+ *  SINOPSIS:
+ *  <P><PRE>                fsbench_sofs13 [OPTIONS] directory
+ *
+ *                OPTIONS:
+ *                 -t list  --- set numbers of threads, separated by commas (default: 1,2,4)
+ *                 -n num   --- set number of operations of each thread in the random I/O, small files and deep
+ *                              hierarchy workloads (default: 1000)
+ *                 -f size  --- set size of the file of each thread in the sequential I/O workloads in MiB (default: 4)
+ *                 -e num   --- set number of entries of the large directory (default: 2000)
+ *                 -l num   --- set number of listings of the large directory by each thread (default: 20)
+ *                 -d num   --- set depth of the hierarchy of directories (default: 32)
+ *                 -o file  --- write the report into file (default: stdout)
+ *                 -h       --- print this help.</PRE>
+ *
+ *  \remarks The directory is supposed to be empty and it is left empty. When it lies in a SOFS13 file system mounted
+ *           by \e mount_sofs13, the latencies measured include those of FUSE and of the kernel; the contents of the
+ *           files read back may be served by the page cache of the kernel, which is only asked to drop them.
+ *           <em>make -C src fsbench</em> formats a fresh image, mounts it and runs the tool on it.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "sofs_direntry.h"
+
+/** \brief default numbers of threads */
+#define FSB_THREADS      "1,2,4"
+/** \brief maximum number of threads of a run */
+#define FSB_MAX_THREADS  64
+/** \brief maximum number of numbers of threads */
+#define FSB_MAX_RUNS     16
+/** \brief default number of operations of each thread */
+#define FSB_OPS          1000
+/** \brief default size of the file of each thread in the sequential I/O workloads (MiB) */
+#define FSB_FILE_SIZE    4
+/** \brief default number of entries of the large directory */
+#define FSB_ENTS         2000
+/** \brief default number of listings of the large directory by each thread */
+#define FSB_LISTS        20
+/** \brief default depth of the hierarchy of directories */
+#define FSB_DEPTH        32
+/** \brief size of the requests of the random I/O workloads */
+#define FSB_RAND_SIZE    4096
+/** \brief seed of the sequences of random offsets (the index of the thread is added) */
+#define FSB_SEED         13
+
+/*
+ *  Internal data structure
+ */
+
+/** \brief state of a thread of a run */
+typedef struct soBenchThread
+{
+  /** \brief index of the thread */
+  uint32_t id;
+  /** \brief size of the requests, in the I/O workloads */
+  uint32_t req;
+  /** \brief number of operations */
+  uint32_t nOps;
+  /** \brief latencies of the operations, in nanoseconds */
+  uint64_t *lat;
+  /** \brief time of the start of the first operation, in nanoseconds */
+  uint64_t tStart;
+  /** \brief time of the end of the last operation, in nanoseconds */
+  uint64_t tEnd;
+  /** \brief number of bytes transferred */
+  uint64_t bytes;
+  /** \brief file descriptor of the file of the thread (-1, if none is open) */
+  int fd;
+  /** \brief buffer of the requests, in the I/O workloads */
+  char *buf;
+  /** \brief path of the file, or of the directory, of the thread */
+  char path[PATH_MAX / 2];
+  /** \brief state of the generator of random offsets */
+  unsigned int seed;
+  /** \brief workload */
+  const struct soWorkload *w;
+  /** \brief status of operation */
+  int stat;
+} SOBenchThread;
+
+/** \brief workload: the set up and the tearing down of a thread, which may be NULL, are not timed */
+typedef struct soWorkload
+{
+  /** \brief name of the workload */
+  const char *name;
+  /** \brief signals if it transfers data */
+  bool io;
+  /** \brief set up of a thread */
+  int (*setup) (SOBenchThread *p);
+  /** \brief operation i of a thread */
+  int (*op) (SOBenchThread *p, uint32_t i);
+  /** \brief tearing down of a thread */
+  int (*teardown) (SOBenchThread *p);
+} SOWorkload;
+
+/** \brief directory where the workloads are run */
+static const char *root = NULL;
+/** \brief size of the file of each thread in the sequential I/O workloads, in bytes */
+static uint64_t fileSize = (uint64_t) FSB_FILE_SIZE * 1024 * 1024;
+/** \brief number of entries of the large directory */
+static uint32_t nEnts = FSB_ENTS;
+/** \brief path of the file at the bottom of the deep hierarchy of directories */
+static char deepPath[PATH_MAX];
+/** \brief start line of the threads of a run */
+static pthread_barrier_t startLine;
+/** \brief report stream */
+static FILE *fo = NULL;
+/** \brief number of runs reported so far */
+static uint32_t nReported = 0;
+
+/* Allusion to internal functions */
+
+static int openSeqWrite (SOBenchThread *p);
+static int openRead (SOBenchThread *p);
+static int openRandWrite (SOBenchThread *p);
+static int seqWrite (SOBenchThread *p, uint32_t i);
+static int seqRead (SOBenchThread *p, uint32_t i);
+static int randWrite (SOBenchThread *p, uint32_t i);
+static int randRead (SOBenchThread *p, uint32_t i);
+static int syncClose (SOBenchThread *p);
+static int closeFile (SOBenchThread *p);
+static int makeOwnDir (SOBenchThread *p);
+static int createFile (SOBenchThread *p, uint32_t i);
+static int statFile (SOBenchThread *p, uint32_t i);
+static int unlinkFile (SOBenchThread *p, uint32_t i);
+static int removeOwnDir (SOBenchThread *p);
+static int listDir (SOBenchThread *p, uint32_t i);
+static int lookupDeep (SOBenchThread *p, uint32_t i);
+static int run (const SOWorkload *w, uint32_t nThreads, uint32_t req, uint32_t nOps);
+static void *worker (void *arg);
+static int makeTrees (uint32_t depth);
+static int removeTrees (uint32_t depth);
+static void report (const char *name, uint32_t nThreads, uint32_t req, uint64_t *lat, uint32_t nOps, uint64_t wall,
+                    uint64_t total, uint64_t bytes);
+static uint64_t now (void);
+static int cmpLatency (const void *a, const void *b);
+static void printString (const char *str);
+static void printUsage (char *cmd_name);
+static void printError (int errcode, char *cmd_name);
+
+/** \brief workloads */
+static const SOWorkload wSeqWrite = { "seq_write", true, openSeqWrite, seqWrite, syncClose };
+static const SOWorkload wSeqRead = { "seq_read", true, openRead, seqRead, closeFile };
+static const SOWorkload wRandWrite = { "rand_write", true, openRandWrite, randWrite, syncClose };
+static const SOWorkload wRandRead = { "rand_read", true, openRead, randRead, closeFile };
+static const SOWorkload wCreate = { "create", false, makeOwnDir, createFile, NULL };
+static const SOWorkload wStat = { "stat", false, NULL, statFile, NULL };
+static const SOWorkload wUnlink = { "unlink", false, NULL, unlinkFile, removeOwnDir };
+static const SOWorkload wList = { "list_large_dir", false, NULL, listDir, NULL };
+static const SOWorkload wLookup = { "lookup_deep_path", false, NULL, lookupDeep, NULL };
+
+/** \brief sizes of the requests of the sequential I/O workloads */
+static const uint32_t seqSize[3] = { 4096, 65536, 1048576 };
+
+/* The main function */
+
+int main (int argc, char *argv[])
+{
+  uint32_t threads[FSB_MAX_RUNS];                /* numbers of threads */
+  uint32_t nRuns = 0;                            /* number of numbers of threads */
+  uint32_t nOps = FSB_OPS;                       /* number of operations of each thread */
+  uint32_t nLists = FSB_LISTS;                   /* number of listings of the large directory by each thread */
+  uint32_t depth = FSB_DEPTH;                    /* depth of the hierarchy of directories */
+  char list[256];                                /* numbers of threads, as given */
+  char *tok;                                     /* a number of threads */
+  int val;                                       /* value of a numeric argument */
+
+  strcpy (list, FSB_THREADS);
+
+  /* process command line options */
+
+  int opt;                                       /* selected option */
+
+  do
+  { switch ((opt = getopt (argc, argv, "t:n:f:e:l:d:o:h")))
+    { case 't': /* numbers of threads */
+                if (strlen (optarg) >= sizeof (list))
+                   { fprintf (stderr, "%s: Bad argument to t option.\n", basename (argv[0]));
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                strcpy (list, optarg);
+                break;
+      case 'n': /* number of operations */
+                if ((sscanf (optarg, "%d", &val) != 1) || (val <= 0))
+                   { fprintf (stderr, "%s: Bad argument to n option.\n", basename (argv[0]));
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                nOps = (uint32_t) val;
+                break;
+      case 'f': /* size of the file of each thread */
+                if ((sscanf (optarg, "%d", &val) != 1) || (val <= 0) || (val > 4096))
+                   { fprintf (stderr, "%s: Bad argument to f option.\n", basename (argv[0]));
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                fileSize = (uint64_t) val * 1024 * 1024;
+                break;
+      case 'e': /* number of entries of the large directory */
+                if ((sscanf (optarg, "%d", &val) != 1) || (val <= 0) || (val > 999999))
+                   { fprintf (stderr, "%s: Bad argument to e option.\n", basename (argv[0]));
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                nEnts = (uint32_t) val;
+                break;
+      case 'l': /* number of listings of the large directory */
+                if ((sscanf (optarg, "%d", &val) != 1) || (val <= 0))
+                   { fprintf (stderr, "%s: Bad argument to l option.\n", basename (argv[0]));
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                nLists = (uint32_t) val;
+                break;
+      case 'd': /* depth of the hierarchy of directories */
+                if ((sscanf (optarg, "%d", &val) != 1) || (val <= 0) || (4 * val + 5 > MAX_PATH))
+                   { fprintf (stderr, "%s: Bad argument to d option.\n", basename (argv[0]));
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                depth = (uint32_t) val;
+                break;
+      case 'o': /* report file */
+                if ((fo = fopen (optarg, "w")) == NULL)
+                   { fprintf (stderr, "%s: Can't open report file \"%s\".\n", basename (argv[0]), optarg);
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                break;
+      case 'h': /* help mode */
+                printUsage (basename (argv[0]));
+                return EXIT_SUCCESS;
+      case -1:  break;
+      default:  fprintf (stderr, "%s: Wrong option.\n", basename (argv[0]));
+                printUsage (basename (argv[0]));
+                return EXIT_FAILURE;
+    }
+  } while (opt != -1);
+  if ((argc - optind) != 1)                      /* check existence of mandatory argument: directory */
+     { fprintf (stderr, "%s: Wrong number of mandatory arguments.\n", basename (argv[0]));
+       printUsage (basename (argv[0]));
+       return EXIT_FAILURE;
+     }
+  for (tok = strtok (list, ","); tok != NULL; tok = strtok (NULL, ","))
+  { if ((nRuns == FSB_MAX_RUNS) || (sscanf (tok, "%d", &val) != 1) || (val <= 0) || (val > FSB_MAX_THREADS))
+       { fprintf (stderr, "%s: Bad argument to t option.\n", basename (argv[0]));
+         printUsage (basename (argv[0]));
+         return EXIT_FAILURE;
+       }
+    threads[nRuns++] = (uint32_t) val;
+  }
+  if (nRuns == 0)
+     { fprintf (stderr, "%s: Bad argument to t option.\n", basename (argv[0]));
+       printUsage (basename (argv[0]));
+       return EXIT_FAILURE;
+     }
+  if (fo == NULL)
+     fo = stdout;                                /* if the switch -o was not used, set output to stdout */
+
+  /* check the directory */
+
+  struct stat st;                                /* file attributes */
+
+  root = argv[optind];
+  if (strlen (root) >= PATH_MAX / 4)
+     { printError (-ENAMETOOLONG, basename (argv[0]));
+       return EXIT_FAILURE;
+     }
+  if (stat (root, &st) == -1)                    /* get file attributes */
+     { printError (-errno, basename (argv[0]));
+       return EXIT_FAILURE;
+     }
+  if (!S_ISDIR (st.st_mode))
+     { printError (-ENOTDIR, basename (argv[0]));
+       return EXIT_FAILURE;
+     }
+
+  /* run the workloads with every number of threads */
+
+  char path[PATH_MAX];                           /* path of the file of a thread */
+  uint32_t r, k, t;                              /* counting variables */
+  int status;                                    /* status of operation */
+
+  if ((status = makeTrees (depth)) != 0)
+     { printError (status, basename (argv[0]));
+       removeTrees (depth);
+       return EXIT_FAILURE;
+     }
+
+  fprintf (fo, "{\n  \"directory\": ");
+  printString (root);
+  fprintf (fo, ",\n  \"file_bytes\": %"PRIu64",\n  \"entries\": %"PRIu32",\n  \"depth\": %"PRIu32",\n"
+           "  \"benchmarks\": [\n", fileSize, nEnts, depth);
+  for (r = 0, status = 0; (r < nRuns) && (status == 0); r++)
+  { for (k = 0; (k < 3) && (status == 0); k++)
+      if ((status = run (&wSeqWrite, threads[r], seqSize[k], (uint32_t) (fileSize / seqSize[k]))) == 0)
+         status = run (&wSeqRead, threads[r], seqSize[k], (uint32_t) (fileSize / seqSize[k]));
+    if (status == 0) status = run (&wRandWrite, threads[r], FSB_RAND_SIZE, nOps);
+    if (status == 0) status = run (&wRandRead, threads[r], FSB_RAND_SIZE, nOps);
+    for (t = 0; t < threads[r]; t++)
+    { snprintf (path, sizeof (path), "%s/file%02"PRIu32, root, t);
+      unlink (path);
+    }
+    if (status == 0) status = run (&wCreate, threads[r], 0, nOps);
+    if (status == 0) status = run (&wStat, threads[r], 0, nOps);
+    if (status == 0) status = run (&wUnlink, threads[r], 0, nOps);
+    if (status == 0) status = run (&wList, threads[r], 0, nLists);
+    if (status == 0) status = run (&wLookup, threads[r], 0, nOps);
+  }
+  fprintf (fo, "\n  ]\n}\n");
+  if (status != 0)
+     { printError (status, basename (argv[0]));
+       removeTrees (depth);
+       return EXIT_FAILURE;
+     }
+
+  /* that's all */
+
+  status = removeTrees (depth);
+  if (fo != stdout) fclose (fo);
+  if (status != 0)
+     { printError (status, basename (argv[0]));
+       return EXIT_FAILURE;
+     }
+
+  return EXIT_SUCCESS;
+
+} /* end of main */
+
+/*
+ *  Internal functions
+ */
+
+/*
+ *  Set up a thread of the sequential write workload: its file is created, or truncated, and the buffer is filled in.
+ */
+
+static int openSeqWrite (SOBenchThread *p)
+{
+  memset (p->buf, (int) (p->id + 1), p->req);
+  if ((p->fd = open (p->path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1) return -errno;
+
+  return 0;
+}
+
+/*
+ *  Set up a thread of the read workloads: its file is opened and the kernel is asked to drop its cached contents.
+ */
+
+static int openRead (SOBenchThread *p)
+{
+  if ((p->fd = open (p->path, O_RDONLY)) == -1) return -errno;
+  posix_fadvise (p->fd, 0, 0, POSIX_FADV_DONTNEED);
+
+  return 0;
+}
+
+/*
+ *  Set up a thread of the random write workload: its file, written before, is opened and the buffer is filled in.
+ */
+
+static int openRandWrite (SOBenchThread *p)
+{
+  memset (p->buf, (int) (p->id + 2), p->req);
+  if ((p->fd = open (p->path, O_WRONLY)) == -1) return -errno;
+
+  return 0;
+}
+
+/*
+ *  Write the next request of the file in sequence.
+ */
+
+static int seqWrite (SOBenchThread *p, uint32_t i __attribute__ ((unused)))
+{
+  ssize_t n;                                     /* number of bytes written */
+
+  if ((n = write (p->fd, p->buf, p->req)) == -1) return -errno;
+  if ((size_t) n != p->req) return -EIO;
+  p->bytes += p->req;
+
+  return 0;
+}
+
+/*
+ *  Read the next request of the file in sequence.
+ */
+
+static int seqRead (SOBenchThread *p, uint32_t i __attribute__ ((unused)))
+{
+  ssize_t n;                                     /* number of bytes read */
+
+  if ((n = read (p->fd, p->buf, p->req)) == -1) return -errno;
+  if ((size_t) n != p->req) return -EIO;
+  p->bytes += p->req;
+
+  return 0;
+}
+
+/*
+ *  Write a request of the file at a random offset, aligned to its size.
+ */
+
+static int randWrite (SOBenchThread *p, uint32_t i __attribute__ ((unused)))
+{
+  off_t pos = (off_t) ((uint64_t) rand_r (&p->seed) % (fileSize / p->req)) * p->req;   /* offset of the request */
+  ssize_t n;                                     /* number of bytes written */
+
+  if ((n = pwrite (p->fd, p->buf, p->req, pos)) == -1) return -errno;
+  if ((size_t) n != p->req) return -EIO;
+  p->bytes += p->req;
+
+  return 0;
+}
+
+/*
+ *  Read a request of the file at a random offset, aligned to its size.
+ */
+
+static int randRead (SOBenchThread *p, uint32_t i __attribute__ ((unused)))
+{
+  off_t pos = (off_t) ((uint64_t) rand_r (&p->seed) % (fileSize / p->req)) * p->req;   /* offset of the request */
+  ssize_t n;                                     /* number of bytes read */
+
+  if ((n = pread (p->fd, p->buf, p->req, pos)) == -1) return -errno;
+  if ((size_t) n != p->req) return -EIO;
+  p->bytes += p->req;
+
+  return 0;
+}
+
+/*
+ *  Tear down a thread of the write workloads: the file, if it was opened, is synchronized and closed.
+ */
+
+static int syncClose (SOBenchThread *p)
+{
+  int stat = 0;                                  /* status of operation */
+
+  if (p->fd == -1) return 0;
+  if (fsync (p->fd) == -1) stat = -errno;
+  if ((close (p->fd) == -1) && (stat == 0)) stat = -errno;
+  p->fd = -1;
+
+  return stat;
+}
+
+/*
+ *  Tear down a thread of the read workloads: the file, if it was opened, is closed.
+ */
+
+static int closeFile (SOBenchThread *p)
+{
+  int stat = 0;                                  /* status of operation */
+
+  if (p->fd == -1) return 0;
+  if (close (p->fd) == -1) stat = -errno;
+  p->fd = -1;
+
+  return stat;
+}
+
+/*
+ *  Set up a thread of the create workload: its directory is created.
+ */
+
+static int makeOwnDir (SOBenchThread *p)
+{
+  if (mkdir (p->path, 0755) == -1) return -errno;
+
+  return 0;
+}
+
+/*
+ *  Create the empty file i in the directory of the thread.
+ */
+
+static int createFile (SOBenchThread *p, uint32_t i)
+{
+  char path[PATH_MAX];                           /* path of the file */
+  int fd;                                        /* file descriptor */
+
+  snprintf (path, sizeof (path), "%s/f%06"PRIu32, p->path, i);
+  if ((fd = open (path, O_WRONLY | O_CREAT | O_EXCL, 0644)) == -1) return -errno;
+  if (close (fd) == -1) return -errno;
+
+  return 0;
+}
+
+/*
+ *  Get the attributes of the file i of the directory of the thread.
+ */
+
+static int statFile (SOBenchThread *p, uint32_t i)
+{
+  char path[PATH_MAX];                           /* path of the file */
+  struct stat st;                                /* file attributes */
+
+  snprintf (path, sizeof (path), "%s/f%06"PRIu32, p->path, i);
+  if (stat (path, &st) == -1) return -errno;
+
+  return 0;
+}
+
+/*
+ *  Delete the file i of the directory of the thread.
+ */
+
+static int unlinkFile (SOBenchThread *p, uint32_t i)
+{
+  char path[PATH_MAX];                           /* path of the file */
+
+  snprintf (path, sizeof (path), "%s/f%06"PRIu32, p->path, i);
+  if (unlink (path) == -1) return -errno;
+
+  return 0;
+}
+
+/*
+ *  Tear down a thread of the unlink workload: its directory, which is empty now, is removed.
+ */
+
+static int removeOwnDir (SOBenchThread *p)
+{
+  if (rmdir (p->path) == -1) return -errno;
+
+  return 0;
+}
+
+/*
+ *  List the large directory, which must hold all its entries.
+ */
+
+static int listDir (SOBenchThread *p __attribute__ ((unused)), uint32_t i __attribute__ ((unused)))
+{
+  char path[PATH_MAX];                           /* path of the directory */
+  DIR *dir;                                      /* directory stream */
+  uint32_t n;                                    /* number of entries */
+
+  snprintf (path, sizeof (path), "%s/large", root);
+  if ((dir = opendir (path)) == NULL) return -errno;
+  for (n = 0; readdir (dir) != NULL; n++) ;
+  closedir (dir);
+
+  return (n >= nEnts) ? 0 : -EIO;
+}
+
+/*
+ *  Get the attributes of the file at the bottom of the deep hierarchy of directories.
+ */
+
+static int lookupDeep (SOBenchThread *p __attribute__ ((unused)), uint32_t i __attribute__ ((unused)))
+{
+  struct stat st;                                /* file attributes */
+
+  if (stat (deepPath, &st) == -1) return -errno;
+
+  return 0;
+}
+
+/*
+ *  Run a workload with a number of threads, each one carrying out nOps operations (with requests of req bytes, in the
+ *  I/O workloads), and report it.
+ */
+
+static int run (const SOWorkload *w, uint32_t nThreads, uint32_t req, uint32_t nOps)
+{
+  SOBenchThread *thr;                            /* state of the threads */
+  pthread_t tid[FSB_MAX_THREADS];                /* identification of the threads */
+  uint64_t *lat;                                 /* latencies of the operations of all threads */
+  uint64_t tStart, tEnd, total, bytes;           /* start and end times, total time of the operations and bytes */
+  uint32_t t, k, n;                              /* counting variables */
+  int stat;                                      /* status of operation */
+
+  if (((thr = calloc (nThreads, sizeof (SOBenchThread))) == NULL) ||
+      ((lat = malloc ((size_t) nThreads * nOps * sizeof (uint64_t))) == NULL))
+     { free (thr);
+       return -ENOMEM;
+     }
+  for (t = 0, stat = 0; t < nThreads; t++)
+  { thr[t].id = t;
+    thr[t].req = req;
+    thr[t].nOps = nOps;
+    thr[t].lat = lat + (size_t) t * nOps;
+    thr[t].fd = -1;
+    thr[t].seed = FSB_SEED + t;
+    thr[t].w = w;
+    if (w->io)
+       { snprintf (thr[t].path, sizeof (thr[t].path), "%s/file%02"PRIu32, root, t);
+         if ((thr[t].buf = malloc (req)) == NULL) stat = -ENOMEM;
+       }
+       else snprintf (thr[t].path, sizeof (thr[t].path), "%s/small%02"PRIu32, root, t);
+  }
+  if (stat != 0)
+     { for (t = 0; t < nThreads; t++)
+         free (thr[t].buf);
+       free (thr);
+       free (lat);
+       return stat;
+     }
+
+  /* the threads set up and start together when all of them are ready */
+
+  pthread_barrier_init (&startLine, NULL, nThreads + 1);
+  for (t = 0; t < nThreads; t++)
+    if ((stat = pthread_create (&tid[t], NULL, worker, &thr[t])) != 0)
+       { fprintf (stderr, "fsbench_sofs13: can not create the threads.\n");
+         exit (EXIT_FAILURE);
+       }
+  pthread_barrier_wait (&startLine);
+  for (t = 0; t < nThreads; t++)
+    pthread_join (tid[t], NULL);
+  pthread_barrier_destroy (&startLine);
+
+  for (t = 0, tStart = UINT64_MAX, tEnd = 0, total = 0, bytes = 0, n = 0; t < nThreads; t++)
+  { if ((thr[t].stat != 0) && (stat == 0)) stat = thr[t].stat;
+    if (thr[t].tStart < tStart) tStart = thr[t].tStart;
+    if (thr[t].tEnd > tEnd) tEnd = thr[t].tEnd;
+    for (k = 0; k < nOps; k++)
+      total += lat[n++] = thr[t].lat[k];
+    bytes += thr[t].bytes;
+    free (thr[t].buf);
+  }
+  if (stat == 0)
+     report (w->name, nThreads, w->io ? req : 0, lat, n, tEnd - tStart, total, bytes);
+  free (thr);
+  free (lat);
+
+  return stat;
+}
+
+/*
+ *  Thread of a run: it sets up, waits for the others at the start line, times its operations and tears down.
+ */
+
+static void *worker (void *arg)
+{
+  SOBenchThread *p = (SOBenchThread *) arg;      /* state of the thread */
+  uint64_t t0;                                   /* start time of the operation */
+  uint32_t i;                                    /* counting variable */
+  int stat;                                      /* status of operation */
+
+  p->stat = (p->w->setup != NULL) ? p->w->setup (p) : 0;
+  pthread_barrier_wait (&startLine);
+  p->tStart = p->tEnd = now ();
+  for (i = 0; (p->stat == 0) && (i < p->nOps); i++)
+  { t0 = now ();
+    p->stat = p->w->op (p, i);
+    p->tEnd = now ();
+    p->lat[i] = p->tEnd - t0;
+  }
+  if ((p->w->teardown != NULL) && ((stat = p->w->teardown (p)) != 0) && (p->stat == 0))
+     p->stat = stat;
+
+  return NULL;
+}
+
+/*
+ *  Create the large directory, with nEnts empty files, and the deep hierarchy of directories with a file at the
+ *  bottom.
+ */
+
+static int makeTrees (uint32_t depth)
+{
+  char path[PATH_MAX];                           /* path of an entry */
+  uint32_t i;                                    /* counting variable */
+  int fd;                                        /* file descriptor */
+
+  snprintf (path, sizeof (path), "%s/large", root);
+  if (mkdir (path, 0755) == -1) return -errno;
+  for (i = 0; i < nEnts; i++)
+  { snprintf (path, sizeof (path), "%s/large/f%06"PRIu32, root, i);
+    if ((fd = open (path, O_WRONLY | O_CREAT | O_EXCL, 0644)) == -1) return -errno;
+    close (fd);
+  }
+
+  snprintf (deepPath, sizeof (deepPath), "%s", root);
+  for (i = 0; i < depth; i++)
+  { snprintf (deepPath + strlen (deepPath), sizeof (deepPath) - strlen (deepPath), "/d%02"PRIu32, i % 100);
+    if (mkdir (deepPath, 0755) == -1) return -errno;
+  }
+  snprintf (deepPath + strlen (deepPath), sizeof (deepPath) - strlen (deepPath), "/leaf");
+  if ((fd = open (deepPath, O_WRONLY | O_CREAT | O_EXCL, 0644)) == -1) return -errno;
+  close (fd);
+
+  return 0;
+}
+
+/*
+ *  Remove the large directory and the deep hierarchy of directories, as much of them as exists.
+ */
+
+static int removeTrees (uint32_t depth)
+{
+  char path[PATH_MAX];                           /* path of an entry */
+  uint32_t i;                                    /* counting variable */
+  int stat = 0;                                  /* status of operation */
+
+  for (i = 0; i < nEnts; i++)
+  { snprintf (path, sizeof (path), "%s/large/f%06"PRIu32, root, i);
+    unlink (path);
+  }
+  snprintf (path, sizeof (path), "%s/large", root);
+  if ((rmdir (path) == -1) && (errno != ENOENT)) stat = -errno;
+
+  snprintf (path, sizeof (path), "%s", root);
+  for (i = 0; i < depth; i++)
+    snprintf (path + strlen (path), sizeof (path) - strlen (path), "/d%02"PRIu32, i % 100);
+  snprintf (path + strlen (path), sizeof (path) - strlen (path), "/leaf");
+  unlink (path);
+  for (i = 0; i <= depth; i++)
+  { *strrchr (path, '/') = '\0';
+    if ((i < depth) && (rmdir (path) == -1) && (errno != ENOENT) && (stat == 0)) stat = -errno;
+  }
+
+  return stat;
+}
+
+/*
+ *  Report a run: the latencies of its operations are sorted to find the percentiles (nearest rank); the throughput is
+ *  got from the time the run took.
+ */
+
+static void report (const char *name, uint32_t nThreads, uint32_t req, uint64_t *lat, uint32_t nOps, uint64_t wall,
+                    uint64_t total, uint64_t bytes)
+{
+  static const uint32_t pct[3] = { 50, 90, 99 }; /* percentiles */
+  uint32_t k;                                    /* counting variable */
+
+  if (nReported++ != 0) fprintf (fo, ",\n");
+  fprintf (fo, "    {\"name\": \"%s\", \"threads\": %"PRIu32, name, nThreads);
+  if (req != 0) fprintf (fo, ", \"req_bytes\": %"PRIu32, req);
+  fprintf (fo, ", \"ops\": %"PRIu32, nOps);
+  if (nOps == 0)
+     { fprintf (fo, "}");
+       return;
+     }
+  qsort (lat, nOps, sizeof (uint64_t), cmpLatency);
+  fprintf (fo, ", \"ops_per_s\": %.1f", (wall != 0) ? 1e9 * (double) nOps / (double) wall : 0.0);
+  if (req != 0)
+     fprintf (fo, ", \"mib_per_s\": %.2f",
+              (wall != 0) ? 1e9 * (double) bytes / (1024.0 * 1024.0 * (double) wall) : 0.0);
+  fprintf (fo, ", \"mean_us\": %.3f", (double) total / (1000.0 * (double) nOps));
+  for (k = 0; k < 3; k++)
+    fprintf (fo, ", \"p%"PRIu32"_us\": %.3f", pct[k],
+             (double) lat[((uint64_t) nOps * pct[k] + 99) / 100 - 1] / 1000.0);
+  fprintf (fo, ", \"max_us\": %.3f}", (double) lat[nOps-1] / 1000.0);
+  fflush (fo);
+}
+
+/*
+ *  Current time of the monotonic clock, in nanoseconds.
+ */
+
+static uint64_t now (void)
+{
+  struct timespec ts;                            /* current time */
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+/*
+ *  Order of two latencies.
+ */
+
+static int cmpLatency (const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+  return (x > y) - (x < y);
+}
+
+/*
+ *  Print a string as a JSON string.
+ */
+
+static void printString (const char *str)
+{
+  fputc ('"', fo);
+  for (; *str != '\0'; str++)
+    if ((*str == '"') || (*str == '\\'))
+       fprintf (fo, "\\%c", *str);
+       else if ((unsigned char) *str < 0x20)
+               fprintf (fo, "\\u%04x", (unsigned int) (unsigned char) *str);
+               else fputc (*str, fo);
+  fputc ('"', fo);
+}
+
+/*
+ * print help message
+ */
+
+static void printUsage (char *cmd_name)
+{
+  printf ("Sinopsis: %s [OPTIONS] directory\n"
+          "  OPTIONS:\n"
+          "  -t list  --- set numbers of threads, separated by commas (default: 1,2,4)\n"
+          "  -n num   --- set number of operations of each thread in the random I/O, small files and deep\n"
+          "               hierarchy workloads (default: 1000)\n"
+          "  -f size  --- set size of the file of each thread in the sequential I/O workloads in MiB (default: 4)\n"
+          "  -e num   --- set number of entries of the large directory (default: 2000)\n"
+          "  -l num   --- set number of listings of the large directory by each thread (default: 20)\n"
+          "  -d num   --- set depth of the hierarchy of directories (default: 32)\n"
+          "  -o file  --- write the report into file (default: stdout)\n"
+          "  -h       --- print this help\n", cmd_name);
+}
+
+/*
+ * print error message
+ */
+
+static void printError (int errcode, char *cmd_name)
+{
+  fprintf(stderr, "%s: error #%d - %s\n", cmd_name, -errcode, strerror (-errcode));
+}
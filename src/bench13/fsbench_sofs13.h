@@ -0,0 +1,37 @@
+/**
+ *  \file fsbench_sofs13.h (interface file)
+ *
+ *  \brief The SOFS13 mounted file system benchmarking tool.
+ *
+ *  It runs a fixed set of workloads through the system calls on a directory of a mounted file system, each one with
+ *  every number of threads asked for, and reports, for each run, the number of operations, the throughput and the
+ *  mean, the percentiles 50, 90 and 99 and the maximum of the latency, in JSON, so that the results of successive runs
+ *  may be compared.
+ *
+ *  The following workloads are run (each thread works on files and directories of its own, but for the large
+ *  directory and the deep hierarchy, which are shared):
+ *     \li write and read a file in sequence, with requests of 4 KiB, 64 KiB and 1 MiB
+ *     \li write and read blocks of 4 KiB of a file at random offsets
+ *     \li create, get the attributes of and delete empty files
+ *     \li list a large directory
+ *     \li get the attributes of a file at the bottom of a deep hierarchy of directories.
+ *
+ *  SINOPSIS:
+ *  <P><PRE>                fsbench_sofs13 [OPTIONS] directory
+ *
+ *                OPTIONS:
+ *                 -t list  --- set numbers of threads, separated by commas (default: 1,2,4)
+ *                 -n num   --- set number of operations of each thread in the random I/O, small files and deep
+ *                              hierarchy workloads (default: 1000)
+ *                 -f size  --- set size of the file of each thread in the sequential I/O workloads in MiB (default: 4)
+ *                 -e num   --- set number of entries of the large directory (default: 2000)
+ *                 -l num   --- set number of listings of the large directory by each thread (default: 20)
+ *                 -d num   --- set depth of the hierarchy of directories (default: 32)
+ *                 -o file  --- write the report into file (default: stdout)
+ *                 -h       --- print this help.</PRE>
+ *
+ *  \remarks The directory is supposed to be empty and it is left empty. When it lies in a SOFS13 file system mounted
+ *           by \e mount_sofs13, the latencies measured include those of FUSE and of the kernel; the contents of the
+ *           files read back may be served by the page cache of the kernel, which is only asked to drop them.
+ *           <em>make -C src fsbench</em> formats a fresh image, mounts it and runs the tool on it.
+ */
@@ -0,0 +1,769 @@
+/**
+ *  \file replay_sofs13.c (implementation file)
+ *
+ *  \brief The SOFS13 trace replaying tool.
+ *
+ *  It replays a trace of operations recorded by \e mount_sofs13 (option -t) directly through the system calls of the
+ *  file system on a storage device, in the order they were completed, either as fast as possible, or at the pace they
+ *  were recorded at, and reports, for each kind of operation, the number of operations and of errors, the throughput
+ *  and the mean, the percentiles 50, 90 and 99 and the maximum of the latency, in JSON, so that the results of runs on
+ *  successive versions of the file system, or with other options, may be compared.
+ *
+ *  When the operations of the trace address the files by the numbers of their inodes (the low-level frontend was
+ *  used), the path of each file is rebuilt from the entries looked up or created before, as recorded.
+ *
+ *  SINOPSIS:
+ *  <P><PRE>                replay_sofs13 [OPTIONS] trace-file supp-file
+ *
+ *                OPTIONS:
+ *                 -p       --- replay the operations at the pace they were recorded at (default: as fast as possible)
+ *                 -c size  --- set buffercache size in MiB (default: 25 clusters)
+ *                 -r name  --- set buffercache replacement policy: lru or 2q, with ",meta" to give priority to the
+ *                              superblock and the table of inodes (default: lru)
+ *                 -e       --- describe the regular files created by trees of extents (default: lists of references)
+ *                 -g       --- allocate the data clusters from allocation groups through per-thread reservations
+ *                              (default: from the shared caches of the superblock)
+ *                 -n       --- store the contents of small files and symbolic links in their inodes (default: in data
+ *                              clusters)
+ *                 -z       --- compress the data clusters of the regular files created in groups (default: stored as
+ *                              they are)
+ *                 -m       --- map the storage device into memory (default: system calls)
+ *                 -u       --- submit batches of transfers through io_uring (default: synchronous transfers)
+ *                 -o file  --- write the report into file (default: stdout)
+ *                 -h       --- print this help.</PRE>
+ *
+ *  \remarks The storage device is changed: it should be a copy of the storage device as it was when the trace was
+ *           started, so that the same files are found. The operations which have no counterpart among the system
+ *           calls (flush and fallocate) are skipped, and so are those whose file can not be found; an operation
+ *           whose outcome, success or failure, differs from the recorded one is counted as a mismatch. The layers of
+ *           \e mount_sofs13 itself (the delayed allocation and the open-file handles) are not replayed.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <fcntl.h>
+#include <utime.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/types.h>
+#include <string.h>
+#include <errno.h>
+
+#include "sofs_stats.h"
+#include "sofs_trace.h"
+#include "sofs_const.h"
+#include "sofs_rawdisk.h"
+#include "sofs_buffercache.h"
+#include "sofs_direntry.h"
+#include "sofs_basicoper.h"
+#include "sofs_basicconsist.h"
+#include "sofs_journal.h"
+#include "sofs_atime.h"
+#include "sofs_readdir.h"
+#include "sofs_extent.h"
+#include "sofs_inline.h"
+#include "sofs_compress.h"
+#include "sofs_allocgroup.h"
+#include "sofs_freesummary.h"
+#include "sofs_inodeindex.h"
+#include "sofs_syscalls.h"
+
+/** \brief maximum number of components of a path rebuilt from the entries recorded */
+#define REPLAY_DEPTH   (MAX_PATH / 2)
+/** \brief size of the buffer of a read of a directory whose size was not recorded (a page, as the kernel uses) */
+#define REPLAY_DIRBUF  4096
+/** \brief maximum number of bytes of a single transfer */
+#define REPLAY_MAXBUF  (64 * 1024 * 1024)
+
+/*
+ *  Internal data structure
+ */
+
+/** \brief latencies of a kind of operation */
+typedef struct soReplayOp
+{
+  /** \brief latencies of the operations, in nanoseconds */
+  uint64_t *lat;
+  /** \brief number of operations */
+  uint32_t nOps;
+  /** \brief number of latencies the storage holds */
+  uint32_t size;
+  /** \brief number of operations which failed */
+  uint32_t nErrors;
+  /** \brief time spent in the operations, in nanoseconds */
+  uint64_t total;
+} SOReplayOp;
+
+/** \brief entry an inode was last reached by (traces whose operations address the inodes) */
+typedef struct soReplayEntry
+{
+  /** \brief number of the inode of the directory (TRACE_NO_INODE, if unknown) */
+  uint32_t parent;
+  /** \brief name of the entry */
+  char name[MAX_NAME+1];
+} SOReplayEntry;
+
+/** \brief latencies of each kind of operation */
+static SOReplayOp opStat[TRACE_MAX];
+/** \brief entries the inodes were last reached by, indexed by the number of the inode */
+static SOReplayEntry *entry = NULL;
+/** \brief number of entries */
+static uint32_t nEntries = 0;
+/** \brief buffer of the transfers */
+static char *buf = NULL;
+/** \brief size of the buffer of the transfers */
+static uint32_t bufSize = 0;
+/** \brief report stream */
+static FILE *fo = NULL;
+
+/* Allusion to internal functions */
+
+static int replay (const SOTraceRecord *p_rec, const char *name, const char *name2, bool byInode, bool *p_skip);
+static int replayPaths (const SOTraceRecord *p_rec, const char *path, const char *path2, bool *p_skip);
+static int resolve (const SOTraceRecord *p_rec, const char *name, const char *name2, char *path, char *path2);
+static void account (const SOTraceRecord *p_rec, const char *name, const char *name2);
+static int buildPath (uint32_t nInode, const char *name, char *path);
+static int setEntry (uint32_t nInode, uint32_t parent, const char *name);
+static uint32_t findEntry (uint32_t parent, const char *name);
+static int growBuffer (uint64_t size);
+static int countEntry (void *data, const char *name, const struct stat *st, uint32_t next);
+static int addLatency (uint32_t op, uint64_t d, bool failed);
+static int setPolicy (const char *name);
+static int openFileSystem (const char *devname);
+static int closeFileSystem (void);
+static void report (void);
+static int cmpLatency (const void *a, const void *b);
+static void printString (const char *str);
+static void printUsage (char *cmd_name);
+static void printError (int errcode, char *cmd_name);
+
+/* The main function */
+
+int main (int argc, char *argv[])
+{
+  bool paced = false;                            /* replay at the pace of the trace, if set */
+  int cache_size;                                /* buffercache size in MiB */
+
+  /* process command line options */
+
+  int opt;                                       /* selected option */
+
+  do
+  { switch ((opt = getopt (argc, argv, "pc:r:egnzmuo:h")))
+    { case 'p': /* pace of the trace */
+                paced = true;
+                break;
+      case 'c': /* buffercache size */
+                if ((sscanf (optarg, "%d", &cache_size) != 1) || (cache_size <= 0) ||
+                    (cache_size > (int) (UINT32_MAX / ((1024 * 1024) / BLOCK_SIZE))))
+                   { fprintf (stderr, "%s: Bad argument to c option.\n", basename (argv[0]));
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                soSetBufferCacheCapacity ((uint32_t) cache_size * ((1024 * 1024) / BLOCK_SIZE));
+                break;
+      case 'r': /* buffercache replacement policy */
+                if (setPolicy (optarg) != 0)
+                   { fprintf (stderr, "%s: Bad argument to r option.\n", basename (argv[0]));
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                break;
+      case 'e': /* trees of extents */
+                soSetExtentFormat (true);        /* the files already created keep their format */
+                break;
+      case 'g': /* allocation groups */
+                soSetAllocGroups (true);         /* they are built on opening the file system */
+                break;
+      case 'n': /* contents stored in the inodes */
+                soSetInlineData (true);          /* the files already created keep their format */
+                break;
+      case 'z': /* compressed data clusters */
+                soSetCompression (true);         /* the files already created keep their format */
+                break;
+      case 'm': /* memory-mapped device */
+                soSetDeviceBackend (RAW_MMAP);   /* it falls back to system calls, if the mapping fails */
+                break;
+      case 'u': /* io_uring transfers */
+                soSetDeviceBackend (RAW_URING);  /* it falls back to synchronous transfers, if not available */
+                break;
+      case 'o': /* report file */
+                if ((fo = fopen (optarg, "w")) == NULL)
+                   { fprintf (stderr, "%s: Can't open report file \"%s\".\n", basename (argv[0]), optarg);
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                break;
+      case 'h': /* help mode */
+                printUsage (basename (argv[0]));
+                return EXIT_SUCCESS;
+      case -1:  break;
+      default:  fprintf (stderr, "%s: Wrong option.\n", basename (argv[0]));
+                printUsage (basename (argv[0]));
+                return EXIT_FAILURE;
+    }
+  } while (opt != -1);
+  if ((argc - optind) != 2)                      /* check existence of mandatory arguments: trace and storage device */
+     { fprintf (stderr, "%s: Wrong number of mandatory arguments.\n", basename (argv[0]));
+       printUsage (basename (argv[0]));
+       return EXIT_FAILURE;
+     }
+  if (fo == NULL)
+     fo = stdout;                                /* if the switch -o was not used, set output to stdout */
+
+  /* open the trace */
+
+  FILE *ft;                                      /* trace stream */
+  SOTraceHeader hdr;                             /* header of the trace */
+  int status;                                    /* status of operation */
+
+  if ((ft = fopen (argv[optind], "r")) == NULL)
+     { printError (-errno, basename (argv[0]));
+       return EXIT_FAILURE;
+     }
+  if ((status = soTraceReadHeader (ft, &hdr)) != 0)
+     { fprintf (stderr, "%s: Bad trace file \"%s\".\n", basename (argv[0]), argv[optind]);
+       fclose (ft);
+       return EXIT_FAILURE;
+     }
+
+  /* open the file system */
+
+  if ((status = openFileSystem (argv[optind+1])) != 0)
+     { printError (status, basename (argv[0]));
+       fclose (ft);
+       return EXIT_FAILURE;
+     }
+
+  /* replay the operations */
+
+  SOTraceRecord rec;                             /* record of the trace */
+  char name[TRACE_MAX_NAME+1];                   /* first name of the record */
+  char name2[TRACE_MAX_NAME+1];                  /* second name of the record */
+  uint64_t nRecords, nSkipped, nMismatches;      /* numbers of records read and skipped and of outcomes differing */
+  uint64_t tStart, tFirst, t0, t;                /* start of the replay, time of the first record and of an op */
+  struct timespec ts;                            /* time to wait for */
+  bool skip;                                     /* signals if the operation was skipped */
+  int res;                                       /* result of the operation */
+
+  nRecords = nSkipped = nMismatches = 0;
+  tStart = soStatClock ();
+  tFirst = 0;
+  while ((status = soTraceReadRecord (ft, &rec, name, name2)) == 1)
+  { if (nRecords++ == 0) tFirst = rec.time;
+    if (paced && ((t = tStart + (rec.time - tFirst)) > (t0 = soStatClock ())))
+       { ts.tv_sec = (time_t) ((t - t0) / 1000000000);
+         ts.tv_nsec = (long) ((t - t0) % 1000000000);
+         nanosleep (&ts, NULL);
+       }
+    skip = false;
+    soBeginTransaction ();                       /* as mount_sofs13 does for every operation */
+    t0 = soStatClock ();
+    res = replay (&rec, name, name2, hdr.byinode != 0, &skip);
+    t = soStatClock () - t0;
+    if ((status = soCommitTransaction ()) != 0) break;
+    if (hdr.byinode) account (&rec, name, name2);
+    if (skip)
+       { nSkipped += 1;
+         continue;
+       }
+    if ((res < 0) != (rec.result < 0)) nMismatches += 1;
+    if ((status = addLatency (rec.op, t, res < 0)) != 0) break;
+  }
+  t = soStatClock () - tStart;
+  fclose (ft);
+  if (status < 0)
+     { printError (status, basename (argv[0]));
+       closeFileSystem ();
+       return EXIT_FAILURE;
+     }
+
+  /* close the file system */
+
+  if ((status = closeFileSystem ()) != 0)
+     { printError (status, basename (argv[0]));
+       return EXIT_FAILURE;
+     }
+
+  /* report */
+
+  fprintf (fo, "{\n  \"trace\": ");
+  printString (argv[optind]);
+  fprintf (fo, ",\n  \"device\": ");
+  printString (argv[optind+1]);
+  fprintf (fo, ",\n  \"byinode\": %s,\n  \"paced\": %s,\n  \"records\": %"PRIu64",\n  \"dropped\": %"PRIu64
+           ",\n  \"skipped\": %"PRIu64",\n  \"mismatches\": %"PRIu64",\n  \"wall_s\": %.3f,\n  \"ops_per_s\": %.1f"
+           ",\n  \"operations\": [\n", hdr.byinode ? "true" : "false", paced ? "true" : "false", nRecords, hdr.dropped,
+           nSkipped, nMismatches, (double) t / 1e9, (t != 0) ? 1e9 * (double) (nRecords - nSkipped) / (double) t : 0.0);
+  report ();
+  fprintf (fo, "\n  ]\n}\n");
+  if (fo != stdout) fclose (fo);
+
+  /* that's all */
+
+  return EXIT_SUCCESS;
+
+} /* end of main */
+
+/*
+ *  Internal functions
+ */
+
+/*
+ *  Replay an operation: the paths are taken from the record, or rebuilt from the entries the inodes were reached by.
+ */
+
+static int replay (const SOTraceRecord *p_rec, const char *name, const char *name2, bool byInode, bool *p_skip)
+{
+  char path[MAX_PATH+1], path2[MAX_PATH+1];      /* paths of the operation */
+
+  if (!byInode)
+     return replayPaths (p_rec, name, name2, p_skip);
+  if (resolve (p_rec, name, name2, path, path2) != 0)
+     { *p_skip = true;                           /* the file was never reached */
+       return 0;
+     }
+
+  return replayPaths (p_rec, path, path2, p_skip);
+}
+
+/*
+ *  Replay an operation whose paths are known.
+ */
+
+static int replayPaths (const SOTraceRecord *p_rec, const char *path, const char *path2, bool *p_skip)
+{
+  struct stat st;                                /* attributes of a file */
+  struct statvfs stv;                            /* attributes of the file system */
+  struct utimbuf times;                          /* times of last access and modification */
+  uint32_t budget;                               /* bytes left in the buffer of a read of a directory */
+  int stat;                                      /* status of operation */
+
+  switch (p_rec->op)
+  { case TRACE_STATFS:
+      return soStatFS ("/", &stv);
+    case TRACE_GETATTR:
+    case TRACE_LOOKUP:
+      return soStat (path, &st);
+    case TRACE_ACCESS:
+      return soAccess (path, (int) p_rec->mode);
+    case TRACE_UTIME:
+      times.actime = (time_t) p_rec->offset;
+      times.modtime = (time_t) p_rec->size;
+      return soUtime (path, (p_rec->mode != 0) ? &times : NULL);
+    case TRACE_CHMOD:
+      return soChmod (path, (mode_t) p_rec->mode);
+    case TRACE_CHOWN:
+      return soChown (path, (uid_t) p_rec->offset, (gid_t) p_rec->size);
+    case TRACE_MKNOD:
+      return soMknod (path, (mode_t) p_rec->mode);
+    case TRACE_CREATE:
+      if ((stat = soMknod (path, (mode_t) p_rec->mode)) != 0) return stat;
+      return soOpen (path, (int) p_rec->offset);
+    case TRACE_OPEN:
+      return soOpen (path, (int) p_rec->mode);
+    case TRACE_READ:
+      if ((stat = growBuffer (p_rec->size)) != 0) return stat;
+      return soRead (path, buf, (uint32_t) p_rec->size, (int32_t) p_rec->offset);
+    case TRACE_WRITE:
+      if ((stat = growBuffer (p_rec->size)) != 0) return stat;
+      return soWrite (path, buf, (uint32_t) p_rec->size, (int32_t) p_rec->offset);
+    case TRACE_RELEASE:
+      return soClose (path);
+    case TRACE_MKDIR:
+      return soMkdir (path, (mode_t) p_rec->mode | S_IFDIR);
+    case TRACE_RMDIR:
+      return soRmdir (path);
+    case TRACE_OPENDIR:
+      return soOpendir (path);
+    case TRACE_READDIR:
+      budget = (p_rec->size != 0) ? (uint32_t) p_rec->size : REPLAY_DIRBUF;
+      stat = soReaddirBatch (path, (uint32_t) p_rec->offset, countEntry, &budget, true);
+      return (stat > 0) ? 0 : stat;
+    case TRACE_RELEASEDIR:
+      return soClosedir (path);
+    case TRACE_LINK:
+      return soLink (path, path2);
+    case TRACE_UNLINK:
+      return soUnlink (path);
+    case TRACE_RENAME:
+      return soRename (path, path2);
+    case TRACE_TRUNCATE:
+      return soTruncate (path, (off_t) p_rec->size);
+    case TRACE_READLINK:
+      if ((stat = growBuffer (p_rec->size)) != 0) return stat;
+      return soReadlink (path, buf, (int32_t) p_rec->size);
+    case TRACE_SYMLINK:
+      return soSymlink (path2, path);
+    case TRACE_FSYNC:
+    case TRACE_FSYNCDIR:
+      return soFsync (path);
+    default:                                     /* no counterpart among the system calls */
+      *p_skip = true;
+      return 0;
+  }
+}
+
+/*
+ *  Rebuild the paths of an operation which addresses the inodes: the first one is that of the entry of the directory
+ *  for the operations which change its contents, or that of the inode, otherwise; the second one is that of the new
+ *  entry (rename and link) or the contents of the symbolic link (symlink).
+ */
+
+static int resolve (const SOTraceRecord *p_rec, const char *name, const char *name2, char *path, char *path2)
+{
+  int stat;                                      /* status of operation */
+
+  path2[0] = '\0';
+  switch (p_rec->op)
+  { case TRACE_STATFS:
+      strcpy (path, "/");
+      return 0;
+    case TRACE_LOOKUP:
+    case TRACE_MKNOD:
+    case TRACE_CREATE:
+    case TRACE_MKDIR:
+    case TRACE_UNLINK:
+    case TRACE_RMDIR:
+      return buildPath (p_rec->inode, name, path);
+    case TRACE_SYMLINK:
+      if ((stat = buildPath (p_rec->inode, name, path)) != 0) return stat;
+      if (strlen (name2) > MAX_PATH) return -ENAMETOOLONG;
+      strcpy (path2, name2);
+      return 0;
+    case TRACE_RENAME:
+      if ((stat = buildPath (p_rec->inode, name, path)) != 0) return stat;
+      return buildPath (p_rec->inode2, name2, path2);
+    case TRACE_LINK:
+      if ((stat = buildPath (p_rec->inode, NULL, path)) != 0) return stat;
+      return buildPath (p_rec->inode2, name2, path2);
+    default:
+      return buildPath (p_rec->inode, NULL, path);
+  }
+}
+
+/*
+ *  Account for the entries an operation which addresses the inodes reached, created, removed or moved, as recorded
+ *  (the numbers of the inodes are those of the trace).
+ */
+
+static void account (const SOTraceRecord *p_rec, const char *name, const char *name2)
+{
+  uint32_t nInode;                               /* number of an inode */
+
+  switch (p_rec->op)
+  { case TRACE_LOOKUP:
+    case TRACE_MKNOD:
+    case TRACE_CREATE:
+    case TRACE_MKDIR:
+    case TRACE_SYMLINK:
+      if (p_rec->inode2 != TRACE_NO_INODE)
+         setEntry (p_rec->inode2, p_rec->inode, name);
+      break;
+    case TRACE_UNLINK:
+    case TRACE_RMDIR:
+      if ((p_rec->result == 0) && ((nInode = findEntry (p_rec->inode, name)) != TRACE_NO_INODE))
+         setEntry (nInode, TRACE_NO_INODE, "");
+      break;
+    case TRACE_RENAME:
+      if (p_rec->result != 0) break;
+      if ((nInode = findEntry (p_rec->inode2, name2)) != TRACE_NO_INODE)      /* the replaced entry */
+         setEntry (nInode, TRACE_NO_INODE, "");
+      if ((nInode = findEntry (p_rec->inode, name)) != TRACE_NO_INODE)
+         setEntry (nInode, p_rec->inode2, name2);
+      break;
+  }
+}
+
+/*
+ *  Build the path of an inode, followed by the name of an entry, if given, from the entries the inodes were reached
+ *  by: the root directory is inode 0.
+ */
+
+static int buildPath (uint32_t nInode, const char *name, char *path)
+{
+  uint32_t chain[REPLAY_DEPTH];                  /* inodes from the one given up to the root directory */
+  uint32_t n, k;                                 /* number of inodes of the chain and counting variable */
+  size_t len;                                    /* length of the path */
+
+  for (n = 0; nInode != 0; n++)
+  { if ((n == REPLAY_DEPTH) || (nInode >= nEntries) || (entry[nInode].parent == TRACE_NO_INODE)) return -ENOENT;
+    chain[n] = nInode;
+    nInode = entry[nInode].parent;
+  }
+
+  len = 0;
+  path[0] = '\0';
+  for (k = n; k > 0; k--)
+  { if (len + 1 + strlen (entry[chain[k-1]].name) > MAX_PATH) return -ENAMETOOLONG;
+    len += (size_t) sprintf (path + len, "/%s", entry[chain[k-1]].name);
+  }
+  if ((name != NULL) && (name[0] != '\0'))
+     { if (len + 1 + strlen (name) > MAX_PATH) return -ENAMETOOLONG;
+       len += (size_t) sprintf (path + len, "/%s", name);
+     }
+  if (len == 0) strcpy (path, "/");
+
+  return 0;
+}
+
+/*
+ *  Set the entry an inode was reached by (the storage grows as needed).
+ */
+
+static int setEntry (uint32_t nInode, uint32_t parent, const char *name)
+{
+  SOReplayEntry *p;                              /* new storage */
+  uint32_t n, i;                                 /* new number of entries and counting variable */
+
+  if ((nInode == 0) || (nInode == TRACE_NO_INODE) || (strlen (name) > MAX_NAME)) return -EINVAL;
+  if (nInode >= nEntries)
+     { n = (nEntries == 0) ? 1024 : nEntries;
+       while (n <= nInode) n *= 2;
+       if ((p = realloc (entry, (size_t) n * sizeof (SOReplayEntry))) == NULL) return -ENOMEM;
+       for (i = nEntries; i < n; i++)
+         p[i].parent = TRACE_NO_INODE;
+       entry = p;
+       nEntries = n;
+     }
+  entry[nInode].parent = parent;
+  strcpy (entry[nInode].name, name);
+
+  return 0;
+}
+
+/*
+ *  Find the inode which was last reached by an entry.
+ */
+
+static uint32_t findEntry (uint32_t parent, const char *name)
+{
+  uint32_t i;                                    /* counting variable */
+
+  for (i = 1; i < nEntries; i++)
+    if ((entry[i].parent == parent) && (strcmp (entry[i].name, name) == 0))
+       return i;
+
+  return TRACE_NO_INODE;
+}
+
+/*
+ *  Make the buffer of the transfers as large as a transfer: its contents are a fixed pattern.
+ */
+
+static int growBuffer (uint64_t size)
+{
+  char *p;                                       /* new buffer */
+  uint32_t i;                                    /* counting variable */
+
+  if (size > REPLAY_MAXBUF) return -EINVAL;
+  if (size <= bufSize) return 0;
+  if ((p = realloc (buf, (size_t) size)) == NULL) return -ENOMEM;
+  for (i = bufSize; i < (uint32_t) size; i++)
+    p[i] = (char) ('a' + i % 26);
+  buf = p;
+  bufSize = (uint32_t) size;
+
+  return 0;
+}
+
+/*
+ *  Count a directory entry against the buffer of a read of a directory, as FUSE lays it out: a non-zero value is
+ *  returned when the buffer is full.
+ */
+
+static int countEntry (void *data, const char *name, const struct stat *st, uint32_t next)
+{
+  uint32_t *p_budget = (uint32_t *) data;
+  uint32_t len = (24 + (uint32_t) strlen (name) + 7) & ~7U;         /* size of a FUSE directory entry */
+
+  if (len > *p_budget) return 1;
+  *p_budget -= len;
+
+  return 0;
+}
+
+/*
+ *  Add the latency of an operation to those of its kind (the storage grows as needed).
+ */
+
+static int addLatency (uint32_t op, uint64_t d, bool failed)
+{
+  SOReplayOp *p_op = &opStat[op];                /* latencies of the kind of operation */
+  uint64_t *p;                                   /* new storage */
+  uint32_t n;                                    /* new number of latencies the storage holds */
+
+  if (p_op->nOps == p_op->size)
+     { n = (p_op->size == 0) ? 1024 : 2 * p_op->size;
+       if ((p = realloc (p_op->lat, (size_t) n * sizeof (uint64_t))) == NULL) return -ENOMEM;
+       p_op->lat = p;
+       p_op->size = n;
+     }
+  p_op->lat[p_op->nOps++] = d;
+  p_op->total += d;
+  if (failed) p_op->nErrors += 1;
+
+  return 0;
+}
+
+/*
+ *  Set the buffercache replacement policy by name: "lru" or "2q", optionally followed by ",meta", which gives priority
+ *  to the superblock and the table of inodes.
+ */
+
+static int setPolicy (const char *name)
+{
+  uint32_t prio = 0;
+  size_t len;
+
+  len = strlen (name);
+  if ((len > 5) && (strcmp (name + len - 5, ",meta") == 0))
+     { prio = (1U << BC_SUPERBLOCK) | (1U << BC_ITABLE);
+       len -= 5;
+     }
+  if ((len == 3) && (strncmp (name, "lru", 3) == 0))
+     return soSetBufferCachePolicy (BC_LRU, prio);
+  if ((len == 2) && (strncmp (name, "2q", 2) == 0))
+     return soSetBufferCachePolicy (BC_2Q, prio);
+
+  return -EINVAL;
+}
+
+/*
+ *  Open the file system, as mount_sofs13 does on mounting it.
+ */
+
+static int openFileSystem (const char *devname)
+{
+  int stat;                                      /* status of operation */
+
+  if ((stat = soReplayJournal (devname, NULL)) != 0) return stat;        /* after an unclean shutdown */
+  if ((stat = soMountSOFS (devname)) != 0) return stat;
+  soOpenJournal ();                                                     /* without it, updates are written in place */
+  if (((stat = soOpenFreeSummary ()) != 0) || ((stat = soOpenAllocGroups ()) != 0))
+     { soCloseFreeSummary ();
+       soCloseJournal ();
+       soUnmountSOFS ();
+       return stat;
+     }
+  soOpenInodeIndex ();                                                  /* without it, inodes are taken in list order */
+
+  return 0;
+}
+
+/*
+ *  Close the file system, as mount_sofs13 does on unmounting it.
+ */
+
+static int closeFileSystem (void)
+{
+  int stat;                                      /* status of operation */
+
+  soBeginTransaction ();
+  soAtimeSyncAll ();
+  soCloseAllocGroups ();                                                /* the reserved clusters are given back */
+  stat = soCommitTransaction ();
+  soCloseFreeSummary ();                                                /* after the last change of the bitmap table */
+  soCloseInodeIndex ();
+  soCloseJournal ();
+  if (soUnmountSOFS () != 0) stat = -EIO;
+
+  return stat;
+}
+
+/*
+ *  Report the kinds of operations replayed: the latencies of each kind are sorted to find the percentiles (nearest
+ *  rank).
+ */
+
+static void report (void)
+{
+  static const uint32_t pct[3] = { 50, 90, 99 }; /* percentiles */
+  SOReplayOp *p_op;                              /* latencies of a kind of operation */
+  uint32_t op, k, nReported;                     /* kind of operation, counting variable and kinds reported */
+
+  for (op = 0, nReported = 0; op < TRACE_MAX; op++)
+  { p_op = &opStat[op];
+    if (p_op->nOps == 0) continue;
+    if (nReported++ != 0) fprintf (fo, ",\n");
+    qsort (p_op->lat, p_op->nOps, sizeof (uint64_t), cmpLatency);
+    fprintf (fo, "    {\"name\": \"%s\", \"ops\": %"PRIu32", \"errors\": %"PRIu32, soTraceOpName (op), p_op->nOps,
+             p_op->nErrors);
+    fprintf (fo, ", \"ops_per_s\": %.1f, \"mean_us\": %.3f",
+             (p_op->total != 0) ? 1e9 * (double) p_op->nOps / (double) p_op->total : 0.0,
+             (double) p_op->total / (1000.0 * (double) p_op->nOps));
+    for (k = 0; k < 3; k++)
+      fprintf (fo, ", \"p%"PRIu32"_us\": %.3f", pct[k],
+               (double) p_op->lat[((uint64_t) p_op->nOps * pct[k] + 99) / 100 - 1] / 1000.0);
+    fprintf (fo, ", \"max_us\": %.3f}", (double) p_op->lat[p_op->nOps-1] / 1000.0);
+    free (p_op->lat);
+    p_op->lat = NULL;
+  }
+}
+
+/*
+ *  Order of two latencies.
+ */
+
+static int cmpLatency (const void *a, const void *b)
+{
+  uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+  return (x > y) - (x < y);
+}
+
+/*
+ *  Print a string as a JSON string.
+ */
+
+static void printString (const char *str)
+{
+  fputc ('"', fo);
+  for (; *str != '\0'; str++)
+    if ((*str == '"') || (*str == '\\'))
+       fprintf (fo, "\\%c", *str);
+       else if ((unsigned char) *str < 0x20)
+               fprintf (fo, "\\u%04x", (unsigned int) (unsigned char) *str);
+               else fputc (*str, fo);
+  fputc ('"', fo);
+}
+
+/*
+ * print help message
+ */
+
+static void printUsage (char *cmd_name)
+{
+  printf ("Sinopsis: %s [OPTIONS] trace-file supp-file\n"
+          "  OPTIONS:\n"
+          "  -p       --- replay the operations at the pace they were recorded at (default: as fast as possible)\n"
+          "  -c size  --- set buffercache size in MiB (default: 25 clusters)\n"
+          "  -r name  --- set buffercache replacement policy: lru or 2q, with \",meta\" to give priority to the\n"
+          "               superblock and the table of inodes (default: lru)\n"
+          "  -e       --- describe the regular files created by trees of extents (default: lists of references)\n"
+          "  -g       --- allocate the data clusters from allocation groups through per-thread reservations\n"
+          "               (default: from the shared caches of the superblock)\n"
+          "  -n       --- store the contents of small files and symbolic links in their inodes (default: in data\n"
+          "               clusters)\n"
+          "  -z       --- compress the data clusters of the regular files created in groups (default: stored as\n"
+          "               they are)\n"
+          "  -m       --- map the storage device into memory (default: system calls)\n"
+          "  -u       --- submit batches of transfers through io_uring (default: synchronous transfers)\n"
+          "  -o file  --- write the report into file (default: stdout)\n"
+          "  -h       --- print this help\n", cmd_name);
+}
+
+/*
+ * print error message
+ */
+
+static void printError (int errcode, char *cmd_name)
+{
+  fprintf(stderr, "%s: error #%d - %s\n", cmd_name, -errcode,
+          soGetErrorMessage (-errcode));
+}
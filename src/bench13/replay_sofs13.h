@@ -0,0 +1,40 @@
+/**
+ *  \file replay_sofs13.h (interface file)
+ *
+ *  \brief The SOFS13 trace replaying tool.
+ *
+ *  It replays a trace of operations recorded by \e mount_sofs13 (option -t) directly through the system calls of the
+ *  file system on a storage device, in the order they were completed, either as fast as possible, or at the pace they
+ *  were recorded at, and reports, for each kind of operation, the number of operations and of errors, the throughput
+ *  and the mean, the percentiles 50, 90 and 99 and the maximum of the latency, in JSON, so that the results of runs on
+ *  successive versions of the file system, or with other options, may be compared.
+ *
+ *  When the operations of the trace address the files by the numbers of their inodes (the low-level frontend was
+ *  used), the path of each file is rebuilt from the entries looked up or created before, as recorded.
+ *
+ *  SINOPSIS:
+ *  <P><PRE>                replay_sofs13 [OPTIONS] trace-file supp-file
+ *
+ *                OPTIONS:
+ *                 -p       --- replay the operations at the pace they were recorded at (default: as fast as possible)
+ *                 -c size  --- set buffercache size in MiB (default: 25 clusters)
+ *                 -r name  --- set buffercache replacement policy: lru or 2q, with ",meta" to give priority to the
+ *                              superblock and the table of inodes (default: lru)
+ *                 -e       --- describe the regular files created by trees of extents (default: lists of references)
+ *                 -g       --- allocate the data clusters from allocation groups through per-thread reservations
+ *                              (default: from the shared caches of the superblock)
+ *                 -n       --- store the contents of small files and symbolic links in their inodes (default: in data
+ *                              clusters)
+ *                 -z       --- compress the data clusters of the regular files created in groups (default: stored as
+ *                              they are)
+ *                 -m       --- map the storage device into memory (default: system calls)
+ *                 -u       --- submit batches of transfers through io_uring (default: synchronous transfers)
+ *                 -o file  --- write the report into file (default: stdout)
+ *                 -h       --- print this help.</PRE>
+ *
+ *  \remarks The storage device is changed: it should be a copy of the storage device as it was when the trace was
+ *           started, so that the same files are found. The operations which have no counterpart among the system
+ *           calls (flush and fallocate) are skipped, and so are those whose file can not be found; an operation
+ *           whose outcome, success or failure, differs from the recorded one is counted as a mismatch. The layers of
+ *           \e mount_sofs13 itself (the delayed allocation and the open-file handles) are not replayed.
+ */
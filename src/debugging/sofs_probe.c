@@ -18,6 +18,11 @@
 #include <stdarg.h>
 #include <errno.h>
 
+#include "sofs_probe.h"
+
+#undef soProbe                                   /* the functions are defined here, not the macros */
+#undef soColorProbe
+
 /*
  *  Internal data structure
  */
@@ -25,9 +30,9 @@
 /** \brief Output stream */
 static FILE *flog = NULL;
 /** \brief Active probing depth: lower limit */
-static int soLowerDepth = -1;
+int soLowerDepth = -1;
 /** \brief Active probing depth: upper limit */
-static int soHigherDepth = -1;
+int soHigherDepth = -1;
 
 /**
  *  \brief Opening of the probing system.
@@ -9,6 +9,11 @@
  *  Upon writing the code, one should assign a depth to every probing message.
  *  Upon activating the probing system, one sets the range of depths that must be logged or displayed.
  *
+ *  The probing messages are issued through macros which check the active depth range in line, before the arguments
+ *  are evaluated, so that a message outside it costs a couple of comparisons. If the symbol \c SOFS_NO_PROBE is
+ *  defined at compile time (<em>make CPPFLAGS=-DSOFS_NO_PROBE</em>), the messages are compiled out altogether. The
+ *  functions themselves are still provided for code that is not compiled with this header.
+ *
  *  \author Artur Carneiro Pereira - September 2008
  *  \author Miguel Oliveira e Silva - September 2009
  *  \author António Rui Borges - July 2010
@@ -23,6 +28,14 @@
 
 #include <stdio.h>
 
+/** \brief Active probing depth: lower limit (-1, if the probing system is closed) */
+extern int soLowerDepth;
+/** \brief Active probing depth: upper limit (-1, if the probing system is closed) */
+extern int soHigherDepth;
+
+/** \brief check if a probing depth is within the active range */
+#define soProbeActive(depth)  (((depth) >= soLowerDepth) && ((depth) <= soHigherDepth))
+
 /**
  *  \brief Opening of the probing system.
  *
@@ -96,4 +109,12 @@ extern int soProbe (int depth, char *fmt, ...);
 
 extern int soColorProbe (int depth, char *color, char *fmt, ...);
 
+#ifdef SOFS_NO_PROBE
+#define soProbe(depth, ...)              ((void) 0)
+#define soColorProbe(depth, color, ...)  ((void) 0)
+#else
+#define soProbe(depth, ...)              (soProbeActive (depth) ? soProbe (depth, __VA_ARGS__) : 0)
+#define soColorProbe(depth, color, ...)  (soProbeActive (depth) ? soColorProbe (depth, color, __VA_ARGS__) : 0)
+#endif
+
 #endif /* SOFS_PROBE_H_ */
@@ -0,0 +1,377 @@
+/**
+ *  \file sofs_stats.c (implementation file)
+ *
+ *  \brief A toolkit of counters and latency histograms of operations.
+ *
+ *  The sets of statistics of the threads are kept in a list, which is only changed, and walked, in mutual exclusion.
+ *  A thread finds its own set through a thread-local pointer, so updates take no lock. When a thread terminates, its
+ *  set is released, but kept in the list with its values, to be taken over by the next thread which needs one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "sofs_stats.h"
+
+/*
+ *  Internal data structure
+ */
+
+/** \brief set of statistics of a thread */
+typedef struct soStatSet
+{
+  /** \brief number of times each operation was carried out (or value of each counter) */
+  uint64_t count[STAT_MAX];
+  /** \brief time spent in each operation, in nanoseconds */
+  uint64_t time[STAT_MAX];
+  /** \brief latency histogram of each operation */
+  uint64_t hist[STAT_MAX][STAT_BUCKETS];
+  /** \brief signals if the set belongs to a running thread */
+  bool owned;
+  /** \brief next set in the list */
+  struct soStatSet *next;
+} SOStatSet;
+
+/** \brief kind of a statistic */
+#define COUNTER  0
+#define TIMED    1
+
+/** \brief name and kind of the statistics */
+static const struct { const char *name; int kind; } statInfo[STAT_MAX] =
+       { {"raw.read", TIMED}, {"raw.write", TIMED}, {"raw.batch", TIMED}, {"raw.sync", TIMED},
+         {"raw.rdbytes", COUNTER}, {"raw.wrbytes", COUNTER},
+         {"bc.hit", COUNTER}, {"bc.miss", COUNTER}, {"bc.evict", COUNTER}, {"bc.wback", COUNTER},
+         {"sc.mount", TIMED}, {"sc.unmount", TIMED}, {"sc.statfs", TIMED}, {"sc.stat", TIMED},
+         {"sc.access", TIMED}, {"sc.chmod", TIMED}, {"sc.chown", TIMED}, {"sc.utime", TIMED},
+         {"sc.open", TIMED}, {"sc.close", TIMED}, {"sc.fsync", TIMED}, {"sc.opendir", TIMED},
+         {"sc.closedir", TIMED}, {"sc.link", TIMED}, {"sc.unlink", TIMED}, {"sc.rename", TIMED},
+         {"sc.mknod", TIMED}, {"sc.read", TIMED}, {"sc.write", TIMED}, {"sc.truncate", TIMED},
+         {"sc.mkdir", TIMED}, {"sc.rmdir", TIMED}, {"sc.readdir", TIMED}, {"sc.symlink", TIMED},
+         {"sc.readlink", TIMED},
+         {"fuse.init", TIMED}, {"fuse.destroy", TIMED}, {"fuse.statfs", TIMED}, {"fuse.getattr", TIMED},
+         {"fuse.access", TIMED}, {"fuse.utime", TIMED}, {"fuse.chmod", TIMED}, {"fuse.chown", TIMED},
+         {"fuse.mknod", TIMED}, {"fuse.open", TIMED}, {"fuse.read", TIMED}, {"fuse.write", TIMED},
+         {"fuse.flush", TIMED}, {"fuse.release", TIMED}, {"fuse.mkdir", TIMED}, {"fuse.rmdir", TIMED},
+         {"fuse.opendir", TIMED}, {"fuse.readdir", TIMED}, {"fuse.releasedir", TIMED}, {"fuse.link", TIMED},
+         {"fuse.unlink", TIMED}, {"fuse.rename", TIMED}, {"fuse.truncate", TIMED}, {"fuse.readlink", TIMED},
+         {"fuse.symlink", TIMED}, {"fuse.fsync", TIMED}, {"fuse.fsyncdir", TIMED}, {"fuse.setxattr", TIMED},
+         {"fuse.getxattr", TIMED}, {"fuse.listxattr", TIMED}, {"fuse.lookup", TIMED}, {"fuse.create", TIMED},
+         {"fuse.fallocate", TIMED}, {"fuse.ioctl", TIMED}
+       };
+
+/** \brief signals if the system is on */
+int soStatOn = 0;
+
+/** \brief list of sets of statistics */
+static SOStatSet *statList = NULL;
+/** \brief access lock to the list of sets of statistics */
+static pthread_mutex_t statCR = PTHREAD_MUTEX_INITIALIZER;
+/** \brief key whose destructor releases the set of a terminating thread */
+static pthread_key_t statKey;
+/** \brief control of the creation of the key */
+static pthread_once_t statOnce = PTHREAD_ONCE_INIT;
+/** \brief set of statistics of the calling thread */
+static __thread SOStatSet *mySet = NULL;
+
+/*
+ *  Allusion to internal functions
+ */
+
+static SOStatSet *getSet (void);
+static void releaseSet (void *p_set);
+static void createKey (void);
+static SOStatSet *sumSets (void);
+static double percentile (const uint64_t *hist, uint64_t count, uint32_t pc);
+
+/**
+ *  \brief Turn the system on or off.
+ *
+ *  \param on \c 0 (zero), to turn it off, any other value, to turn it on
+ */
+
+void soStatEnable (int on)
+{
+  soStatOn = (on != 0);
+}
+
+/**
+ *  \brief Read the clock the operations are timed with.
+ *
+ *  \return <em>time elapsed since some unspecified point in the past</em>, in nanoseconds (never zero)
+ */
+
+uint64_t soStatClock (void)
+{
+  struct timespec ts;                            /* current time */
+  uint64_t t;                                    /* current time in nanoseconds */
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  t = (uint64_t) ts.tv_sec * 1000000000 + (uint64_t) ts.tv_nsec;
+
+  return (t != 0) ? t : 1;                       /* zero stands for a timer which was not started */
+}
+
+/**
+ *  \brief Add to a counter.
+ *
+ *  \param id statistic
+ *  \param n value to be added
+ */
+
+void soStatCount (uint32_t id, uint64_t n)
+{
+  SOStatSet *p_set;                              /* set of statistics of the thread */
+
+  if ((id >= STAT_MAX) || ((p_set = getSet ()) == NULL)) return;
+  p_set->count[id] += n;
+}
+
+/**
+ *  \brief Record an operation which has just ended.
+ *
+ *  The counter is incremented and the latency is accounted for.
+ *
+ *  \param id statistic
+ *  \param t0 time when the operation started, as given by \e soStatClock
+ */
+
+void soStatRecord (uint32_t id, uint64_t t0)
+{
+  SOStatSet *p_set;                              /* set of statistics of the thread */
+  uint64_t d;                                    /* latency */
+  uint32_t k;                                    /* bucket */
+
+  if ((id >= STAT_MAX) || ((p_set = getSet ()) == NULL)) return;
+  d = soStatClock ();
+  d = (d > t0) ? d - t0 : 0;
+  k = (d == 0) ? 0 : 63 - (uint32_t) __builtin_clzll (d);
+  if (k >= STAT_BUCKETS) k = STAT_BUCKETS - 1;
+  p_set->count[id] += 1;
+  p_set->time[id] += d;
+  p_set->hist[id][k] += 1;
+}
+
+/**
+ *  \brief Record the operation timed by a timer, if it was started while the system was on.
+ *
+ *  \param p_tm pointer to the timer
+ */
+
+void soStatStop (SOStatTimer *p_tm)
+{
+  if (p_tm->t0 != 0)
+     soStatRecord (p_tm->id, p_tm->t0);
+}
+
+/**
+ *  \brief Reset the statistics.
+ *
+ *  Updates carried out concurrently may be lost.
+ */
+
+void soStatReset (void)
+{
+  SOStatSet *p_set;                              /* set of statistics */
+
+  pthread_mutex_lock (&statCR);
+  for (p_set = statList; p_set != NULL; p_set = p_set->next)
+  { memset (p_set->count, 0, sizeof (p_set->count));
+    memset (p_set->time, 0, sizeof (p_set->time));
+    memset (p_set->hist, 0, sizeof (p_set->hist));
+  }
+  pthread_mutex_unlock (&statCR);
+}
+
+/**
+ *  \brief Report the statistics in a buffer.
+ *
+ *  A line is issued for each statistic, with its name and count and, if it is timed, the total and mean time and an
+ *  upper bound of the percentiles 50, 90 and 99 of the latency, in microseconds. The lines have a fixed layout, so
+ *  that the length of the report does not change while the values fit in it.
+ *
+ *  As with \e snprintf, at most <tt>size - 1</tt> characters are stored and the report is NUL-terminated, if
+ *  \e size is not zero.
+ *
+ *  \param buf pointer to the buffer where the report is to be stored (it may be \c NULL, if \e size is zero)
+ *  \param size size of the buffer
+ *
+ *  \return <em>length of the whole report</em>, on success
+ *  \return -\c ENOMEM, if there is no memory to sum up the statistics
+ */
+
+int soStatReport (char *buf, size_t size)
+{
+  SOStatSet *p_sum;                              /* sum of the sets of statistics */
+  uint64_t n;                                    /* count of a statistic */
+  uint32_t id;                                   /* statistic */
+  size_t len;                                    /* length of the report */
+  int k;                                         /* length of a line */
+
+  if ((p_sum = sumSets ()) == NULL) return -ENOMEM;
+
+  k = snprintf (buf, size, "%-16s %14s %14s %12s %12s %12s %12s\n", "(times in us)", "count", "total", "mean",
+                "p50", "p90", "p99");
+  len = (k > 0) ? (size_t) k : 0;
+  for (id = 0; id < STAT_MAX; id++)
+  { n = p_sum->count[id];
+    if (statInfo[id].kind == COUNTER)
+       k = snprintf ((len < size) ? buf + len : NULL, (len < size) ? size - len : 0,
+                     "%-16s %14"PRIu64" %14s %12s %12s %12s %12s\n", statInfo[id].name, n, "-", "-", "-", "-", "-");
+       else k = snprintf ((len < size) ? buf + len : NULL, (len < size) ? size - len : 0,
+                          "%-16s %14"PRIu64" %14.1f %12.3f %12.3f %12.3f %12.3f\n", statInfo[id].name, n,
+                          (double) p_sum->time[id] / 1000.0,
+                          (n != 0) ? (double) p_sum->time[id] / (1000.0 * (double) n) : 0.0,
+                          percentile (p_sum->hist[id], n, 50), percentile (p_sum->hist[id], n, 90),
+                          percentile (p_sum->hist[id], n, 99));
+    if (k > 0) len += (size_t) k;
+  }
+  free (p_sum);
+
+  return (int) len;
+}
+
+/**
+ *  \brief Print the statistics.
+ *
+ *  The report is the same as the one of \e soStatReport.
+ *
+ *  \param fs the stream the statistics are to be printed on
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the stream is \c NULL
+ *  \return -\c ENOMEM, if there is no memory to sum up the statistics
+ */
+
+int soStatPrint (FILE *fs)
+{
+  char *buf;                                     /* report */
+  int len;                                       /* length of the report */
+
+  if (fs == NULL) return -EINVAL;
+  if ((len = soStatReport (NULL, 0)) < 0) return len;
+  if ((buf = malloc ((size_t) len + 1)) == NULL) return -ENOMEM;
+  if ((len = soStatReport (buf, (size_t) len + 1)) < 0)
+     { free (buf);
+       return len;
+     }
+  fputs (buf, fs);                               /* it may have been truncated, if the values grew meanwhile */
+  fflush (fs);
+  free (buf);
+
+  return 0;
+}
+
+/*
+ *  Internal functions
+ */
+
+/**
+ *  \brief Get the set of statistics of the calling thread.
+ *
+ *  A released set is taken over, if there is one; otherwise, a new one is allocated and added to the list.
+ *
+ *  \return <em>pointer to the set</em>, on success
+ *  \return \c NULL, if there is no memory for a new set
+ */
+
+static SOStatSet *getSet (void)
+{
+  SOStatSet *p_set;                              /* set of statistics */
+
+  if (mySet != NULL) return mySet;
+
+  pthread_once (&statOnce, createKey);
+  pthread_mutex_lock (&statCR);
+  for (p_set = statList; (p_set != NULL) && p_set->owned; p_set = p_set->next) ;
+  if ((p_set == NULL) && ((p_set = calloc (1, sizeof (SOStatSet))) != NULL))
+     { p_set->next = statList;
+       statList = p_set;
+     }
+  if (p_set != NULL)
+     p_set->owned = true;
+  pthread_mutex_unlock (&statCR);
+  if (p_set != NULL)
+     pthread_setspecific (statKey, p_set);
+  mySet = p_set;
+
+  return p_set;
+}
+
+/**
+ *  \brief Release the set of statistics of a terminating thread.
+ *
+ *  \param p_set pointer to the set
+ */
+
+static void releaseSet (void *p_set)
+{
+  pthread_mutex_lock (&statCR);
+  ((SOStatSet *) p_set)->owned = false;
+  pthread_mutex_unlock (&statCR);
+}
+
+/**
+ *  \brief Create the key whose destructor releases the set of a terminating thread.
+ */
+
+static void createKey (void)
+{
+  pthread_key_create (&statKey, releaseSet);
+}
+
+/**
+ *  \brief Sum up the sets of statistics.
+ *
+ *  \return <em>pointer to the sum</em>, which must be freed by the caller, on success
+ *  \return \c NULL, if there is no memory
+ */
+
+static SOStatSet *sumSets (void)
+{
+  SOStatSet *p_sum, *p_set;                      /* sum of the sets and set of statistics */
+  uint32_t id, k;                                /* statistic and bucket */
+
+  if ((p_sum = calloc (1, sizeof (SOStatSet))) == NULL) return NULL;
+
+  pthread_mutex_lock (&statCR);
+  for (p_set = statList; p_set != NULL; p_set = p_set->next)
+    for (id = 0; id < STAT_MAX; id++)
+    { p_sum->count[id] += p_set->count[id];
+      p_sum->time[id] += p_set->time[id];
+      for (k = 0; k < STAT_BUCKETS; k++)
+        p_sum->hist[id][k] += p_set->hist[id][k];
+    }
+  pthread_mutex_unlock (&statCR);
+
+  return p_sum;
+}
+
+/**
+ *  \brief Get an upper bound of a percentile of a latency histogram.
+ *
+ *  \param hist pointer to the histogram
+ *  \param count number of operations
+ *  \param pc percentile
+ *
+ *  \return <em>upper bound of the bucket where the percentile falls</em>, in microseconds
+ */
+
+static double percentile (const uint64_t *hist, uint64_t count, uint32_t pc)
+{
+  uint64_t seen, rank;                           /* operations accounted for and rank of the percentile */
+  uint32_t k;                                    /* bucket */
+
+  if (count == 0) return 0.0;
+  rank = (count * pc + 99) / 100;
+  seen = 0;
+  for (k = 0; k < STAT_BUCKETS - 1; k++)
+    if ((seen += hist[k]) >= rank) break;
+
+  return (double) ((uint64_t) 1 << (k + 1)) / 1000.0;
+}
@@ -0,0 +1,242 @@
+/**
+ *  \file sofs_stats.h (interface file)
+ *
+ *  \brief A toolkit of counters and latency histograms of operations.
+ *
+ *  Each kind of operation is identified by a statistic, which counts how many times it was carried out and, for timed
+ *  statistics, how long it took altogether and the distribution of its latency in a histogram of logarithmic buckets
+ *  (bucket \e k counts the operations which took between 2^k and 2^(k+1) nanoseconds). Each thread updates its own set
+ *  of statistics, so that no lock, nor atomic operation, is required; the sets are summed up when they are reported.
+ *  The set of a thread which terminates is taken over by the next thread which needs one.
+ *
+ *  The system may be turned on or off and it is off initially. The statistics are updated through macros which check
+ *  whether it is on in line, before the arguments are evaluated, and the clock is only read when it is on. If the
+ *  symbol \c SOFS_NO_STATS is defined at compile time (<em>make CPPFLAGS=-DSOFS_NO_STATS</em>), the updates are
+ *  compiled out altogether. The macros rely on the \e cleanup attribute and statement expressions of \e gcc.
+ *
+ *  The operations are:
+ *      \li turn the system on or off
+ *      \li add to a counter
+ *      \li time an operation, either for the rest of a block, or for a call
+ *      \li reset the statistics
+ *      \li report the statistics in a buffer, or print them.
+ */
+
+#ifndef SOFS_STATS_H_
+#define SOFS_STATS_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* raw I/O */
+
+/** \brief transfers from the storage device (timed) */
+#define STAT_RAW_READ         0
+/** \brief transfers to the storage device (timed) */
+#define STAT_RAW_WRITE        1
+/** \brief batches of transfers (timed) */
+#define STAT_RAW_BATCH        2
+/** \brief synchronizations of runs of blocks (timed) */
+#define STAT_RAW_SYNC         3
+/** \brief bytes read from the storage device */
+#define STAT_RAW_RDBYTES      4
+/** \brief bytes written to the storage device */
+#define STAT_RAW_WRBYTES      5
+
+/* buffercache */
+
+/** \brief accesses to blocks or clusters found in the storage area */
+#define STAT_BC_HIT           6
+/** \brief accesses to blocks or clusters not found in the storage area */
+#define STAT_BC_MISS          7
+/** \brief nodes replaced */
+#define STAT_BC_EVICT         8
+/** \brief nodes written back to the storage device */
+#define STAT_BC_WBACK         9
+
+/* syscalls layer (timed) */
+
+#define STAT_SC_MOUNT        10
+#define STAT_SC_UNMOUNT      11
+#define STAT_SC_STATFS       12
+#define STAT_SC_STAT         13
+#define STAT_SC_ACCESS       14
+#define STAT_SC_CHMOD        15
+#define STAT_SC_CHOWN        16
+#define STAT_SC_UTIME        17
+#define STAT_SC_OPEN         18
+#define STAT_SC_CLOSE        19
+#define STAT_SC_FSYNC        20
+#define STAT_SC_OPENDIR      21
+#define STAT_SC_CLOSEDIR     22
+#define STAT_SC_LINK         23
+#define STAT_SC_UNLINK       24
+#define STAT_SC_RENAME       25
+#define STAT_SC_MKNOD        26
+#define STAT_SC_READ         27
+#define STAT_SC_WRITE        28
+#define STAT_SC_TRUNCATE     29
+#define STAT_SC_MKDIR        30
+#define STAT_SC_RMDIR        31
+#define STAT_SC_READDIR      32
+#define STAT_SC_SYMLINK      33
+#define STAT_SC_READLINK     34
+
+/* FUSE callbacks (timed) */
+
+#define STAT_FUSE_INIT       35
+#define STAT_FUSE_DESTROY    36
+#define STAT_FUSE_STATFS     37
+#define STAT_FUSE_GETATTR    38
+#define STAT_FUSE_ACCESS     39
+#define STAT_FUSE_UTIME      40
+#define STAT_FUSE_CHMOD      41
+#define STAT_FUSE_CHOWN      42
+#define STAT_FUSE_MKNOD      43
+#define STAT_FUSE_OPEN       44
+#define STAT_FUSE_READ       45
+#define STAT_FUSE_WRITE      46
+#define STAT_FUSE_FLUSH      47
+#define STAT_FUSE_RELEASE    48
+#define STAT_FUSE_MKDIR      49
+#define STAT_FUSE_RMDIR      50
+#define STAT_FUSE_OPENDIR    51
+#define STAT_FUSE_READDIR    52
+#define STAT_FUSE_RELEASEDIR 53
+#define STAT_FUSE_LINK       54
+#define STAT_FUSE_UNLINK     55
+#define STAT_FUSE_RENAME     56
+#define STAT_FUSE_TRUNCATE   57
+#define STAT_FUSE_READLINK   58
+#define STAT_FUSE_SYMLINK    59
+#define STAT_FUSE_FSYNC      60
+#define STAT_FUSE_FSYNCDIR   61
+#define STAT_FUSE_SETXATTR   62
+#define STAT_FUSE_GETXATTR   63
+#define STAT_FUSE_LISTXATTR  64
+#define STAT_FUSE_LOOKUP     65
+#define STAT_FUSE_CREATE     66
+#define STAT_FUSE_FALLOCATE  67
+#define STAT_FUSE_IOCTL      68
+
+/** \brief number of statistics */
+#define STAT_MAX             69
+
+/** \brief number of buckets of a latency histogram */
+#define STAT_BUCKETS         32
+
+/** \brief timer of an operation */
+typedef struct soStatTimer
+{
+  /** \brief statistic */
+  uint32_t id;
+  /** \brief time when the operation started, in nanoseconds (zero, if the system was off) */
+  uint64_t t0;
+} SOStatTimer;
+
+/** \brief signals if the system is on */
+extern int soStatOn;
+
+/**
+ *  \brief Turn the system on or off.
+ *
+ *  \param on \c 0 (zero), to turn it off, any other value, to turn it on
+ */
+
+extern void soStatEnable (int on);
+
+/**
+ *  \brief Read the clock the operations are timed with.
+ *
+ *  \return <em>time elapsed since some unspecified point in the past</em>, in nanoseconds (never zero)
+ */
+
+extern uint64_t soStatClock (void);
+
+/**
+ *  \brief Add to a counter.
+ *
+ *  \param id statistic
+ *  \param n value to be added
+ */
+
+extern void soStatCount (uint32_t id, uint64_t n);
+
+/**
+ *  \brief Record an operation which has just ended.
+ *
+ *  The counter is incremented and the latency is accounted for.
+ *
+ *  \param id statistic
+ *  \param t0 time when the operation started, as given by \e soStatClock
+ */
+
+extern void soStatRecord (uint32_t id, uint64_t t0);
+
+/**
+ *  \brief Record the operation timed by a timer, if it was started while the system was on.
+ *
+ *  \param p_tm pointer to the timer
+ */
+
+extern void soStatStop (SOStatTimer *p_tm);
+
+/**
+ *  \brief Reset the statistics.
+ *
+ *  Updates carried out concurrently may be lost.
+ */
+
+extern void soStatReset (void);
+
+/**
+ *  \brief Report the statistics in a buffer.
+ *
+ *  A line is issued for each statistic, with its name and count and, if it is timed, the total and mean time and an
+ *  upper bound of the percentiles 50, 90 and 99 of the latency, in microseconds. The lines have a fixed layout, so
+ *  that the length of the report does not change while the values fit in it.
+ *
+ *  As with \e snprintf, at most <tt>size - 1</tt> characters are stored and the report is NUL-terminated, if
+ *  \e size is not zero.
+ *
+ *  \param buf pointer to the buffer where the report is to be stored (it may be \c NULL, if \e size is zero)
+ *  \param size size of the buffer
+ *
+ *  \return <em>length of the whole report</em>, on success
+ *  \return -\c ENOMEM, if there is no memory to sum up the statistics
+ */
+
+extern int soStatReport (char *buf, size_t size);
+
+/**
+ *  \brief Print the statistics.
+ *
+ *  The report is the same as the one of \e soStatReport.
+ *
+ *  \param fs the stream the statistics are to be printed on
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the stream is \c NULL
+ *  \return -\c ENOMEM, if there is no memory to sum up the statistics
+ */
+
+extern int soStatPrint (FILE *fs);
+
+#ifdef SOFS_NO_STATS
+#define soStatAdd(id, n)      ((void) sizeof (n))
+#define soStatScope(id)       ((void) 0)
+#define soStatCall(id, call)  (call)
+#else
+/** \brief add to a counter, if the system is on */
+#define soStatAdd(id, n)      (soStatOn ? soStatCount ((id), (n)) : (void) 0)
+/** \brief time the rest of the enclosing block */
+#define soStatScope(id)       SOStatTimer soStatTimer_ __attribute__ ((cleanup (soStatStop))) = \
+                                { (id), soStatOn ? soStatClock () : 0 }
+/** \brief time a call, the expression taking its value */
+#define soStatCall(id, call)  ({ uint64_t soStatT0_ = soStatOn ? soStatClock () : 0;                    \
+                                 __typeof__ (call) soStatVal_ = (call);                                  \
+                                 if (soStatT0_ != 0) soStatRecord ((id), soStatT0_);                     \
+                                 soStatVal_; })
+#endif
+
+#endif /* SOFS_STATS_H_ */
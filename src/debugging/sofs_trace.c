@@ -0,0 +1,356 @@
+/**
+ *  \file sofs_trace.c (implementation file)
+ *
+ *  \brief A toolkit to record traces of operations.
+ *
+ *  The ring buffer is addressed by two byte counters which only grow: the records are appended at the head and
+ *  written to the file from the tail. Appending takes a mutex for as long as a record is copied; the background thread
+ *  takes it only to learn the head and to move the tail, so the file is written with the mutex released, as the part
+ *  being written is not reused until the tail moves past it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "sofs_stats.h"
+#include "sofs_trace.h"
+
+/** \brief period of the writing of the ring buffer, in seconds */
+#define TRACE_PERIOD  1
+
+/*
+ *  Internal data structure
+ */
+
+/** \brief names of the kinds of operations */
+static const char *opName[TRACE_MAX] =
+       { "statfs", "getattr", "access", "utime", "chmod", "chown", "mknod", "create", "open", "read", "write", "flush",
+         "release", "mkdir", "rmdir", "opendir", "readdir", "releasedir", "link", "unlink", "rename", "truncate",
+         "readlink", "symlink", "fsync", "fsyncdir", "lookup", "fallocate"
+       };
+
+/** \brief signals if the system is on */
+int soTraceOn = 0;
+
+/** \brief stream the trace is written to */
+static FILE *traceFile = NULL;
+/** \brief header of the trace */
+static SOTraceHeader header;
+/** \brief ring buffer */
+static unsigned char *ring = NULL;
+/** \brief size of the ring buffer */
+static uint32_t ringSize = 0;
+/** \brief number of bytes appended to the ring buffer since the trace was started */
+static uint64_t head = 0;
+/** \brief number of bytes written to the file since the trace was started */
+static uint64_t tail = 0;
+/** \brief time when the trace was started, as given by soStatClock */
+static uint64_t t0 = 0;
+/** \brief signals if records are being appended */
+static bool running = false;
+/** \brief signals if the background thread is to write what is left and terminate */
+static bool stopping = false;
+/** \brief signals if writing the file failed */
+static bool ioError = false;
+/** \brief access lock to the ring buffer */
+static pthread_mutex_t traceCR = PTHREAD_MUTEX_INITIALIZER;
+/** \brief condition the background thread waits on */
+static pthread_cond_t traceCond = PTHREAD_COND_INITIALIZER;
+/** \brief background thread */
+static pthread_t writer;
+
+/*
+ *  Allusion to internal functions
+ */
+
+static void put (const void *src, size_t n);
+static void *writeRing (void *arg);
+static void writeRange (uint64_t from, uint64_t to);
+
+/**
+ *  \brief Start the trace.
+ *
+ *  The header is written and the background thread is started. The system is turned on.
+ *
+ *  \param ft the stream the trace is to be written to (it is closed when the trace is stopped)
+ *  \param size size of the ring buffer in bytes
+ *  \param byInode signals if the operations address the files by the numbers of their inodes
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the stream is \c NULL or the ring buffer can not hold a record with the longest names
+ *  \return -\c EBUSY, if the trace is already started
+ *  \return -\c ENOMEM, if there is no memory for the ring buffer
+ *  \return -\c EIO, if the header can not be written
+ *  \return -<em>other specific error</em> issued by \e pthread_create
+ */
+
+int soTraceStart (FILE *ft, uint32_t size, bool byInode)
+{
+  int stat;                                      /* status of operation */
+
+  if ((ft == NULL) || (size < 2 * (sizeof (SOTraceRecord) + 2 * TRACE_MAX_NAME))) return -EINVAL;
+
+  pthread_mutex_lock (&traceCR);
+  if (running)
+     { pthread_mutex_unlock (&traceCR);
+       return -EBUSY;
+     }
+  if ((ring = malloc (size)) == NULL)
+     { pthread_mutex_unlock (&traceCR);
+       return -ENOMEM;
+     }
+  memset (&header, 0, sizeof (header));
+  header.magic = TRACE_MAGIC;
+  header.version = TRACE_VERSION;
+  header.byinode = byInode ? 1 : 0;
+  header.start = (uint64_t) time (NULL);
+  stat = (fwrite (&header, sizeof (header), 1, ft) == 1) ? 0 : -EIO;
+  if (stat == 0)
+     { traceFile = ft;
+       ringSize = size;
+       head = tail = 0;
+       t0 = soStatClock ();
+       running = true;
+       stopping = ioError = false;
+       stat = -pthread_create (&writer, NULL, writeRing, NULL);
+     }
+  if (stat == 0)
+     soTraceOn = 1;
+     else { running = false;
+            traceFile = NULL;
+            free (ring);
+            ring = NULL;
+          }
+  pthread_mutex_unlock (&traceCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Stop the trace.
+ *
+ *  The system is turned off, the records still in the ring buffer are written, the header is written again with the
+ *  number of records and the stream is closed. Nothing is done if the trace is not started.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EIO, if the trace could not be written
+ */
+
+int soTraceStop (void)
+{
+  pthread_mutex_lock (&traceCR);
+  if (!running)
+     { pthread_mutex_unlock (&traceCR);
+       return 0;
+     }
+  soTraceOn = 0;
+  running = false;
+  stopping = true;
+  pthread_cond_signal (&traceCond);
+  pthread_mutex_unlock (&traceCR);
+  pthread_join (writer, NULL);
+
+  /* the header is not written again, if the stream can not be repositioned: the trace is then read to its end */
+
+  if ((fflush (traceFile) == 0) && (fseek (traceFile, 0, SEEK_SET) == 0) &&
+      (fwrite (&header, sizeof (header), 1, traceFile) != 1))
+     ioError = true;
+  if (fclose (traceFile) != 0)
+     ioError = true;
+  traceFile = NULL;
+  free (ring);
+  ring = NULL;
+  stopping = false;
+
+  return ioError ? -EIO : 0;
+}
+
+/**
+ *  \brief Append a record.
+ *
+ *  \param op kind of operation
+ *  \param nInode number of the inode addressed
+ *  \param nInode2 number of the inode of the entry, or of the new directory
+ *  \param name first name (it may be \c NULL)
+ *  \param name2 second name (it may be \c NULL)
+ *  \param offset first numeric argument
+ *  \param size second numeric argument
+ *  \param mode permissions or flags
+ *  \param result result of the operation
+ */
+
+void soTraceAppend (uint32_t op, uint32_t nInode, uint32_t nInode2, const char *name, const char *name2,
+                    uint64_t offset, uint64_t size, uint32_t mode, int32_t result)
+{
+  SOTraceRecord rec;                             /* record */
+  size_t len, len2;                              /* lengths of the names */
+
+  len = (name != NULL) ? strnlen (name, TRACE_MAX_NAME) : 0;
+  len2 = (name2 != NULL) ? strnlen (name2, TRACE_MAX_NAME) : 0;
+  memset (&rec, 0, sizeof (rec));
+  rec.offset = offset;
+  rec.size = size;
+  rec.inode = nInode;
+  rec.inode2 = nInode2;
+  rec.mode = mode;
+  rec.result = result;
+  rec.op = (uint16_t) op;
+  rec.len = (uint16_t) len;
+  rec.len2 = (uint16_t) len2;
+
+  pthread_mutex_lock (&traceCR);
+  if (!running)
+     { pthread_mutex_unlock (&traceCR);
+       return;
+     }
+  if (head - tail + sizeof (rec) + len + len2 > ringSize)
+     { header.dropped += 1;
+       pthread_mutex_unlock (&traceCR);
+       return;
+     }
+  rec.time = soStatClock () - t0;                /* read with the lock held, so that the times never decrease */
+  put (&rec, sizeof (rec));
+  put (name, len);
+  put (name2, len2);
+  header.records += 1;
+  if (head - tail > ringSize / 2)
+     pthread_cond_signal (&traceCond);
+  pthread_mutex_unlock (&traceCR);
+}
+
+/**
+ *  \brief Read the header of a trace.
+ *
+ *  \param ft the stream the trace is read from
+ *  \param p_hdr pointer to the header
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if any of the pointers is \c NULL
+ *  \return -\c EIO, if the header can not be read
+ *  \return -\c EILSEQ, if the stream does not hold a trace of this version
+ */
+
+int soTraceReadHeader (FILE *ft, SOTraceHeader *p_hdr)
+{
+  if ((ft == NULL) || (p_hdr == NULL)) return -EINVAL;
+  if (fread (p_hdr, sizeof (SOTraceHeader), 1, ft) != 1) return -EIO;
+  if ((p_hdr->magic != TRACE_MAGIC) || (p_hdr->version != TRACE_VERSION)) return -EILSEQ;
+
+  return 0;
+}
+
+/**
+ *  \brief Read the next record of a trace.
+ *
+ *  The names are stored NUL-terminated (they are empty, if not given).
+ *
+ *  \param ft the stream the trace is read from
+ *  \param p_rec pointer to the record
+ *  \param name pointer to a buffer of <tt>TRACE_MAX_NAME + 1</tt> characters where the first name is to be stored
+ *  \param name2 pointer to a buffer of <tt>TRACE_MAX_NAME + 1</tt> characters where the second name is to be stored
+ *
+ *  \return \c 1, if a record was read
+ *  \return <tt>0 (zero)</tt>, at the end of the trace
+ *  \return -\c EINVAL, if any of the pointers is \c NULL
+ *  \return -\c EILSEQ, if the record is cut or malformed
+ */
+
+int soTraceReadRecord (FILE *ft, SOTraceRecord *p_rec, char *name, char *name2)
+{
+  size_t n;                                      /* number of bytes read */
+
+  if ((ft == NULL) || (p_rec == NULL) || (name == NULL) || (name2 == NULL)) return -EINVAL;
+  if ((n = fread (p_rec, 1, sizeof (SOTraceRecord), ft)) == 0) return 0;
+  if ((n != sizeof (SOTraceRecord)) || (p_rec->op >= TRACE_MAX) || (p_rec->len > TRACE_MAX_NAME) ||
+      (p_rec->len2 > TRACE_MAX_NAME))
+     return -EILSEQ;
+  if ((fread (name, 1, p_rec->len, ft) != p_rec->len) || (fread (name2, 1, p_rec->len2, ft) != p_rec->len2))
+     return -EILSEQ;
+  name[p_rec->len] = '\0';
+  name2[p_rec->len2] = '\0';
+
+  return 1;
+}
+
+/**
+ *  \brief Get the name of a kind of operation.
+ *
+ *  \param op kind of operation
+ *
+ *  \return the name, or \c "unknown", if the kind is out of range
+ */
+
+const char *soTraceOpName (uint32_t op)
+{
+  return (op < TRACE_MAX) ? opName[op] : "unknown";
+}
+
+/*
+ *  Internal functions
+ */
+
+/*
+ *  Copy bytes to the head of the ring buffer (the lock is supposed to be held and there is supposed to be room).
+ */
+
+static void put (const void *src, size_t n)
+{
+  size_t pos, n1;                                /* position of the head and number of bytes up to the end */
+
+  if (n == 0) return;
+  pos = (size_t) (head % ringSize);
+  n1 = (n < ringSize - pos) ? n : ringSize - pos;
+  memcpy (ring + pos, src, n1);
+  memcpy (ring, (const unsigned char *) src + n1, n - n1);
+  head += n;
+}
+
+/*
+ *  Write the ring buffer to the file, periodically, or when it is half full, until the trace is stopped.
+ */
+
+static void *writeRing (void *arg)
+{
+  struct timespec ts;                            /* time the wait ends */
+  uint64_t to;                                   /* head when the writing started */
+
+  pthread_mutex_lock (&traceCR);
+  while (true)
+  { if (!stopping && (head - tail <= ringSize / 2))
+       { clock_gettime (CLOCK_REALTIME, &ts);
+         ts.tv_sec += TRACE_PERIOD;
+         pthread_cond_timedwait (&traceCond, &traceCR, &ts);
+       }
+    to = head;
+    pthread_mutex_unlock (&traceCR);
+    writeRange (tail, to);                       /* only this thread moves the tail */
+    pthread_mutex_lock (&traceCR);
+    tail = to;
+    if (stopping && (tail == head)) break;
+  }
+  pthread_mutex_unlock (&traceCR);
+
+  return NULL;
+}
+
+/*
+ *  Write a part of the ring buffer to the file.
+ */
+
+static void writeRange (uint64_t from, uint64_t to)
+{
+  size_t pos, n, n1;                             /* position of the tail, number of bytes and bytes up to the end */
+
+  if (to == from) return;
+  pos = (size_t) (from % ringSize);
+  n = (size_t) (to - from);
+  n1 = (n < ringSize - pos) ? n : ringSize - pos;
+  if ((fwrite (ring + pos, 1, n1, traceFile) != n1) || (fwrite (ring, 1, n - n1, traceFile) != n - n1))
+     ioError = true;
+}
@@ -0,0 +1,248 @@
+/**
+ *  \file sofs_trace.h (interface file)
+ *
+ *  \brief A toolkit to record traces of operations.
+ *
+ *  A trace is a binary file which holds a header and a record for each operation carried out, in the order they were
+ *  completed: the kind of operation, the time when it was completed, in nanoseconds since the trace was started, its
+ *  arguments and its result. A record is followed by up to two names, which are not NUL-terminated.
+ *
+ *  The records are appended to a ring buffer in memory, which is written to the file by a background thread, either
+ *  periodically, or as soon as it is half full, so that the operations never wait for the file to be written. If the
+ *  ring buffer is full, the record is dropped and counted as such.
+ *
+ *  The operations address the files either by their paths, or by the numbers of their inodes, as told in the header.
+ *  In the former case, the first name is the path of the file and the second one, if any, the new path (rename and
+ *  link) or the contents of the symbolic link (symlink). In the latter case, \e inode is the number of the inode of
+ *  the file or, for the operations which change the contents of a directory, of the directory, and the first name is
+ *  the name of the entry; \e inode2 is the number of the inode of the entry looked up or created, or, for rename and
+ *  link, of the new directory, the second name being then the name of the new entry.
+ *
+ *  The other arguments are kept, according to the operation:
+ *      \li \e offset and \e size, the position and the number of bytes (read, write, readdir, readlink and
+ *          fallocate), or the length of the file (truncate)
+ *      \li \e mode, the permissions (mknod, mkdir, chmod, create and access), or the flags of opening (open)
+ *      \li \e offset and \e size, the user and group ID (chown), or the times of last access and modification
+ *          (utime, \e mode telling whether they were given, rather than set to the current time)
+ *      \li \e offset, the flags of opening (create).
+ *
+ *  The system is off initially. Records are appended through a macro which checks whether it is on in line, before
+ *  the arguments are evaluated. If the symbol \c SOFS_NO_TRACE is defined at compile time, the appends are compiled
+ *  out altogether.
+ *
+ *  The operations are:
+ *      \li start the trace
+ *      \li stop the trace
+ *      \li append a record
+ *      \li read the header of a trace
+ *      \li read the next record of a trace
+ *      \li get the name of a kind of operation.
+ */
+
+#ifndef SOFS_TRACE_H_
+#define SOFS_TRACE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/** \brief magic number of the header of a trace */
+#define TRACE_MAGIC     (0x534F5452)
+/** \brief version of the layout of a trace */
+#define TRACE_VERSION   1
+/** \brief default size of the ring buffer in bytes */
+#define TRACE_RING      (4 * 1024 * 1024)
+/** \brief maximum length of a name (longer names are cut) */
+#define TRACE_MAX_NAME  1023
+/** \brief number of an inode which is not given */
+#define TRACE_NO_INODE  (UINT32_MAX)
+
+/* kinds of operations */
+
+#define TRACE_STATFS      0
+#define TRACE_GETATTR     1
+#define TRACE_ACCESS      2
+#define TRACE_UTIME       3
+#define TRACE_CHMOD       4
+#define TRACE_CHOWN       5
+#define TRACE_MKNOD       6
+#define TRACE_CREATE      7
+#define TRACE_OPEN        8
+#define TRACE_READ        9
+#define TRACE_WRITE      10
+#define TRACE_FLUSH      11
+#define TRACE_RELEASE    12
+#define TRACE_MKDIR      13
+#define TRACE_RMDIR      14
+#define TRACE_OPENDIR    15
+#define TRACE_READDIR    16
+#define TRACE_RELEASEDIR 17
+#define TRACE_LINK       18
+#define TRACE_UNLINK     19
+#define TRACE_RENAME     20
+#define TRACE_TRUNCATE   21
+#define TRACE_READLINK   22
+#define TRACE_SYMLINK    23
+#define TRACE_FSYNC      24
+#define TRACE_FSYNCDIR   25
+#define TRACE_LOOKUP     26
+#define TRACE_FALLOCATE  27
+
+/** \brief number of kinds of operations */
+#define TRACE_MAX        28
+
+/**
+ *  \brief Definition of the header of a trace.
+ */
+
+typedef struct soTraceHeader
+{
+  /** \brief magic number (should be TRACE_MAGIC macro value) */
+  uint32_t magic;
+  /** \brief version of the layout (should be TRACE_VERSION macro value) */
+  uint32_t version;
+  /** \brief signals if the operations address the files by the numbers of their inodes */
+  uint32_t byinode;
+  /** \brief reserved area */
+  uint32_t reserved;
+  /** \brief time when the trace was started, in seconds since the Epoch */
+  uint64_t start;
+  /** \brief number of records written (zero, if the trace was not stopped) */
+  uint64_t records;
+  /** \brief number of records dropped because the ring buffer was full */
+  uint64_t dropped;
+} SOTraceHeader;
+
+/**
+ *  \brief Definition of a record of a trace.
+ */
+
+typedef struct soTraceRecord
+{
+  /** \brief time when the operation was completed, in nanoseconds since the trace was started */
+  uint64_t time;
+  /** \brief first numeric argument */
+  uint64_t offset;
+  /** \brief second numeric argument */
+  uint64_t size;
+  /** \brief number of the inode addressed (TRACE_NO_INODE, if the files are addressed by their paths) */
+  uint32_t inode;
+  /** \brief number of the inode of the entry, or of the new directory (TRACE_NO_INODE, if none) */
+  uint32_t inode2;
+  /** \brief permissions or flags */
+  uint32_t mode;
+  /** \brief result (a negative value is the symmetric of the system error) */
+  int32_t result;
+  /** \brief kind of operation */
+  uint16_t op;
+  /** \brief length of the first name */
+  uint16_t len;
+  /** \brief length of the second name */
+  uint16_t len2;
+  /** \brief reserved area */
+  uint16_t reserved;
+} SOTraceRecord;
+
+/** \brief signals if the system is on */
+extern int soTraceOn;
+
+/**
+ *  \brief Start the trace.
+ *
+ *  The header is written and the background thread is started. The system is turned on.
+ *
+ *  \param ft the stream the trace is to be written to (it is closed when the trace is stopped)
+ *  \param size size of the ring buffer in bytes
+ *  \param byInode signals if the operations address the files by the numbers of their inodes
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the stream is \c NULL or the ring buffer can not hold a record with the longest names
+ *  \return -\c EBUSY, if the trace is already started
+ *  \return -\c ENOMEM, if there is no memory for the ring buffer
+ *  \return -\c EIO, if the header can not be written
+ *  \return -<em>other specific error</em> issued by \e pthread_create
+ */
+
+extern int soTraceStart (FILE *ft, uint32_t size, bool byInode);
+
+/**
+ *  \brief Stop the trace.
+ *
+ *  The system is turned off, the records still in the ring buffer are written, the header is written again with the
+ *  number of records and the stream is closed. Nothing is done if the trace is not started.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EIO, if the trace could not be written
+ */
+
+extern int soTraceStop (void);
+
+/**
+ *  \brief Append a record.
+ *
+ *  \param op kind of operation
+ *  \param nInode number of the inode addressed
+ *  \param nInode2 number of the inode of the entry, or of the new directory
+ *  \param name first name (it may be \c NULL)
+ *  \param name2 second name (it may be \c NULL)
+ *  \param offset first numeric argument
+ *  \param size second numeric argument
+ *  \param mode permissions or flags
+ *  \param result result of the operation
+ */
+
+extern void soTraceAppend (uint32_t op, uint32_t nInode, uint32_t nInode2, const char *name, const char *name2,
+                           uint64_t offset, uint64_t size, uint32_t mode, int32_t result);
+
+/**
+ *  \brief Read the header of a trace.
+ *
+ *  \param ft the stream the trace is read from
+ *  \param p_hdr pointer to the header
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if any of the pointers is \c NULL
+ *  \return -\c EIO, if the header can not be read
+ *  \return -\c EILSEQ, if the stream does not hold a trace of this version
+ */
+
+extern int soTraceReadHeader (FILE *ft, SOTraceHeader *p_hdr);
+
+/**
+ *  \brief Read the next record of a trace.
+ *
+ *  The names are stored NUL-terminated (they are empty, if not given).
+ *
+ *  \param ft the stream the trace is read from
+ *  \param p_rec pointer to the record
+ *  \param name pointer to a buffer of <tt>TRACE_MAX_NAME + 1</tt> characters where the first name is to be stored
+ *  \param name2 pointer to a buffer of <tt>TRACE_MAX_NAME + 1</tt> characters where the second name is to be stored
+ *
+ *  \return \c 1, if a record was read
+ *  \return <tt>0 (zero)</tt>, at the end of the trace
+ *  \return -\c EINVAL, if any of the pointers is \c NULL
+ *  \return -\c EILSEQ, if the record is cut or malformed
+ */
+
+extern int soTraceReadRecord (FILE *ft, SOTraceRecord *p_rec, char *name, char *name2);
+
+/**
+ *  \brief Get the name of a kind of operation.
+ *
+ *  \param op kind of operation
+ *
+ *  \return the name, or \c "unknown", if the kind is out of range
+ */
+
+extern const char *soTraceOpName (uint32_t op);
+
+#ifdef SOFS_NO_TRACE
+#define soTrace(op, nInode, nInode2, name, name2, offset, size, mode, result)  ((void) 0)
+#else
+/** \brief append a record, if the system is on */
+#define soTrace(op, nInode, nInode2, name, name2, offset, size, mode, result)                                  \
+        (soTraceOn ? soTraceAppend ((op), (nInode), (nInode2), (name), (name2), (uint64_t) (offset),           \
+                                    (uint64_t) (size), (uint32_t) (mode), (int32_t) (result)) : (void) 0)
+#endif
+
+#endif /* SOFS_TRACE_H_ */
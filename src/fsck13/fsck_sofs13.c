@@ -0,0 +1,834 @@
+/**
+ *  \file fsck_sofs13.c (implementation file)
+ *
+ *  \brief The SOFS13 file system consistency checking tool.
+ *
+ *  It checks the consistency of the whole file system metadata stored in the storage device, without changing it.
+ *  After the quick checks of the superblock and of the related structures, the table of inodes, the mapping table
+ *  cluster-to-inode and the bitmap table to free data clusters are read sequentially into memory and the inodes are
+ *  split among several threads, which check them and their lists of references and the contents of the directories.
+ *  The ownership of the data clusters found is recorded in bitsets and cross-checked against the tables at the end.
+ *
+ *  The following checks are made:
+ *     \li quick check of the superblock, the table of inodes and the data zone metadata
+ *     \li consistency of every inode, either in use, or free in the clean or in the dirty state
+ *     \li the data clusters referenced by an inode are legal, referenced only once, mapped to the inode in the
+ *         mapping table cluster-to-inode and allocated or freed, according to the inode status
+ *     \li the <tt>clucount</tt> field of every inode matches its lists of references
+ *     \li the tree of extents of every regular file described by one is sorted, its extents do not overlap and lie
+ *         within the bounds set by the upper levels, and its nodes are accounted for as the clusters of references
+ *     \li every inode storing its contents is a regular file or a symbolic link in use, with no data clusters and
+ *         zeros past its size
+ *     \li the entries of every directory are legal, the first two being "." and ".."
+ *     \li the <tt>refcount</tt> field of every inode in use matches the number of directory entries which refer to it
+ *         and every directory but the root is referred to by a single entry of its parent
+ *     \li every allocated data cluster is referenced by an inode and every free data cluster is either clean or mapped
+ *         to a free inode in the dirty state
+ *     \li the number of free inodes in the table of inodes matches the superblock.
+ *
+ *  SINOPSIS:
+ *  <P><PRE>                fsck_sofs13 [OPTIONS] supp-file
+ *
+ *                OPTIONS:
+ *                 -t num  --- set number of threads which check the inodes (default: number of processors, at most 16)
+ *                 -q      --- set quiet mode (default: not quiet)
+ *                 -h      --- print this help.</PRE>
+ *
+ *  \remarks The file system must not be mounted while it is checked. The exit status is \c EXIT_SUCCESS only if no
+ *           inconsistency was found.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "sofs_const.h"
+#include "sofs_buffercache.h"
+#include "sofs_rawdisk.h"
+#include "sofs_superblock.h"
+#include "sofs_inode.h"
+#include "sofs_direntry.h"
+#include "sofs_datacluster.h"
+#include "sofs_basicoper.h"
+#include "sofs_basicconsist.h"
+#include "sofs_extent.h"
+
+/** \brief number of blocks of a table read at a time */
+#define FSCK_CHUNK    2048
+/** \brief maximum number of threads which check the inodes concurrently */
+#define FSCK_THREADS  16
+/** \brief number of successive inodes taken at a time by a thread */
+#define FSCK_BATCH    64
+
+/*
+ *  Internal data structure
+ */
+
+/** \brief copy of the superblock */
+static SOSuperBlock sb;
+/** \brief copy of the table of inodes */
+static SOInode *inT = NULL;
+/** \brief copy of the mapping table cluster-to-inode */
+static uint32_t *ciuT = NULL;
+/** \brief bitset of the free data clusters (either in the bitmap table or in one of the caches) */
+static uint32_t *freeC = NULL;
+/** \brief bitset of the data clusters referenced by some inode */
+static uint32_t *seenC = NULL;
+/** \brief number of directory entries which refer to each inode */
+static uint32_t *links = NULL;
+/** \brief number of directory entries, other than "." and "..", which refer to each directory */
+static uint32_t *parents = NULL;
+/** \brief number of the next inode to be taken by a thread */
+static uint32_t nextInode = 0;
+/** \brief number of inconsistencies found */
+static uint32_t nErrors = 0;
+/** \brief quiet mode */
+static int quiet = 0;
+/** \brief signals if a progress message was printed without a newline */
+static bool pending = false;
+/** \brief access lock to the report of inconsistencies */
+static pthread_mutex_t reportCR = PTHREAD_MUTEX_INITIALIZER;
+
+/* Allusion to internal functions */
+
+static int loadTables (void);
+static int readTable (uint32_t start, uint32_t size, void *buf);
+static void checkInodes (uint32_t nThreads);
+static void *checkRange (void *arg);
+static void checkInode (uint32_t nInode, SODataClust *clt);
+static void checkRefs (uint32_t nInode, SOInode *p_inode, SODataClust *clt);
+static void checkInline (uint32_t nInode, SOInode *p_inode);
+static void checkExtents (uint32_t nInode, SOInode *p_inode);
+static void checkExtNode (uint32_t nInode, bool inUse, const SOExtent *ent, uint32_t cnt, uint32_t depth,
+                          uint32_t lower, uint32_t upper, uint32_t *p_next, uint32_t *p_count);
+static bool checkClust (uint32_t nInode, bool inUse, bool isData, uint32_t nClust);
+static void checkDirClust (uint32_t nInode, uint32_t clustInd, uint32_t nClust, SODataClust *p_clt);
+static int readClust (uint32_t nClust, SODataClust *p_clt);
+static void checkClusters (void);
+static void checkLinks (void);
+static bool testBit (uint32_t *set, uint32_t n);
+static bool setBit (uint32_t *set, uint32_t n);
+static void report (int code, const char *fmt, ...);
+static void printUsage (char *cmd_name);
+static void printError (int errcode, char *cmd_name);
+
+/* The main function */
+
+int main (int argc, char *argv[])
+{
+  long ncpu = sysconf (_SC_NPROCESSORS_ONLN);    /* number of processors */
+  uint32_t nThreads;                             /* number of threads which check the inodes */
+
+  nThreads = (ncpu < 1) ? 1 : ((ncpu > FSCK_THREADS) ? FSCK_THREADS : (uint32_t) ncpu);
+
+  /* process command line options */
+
+  int opt;                                       /* selected option */
+
+  do
+  { switch ((opt = getopt (argc, argv, "t:qh")))
+    { case 't': /* number of threads */
+                if ((atoi (optarg) <= 0) || (atoi (optarg) > FSCK_THREADS))
+                   { fprintf (stderr, "%s: Bad number of threads.\n", basename (argv[0]));
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                nThreads = (uint32_t) atoi (optarg);
+                break;
+      case 'q': /* quiet mode */
+                quiet = 1;                       /* set quiet mode for processing: no messages are issued */
+                break;
+      case 'h': /* help mode */
+                printUsage (basename (argv[0]));
+                return EXIT_SUCCESS;
+      case -1:  break;
+      default:  fprintf (stderr, "%s: Wrong option.\n", basename (argv[0]));
+                printUsage (basename (argv[0]));
+                return EXIT_FAILURE;
+    }
+  } while (opt != -1);
+  if ((argc - optind) != 1)                      /* check existence of mandatory argument: storage device name */
+     { fprintf (stderr, "%s: Wrong number of mandatory arguments.\n", basename (argv[0]));
+       printUsage (basename (argv[0]));
+       return EXIT_FAILURE;
+     }
+
+  /* check for storage device conformity */
+
+  char *devname;                                 /* path to the storage device in the Linux file system */
+  struct stat st;                                /* file attributes */
+
+  devname = argv[optind];
+  if (stat (devname, &st) == -1)                 /* get file attributes */
+     { printError (-errno, basename (argv[0]));
+       return EXIT_FAILURE;
+     }
+  if (st.st_size % BLOCK_SIZE != 0)              /* check file size: the storage device must have a size in bytes
+                                                    multiple of block size */
+     { fprintf (stderr, "%s: Bad size of support file.\n", basename (argv[0]));
+       return EXIT_FAILURE;
+     }
+
+  /* checking of the file system is going to start */
+
+  int status;                                    /* status of operation */
+
+  if (!quiet)
+     printf("\e[34mChecking the SOFS13 file system in %s.\e[0m\n", devname);
+
+  /* open a buffered communication channel with the storage device */
+
+  if ((status = soOpenBufferCache (devname, BUF)) != 0)
+     { printError (status, basename (argv[0]));
+       return EXIT_FAILURE;
+     }
+
+  /* quick check of the superblock and of the related structures: the remaining checks rely on them */
+
+  if (!quiet)
+     { printf ("Checking the superblock, the table of inodes and the data zone metadata ... ");
+       fflush (stdout);
+     }
+  if (((status = soLoadSuperBlock ()) != 0) || ((status = soQCheckSuperBlock (soGetSuperBlock ())) != 0))
+     { if (!quiet) printf ("\n");
+       printError (status, basename (argv[0]));
+       soCloseBufferCache ();
+       return EXIT_FAILURE;
+     }
+  sb = *soGetSuperBlock ();
+  if (!quiet) printf ("done.\n");
+  if (!quiet && (sb.mstat != PRU))
+     printf ("The file system was not properly unmounted.\n");
+
+  /* read the tables into memory */
+
+  if (!quiet)
+     { printf ("Reading the tables of inodes, cluster-to-inode mapping and free data clusters ... ");
+       fflush (stdout);
+     }
+  if ((status = loadTables ()) != 0)
+     { if (!quiet) printf ("\n");
+       printError (status, basename (argv[0]));
+       soCloseBufferCache ();
+       return EXIT_FAILURE;
+     }
+  if (!quiet) printf ("done.\n");
+
+  /* check the inodes, their lists of references and the contents of the directories */
+
+  if (!quiet)
+     { printf ("Checking the inodes and the directories with %"PRIu32" threads ... ", nThreads);
+       fflush (stdout);
+       pending = true;
+     }
+  checkInodes (nThreads);
+  if (!quiet) printf ("%s", pending ? "done.\n" : "");
+
+  /* cross-check the ownership of the data clusters and the references to the inodes */
+
+  if (!quiet)
+     { printf ("Cross-checking the data clusters and the references to the inodes ... ");
+       fflush (stdout);
+       pending = true;
+     }
+  checkClusters ();
+  checkLinks ();
+  if (!quiet) printf ("%s", pending ? "done.\n" : "");
+  pending = false;
+
+  /* close the buffered communication channel with the storage device */
+
+  if ((status = soCloseBufferCache ()) != 0)
+     { printError (status, basename (argv[0]));
+       return EXIT_FAILURE;
+     }
+
+  /* that's all */
+
+  if (!quiet)
+     { if (nErrors == 0)
+          printf ("The file system is consistent.\n");
+          else printf ("%"PRIu32" inconsistencies were found.\n", nErrors);
+     }
+
+  return (nErrors == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+} /* end of main */
+
+/*
+ * read the table of inodes, the mapping table cluster-to-inode and the bitmap table to free data clusters into
+ * memory and set up the bitsets: the data clusters whose references are in the caches are also marked as free
+ */
+
+static int loadTables (void)
+{
+  unsigned char *bmap;                           /* copy of the bitmap table to free data clusters */
+  uint32_t nWords, c, i;                         /* size of the bitsets and counting variables */
+  int stat;                                      /* status of operation */
+
+  nWords = (sb.dzone_total + 31) / 32;
+  if (((inT = malloc ((size_t) sb.itable_size * BLOCK_SIZE)) == NULL) ||
+      ((ciuT = malloc ((size_t) sb.ciutable_size * BLOCK_SIZE)) == NULL) ||
+      ((freeC = calloc (nWords, sizeof (uint32_t))) == NULL) ||
+      ((seenC = calloc (nWords, sizeof (uint32_t))) == NULL) ||
+      ((links = calloc (sb.itotal, sizeof (uint32_t))) == NULL) ||
+      ((parents = calloc (sb.itotal, sizeof (uint32_t))) == NULL))
+     return -ENOMEM;
+  if ((bmap = malloc ((size_t) sb.fctable_size * BLOCK_SIZE)) == NULL)
+     return -ENOMEM;
+
+  if (((stat = readTable (sb.itable_start, sb.itable_size, inT)) != 0) ||
+      ((stat = readTable (sb.ciutable_start, sb.ciutable_size, ciuT)) != 0) ||
+      ((stat = readTable (sb.fctable_start, sb.fctable_size, bmap)) != 0))
+     { free (bmap);
+       return stat;
+     }
+
+  for (c = 0; c < sb.dzone_total; c++)
+    if (bmap[c/8] & (1 << (7 - c % 8)))
+       setBit (freeC, c);
+  free (bmap);
+  for (i = sb.dzone_retriev.cache_idx; i < DZONE_CACHE_SIZE; i++)
+    if ((sb.dzone_retriev.cache[i] < sb.dzone_total) && setBit (freeC, sb.dzone_retriev.cache[i]))
+       report (ESBFCCINVAL, "data cluster %"PRIu32" of the retrieval cache is also free elsewhere",
+               sb.dzone_retriev.cache[i]);
+  for (i = 0; i < sb.dzone_insert.cache_idx; i++)
+    if ((sb.dzone_insert.cache[i] < sb.dzone_total) && setBit (freeC, sb.dzone_insert.cache[i]))
+       report (ESBFCCINVAL, "data cluster %"PRIu32" of the insertion cache is also free elsewhere",
+               sb.dzone_insert.cache[i]);
+
+  return 0;
+}
+
+/*
+ * read a table into memory, FSCK_CHUNK blocks at a time, each chunk by a single transfer
+ */
+
+static int readTable (uint32_t start, uint32_t size, void *buf)
+{
+  struct iovec iov;                              /* buffer of a chunk */
+  uint32_t blk, n;                               /* index of the first block of a chunk and its size */
+  int stat;                                      /* status of operation */
+
+  for (blk = 0; blk < size; blk += n)
+  { n = ((size - blk) < FSCK_CHUNK) ? (size - blk) : FSCK_CHUNK;
+    iov.iov_base = (unsigned char *) buf + (size_t) blk * BLOCK_SIZE;
+    iov.iov_len = (size_t) n * BLOCK_SIZE;
+    if ((stat = soReadRawBlocks (start + blk, 1, &iov)) != 0)
+       return stat;
+  }
+
+  return 0;
+}
+
+/*
+ * check all the inodes: the threads take FSCK_BATCH successive inodes at a time, so that they are kept evenly busy
+ * whatever the size of the files
+ */
+
+static void checkInodes (uint32_t nThreads)
+{
+  pthread_t thr[FSCK_THREADS];                   /* threads which check the inodes */
+  bool started[FSCK_THREADS];                    /* signals if a thread was started */
+  bool any;                                      /* signals if some thread was started */
+  uint32_t t;                                    /* counting variable */
+
+  nextInode = 0;
+  any = false;
+  for (t = 0; t < nThreads; t++)
+    if ((started[t] = (pthread_create (&thr[t], NULL, checkRange, NULL) == 0)))
+       any = true;
+  for (t = 0; t < nThreads; t++)
+    if (started[t])
+       pthread_join (thr[t], NULL);
+  if (!any)                                      /* the inodes are checked by the main thread */
+     checkRange (NULL);
+}
+
+/*
+ * thread which checks groups of successive inodes until there are no more
+ */
+
+static void *checkRange (void *arg)
+{
+  SODataClust clt[3];                            /* buffers of the clusters of references and of directory entries */
+  uint32_t first, end, n;                        /* inodes of the group and counting variable */
+
+  while ((first = __sync_fetch_and_add (&nextInode, FSCK_BATCH)) < sb.itotal)
+  { end = (sb.itotal - first < FSCK_BATCH) ? sb.itotal : first + FSCK_BATCH;
+    for (n = first; n < end; n++)
+      checkInode (n, clt);
+  }
+
+  return NULL;
+}
+
+/*
+ * check an inode and its list of references: the contents of a directory are checked as its clusters are found
+ */
+
+static void checkInode (uint32_t nInode, SODataClust *clt)
+{
+  SOInode *p_inode = &inT[nInode];               /* pointer to the inode */
+  uint32_t type, i;                              /* file type and counting variable */
+  bool dirty;                                    /* signals if a free inode is in the dirty state */
+  int stat;                                      /* status of operation */
+
+  if (p_inode->mode & INODE_FREE)
+     { if ((stat = soQCheckFInode (p_inode)) != 0)
+          { report (-stat, "free inode %"PRIu32, nInode);
+            return;
+          }
+       dirty = (p_inode->i1 != NULL_CLUSTER) || (p_inode->i2 != NULL_CLUSTER);
+       for (i = 0; (i < N_DIRECT) && !dirty; i++)
+         dirty = (p_inode->d[i] != NULL_CLUSTER);
+       if (dirty)
+          checkRefs (nInode, p_inode, clt);
+          else if (p_inode->clucount != 0)
+                  report (EFCININVAL, "free inode %"PRIu32" in the clean state has %"PRIu32" data clusters",
+                          nInode, p_inode->clucount);
+       return;
+     }
+
+  type = p_inode->mode & INODE_TYPE_MASK;
+  if ((type != INODE_DIR) && (type != INODE_FILE) && (type != INODE_SYMLINK))
+     { report (EIUININVAL, "inode %"PRIu32" in use has an illegal type", nInode);
+       return;
+     }
+  if (p_inode->refcount == 0)
+     report (EIUININVAL, "inode %"PRIu32" in use has a null reference count", nInode);
+  if ((type == INODE_DIR) && ((p_inode->size == 0) || ((p_inode->size % BSLPC) != 0)))
+     report (EDIRINVAL, "directory %"PRIu32" has an illegal size (%"PRIu32")", nInode, p_inode->size);
+  checkRefs (nInode, p_inode, clt);
+}
+
+/*
+ * check the list of references of an inode, either in use or free in the dirty state, or its tree of extents: clt[0]
+ * and clt[1] hold the clusters of references being parsed and clt[2] the clusters of directory entries
+ */
+
+static void checkRefs (uint32_t nInode, SOInode *p_inode, SODataClust *clt)
+{
+  bool inUse = !(p_inode->mode & INODE_FREE);    /* status of the inode */
+  bool isDir = inUse && ((p_inode->mode & INODE_TYPE_MASK) == INODE_DIR);  /* file type */
+  uint32_t nDirClust = p_inode->size / BSLPC;    /* number of data clusters of a directory */
+  uint32_t count, nData, ind, i, j;              /* number of data clusters found and counting variables */
+  uint32_t ref;                                  /* reference to a data cluster */
+  int stat;                                      /* status of operation */
+
+  if (p_inode->mode & INODE_EXTENTS)
+     { checkExtents (nInode, p_inode);
+       return;
+     }
+  if (INODE_IS_INLINE (p_inode->mode))
+     { checkInline (nInode, p_inode);
+       return;
+     }
+
+  count = nData = 0;
+
+  /* direct references */
+
+  for (i = 0; i < N_DIRECT; i++)
+    if ((ref = p_inode->d[i]) != NULL_CLUSTER)
+       { count += 1;
+         if (checkClust (nInode, inUse, true, ref) && isDir)
+            checkDirClust (nInode, i, ref, &clt[2]);
+         if (i < nDirClust) nData += 1;
+       }
+
+  /* single indirect references */
+
+  if ((ref = p_inode->i1) != NULL_CLUSTER)
+     { count += 1;
+       if (checkClust (nInode, inUse, false, ref))
+          { if ((stat = readClust (ref, &clt[0])) != 0)
+               report (-stat, "inode %"PRIu32": reading data cluster %"PRIu32, nInode, ref);
+               else for (i = 0; i < RPC; i++)
+                      if ((ref = clt[0].ref[i]) != NULL_CLUSTER)
+                         { count += 1;
+                           ind = N_DIRECT + i;
+                           if (checkClust (nInode, inUse, true, ref) && isDir)
+                              checkDirClust (nInode, ind, ref, &clt[2]);
+                           if (ind < nDirClust) nData += 1;
+                         }
+          }
+     }
+
+  /* double indirect references */
+
+  if ((ref = p_inode->i2) != NULL_CLUSTER)
+     { count += 1;
+       if (checkClust (nInode, inUse, false, ref))
+          { if ((stat = readClust (ref, &clt[0])) != 0)
+               report (-stat, "inode %"PRIu32": reading data cluster %"PRIu32, nInode, ref);
+               else for (j = 0; j < RPC; j++)
+                      if ((ref = clt[0].ref[j]) != NULL_CLUSTER)
+                         { count += 1;
+                           if (!checkClust (nInode, inUse, false, ref)) continue;
+                           if ((stat = readClust (ref, &clt[1])) != 0)
+                              { report (-stat, "inode %"PRIu32": reading data cluster %"PRIu32, nInode, ref);
+                                continue;
+                              }
+                           for (i = 0; i < RPC; i++)
+                             if ((ref = clt[1].ref[i]) != NULL_CLUSTER)
+                                { count += 1;
+                                  ind = N_DIRECT + RPC + j * RPC + i;
+                                  if (checkClust (nInode, inUse, true, ref) && isDir)
+                                     checkDirClust (nInode, ind, ref, &clt[2]);
+                                  if (ind < nDirClust) nData += 1;
+                                }
+                         }
+          }
+     }
+
+  if (count != p_inode->clucount)
+     report (ELDCININVAL, "inode %"PRIu32" has %"PRIu32" data clusters, but its clucount is %"PRIu32,
+             nInode, count, p_inode->clucount);
+  if (isDir && (nData != nDirClust))
+     report (EDIRINVAL, "directory %"PRIu32" lacks %"PRIu32" of its data clusters", nInode, nDirClust - nData);
+}
+
+/*
+ * check an inode whose contents are stored in it: only regular files and symbolic links in use do it, they have no
+ * data clusters and the bytes stored past the file size are zero
+ */
+
+static void checkInline (uint32_t nInode, SOInode *p_inode)
+{
+  const unsigned char *c = (const unsigned char *) p_inode->d;  /* contents of the file */
+  uint32_t type = p_inode->mode & INODE_TYPE_MASK;              /* file type */
+  uint32_t i;                                                   /* counting variable */
+
+  if (p_inode->mode & INODE_FREE)
+     { report (EFDININVAL, "free inode %"PRIu32" has contents stored in it", nInode);
+       return;
+     }
+  if ((type != INODE_FILE) && (type != INODE_SYMLINK))
+     report (EIUININVAL, "inode %"PRIu32" in use stores its contents, but it is neither a regular file nor a symbolic "
+             "link", nInode);
+  if (p_inode->clucount != 0)
+     report (ELDCININVAL, "inode %"PRIu32" stores its contents, but it has %"PRIu32" data clusters", nInode,
+             p_inode->clucount);
+  for (i = p_inode->size; i < INLINE_SIZE; i++)
+    if (c[i] != 0)
+       { report (EIUININVAL, "inode %"PRIu32" stores non-zero bytes past its size (%"PRIu32")", nInode,
+                 p_inode->size);
+         break;
+       }
+}
+
+/*
+ * check the tree of extents of an inode, either in use or free in the dirty state: only regular files are described
+ * by one
+ */
+
+static void checkExtents (uint32_t nInode, SOInode *p_inode)
+{
+  bool inUse = !(p_inode->mode & INODE_FREE);    /* status of the inode */
+  SOExtent root[N_ROOT_EXTENTS];                 /* entries of the root */
+  uint32_t depth, cnt, count, next, i;           /* depth of the tree, number of entries, clusters found and bound */
+
+  depth = (p_inode->mode & INODE_EXT_DEPTH_MASK) >> INODE_EXT_DEPTH_SHIFT;
+  if (inUse && ((p_inode->mode & INODE_TYPE_MASK) != INODE_FILE))
+     report (EIUININVAL, "inode %"PRIu32" in use has a tree of extents, but it is not a regular file", nInode);
+  if (depth > EXT_MAX_DEPTH)
+     { report (ELDCININVAL, "inode %"PRIu32" has a tree of extents of depth %"PRIu32, nInode, depth);
+       return;
+     }
+  memcpy (root, p_inode->d, sizeof (root));
+  for (cnt = 0; (cnt < N_ROOT_EXTENTS) && (root[cnt].nClust != NULL_CLUSTER); cnt++);
+  for (i = cnt; i < N_ROOT_EXTENTS; i++)
+    if ((root[i].first != NULL_CLUSTER) || (root[i].count != NULL_CLUSTER) || (root[i].nClust != NULL_CLUSTER))
+       { report (ELDCININVAL, "inode %"PRIu32" has a root of its tree of extents which is not packed", nInode);
+         break;
+       }
+  if ((depth > 0) && (cnt == 0))
+     report (ELDCININVAL, "inode %"PRIu32" has an empty root in a tree of extents of depth %"PRIu32, nInode, depth);
+
+  count = next = 0;
+  checkExtNode (nInode, inUse, root, cnt, depth, 0, MAX_FILE_CLUSTERS, &next, &count);
+  if (count != p_inode->clucount)
+     report (ELDCININVAL, "inode %"PRIu32" has %"PRIu32" data clusters, but its clucount is %"PRIu32,
+             nInode, count, p_inode->clucount);
+}
+
+/*
+ * check the entries of a node of a tree of extents (the root included) and the subtrees they lead to: the entries not
+ * in use must follow those in use, the extents must start after the end of the previous one and lie within the
+ * bounds set by the upper levels, and the lower bounds held by an index node must be strictly increasing; the nodes
+ * are checked as clusters of references and the clusters of the extents as data clusters
+ */
+
+static void checkExtNode (uint32_t nInode, bool inUse, const SOExtent *ent, uint32_t cnt, uint32_t depth,
+                          uint32_t lower, uint32_t upper, uint32_t *p_next, uint32_t *p_count)
+{
+  SODataClust node;                              /* contents of a node of the level below */
+  uint32_t i, k, sub;                            /* counting variables and number of entries of the node below */
+  int stat;                                      /* status of operation */
+
+  for (i = 0; i < cnt; i++)
+  { if ((ent[i].first < lower) || (ent[i].first >= upper) || ((i > 0) && (ent[i].first <= ent[i-1].first)))
+       { report (ELDCININVAL, "inode %"PRIu32": entry %"PRIu32" of a node of its tree of extents is out of order",
+                 nInode, ent[i].first);
+         return;
+       }
+    if (depth == 0)
+       { if ((ent[i].count == 0) || (ent[i].first < *p_next) || (ent[i].count > upper - ent[i].first))
+            { report (ELDCININVAL, "inode %"PRIu32": extent %"PRIu32" (%"PRIu32" clusters) overlaps its neighbours",
+                      nInode, ent[i].first, ent[i].count);
+              return;
+            }
+         *p_next = ent[i].first + ent[i].count;
+         for (k = 0; k < ent[i].count; k++)
+         { *p_count += 1;
+           if (!checkClust (nInode, inUse, true, ent[i].nClust + k)) break;
+         }
+         continue;
+       }
+    if (ent[i].count != 0)
+       report (ELDCININVAL, "inode %"PRIu32": index entry %"PRIu32" of its tree of extents has a count",
+               nInode, ent[i].first);
+    *p_count += 1;
+    if (!checkClust (nInode, inUse, false, ent[i].nClust)) continue;
+    if ((stat = readClust (ent[i].nClust, &node)) != 0)
+       { report (-stat, "inode %"PRIu32": reading data cluster %"PRIu32, nInode, ent[i].nClust);
+         continue;
+       }
+    for (sub = 0; (sub < EPC) && (node.ext[sub].nClust != NULL_CLUSTER); sub++);
+    for (k = sub; k < EPC; k++)
+      if ((node.ext[k].first != NULL_CLUSTER) || (node.ext[k].count != NULL_CLUSTER) ||
+          (node.ext[k].nClust != NULL_CLUSTER))
+         break;
+    if ((sub == 0) || (k != EPC))
+       { report (ELDCININVAL, "inode %"PRIu32": node %"PRIu32" of its tree of extents is %s", nInode,
+                 ent[i].nClust, (sub == 0) ? "empty" : "not packed");
+         continue;
+       }
+    checkExtNode (nInode, inUse, node.ext, sub, depth - 1, ent[i].first,
+                  (i + 1 < cnt) ? ent[i+1].first : upper, p_next, p_count);
+  }
+}
+
+/*
+ * check a data cluster referenced by an inode: it must be legal, mapped to the inode and allocated, unless it is a
+ * data cluster of a free inode in the dirty state, and it must not have been found before; it returns true if the
+ * contents of the data cluster may be parsed (it is legal and it was not found before)
+ */
+
+static bool checkClust (uint32_t nInode, bool inUse, bool isData, uint32_t nClust)
+{
+  if (nClust >= sb.dzone_total)
+     { report (ELDCININVAL, "inode %"PRIu32" refers to data cluster %"PRIu32", which is out of range",
+               nInode, nClust);
+       return false;
+     }
+  if (setBit (seenC, nClust))
+     { report (ELDCININVAL, "inode %"PRIu32" refers to data cluster %"PRIu32", which is referenced more than once",
+               nInode, nClust);
+       return false;
+     }
+  if (ciuT[nClust] != nInode)
+     report (EDCMINVAL, "inode %"PRIu32" refers to data cluster %"PRIu32", which is mapped to inode %"PRId32,
+             nInode, nClust, (int32_t) ciuT[nClust]);
+  if (testBit (freeC, nClust) != (!inUse && isData))
+     { if (inUse || !isData)
+          report (EDCNALINVAL, "inode %"PRIu32" refers to data cluster %"PRIu32", which is free", nInode, nClust);
+          else report (EFDININVAL, "free inode %"PRIu32" refers to data cluster %"PRIu32", which is allocated",
+                       nInode, nClust);
+     }
+
+  return true;
+}
+
+/*
+ * check a data cluster of a directory: the entries in use must refer to inodes in use, the first two entries being
+ * "." and "..", and they are counted as references to the inodes
+ */
+
+static void checkDirClust (uint32_t nInode, uint32_t clustInd, uint32_t nClust, SODataClust *p_clt)
+{
+  SODirEntry *p_de;                              /* pointer to a directory entry */
+  uint64_t pos;                                  /* position of the entry in the directory */
+  uint32_t i;                                    /* counting variable */
+  bool isDir;                                    /* signals if the entry refers to a directory */
+  int stat;                                      /* status of operation */
+
+  if ((uint64_t) clustInd * BSLPC >= inT[nInode].size)
+     { report (EDIRINVAL, "directory %"PRIu32" has data cluster %"PRIu32" beyond its size", nInode, nClust);
+       return;
+     }
+  if ((stat = readClust (nClust, p_clt)) != 0)
+     { report (-stat, "directory %"PRIu32": reading data cluster %"PRIu32, nInode, nClust);
+       return;
+     }
+
+  for (i = 0; i < DPC; i++)
+  { p_de = &p_clt->de[i];
+    pos = (uint64_t) clustInd * DPC + i;
+    if (p_de->name[0] == '\0')
+       { if (pos < 2)
+            report (EDIRINVAL, "directory %"PRIu32" lacks entry \"%s\"", nInode, (pos == 0) ? "." : "..");
+         continue;
+       }
+    if (memchr (p_de->name, '\0', MAX_NAME + 1) == NULL)
+       { report (EDEINVAL, "directory %"PRIu32", entry %"PRIu64": the name is not NUL-terminated", nInode, pos);
+         continue;
+       }
+    if ((p_de->nInode >= sb.itotal) || (inT[p_de->nInode].mode & INODE_FREE))
+       { report (EDEINVAL, "directory %"PRIu32", entry \"%s\": inode %"PRId32" is not in use",
+                 nInode, p_de->name, (int32_t) p_de->nInode);
+         continue;
+       }
+    isDir = ((inT[p_de->nInode].mode & INODE_TYPE_MASK) == INODE_DIR);
+    if (pos == 0)
+       { if ((strcmp ((char *) p_de->name, ".") != 0) || (p_de->nInode != nInode))
+            report (EDIRINVAL, "directory %"PRIu32": the first entry is not \".\"", nInode);
+       }
+       else if (pos == 1)
+               { if ((strcmp ((char *) p_de->name, "..") != 0) || !isDir)
+                    report (EDIRINVAL, "directory %"PRIu32": the second entry is not \"..\"", nInode);
+               }
+       else if ((strcmp ((char *) p_de->name, ".") == 0) || (strcmp ((char *) p_de->name, "..") == 0))
+               report (EDEINVAL, "directory %"PRIu32", entry %"PRIu64": illegal name \"%s\"", nInode, pos, p_de->name);
+       else if (isDir)
+               __sync_fetch_and_add (&parents[p_de->nInode], 1);
+    __sync_fetch_and_add (&links[p_de->nInode], 1);
+  }
+}
+
+/*
+ * read a data cluster straight from the storage device (the buffercache is not shared by the threads)
+ */
+
+static int readClust (uint32_t nClust, SODataClust *p_clt)
+{
+  return soReadRawCluster (sb.dzone_start + nClust * BLOCKS_PER_CLUSTER, p_clt);
+}
+
+/*
+ * cross-check the data clusters: an allocated data cluster must have been found in the list of references of an
+ * inode and a free data cluster, if it is not clean, must be mapped to a free inode in the dirty state which refers
+ * to it
+ */
+
+static void checkClusters (void)
+{
+  uint32_t c, n;                                 /* counting variable and mapped inode */
+
+  for (c = 0; c < sb.dzone_total; c++)
+  { if (testBit (seenC, c)) continue;            /* it was checked with the inode */
+    n = ciuT[c];
+    if (!testBit (freeC, c))
+       report (EDCMINVAL, "data cluster %"PRIu32" is allocated, but it is not referenced by any inode", c);
+       else if (n != NULL_INODE)
+               report (EDCMINVAL, "data cluster %"PRIu32" is free and mapped to inode %"PRId32", which does not refer "
+                       "to it", c, (int32_t) n);
+  }
+}
+
+/*
+ * cross-check the references to the inodes: the number of entries which refer to an inode in use must match its
+ * reference count and the directories must have a single parent; the free inodes are also counted
+ */
+
+static void checkLinks (void)
+{
+  uint32_t n, nFree;                             /* counting variable and number of free inodes */
+  bool isDir;                                    /* signals if the inode is a directory */
+
+  if ((inT[0].mode & INODE_FREE) || ((inT[0].mode & INODE_TYPE_MASK) != INODE_DIR))
+     report (EIUININVAL, "inode 0 is not the root directory");
+
+  nFree = 0;
+  for (n = 0; n < sb.itotal; n++)
+  { if (inT[n].mode & INODE_FREE)
+       { nFree += 1;
+         continue;
+       }
+    if (links[n] != inT[n].refcount)
+       report (EIUININVAL, "inode %"PRIu32" is referred to by %"PRIu32" directory entries, but its refcount is %"
+               PRIu16, n, links[n], inT[n].refcount);
+    isDir = ((inT[n].mode & INODE_TYPE_MASK) == INODE_DIR);
+    if (isDir && (parents[n] != ((n == 0) ? 0 : 1)))
+       report (EDIRINVAL, "directory %"PRIu32" is referred to by %"PRIu32" entries of other directories",
+               n, parents[n]);
+  }
+  if (nFree != sb.ifree)
+     report (ESBTINPINVAL, "the table of inodes has %"PRIu32" free inodes, but ifree is %"PRIu32, nFree, sb.ifree);
+}
+
+/*
+ * test a bit of a bitset
+ */
+
+static bool testBit (uint32_t *set, uint32_t n)
+{
+  return (set[n/32] & (1U << (n % 32))) != 0;
+}
+
+/*
+ * set a bit of a bitset atomically: it returns true if the bit was already set
+ */
+
+static bool setBit (uint32_t *set, uint32_t n)
+{
+  return (__sync_fetch_and_or (&set[n/32], 1U << (n % 32)) & (1U << (n % 32))) != 0;
+}
+
+/*
+ * report an inconsistency (or an error on reading the storage device); code is a positive error code
+ */
+
+static void report (int code, const char *fmt, ...)
+{
+  va_list ap;                                    /* variable argument list */
+
+  pthread_mutex_lock (&reportCR);
+  nErrors += 1;
+  if (!quiet)
+     { if (pending)                              /* the progress message is ended first */
+          { printf ("\n");
+            pending = false;
+          }
+       printf ("error #%d - %s: ", code, soGetErrorMessage (code));
+       va_start (ap, fmt);
+       vprintf (fmt, ap);
+       va_end (ap);
+       printf ("\n");
+     }
+  pthread_mutex_unlock (&reportCR);
+}
+
+/*
+ * print help message
+ */
+
+static void printUsage (char *cmd_name)
+{
+  printf ("Sinopsis: %s [OPTIONS] supp-file\n"
+          "  OPTIONS:\n"
+          "  -t num  --- set number of threads which check the inodes (default: number of processors, at most 16)\n"
+          "  -q      --- set quiet mode (default: not quiet)\n"
+          "  -h      --- print this help\n", cmd_name);
+}
+
+/*
+ * print error message
+ */
+
+static void printError (int errcode, char *cmd_name)
+{
+  fprintf(stderr, "%s: error #%d - %s\n", cmd_name, -errcode,
+          soGetErrorMessage (-errcode));
+}
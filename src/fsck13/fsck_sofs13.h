@@ -0,0 +1,35 @@
+/**
+ *  \file fsck_sofs13.h (interface file)
+ *
+ *  \brief The SOFS13 file system consistency checking tool.
+ *
+ *  It checks the consistency of the whole file system metadata stored in the storage device, without changing it.
+ *  After the quick checks of the superblock and of the related structures, the table of inodes, the mapping table
+ *  cluster-to-inode and the bitmap table to free data clusters are read sequentially into memory and the inodes are
+ *  split among several threads, which check them and their lists of references and the contents of the directories.
+ *  The ownership of the data clusters found is recorded in bitsets and cross-checked against the tables at the end.
+ *
+ *  The following checks are made:
+ *     \li quick check of the superblock, the table of inodes and the data zone metadata
+ *     \li consistency of every inode, either in use, or free in the clean or in the dirty state
+ *     \li the data clusters referenced by an inode are legal, referenced only once, mapped to the inode in the
+ *         mapping table cluster-to-inode and allocated or freed, according to the inode status
+ *     \li the <tt>clucount</tt> field of every inode matches its lists of references
+ *     \li the entries of every directory are legal, the first two being "." and ".."
+ *     \li the <tt>refcount</tt> field of every inode in use matches the number of directory entries which refer to it
+ *         and every directory but the root is referred to by a single entry of its parent
+ *     \li every allocated data cluster is referenced by an inode and every free data cluster is either clean or mapped
+ *         to a free inode in the dirty state
+ *     \li the number of free inodes in the table of inodes matches the superblock.
+ *
+ *  SINOPSIS:
+ *  <P><PRE>                fsck_sofs13 [OPTIONS] supp-file
+ *
+ *                OPTIONS:
+ *                 -t num  --- set number of threads which check the inodes (default: number of processors, at most 16)
+ *                 -q      --- set quiet mode (default: not quiet)
+ *                 -h      --- print this help.</PRE>
+ *
+ *  \remarks The file system must not be mounted while it is checked. The exit status is \c EXIT_SUCCESS only if no
+ *           inconsistency was found.
+ */
@@ -13,7 +13,14 @@
      *     \li the table of inodes
      *     \li the mapping table cluster-to-inode
      *     \li the data zone
-     *     \li the contents of the root directory seen as empty.
+     *     \li the contents of the root directory seen as empty
+     *     \li the header of the journal, if one is required
+     *     \li the summary of the free data clusters, if one is required.
+     *
+     *  In zero mode, or in discard mode, the free data clusters are discarded on the storage device by a single
+     *  request, so that a sparse supporting file, or a thin-provisioned block device, gets back the room they take; a
+     *  supporting file reads as zeros afterwards, but, if it can not be done, or the storage device is a block device,
+     *  the free data clusters are written with zeros in zero mode.
      *
      *  SINOPSIS:
      *  <P><PRE>                mkfs_sofs13 [OPTIONS] supp-file
@@ -21,7 +28,13 @@
      *                OPTIONS:
      *                 -n name --- set volume name (default: "SOFS13")
      *                 -i num  --- set number of inodes (default: N/8, where N = number of blocks)
+     *                 -t num  --- set number of threads which fill in the tables (default: number of processors, at most 16)
+     *                 -j num  --- set number of blocks of the journal (default: 0, no journal)
+     *                 -s      --- keep a summary of the free data clusters past the journal (default: not kept)
+     *                 -c size --- set size of the clusters in bytes, kilobytes with a trailing K (default and only value
+     *                             allowed: the one the tools were built with)
      *                 -z      --- set zero mode (default: not zero)
+     *                 -d      --- set discard mode (default: not discard)
      *                 -q      --- set quiet mode (default: not quiet)
      *                 -h      --- print this help.</PRE>
      *
@@ -41,23 +54,65 @@
     #include <string.h>
     #include <time.h>
     #include <errno.h>
+    #include <pthread.h>
+    #include <sys/uio.h>
+    #include <sys/ioctl.h>
+    #include <fcntl.h>
+    #include <linux/fs.h>
+    #undef BLOCK_SIZE                                  /* the kernel block size is not the one of the storage device */
 
     #include "sofs_const.h"
     #include "sofs_buffercache.h"
+    #include "sofs_rawdisk.h"
     #include "sofs_superblock.h"
     #include "sofs_inode.h"
     #include "sofs_direntry.h"
     #include "sofs_basicoper.h"
     #include "sofs_basicconsist.h"
+    #include "sofs_journal.h"
+    #include "sofs_freesummary.h"
+
+    /** \brief number of blocks of a table generated in memory and written at a time */
+    #define MKFS_CHUNK    2048
+    /** \brief maximum number of threads which fill in a table concurrently */
+    #define MKFS_THREADS  16
+
+    /** \brief generator of a run of blocks of a table: it gets the superblock, the index of the first block of the run
+     *         in the table, the number of blocks and the buffer where they are to be stored */
+    typedef void (*SOFillFn) (SOSuperBlock *p_sb, uint32_t blk, uint32_t nblks, unsigned char *buf);
+
+    /** \brief range of blocks of a table filled in by a thread */
+    typedef struct soFillRange
+    {
+      /** \brief pointer to the superblock */
+      SOSuperBlock *p_sb;
+      /** \brief physical number of the first block of the table */
+      uint32_t start;
+      /** \brief index of the first block of the range in the table */
+      uint32_t first;
+      /** \brief index of the block past the last one of the range in the table */
+      uint32_t end;
+      /** \brief generator of the blocks (\c NULL, if they are zero filled) */
+      SOFillFn fill;
+      /** \brief status of operation */
+      int stat;
+    } SOFillRange;
 
     /* Allusion to internal functions */
 
     static int fillInSuperBlock (SOSuperBlock *p_sb, uint32_t ntotal, uint32_t itotal, uint32_t ctinmblktotal, uint32_t fcblktotal,
-                                         uint32_t nclusttotal, unsigned char *name);
-    static int fillInINT (SOSuperBlock *p_sb);
-    static int fillInCIT (SOSuperBlock *p_sb);
+                                         uint32_t nclusttotal, uint32_t jblktotal, unsigned char *name);
+    static int fillInINT (SOSuperBlock *p_sb, uint32_t nThreads);
+    static void fillBlocksINT (SOSuperBlock *p_sb, uint32_t blk, uint32_t nblks, unsigned char *buf);
+    static int fillInCIT (SOSuperBlock *p_sb, uint32_t nThreads);
+    static void fillBlocksCIT (SOSuperBlock *p_sb, uint32_t blk, uint32_t nblks, unsigned char *buf);
     static int fillInRootDir (SOSuperBlock *p_sb);
-    static int fillInBitMapT (SOSuperBlock *p_sb, int zero);
+    static int fillInBitMapT (SOSuperBlock *p_sb, int zero, int discard, int blkdev, uint32_t nThreads);
+    static int fillInJournal (SOSuperBlock *p_sb);
+    static int fillInFreeSummary (SOSuperBlock *p_sb);
+    static void fillBlocksBMapT (SOSuperBlock *p_sb, uint32_t blk, uint32_t nblks, unsigned char *buf);
+    static int fillInTable (SOSuperBlock *p_sb, uint32_t start, uint32_t size, SOFillFn fill, uint32_t nThreads);
+    static void *fillInRange (void *arg);
     static int checkFSConsist (void);
     static void printUsage (char *cmd_name);
     static void printError (int errcode, char *cmd_name);
@@ -68,15 +123,24 @@
     {
       char *name = "SOFS13";                         /* volume name */
       uint32_t itotal = 0;                           /* total number of inodes, if kept, set value automatically */
+      uint32_t jblktotal = 0;                        /* number of blocks of the journal, if kept, there is no journal */
+      long csize;                                    /* size of the clusters in bytes */
+      char *end;                                     /* end of the numeric part of the size of the clusters */
       int quiet = 0;                                 /* quiet mode, if kept, set not quiet mode */
       int zero = 0;                                  /* zero mode, if kept, set not zero mode */
+      int discard = 0;                               /* discard mode, if kept, set not discard mode */
+      int summary = 0;                               /* summary of the free data clusters, if kept, there is none */
+      long ncpu = sysconf (_SC_NPROCESSORS_ONLN);    /* number of processors */
+      uint32_t nThreads;                             /* number of threads which fill in the tables */
+
+      nThreads = (ncpu < 1) ? 1 : ((ncpu > MKFS_THREADS) ? MKFS_THREADS : (uint32_t) ncpu);
 
       /* process command line options */
 
       int opt;                                       /* selected option */
 
       do
-      { switch ((opt = getopt (argc, argv, "n:i:qzh")))
+      { switch ((opt = getopt (argc, argv, "n:i:t:j:sc:qzdh")))
         { case 'n': /* volume name */
                     name = optarg;
                     break;
@@ -88,6 +152,39 @@
                        }
                     itotal = (uint32_t) atoi (optarg);
                     break;
+          case 't': /* number of threads */
+                    if ((atoi (optarg) <= 0) || (atoi (optarg) > MKFS_THREADS))
+                       { fprintf (stderr, "%s: Bad number of threads.\n", basename (argv[0]));
+                         printUsage (basename (argv[0]));
+                         return EXIT_FAILURE;
+                       }
+                    nThreads = (uint32_t) atoi (optarg);
+                    break;
+          case 'j': /* number of blocks of the journal */
+                    if ((atoi (optarg) < 0) || ((atoi (optarg) > 0) && (atoi (optarg) < JNL_MIN_SIZE)))
+                       { fprintf (stderr, "%s: Bad number of blocks of the journal (at least %d).\n", basename (argv[0]),
+                                  (int) JNL_MIN_SIZE);
+                         printUsage (basename (argv[0]));
+                         return EXIT_FAILURE;
+                       }
+                    jblktotal = (uint32_t) atoi (optarg);
+                    break;
+          case 's': /* summary of the free data clusters */
+                    summary = 1;
+                    break;
+          case 'c': /* size of the clusters */
+                    csize = strtol (optarg, &end, 10);
+                    if ((*end == 'K') || (*end == 'k'))
+                       { csize *= 1024;
+                         end += 1;
+                       }
+                    if ((*end != '\0') || (csize != CLUSTER_SIZE))
+                       { fprintf (stderr, "%s: Cluster size not supported by this build (only %d bytes; rebuild with "
+                                  "-DBLOCKS_PER_CLUSTER=n for another one).\n", basename (argv[0]), (int) CLUSTER_SIZE);
+                         printUsage (basename (argv[0]));
+                         return EXIT_FAILURE;
+                       }
+                    break;
           case 'q': /* quiet mode */
                     quiet = 1;                       /* set quiet mode for processing: no messages are issued */
                     break;
@@ -95,6 +192,10 @@
                     zero = 1;                        /* set zero mode for processing: the information content of all free
                                                         data clusters are set to zero */
                     break;
+          case 'd': /* discard mode */
+                    discard = 1;                     /* set discard mode for processing: all free data clusters are
+                                                        discarded on the storage device */
+                    break;
           case 'h': /* help mode */
                     printUsage (basename (argv[0]));
                     return EXIT_SUCCESS;
@@ -120,6 +221,18 @@
          { printError (-errno, basename (argv[0]));
            return EXIT_FAILURE;
          }
+      if (S_ISBLK (st.st_mode))                      /* the size of a block device is got from the driver */
+         { uint64_t size;                            /* size of the block device in bytes */
+           int bfd;                                  /* file descriptor of the block device */
+
+           if (((bfd = open (devname, O_RDONLY)) == -1) || (ioctl (bfd, BLKGETSIZE64, &size) == -1))
+              { printError (-errno, basename (argv[0]));
+                if (bfd != -1) close (bfd);
+                return EXIT_FAILURE;
+              }
+           close (bfd);
+           st.st_size = (off_t) size;
+         }
       if (st.st_size % BLOCK_SIZE != 0)              /* check file size: the storage device must have a size in bytes
                                                         multiple of block size */
          { fprintf (stderr, "%s: Bad size of support file.\n", basename (argv[0]));
@@ -151,9 +264,25 @@
       uint32_t nclusttotal;                          /* total number of clusters */
       uint32_t fcblktotal;                           /* number of blocks of the free clusters table (bitmap) */
       uint32_t ctinmblktotal;                        /* number of blocks of the cluster to inode mapping table */
+      uint32_t fsumblktotal = 0;                     /* number of blocks of the region of the summary of the free
+                                                        data clusters */
       uint32_t tmp;                                  /* temporary variable */
 
       ntotal = st.st_size / BLOCK_SIZE;
+      if (jblktotal > ntotal / 2)                    /* the journal lies past the end of the file system proper */
+         { fprintf (stderr, "%s: The journal takes more than half the support file.\n", basename (argv[0]));
+           return EXIT_FAILURE;
+         }
+      ntotal -= jblktotal;
+      if (summary)                                   /* the summary lies past the journal, sized for the largest table */
+         { fsumblktotal = FSUM_SIZE ((ntotal / BLOCKS_PER_CLUSTER + BITS_PER_BLOCK - 1) / BITS_PER_BLOCK);
+           if (fsumblktotal > ntotal / 2)
+              { fprintf (stderr, "%s: The summary of the free data clusters takes more than half the support file.\n",
+                         basename (argv[0]));
+                return EXIT_FAILURE;
+              }
+           ntotal -= fsumblktotal;
+         }
       if (itotal == 0) itotal = ntotal >> 3;
       if ((itotal % IPB) == 0)
          iblktotal = itotal / IPB;
@@ -201,10 +330,17 @@
 
       /* read the contents of the superblock to the internal storage area
        * this operation only serves at present time to get a pointer to the superblock storage area in main memory
+       * the previous superblock is discarded beforehand, so that a device formatted with another geometry is accepted
        */
 
-      if ((status = soLoadSuperBlock ()) != 0)
-         return status;
+      unsigned char blank[BLOCK_SIZE];                /* contents of a discarded superblock */
+
+      memset (blank, 0, BLOCK_SIZE);
+      if (((status = soWriteCacheBlock (0, blank)) != 0) || ((status = soLoadSuperBlock ()) != 0))
+         { printError (status, basename (argv[0]));
+           soCloseBufferCache ();
+           return EXIT_FAILURE;
+         }
       p_sb = soGetSuperBlock ();
 
       /* filling in the superblock fields:
@@ -217,7 +353,8 @@
            fflush (stdout);                          /* make sure the message is printed now */
          }
 
-      if ((status = fillInSuperBlock (p_sb, ntotal, itotal, ctinmblktotal, fcblktotal, nclusttotal, (unsigned char *) name)) != 0)
+      if ((status = fillInSuperBlock (p_sb, ntotal, itotal, ctinmblktotal, fcblktotal, nclusttotal, jblktotal,
+                                      (unsigned char *) name)) != 0)
          { printError (status, basename (argv[0]));
            soCloseBufferCache ();
            return EXIT_FAILURE;
@@ -234,7 +371,7 @@
            fflush (stdout);                          /* make sure the message is printed now */
          }
 
-      if ((status = fillInINT (p_sb)) != 0)
+      if ((status = fillInINT (p_sb, nThreads)) != 0)
          { printError (status, basename (argv[0]));
            soCloseBufferCache ();
            return EXIT_FAILURE;
@@ -257,7 +394,7 @@
       //soStoreSuperBlock();
       // exit(EXIT_FAILURE);
 
-      if ((status = fillInCIT (p_sb)) != 0)
+      if ((status = fillInCIT (p_sb, nThreads)) != 0)
          { printError (status, basename (argv[0]));
            soCloseBufferCache ();
            return EXIT_FAILURE;
@@ -288,6 +425,7 @@
        *   only data cluster 0 has been allocated (it stores the contents of the root directory)
        * zero fill the remaining data clusters if full formating was required:
        *   zero mode was selected
+       * discard them if discard mode was selected
        */
 
       if (!quiet)
@@ -295,7 +433,7 @@
            fflush (stdout);                          /* make sure the message is printed now */
          }
 
-      if ((status = fillInBitMapT (p_sb, zero)) != 0)
+      if ((status = fillInBitMapT (p_sb, zero, discard, S_ISBLK (st.st_mode), nThreads)) != 0)
          { printError (status, basename (argv[0]));
            soCloseBufferCache ();
            return EXIT_FAILURE;
@@ -303,6 +441,44 @@
 
       if (!quiet) printf ("done.\n");
 
+      /* filling in the header of the journal, if one is required:
+       *   the journal is empty
+       */
+
+      if (jblktotal != 0)
+         { if (!quiet)
+              { printf ("Filling in the header of the journal ... ");
+                fflush (stdout);                     /* make sure the message is printed now */
+              }
+
+           if ((status = fillInJournal (p_sb)) != 0)
+              { printError (status, basename (argv[0]));
+                soCloseBufferCache ();
+                return EXIT_FAILURE;
+              }
+
+           if (!quiet) printf ("done.\n");
+         }
+
+      /* filling in the summary of the free data clusters, if one is required:
+       *   it is counted in the bitmap table and stored as valid
+       */
+
+      if (summary)
+         { if (!quiet)
+              { printf ("Filling in the summary of the free data clusters ... ");
+                fflush (stdout);                     /* make sure the message is printed now */
+              }
+
+           if ((status = fillInFreeSummary (p_sb)) != 0)
+              { printError (status, basename (argv[0]));
+                soCloseBufferCache ();
+                return EXIT_FAILURE;
+              }
+
+           if (!quiet) printf ("done.\n");
+         }
+
       /* magic number should now be set to the right value before writing the contents of the superblock to the storage
          device */
 
@@ -350,9 +526,14 @@
               "  OPTIONS:\n"
               "  -n name --- set volume name (default: \"SOFS13\")\n"
               "  -i num  --- set number of inodes (default: N/8, where N = number of blocks)\n"
+              "  -t num  --- set number of threads which fill in the tables (default: number of processors, at most 16)\n"
+              "  -j num  --- set number of blocks of the journal (default: 0, no journal)\n"
+              "  -s      --- keep a summary of the free data clusters past the journal (default: not kept)\n"
+              "  -c size --- set size of the clusters in bytes, kilobytes with a trailing K (default: %d)\n"
               "  -z      --- set zero mode (default: not zero)\n"
+              "  -d      --- set discard mode (default: not discard)\n"
               "  -q      --- set quiet mode (default: not quiet)\n"
-              "  -h      --- print this help\n", cmd_name);
+              "  -h      --- print this help\n", cmd_name, (int) CLUSTER_SIZE);
     }
 
     /*
@@ -371,7 +552,7 @@
        */
 
     static int fillInSuperBlock (SOSuperBlock *p_sb, uint32_t ntotal, uint32_t itotal, uint32_t ctinmblktotal, uint32_t fcblktotal,
-                                         uint32_t nclusttotal, unsigned char *name)
+                                         uint32_t nclusttotal, uint32_t jblktotal, unsigned char *name)
     {
                     /* header */
                     // Função criada por Rui Monteiro
@@ -436,7 +617,11 @@
                     else
                             p_sb->fctable_size = nclusttotal/RPB+1;*/
 
-                    for (i=0; i<BLOCK_SIZE-PARTITION_NAME_SIZE - 1 - 18 * sizeof(uint32_t) - 2 * sizeof(struct fCNode); i++)
+                    /* journal: past the end of the file system proper */
+                    p_sb->jnl_start = ntotal;
+                    p_sb->jnl_size = jblktotal;
+
+                    for (i=0; i<sizeof (p_sb->reserved); i++)
                     {
                             p_sb->reserved[i] = 0xEE;       // qualquer valor
                     }
@@ -454,84 +639,48 @@
      *   only inode 0 is in use (it describes the root directory)
      */
 
-    static int fillInINT (SOSuperBlock *p_sb)
+    static int fillInINT (SOSuperBlock *p_sb, uint32_t nThreads)
     {
-        if(p_sb == NULL)
-        return -EINVAL;				/*verificação a cabeça se o ponteiro contém conteudo válido*/
-
-	uint32_t s;
-	uint32_t i;	/*Variavel que vai identificar cada inode dentro dos blocos */
-	uint32_t blk;	/*Variavel que vai identificar cada bloco */
-	uint32_t k;	/*Variavel que vai identificar cada indice do vector .d[] de cada inode */
-
-	SOInode *inode; /*Criacao do bloco de inodes, tendo cada bloco IPB inodes */
-
-	for (blk = 0; blk < p_sb->itable_size; blk++){			/*preenchimento da tabela de inodes com inodes livre*/
-	  if((s=soLoadBlockInT(blk)))
-           return s;
-         inode=soGetBlockInT();
-		for (i = 0; i < IPB; i++){
-
-     			inode[i].mode = INODE_FREE;
-     			inode[i].refcount = 0;
-     			inode[i].owner = 0;
-     			inode[i].group = 0;
-     			inode[i].size = 0;
-     			inode[i].clucount = 0;
-
-
-		/*Atribuicao aos ponteiros .prev e .next os numeros do inode anterior e seguinte, respectivamente. Criação de uma varialvel node */
-
-		uint32_t node = IPB * blk + i;
-		inode[i].vD1.prev = node-1;
-		inode[i].vD2.next = node+1;
-
-
-			for (k=0; k < N_DIRECT; k++){			/*Preenchimento da tabela de referencias directas, neste caso com null_cluster visto que estes agora estão vazias*/
-
-			inode[i].d[k]= NULL_CLUSTER;
-			}
-
-			inode[i].i1= NULL_CLUSTER;				/*referencias inderectas tbm vazias*/
-			inode[i].i2= NULL_CLUSTER;				/*referencias duplamente inderectas tbm vazias*/
-
-
-
+      if (p_sb == NULL) return -EINVAL;
 
-			if(node==0){						/*nó zero que contém o directorio raiz*/
-
-			inode[i].mode= (INODE_RD_OTH | INODE_WR_OTH  | INODE_EX_OTH  | INODE_RD_GRP  | INODE_WR_GRP | INODE_EX_GRP | INODE_RD_USR | INODE_WR_USR | INODE_EX_USR | INODE_DIR);
-			inode[i].refcount = 2;
-			inode[i].owner = getuid();
-     			inode[i].group = getgid();
-     			inode[i].size = CLUSTER_SIZE;
-     			inode[i].clucount = 1;
-			inode[i].vD1.atime = time(NULL);
-			inode[i].vD2.mtime = time(NULL);
-			inode[i].d[0]= 0;
-			}
-
-			if(node==1){						/*Caso do 1º inode livre*/
-
-			inode[i].vD1.prev= NULL_INODE;
-			inode[i].vD2.next= node+1;
-
-
-			}
-
-			if(node==p_sb->itotal-1){				/*Caso para o ultimo Inode livre da lista*/
-			inode[i].vD1.prev= node-1;
-			inode[i].vD2.next= NULL_INODE;
-
-			}
-
-		}
-	 if ((s = soStoreBlockInT ()) != 0)
-           return s;
+      return fillInTable (p_sb, p_sb->itable_start, p_sb->itable_size, fillBlocksINT, nThreads);
+    }
 
-	}
+    /*
+     * generate a run of blocks of the inode table:
+     *   all the inodes are free and form a double-linked list, from inode 1 to the last one, except inode 0, which
+     *   describes the root directory
+     */
 
-	return 0;
+    static void fillBlocksINT (SOSuperBlock *p_sb, uint32_t blk, uint32_t nblks, unsigned char *buf)
+    {
+      SOInode *inode = (SOInode *) buf;              /* inodes of the run */
+      uint32_t i, k;                                 /* inode index in the run and index of direct references */
+      uint32_t node;                                 /* inode number */
+
+      memset (buf, 0, (size_t) nblks * BLOCK_SIZE);
+      for (i = 0; i < nblks * IPB; i++)
+      { node = blk * IPB + i;
+        inode[i].mode = INODE_FREE;
+        inode[i].vD1.prev = (node == 1) ? NULL_INODE : node - 1;
+        inode[i].vD2.next = (node == p_sb->itotal - 1) ? NULL_INODE : node + 1;
+        for (k = 0; k < N_DIRECT; k++)
+          inode[i].d[k] = NULL_CLUSTER;
+        inode[i].i1 = NULL_CLUSTER;
+        inode[i].i2 = NULL_CLUSTER;
+        if (node == 0)                               /* root directory */
+           { inode[i].mode = INODE_RD_OTH | INODE_WR_OTH | INODE_EX_OTH | INODE_RD_GRP | INODE_WR_GRP | INODE_EX_GRP |
+                             INODE_RD_USR | INODE_WR_USR | INODE_EX_USR | INODE_DIR;
+             inode[i].refcount = 2;
+             inode[i].owner = getuid ();
+             inode[i].group = getgid ();
+             inode[i].size = CLUSTER_SIZE;
+             inode[i].clucount = 1;
+             inode[i].vD1.atime = time (NULL);
+             inode[i].vD2.mtime = time (NULL);
+             inode[i].d[0] = 0;
+           }
+      }
     }
 
     /* filling in the cluster-to-inode mapping table:
@@ -539,51 +688,32 @@
      *   so only the first element of the table is equal to inode 0, all the others are equal to NULL_INODE
      */
 
-    static int fillInCIT (SOSuperBlock *p_sb)
+    static int fillInCIT (SOSuperBlock *p_sb, uint32_t nThreads)
     {
-    	uint32_t ref,p_nBlk, p_offset;
-    	uint32_t* bits;
-    	int status;
-
-    	// Dá ao primeiro data cluster o valor 0
-    	if((status = soLoadBlockCTInMT(0)) != 0)
-    		return status;
-    	bits = soGetBlockCTInMT();
-    	bits[0] = 0;
-
-    	// poe todos os data clusters a NULL
-    	for(ref = 1; ref < p_sb->dzone_total; ref++)
-    	{
-
-    		if((status = soConvertRefCInMT(ref,&p_nBlk,&p_offset))!= 0)
-    				return status;
-
-    		if((p_offset) == 0)
-    		{
-    			if((status = soStoreBlockCTInMT())!= 0)
-    				return status;
-    			if((status = soLoadBlockCTInMT(p_nBlk)) != 0)
-    			{
-    				return status;
-    			}
-    				bits = soGetBlockCTInMT();
-    		}
-    		bits[p_offset] = NULL_INODE;
-
-    	}
-
-    	// preenche o resto do bloco com 0xFFFFFFFE
-    	p_offset++;
-    	for(; p_offset<RPB; p_offset++)
-    	{
-    		bits[p_offset] = 0xFFFFFFFE;
-    	}
-
-    	// Store block
-    	if(( status = soStoreBlockCTInMT()) != 0)
-    		return status;
-
-    	return 0;
+      if (p_sb == NULL) return -EINVAL;
+
+      return fillInTable (p_sb, p_sb->ciutable_start, p_sb->ciutable_size, fillBlocksCIT, nThreads);
+    }
+
+    /*
+     * generate a run of blocks of the cluster-to-inode mapping table:
+     *   the elements past the last data cluster are set to 0xFFFFFFFE
+     */
+
+    static void fillBlocksCIT (SOSuperBlock *p_sb, uint32_t blk, uint32_t nblks, unsigned char *buf)
+    {
+      uint32_t *ref = (uint32_t *) buf;              /* elements of the run */
+      uint32_t i;                                    /* element index in the run */
+      uint32_t nClust;                               /* logical number of the data cluster */
+
+      for (i = 0; i < nblks * RPB; i++)
+      { nClust = blk * RPB + i;
+        if (nClust == 0)
+           ref[i] = 0;
+           else if (nClust < p_sb->dzone_total)
+                   ref[i] = NULL_INODE;
+           else ref[i] = 0xFFFFFFFE;
+      }
     }
     /*
      * filling in the contents of the root directory:
@@ -623,53 +753,175 @@
        *   only data cluster 0 has been allocated (it stores the contents of the root directory)
        * zero fill the remaining data clusters if full formating was required:
        *   zero mode was selected
+       * discard them if discard mode was selected
        */
 
-static int fillInBitMapT (SOSuperBlock *p_sb, int zero)
-{
-	// Função criada por João Ribeiro
-  uint32_t i, bloco, byteoff, bitoff;
-  int error;
-  SODataClust clt;
-  unsigned char *p_blck;
+    static int fillInBitMapT (SOSuperBlock *p_sb, int zero, int discard, int blkdev, uint32_t nThreads)
+    {
+      uint32_t start, size;                          /* run of blocks of the free data clusters */
+      int stat;                                      /* status of operation */
+
+      if (p_sb == NULL) return -EINVAL;
+
+      if ((stat = fillInTable (p_sb, p_sb->fctable_start, p_sb->fctable_size, fillBlocksBMapT, nThreads)) != 0)
+         return stat;
+
+      /* the free data clusters were never brought into the buffercache, so they are discarded, or zero filled, straight
+         on the device: the whole run is discarded by a single request and, as a supporting file reads as zeros
+         afterwards, it only has to be zero filled if it fails, or the device is a block device */
+
+      if ((!zero && !discard) || (p_sb->dzone_total <= 1)) return 0;
+      start = p_sb->dzone_start + BLOCKS_PER_CLUSTER;
+      size = (p_sb->dzone_total - 1) * BLOCKS_PER_CLUSTER;
+      stat = soDiscardRawBlocks (start, size);
+      if (zero && ((stat != 0) || blkdev))
+         return fillInTable (p_sb, start, size, NULL, nThreads);
+
+      return (stat == -EOPNOTSUPP) ? 0 : stat;
+    }
+
+    /*
+     * generate a run of blocks of the bitmap table to free data clusters:
+     *   the bit of a free data cluster is set to 1, the most significant bit of each byte coming first; the bits past
+     *   the last data cluster are set to 0
+     */
+
+    static void fillBlocksBMapT (SOSuperBlock *p_sb, uint32_t blk, uint32_t nblks, unsigned char *buf)
+    {
+      uint32_t first, lo, hi, c;                     /* data clusters of the run */
+      uint32_t nBytes;                               /* number of whole bytes set */
+
+      memset (buf, 0, (size_t) nblks * BLOCK_SIZE);
+      first = blk * BITS_PER_BLOCK;
+      lo = (first > 1) ? first : 1;
+      hi = ((uint64_t) first + (uint64_t) nblks * BITS_PER_BLOCK < p_sb->dzone_total) ? first + nblks * BITS_PER_BLOCK
+                                                                                      : p_sb->dzone_total;
+      for (c = lo; (c < hi) && (((c - first) % 8) != 0); c++)
+        buf[(c-first)/8] |= 1 << (7 - (c - first) % 8);
+      if (c < hi)                                    /* whole bytes */
+         { nBytes = (hi - c) / 8;
+           memset (buf + (c - first) / 8, 0xFF, nBytes);
+           c += 8 * nBytes;
+         }
+      for (; c < hi; c++)
+        buf[(c-first)/8] |= 1 << (7 - (c - first) % 8);
+    }
 
-  soConvertRefBMapT(0, &bloco, &byteoff, &bitoff);	//gets ref to the first element of bmap table
+    /*
+     * fill in a table, or zero fill a run of blocks (fill is NULL):
+     *   the table is split in as many ranges of blocks as threads, each one being generated in a memory buffer
+     *   MKFS_CHUNK blocks at a time and written straight to the device by a single transfer
+     */
 
-  if((error = soLoadBlockBMapT(bloco)) != 0)		// loads the first block of bitmap
-    return error;
+    static int fillInTable (SOSuperBlock *p_sb, uint32_t start, uint32_t size, SOFillFn fill, uint32_t nThreads)
+    {
+      SOFillRange range[MKFS_THREADS];               /* ranges of blocks */
+      pthread_t thr[MKFS_THREADS];                   /* threads which process the ranges */
+      bool started[MKFS_THREADS];                    /* signals if a thread was started */
+      uint32_t t, nRanges, per;                      /* counting variables and size of a range */
+      int stat;                                      /* status of operation */
 
-  p_blck = soGetBlockBMapT();
+      if (size == 0) return 0;
+      if (nThreads == 0) nThreads = 1;
+      if (nThreads > MKFS_THREADS) nThreads = MKFS_THREADS;
+      per = (size + nThreads - 1) / nThreads;
+      per = (per + MKFS_CHUNK - 1) / MKFS_CHUNK * MKFS_CHUNK;
+
+      for (t = 0, nRanges = 0; (uint64_t) t * per < size; t++, nRanges++)
+      { range[t].p_sb = p_sb;
+        range[t].start = start;
+        range[t].first = t * per;
+        range[t].end = ((uint64_t) (t + 1) * per < size) ? (t + 1) * per : size;
+        range[t].fill = fill;
+        range[t].stat = 0;
+      }
+      for (t = 1; t < nRanges; t++)                  /* the first range is processed by the calling thread */
+        started[t] = (pthread_create (&thr[t], NULL, fillInRange, &range[t]) == 0);
+      fillInRange (&range[0]);
+      for (t = 1; t < nRanges; t++)
+        if (started[t])
+           pthread_join (thr[t], NULL);
+           else fillInRange (&range[t]);             /* the thread could not be started */
+
+      for (t = 0, stat = 0; (t < nRanges) && (stat == 0); t++)
+        stat = range[t].stat;
+
+      return stat;
+    }
 
-  memset(p_blck, 0, BLOCK_SIZE);
-  p_blck[0] = 0x7F;				// sets the first bit 0
+    /*
+     * fill in a range of blocks of a table, or zero fill it
+     */
 
-  if((error = soStoreBlockBMapT()) != 0)
-    return error;
+    static void *fillInRange (void *arg)
+    {
+      SOFillRange *p_r = (SOFillRange *) arg;        /* range of blocks */
+      unsigned char *buf;                            /* memory buffer */
+      struct iovec iov;                              /* vector of buffers */
+      uint32_t n, m;                                 /* block indexes */
+
+      if (p_r->fill == NULL)
+         { p_r->stat = soZeroRawBlocks (p_r->start + p_r->first, p_r->end - p_r->first);
+           return NULL;
+         }
 
-  for(i = 1; i < p_sb->dzone_total; i++)
-  {
-    soConvertRefBMapT(i, &bloco, &byteoff, &bitoff);	// gets references to the bmap current block
-    if((error = soLoadBlockBMapT(bloco)) != 0)
-      return error;
+      if ((buf = malloc ((size_t) MKFS_CHUNK * BLOCK_SIZE)) == NULL)
+         { p_r->stat = -ENOMEM;
+           return NULL;
+         }
+      for (n = p_r->first; (n < p_r->end) && (p_r->stat == 0); n += m)
+      { m = ((p_r->end - n) < MKFS_CHUNK) ? (p_r->end - n) : MKFS_CHUNK;
+        p_r->fill (p_r->p_sb, n, m, buf);
+        iov.iov_base = buf;
+        iov.iov_len = (size_t) m * BLOCK_SIZE;
+        p_r->stat = soWriteRawBlocks (p_r->start + n, 1, &iov);
+      }
+      free (buf);
+
+      return NULL;
+    }
+
+    /*
+     * filling in the header of the journal:
+     *   no record is expected, nor was the journal in use
+     */
+
+    static int fillInJournal (SOSuperBlock *p_sb)
+    {
+      SOJournalHeader hdr;                           /* header of the journal */
+
+      if (p_sb == NULL) return -EINVAL;
 
-    p_blck = soGetBlockBMapT();
+      memset (&hdr, 0, sizeof (hdr));
+      hdr.magic = JNL_MAGIC;
+      hdr.seq = 1;
+      hdr.open = 0;
 
-    if(byteoff == 0 && bitoff == 0) memset(p_blck, 0, BLOCK_SIZE); // if new block sets 0s   
+      return soWriteCacheBlock (p_sb->jnl_start, &hdr);
+    }
 
-    p_blck[byteoff] |= (1 << (7-bitoff));		// sets current bit not free
+    /*
+     * filling in the summary of the free data clusters:
+     *   its header is laid out right past the journal and the summary is then counted in the bitmap table and stored
+     */
 
-    if(zero)						// sets cluster data to 0
+    static int fillInFreeSummary (SOSuperBlock *p_sb)
     {
-      memset(clt.data, 0, BSLPC);
-      if((error = soWriteCacheCluster((p_sb->dzone_start + i * BLOCKS_PER_CLUSTER), &clt)) != 0)
-        return error;
+      SOFreeSummaryHeader hdr;                       /* header of the region of the summary */
+      int stat;                                      /* status of operation */
+
+      if (p_sb == NULL) return -EINVAL;
+
+      memset (&hdr, 0, sizeof (hdr));
+      hdr.magic = FSUM_MAGIC;
+      hdr.valid = 0;
+      hdr.nblocks = p_sb->fctable_size;
+      if ((stat = soWriteRawBlock (FSUM_START (p_sb), &hdr)) != 0) return stat;
+      if ((stat = soOpenFreeSummary ()) != 0) return stat;
+
+      return soCloseFreeSummary ();
     }
-    if((error = soStoreBlockBMapT()) != 0)		// saves the bmap block
-      return error;
-  }
 
-  return 0;
-}
     /*
        check the consistency of the file system metadata
      */
@@ -19,6 +19,7 @@
  *                OPTIONS:
  *                 -n name --- set volume name (default: "SOFS13")
  *                 -i num  --- set number of inodes (default: N/8, where N = number of blocks)
+ *                 -t num  --- set number of threads which fill in the tables (default: number of processors, at most 16)
  *                 -z      --- set zero mode (default: not zero)
  *                 -q      --- set quiet mode (default: not quiet)
  *                 -h      --- print this help.</PRE>
@@ -9,11 +9,82 @@
  *  <P><PRE>                mount_sofs13 [OPTIONS] supp-file mount-point
  *
  *               OPTIONS:
+ *                 -a mode  --- set update of access times: strict, relatime or noatime (default: strict)
+ *                 -b f,s   --- share a buffercache budget of s MiB with the volumes mounted with the same file f
+ *                              (default: no budget)
+ *                 -c size  --- set buffercache size in MiB (default: 25 clusters)
  *                 -d       --- set debugging mode (default: no debugging)
+ *                 -D       --- discard the data clusters freed on the storage device, unless it has a journal (default:
+ *                              keep them)
+ *                 -e       --- describe the regular files created by trees of extents (default: lists of references)
+ *                 -g       --- allocate the data clusters from allocation groups through per-thread reservations
+ *                              (default: from the shared caches of the superblock)
+ *                 -i       --- use the low-level (inode-number) FUSE frontend (default: path-based)
+ *                 -k secs  --- clean the dirty free inodes and data clusters in the background every secs s
+ *                              (default: when they are allocated)
  *                 -l depth --- set log depth (default: 0,0)
  *                 -L file  --- log file (default: stdout)
+ *                 -m       --- map the storage device into memory (default: system calls)
+ *                 -n       --- store the contents of small files and symbolic links in their inodes (default: in data
+ *                              clusters)
+ *                 -r name  --- set buffercache replacement policy: lru or 2q, with ",meta" to give priority to the
+ *                              superblock and the table of inodes (default: lru)
+ *                 -s file  --- dump the statistics of operations into file on unmounting (default: no dump)
+ *                 -t file  --- record a trace of the operations into file (default: no trace)
+ *                 -u       --- submit batches of transfers through io_uring (default: synchronous transfers)
+ *                 -w p,a,r --- set write-back flusher period (s), age (s) and dirty ratio (%) (default: 5,30,10)
+ *                 -z       --- compress the data clusters of the regular files created in groups (default: stored as
+ *                              they are)
  *                 -h       --- print this help.</PRE>
  *
+ *  The statistics of operations (counters and latency histograms of the FUSE operations, the system calls, the
+ *  buffercache and the raw transfers) may be read at any time from the extended attribute "user.sofs.stats" of the
+ *  root directory (<em>getfattr -n user.sofs.stats mount-point</em>) and are reset by setting it.
+ *
+ *  The statistics of the buffercache (hit ratios by region of the storage device, changed nodes, evictions and bytes
+ *  written back) and its parameters may be read likewise from the extended attribute "user.sofs.cache" of the root
+ *  directory. Setting it tunes the buffercache while the file system is mounted, according to the value:
+ *      \li "reset" resets its statistics
+ *      \li "capacity=size" resizes it to size MiB
+ *      \li "flusher=p,a,r" sets the write-back flusher period (s), age (s) and dirty ratio (%)
+ *      \li "policy=name" sets the replacement policy, as the -r option.
+ *
+ *  With the -i option, the low-level FUSE interface is used instead: the requests address the files by the numbers of
+ *  their inodes, so no path is resolved on each operation, and the kernel keeps the entries and the attributes it is
+ *  replied for one second. The inode of a new file is then allocated next to the inode of its directory, in the same
+ *  block of the table of inodes whenever possible (see sofs_inodeindex.h).
+ *
+ *  The regular files may be sparse: the data clusters which were never written are holes, which take no room and read
+ *  as zeros. Room may be allocated in advance, or holes punched, by fallocate (when built against libfuse 2.9 or
+ *  later), and the next data or hole of an open file is found by the ioctl commands SOFS_IOC_SEEK_DATA and
+ *  SOFS_IOC_SEEK_HOLE (see sofs_sparse.h), as FUSE does not forward the calls of lseek.
+ *
+ *  With the -D option, the data clusters freed are discarded on the storage device in batches (see sofs_discard.h),
+ *  so that a sparse supporting file, or a thin-provisioned block device, gets back the room they took.
+ *
+ *  With the -g option, each thread allocates the data clusters from a reservation drawn from a single allocation group
+ *  (see sofs_allocgroup.h), without the lock of the superblock, so that concurrent writers neither contend for it nor
+ *  interleave their files. The clusters still reserved are given back on unmounting; after an unclean shutdown they
+ *  are lost until the file system is checked.
+ *
+ *  The number of free data clusters of each block of the bitmap table is kept in memory while the file system is
+ *  mounted, so that the blocks which have none are not read when looking for free clusters, and stored on unmounting
+ *  in a region past the journal, if the formatting tool laid one out (see sofs_freesummary.h), so that it is not
+ *  counted in the whole bitmap table the next time.
+ *
+ *  With the -k option, a background thread cleans the inodes of the deleted files while the file system is idle, and
+ *  shortly after they are freed, dissociating their data clusters (see sofs_cleaner.h), so that allocating them again
+ *  does not have to.
+ *
+ *  With the -t option, every operation is recorded into a trace, with its arguments, its result and the time when it
+ *  was completed (see sofs_trace.h), so that it may be replayed offline by \e replay_sofs13. The records are written
+ *  by a background thread; an operation only waits for its record to be copied into memory.
+ *
+ *  With the -b option, the buffercache takes a share of a budget of memory common to all the volumes mounted with the
+ *  same file (see sofs_cachebudget.h), instead of a fixed capacity: a background thread resizes it periodically, so
+ *  that the idle volumes shrink and give their memory back to the system and the busy ones grow. The capacity set by
+ *  the -c option, or through the extended attribute "user.sofs.cache", only lasts until it is next resized.
+ *
  *  \author Artur Carneiro Pereira - October 2005
  *  \author Miguel Oliveira e Silva - September 2009
  *  \author João Rodrigues - September 2009
@@ -28,19 +99,103 @@
 #include <pthread.h>
 #include <errno.h>
 #include <string.h>
+#include <fcntl.h>
+#include <sys/xattr.h>
+#include <linux/falloc.h>
 #include <fuse.h>
 #include <fuse/fuse.h>
+#include <fuse/fuse_lowlevel.h>
 
 #include "sofs_probe.h"
+#include "sofs_stats.h"
+#include "sofs_trace.h"
 #include "sofs_const.h"
+#include "sofs_rawdisk.h"
+#include "sofs_buffercache.h"
+#include "sofs_cachebudget.h"
+#include "sofs_inode.h"
 #include "sofs_direntry.h"
+#include "sofs_datacluster.h"
+#include "sofs_basicoper.h"
+#include "sofs_journal.h"
+#include "sofs_ifuncs_1.h"
+#include "sofs_ifuncs_2.h"
+#include "sofs_ifuncs_3.h"
+#include "sofs_ifuncs_4.h"
+#include "sofs_delalloc.h"
+#include "sofs_openfile.h"
+#include "sofs_atime.h"
+#include "sofs_readdir.h"
+#include "sofs_extent.h"
+#include "sofs_inline.h"
+#include "sofs_compress.h"
+#include "sofs_sparse.h"
+#include "sofs_discard.h"
+#include "sofs_allocgroup.h"
+#include "sofs_cleaner.h"
+#include "sofs_inodeindex.h"
+#include "sofs_freesummary.h"
 #include "sofs_syscalls.h"
 
 /*
- *  Access with mutual exclusion to some of the operations
+ *  Access control to the operations
+ *
+ *  The operations which change the contents of a directory hold the namespace lock in exclusion. All the others share
+ *  it and hold, besides, the lock of the inode they address: in exclusion, if they change it, shared, otherwise. So,
+ *  reads and status queries on different files, or on the same file, proceed in parallel.
  */
 
-static pthread_mutex_t accessCR = PTHREAD_MUTEX_INITIALIZER;                                         /* locking flag */
+/** \brief number of locks of inodes (an inode is mapped to one of them by its number) */
+#define INODE_LOCKS  64
+
+/* lock modes */
+
+/** \brief shared lock */
+#define SHARED  0
+/** \brief exclusive lock */
+#define EXCL    1
+
+/** \brief name of the control attribute of the root directory which holds the statistics of operations */
+#define STATS_XATTR  "user.sofs.stats"
+/** \brief name of the control attribute of the root directory which holds the statistics of the buffercache */
+#define CACHE_XATTR  "user.sofs.cache"
+
+/** \brief buffer which directory entries are filled into by sofs_readdir */
+typedef struct soReaddirBuf
+{
+  /** \brief pointer to the FUSE buffer */
+  void *buf;
+  /** \brief pointer to the FUSE filler function */
+  fuse_fill_dir_t filler;
+} SOReaddirBuf;
+
+/* low-level frontend */
+
+/** \brief time (s) the kernel may keep the entries and the attributes it is replied by the low-level frontend */
+#define LL_TIMEOUT  1.0
+
+/** \brief number of the inode addressed by a FUSE inode number (FUSE_ROOT_ID is the root directory, inode 0) */
+#define LL_INODE(ino)  ((uint32_t) ((ino) - 1))
+/** \brief FUSE inode number of an inode */
+#define LL_INO(nInode)  ((fuse_ino_t) (nInode) + 1)
+/** \brief path which the control attributes of a file are got for (only the root directory holds some) */
+#define LL_XPATH(ino)  (((ino) == FUSE_ROOT_ID) ? "/" : "")
+
+/** \brief buffer which directory entries are filled into by sofs_ll_readdir */
+typedef struct soLLReaddirBuf
+{
+  /** \brief request handle */
+  fuse_req_t req;
+  /** \brief pointer to the buffer */
+  char *buf;
+  /** \brief size of the buffer */
+  size_t size;
+  /** \brief number of bytes filled */
+  size_t len;
+} SOLLReaddirBuf;
+
+static pthread_rwlock_t nsCR = PTHREAD_RWLOCK_INITIALIZER;                          /* namespace locking flag */
+static pthread_rwlock_t inodeCR[INODE_LOCKS];                                       /* inode locking flags */
 
 /*
  *  Allusion to FUSE callbacks and other internal functions
@@ -78,7 +233,81 @@ static int sofs_setxattr (const char *ePath, const char *name, const char *value
 static int sofs_getxattr (const char *ePath, const char *name, char *value, size_t size);
 static int sofs_listxattr (const char *ePath, char *list, size_t size);
 static int sofs_removexattr (const char *ePath, const char *name);
+#if FUSE_VERSION >= 29
+static int sofs_fallocate (const char *ePath, int mode, off_t offset, off_t length, struct fuse_file_info *fi);
+#endif
+static int sofs_ioctl (const char *ePath, int cmd, void *arg, struct fuse_file_info *fi, unsigned int flags,
+                       void *data);
 static void printUsage (char *cmd_name);
+static int enterNamespace (int mode);
+static int leaveNamespace (void);
+static int enterInode (const char *ePath, int mode, pthread_rwlock_t **pp_lock, uint32_t *p_nInode);
+static int enterFile (const char *ePath, struct fuse_file_info *fi, int mode, pthread_rwlock_t **pp_lock,
+                      uint32_t *p_nInode);
+static int leaveInode (pthread_rwlock_t *p_lock);
+static void dropIfRemoved (uint32_t nInode);
+static int getStats (int (*report) (char *buf, size_t size), char **p_report);
+static int tuneCache (const char *value, size_t size);
+static int setPolicy (const char *name);
+static int fillEntry (void *data, const char *name, const struct stat *st, uint32_t next);
+#if FUSE_VERSION >= 29
+static int allocRange (uint32_t nInode, int mode, off_t offset, off_t length);
+#endif
+static int seekData (uint32_t nInode, int cmd, uint64_t *p_pos);
+static int enterInodeNo (uint32_t nInode, int mode, pthread_rwlock_t **pp_lock);
+static int mountLowLevel (int argc, char *argv[]);
+static int llGetAttr (uint32_t nInode, struct stat *st);
+static int llEntry (uint32_t nInode, struct fuse_entry_param *e);
+static int llMakeNode (uint32_t nInodeDir, const char *name, uint32_t type, mode_t mode, uint32_t *p_nInode);
+static int llSymlink (uint32_t nInodeDir, const char *name, const char *effPath, uint32_t *p_nInode);
+static int llRemove (uint32_t nInodeDir, const char *name, bool isDir, uint32_t *p_nInode);
+static int llRename (uint32_t nDirOld, const char *oldName, uint32_t nDirNew, const char *newName,
+                     uint32_t *p_nReplaced);
+static int llTruncate (uint32_t nInode, off_t length);
+static int llSetAttr (uint32_t nInode, const struct stat *attr, int to_set);
+static int llOpen (uint32_t nInode, int flags, bool isDir);
+static int llFillEntry (void *data, const char *name, const struct stat *st, uint32_t next);
+static void sofs_ll_init (void *userdata, struct fuse_conn_info *fci);
+static void sofs_ll_destroy (void *userdata);
+static void sofs_ll_lookup (fuse_req_t req, fuse_ino_t parent, const char *name);
+static void sofs_ll_forget (fuse_req_t req, fuse_ino_t ino, unsigned long nlookup);
+static void sofs_ll_getattr (fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi);
+static void sofs_ll_setattr (fuse_req_t req, fuse_ino_t ino, struct stat *attr, int to_set, struct fuse_file_info *fi);
+static void sofs_ll_readlink (fuse_req_t req, fuse_ino_t ino);
+static void sofs_ll_mknod (fuse_req_t req, fuse_ino_t parent, const char *name, mode_t mode, dev_t rdev);
+static void sofs_ll_mkdir (fuse_req_t req, fuse_ino_t parent, const char *name, mode_t mode);
+static void sofs_ll_unlink (fuse_req_t req, fuse_ino_t parent, const char *name);
+static void sofs_ll_rmdir (fuse_req_t req, fuse_ino_t parent, const char *name);
+static void sofs_ll_symlink (fuse_req_t req, const char *link, fuse_ino_t parent, const char *name);
+static void sofs_ll_rename (fuse_req_t req, fuse_ino_t parent, const char *name, fuse_ino_t newparent,
+                            const char *newname);
+static void sofs_ll_link (fuse_req_t req, fuse_ino_t ino, fuse_ino_t newparent, const char *newname);
+static void sofs_ll_open (fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi);
+static void sofs_ll_read (fuse_req_t req, fuse_ino_t ino, size_t size, off_t off, struct fuse_file_info *fi);
+static void sofs_ll_write (fuse_req_t req, fuse_ino_t ino, const char *buff, size_t size, off_t off,
+                           struct fuse_file_info *fi);
+static void sofs_ll_flush (fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi);
+static void sofs_ll_release (fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi);
+static void sofs_ll_fsync (fuse_req_t req, fuse_ino_t ino, int datasync, struct fuse_file_info *fi);
+static void sofs_ll_opendir (fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi);
+static void sofs_ll_readdir (fuse_req_t req, fuse_ino_t ino, size_t size, off_t off, struct fuse_file_info *fi);
+static void sofs_ll_releasedir (fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi);
+static void sofs_ll_fsyncdir (fuse_req_t req, fuse_ino_t ino, int datasync, struct fuse_file_info *fi);
+static void sofs_ll_statfs (fuse_req_t req, fuse_ino_t ino);
+static void sofs_ll_setxattr (fuse_req_t req, fuse_ino_t ino, const char *name, const char *value, size_t size,
+                              int flags);
+static void sofs_ll_getxattr (fuse_req_t req, fuse_ino_t ino, const char *name, size_t size);
+static void sofs_ll_listxattr (fuse_req_t req, fuse_ino_t ino, size_t size);
+static void sofs_ll_removexattr (fuse_req_t req, fuse_ino_t ino, const char *name);
+static void sofs_ll_access (fuse_req_t req, fuse_ino_t ino, int mask);
+static void sofs_ll_create (fuse_req_t req, fuse_ino_t parent, const char *name, mode_t mode,
+                            struct fuse_file_info *fi);
+#if FUSE_VERSION >= 29
+static void sofs_ll_fallocate (fuse_req_t req, fuse_ino_t ino, int mode, off_t offset, off_t length,
+                               struct fuse_file_info *fi);
+#endif
+static void sofs_ll_ioctl (fuse_req_t req, fuse_ino_t ino, int cmd, void *arg, struct fuse_file_info *fi,
+                           unsigned flags, const void *in_buf, size_t in_bufsz, size_t out_bufsz);
 
 /*
  *  Set of FUSE operations (required by the FUSE filesystem)
@@ -124,14 +353,82 @@ static struct fuse_operations fuse_operations = {.getattr     = sofs_getattr,
                                                  .bmap        = NULL,
                                                  .flag_nullpath_ok = 0,
                                                  .flag_reserved = 0 ,
-                                                 .ioctl       = NULL,
-                                                 .poll        = NULL
+                                                 .ioctl       = sofs_ioctl,
+                                                 .poll        = NULL,
+#if FUSE_VERSION >= 29
+                                                 .fallocate   = sofs_fallocate
+#endif
                                                 };
 
+/*
+ *  Set of FUSE low-level operations (required by the low-level frontend)
+ */
+
+static struct fuse_lowlevel_ops fuse_ll_operations = {.init        = sofs_ll_init,
+                                                      .destroy     = sofs_ll_destroy,
+                                                      .lookup      = sofs_ll_lookup,
+                                                      .forget      = sofs_ll_forget,
+                                                      .getattr     = sofs_ll_getattr,
+                                                      .setattr     = sofs_ll_setattr,
+                                                      .readlink    = sofs_ll_readlink,
+                                                      .mknod       = sofs_ll_mknod,
+                                                      .mkdir       = sofs_ll_mkdir,
+                                                      .unlink      = sofs_ll_unlink,
+                                                      .rmdir       = sofs_ll_rmdir,
+                                                      .symlink     = sofs_ll_symlink,
+                                                      .rename      = sofs_ll_rename,
+                                                      .link        = sofs_ll_link,
+                                                      .open        = sofs_ll_open,
+                                                      .read        = sofs_ll_read,
+                                                      .write       = sofs_ll_write,
+                                                      .flush       = sofs_ll_flush,
+                                                      .release     = sofs_ll_release,
+                                                      .fsync       = sofs_ll_fsync,
+                                                      .opendir     = sofs_ll_opendir,
+                                                      .readdir     = sofs_ll_readdir,
+                                                      .releasedir  = sofs_ll_releasedir,
+                                                      .fsyncdir    = sofs_ll_fsyncdir,
+                                                      .statfs      = sofs_ll_statfs,
+                                                      .setxattr    = sofs_ll_setxattr,
+                                                      .getxattr    = sofs_ll_getxattr,
+                                                      .listxattr   = sofs_ll_listxattr,
+                                                      .removexattr = sofs_ll_removexattr,
+                                                      .access      = sofs_ll_access,
+                                                      .create      = sofs_ll_create,
+                                                      .ioctl       = sofs_ll_ioctl,
+#if FUSE_VERSION >= 29
+                                                      .fallocate   = sofs_ll_fallocate
+#endif
+                                                     };
+
 /* SOFS10 support filename (should be the absolute path) */
 
 static char *sofs_supp_file = NULL;
 
+/* statistics dump stream */
+
+static FILE *sofs_stat_file = NULL;
+
+/* trace stream */
+
+static FILE *sofs_trace_file = NULL;
+
+/* low-level frontend, if set */
+
+static int low_level = 0;
+
+/* period of the background cleaner (s) */
+
+static uint32_t clean_period = 0;
+
+/* file where the table of the buffercache budget is kept */
+
+static char *budget_file = NULL;
+
+/* number of data blocks of the buffercache budget */
+
+static uint32_t budget_size = 0;
+
 /* The main function */
 
 int main(int argc, char *argv[])
@@ -139,6 +436,8 @@ int main(int argc, char *argv[])
   int lower = 0;                                 /* lower limit of log depth, if kept set to zero */
   int higher = 0;                                /* upper limit of log depth, if kept set to zero */
   int debug_mode = 0;                            /* debugging mode, if kept set to zero */
+  int cache_size;                                /* buffercache size in MiB */
+  int period, age, ratio;                        /* write-back flusher parameters */
   FILE *fl = NULL;                               /* log stream default */
 
   /* process command line options */
@@ -146,7 +445,7 @@ int main(int argc, char *argv[])
   int opt;                                       /* selected option */
 
   do
-  { switch ((opt = getopt (argc, argv, "l:L:dh")))
+  { switch ((opt = getopt (argc, argv, "l:L:b:c:w:a:r:s:t:k:mudDegnzih")))
     { case 'l': /* log depth */
                 if (sscanf (optarg, "%d,%d", &lower, &higher) != 2)
                    { fprintf (stderr, "%s: Bad argument to l option.\n", basename (argv[0]));
@@ -163,9 +462,103 @@ int main(int argc, char *argv[])
                    }
                 soOpenProbe (fl);
                 break;
+      case 'c': /* buffercache size */
+                if ((sscanf (optarg, "%d", &cache_size) != 1) || (cache_size <= 0) ||
+                    (cache_size > (int) (UINT32_MAX / ((1024 * 1024) / BLOCK_SIZE))))
+                   { fprintf (stderr, "%s: Bad argument to c option.\n", basename (argv[0]));
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                soSetBufferCacheCapacity ((uint32_t) cache_size * ((1024 * 1024) / BLOCK_SIZE));
+                break;
+      case 'b': /* buffercache budget */
+                if (((budget_file = strrchr (optarg, ',')) == NULL) || (budget_file == optarg) ||
+                    (sscanf (budget_file + 1, "%d", &cache_size) != 1) || (cache_size <= 0) ||
+                    (cache_size > (int) (UINT32_MAX / ((1024 * 1024) / BLOCK_SIZE))))
+                   { fprintf (stderr, "%s: Bad argument to b option.\n", basename (argv[0]));
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                *budget_file = '\0';                  /* the path is what comes before the last comma */
+                budget_file = optarg;
+                budget_size = (uint32_t) cache_size * ((1024 * 1024) / BLOCK_SIZE);
+                break;
+      case 'w': /* write-back flusher */
+                if ((sscanf (optarg, "%d,%d,%d", &period, &age, &ratio) != 3) || (period < 0) || (age < 0) ||
+                    (ratio < 0) || (soSetBufferCacheFlusher ((uint32_t) period, (uint32_t) age, (uint32_t) ratio) != 0))
+                   { fprintf (stderr, "%s: Bad argument to w option.\n", basename (argv[0]));
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                break;
+      case 'k': /* background cleaner */
+                if ((sscanf (optarg, "%d", &period) != 1) || (period <= 0))
+                   { fprintf (stderr, "%s: Bad argument to k option.\n", basename (argv[0]));
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                clean_period = (uint32_t) period;
+                break;
+      case 'a': /* policy of update of the time of last access */
+                if (strcmp (optarg, "strict") == 0)
+                   soSetAtimePolicy (ATIME_STRICT);
+                   else if (strcmp (optarg, "relatime") == 0)
+                           soSetAtimePolicy (ATIME_RELATIME);
+                   else if (strcmp (optarg, "noatime") == 0)
+                           soSetAtimePolicy (ATIME_NONE);
+                   else { fprintf (stderr, "%s: Bad argument to a option.\n", basename (argv[0]));
+                          printUsage (basename (argv[0]));
+                          return EXIT_FAILURE;
+                        }
+                break;
+      case 'r': /* buffercache replacement policy */
+                if (setPolicy (optarg) != 0)
+                   { fprintf (stderr, "%s: Bad argument to r option.\n", basename (argv[0]));
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                break;
+      case 's': /* statistics dump file */
+                if ((sofs_stat_file = fopen (optarg, "w")) == NULL)
+                   { fprintf (stderr, "%s: Can't open statistics file \"%s\".\n", basename (argv[0]), optarg);
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                break;
+      case 't': /* trace file */
+                if ((sofs_trace_file = fopen (optarg, "w")) == NULL)
+                   { fprintf (stderr, "%s: Can't open trace file \"%s\".\n", basename (argv[0]), optarg);
+                     printUsage (basename (argv[0]));
+                     return EXIT_FAILURE;
+                   }
+                break;
+      case 'm': /* memory-mapped device */
+                soSetDeviceBackend (RAW_MMAP);   /* it falls back to system calls, if the mapping fails */
+                break;
+      case 'u': /* io_uring transfers */
+                soSetDeviceBackend (RAW_URING);  /* it falls back to synchronous transfers, if not available */
+                break;
       case 'd': /* debugging mode */
                 debug_mode = 1;                  /* set debugging mode for processing: no FUSE messages are issued */
                 break;
+      case 'D': /* discard of the data clusters freed */
+                soSetDiscard (true);             /* it is turned off, if the storage device does not allow it */
+                break;
+      case 'e': /* trees of extents */
+                soSetExtentFormat (true);        /* the files already created keep their format */
+                break;
+      case 'g': /* allocation groups */
+                soSetAllocGroups (true);         /* they are built on mounting */
+                break;
+      case 'n': /* contents stored in the inodes */
+                soSetInlineData (true);          /* the files already created keep their format */
+                break;
+      case 'z': /* compressed data clusters */
+                soSetCompression (true);         /* the files already created keep their format */
+                break;
+      case 'i': /* low-level frontend */
+                low_level = 1;                   /* the requests address the inodes by their numbers */
+                break;
       case 'h': /* help mode */
                 printUsage (basename (argv[0]));
                 return EXIT_SUCCESS;
@@ -192,6 +585,17 @@ int main(int argc, char *argv[])
      fl = stdout;                                /* if the switch -L was not used, set output to stdout */
      else stderr = fl;                           /* if the switch -L was used, set stderr to log file */
 
+  /* gather the statistics of operations */
+
+  soStatEnable (1);
+
+  /* set up the locks of inodes */
+
+  int i;                                         /* counting variable */
+
+  for (i = 0; i < INODE_LOCKS; i++)
+    pthread_rwlock_init (&inodeCR[i], NULL);
+
   /* build argv and argc for fuse_main */
 
   char *fuse_argv[] = { argv[0], argv[optind+1],
@@ -203,6 +607,8 @@ int main(int argc, char *argv[])
                       };
   int fuse_argc = (debug_mode) ? 9 : 8;
 
+  if (low_level)
+     return mountLowLevel (fuse_argc, fuse_argv);
   return fuse_main (fuse_argc, fuse_argv, &fuse_operations, NULL);
 }
 
@@ -214,12 +620,328 @@ static void printUsage (char *cmd_name)
 {
   printf ("Sinopsis: %s [OPTIONS] supp-file mount-point\n"
           "  OPTIONS:\n"
+          "  -a mode  --- set update of access times: strict, relatime or noatime (default: strict)\n"
+          "  -b f,s   --- share a buffercache budget of s MiB with the volumes mounted with the same file f\n"
+          "               (default: no budget)\n"
+          "  -c size  --- set buffercache size in MiB (default: 25 clusters)\n"
           "  -d       --- set debugging mode (default: no debugging)\n"
+          "  -D       --- discard the data clusters freed on the storage device, unless it has a journal (default:\n"
+          "               keep them)\n"
+          "  -e       --- describe the regular files created by trees of extents (default: lists of references)\n"
+          "  -g       --- allocate the data clusters from allocation groups through per-thread reservations\n"
+          "               (default: from the shared caches of the superblock)\n"
+          "  -i       --- use the low-level (inode-number) FUSE frontend (default: path-based)\n"
+          "  -k secs  --- clean the dirty free inodes and data clusters in the background every secs s\n"
+          "               (default: when they are allocated)\n"
           "  -l depth --- set log depth (default: 0,0)\n"
           "  -L file  --- log file (default: stdout)\n"
+          "  -m       --- map the storage device into memory (default: system calls)\n"
+          "  -n       --- store the contents of small files and symbolic links in their inodes (default: in data\n"
+          "               clusters)\n"
+          "  -r name  --- set buffercache replacement policy: lru or 2q, with \",meta\" to give priority to the\n"
+          "               superblock and the table of inodes (default: lru)\n"
+          "  -s file  --- dump the statistics of operations into file on unmounting (default: no dump)\n"
+          "  -t file  --- record a trace of the operations into file (default: no trace)\n"
+          "  -u       --- submit batches of transfers through io_uring (default: synchronous transfers)\n"
+          "  -w p,a,r --- set write-back flusher period (s), age (s) and dirty ratio (%%) (default: 5,30,10)\n"
+          "  -z       --- compress the data clusters of the regular files created in groups (default: stored as\n"
+          "               they are)\n"
           "  -h       --- print this help\n", cmd_name);
 }
 
+/*
+ * run the low-level frontend: the arguments are those fuse_main would be given
+ */
+
+static int mountLowLevel (int argc, char *argv[])
+{
+  struct fuse_args args = FUSE_ARGS_INIT (argc, argv);
+  struct fuse_chan *ch;
+  struct fuse_session *se;
+  char *mountpoint = NULL;
+  int multithreaded, foreground;
+  int err = -1;
+
+  if ((fuse_parse_cmdline (&args, &mountpoint, &multithreaded, &foreground) != -1) &&
+      ((ch = fuse_mount (mountpoint, &args)) != NULL))
+     { if ((se = fuse_lowlevel_new (&args, &fuse_ll_operations, sizeof (fuse_ll_operations), NULL)) != NULL)
+          { fuse_session_add_chan (se, ch);
+            if ((fuse_daemonize (foreground) != -1) && (fuse_set_signal_handlers (se) != -1))
+               { err = multithreaded ? fuse_session_loop_mt (se) : fuse_session_loop (se);
+                 fuse_remove_signal_handlers (se);
+               }
+            fuse_session_remove_chan (ch);
+            fuse_session_destroy (se);
+          }
+       fuse_unmount (mountpoint, ch);
+     }
+  free (mountpoint);
+  fuse_opt_free_args (&args);
+
+  return (err == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/*
+ * lock the namespace, either in exclusion or shared, and open a transaction, so that the updates of metadata of the
+ * operation are stored together
+ */
+
+static int enterNamespace (int mode)
+{
+  int stat;                                      /* status of operation */
+
+  stat = (mode == EXCL) ? pthread_rwlock_wrlock (&nsCR) : pthread_rwlock_rdlock (&nsCR);
+  if (stat == 0) soBeginTransaction ();
+
+  return stat;
+}
+
+/*
+ * commit the transaction and unlock the namespace
+ */
+
+static int leaveNamespace (void)
+{
+  int stat;                                      /* status of operation */
+
+  stat = soCommitTransaction ();
+  if (pthread_rwlock_unlock (&nsCR) != 0) stat = -ENOLCK;
+
+  return stat;
+}
+
+/*
+ * lock the namespace shared and the inode a path refers to, either in exclusion or shared, and get its number, if
+ * required (p_nInode is not NULL); if the path can not be resolved, no inode is locked, the number is NULL_INODE and
+ * the operation itself will report the error, since the namespace can not change meanwhile
+ */
+
+static int enterInode (const char *ePath, int mode, pthread_rwlock_t **pp_lock, uint32_t *p_nInode)
+{
+  uint32_t nInode;                               /* number of the inode */
+  int stat;                                      /* status of operation */
+
+  *pp_lock = NULL;
+  if (p_nInode != NULL) *p_nInode = NULL_INODE;
+  if ((stat = enterNamespace (SHARED)) != 0) return stat;
+  if (soGetDirEntryByPath (ePath, NULL, &nInode) != 0) return 0;
+  if (p_nInode != NULL) *p_nInode = nInode;
+  *pp_lock = &inodeCR[nInode % INODE_LOCKS];
+  stat = (mode == EXCL) ? pthread_rwlock_wrlock (*pp_lock) : pthread_rwlock_rdlock (*pp_lock);
+  if (stat != 0)
+     { *pp_lock = NULL;
+       leaveNamespace ();
+     }
+
+  return stat;
+}
+
+/*
+ * lock the namespace shared and the inode of an open file, either in exclusion or shared, and get its number: the inode
+ * is got from the open-file handle, if there is one, so that the path need not be resolved
+ */
+
+static int enterFile (const char *ePath, struct fuse_file_info *fi, int mode, pthread_rwlock_t **pp_lock,
+                      uint32_t *p_nInode)
+{
+  if ((fi == NULL) || (soGetFhInode ((uint32_t) fi->fh, p_nInode) != 0))
+     return enterInode (ePath, mode, pp_lock, p_nInode);
+
+  return enterInodeNo (*p_nInode, mode, pp_lock);
+}
+
+/*
+ * lock the namespace shared and an inode given its number, either in exclusion or shared
+ */
+
+static int enterInodeNo (uint32_t nInode, int mode, pthread_rwlock_t **pp_lock)
+{
+  int stat;                                      /* status of operation */
+
+  *pp_lock = NULL;
+  if ((stat = enterNamespace (SHARED)) != 0) return stat;
+  *pp_lock = &inodeCR[nInode % INODE_LOCKS];
+  stat = (mode == EXCL) ? pthread_rwlock_wrlock (*pp_lock) : pthread_rwlock_rdlock (*pp_lock);
+  if (stat != 0)
+     { *pp_lock = NULL;
+       leaveNamespace ();
+     }
+
+  return stat;
+}
+
+/*
+ * unlock the inode, if any, and the namespace
+ */
+
+static int leaveInode (pthread_rwlock_t *p_lock)
+{
+  int stat = 0;                                  /* status of operation */
+
+  if (p_lock != NULL) stat = pthread_rwlock_unlock (p_lock);
+  if (leaveNamespace () != 0) stat = -ENOLCK;
+
+  return stat;
+}
+
+/*
+ * drop the buffered data of a file whose last link was removed (its inode is no longer in use)
+ */
+
+static void dropIfRemoved (uint32_t nInode)
+{
+  SOInode inode;                                 /* inode associated to the file */
+
+  if (soReadInode (&inode, nInode, IUIN) != 0)
+     soDelAllocDrop (nInode, 0);
+}
+
+/*
+ * get the report of the statistics of operations in a buffer allocated for it, which must be freed by the caller
+ */
+
+static int getStats (int (*report) (char *buf, size_t size), char **p_report)
+{
+  int len, size;
+
+  if ((len = report (NULL, 0)) < 0) return len;
+  do
+  { size = len + 1;                              /* the report may grow meanwhile */
+    if ((*p_report = malloc ((size_t) size)) == NULL) return -ENOMEM;
+    if ((len = report (*p_report, (size_t) size)) < 0)
+       { free (*p_report);
+         return len;
+       }
+    if (len >= size) free (*p_report);
+  } while (len >= size);
+
+  return len;
+}
+
+/*
+ *  Tune the buffercache according to the value the control attribute "user.sofs.cache" was set to.
+ */
+
+static int tuneCache (const char *value, size_t size)
+{
+  char cmd[64];
+  unsigned int cache_size, period, age, ratio;
+  char tail;
+
+  if (size >= sizeof (cmd)) return -EINVAL;
+  memcpy (cmd, value, size);
+  cmd[size] = '\0';
+  if ((size > 0) && (cmd[size-1] == '\n')) cmd[size-1] = '\0';
+
+  if (strcmp (cmd, "reset") == 0)
+     { soResetBufferCacheStats ();
+       return 0;
+     }
+  if (sscanf (cmd, "capacity=%u%c", &cache_size, &tail) == 1)
+     { if ((cache_size == 0) || (cache_size > UINT32_MAX / ((1024 * 1024) / BLOCK_SIZE))) return -EINVAL;
+       return soSetBufferCacheCapacity ((uint32_t) cache_size * ((1024 * 1024) / BLOCK_SIZE));
+     }
+  if (sscanf (cmd, "flusher=%u,%u,%u%c", &period, &age, &ratio, &tail) == 3)
+     return soSetBufferCacheFlusher ((uint32_t) period, (uint32_t) age, (uint32_t) ratio);
+  if (strncmp (cmd, "policy=", 7) == 0)
+     return setPolicy (cmd + 7);
+
+  return -EINVAL;
+}
+
+/*
+ *  Set the buffercache replacement policy by name: "lru" or "2q", optionally followed by ",meta", which gives priority
+ *  to the superblock and the table of inodes.
+ */
+
+static int setPolicy (const char *name)
+{
+  uint32_t prio = 0;
+  size_t len;
+
+  len = strlen (name);
+  if ((len > 5) && (strcmp (name + len - 5, ",meta") == 0))
+     { prio = (1U << BC_SUPERBLOCK) | (1U << BC_ITABLE);
+       len -= 5;
+     }
+  if ((len == 3) && (strncmp (name, "lru", 3) == 0))
+     return soSetBufferCachePolicy (BC_LRU, prio);
+  if ((len == 2) && (strncmp (name, "2q", 2) == 0))
+     return soSetBufferCachePolicy (BC_2Q, prio);
+
+  return -EINVAL;
+}
+
+/*
+ *  Fill a directory entry, together with the attributes of the file it refers to, into the FUSE buffer; a non-zero
+ *  value is returned when the buffer is full.
+ */
+
+static int fillEntry (void *data, const char *name, const struct stat *st, uint32_t next)
+{
+  SOReaddirBuf *p_rd = (SOReaddirBuf *) data;
+  struct stat est = *st;
+  uint32_t size;
+
+  if (S_ISREG (est.st_mode))                                         /* data may still be buffered */
+     { size = (uint32_t) est.st_size;
+       soDelAllocSize ((uint32_t) est.st_ino, &size);
+       est.st_size = size;
+     }
+
+  return p_rd->filler (p_rd->buf, name, &est, (off_t) next);
+}
+
+#if FUSE_VERSION >= 29
+
+/*
+ * allocate the data clusters of a range of a regular file, growing it unless its size is to be kept, or punch a hole
+ * in it, which keeps its size, as fallocate does: the buffered data is written back first
+ */
+
+static int allocRange (uint32_t nInode, int mode, off_t offset, off_t length)
+{
+  int stat;
+
+  if ((offset < 0) || (length <= 0)) return -EINVAL;
+  if ((mode & ~(FALLOC_FL_KEEP_SIZE | FALLOC_FL_PUNCH_HOLE)) ||
+      ((mode & FALLOC_FL_PUNCH_HOLE) && !(mode & FALLOC_FL_KEEP_SIZE)))
+     return -EOPNOTSUPP;
+  if ((stat = soDelAllocFlush (nInode)) != 0) return stat;
+
+  if (mode & FALLOC_FL_PUNCH_HOLE)                                  /* there is nothing past the maximum size */
+     { if (offset >= (off_t) MAX_FILE_SIZE) return 0;
+       if (length > (off_t) MAX_FILE_SIZE - offset) length = (off_t) MAX_FILE_SIZE - offset;
+       return soPunchFileHole (nInode, (uint32_t) offset, (uint32_t) length);
+     }
+  if (offset + length > (off_t) MAX_FILE_SIZE) return -EFBIG;
+
+  return soAllocFileRange (nInode, (uint32_t) offset, (uint32_t) length, (mode & FALLOC_FL_KEEP_SIZE) != 0);
+}
+
+#endif
+
+/*
+ * find the next data or the next hole of a regular file, as lseek does with SEEK_DATA or SEEK_HOLE, on the ioctl
+ * commands SOFS_IOC_SEEK_DATA and SOFS_IOC_SEEK_HOLE (FUSE does not forward lseek): the buffered data is written back
+ * first, so that it is not taken as a hole
+ */
+
+static int seekData (uint32_t nInode, int cmd, uint64_t *p_pos)
+{
+  uint32_t pos;
+  int stat;
+
+  if (((unsigned int) cmd != SOFS_IOC_SEEK_DATA) && ((unsigned int) cmd != SOFS_IOC_SEEK_HOLE)) return -ENOTTY;
+  if ((stat = soDelAllocFlush (nInode)) != 0) return stat;
+  if (*p_pos >= MAX_FILE_SIZE) return -ENXIO;
+  if ((stat = soSeekFileData (nInode, (uint32_t) *p_pos, (unsigned int) cmd == SOFS_IOC_SEEK_HOLE, &pos)) != 0)
+     return stat;
+  *p_pos = pos;
+
+  return 0;
+}
+
 /* Functions to be implemented */
 
 /**
@@ -239,9 +961,22 @@ static void *sofs_mount (struct fuse_conn_info* fci)
 {
   soColorProbe (111, "07;31", "sofs_mount_bin ()\n");
 
+  soStatScope (STAT_FUSE_INIT);
+
   int stat;
 
-  if ((stat = soMountSOFS (sofs_supp_file)) != 0) return NULL;
+  if ((stat = soReplayJournal (sofs_supp_file, NULL)) != 0) return NULL;           /* after an unclean shutdown */
+  if ((stat = soStatCall (STAT_SC_MOUNT, soMountSOFS (sofs_supp_file))) != 0) return NULL;
+  soOpenJournal ();                                                  /* without it, updates are written in place */
+  if ((stat = soOpenFreeSummary ()) != 0) return NULL;
+  if ((stat = soOpenAllocGroups ()) != 0) return NULL;
+  soOpenInodeIndex ();                                               /* without it, inodes are taken in list order */
+  if (clean_period != 0) soStartCleaner (clean_period);             /* without it, they are cleaned when allocated */
+  if (budget_file != NULL) soJoinCacheBudget (budget_file, budget_size);    /* without it, the capacity is fixed */
+  if (sofs_trace_file != NULL)                                       /* the stream is closed when it is stopped */
+     { if (soTraceStart (sofs_trace_file, TRACE_RING, low_level != 0) != 0) fclose (sofs_trace_file);
+       sofs_trace_file = NULL;
+     }
   return sofs_supp_file;
 }
 
@@ -259,11 +994,29 @@ static void sofs_unmount (void *path)
 {
   soColorProbe (112, "07;31", "sofs_unmount_bin (\"%s\")\n", (char *) path);
 
-  pthread_mutex_lock (&accessCR);                                    /* enter critical region */
-
-  soUnmountSOFS ();
+  soStatScope (STAT_FUSE_DESTROY);
+
+  pthread_rwlock_wrlock (&nsCR);                                     /* enter critical region */
+
+  soTraceStop ();
+  soLeaveCacheBudget ();
+  soStopCleaner ();                                                  /* before the last transaction */
+  soBeginTransaction ();
+  soDelAllocFlushAll ();
+  soAtimeSyncAll ();
+  soCloseAllocGroups ();                                             /* the reserved clusters are given back */
+  soCommitTransaction ();                                            /* before the storage device is closed */
+  soCloseFreeSummary ();                                             /* after the last change of the bitmap table */
+  soCloseInodeIndex ();
+  soCloseJournal ();
+  soStatCall (STAT_SC_UNMOUNT, soUnmountSOFS ());
+  if (sofs_stat_file != NULL)
+     { soStatPrint (sofs_stat_file);
+       fclose (sofs_stat_file);
+       sofs_stat_file = NULL;
+     }
 
-  pthread_mutex_unlock (&accessCR);                                  /* exit critical region */
+  pthread_rwlock_unlock (&nsCR);                                     /* exit critical region */
 }
 
 /**
@@ -284,14 +1037,24 @@ static int sofs_getattr (const char *ePath, struct stat *st)
 {
   soColorProbe (113, "07;31", "sofs_getattr_bin (\"%s\", %p)\n", ePath, st);
 
+  soStatScope (STAT_FUSE_GETATTR);
+
   int stat;
+  pthread_rwlock_t *p_lock;
+  uint32_t nInode, size;
 
-  if (pthread_mutex_lock (&accessCR) != 0)                           /* enter critical region */
+  if (enterInode (ePath, SHARED, &p_lock, &nInode) != 0)           /* enter critical region */
      return -ENOLCK;
 
-  stat = soStat (ePath, st);
+  stat = soStatCall (STAT_SC_STAT, soStat (ePath, st));
+  if ((stat == 0) && S_ISREG (st->st_mode))                          /* data may still be buffered */
+     { size = (uint32_t) st->st_size;
+       soDelAllocSize (nInode, &size);
+       st->st_size = size;
+     }
+  soTrace (TRACE_GETATTR, TRACE_NO_INODE, TRACE_NO_INODE, ePath, NULL, 0, 0, 0, stat);
 
-  if (pthread_mutex_unlock (&accessCR) != 0)                         /* exit critical region */
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
      return -ENOLCK;
 
   return stat;
@@ -314,14 +1077,18 @@ static int sofs_access (const char *ePath, int opRequested)
 {
   soColorProbe (114, "07;31", "sofs_access_bin (\"%s\", %x)\n", ePath, opRequested);
 
+  soStatScope (STAT_FUSE_ACCESS);
+
   int stat;
+  pthread_rwlock_t *p_lock;
 
-  if (pthread_mutex_lock (&accessCR) != 0)                           /* enter critical region */
+  if (enterInode (ePath, SHARED, &p_lock, NULL) != 0)              /* enter critical region */
      return -ENOLCK;
 
-  stat = soAccess (ePath, opRequested);
+  stat = soStatCall (STAT_SC_ACCESS, soAccess (ePath, opRequested));
+  soTrace (TRACE_ACCESS, TRACE_NO_INODE, TRACE_NO_INODE, ePath, NULL, 0, 0, opRequested, stat);
 
-  if (pthread_mutex_unlock (&accessCR) != 0)                         /* exit critical region */
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
      return -ENOLCK;
 
   return stat;
@@ -346,14 +1113,17 @@ static int sofs_mknod (const char *ePath, mode_t mode, dev_t rdev)
 {
   soColorProbe (115, "07;31", "sofs_mknod_bin (\"%s\", %x, %x)\n", ePath, (uint32_t) mode, (uint32_t) rdev);
 
+  soStatScope (STAT_FUSE_MKNOD);
+
   int stat;
 
-  if (pthread_mutex_lock (&accessCR) != 0)                           /* enter critical region */
+  if (enterNamespace (EXCL) != 0)                                  /* enter critical region */
      return -ENOLCK;
 
-  stat = soMknod (ePath, mode);
+  stat = soStatCall (STAT_SC_MKNOD, soMknod (ePath, mode));
+  soTrace (TRACE_MKNOD, TRACE_NO_INODE, TRACE_NO_INODE, ePath, NULL, 0, 0, mode, stat);
 
-  if (pthread_mutex_unlock (&accessCR) != 0)                         /* exit critical region */
+  if (leaveNamespace () != 0)                                        /* exit critical region */
      return -ENOLCK;
 
   return stat;
@@ -377,14 +1147,17 @@ static int sofs_mkdir (const char *ePath, mode_t mode)
 {
   soColorProbe (116, "07;31", "sofs_mkdir_bin (\"%s\", %x)\n", ePath, (uint32_t) mode);
 
+  soStatScope (STAT_FUSE_MKDIR);
+
   int stat;
 
-  if (pthread_mutex_lock (&accessCR) != 0)                           /* enter critical region */
+  if (enterNamespace (EXCL) != 0)                                  /* enter critical region */
      return -ENOLCK;
 
-  stat = soMkdir (ePath, mode | S_IFDIR);
+  stat = soStatCall (STAT_SC_MKDIR, soMkdir (ePath, mode | S_IFDIR));
+  soTrace (TRACE_MKDIR, TRACE_NO_INODE, TRACE_NO_INODE, ePath, NULL, 0, 0, mode, stat);
 
-  if (pthread_mutex_unlock (&accessCR) != 0)                         /* exit critical region */
+  if (leaveNamespace () != 0)                                        /* exit critical region */
      return -ENOLCK;
 
   return stat;
@@ -404,14 +1177,22 @@ static int sofs_unlink (const char *ePath)
 {
   soColorProbe (117, "07;31", "sofs_unlink_bin (\"%s\")\n", ePath);
 
+  soStatScope (STAT_FUSE_UNLINK);
+
   int stat;
+  uint32_t nInode;
 
-  if (pthread_mutex_lock (&accessCR) != 0)                           /* enter critical region */
+  if (enterNamespace (EXCL) != 0)                                  /* enter critical region */
      return -ENOLCK;
 
-  stat = soUnlink (ePath);
+  if (soGetDirEntryByPath (ePath, NULL, &nInode) != 0)
+     nInode = NULL_INODE;
+  stat = soStatCall (STAT_SC_UNLINK, soUnlink (ePath));
+  if ((stat == 0) && (nInode != NULL_INODE))                         /* a removed file loses its buffered data */
+     dropIfRemoved (nInode);
+  soTrace (TRACE_UNLINK, TRACE_NO_INODE, TRACE_NO_INODE, ePath, NULL, 0, 0, 0, stat);
 
-  if (pthread_mutex_unlock (&accessCR) != 0)                         /* exit critical region */
+  if (leaveNamespace () != 0)                                        /* exit critical region */
      return -ENOLCK;
 
   return stat;
@@ -431,14 +1212,17 @@ static int sofs_rmdir (const char *ePath)
 {
   soColorProbe (118, "07;31", "sofs_rmdir_bin (\"%s\")\n", ePath);
 
+  soStatScope (STAT_FUSE_RMDIR);
+
   int stat;
 
-  if (pthread_mutex_lock (&accessCR) != 0)                           /* enter critical region */
+  if (enterNamespace (EXCL) != 0)                                  /* enter critical region */
      return -ENOLCK;
 
-  stat = soRmdir (ePath);
+  stat = soStatCall (STAT_SC_RMDIR, soRmdir (ePath));
+  soTrace (TRACE_RMDIR, TRACE_NO_INODE, TRACE_NO_INODE, ePath, NULL, 0, 0, 0, stat);
 
-  if (pthread_mutex_unlock (&accessCR) != 0)                         /* exit critical region */
+  if (leaveNamespace () != 0)                                        /* exit critical region */
      return -ENOLCK;
 
   return stat;
@@ -459,14 +1243,22 @@ static int sofs_rename (const char *oldPath, const char *newPath)
 {
   soColorProbe (119, "07;31", "sofs_rename_bin (\"%s\", \"%s\")\n", oldPath, newPath);
 
+  soStatScope (STAT_FUSE_RENAME);
+
   int stat;
+  uint32_t nInode;
 
-  if (pthread_mutex_lock (&accessCR) != 0)                           /* enter critical region */
+  if (enterNamespace (EXCL) != 0)                                  /* enter critical region */
      return -ENOLCK;
 
-  stat = soRename (oldPath, newPath);
+  if (soGetDirEntryByPath (newPath, NULL, &nInode) != 0)
+     nInode = NULL_INODE;
+  stat = soStatCall (STAT_SC_RENAME, soRename (oldPath, newPath));
+  if ((stat == 0) && (nInode != NULL_INODE))                         /* a replaced file loses its buffered data */
+     dropIfRemoved (nInode);
+  soTrace (TRACE_RENAME, TRACE_NO_INODE, TRACE_NO_INODE, oldPath, newPath, 0, 0, 0, stat);
 
-  if (pthread_mutex_unlock (&accessCR) != 0)                         /* exit critical region */
+  if (leaveNamespace () != 0)                                        /* exit critical region */
      return -ENOLCK;
 
   return stat;
@@ -486,14 +1278,17 @@ static int sofs_link (const char *oldPath, const char *newPath)
 {
   soColorProbe (120, "07;31", "sofs_link_bin (\"%s\", \"%s\")\n", oldPath, newPath);
 
+  soStatScope (STAT_FUSE_LINK);
+
   int stat;
 
-  if (pthread_mutex_lock (&accessCR) != 0)                           /* enter critical region */
+  if (enterNamespace (EXCL) != 0)                                  /* enter critical region */
      return -ENOLCK;
 
-  stat = soLink (oldPath, newPath);
+  stat = soStatCall (STAT_SC_LINK, soLink (oldPath, newPath));
+  soTrace (TRACE_LINK, TRACE_NO_INODE, TRACE_NO_INODE, oldPath, newPath, 0, 0, 0, stat);
 
-  if (pthread_mutex_unlock (&accessCR) != 0)                         /* exit critical region */
+  if (leaveNamespace () != 0)                                        /* exit critical region */
      return -ENOLCK;
 
   return stat;
@@ -513,14 +1308,18 @@ static int sofs_chmod (const char *ePath, mode_t mode)
 {
   soColorProbe (121, "07;31", "sofs_chmod_bin (\"%s\", 0%o)\n", ePath, (uint32_t) mode);
 
+  soStatScope (STAT_FUSE_CHMOD);
+
   int stat;
+  pthread_rwlock_t *p_lock;
 
-  if (pthread_mutex_lock (&accessCR) != 0)                           /* enter critical region */
+  if (enterInode (ePath, EXCL, &p_lock, NULL) != 0)                /* enter critical region */
      return -ENOLCK;
 
-  stat = soChmod (ePath, mode);
+  stat = soStatCall (STAT_SC_CHMOD, soChmod (ePath, mode));
+  soTrace (TRACE_CHMOD, TRACE_NO_INODE, TRACE_NO_INODE, ePath, NULL, 0, 0, mode, stat);
 
-  if (pthread_mutex_unlock (&accessCR) != 0)                         /* exit critical region */
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
      return -ENOLCK;
 
   return stat;
@@ -542,14 +1341,18 @@ static int sofs_chown (const char *ePath, uid_t owner, gid_t group)
   soColorProbe (122, "07;31", "sofs_chown_bin (\"%s\", %"PRIu32", %"PRIu32")\n", ePath, (uint32_t) owner,
 		        (uint32_t) group);
 
+  soStatScope (STAT_FUSE_CHOWN);
+
   int stat;
+  pthread_rwlock_t *p_lock;
 
-  if (pthread_mutex_lock (&accessCR) != 0)                           /* enter critical region */
+  if (enterInode (ePath, EXCL, &p_lock, NULL) != 0)                /* enter critical region */
      return -ENOLCK;
 
-  stat = soChown (ePath, owner, group);
+  stat = soStatCall (STAT_SC_CHOWN, soChown (ePath, owner, group));
+  soTrace (TRACE_CHOWN, TRACE_NO_INODE, TRACE_NO_INODE, ePath, NULL, owner, group, 0, stat);
 
-  if (pthread_mutex_unlock (&accessCR) != 0)                         /* exit critical region */
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
      return -ENOLCK;
 
   return stat;
@@ -569,14 +1372,23 @@ static int sofs_truncate (const char *ePath, off_t length)
 {
   soColorProbe (123, "07;31", "sofs_truncate_bin (\"%s\", %u)\n", ePath, (uint32_t) length);
 
+  soStatScope (STAT_FUSE_TRUNCATE);
+
   int stat;
+  pthread_rwlock_t *p_lock;
+  uint32_t nInode;
 
-  if (pthread_mutex_lock (&accessCR) != 0)                           /* enter critical region */
+  if (enterInode (ePath, EXCL, &p_lock, &nInode) != 0)             /* enter critical region */
      return -ENOLCK;
 
-  stat = soTruncate (ePath, length);
+  if (nInode != NULL_INODE)                                          /* the data clusters not written are left as holes */
+     stat = soStatCall (STAT_SC_TRUNCATE, llTruncate (nInode, length));
+     else stat = soStatCall (STAT_SC_TRUNCATE, soTruncate (ePath, length));
+  if ((stat == 0) && (nInode != NULL_INODE) && (length >= 0))       /* the buffered data past the end is dropped */
+     soDelAllocDrop (nInode, (length > (off_t) MAX_FILE_SIZE) ? MAX_FILE_SIZE : (uint32_t) length);
+  soTrace (TRACE_TRUNCATE, TRACE_NO_INODE, TRACE_NO_INODE, ePath, NULL, 0, length, 0, stat);
 
-  if (pthread_mutex_unlock (&accessCR) != 0)                         /* exit critical region */
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
      return -ENOLCK;
 
   return stat;
@@ -599,14 +1411,19 @@ static int sofs_utime (const char *ePath, struct utimbuf *times)
 {
   soColorProbe (124, "07;31", "sofs_utime_bin (\"%s\", %p)\n", ePath, times);
 
+  soStatScope (STAT_FUSE_UTIME);
+
   int stat;
+  pthread_rwlock_t *p_lock;
 
-  if (pthread_mutex_lock (&accessCR) != 0)                           /* enter critical region */
+  if (enterInode (ePath, EXCL, &p_lock, NULL) != 0)                /* enter critical region */
      return -ENOLCK;
 
-  stat = soUtime (ePath, times);
+  stat = soStatCall (STAT_SC_UTIME, soUtime (ePath, times));
+  soTrace (TRACE_UTIME, TRACE_NO_INODE, TRACE_NO_INODE, ePath, NULL, (times != NULL) ? times->actime : 0,
+           (times != NULL) ? times->modtime : 0, times != NULL, stat);
 
-  if (pthread_mutex_unlock (&accessCR) != 0)                         /* exit critical region */
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
      return -ENOLCK;
 
   return stat;
@@ -629,14 +1446,17 @@ static int sofs_statfs (const char *ePath, struct statvfs *st)
 {
   soColorProbe (125, "07;31", "sofs_statfs_bin (\"%s\", %p)\n", ePath, st);
 
+  soStatScope (STAT_FUSE_STATFS);
+
   int stat;
 
-  if (pthread_mutex_lock (&accessCR) != 0)                           /* enter critical region */
+  if (enterNamespace (SHARED) != 0)                                /* enter critical region */
      return -ENOLCK;
 
-  stat = soStatFS (ePath, st);
+  stat = soStatCall (STAT_SC_STATFS, soStatFS (ePath, st));
+  soTrace (TRACE_STATFS, TRACE_NO_INODE, TRACE_NO_INODE, ePath, NULL, 0, 0, 0, stat);
 
-  if (pthread_mutex_unlock (&accessCR) != 0)                         /* exit critical region */
+  if (leaveNamespace () != 0)                                        /* exit critical region */
      return -ENOLCK;
 
   return stat;
@@ -663,15 +1483,23 @@ static int sofs_open (const char *ePath, struct fuse_file_info *fi)
 {
   soColorProbe (126, "07;31", "sofs_open_bin (\"%s\", %p)\n", ePath, fi);
 
+  soStatScope (STAT_FUSE_OPEN);
+
   int stat;
+  pthread_rwlock_t *p_lock;
+  uint32_t nInode, fh;
 
-  if (pthread_mutex_lock (&accessCR) != 0)                           /* enter critical region */
+  if (enterInode (ePath, SHARED, &p_lock, &nInode) != 0)           /* enter critical region */
      return -ENOLCK;
 
-  stat = soOpen (ePath, fi->flags);
-  fi->fh = (uint64_t) 0;
+  stat = soStatCall (STAT_SC_OPEN, soOpen (ePath, fi->flags));
+  fh = NULL_FH;
+  if ((stat == 0) && (nInode != NULL_INODE))                         /* without a handle, the path is used */
+     soOpenFh (nInode, fi->flags, &fh);
+  fi->fh = (uint64_t) fh;
+  soTrace (TRACE_OPEN, TRACE_NO_INODE, TRACE_NO_INODE, ePath, NULL, 0, 0, fi->flags, stat);
 
-  if (pthread_mutex_unlock (&accessCR) != 0)                         /* exit critical region */
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
      return -ENOLCK;
 
   return stat;
@@ -702,14 +1530,23 @@ static int sofs_read (const char *ePath, char *buff, size_t count, off_t pos, st
   soColorProbe (127, "07;31", "sofs_read_bin (\"%s\", %p, %"PRIu32", %"PRId32", %p)\n", ePath, buff, (uint32_t) count,
                 (int32_t) pos, fi);
 
+  soStatScope (STAT_FUSE_READ);
+
   int stat;
+  pthread_rwlock_t *p_lock;
+  uint32_t nInode;
 
-  if (pthread_mutex_lock (&accessCR) != 0)                           /* enter critical region */
+  if (enterFile (ePath, fi, SHARED, &p_lock, &nInode) != 0)        /* enter critical region */
      return -ENOLCK;
 
-  stat = soRead (ePath, buff, (uint32_t) count, (int32_t) pos);
+  if ((fi->fh != NULL_FH) && (pos >= 0))
+     stat = soStatCall (STAT_SC_READ, soReadFh ((uint32_t) fi->fh, buff, (uint32_t) count, (uint32_t) pos));
+     else stat = soStatCall (STAT_SC_READ, soRead (ePath, buff, (uint32_t) count, (int32_t) pos));
+  if (stat >= 0)                                                     /* data may still be buffered */
+     stat = (int) soDelAllocRead (nInode, buff, (uint32_t) count, (uint32_t) pos, (uint32_t) stat);
+  soTrace (TRACE_READ, TRACE_NO_INODE, TRACE_NO_INODE, ePath, NULL, pos, count, 0, stat);
 
-  if (pthread_mutex_unlock (&accessCR) != 0)                         /* exit critical region */
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
      return -ENOLCK;
 
   return stat;
@@ -739,20 +1576,29 @@ static int sofs_write (const char *ePath, const char *buff, size_t count, off_t
   soColorProbe (128, "07;31", "sofs_write_bin (\"%s\", %p, %"PRIu32", %"PRId32", %p)\n", ePath, buff, (uint32_t) count,
                 (int32_t) pos, fi);
 
-  int i;
+  soStatScope (STAT_FUSE_WRITE);
+
   int stat;
-  char *b;
+  pthread_rwlock_t *p_lock;
+  uint32_t nInode;
+  bool buffered;
 
-  if (pthread_mutex_lock (&accessCR) != 0)                           /* enter critical region */
+  if (enterFile (ePath, fi, EXCL, &p_lock, &nInode) != 0)          /* enter critical region */
      return -ENOLCK;
 
-  b = malloc (count);
-  for (i = 0; i < count; i++)
-    b[i] = buff[i];
-  stat = soWrite (ePath, (void *) b, (uint32_t) count, (int32_t) pos);
-  free (b);
-
-  if (pthread_mutex_unlock (&accessCR) != 0)                         /* exit critical region */
+  stat = 0;
+  buffered = false;
+  if ((nInode != NULL_INODE) && (pos >= 0))                          /* the data clusters are allocated on flushing */
+     stat = soDelAllocWrite (nInode, buff, (uint32_t) count, (uint32_t) pos, &buffered);
+  if ((stat == 0) && buffered)
+     stat = (int) count;
+     else if ((stat == 0) && (fi->fh != NULL_FH) && (pos >= 0))     /* the data is written straight from the FUSE buffer */
+             stat = soStatCall (STAT_SC_WRITE, soWriteFh ((uint32_t) fi->fh, buff, (uint32_t) count, (uint32_t) pos));
+     else if (stat == 0)
+             stat = soStatCall (STAT_SC_WRITE, soWrite (ePath, buff, (uint32_t) count, (int32_t) pos));
+  soTrace (TRACE_WRITE, TRACE_NO_INODE, TRACE_NO_INODE, ePath, NULL, pos, count, 0, stat);
+
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
      return -ENOLCK;
 
   return stat;
@@ -788,7 +1634,22 @@ static int sofs_flush (const char *ePath, struct fuse_file_info *fi)
 {
   soColorProbe(129, "07;31", "sofs_flush_bin (\"%s\", %p)\n", ePath, fi);
 
-  return 0;
+  soStatScope (STAT_FUSE_FLUSH);
+
+  int stat;
+  pthread_rwlock_t *p_lock;
+  uint32_t nInode;
+
+  if (enterFile (ePath, fi, EXCL, &p_lock, &nInode) != 0)          /* enter critical region */
+     return -ENOLCK;
+
+  stat = (nInode != NULL_INODE) ? soDelAllocFlush (nInode) : 0;    /* the buffered data is written back */
+  soTrace (TRACE_FLUSH, TRACE_NO_INODE, TRACE_NO_INODE, ePath, NULL, 0, 0, 0, stat);
+
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
+     return -ENOLCK;
+
+  return stat;
 }
 
 /**
@@ -813,14 +1674,25 @@ static int sofs_release (const char *ePath, struct fuse_file_info *fi)
 {
   soColorProbe (130, "07;31", "sofs_release_bin (\"%s\", %p)\n", ePath, fi);
 
+  soStatScope (STAT_FUSE_RELEASE);
+
   int stat;
+  pthread_rwlock_t *p_lock;
+  uint32_t nInode;
 
-  if (pthread_mutex_lock (&accessCR) != 0)                           /* enter critical region */
+  if (enterFile (ePath, fi, EXCL, &p_lock, &nInode) != 0)          /* enter critical region */
      return -ENOLCK;
 
-  stat = soClose (ePath);
+  stat = (nInode != NULL_INODE) ? soDelAllocFlush (nInode) : 0;    /* the buffered data is written back */
+  if (fi->fh != NULL_FH)                                              /* the handle is released in any case */
+     { if (soCloseFh ((uint32_t) fi->fh) != 0) stat = -EBADF;
+       fi->fh = (uint64_t) NULL_FH;
+     }
+     else if (stat == 0)
+             stat = soStatCall (STAT_SC_CLOSE, soClose (ePath));
+  soTrace (TRACE_RELEASE, TRACE_NO_INODE, TRACE_NO_INODE, ePath, NULL, 0, 0, 0, stat);
 
-  if (pthread_mutex_unlock (&accessCR) != 0)                         /* exit critical region */
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
      return -ENOLCK;
 
   return stat;
@@ -846,7 +1718,33 @@ static int sofs_fsync (const char *ePath, int isdatasync, struct fuse_file_info
 {
   soColorProbe(131, "07;31", "sofs_fsync_bin (\"%s\", %d, %p)\n", ePath, isdatasync, fi);
 
-  return soFsync (ePath);
+  soStatScope (STAT_FUSE_FSYNC);
+
+  int stat;
+  pthread_rwlock_t *p_lock;
+  uint32_t nInode;
+
+  if (enterFile (ePath, fi, EXCL, &p_lock, &nInode) != 0)          /* enter critical region */
+     return -ENOLCK;
+
+  stat = (nInode != NULL_INODE) ? soDelAllocFlush (nInode) : 0;    /* the buffered data is written back */
+  if ((stat == 0) && (nInode != NULL_INODE))                         /* and so is the time of last access */
+     stat = soAtimeSync (nInode);
+  if ((stat == 0) && (fi->fh != NULL_FH))
+     stat = soStatCall (STAT_SC_FSYNC, soFsyncFh ((uint32_t) fi->fh));
+     else if ((stat == 0) && (nInode != NULL_INODE))               /* the references may be a tree of extents */
+             stat = soStatCall (STAT_SC_FSYNC, soFsyncFile (nInode));
+  soTrace (TRACE_FSYNC, TRACE_NO_INODE, TRACE_NO_INODE, ePath, NULL, 0, 0, 0, stat);
+
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
+     return -ENOLCK;
+
+  if ((stat != 0) || (fi->fh != NULL_FH) || (nInode != NULL_INODE))
+     return stat;
+
+  if ((stat = soFlushTransactions ()) != 0)                          /* the superblock store may have been put off */
+     return stat;
+  return soStatCall (STAT_SC_FSYNC, soFsync (ePath));
 }
 
 /**
@@ -868,15 +1766,19 @@ static int sofs_opendir (const char *ePath, struct fuse_file_info *fi)
 {
   soColorProbe (132, "07;31", "sofs_opendir_bin (\"%s\", %p)\n", ePath, fi);
 
+  soStatScope (STAT_FUSE_OPENDIR);
+
   int stat;
+  pthread_rwlock_t *p_lock;
 
-  if (pthread_mutex_lock (&accessCR) != 0)                           /* enter critical region */
+  if (enterInode (ePath, SHARED, &p_lock, NULL) != 0)              /* enter critical region */
      return -ENOLCK;
 
-  stat = soOpendir (ePath);
+  stat = soStatCall (STAT_SC_OPENDIR, soOpendir (ePath));
   fi->fh = (uint64_t) 0;
+  soTrace (TRACE_OPENDIR, TRACE_NO_INODE, TRACE_NO_INODE, ePath, NULL, 0, 0, 0, stat);
 
-  if (pthread_mutex_unlock (&accessCR) != 0)                         /* exit critical region */
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
      return -ENOLCK;
 
   return stat;
@@ -915,19 +1817,22 @@ static int sofs_readdir (const char *ePath, void *buf, fuse_fill_dir_t filler, o
   soColorProbe (133, "07;31", "sofs_readdir_bin (\"%s\", %p, %p, %"PRId32", %p)\n", ePath, buf, filler,
                 (int32_t)offset, fi);
 
-  char name[MAX_NAME+1];
+  soStatScope (STAT_FUSE_READDIR);
+
+  SOReaddirBuf rd;
   int stat;
+  pthread_rwlock_t *p_lock;
 
-  if (pthread_mutex_lock (&accessCR) != 0)                           /* enter critical region */
+  if (enterInode (ePath, SHARED, &p_lock, NULL) != 0)              /* enter critical region */
      return -ENOLCK;
 
-  stat = soReaddir (ePath, name, (int32_t) offset);
-  if (stat > 0)
-     { offset += stat;
-       stat = filler (buf, name, NULL, offset);
-     }
+  rd.buf = buf;                                                      /* entries are filled until the buffer is full */
+  rd.filler = filler;
+  stat = soStatCall (STAT_SC_READDIR, soReaddirBatch (ePath, (uint32_t) offset, fillEntry, &rd, true));
+  if (stat > 0) stat = 0;
+  soTrace (TRACE_READDIR, TRACE_NO_INODE, TRACE_NO_INODE, ePath, NULL, offset, 0, 0, stat);
 
-  if (pthread_mutex_unlock (&accessCR) != 0)                         /* exit critical region */
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
      return -ENOLCK;
 
   return stat;
@@ -950,14 +1855,18 @@ static int sofs_releasedir (const char *ePath, struct fuse_file_info *fi)
 {
   soColorProbe (134, "07;31", "sofs_releasedir_bin (\"%s\", %p)\n", ePath, fi);
 
+  soStatScope (STAT_FUSE_RELEASEDIR);
+
   int stat;
+  pthread_rwlock_t *p_lock;
 
-  if (pthread_mutex_lock (&accessCR) != 0)                           /* enter critical region */
+  if (enterInode (ePath, SHARED, &p_lock, NULL) != 0)              /* enter critical region */
      return -ENOLCK;
 
-  stat = soClosedir (ePath);
+  stat = soStatCall (STAT_SC_CLOSEDIR, soClosedir (ePath));
+  soTrace (TRACE_RELEASEDIR, TRACE_NO_INODE, TRACE_NO_INODE, ePath, NULL, 0, 0, 0, stat);
 
-  if (pthread_mutex_unlock (&accessCR) != 0)                         /* exit critical region */
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
      return -ENOLCK;
 
   return stat;
@@ -981,7 +1890,15 @@ static int sofs_fsyncdir (const char *ePath, int isdatasync, struct fuse_file_in
 {
   soColorProbe (135, "07;31", "sofs_fsyncdir_bin (\"%s\", %d, %p)\n", ePath, isdatasync, fi);
 
-  return soFsync (ePath);
+  soStatScope (STAT_FUSE_FSYNCDIR);
+
+  int stat;
+
+  if ((stat = soFlushTransactions ()) == 0)                          /* the superblock store may have been put off */
+     stat = soStatCall (STAT_SC_FSYNC, soFsync (ePath));
+  soTrace (TRACE_FSYNCDIR, TRACE_NO_INODE, TRACE_NO_INODE, ePath, NULL, 0, 0, 0, stat);
+
+  return stat;
 }
 
 /**
@@ -999,14 +1916,17 @@ static int sofs_symlink (const char *effPath, const char *ePath)
 {
   soColorProbe (136, "07;31", "sofs_symlink_bin (\"%s\", \"%s\")\n", effPath, ePath);
 
+  soStatScope (STAT_FUSE_SYMLINK);
+
   int stat;
 
-  if (pthread_mutex_lock (&accessCR) != 0)                           /* enter critical region */
+  if (enterNamespace (EXCL) != 0)                                  /* enter critical region */
      return -ENOLCK;
 
-  stat = soSymlink (effPath, ePath);
+  stat = soStatCall (STAT_SC_SYMLINK, soSymlink (effPath, ePath));
+  soTrace (TRACE_SYMLINK, TRACE_NO_INODE, TRACE_NO_INODE, ePath, effPath, 0, 0, 0, stat);
 
-  if (pthread_mutex_unlock (&accessCR) != 0)                         /* exit critical region */
+  if (leaveNamespace () != 0)                                        /* exit critical region */
      return -ENOLCK;
 
   return stat;
@@ -1032,14 +1952,18 @@ static int sofs_readlink (const char *ePath, char *buf, size_t size)
 {
   soColorProbe (137, "07;31", "sofs_readlink_bin (\"%s\", %p, %"PRIu32")\n", ePath, buf, (uint32_t) size);
 
+  soStatScope (STAT_FUSE_READLINK);
+
   int stat;
+  pthread_rwlock_t *p_lock;
 
-  if (pthread_mutex_lock (&accessCR) != 0)                           /* enter critical region */
+  if (enterInode (ePath, SHARED, &p_lock, NULL) != 0)              /* enter critical region */
      return -ENOLCK;
 
-  stat = soReadlink (ePath, buf, (uint32_t) size);
+  stat = soStatCall (STAT_SC_READLINK, soReadlink (ePath, buf, (uint32_t) size));
+  soTrace (TRACE_READLINK, TRACE_NO_INODE, TRACE_NO_INODE, ePath, NULL, 0, size, 0, stat);
 
-  if (pthread_mutex_unlock (&accessCR) != 0)                         /* exit critical region */
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
      return -ENOLCK;
 
   return stat;
@@ -1050,7 +1974,8 @@ static int sofs_readlink (const char *ePath, char *buf, size_t size)
  *
  *  Equivalent to setxattr (man 2 setxattr).
  *
- *  \remarks UNIMPLEMENTED.
+ *  \remarks Only the control attributes of the root directory are supported: setting "user.sofs.stats", whatever the
+ *           value, resets the statistics of operations and setting "user.sofs.cache" tunes the buffercache.
  */
 
 static int sofs_setxattr (const char *ePath, const char *name, const char *value, size_t size, int flags)
@@ -1058,7 +1983,16 @@ static int sofs_setxattr (const char *ePath, const char *name, const char *value
   soColorProbe (138, "07;31", "sofs_setxattr_bin (\"%s\", \"%s\", %p, %"PRIu32", %d)\n", ePath, name, value,
                 (uint32_t) size, flags);
 
-  return -ENOSYS;
+  soStatScope (STAT_FUSE_SETXATTR);
+
+  if ((strcmp (ePath, "/") != 0) || ((strcmp (name, STATS_XATTR) != 0) && (strcmp (name, CACHE_XATTR) != 0)))
+     return -ENOTSUP;
+  if (flags & XATTR_CREATE) return -EEXIST;      /* the control attributes always exist */
+  if (strcmp (name, CACHE_XATTR) == 0)
+     return tuneCache (value, size);
+  soStatReset ();
+
+  return 0;
 }
 
 /**
@@ -1066,14 +2000,33 @@ static int sofs_setxattr (const char *ePath, const char *name, const char *value
  *
  *  Equivalent to getxattr (man 2 getxattr).
  *
- *  \remarks UNIMPLEMENTED.
+ *  \remarks Only the control attributes of the root directory are supported: "user.sofs.stats" holds the report of
+ *           the statistics of operations (see soStatReport) and "user.sofs.cache" the report of the statistics of the
+ *           buffercache (see soReportBufferCacheStats).
  */
 
 static int sofs_getxattr (const char *ePath, const char *name, char *value, size_t size)
 {
   soColorProbe (139, "07;31", "sofs_getxattr_bin (\"%s\", \"%s\", %p, %"PRIu32")\n", ePath, name, value, (uint32_t) size);
 
-  return -ENOSYS;
+  soStatScope (STAT_FUSE_GETXATTR);
+
+  char *report;
+  int len;
+
+  if (strcmp (ePath, "/") != 0) return -ENODATA;
+  if (strcmp (name, STATS_XATTR) == 0)
+     len = getStats (soStatReport, &report);
+     else if (strcmp (name, CACHE_XATTR) == 0)
+             len = getStats (soReportBufferCacheStats, &report);
+             else return -ENODATA;
+  if (len < 0) return len;
+  if ((size != 0) && ((size_t) len > size))
+     len = -ERANGE;
+     else if (size != 0) memcpy (value, report, (size_t) len);
+  free (report);
+
+  return len;
 }
 
 /**
@@ -1081,14 +2034,23 @@ static int sofs_getxattr (const char *ePath, const char *name, char *value, size
  *
  *  Equivalent to listxattr (man 2 listxattr).
  *
- *  \remarks UNIMPLEMENTED.
+ *  \remarks Only the control attributes of the root directory are listed.
  */
 
 static int sofs_listxattr (const char *ePath, char *list, size_t size)
 {
   soColorProbe (140, "07;31", "sofs_listxattr_bin (\"%s\", \"%s\", %"PRIu32")\n", ePath, list, (uint32_t) size);
 
-  return -ENOSYS;
+  soStatScope (STAT_FUSE_LISTXATTR);
+
+  static const char names[] = STATS_XATTR "\0" CACHE_XATTR;   /* sizeof includes the final NUL */
+
+  if (strcmp (ePath, "/") != 0) return 0;
+  if (size == 0) return sizeof (names);
+  if (size < sizeof (names)) return -ERANGE;
+  memcpy (list, names, sizeof (names));
+
+  return sizeof (names);
 }
 
 /**
@@ -1118,3 +2080,1441 @@ static int sofs_getdir (const char *ePath, fuse_dirh_t handle, fuse_dirfil_t fil
 
   return -ENOSYS;
 }
+
+#if FUSE_VERSION >= 29
+
+/**
+ *  \brief Allocate space for an open file.
+ *
+ *  Equivalent to system call fallocate (man 2 fallocate), with the modes FALLOC_FL_KEEP_SIZE and
+ *  FALLOC_FL_PUNCH_HOLE.
+ *
+ *  \remarks Introduced in version 2.9.1.
+ *
+ *  \param ePath path to the file
+ *  \param mode operation to be performed
+ *  \param offset starting [byte] position of the range
+ *  \param length length of the range in bytes
+ *  \param fi pointer to fuse file information
+ *
+ *  \return 0, on success, and a negative value, on error
+ */
+
+static int sofs_fallocate (const char *ePath, int mode, off_t offset, off_t length, struct fuse_file_info *fi)
+{
+  soColorProbe (166, "07;31", "sofs_fallocate_bin (\"%s\", %d, %"PRId64", %"PRId64", %p)\n", ePath, mode,
+                (int64_t) offset, (int64_t) length, fi);
+
+  soStatScope (STAT_FUSE_FALLOCATE);
+
+  int stat;
+  pthread_rwlock_t *p_lock;
+  uint32_t nInode;
+
+  if (enterFile (ePath, fi, EXCL, &p_lock, &nInode) != 0)          /* enter critical region */
+     return -ENOLCK;
+
+  if (nInode == NULL_INODE)
+     stat = -ENOENT;
+     else if ((fi != NULL) && ((fi->flags & O_ACCMODE) == O_RDONLY))
+             stat = -EBADF;
+     else stat = allocRange (nInode, mode, offset, length);
+  soTrace (TRACE_FALLOCATE, TRACE_NO_INODE, TRACE_NO_INODE, ePath, NULL, offset, length, mode, stat);
+
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
+     return -ENOLCK;
+
+  return stat;
+}
+
+#endif
+
+/**
+ *  \brief Ioctl.
+ *
+ *  The commands SOFS_IOC_SEEK_DATA and SOFS_IOC_SEEK_HOLE find the next data or the next hole of an open file, from
+ *  the position given in the argument, where the position found is stored, as system call lseek (man 2 lseek) does
+ *  with SEEK_DATA and SEEK_HOLE.
+ *
+ *  \remarks Introduced in version 2.8.
+ *
+ *  \param ePath path to the file
+ *  \param cmd command
+ *  \param arg argument, as given by the caller
+ *  \param fi pointer to fuse file information
+ *  \param flags FUSE_IOCTL_* flags
+ *  \param data pointer to the argument, copied in and out by the kernel
+ *
+ *  \return 0, on success, and a negative value, on error
+ */
+
+static int sofs_ioctl (const char *ePath, int cmd, void *arg, struct fuse_file_info *fi, unsigned int flags,
+                       void *data)
+{
+  soColorProbe (167, "07;31", "sofs_ioctl_bin (\"%s\", %x, %p, %p, %x, %p)\n", ePath, (unsigned int) cmd, arg, fi,
+                flags, data);
+
+  soStatScope (STAT_FUSE_IOCTL);
+
+  int stat;
+  pthread_rwlock_t *p_lock;
+  uint32_t nInode;
+
+  if (enterFile (ePath, fi, EXCL, &p_lock, &nInode) != 0)          /* enter critical region */
+     return -ENOLCK;
+
+  stat = (nInode != NULL_INODE) ? seekData (nInode, cmd, (uint64_t *) data) : -ENOENT;
+
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
+     return -ENOLCK;
+
+  return stat;
+}
+
+/*
+ *  Low-level (inode-number) frontend
+ *
+ *  The requests carry the FUSE numbers of the inodes they address, which are the SOFS13 numbers plus one (FUSE reserves
+ *  number 1 for the root directory, which is inode 0), so no path is ever resolved: the internal operations are called
+ *  directly on the inodes. The kernel is allowed to keep the entries and the attributes it is replied for LL_TIMEOUT
+ *  seconds. The access control is the one of the path-based frontend.
+ */
+
+/*
+ * get the attributes of the file associated to an inode as they are replied to the kernel: with the FUSE inode number
+ * and with a size which takes into account the data that is still buffered
+ */
+
+static int llGetAttr (uint32_t nInode, struct stat *st)
+{
+  uint32_t size;
+  int stat;
+
+  if ((stat = soGetInodeAttr (nInode, st)) != 0) return stat;
+  st->st_ino = LL_INO (nInode);
+  if (S_ISREG (st->st_mode))                                         /* data may still be buffered */
+     { size = (uint32_t) st->st_size;
+       soDelAllocSize (nInode, &size);
+       st->st_size = size;
+     }
+
+  return 0;
+}
+
+/*
+ * get the entry to be replied to the kernel for an inode
+ */
+
+static int llEntry (uint32_t nInode, struct fuse_entry_param *e)
+{
+  memset (e, 0, sizeof (struct fuse_entry_param));
+  e->ino = LL_INO (nInode);
+  e->attr_timeout = LL_TIMEOUT;
+  e->entry_timeout = LL_TIMEOUT;
+
+  return llGetAttr (nInode, &e->attr);
+}
+
+/*
+ * create a file of a given type, with the given permissions, and add it to a directory; the inode is freed, if the
+ * entry can not be added
+ */
+
+static int llMakeNode (uint32_t nInodeDir, const char *name, uint32_t type, mode_t mode, uint32_t *p_nInode)
+{
+  SOInode inode;
+  int stat;
+
+  if ((stat = soAllocInodeNear (type, nInodeDir, p_nInode)) != 0) return stat;   /* in the block of the directory */
+  if ((stat = soReadInode (&inode, *p_nInode, IUIN)) == 0)
+     { inode.mode = (uint16_t) ((inode.mode & INODE_TYPE_MASK) | (mode & (S_IRWXU | S_IRWXG | S_IRWXO)));
+       if ((stat = soWriteInode (&inode, *p_nInode, IUIN)) == 0)
+          stat = soAddAttDirEntry (nInodeDir, name, *p_nInode, ADD);
+     }
+  if (stat != 0)
+     soFreeInode (*p_nInode);
+
+  return stat;
+}
+
+/*
+ * create a symbolic link to a path and add it to a directory
+ */
+
+static int llSymlink (uint32_t nInodeDir, const char *name, const char *effPath, uint32_t *p_nInode)
+{
+  SODataClust clust;
+  SOInode inode;
+  int stat;
+
+  if (strlen (effPath) > MAX_PATH) return -ENAMETOOLONG;
+  if ((stat = llMakeNode (nInodeDir, name, INODE_SYMLINK, S_IRWXU | S_IRWXG | S_IRWXO, p_nInode)) != 0)
+     return stat;
+  memset (&clust, 0, sizeof (clust));
+  strcpy ((char *) clust.data, effPath);
+  if ((stat = soWriteFileCluster (*p_nInode, 0, &clust)) != 0) return stat;
+  if ((stat = soReadInode (&inode, *p_nInode, IUIN)) != 0) return stat;
+  inode.size = (uint32_t) strlen (effPath);
+
+  return soWriteInode (&inode, *p_nInode, IUIN);
+}
+
+/*
+ * remove an entry of a given kind (a directory, or not) from a directory, getting the number of the inode it refers to
+ */
+
+static int llRemove (uint32_t nInodeDir, const char *name, bool isDir, uint32_t *p_nInode)
+{
+  SOInode inode;
+  int stat;
+
+  if ((stat = soGetDirEntryByName (nInodeDir, name, p_nInode, NULL)) != 0) return stat;
+  if ((stat = soReadInode (&inode, *p_nInode, IUIN)) != 0) return stat;
+  if (isDir && ((inode.mode & INODE_TYPE_MASK) != INODE_DIR)) return -ENOTDIR;
+  if (!isDir && ((inode.mode & INODE_TYPE_MASK) == INODE_DIR)) return -EISDIR;
+
+  return soRemDetachDirEntry (nInodeDir, name, REM);
+}
+
+/*
+ * rename an entry, moving it to another directory, if required; an entry with the new name is replaced, and the number
+ * of the inode it refers to got (NULL_INODE, if there was none)
+ */
+
+static int llRename (uint32_t nDirOld, const char *oldName, uint32_t nDirNew, const char *newName,
+                     uint32_t *p_nReplaced)
+{
+  SOInode inode, target;
+  uint32_t nInode, nTarget;
+  bool isDir;
+  int stat;
+
+  *p_nReplaced = NULL_INODE;
+  if ((stat = soGetDirEntryByName (nDirOld, oldName, &nInode, NULL)) != 0) return stat;
+  if ((stat = soReadInode (&inode, nInode, IUIN)) != 0) return stat;
+  isDir = ((inode.mode & INODE_TYPE_MASK) == INODE_DIR);
+  if (((stat = soAccessGranted (nDirOld, X)) != 0) || ((stat = soAccessGranted (nDirNew, X)) != 0)) return stat;
+  if (((stat = soAccessGranted (nDirOld, W)) != 0) || ((stat = soAccessGranted (nDirNew, W)) != 0))
+     return (stat == -EACCES) ? -EPERM : stat;
+
+  /* an entry with the new name is removed, before the entry is renamed */
+
+  stat = soGetDirEntryByName (nDirNew, newName, &nTarget, NULL);
+  if ((stat != 0) && (stat != -ENOENT)) return stat;
+  if (stat == 0)
+     { if (nTarget == nInode) return 0;
+       if ((stat = soReadInode (&target, nTarget, IUIN)) != 0) return stat;
+       if (isDir && ((target.mode & INODE_TYPE_MASK) != INODE_DIR)) return -ENOTDIR;
+       if (!isDir && ((target.mode & INODE_TYPE_MASK) == INODE_DIR)) return -EISDIR;
+       if ((stat = soRemDetachDirEntry (nDirNew, newName, REM)) != 0) return stat;
+       *p_nReplaced = nTarget;
+     }
+
+  if (nDirOld == nDirNew)
+     return soRenameDirEntry (nDirOld, oldName, newName);
+  if ((stat = soAddAttDirEntry (nDirNew, newName, nInode, isDir ? ATTACH : ADD)) != 0) return stat;
+
+  return soRemDetachDirEntry (nDirOld, oldName, DETACH);
+}
+
+/*
+ * change the size of a regular file: the data clusters wholly past the new end are freed and the rest of the last one
+ * is cleared, so that it reads as zeros if the file grows again (a data cluster of a compressed group is not allocated
+ * by itself, so it is always cleared)
+ */
+
+static int llTruncate (uint32_t nInode, off_t length)
+{
+  SOInode inode;
+  SODataClust clust;
+  uint32_t clustInd, off, nClust;
+  int stat;
+
+  if (length < 0) return -EINVAL;
+  if (length > (off_t) MAX_FILE_SIZE) return -EFBIG;
+  if ((stat = soReadInode (&inode, nInode, IUIN)) != 0) return stat;
+  if ((inode.mode & INODE_TYPE_MASK) == INODE_DIR) return -EISDIR;
+  if ((stat = soAccessGranted (nInode, W)) != 0) return stat;
+
+  if ((uint32_t) length < inode.size)
+     { clustInd = (uint32_t) length / BSLPC;
+       off = (uint32_t) length % BSLPC;
+       if ((stat = soHandleFileClusters (nInode, (off == 0) ? clustInd : clustInd + 1, FREE_CLEAN)) != 0)
+          return stat;
+       if (off != 0)
+          { if ((stat = soHandleFileCluster (nInode, clustInd, GET, &nClust)) != 0) return stat;
+            if ((nClust != NULL_CLUSTER) || INODE_IS_COMPRESSED (inode.mode))
+               { if ((stat = soReadFileCluster (nInode, clustInd, &clust)) != 0) return stat;
+                 memset (clust.data + off, 0, BSLPC - off);
+                 if ((stat = soWriteFileCluster (nInode, clustInd, &clust)) != 0) return stat;
+               }
+          }
+       if ((stat = soReadInode (&inode, nInode, IUIN)) != 0) return stat;
+     }
+  inode.size = (uint32_t) length;
+
+  return soWriteInode (&inode, nInode, IUIN);
+}
+
+/*
+ * change the attributes of a file, as requested by the kernel
+ */
+
+static int llSetAttr (uint32_t nInode, const struct stat *attr, int to_set)
+{
+  SOInode inode;
+  int stat;
+
+  if (to_set & FUSE_SET_ATTR_SIZE)
+     { if ((stat = soStatCall (STAT_SC_TRUNCATE, llTruncate (nInode, attr->st_size))) != 0) return stat;
+       soDelAllocDrop (nInode, (uint32_t) attr->st_size);          /* the buffered data past the end is dropped */
+     }
+  if ((to_set & (FUSE_SET_ATTR_MODE | FUSE_SET_ATTR_UID | FUSE_SET_ATTR_GID | FUSE_SET_ATTR_ATIME |
+                 FUSE_SET_ATTR_MTIME)) == 0)
+     return 0;
+
+  if ((stat = soReadInode (&inode, nInode, IUIN)) != 0) return stat;
+  if ((to_set & (FUSE_SET_ATTR_MODE | FUSE_SET_ATTR_UID | FUSE_SET_ATTR_GID)) &&
+      (getuid () != 0) && (getuid () != inode.owner))                /* only the owner may change them */
+     return -EPERM;
+  if (to_set & FUSE_SET_ATTR_MODE)
+     inode.mode = (uint16_t) ((inode.mode & INODE_TYPE_MASK) | (attr->st_mode & (S_IRWXU | S_IRWXG | S_IRWXO)));
+  if (to_set & FUSE_SET_ATTR_UID) inode.owner = (uint32_t) attr->st_uid;
+  if (to_set & FUSE_SET_ATTR_GID) inode.group = (uint32_t) attr->st_gid;
+  if (to_set & FUSE_SET_ATTR_ATIME) inode.vD1.atime = (uint32_t) attr->st_atime;
+  if (to_set & FUSE_SET_ATTR_MTIME) inode.vD2.mtime = (uint32_t) attr->st_mtime;
+
+  return soWriteInode (&inode, nInode, IUIN);
+}
+
+/*
+ * check if a file may be opened with the given flags
+ */
+
+static int llOpen (uint32_t nInode, int flags, bool isDir)
+{
+  SOInode inode;
+  uint32_t op;
+  int stat;
+
+  if ((stat = soReadInode (&inode, nInode, IUIN)) != 0) return stat;
+  if (isDir && ((inode.mode & INODE_TYPE_MASK) != INODE_DIR)) return -ENOTDIR;
+  if (!isDir && ((inode.mode & INODE_TYPE_MASK) == INODE_DIR) && ((flags & O_ACCMODE) != O_RDONLY)) return -EISDIR;
+  switch (flags & O_ACCMODE)
+  { case O_WRONLY: op = W;
+                   break;
+    case O_RDWR:   op = R | W;
+                   break;
+    default:       op = R;
+  }
+
+  return soAccessGranted (nInode, op);
+}
+
+/*
+ * fill a directory entry into the buffer of a low-level readdir request; a non-zero value is returned when the buffer
+ * is full
+ */
+
+static int llFillEntry (void *data, const char *name, const struct stat *st, uint32_t next)
+{
+  SOLLReaddirBuf *p_rd = (SOLLReaddirBuf *) data;
+  struct stat est = *st;
+  size_t len;
+
+  est.st_ino = LL_INO (st->st_ino);
+  if ((len = fuse_add_direntry (p_rd->req, NULL, 0, name, NULL, 0)) > p_rd->size - p_rd->len)
+     return 1;
+  fuse_add_direntry (p_rd->req, p_rd->buf + p_rd->len, p_rd->size - p_rd->len, name, &est, (off_t) next);
+  p_rd->len += len;
+
+  return 0;
+}
+
+/**
+ *  \brief Initialize the filesystem (low-level frontend).
+ *
+ *  \param userdata user data passed to fuse_lowlevel_new
+ *  \param fci pointer to fuse connection information
+ */
+
+static void sofs_ll_init (void *userdata, struct fuse_conn_info *fci)
+{
+  sofs_mount (fci);
+}
+
+/**
+ *  \brief Clean up the filesystem (low-level frontend).
+ *
+ *  \param userdata user data passed to fuse_lowlevel_new
+ */
+
+static void sofs_ll_destroy (void *userdata)
+{
+  sofs_unmount (sofs_supp_file);
+}
+
+/**
+ *  \brief Look up a directory entry by name and get its attributes.
+ *
+ *  \param req request handle
+ *  \param parent inode number of the parent directory
+ *  \param name the name to look up
+ */
+
+static void sofs_ll_lookup (fuse_req_t req, fuse_ino_t parent, const char *name)
+{
+  soColorProbe (143, "07;31", "sofs_ll_lookup (%lu, \"%s\")\n", (unsigned long) parent, name);
+
+  soStatScope (STAT_FUSE_LOOKUP);
+
+  struct fuse_entry_param e;
+  int stat;
+  pthread_rwlock_t *p_lock;
+  uint32_t nInode;
+
+  if (enterInodeNo (LL_INODE (parent), SHARED, &p_lock) != 0)     /* enter critical region */
+     { fuse_reply_err (req, ENOLCK);
+       return;
+     }
+
+  stat = soGetDirEntryByName (LL_INODE (parent), name, &nInode, NULL);
+  if (stat == 0) stat = llEntry (nInode, &e);
+  soTrace (TRACE_LOOKUP, LL_INODE (parent), (stat == 0) ? nInode : TRACE_NO_INODE, name, NULL, 0, 0, 0, stat);
+
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
+     stat = -ENOLCK;
+
+  if (stat == 0)
+     fuse_reply_entry (req, &e);
+     else fuse_reply_err (req, -stat);
+}
+
+/**
+ *  \brief Forget about an inode.
+ *
+ *  \remarks Nothing is kept about the inodes the kernel knows of.
+ *
+ *  \param req request handle
+ *  \param ino the inode number
+ *  \param nlookup the number of lookups to forget
+ */
+
+static void sofs_ll_forget (fuse_req_t req, fuse_ino_t ino, unsigned long nlookup)
+{
+  fuse_reply_none (req);
+}
+
+/**
+ *  \brief Get file attributes.
+ *
+ *  \param req request handle
+ *  \param ino the inode number
+ *  \param fi for future use, currently always NULL
+ */
+
+static void sofs_ll_getattr (fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi)
+{
+  soColorProbe (144, "07;31", "sofs_ll_getattr (%lu, %p)\n", (unsigned long) ino, fi);
+
+  soStatScope (STAT_FUSE_GETATTR);
+
+  struct stat st;
+  int stat;
+  pthread_rwlock_t *p_lock;
+
+  if (enterInodeNo (LL_INODE (ino), SHARED, &p_lock) != 0)        /* enter critical region */
+     { fuse_reply_err (req, ENOLCK);
+       return;
+     }
+
+  stat = soStatCall (STAT_SC_STAT, llGetAttr (LL_INODE (ino), &st));
+  soTrace (TRACE_GETATTR, LL_INODE (ino), TRACE_NO_INODE, NULL, NULL, 0, 0, 0, stat);
+
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
+     stat = -ENOLCK;
+
+  if (stat == 0)
+     fuse_reply_attr (req, &st, LL_TIMEOUT);
+     else fuse_reply_err (req, -stat);
+}
+
+/**
+ *  \brief Set file attributes.
+ *
+ *  It stands for chmod, chown, truncate and utime.
+ *
+ *  \param req request handle
+ *  \param ino the inode number
+ *  \param attr the attributes
+ *  \param to_set bit mask of attributes which should be set
+ *  \param fi file information, or NULL
+ */
+
+static void sofs_ll_setattr (fuse_req_t req, fuse_ino_t ino, struct stat *attr, int to_set, struct fuse_file_info *fi)
+{
+  soColorProbe (145, "07;31", "sofs_ll_setattr (%lu, %p, %x, %p)\n", (unsigned long) ino, attr, to_set, fi);
+
+  soStatScope ((to_set & FUSE_SET_ATTR_SIZE) ? STAT_FUSE_TRUNCATE : STAT_FUSE_CHMOD);
+
+  struct stat st;
+  int stat;
+  pthread_rwlock_t *p_lock;
+
+  if (enterInodeNo (LL_INODE (ino), EXCL, &p_lock) != 0)          /* enter critical region */
+     { fuse_reply_err (req, ENOLCK);
+       return;
+     }
+
+  stat = llSetAttr (LL_INODE (ino), attr, to_set);
+  if (stat == 0) stat = llGetAttr (LL_INODE (ino), &st);
+  if (to_set & FUSE_SET_ATTR_MODE)                                   /* a record for each attribute set */
+     soTrace (TRACE_CHMOD, LL_INODE (ino), TRACE_NO_INODE, NULL, NULL, 0, 0, attr->st_mode, stat);
+  if (to_set & (FUSE_SET_ATTR_UID | FUSE_SET_ATTR_GID))
+     soTrace (TRACE_CHOWN, LL_INODE (ino), TRACE_NO_INODE, NULL, NULL,
+              (to_set & FUSE_SET_ATTR_UID) ? attr->st_uid : (uid_t) -1,
+              (to_set & FUSE_SET_ATTR_GID) ? attr->st_gid : (gid_t) -1, 0, stat);
+  if (to_set & FUSE_SET_ATTR_SIZE)
+     soTrace (TRACE_TRUNCATE, LL_INODE (ino), TRACE_NO_INODE, NULL, NULL, 0, attr->st_size, 0, stat);
+  if (to_set & (FUSE_SET_ATTR_ATIME | FUSE_SET_ATTR_MTIME))
+     soTrace (TRACE_UTIME, LL_INODE (ino), TRACE_NO_INODE, NULL, NULL, attr->st_atime, attr->st_mtime, 1, stat);
+
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
+     stat = -ENOLCK;
+
+  if (stat == 0)
+     fuse_reply_attr (req, &st, LL_TIMEOUT);
+     else fuse_reply_err (req, -stat);
+}
+
+/**
+ *  \brief Read a symbolic link.
+ *
+ *  \param req request handle
+ *  \param ino the inode number
+ */
+
+static void sofs_ll_readlink (fuse_req_t req, fuse_ino_t ino)
+{
+  soColorProbe (146, "07;31", "sofs_ll_readlink (%lu)\n", (unsigned long) ino);
+
+  soStatScope (STAT_FUSE_READLINK);
+
+  SOInode inode;
+  SODataClust clust;
+  int stat;
+  pthread_rwlock_t *p_lock;
+
+  if (enterInodeNo (LL_INODE (ino), SHARED, &p_lock) != 0)        /* enter critical region */
+     { fuse_reply_err (req, ENOLCK);
+       return;
+     }
+
+  if (((stat = soReadInode (&inode, LL_INODE (ino), IUIN)) == 0) && ((inode.mode & INODE_TYPE_MASK) != INODE_SYMLINK))
+     stat = -EINVAL;
+  if (stat == 0)
+     stat = soStatCall (STAT_SC_READLINK, soReadFileCluster (LL_INODE (ino), 0, &clust));
+  if (stat == 0)
+     clust.data[(inode.size < BSLPC) ? inode.size : BSLPC - 1] = '\0';
+  soTrace (TRACE_READLINK, LL_INODE (ino), TRACE_NO_INODE, NULL, NULL, 0, BSLPC, 0, stat);
+
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
+     stat = -ENOLCK;
+
+  if (stat == 0)
+     fuse_reply_readlink (req, (const char *) clust.data);
+     else fuse_reply_err (req, -stat);
+}
+
+/**
+ *  \brief Create a file node.
+ *
+ *  \remarks Only regular files are supported.
+ *
+ *  \param req request handle
+ *  \param parent inode number of the parent directory
+ *  \param name to create
+ *  \param mode file type and mode with which to create the new file
+ *  \param rdev the device number (only valid if created file is a device)
+ */
+
+static void sofs_ll_mknod (fuse_req_t req, fuse_ino_t parent, const char *name, mode_t mode, dev_t rdev)
+{
+  soColorProbe (147, "07;31", "sofs_ll_mknod (%lu, \"%s\", %x, %x)\n", (unsigned long) parent, name, (uint32_t) mode,
+                (uint32_t) rdev);
+
+  soStatScope (STAT_FUSE_MKNOD);
+
+  struct fuse_entry_param e;
+  int stat;
+  uint32_t nInode;
+
+  if (!S_ISREG (mode))
+     { fuse_reply_err (req, EPERM);
+       return;
+     }
+  if (enterNamespace (EXCL) != 0)                                  /* enter critical region */
+     { fuse_reply_err (req, ENOLCK);
+       return;
+     }
+
+  stat = soStatCall (STAT_SC_MKNOD, llMakeNode (LL_INODE (parent), name, INODE_FILE, mode, &nInode));
+  if (stat == 0) stat = llEntry (nInode, &e);
+  soTrace (TRACE_MKNOD, LL_INODE (parent), (stat == 0) ? nInode : TRACE_NO_INODE, name, NULL, 0, 0, mode, stat);
+
+  if (leaveNamespace () != 0)                                        /* exit critical region */
+     stat = -ENOLCK;
+
+  if (stat == 0)
+     fuse_reply_entry (req, &e);
+     else fuse_reply_err (req, -stat);
+}
+
+/**
+ *  \brief Create a directory.
+ *
+ *  \param req request handle
+ *  \param parent inode number of the parent directory
+ *  \param name to create
+ *  \param mode with which to create the new file
+ */
+
+static void sofs_ll_mkdir (fuse_req_t req, fuse_ino_t parent, const char *name, mode_t mode)
+{
+  soColorProbe (148, "07;31", "sofs_ll_mkdir (%lu, \"%s\", %x)\n", (unsigned long) parent, name, (uint32_t) mode);
+
+  soStatScope (STAT_FUSE_MKDIR);
+
+  struct fuse_entry_param e;
+  int stat;
+  uint32_t nInode;
+
+  if (enterNamespace (EXCL) != 0)                                  /* enter critical region */
+     { fuse_reply_err (req, ENOLCK);
+       return;
+     }
+
+  stat = soStatCall (STAT_SC_MKDIR, llMakeNode (LL_INODE (parent), name, INODE_DIR, mode, &nInode));
+  if (stat == 0) stat = llEntry (nInode, &e);
+  soTrace (TRACE_MKDIR, LL_INODE (parent), (stat == 0) ? nInode : TRACE_NO_INODE, name, NULL, 0, 0, mode, stat);
+
+  if (leaveNamespace () != 0)                                        /* exit critical region */
+     stat = -ENOLCK;
+
+  if (stat == 0)
+     fuse_reply_entry (req, &e);
+     else fuse_reply_err (req, -stat);
+}
+
+/**
+ *  \brief Remove a file.
+ *
+ *  \param req request handle
+ *  \param parent inode number of the parent directory
+ *  \param name to remove
+ */
+
+static void sofs_ll_unlink (fuse_req_t req, fuse_ino_t parent, const char *name)
+{
+  soColorProbe (149, "07;31", "sofs_ll_unlink (%lu, \"%s\")\n", (unsigned long) parent, name);
+
+  soStatScope (STAT_FUSE_UNLINK);
+
+  int stat;
+  uint32_t nInode;
+
+  if (enterNamespace (EXCL) != 0)                                  /* enter critical region */
+     { fuse_reply_err (req, ENOLCK);
+       return;
+     }
+
+  stat = soStatCall (STAT_SC_UNLINK, llRemove (LL_INODE (parent), name, false, &nInode));
+  if (stat == 0)                                                     /* a removed file loses its buffered data */
+     dropIfRemoved (nInode);
+  soTrace (TRACE_UNLINK, LL_INODE (parent), TRACE_NO_INODE, name, NULL, 0, 0, 0, stat);
+
+  if (leaveNamespace () != 0)                                        /* exit critical region */
+     stat = -ENOLCK;
+
+  fuse_reply_err (req, -stat);
+}
+
+/**
+ *  \brief Remove a directory.
+ *
+ *  \param req request handle
+ *  \param parent inode number of the parent directory
+ *  \param name to remove
+ */
+
+static void sofs_ll_rmdir (fuse_req_t req, fuse_ino_t parent, const char *name)
+{
+  soColorProbe (150, "07;31", "sofs_ll_rmdir (%lu, \"%s\")\n", (unsigned long) parent, name);
+
+  soStatScope (STAT_FUSE_RMDIR);
+
+  int stat;
+  uint32_t nInode;
+
+  if (enterNamespace (EXCL) != 0)                                  /* enter critical region */
+     { fuse_reply_err (req, ENOLCK);
+       return;
+     }
+
+  stat = soStatCall (STAT_SC_RMDIR, llRemove (LL_INODE (parent), name, true, &nInode));
+  soTrace (TRACE_RMDIR, LL_INODE (parent), TRACE_NO_INODE, name, NULL, 0, 0, 0, stat);
+
+  if (leaveNamespace () != 0)                                        /* exit critical region */
+     stat = -ENOLCK;
+
+  fuse_reply_err (req, -stat);
+}
+
+/**
+ *  \brief Create a symbolic link.
+ *
+ *  \param req request handle
+ *  \param link the contents of the symbolic link
+ *  \param parent inode number of the parent directory
+ *  \param name to create
+ */
+
+static void sofs_ll_symlink (fuse_req_t req, const char *link, fuse_ino_t parent, const char *name)
+{
+  soColorProbe (151, "07;31", "sofs_ll_symlink (\"%s\", %lu, \"%s\")\n", link, (unsigned long) parent, name);
+
+  soStatScope (STAT_FUSE_SYMLINK);
+
+  struct fuse_entry_param e;
+  int stat;
+  uint32_t nInode;
+
+  if (enterNamespace (EXCL) != 0)                                  /* enter critical region */
+     { fuse_reply_err (req, ENOLCK);
+       return;
+     }
+
+  stat = soStatCall (STAT_SC_SYMLINK, llSymlink (LL_INODE (parent), name, link, &nInode));
+  if (stat == 0) stat = llEntry (nInode, &e);
+  soTrace (TRACE_SYMLINK, LL_INODE (parent), (stat == 0) ? nInode : TRACE_NO_INODE, name, link, 0, 0, 0, stat);
+
+  if (leaveNamespace () != 0)                                        /* exit critical region */
+     stat = -ENOLCK;
+
+  if (stat == 0)
+     fuse_reply_entry (req, &e);
+     else fuse_reply_err (req, -stat);
+}
+
+/**
+ *  \brief Rename a file.
+ *
+ *  \param req request handle
+ *  \param parent inode number of the old parent directory
+ *  \param name old name
+ *  \param newparent inode number of the new parent directory
+ *  \param newname new name
+ */
+
+static void sofs_ll_rename (fuse_req_t req, fuse_ino_t parent, const char *name, fuse_ino_t newparent,
+                            const char *newname)
+{
+  soColorProbe (152, "07;31", "sofs_ll_rename (%lu, \"%s\", %lu, \"%s\")\n", (unsigned long) parent, name,
+                (unsigned long) newparent, newname);
+
+  soStatScope (STAT_FUSE_RENAME);
+
+  int stat;
+  uint32_t nInode;
+
+  if (enterNamespace (EXCL) != 0)                                  /* enter critical region */
+     { fuse_reply_err (req, ENOLCK);
+       return;
+     }
+
+  stat = soStatCall (STAT_SC_RENAME, llRename (LL_INODE (parent), name, LL_INODE (newparent), newname, &nInode));
+  if (nInode != NULL_INODE)                                          /* a replaced file loses its buffered data */
+     dropIfRemoved (nInode);
+  soTrace (TRACE_RENAME, LL_INODE (parent), LL_INODE (newparent), name, newname, 0, 0, 0, stat);
+
+  if (leaveNamespace () != 0)                                        /* exit critical region */
+     stat = -ENOLCK;
+
+  fuse_reply_err (req, -stat);
+}
+
+/**
+ *  \brief Create a hard link.
+ *
+ *  \param req request handle
+ *  \param ino the old inode number
+ *  \param newparent inode number of the new parent directory
+ *  \param newname new name to create
+ */
+
+static void sofs_ll_link (fuse_req_t req, fuse_ino_t ino, fuse_ino_t newparent, const char *newname)
+{
+  soColorProbe (153, "07;31", "sofs_ll_link (%lu, %lu, \"%s\")\n", (unsigned long) ino, (unsigned long) newparent,
+                newname);
+
+  soStatScope (STAT_FUSE_LINK);
+
+  struct fuse_entry_param e;
+  SOInode inode;
+  int stat;
+
+  if (enterNamespace (EXCL) != 0)                                  /* enter critical region */
+     { fuse_reply_err (req, ENOLCK);
+       return;
+     }
+
+  if (((stat = soReadInode (&inode, LL_INODE (ino), IUIN)) == 0) && ((inode.mode & INODE_TYPE_MASK) == INODE_DIR))
+     stat = -EPERM;                                                  /* directories can not be hard linked */
+  if (stat == 0)
+     stat = soStatCall (STAT_SC_LINK, soAddAttDirEntry (LL_INODE (newparent), newname, LL_INODE (ino), ADD));
+  if (stat == 0) stat = llEntry (LL_INODE (ino), &e);
+  soTrace (TRACE_LINK, LL_INODE (ino), LL_INODE (newparent), NULL, newname, 0, 0, 0, stat);
+
+  if (leaveNamespace () != 0)                                        /* exit critical region */
+     stat = -ENOLCK;
+
+  if (stat == 0)
+     fuse_reply_entry (req, &e);
+     else fuse_reply_err (req, -stat);
+}
+
+/**
+ *  \brief Open a file.
+ *
+ *  An open-file handle is got, which is passed to all file operations.
+ *
+ *  \param req request handle
+ *  \param ino the inode number
+ *  \param fi file information
+ */
+
+static void sofs_ll_open (fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi)
+{
+  soColorProbe (154, "07;31", "sofs_ll_open (%lu, %p)\n", (unsigned long) ino, fi);
+
+  soStatScope (STAT_FUSE_OPEN);
+
+  int stat;
+  pthread_rwlock_t *p_lock;
+  uint32_t fh;
+
+  if (enterInodeNo (LL_INODE (ino), SHARED, &p_lock) != 0)        /* enter critical region */
+     { fuse_reply_err (req, ENOLCK);
+       return;
+     }
+
+  fh = NULL_FH;
+  stat = soStatCall (STAT_SC_OPEN, llOpen (LL_INODE (ino), fi->flags, false));
+  if (stat == 0) stat = soOpenFh (LL_INODE (ino), fi->flags, &fh);
+  fi->fh = (uint64_t) fh;
+  soTrace (TRACE_OPEN, LL_INODE (ino), TRACE_NO_INODE, NULL, NULL, 0, 0, fi->flags, stat);
+
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
+     stat = -ENOLCK;
+
+  if (stat == 0)
+     fuse_reply_open (req, fi);
+     else { if (fh != NULL_FH) soCloseFh (fh);
+            fuse_reply_err (req, -stat);
+          }
+}
+
+/**
+ *  \brief Read data from an open file.
+ *
+ *  \param req request handle
+ *  \param ino the inode number
+ *  \param size number of bytes to read
+ *  \param off offset to read from
+ *  \param fi file information
+ */
+
+static void sofs_ll_read (fuse_req_t req, fuse_ino_t ino, size_t size, off_t off, struct fuse_file_info *fi)
+{
+  soColorProbe (155, "07;31", "sofs_ll_read (%lu, %"PRIu32", %"PRId32", %p)\n", (unsigned long) ino, (uint32_t) size,
+                (int32_t) off, fi);
+
+  soStatScope (STAT_FUSE_READ);
+
+  char *buff;
+  int stat;
+  pthread_rwlock_t *p_lock;
+
+  if ((off < 0) || (off > (off_t) MAX_FILE_SIZE))
+     { fuse_reply_err (req, EINVAL);
+       return;
+     }
+  if ((buff = malloc ((size != 0) ? size : 1)) == NULL)
+     { fuse_reply_err (req, ENOMEM);
+       return;
+     }
+  if (enterInodeNo (LL_INODE (ino), SHARED, &p_lock) != 0)        /* enter critical region */
+     { free (buff);
+       fuse_reply_err (req, ENOLCK);
+       return;
+     }
+
+  stat = soStatCall (STAT_SC_READ, soReadFh ((uint32_t) fi->fh, buff, (uint32_t) size, (uint32_t) off));
+  if (stat >= 0)                                                     /* data may still be buffered */
+     stat = (int) soDelAllocRead (LL_INODE (ino), buff, (uint32_t) size, (uint32_t) off, (uint32_t) stat);
+  soTrace (TRACE_READ, LL_INODE (ino), TRACE_NO_INODE, NULL, NULL, off, size, 0, stat);
+
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
+     stat = -ENOLCK;
+
+  if (stat >= 0)
+     fuse_reply_buf (req, buff, (size_t) stat);
+     else fuse_reply_err (req, -stat);
+  free (buff);
+}
+
+/**
+ *  \brief Write data to an open file.
+ *
+ *  \param req request handle
+ *  \param ino the inode number
+ *  \param buff data to write
+ *  \param size number of bytes to write
+ *  \param off offset to write to
+ *  \param fi file information
+ */
+
+static void sofs_ll_write (fuse_req_t req, fuse_ino_t ino, const char *buff, size_t size, off_t off,
+                           struct fuse_file_info *fi)
+{
+  soColorProbe (156, "07;31", "sofs_ll_write (%lu, %p, %"PRIu32", %"PRId32", %p)\n", (unsigned long) ino, buff,
+                (uint32_t) size, (int32_t) off, fi);
+
+  soStatScope (STAT_FUSE_WRITE);
+
+  int stat;
+  pthread_rwlock_t *p_lock;
+  bool buffered;
+
+  if ((off < 0) || (off > (off_t) MAX_FILE_SIZE))
+     { fuse_reply_err (req, EFBIG);
+       return;
+     }
+  if (enterInodeNo (LL_INODE (ino), EXCL, &p_lock) != 0)          /* enter critical region */
+     { fuse_reply_err (req, ENOLCK);
+       return;
+     }
+
+  buffered = false;                                                  /* the data clusters are allocated on flushing */
+  stat = soDelAllocWrite (LL_INODE (ino), buff, (uint32_t) size, (uint32_t) off, &buffered);
+  if ((stat == 0) && buffered)
+     stat = (int) size;
+     else if (stat == 0)                                             /* the data is written straight from the buffer */
+             stat = soStatCall (STAT_SC_WRITE, soWriteFh ((uint32_t) fi->fh, buff, (uint32_t) size, (uint32_t) off));
+  soTrace (TRACE_WRITE, LL_INODE (ino), TRACE_NO_INODE, NULL, NULL, off, size, 0, stat);
+
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
+     stat = -ENOLCK;
+
+  if (stat >= 0)
+     fuse_reply_write (req, (size_t) stat);
+     else fuse_reply_err (req, -stat);
+}
+
+/**
+ *  \brief Flush method.
+ *
+ *  It is called on each close() of an open file: the buffered data is written back.
+ *
+ *  \param req request handle
+ *  \param ino the inode number
+ *  \param fi file information
+ */
+
+static void sofs_ll_flush (fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi)
+{
+  soColorProbe (157, "07;31", "sofs_ll_flush (%lu, %p)\n", (unsigned long) ino, fi);
+
+  soStatScope (STAT_FUSE_FLUSH);
+
+  int stat;
+  pthread_rwlock_t *p_lock;
+
+  if (enterInodeNo (LL_INODE (ino), EXCL, &p_lock) != 0)          /* enter critical region */
+     { fuse_reply_err (req, ENOLCK);
+       return;
+     }
+
+  stat = soDelAllocFlush (LL_INODE (ino));                           /* the buffered data is written back */
+  soTrace (TRACE_FLUSH, LL_INODE (ino), TRACE_NO_INODE, NULL, NULL, 0, 0, 0, stat);
+
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
+     stat = -ENOLCK;
+
+  fuse_reply_err (req, -stat);
+}
+
+/**
+ *  \brief Release an open file.
+ *
+ *  \param req request handle
+ *  \param ino the inode number
+ *  \param fi file information
+ */
+
+static void sofs_ll_release (fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi)
+{
+  soColorProbe (158, "07;31", "sofs_ll_release (%lu, %p)\n", (unsigned long) ino, fi);
+
+  soStatScope (STAT_FUSE_RELEASE);
+
+  int stat;
+  pthread_rwlock_t *p_lock;
+
+  if (enterInodeNo (LL_INODE (ino), EXCL, &p_lock) != 0)          /* enter critical region */
+     { fuse_reply_err (req, ENOLCK);
+       return;
+     }
+
+  stat = soDelAllocFlush (LL_INODE (ino));                           /* the buffered data is written back */
+  if (soCloseFh ((uint32_t) fi->fh) != 0) stat = -EBADF;             /* the handle is released in any case */
+  fi->fh = (uint64_t) NULL_FH;
+  soTrace (TRACE_RELEASE, LL_INODE (ino), TRACE_NO_INODE, NULL, NULL, 0, 0, 0, stat);
+
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
+     stat = -ENOLCK;
+
+  fuse_reply_err (req, -stat);
+}
+
+/**
+ *  \brief Synchronize file contents.
+ *
+ *  \param req request handle
+ *  \param ino the inode number
+ *  \param datasync flag indicating if only data should be flushed
+ *  \param fi file information
+ */
+
+static void sofs_ll_fsync (fuse_req_t req, fuse_ino_t ino, int datasync, struct fuse_file_info *fi)
+{
+  soColorProbe (159, "07;31", "sofs_ll_fsync (%lu, %d, %p)\n", (unsigned long) ino, datasync, fi);
+
+  soStatScope (STAT_FUSE_FSYNC);
+
+  int stat;
+  pthread_rwlock_t *p_lock;
+
+  if (enterInodeNo (LL_INODE (ino), EXCL, &p_lock) != 0)          /* enter critical region */
+     { fuse_reply_err (req, ENOLCK);
+       return;
+     }
+
+  stat = soDelAllocFlush (LL_INODE (ino));                           /* the buffered data is written back */
+  if (stat == 0)                                                     /* and so is the time of last access */
+     stat = soAtimeSync (LL_INODE (ino));
+  if (stat == 0)
+     stat = soStatCall (STAT_SC_FSYNC, soFsyncFh ((uint32_t) fi->fh));
+  soTrace (TRACE_FSYNC, LL_INODE (ino), TRACE_NO_INODE, NULL, NULL, 0, 0, 0, stat);
+
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
+     stat = -ENOLCK;
+
+  fuse_reply_err (req, -stat);
+}
+
+/**
+ *  \brief Open a directory.
+ *
+ *  \param req request handle
+ *  \param ino the inode number
+ *  \param fi file information
+ */
+
+static void sofs_ll_opendir (fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi)
+{
+  soColorProbe (160, "07;31", "sofs_ll_opendir (%lu, %p)\n", (unsigned long) ino, fi);
+
+  soStatScope (STAT_FUSE_OPENDIR);
+
+  int stat;
+  pthread_rwlock_t *p_lock;
+
+  if (enterInodeNo (LL_INODE (ino), SHARED, &p_lock) != 0)        /* enter critical region */
+     { fuse_reply_err (req, ENOLCK);
+       return;
+     }
+
+  stat = soStatCall (STAT_SC_OPENDIR, llOpen (LL_INODE (ino), O_RDONLY, true));
+  fi->fh = (uint64_t) 0;
+  soTrace (TRACE_OPENDIR, LL_INODE (ino), TRACE_NO_INODE, NULL, NULL, 0, 0, 0, stat);
+
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
+     stat = -ENOLCK;
+
+  if (stat == 0)
+     fuse_reply_open (req, fi);
+     else fuse_reply_err (req, -stat);
+}
+
+/**
+ *  \brief Read a directory.
+ *
+ *  As many entries as fit into the buffer are read in a single request.
+ *
+ *  \param req request handle
+ *  \param ino the inode number
+ *  \param size maximum number of bytes to send
+ *  \param off offset to continue reading the directory stream
+ *  \param fi file information
+ */
+
+static void sofs_ll_readdir (fuse_req_t req, fuse_ino_t ino, size_t size, off_t off, struct fuse_file_info *fi)
+{
+  soColorProbe (161, "07;31", "sofs_ll_readdir (%lu, %"PRIu32", %"PRId32", %p)\n", (unsigned long) ino,
+                (uint32_t) size, (int32_t) off, fi);
+
+  soStatScope (STAT_FUSE_READDIR);
+
+  SOLLReaddirBuf rd;
+  int stat;
+  pthread_rwlock_t *p_lock;
+
+  if ((off < 0) || (off > (off_t) MAX_FILE_SIZE))
+     { fuse_reply_err (req, EINVAL);
+       return;
+     }
+  if ((rd.buf = malloc ((size != 0) ? size : 1)) == NULL)
+     { fuse_reply_err (req, ENOMEM);
+       return;
+     }
+  rd.req = req;
+  rd.size = size;
+  rd.len = 0;
+  if (enterInodeNo (LL_INODE (ino), SHARED, &p_lock) != 0)        /* enter critical region */
+     { free (rd.buf);
+       fuse_reply_err (req, ENOLCK);
+       return;
+     }
+
+  stat = soStatCall (STAT_SC_READDIR, soReaddirBatchInode (LL_INODE (ino), (uint32_t) off, llFillEntry, &rd, true));
+  soTrace (TRACE_READDIR, LL_INODE (ino), TRACE_NO_INODE, NULL, NULL, off, size, 0, stat);
+
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
+     stat = -ENOLCK;
+
+  if (stat >= 0)
+     fuse_reply_buf (req, rd.buf, rd.len);
+     else fuse_reply_err (req, -stat);
+  free (rd.buf);
+}
+
+/**
+ *  \brief Release an open directory.
+ *
+ *  \param req request handle
+ *  \param ino the inode number
+ *  \param fi file information
+ */
+
+static void sofs_ll_releasedir (fuse_req_t req, fuse_ino_t ino, struct fuse_file_info *fi)
+{
+  soColorProbe (162, "07;31", "sofs_ll_releasedir (%lu, %p)\n", (unsigned long) ino, fi);
+
+  soStatScope (STAT_FUSE_RELEASEDIR);
+
+  soTrace (TRACE_RELEASEDIR, LL_INODE (ino), TRACE_NO_INODE, NULL, NULL, 0, 0, 0, 0);
+  fuse_reply_err (req, 0);
+}
+
+/**
+ *  \brief Synchronize directory contents.
+ *
+ *  \param req request handle
+ *  \param ino the inode number
+ *  \param datasync flag indicating if only data should be flushed
+ *  \param fi file information
+ */
+
+static void sofs_ll_fsyncdir (fuse_req_t req, fuse_ino_t ino, int datasync, struct fuse_file_info *fi)
+{
+  soColorProbe (163, "07;31", "sofs_ll_fsyncdir (%lu, %d, %p)\n", (unsigned long) ino, datasync, fi);
+
+  soStatScope (STAT_FUSE_FSYNCDIR);
+
+  int stat;
+  pthread_rwlock_t *p_lock;
+  uint32_t fh;
+
+  if (enterInodeNo (LL_INODE (ino), SHARED, &p_lock) != 0)        /* enter critical region */
+     { fuse_reply_err (req, ENOLCK);
+       return;
+     }
+
+  if ((stat = soOpenFh (LL_INODE (ino), O_RDONLY, &fh)) == 0)       /* a handle is got only for synchronizing */
+     { stat = soStatCall (STAT_SC_FSYNC, soFsyncFh (fh));
+       soCloseFh (fh);
+     }
+  soTrace (TRACE_FSYNCDIR, LL_INODE (ino), TRACE_NO_INODE, NULL, NULL, 0, 0, 0, stat);
+
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
+     stat = -ENOLCK;
+
+  fuse_reply_err (req, -stat);
+}
+
+/**
+ *  \brief Get file system statistics.
+ *
+ *  \param req request handle
+ *  \param ino the inode number, zero means "undefined"
+ */
+
+static void sofs_ll_statfs (fuse_req_t req, fuse_ino_t ino)
+{
+  struct statvfs st;
+  int stat;
+
+  if ((stat = sofs_statfs ("/", &st)) == 0)
+     fuse_reply_statfs (req, &st);
+     else fuse_reply_err (req, -stat);
+}
+
+/**
+ *  \brief Set an extended attribute.
+ *
+ *  \remarks Only the control attributes of the root directory are supported (see sofs_setxattr).
+ */
+
+static void sofs_ll_setxattr (fuse_req_t req, fuse_ino_t ino, const char *name, const char *value, size_t size,
+                              int flags)
+{
+  fuse_reply_err (req, -sofs_setxattr (LL_XPATH (ino), name, value, size, flags));
+}
+
+/**
+ *  \brief Get an extended attribute.
+ *
+ *  \remarks Only the control attributes of the root directory are supported (see sofs_getxattr).
+ */
+
+static void sofs_ll_getxattr (fuse_req_t req, fuse_ino_t ino, const char *name, size_t size)
+{
+  char *value = NULL;
+  int len;
+
+  if ((size != 0) && ((value = malloc (size)) == NULL))
+     { fuse_reply_err (req, ENOMEM);
+       return;
+     }
+  if ((len = sofs_getxattr (LL_XPATH (ino), name, value, size)) < 0)
+     fuse_reply_err (req, -len);
+     else if (size == 0)
+             fuse_reply_xattr (req, (size_t) len);
+             else fuse_reply_buf (req, value, (size_t) len);
+  free (value);
+}
+
+/**
+ *  \brief List extended attribute names.
+ *
+ *  \remarks Only the control attributes of the root directory are listed (see sofs_listxattr).
+ */
+
+static void sofs_ll_listxattr (fuse_req_t req, fuse_ino_t ino, size_t size)
+{
+  char *list = NULL;
+  int len;
+
+  if ((size != 0) && ((list = malloc (size)) == NULL))
+     { fuse_reply_err (req, ENOMEM);
+       return;
+     }
+  if ((len = sofs_listxattr (LL_XPATH (ino), list, size)) < 0)
+     fuse_reply_err (req, -len);
+     else if (size == 0)
+             fuse_reply_xattr (req, (size_t) len);
+             else fuse_reply_buf (req, list, (size_t) len);
+  free (list);
+}
+
+/**
+ *  \brief Remove an extended attribute.
+ *
+ *  \remarks UNIMPLEMENTED (see sofs_removexattr).
+ */
+
+static void sofs_ll_removexattr (fuse_req_t req, fuse_ino_t ino, const char *name)
+{
+  fuse_reply_err (req, -sofs_removexattr (LL_XPATH (ino), name));
+}
+
+/**
+ *  \brief Check file access permissions.
+ *
+ *  \param req request handle
+ *  \param ino the inode number
+ *  \param mask requested access mode
+ */
+
+static void sofs_ll_access (fuse_req_t req, fuse_ino_t ino, int mask)
+{
+  soColorProbe (164, "07;31", "sofs_ll_access (%lu, %x)\n", (unsigned long) ino, mask);
+
+  soStatScope (STAT_FUSE_ACCESS);
+
+  SOInode inode;
+  int stat;
+  pthread_rwlock_t *p_lock;
+
+  if (enterInodeNo (LL_INODE (ino), SHARED, &p_lock) != 0)        /* enter critical region */
+     { fuse_reply_err (req, ENOLCK);
+       return;
+     }
+
+  if (mask == F_OK)                                                  /* only the existence of the file is checked */
+     stat = soReadInode (&inode, LL_INODE (ino), IUIN);
+     else stat = soStatCall (STAT_SC_ACCESS, soAccessGranted (LL_INODE (ino), (uint32_t) mask & (R | W | X)));
+  soTrace (TRACE_ACCESS, LL_INODE (ino), TRACE_NO_INODE, NULL, NULL, 0, 0, mask, stat);
+
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
+     stat = -ENOLCK;
+
+  fuse_reply_err (req, -stat);
+}
+
+/**
+ *  \brief Create and open a file.
+ *
+ *  \param req request handle
+ *  \param parent inode number of the parent directory
+ *  \param name to create
+ *  \param mode file type and mode with which to create the new file
+ *  \param fi file information
+ */
+
+static void sofs_ll_create (fuse_req_t req, fuse_ino_t parent, const char *name, mode_t mode,
+                            struct fuse_file_info *fi)
+{
+  soColorProbe (165, "07;31", "sofs_ll_create (%lu, \"%s\", %x, %p)\n", (unsigned long) parent, name,
+                (uint32_t) mode, fi);
+
+  soStatScope (STAT_FUSE_CREATE);
+
+  struct fuse_entry_param e;
+  int stat;
+  uint32_t nInode, fh;
+
+  if (enterNamespace (EXCL) != 0)                                  /* enter critical region */
+     { fuse_reply_err (req, ENOLCK);
+       return;
+     }
+
+  fh = NULL_FH;
+  stat = soStatCall (STAT_SC_MKNOD, llMakeNode (LL_INODE (parent), name, INODE_FILE, mode, &nInode));
+  if (stat == 0) stat = llEntry (nInode, &e);
+  if (stat == 0)                                                     /* the creator may open it whatever its mode */
+     stat = soOpenFh (nInode, fi->flags, &fh);
+  fi->fh = (uint64_t) fh;
+  soTrace (TRACE_CREATE, LL_INODE (parent), (stat == 0) ? nInode : TRACE_NO_INODE,
+           name, NULL, fi->flags, 0, mode, stat);
+
+  if (leaveNamespace () != 0)                                        /* exit critical region */
+     stat = -ENOLCK;
+
+  if (stat == 0)
+     fuse_reply_create (req, &e, fi);
+     else { if (fh != NULL_FH) soCloseFh (fh);
+            fuse_reply_err (req, -stat);
+          }
+}
+
+#if FUSE_VERSION >= 29
+
+/**
+ *  \brief Allocate space for an open file.
+ *
+ *  \param req request handle
+ *  \param ino the inode number
+ *  \param mode operation to be performed (FALLOC_FL_KEEP_SIZE and FALLOC_FL_PUNCH_HOLE)
+ *  \param offset starting [byte] position of the range
+ *  \param length length of the range in bytes
+ *  \param fi file information
+ */
+
+static void sofs_ll_fallocate (fuse_req_t req, fuse_ino_t ino, int mode, off_t offset, off_t length,
+                               struct fuse_file_info *fi)
+{
+  soColorProbe (168, "07;31", "sofs_ll_fallocate (%lu, %d, %"PRId64", %"PRId64", %p)\n", (unsigned long) ino, mode,
+                (int64_t) offset, (int64_t) length, fi);
+
+  soStatScope (STAT_FUSE_FALLOCATE);
+
+  int stat;
+  pthread_rwlock_t *p_lock;
+
+  if (enterInodeNo (LL_INODE (ino), EXCL, &p_lock) != 0)          /* enter critical region */
+     { fuse_reply_err (req, ENOLCK);
+       return;
+     }
+
+  if ((fi->flags & O_ACCMODE) == O_RDONLY)
+     stat = -EBADF;
+     else stat = allocRange (LL_INODE (ino), mode, offset, length);
+  soTrace (TRACE_FALLOCATE, LL_INODE (ino), TRACE_NO_INODE, NULL, NULL, offset, length, mode, stat);
+
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
+     stat = -ENOLCK;
+
+  fuse_reply_err (req, -stat);
+}
+
+#endif
+
+/**
+ *  \brief Ioctl: the commands SOFS_IOC_SEEK_DATA and SOFS_IOC_SEEK_HOLE find the next data or the next hole of an
+ *  open file.
+ *
+ *  \param req request handle
+ *  \param ino the inode number
+ *  \param cmd command
+ *  \param arg argument, as given by the caller
+ *  \param fi file information
+ *  \param flags FUSE_IOCTL_* flags
+ *  \param in_buf data copied in by the kernel
+ *  \param in_bufsz size of the data copied in
+ *  \param out_bufsz size of the data to be copied out
+ */
+
+static void sofs_ll_ioctl (fuse_req_t req, fuse_ino_t ino, int cmd, void *arg, struct fuse_file_info *fi,
+                           unsigned flags, const void *in_buf, size_t in_bufsz, size_t out_bufsz)
+{
+  soColorProbe (169, "07;31", "sofs_ll_ioctl (%lu, %x, %p, %p, %x, %p, %zu, %zu)\n", (unsigned long) ino,
+                (unsigned int) cmd, arg, fi, flags, in_buf, in_bufsz, out_bufsz);
+
+  soStatScope (STAT_FUSE_IOCTL);
+
+  int stat;
+  pthread_rwlock_t *p_lock;
+  uint64_t pos;
+
+  if ((in_bufsz < sizeof (pos)) || (out_bufsz < sizeof (pos)))    /* the argument is a position */
+     { fuse_reply_err (req, ENOTTY);
+       return;
+     }
+  memcpy (&pos, in_buf, sizeof (pos));
+
+  if (enterInodeNo (LL_INODE (ino), EXCL, &p_lock) != 0)          /* enter critical region */
+     { fuse_reply_err (req, ENOLCK);
+       return;
+     }
+
+  stat = seekData (LL_INODE (ino), cmd, &pos);
+
+  if (leaveInode (p_lock) != 0)                                      /* exit critical region */
+     stat = -ENOLCK;
+
+  if (stat == 0)
+     fuse_reply_ioctl (req, 0, &pos, sizeof (pos));
+     else fuse_reply_err (req, -stat);
+}
@@ -9,9 +9,21 @@
  *  <P><PRE>                mount_sofs13 [OPTIONS] supp-file mount-point
  *
  *               OPTIONS:
+ *                 -a mode  --- set update of access times: strict, relatime or noatime (default: strict)
+ *                 -c size  --- set buffercache size in MiB (default: 25 clusters)
  *                 -d       --- set debugging mode (default: no debugging)
+ *                 -e       --- describe the regular files created by trees of extents (default: lists of references)
+ *                 -i       --- use the low-level (inode-number) FUSE frontend (default: path-based)
  *                 -l depth --- set log depth (default: 0,0)
  *                 -L file  --- log file (default: stdout)
+ *                 -m       --- map the storage device into memory (default: system calls)
+ *                 -n       --- store the contents of small files and symbolic links in their inodes (default: in data
+ *                              clusters)
+ *                 -r name  --- set buffercache replacement policy: lru or 2q, with ",meta" to give priority to the
+ *                              superblock and the table of inodes (default: lru)
+ *                 -s file  --- dump the statistics of operations into file on unmounting (default: no dump)
+ *                 -u       --- submit batches of transfers through io_uring (default: synchronous transfers)
+ *                 -w p,a,r --- set write-back flusher period (s), age (s) and dirty ratio (%) (default: 5,30,10)
  *                 -h       --- print this help.</PRE>
  *
  *  \author Artur Carneiro Pereira - October 2005
@@ -0,0 +1,2910 @@
+/**
+ *  \file sofs_buffercache.c (implementation file)
+ *
+ *  \brief Access to buffered/unbuffered raw disk blocks and clusters.
+ *
+ *  The buffercache may be regarded as a storage area resident in main memory having the ability to store K data blocks
+ *  of the device's storage space. K is set at run time, either before the storage area is assigned to the storage
+ *  device, or while it is in use, the storage area being resized.
+ *  The storage area is allocated as a single page-aligned slab: the node metadata (block number, status and the links
+ *  of the two double-linked lists) is packed at its beginning and the buffer areas, which store the contents of the
+ *  data blocks, are packed after it, starting at a page boundary.
+ *  There are two kinds of nodes, each with its own list based on the last access time: block nodes, which store a
+ *  single block, and cluster nodes, which store a whole cluster of the data zone. Clusters are transferred as a whole,
+ *  so that a cluster access takes a single look up and a single transfer. A block is never stored in more than one
+ *  node: blocks of a cluster already stored in a cluster node are accessed there, and clusters some of whose blocks
+ *  are already stored in block nodes are accessed block by block.
+ *  Changed nodes are written back in the background by a flusher thread, in ascending order of physical block number,
+ *  when they become older than a given age or when the number of changed nodes exceeds a given ratio of the storage
+ *  area. When replacement is required, unchanged nodes close to the tail of the list based on the last access time are
+ *  preferred, so that reads seldom have to wait for a write-back.
+ *  Under the scan-resistant policy (2Q), each kind of nodes has, besides, a first-access queue, threaded through the
+ *  same links as the list based on the last access time: a node enters it when its block is not found, unless the
+ *  block was replaced from it recently (a ghost entry of the block is kept meanwhile), and it is not moved on hits.
+ *  Nodes of regions with priority are skipped when a node is selected for replacement, while they hold at most
+ *  PRIO_SHARE quarters of their kind.
+ *  Long runs of successive clusters are transferred straight between the caller's buffer and the storage device, so
+ *  that large sequential transfers are not copied through the buffer areas of the nodes, nor replace the nodes in use.
+ *  Clusters which are expected to be accessed soon may be queued for prefetching: a prefetcher thread reads them in
+ *  batches, without holding the access lock, and stores them in the storage area, unless they were meanwhile accessed
+ *  or written.
+ *  All operations are carried out in mutual exclusion.
+ *
+ *  The following operations are defined:
+ *    \li set the number of data blocks of the storage area
+ *    \li set the parameters of the write-back flusher
+ *    \li set the replacement policy and the regions of the storage device with priority
+ *    \li initialize the storage area and assign it to the storage device
+ *    \li unassign the storage area from the storage device and perform the required housekeeping duties
+ *    \li read a block of data from the buffercache
+ *    \li write a block of data to the buffercache
+ *    \li flush a block of data to the storage device
+ *    \li synchronize a block of data with the same block in the storage device
+ *    \li read a cluster of data from the buffercache
+ *    \li write a cluster of data to the buffercache
+ *    \li flush a cluster of data to the storage device
+ *    \li synchronize a cluster of data with the same cluster in the storage device
+ *    \li read a run of successive clusters of data from the buffercache
+ *    \li write a run of successive clusters of data to the buffercache
+ *    \li pin, unpin and mark as changed a block of data in the buffercache
+ *    \li pin, unpin and mark as changed a cluster of data in the buffercache
+ *    \li prefetch a cluster of data into the buffercache
+ *    \li discard a run of successive clusters of data
+ *    \li set the layout of the regions of the storage device
+ *    \li get, reset and report the statistics of the buffercache.
+ *
+ *  \author Artur Carneiro Pereira - September 2007
+ *  \author Miguel Oliveira e Silva - September 2009
+ *  \author António Rui Borges - July 2010 / August 2011
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "sofs_probe.h"
+#include "sofs_stats.h"
+#include "sofs_const.h"
+#include "sofs_rawdisk.h"
+#include "sofs_buffercache.h"
+#include "sofs_buffercachenode.h"
+#include "sofs_buffercacheinternals.h"
+
+/*
+ *  Internal data structure
+ */
+
+/** \brief maximum number of data blocks written back by the flusher in each activation step */
+#define MAX_WBACK  256
+/** \brief maximum number of adjacent nodes written back by a single vectored transfer */
+#define WRITE_RUN  64
+/** \brief maximum number of runs of adjacent nodes submitted together */
+#define WRITE_BATCH  16
+/** \brief maximum number of clusters not stored in the storage area read by a single vectored transfer */
+#define READ_RUN  64
+/** \brief number of entries of the queue of clusters to be prefetched */
+#define PREFETCH_QUEUE  128
+/** \brief maximum number of clusters read by the prefetcher in each activation step (and at most a quarter of the
+ *         cluster nodes) */
+#define PREFETCH_BATCH  16
+/** \brief number of cluster nodes which are kept to be replaced when a cluster is pinned (and at most a quarter of the
+ *         cluster nodes) */
+#define PIN_RESERVE  16
+
+/** \brief number of data blocks of the storage area, when the storage area is assigned to the storage device */
+static uint32_t capacity = K_DEFAULT;
+/** \brief type of the communication channel presently established with the storage device */
+static uint32_t commType = BUF;
+/** \brief number of blocks of the storage device */
+static uint32_t bnmax = 0;
+/** \brief page-aligned slab where the nodes and their buffer areas are stored */
+static void *slab = NULL;
+/** \brief array of nodes of the storage area (located at the beginning of the slab) */
+static SOBufferCacheNode *node = NULL;
+/** \brief number of nodes of the storage area */
+static uint32_t nNodes = 0;
+/** \brief lists of nodes of each kind which are not assigned to any block (linked through n_next) */
+static SOBufferCacheNode *freeList[2] = { NULL, NULL };
+/** \brief head of the double-linked list based on the physical block number (shared by both kinds of nodes) */
+static SOBufferCacheNode *nLHead = NULL;
+/** \brief heads of the double-linked lists based on the last access time (one for each kind of nodes) */
+static SOBufferCacheNode *lATLHead[2] = { NULL, NULL };
+/** \brief tails of the double-linked lists based on the last access time (one for each kind of nodes) */
+static SOBufferCacheNode *lATLTail[2] = { NULL, NULL };
+/** \brief heads of the first-access queues of the scan-resistant policy (one for each kind of nodes) */
+static SOBufferCacheNode *fQHead[2] = { NULL, NULL };
+/** \brief tails of the first-access queues of the scan-resistant policy (one for each kind of nodes) */
+static SOBufferCacheNode *fQTail[2] = { NULL, NULL };
+/** \brief number of nodes of each kind in the first-access queue */
+static uint32_t nFirst[2] = { 0, 0 };
+/** \brief number of nodes of each kind with priority */
+static uint32_t nPrio[2] = { 0, 0 };
+/** \brief replacement policy */
+static uint32_t replPolicy = BC_LRU;
+/** \brief regions of the storage device with priority, one bit per region */
+static uint32_t prioRegions = 0;
+
+/** \brief number of changed nodes of the storage area */
+static uint32_t nDirty = 0;
+/** \brief number of nodes of each kind of the storage area (the ones withdrawn from it excluded) */
+static uint32_t nActive[2] = { 0, 0 };
+/** \brief lists of nodes of each kind withdrawn from the storage area when it was shrunk (linked through n_next) */
+static SOBufferCacheNode *spareList[2] = { NULL, NULL };
+/** \brief number of nodes allocated, the ones withdrawn from the storage area included */
+static uint32_t nAllocated = 0;
+/** \brief slabs allocated when the storage area was enlarged */
+static void **extSlab = NULL;
+/** \brief number of slabs allocated when the storage area was enlarged */
+static uint32_t nExtSlabs = 0;
+
+/** \brief physical number of the first block of each region of the storage device (all zero, if it is not set) */
+static uint32_t regionStart[BC_REGIONS];
+/** \brief number of accesses to each region found in the storage area */
+static uint64_t hitCount[BC_REGIONS];
+/** \brief number of accesses to each region not found in the storage area */
+static uint64_t missCount[BC_REGIONS];
+/** \brief number of nodes replaced */
+static uint64_t evictCount = 0;
+/** \brief number of bytes written back to the storage device */
+static uint64_t wbackBytes = 0;
+/** \brief number of bytes transferred straight between the caller's buffers and the storage device */
+static uint64_t directBytes = 0;
+
+/** \brief access lock to the storage area */
+static pthread_mutex_t accessCR = PTHREAD_MUTEX_INITIALIZER;
+/** \brief condition signalled to wake up the flusher */
+static pthread_cond_t flusherWakeUp = PTHREAD_COND_INITIALIZER;
+/** \brief condition signalled when the flusher has completed a write-back */
+static pthread_cond_t wbackDone = PTHREAD_COND_INITIALIZER;
+/** \brief flusher thread */
+static pthread_t flusherThread;
+/** \brief signals if the flusher thread is running */
+static int flusherRunning = 0;
+/** \brief signals the flusher thread to terminate */
+static int flusherStop = 0;
+/** \brief period (in seconds) of activation of the flusher (zero disables it) */
+static uint32_t flushPeriod = FLUSH_PERIOD;
+/** \brief age (in seconds) above which a changed node is written back */
+static uint32_t dirtyAge = DIRTY_AGE;
+/** \brief percentage of changed nodes of the storage area above which changed nodes are written back regardless of
+ *         their age */
+static uint32_t dirtyRatio = DIRTY_RATIO;
+/** \brief staging area where the contents of the nodes being written back is copied to */
+static unsigned char *staging = NULL;
+/** \brief nodes whose contents was copied to the staging area */
+static SOBufferCacheNode *stagedNode[MAX_WBACK];
+/** \brief requests for the transfer of the runs of adjacent nodes copied to the staging area */
+static SORawRequest stagedReq[MAX_WBACK];
+/** \brief buffer descriptors of the runs of adjacent nodes copied to the staging area */
+static struct iovec stagedIov[MAX_WBACK];
+
+/** \brief prefetcher thread */
+static pthread_t prefetcherThread;
+/** \brief signals if the prefetcher thread is running */
+static int prefetcherRunning = 0;
+/** \brief signals the prefetcher thread to terminate */
+static int prefetcherStop = 0;
+/** \brief condition signalled to wake up the prefetcher */
+static pthread_cond_t prefetcherWakeUp = PTHREAD_COND_INITIALIZER;
+/** \brief queue of clusters to be prefetched (physical number of their first block) */
+static uint32_t pfQueue[PREFETCH_QUEUE];
+/** \brief index of the first entry and number of entries of the queue of clusters to be prefetched */
+static uint32_t pfHead = 0, pfCount = 0;
+/** \brief nodes where the clusters being prefetched are read into */
+static SOBufferCacheNode *pfNode[PREFETCH_BATCH];
+/** \brief signals the clusters being prefetched which were written meanwhile (their contents is discarded) */
+static int pfStale[PREFETCH_BATCH];
+/** \brief number of clusters being prefetched */
+static uint32_t nPfNode = 0;
+/** \brief requests for the transfer of the clusters being prefetched */
+static SORawRequest pfReq[PREFETCH_BATCH];
+/** \brief buffer descriptors of the clusters being prefetched */
+static struct iovec pfIov[PREFETCH_BATCH];
+
+/** \brief nodes of the batch of runs of adjacent nodes to be written back */
+static SOBufferCacheNode *batchNode[WRITE_BATCH * WRITE_RUN];
+/** \brief buffer descriptors of the batch of runs of adjacent nodes to be written back */
+static struct iovec batchIov[WRITE_BATCH * WRITE_RUN];
+/** \brief requests for the transfer of the batch of runs of adjacent nodes to be written back */
+static SORawRequest batchReq[WRITE_BATCH];
+/** \brief number of requests and of nodes of the batch */
+static uint32_t nBatchReq = 0, nBatchNode = 0;
+
+/** \brief kind of node which stores a single block (superblock, inode table, mapping table and bitmap) */
+#define BLOCK_NODE    0
+/** \brief kind of node which stores a whole cluster (data zone) */
+#define CLUSTER_NODE  1
+/** \brief kind of a node */
+#define KIND(p)  (((p)->nblks == 1) ? BLOCK_NODE : CLUSTER_NODE)
+/** \brief fraction (in 1/4) of the storage area which is assigned to cluster nodes */
+#define CLUSTER_SHARE  3
+/** \brief number of nodes close to the tail of the list based on the last access time which are searched for an
+ *         unchanged node, when replacement is required */
+#define EVICT_SCAN  8
+/** \brief fraction (in 1/4) of the nodes of a kind above which the first-access queue is replaced first */
+#define FIRST_SHARE  1
+/** \brief fraction (in 1/4) of the number of nodes which is kept as ghost entries of the first-access queue */
+#define GHOST_SHARE  2
+/** \brief fraction (in 1/4) of the nodes of a kind up to which the nodes with priority are skipped on replacement */
+#define PRIO_SHARE  2
+/** \brief pointers to the head and to the tail of the list or queue a node belongs to */
+#define HEAD(p)  (((p)->queue == FIRST_Q) ? &fQHead[KIND(p)] : &lATLHead[KIND(p)])
+#define TAIL(p)  (((p)->queue == FIRST_Q) ? &fQTail[KIND(p)] : &lATLTail[KIND(p)])
+
+/* Allusion to internal functions */
+
+static int openCache (const char *devname, uint32_t type);
+static int closeCache (void);
+static int readBlock (uint32_t n, void *buf);
+static int writeBlock (uint32_t n, void *buf);
+static int flushBlock (uint32_t n, void *buf);
+static int syncBlock (uint32_t n);
+static int readCluster (uint32_t n, void *buf);
+static int writeCluster (uint32_t n, void *buf);
+static int flushCluster (uint32_t n, void *buf);
+static int syncCluster (uint32_t n);
+static int readClusters (uint32_t n, uint32_t count, void *buf);
+static int writeClusters (uint32_t n, uint32_t count, void *buf);
+static int readDirect (uint32_t n, uint32_t count, void *buf);
+static int writeDirect (uint32_t n, uint32_t count, void *buf);
+static int discardClusters (uint32_t n, uint32_t count);
+static int pinBlock (uint32_t n, void **p_buf);
+static int unpinBlock (uint32_t n);
+static int markBlockDirty (uint32_t n);
+static int pinCluster (uint32_t n, void **p_buf);
+static int unpinCluster (uint32_t n);
+static int markClusterDirty (uint32_t n);
+static int allocStorageArea (uint32_t nBlocks);
+static void freeStorageArea (void);
+static void splitCapacity (uint32_t nBlocks, uint32_t *nKind);
+static void *allocSlab (uint32_t nBlk, uint32_t nClust, SOBufferCacheNode **p_nodes);
+static void initNodes (SOBufferCacheNode *nodes, uint32_t nBlk, uint32_t nClust);
+static int resizeStorageArea (uint32_t nBlocks);
+static int withdrawNode (uint32_t kind);
+static int enlargeStorageArea (uint32_t nBlk, uint32_t nClust);
+static void releaseSpareMemory (void);
+static int cmpBuffer (const void *a, const void *b);
+static uint32_t regionOf (uint32_t n);
+static void countAccess (uint32_t n, int hit);
+static void countWriteBack (uint32_t nblks);
+static void startFlusher (void);
+static int initGhosts (void);
+static void dropNode (SOBufferCacheNode *p);
+static void evictNode (SOBufferCacheNode *p);
+static SOBufferCacheNode *selectVictim (uint32_t kind);
+static SOBufferCacheNode *scanVictims (SOBufferCacheNode *tail, int skipPrio);
+static int spareNodes (uint32_t kind, uint32_t want);
+static SOBufferCacheNode *searchBlock (uint32_t n, uint32_t *p_off);
+static SOBufferCacheNode *searchCluster (uint32_t n);
+static SOBufferCacheNode *searchIdleBlock (uint32_t n, uint32_t *p_off);
+static SOBufferCacheNode *searchIdleCluster (uint32_t n);
+static int clusterOverlaps (uint32_t n);
+static int absorbOverlaps (uint32_t n);
+static int writeNode (SOBufferCacheNode *p);
+static void addNode (SOBufferCacheNode *p);
+static void touchNode (SOBufferCacheNode *p);
+static int getFreeNode (uint32_t kind, SOBufferCacheNode **p_node);
+static uint32_t now (void);
+static void markChanged (SOBufferCacheNode *p);
+static void markSame (SOBufferCacheNode *p);
+static int devRead (uint32_t n, uint32_t nblks, void *buf);
+static int devWrite (uint32_t n, uint32_t nblks, void *buf);
+static int devFlush (uint32_t n, uint32_t nblks, void *buf);
+static int addToBatch (SOBufferCacheNode *p);
+static int submitBatch (void);
+static void *flusher (void *arg);
+static uint32_t writeBackStep (void);
+static int prefetchCluster (uint32_t n);
+static void *prefetcher (void *arg);
+static void prefetchStep (void);
+static void noteWrite (uint32_t n, uint32_t nblks);
+static void stopThreads (void);
+static void putFreeNode (SOBufferCacheNode *p);
+
+/**
+ *  \brief Set the number of data blocks of the storage area.
+ *
+ *  The value takes effect the next time the storage area is assigned to the storage device by \e soOpenBufferCache.
+ *  If the storage area is already in use and the communication channel is buffered, it is resized straight away:
+ *  nodes are added to it, or the nodes not accessed for the longest time, unless pinned or being written back, are
+ *  written back, if changed, and withdrawn from it (the nodes are kept, to be reused if it grows again, but the memory
+ *  pages which only hold their buffer areas are returned to the system).
+ *
+ *  \param nBlocks number of data blocks of the storage area
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>number of data blocks</em> is smaller than \c BLOCKS_PER_CLUSTER
+ *  \return -\c EBUSY, if the storage area could not be shrunk that much, because too many nodes are pinned or being
+ *          written back (it is shrunk as much as possible)
+ *  \return -\c ENOMEM, if there is no memory to enlarge the storage area
+ *  \return -\c EIO, if it fails on writing back a node
+ */
+
+int soSetBufferCacheCapacity (uint32_t nBlocks)
+{
+  soColorProbe (821, "07;31", "soSetBufferCacheCapacity(%"PRIu32")\n", nBlocks);
+
+  int stat;                                      /* status of operation */
+
+  if (nBlocks < BLOCKS_PER_CLUSTER) return -EINVAL;  /* a cluster must fit in the storage area */
+
+  pthread_mutex_lock (&accessCR);
+  capacity = nBlocks;
+  stat = 0;
+  if ((bnmax != 0) && (commType == BUF))         /* the storage area is in use */
+     stat = resizeStorageArea (nBlocks);
+  pthread_mutex_unlock (&accessCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Set the parameters of the write-back flusher.
+ *
+ *  The values take effect straight away, if the storage area is in use, the flusher being started, if it was not
+ *  running, or left idle while the period is zero, or the next time the storage area is assigned to the storage device
+ *  by \e soOpenBufferCache, otherwise.
+ *
+ *  \param period period (in seconds) of activation of the flusher (zero disables it)
+ *  \param age age (in seconds) above which a changed node is written back
+ *  \param ratio percentage of changed nodes of the storage area above which changed nodes are written back regardless
+ *               of their age
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>ratio</em> is greater than 100
+ */
+
+int soSetBufferCacheFlusher (uint32_t period, uint32_t age, uint32_t ratio)
+{
+  soColorProbe (828, "07;31", "soSetBufferCacheFlusher(%"PRIu32", %"PRIu32", %"PRIu32")\n", period, age, ratio);
+
+  if (ratio > 100) return -EINVAL;
+
+  pthread_mutex_lock (&accessCR);
+  flushPeriod = period;
+  dirtyAge = age;
+  dirtyRatio = ratio;
+  if ((bnmax != 0) && (commType == BUF))         /* the storage area is in use */
+     { if (flusherRunning)
+          pthread_cond_signal (&flusherWakeUp);  /* the flusher waits again, or idles, according to the new period */
+          else if ((flushPeriod != 0) && !flusherStop) startFlusher ();  /* not while it is being closed */
+     }
+  pthread_mutex_unlock (&accessCR);
+
+  return 0;
+}
+
+/**
+ *  \brief Set the replacement policy and the regions of the storage device with priority.
+ *
+ *  The values take effect straight away: if the policy changes while the storage area is in use, the nodes of the
+ *  first-access queue join the main list, or they all start in the main list, and the priority of every node is set
+ *  anew.
+ *
+ *  \param policy replacement policy (\c BC_LRU or \c BC_2Q)
+ *  \param prio regions of the storage device with priority, one bit per region (<tt>1 << BC_ITABLE</tt>, for instance)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>policy</em> is unknown or the <em>regions</em> do not exist
+ *  \return -\c ENOMEM, if there is no memory to keep track of the nodes replaced recently
+ */
+
+int soSetBufferCachePolicy (uint32_t policy, uint32_t prio)
+{
+  soColorProbe (836, "07;31", "soSetBufferCachePolicy(%"PRIu32", %#"PRIx32")\n", policy, prio);
+
+  SOBufferCacheNode *p;                          /* pointer to a node of the storage area */
+  uint32_t kind;                                 /* kind of node */
+  int stat;                                      /* status of operation */
+
+  if ((policy != BC_LRU) && (policy != BC_2Q)) return -EINVAL;
+  if ((prio >> BC_REGIONS) != 0) return -EINVAL;
+
+  pthread_mutex_lock (&accessCR);
+  stat = 0;
+  if ((bnmax != 0) && (commType == BUF))         /* the storage area is in use */
+     { if ((policy == BC_2Q) && (replPolicy != BC_2Q) && ((stat = initGhosts ()) != 0))
+          { pthread_mutex_unlock (&accessCR);
+            return stat;
+          }
+       if (policy == BC_LRU)                     /* the first-access queues join the main lists */
+          { for (kind = BLOCK_NODE; kind <= CLUSTER_NODE; kind++)
+              while ((p = fQTail[kind]) != NULL)
+              { removeNode (p, &nLHead, &fQHead[kind], &fQTail[kind]);
+                p->queue = MAIN_Q;
+                insertNode (p, &nLHead, &lATLHead[kind], &lATLTail[kind]);
+              }
+            nFirst[BLOCK_NODE] = nFirst[CLUSTER_NODE] = 0;
+            freeGhostIndex ();
+          }
+       nPrio[BLOCK_NODE] = nPrio[CLUSTER_NODE] = 0;
+       for (p = nLHead; p != NULL; p = p->n_next)
+       { p->prio = (prio >> regionOf (p->n)) & 1;
+         nPrio[KIND(p)] += p->prio;
+       }
+     }
+  replPolicy = policy;
+  prioRegions = prio;
+  pthread_mutex_unlock (&accessCR);
+
+  return 0;
+}
+
+/**
+ *  \brief Initialize the storage area and assign it to the storage device.
+ *
+ *  A communication channel is established with the storage device so that data transfers between main memory and the
+ *  storage device may be minimized.
+ *  This communication may be unbuffered or buffered: it will be unbuffered, if the second argument is \c UNBUF , and
+ *  buffered, in any other case.
+ *
+ *  \param devname absolute path to the Linux file that simulates the storage device
+ *  \param type type of the communication channel that is opened
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the argument is \c NULL
+ *  \return -\c EBUSY, if the storage area is already in use or the device is already opened
+ *  \return -\c ENOMEM, if there is no memory to allocate the storage area
+ *  \return -\c ELIBBAD, if the supporting file size is invalid
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soOpenBufferCache (const char *devname, uint32_t type)
+{
+  soColorProbe (811, "07;31", "soOpenBufferCache(\"%s\", %"PRIu32")\n", devname, type);
+
+  int stat;                                      /* status of operation */
+
+  pthread_mutex_lock (&accessCR);
+  stat = openCache (devname, type);
+  pthread_mutex_unlock (&accessCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Unassign the storage area from the storage device and perform the required housekeeping duties.
+ *
+ *  The buffered/unbuffered communication channel previously established with the storage device is closed.
+ *  This means, namely, that the contents of the storage area is flushed into the storage device to keep data
+ *  consistent.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -\c ELIBBAD, if the internal data is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soCloseBufferCache (void)
+{
+  soColorProbe (812, "07;31", "soCloseBufferCache()\n");
+
+  int stat;                                      /* status of operation */
+
+  stopThreads ();                                /* the flusher and the prefetcher must not hold the access lock meanwhile */
+  pthread_mutex_lock (&accessCR);
+  stat = closeCache ();
+  pthread_mutex_unlock (&accessCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Read a block of data from the buffercache.
+ *
+ *  Both the physical number of the data block to be read and a pointer to a previously allocated buffer are supplied
+ *  as arguments.
+ *
+ *  \param n physical number of the data block to be read from
+ *  \param buf pointer to the buffer where the data must be read into
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>buffer pointer</em> is \c NULL or the <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soReadCacheBlock (uint32_t n, void *buf)
+{
+  soColorProbe (813, "07;31", "soReadCacheBlock(%"PRIu32", %p)\n", n, buf);
+
+  int stat;                                      /* status of operation */
+
+  pthread_mutex_lock (&accessCR);
+  stat = readBlock (n, buf);
+  pthread_mutex_unlock (&accessCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Write a block of data to the buffercache.
+ *
+ *  Both the physical number of the data block to be written and a pointer to a previously allocated buffer are supplied
+ *  as arguments.
+ *
+ *  \param n physical number of the block to be written into
+ *  \param buf pointer to the buffer containing the data to be written from
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if <em>buffer pointer</em> is \c NULL or <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soWriteCacheBlock (uint32_t n, void *buf)
+{
+  soColorProbe (814, "07;31", "soWriteCacheBlock(%"PRIu32", %p)\n", n, buf);
+
+  int stat;                                      /* status of operation */
+
+  pthread_mutex_lock (&accessCR);
+  stat = writeBlock (n, buf);
+  pthread_mutex_unlock (&accessCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Flush a block of data to the storage device.
+ *
+ *  Both the physical number of the data block to be written and a pointer to a previously allocated buffer are supplied
+ *  as arguments.
+ *
+ *  \param n physical number of the block to be flushed
+ *  \param buf pointer to the buffer containing the data to be written from
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if <em>buffer pointer</em> is \c NULL or <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soFlushCacheBlock (uint32_t n, void *buf)
+{
+  soColorProbe (815, "07;31", "soFlushCacheBlock(%"PRIu32", %p)\n", n, buf);
+
+  int stat;                                      /* status of operation */
+
+  pthread_mutex_lock (&accessCR);
+  stat = flushBlock (n, buf);
+  pthread_mutex_unlock (&accessCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Synchronize a block of data with the same block in the storage device.
+ *
+ *  The physical number of the data block to be synchronized is supplied as argument.
+ *
+ *  \param n physical number of the block to be synchronized
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soSyncCacheBlock (uint32_t n)
+{
+  soColorProbe (816, "07;31", "soSyncCacheBlock(%"PRIu32")\n", n);
+
+  int stat;                                      /* status of operation */
+
+  pthread_mutex_lock (&accessCR);
+  stat = syncBlock (n);
+  pthread_mutex_unlock (&accessCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Read a cluster of data from the buffercache.
+ *
+ *  The device is organized as a linear array of data blocks. A cluster is a group of successive blocks.
+ *  Both the physical number of the first block of the data cluster to be read and a pointer to a previously allocated
+ *  buffer are supplied as arguments.
+ *
+ *  \param n physical number of the first block of the data cluster to be read from
+ *  \param buf pointer to the buffer where the data must be read into
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>buffer pointer</em> is \c NULL or the <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soReadCacheCluster (uint32_t n, void *buf)
+{
+  soColorProbe (817, "07;31", "soReadCacheCluster(%"PRIu32", %p)\n", n, buf);
+
+  int stat;                                      /* status of operation */
+
+  pthread_mutex_lock (&accessCR);
+  stat = readCluster (n, buf);
+  pthread_mutex_unlock (&accessCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Write a cluster of data to the buffercache.
+ *
+ *  The device is organized as a linear array of data blocks. A cluster is a group of successive blocks.
+ *  Both the physical number of the first block of the data cluster to be written and a pointer to a previously
+ *  allocated buffer are supplied as arguments.
+ *
+ *  \param n physical number of the first block of the data cluster to be written into
+ *  \param buf pointer to the buffer containing the data to be written from
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if <em>buffer pointer</em> is \c NULL or <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soWriteCacheCluster (uint32_t n, void *buf)
+{
+  soColorProbe (818, "07;31", "soWriteCacheCluster(%"PRIu32", %p)\n", n, buf);
+
+  int stat;                                      /* status of operation */
+
+  pthread_mutex_lock (&accessCR);
+  stat = writeCluster (n, buf);
+  pthread_mutex_unlock (&accessCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Flush a cluster of data to the storage device.
+ *
+ *  The device is organized as a linear array of data blocks. A cluster is a group of successive blocks.
+ *  Both the physical number of the first block of the data cluster to be flushed and a pointer to a previously
+ *  allocated buffer are supplied as arguments.
+ *
+ *  \param n physical number of the first block of the data cluster to be flushed
+ *  \param buf pointer to the buffer containing the data to be written from
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if <em>buffer pointer</em> is \c NULL or <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soFlushCacheCluster (uint32_t n, void *buf)
+{
+  soColorProbe (819, "07;31", "soFlushCacheCluster(%"PRIu32", %p)\n", n, buf);
+
+  int stat;                                      /* status of operation */
+
+  pthread_mutex_lock (&accessCR);
+  stat = flushCluster (n, buf);
+  pthread_mutex_unlock (&accessCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Synchronize a cluster of data with the same cluster in the storage device.
+ *
+ *  The device is organized as a linear array of data blocks. A cluster is a group of successive blocks.
+ *  The physical number of the data cluster to be synchronized is supplied as argument.
+ *
+ *  \param n physical number of the first block of the data cluster to be synchronized
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soSyncCacheCluster (uint32_t n)
+{
+  soColorProbe (820, "07;31", "soSyncCacheCluster(%"PRIu32")\n", n);
+
+  int stat;                                      /* status of operation */
+
+  pthread_mutex_lock (&accessCR);
+  stat = syncCluster (n);
+  pthread_mutex_unlock (&accessCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Read a run of successive clusters of data from the buffercache.
+ *
+ *  The device is organized as a linear array of data blocks. A cluster is a group of successive blocks.
+ *  The physical number of the first block of the first data cluster of the run, the number of data clusters and a
+ *  pointer to a previously allocated buffer, large enough to hold all of them, are supplied as arguments.
+ *
+ *  \param n physical number of the first block of the first data cluster of the run to be read from
+ *  \param count number of data clusters of the run
+ *  \param buf pointer to the buffer where the data must be read into
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>buffer pointer</em> is \c NULL, the <em>number of data clusters</em> is zero or the
+ *          run is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soReadCacheClusters (uint32_t n, uint32_t count, void *buf)
+{
+  soColorProbe (830, "07;31", "soReadCacheClusters(%"PRIu32", %"PRIu32", %p)\n", n, count, buf);
+
+  int stat;                                      /* status of operation */
+
+  pthread_mutex_lock (&accessCR);
+  stat = readClusters (n, count, buf);
+  pthread_mutex_unlock (&accessCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Write a run of successive clusters of data to the buffercache.
+ *
+ *  The device is organized as a linear array of data blocks. A cluster is a group of successive blocks.
+ *  The physical number of the first block of the first data cluster of the run, the number of data clusters and a
+ *  pointer to a previously allocated buffer containing all of them are supplied as arguments.
+ *
+ *  \param n physical number of the first block of the first data cluster of the run to be written into
+ *  \param count number of data clusters of the run
+ *  \param buf pointer to the buffer containing the data to be written from
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>buffer pointer</em> is \c NULL, the <em>number of data clusters</em> is zero or the
+ *          run is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soWriteCacheClusters (uint32_t n, uint32_t count, void *buf)
+{
+  soColorProbe (831, "07;31", "soWriteCacheClusters(%"PRIu32", %"PRIu32", %p)\n", n, count, buf);
+
+  int stat;                                      /* status of operation */
+
+  pthread_mutex_lock (&accessCR);
+  stat = writeClusters (n, count, buf);
+  pthread_mutex_unlock (&accessCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Pin a block of data in the buffercache.
+ *
+ *  The block is brought into the storage area, if it is not there yet, and a pointer to its contents in the storage
+ *  area is returned. The node where it is stored is not selected for replacement until every pin on it is released.
+ *  The contents may be directly read and modified through the pointer; in the latter case, the block must be marked
+ *  as changed by calling \e soMarkCacheBlockDirty before it is unpinned.
+ *  Closing the buffercache releases all pins.
+ *
+ *  \param n physical number of the data block to be pinned
+ *  \param p_buf pointer to a location where the pointer to the contents of the block is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>pointer</em> is \c NULL or the <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c ENOTSUP, if the communication channel is unbuffered
+ *  \return -\c ENOBUFS, if all the nodes of the storage area are pinned
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soPinCacheBlock (uint32_t n, void **p_buf)
+{
+  soColorProbe (822, "07;31", "soPinCacheBlock(%"PRIu32", %p)\n", n, p_buf);
+
+  int stat;                                      /* status of operation */
+
+  pthread_mutex_lock (&accessCR);
+  stat = pinBlock (n, p_buf);
+  pthread_mutex_unlock (&accessCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Release a pin on a block of data in the buffercache.
+ *
+ *  \param n physical number of the data block to be unpinned
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>block number</em> is out of range or the block is not pinned
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c ENOTSUP, if the communication channel is unbuffered
+ */
+
+int soUnpinCacheBlock (uint32_t n)
+{
+  soColorProbe (823, "07;31", "soUnpinCacheBlock(%"PRIu32")\n", n);
+
+  int stat;                                      /* status of operation */
+
+  pthread_mutex_lock (&accessCR);
+  stat = unpinBlock (n);
+  pthread_mutex_unlock (&accessCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Mark a block of data in the buffercache as changed.
+ *
+ *  It is meant to be used when the contents of a pinned block is modified through the pointer returned by
+ *  \e soPinCacheBlock.
+ *
+ *  \param n physical number of the data block to be marked
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>block number</em> is out of range or the block is not stored in the storage area
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c ENOTSUP, if the communication channel is unbuffered
+ */
+
+int soMarkCacheBlockDirty (uint32_t n)
+{
+  soColorProbe (824, "07;31", "soMarkCacheBlockDirty(%"PRIu32")\n", n);
+
+  int stat;                                      /* status of operation */
+
+  pthread_mutex_lock (&accessCR);
+  stat = markBlockDirty (n);
+  pthread_mutex_unlock (&accessCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Pin a cluster of data in the buffercache.
+ *
+ *  The device is organized as a linear array of data blocks. A cluster is a group of successive blocks.
+ *  The cluster is brought into the storage area as a whole, if it is not there yet, and a pointer to its contents in
+ *  the storage area is returned. The node where it is stored is not selected for replacement until every pin on it is
+ *  released. The contents may be directly read and modified through the pointer; in the latter case, the cluster must
+ *  be marked as changed by calling \e soMarkCacheClusterDirty before it is unpinned.
+ *  A cluster is not pinned if that would leave fewer than a reserve of nodes which may be replaced, so that the
+ *  other accesses never run out of nodes because of the pins.
+ *  Closing the buffercache releases all pins.
+ *
+ *  \param n physical number of the first block of the data cluster to be pinned
+ *  \param p_buf pointer to a location where the pointer to the contents of the cluster is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>pointer</em> is \c NULL or the <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c ENOTSUP, if the communication channel is unbuffered
+ *  \return -\c EBUSY, if some of the blocks of the cluster are pinned in another node
+ *  \return -\c ENOBUFS, if pinning it would leave too few nodes of the storage area to be replaced
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soPinCacheCluster (uint32_t n, void **p_buf)
+{
+  soColorProbe (825, "07;31", "soPinCacheCluster(%"PRIu32", %p)\n", n, p_buf);
+
+  int stat;                                      /* status of operation */
+
+  pthread_mutex_lock (&accessCR);
+  stat = pinCluster (n, p_buf);
+  pthread_mutex_unlock (&accessCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Release a pin on a cluster of data in the buffercache.
+ *
+ *  \param n physical number of the first block of the data cluster to be unpinned
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>block number</em> is out of range or the cluster is not pinned
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c ENOTSUP, if the communication channel is unbuffered
+ */
+
+int soUnpinCacheCluster (uint32_t n)
+{
+  soColorProbe (826, "07;31", "soUnpinCacheCluster(%"PRIu32")\n", n);
+
+  int stat;                                      /* status of operation */
+
+  pthread_mutex_lock (&accessCR);
+  stat = unpinCluster (n);
+  pthread_mutex_unlock (&accessCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Mark a cluster of data in the buffercache as changed.
+ *
+ *  It is meant to be used when the contents of a pinned cluster is modified through the pointer returned by
+ *  \e soPinCacheCluster.
+ *
+ *  \param n physical number of the first block of the data cluster to be marked
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>block number</em> is out of range or the cluster is not stored in the storage area
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c ENOTSUP, if the communication channel is unbuffered
+ */
+
+int soMarkCacheClusterDirty (uint32_t n)
+{
+  soColorProbe (827, "07;31", "soMarkCacheClusterDirty(%"PRIu32")\n", n);
+
+  int stat;                                      /* status of operation */
+
+  pthread_mutex_lock (&accessCR);
+  stat = markClusterDirty (n);
+  pthread_mutex_unlock (&accessCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Prefetch a cluster of data into the buffercache.
+ *
+ *  The cluster is queued to be read into the storage area in the background, so that a later access to it does not
+ *  have to wait for the storage device. Nothing is done if the communication channel is unbuffered, the cluster, or
+ *  some of its blocks, are already stored in the storage area, or the queue is full: it is only a hint.
+ *
+ *  \param n physical number of the first block of the data cluster to be prefetched
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ */
+
+int soPrefetchCacheCluster (uint32_t n)
+{
+  soColorProbe (829, "07;31", "soPrefetchCacheCluster(%"PRIu32")\n", n);
+
+  int stat;                                      /* status of operation */
+
+  pthread_mutex_lock (&accessCR);
+  stat = prefetchCluster (n);
+  pthread_mutex_unlock (&accessCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Discard a run of successive clusters of data.
+ *
+ *  The device is organized as a linear array of data blocks. A cluster is a group of successive blocks.
+ *  The contents of the run is no longer needed: its copies in the storage area are dropped, even if changed, so that
+ *  they are never written back, the nodes where only some of the blocks of a cluster are stored excepted, which are
+ *  written back first, if changed, and the run is discarded on the storage device, whose room may then be reclaimed.
+ *
+ *  \param n physical number of the first block of the first data cluster of the run to be discarded
+ *  \param count number of data clusters of the run
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>number of data clusters</em> is zero or the run is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EBUSY, if some of the data clusters are pinned (the run is not discarded on the storage device)
+ *  \return -\c EOPNOTSUPP, if the storage device does not allow it
+ *  \return -\c EIO, if it fails on writing
+ *  \return -<em>other specific error</em> issued by \e soDiscardRawBlocks
+ */
+
+int soDiscardCacheClusters (uint32_t n, uint32_t count)
+{
+  soColorProbe (837, "07;31", "soDiscardCacheClusters(%"PRIu32", %"PRIu32")\n", n, count);
+
+  int stat;                                      /* status of operation */
+
+  pthread_mutex_lock (&accessCR);
+  stat = discardClusters (n, count);
+  pthread_mutex_unlock (&accessCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Set the layout of the regions of the storage device.
+ *
+ *  It only serves to account the accesses to each region separately. Until it is set, block zero is accounted to the
+ *  superblock and every other block to the data zone. It is reset when the storage area is unassigned.
+ *
+ *  \param itable physical number of the first block of the table of inodes
+ *  \param ciutable physical number of the first block of the mapping table cluster-to-inode
+ *  \param bitmap physical number of the first block of the bitmap table to free data clusters
+ *  \param dzone physical number of the first block of the data zone
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the regions are not laid out in this order after the superblock
+ */
+
+int soSetBufferCacheLayout (uint32_t itable, uint32_t ciutable, uint32_t bitmap, uint32_t dzone)
+{
+  soColorProbe (832, "07;31", "soSetBufferCacheLayout(%"PRIu32", %"PRIu32", %"PRIu32", %"PRIu32")\n",
+                itable, ciutable, bitmap, dzone);
+
+  if ((itable == 0) || (ciutable < itable) || (bitmap < ciutable) || (dzone < bitmap))
+     return -EINVAL;
+
+  pthread_mutex_lock (&accessCR);
+  regionStart[BC_SUPERBLOCK] = 0;
+  regionStart[BC_ITABLE] = itable;
+  regionStart[BC_CIUTABLE] = ciutable;
+  regionStart[BC_BITMAP] = bitmap;
+  regionStart[BC_DZONE] = dzone;
+  pthread_mutex_unlock (&accessCR);
+
+  return 0;
+}
+
+/**
+ *  \brief Get the statistics and the parameters of the buffercache.
+ *
+ *  \param p_stats pointer to the location where they are to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the pointer is \c NULL
+ */
+
+int soGetBufferCacheStats (SOBufferCacheStats *p_stats)
+{
+  soColorProbe (833, "07;31", "soGetBufferCacheStats(%p)\n", p_stats);
+
+  SOBufferCacheNode *p;                          /* pointer to a node of the storage area */
+
+  if (p_stats == NULL) return -EINVAL;           /* checking for null pointer */
+
+  pthread_mutex_lock (&accessCR);
+  memcpy (p_stats->hits, hitCount, sizeof (hitCount));
+  memcpy (p_stats->misses, missCount, sizeof (missCount));
+  p_stats->evictions = evictCount;
+  p_stats->wbackBytes = wbackBytes;
+  p_stats->directBytes = directBytes;
+  p_stats->inUse = (bnmax != 0);
+  p_stats->capacity = capacity;
+  p_stats->nodes = nNodes;
+  p_stats->dirty = nDirty;
+  p_stats->pinned = 0;
+  for (p = nLHead; p != NULL; p = p->n_next)
+    if (p->pin != 0) p_stats->pinned += 1;
+  p_stats->period = flushPeriod;
+  p_stats->age = dirtyAge;
+  p_stats->ratio = dirtyRatio;
+  p_stats->policy = replPolicy;
+  p_stats->prio = prioRegions;
+  pthread_mutex_unlock (&accessCR);
+
+  return 0;
+}
+
+/**
+ *  \brief Reset the statistics of the buffercache.
+ */
+
+void soResetBufferCacheStats (void)
+{
+  soColorProbe (834, "07;31", "soResetBufferCacheStats()\n");
+
+  pthread_mutex_lock (&accessCR);
+  memset (hitCount, 0, sizeof (hitCount));
+  memset (missCount, 0, sizeof (missCount));
+  evictCount = wbackBytes = directBytes = 0;
+  pthread_mutex_unlock (&accessCR);
+}
+
+/**
+ *  \brief Report the statistics and the parameters of the buffercache in a buffer.
+ *
+ *  The hit ratio of each region is reported, besides the values returned by \e soGetBufferCacheStats. As with
+ *  \e snprintf, at most <tt>size - 1</tt> characters are stored and the report is NUL-terminated, if \e size is not
+ *  zero.
+ *
+ *  \param buf pointer to the buffer where the report is to be stored (it may be \c NULL, if \e size is zero)
+ *  \param size size of the buffer
+ *
+ *  \return <em>length of the whole report</em>
+ */
+
+int soReportBufferCacheStats (char *buf, size_t size)
+{
+  soColorProbe (835, "07;31", "soReportBufferCacheStats(%p, %zu)\n", buf, size);
+
+  static const char *name[BC_REGIONS] = { "superblock", "itable", "ciutable", "bitmap", "dzone" };
+  SOBufferCacheStats st;                         /* statistics and parameters of the buffercache */
+  uint64_t hits, misses;                         /* number of accesses found and not found */
+  uint64_t tHits, tMisses;                       /* total number of accesses found and not found */
+  size_t len;                                    /* length of the report */
+  uint32_t r;                                    /* region */
+  int k;                                         /* length of a line */
+
+  soGetBufferCacheStats (&st);
+  k = snprintf (buf, size, "buffercache %s: capacity %"PRIu32" blocks, %"PRIu32" nodes, %"PRIu32" changed, "
+                "%"PRIu32" pinned\nflusher: period %"PRIu32" s, age %"PRIu32" s, ratio %"PRIu32" %%\n"
+                "evictions %"PRIu64", written back %"PRIu64" bytes, direct %"PRIu64" bytes\npolicy %s, priority to",
+                st.inUse ? "in use" : "idle", st.capacity, st.nodes, st.dirty, st.pinned, st.period, st.age, st.ratio,
+                st.evictions, st.wbackBytes, st.directBytes, (st.policy == BC_2Q) ? "2q" : "lru");
+  len = (k > 0) ? (size_t) k : 0;
+  for (r = 0; r <= BC_REGIONS; r++)              /* the regions with priority, or none */
+  { if ((r < BC_REGIONS) && !((st.prio >> r) & 1)) continue;
+    if ((r == BC_REGIONS) && (st.prio != 0)) break;
+    k = snprintf ((len < size) ? buf + len : NULL, (len < size) ? size - len : 0, " %s",
+                  (r < BC_REGIONS) ? name[r] : "none");
+    if (k > 0) len += (size_t) k;
+  }
+  k = snprintf ((len < size) ? buf + len : NULL, (len < size) ? size - len : 0, "\n%-10s %14s %14s %8s\n",
+                "region", "hits", "misses", "ratio");
+  if (k > 0) len += (size_t) k;
+  tHits = tMisses = 0;
+  for (r = 0; r <= BC_REGIONS; r++)              /* the last line sums up the regions */
+  { if (r < BC_REGIONS)
+       { hits = st.hits[r];
+         misses = st.misses[r];
+         tHits += hits;
+         tMisses += misses;
+       }
+       else { hits = tHits;
+              misses = tMisses;
+            }
+    k = snprintf ((len < size) ? buf + len : NULL, (len < size) ? size - len : 0,
+                  "%-10s %14"PRIu64" %14"PRIu64" %7.2f%%\n", (r < BC_REGIONS) ? name[r] : "total", hits, misses,
+                  (hits + misses != 0) ? 100.0 * (double) hits / (double) (hits + misses) : 0.0);
+    if (k > 0) len += (size_t) k;
+  }
+
+  return (int) len;
+}
+
+/*
+ *  Internal functions
+ */
+
+/*
+ *  Implementation of soOpenBufferCache (the caller holds the access lock).
+ */
+
+static int openCache (const char *devname, uint32_t type)
+{
+  int stat;                                      /* status of operation */
+
+  if (devname == NULL) return -EINVAL;           /* checking for null pointer */
+  if (bnmax != 0) return -EBUSY;                 /* checking for storage area in use */
+
+  commType = (type == UNBUF) ? UNBUF : BUF;
+  memset (hitCount, 0, sizeof (hitCount));
+  memset (missCount, 0, sizeof (missCount));
+  evictCount = wbackBytes = directBytes = 0;
+  if ((commType == BUF) && ((stat = allocStorageArea (capacity)) != 0))
+     return stat;
+  if ((stat = soOpenDevice (devname, &bnmax)) != 0)
+     { freeStorageArea ();
+       commType = BUF;
+       bnmax = 0;
+       return stat;
+     }
+
+  /* start the write-back flusher and the prefetcher */
+
+  flusherStop = 0;
+  if ((commType == BUF) && (flushPeriod != 0))
+     startFlusher ();
+  if (commType == BUF)
+     { prefetcherStop = 0;
+       pfHead = pfCount = nPfNode = 0;
+       if (pthread_create (&prefetcherThread, NULL, prefetcher, NULL) == 0)
+          prefetcherRunning = 1;
+     }
+
+  return 0;
+}
+
+/*
+ *  Implementation of soCloseBufferCache (the caller holds the access lock).
+ */
+
+static int closeCache (void)
+{
+  SOBufferCacheNode *p;                          /* pointer to a node of the storage area */
+  uint32_t i;                                    /* counting variable */
+  int stat;                                      /* status of operation */
+
+  if (bnmax == 0) return -EBADF;                 /* checking for device closed state */
+
+  if (commType == BUF)
+     { /* flush the changed nodes in ascending order of physical block number, in batches of runs of adjacent ones */
+       nBatchReq = nBatchNode = 0;
+       for (p = getFirstNodeOnN (nLHead), i = 0; p != NULL; p = getNextNodeOnN (), i++)
+       { if (i >= nNodes) return -ELIBBAD;       /* the storage area is inconsistent */
+         if ((p->stat == CHANGED) && ((stat = addToBatch (p)) != 0))
+            { nBatchReq = nBatchNode = 0;
+              return stat;
+            }
+       }
+       if ((stat = submitBatch ()) != 0) return stat;
+       freeStorageArea ();
+     }
+  commType = BUF;
+  bnmax = 0;
+  memset (regionStart, 0, sizeof (regionStart));
+
+  return soCloseDevice ();
+}
+
+/*
+ *  Implementation of soReadCacheBlock (the caller holds the access lock).
+ */
+
+static int readBlock (uint32_t n, void *buf)
+{
+  SOBufferCacheNode *p;                          /* pointer to the node where the block is stored */
+  uint32_t off;                                  /* offset of the block in the buffer area of the node */
+  int stat;                                      /* status of operation */
+
+  if (buf == NULL) return -EINVAL;               /* checking for null pointer */
+  if (bnmax == 0) return -EBADF;                 /* checking for device closed state */
+  if (n >= bnmax) return -EINVAL;                /* checking for block number */
+  if (commType == UNBUF) return devRead (n, 1, buf);
+
+  if ((p = searchBlock (n, &off)) != NULL)       /* the block is already stored in the storage area */
+     { countAccess (n, 1);
+       memcpy (buf, p->buffer + off, BLOCK_SIZE);
+       touchNode (p);
+       return 0;
+     }
+
+  countAccess (n, 0);
+  if ((stat = getFreeNode (BLOCK_NODE, &p)) != 0) return stat;
+  p->n = n;
+  if ((stat = devRead (n, 1, p->buffer)) != 0)
+     { putFreeNode (p);
+       return stat;
+     }
+  addNode (p);
+  memcpy (buf, p->buffer, BLOCK_SIZE);
+
+  return 0;
+}
+
+/*
+ *  Implementation of soWriteCacheBlock (the caller holds the access lock).
+ */
+
+static int writeBlock (uint32_t n, void *buf)
+{
+  SOBufferCacheNode *p;                          /* pointer to the node where the block is stored */
+  uint32_t off;                                  /* offset of the block in the buffer area of the node */
+  int stat;                                      /* status of operation */
+
+  if (buf == NULL) return -EINVAL;               /* checking for null pointer */
+  if (bnmax == 0) return -EBADF;                 /* checking for device closed state */
+  if (n >= bnmax) return -EINVAL;                /* checking for block number */
+  if (commType == UNBUF) return devWrite (n, 1, buf);
+
+  if ((p = searchBlock (n, &off)) != NULL)       /* the block is already stored in the storage area */
+     { countAccess (n, 1);
+       memcpy (p->buffer + off, buf, BLOCK_SIZE);
+       markChanged (p);
+       touchNode (p);
+       return 0;
+     }
+
+  countAccess (n, 0);
+  if ((stat = getFreeNode (BLOCK_NODE, &p)) != 0) return stat;
+  p->n = n;
+  markChanged (p);
+  memcpy (p->buffer, buf, BLOCK_SIZE);
+  addNode (p);
+
+  return 0;
+}
+
+/*
+ *  Implementation of soFlushCacheBlock (the caller holds the access lock).
+ */
+
+static int flushBlock (uint32_t n, void *buf)
+{
+  SOBufferCacheNode *p;                          /* pointer to the node where the block is stored */
+  uint32_t off;                                  /* offset of the block in the buffer area of the node */
+  int stat;                                      /* status of operation */
+
+  if (buf == NULL) return -EINVAL;               /* checking for null pointer */
+  if (bnmax == 0) return -EBADF;                 /* checking for device closed state */
+  if (n >= bnmax) return -EINVAL;                /* checking for block number */
+  if (commType == UNBUF) return devFlush (n, 1, buf);
+
+  if ((p = searchIdleBlock (n, &off)) != NULL)       /* the block is already stored in the storage area */
+     { memcpy (p->buffer + off, buf, BLOCK_SIZE);
+       if ((stat = devFlush (n, 1, p->buffer + off)) != 0)
+          { markChanged (p);
+            return stat;
+          }
+       if (p->nblks == 1)                        /* the other blocks of a cluster node may still be changed */
+          markSame (p);
+       touchNode (p);
+       return 0;
+     }
+
+  return devFlush (n, 1, buf);
+}
+
+/*
+ *  Implementation of soSyncCacheBlock (the caller holds the access lock).
+ */
+
+static int syncBlock (uint32_t n)
+{
+  SOBufferCacheNode *p;                          /* pointer to the node where the block is stored */
+  uint32_t off;                                  /* offset of the block in the buffer area of the node */
+  int stat;                                      /* status of operation */
+
+  if (bnmax == 0) return -EBADF;                 /* checking for device closed state */
+  if (n >= bnmax) return -EINVAL;                /* checking for block number */
+  if (commType == UNBUF) return soSyncRawBlocks (n, 1);
+
+  if (((p = searchIdleBlock (n, &off)) != NULL) && (p->stat == CHANGED))
+     { if (((stat = writeNode (p)) != 0) || ((stat = soSyncRawBlocks (p->n, p->nblks)) != 0))
+          return stat;
+       touchNode (p);
+     }
+
+  return 0;
+}
+
+/*
+ *  Implementation of soReadCacheCluster (the caller holds the access lock).
+ */
+
+static int readCluster (uint32_t n, void *buf)
+{
+  SOBufferCacheNode *p;                          /* pointer to the node where the cluster is stored */
+  uint32_t i;                                    /* counting variable */
+  int stat;                                      /* status of operation */
+
+  if (buf == NULL) return -EINVAL;               /* checking for null pointer */
+  if (bnmax == 0) return -EBADF;                 /* checking for device closed state */
+  if ((n + BLOCKS_PER_CLUSTER) > bnmax)          /* checking for cluster number */
+     return -EINVAL;
+  if (commType == UNBUF) return devRead (n, BLOCKS_PER_CLUSTER, buf);
+
+  if ((p = searchCluster (n)) != NULL)           /* the cluster is already stored in the storage area */
+     { countAccess (n, 1);
+       memcpy (buf, p->buffer, CLUSTER_SIZE);
+       touchNode (p);
+       return 0;
+     }
+  if (clusterOverlaps (n))                       /* some of its blocks are stored in block nodes */
+     { for (i = 0; i < BLOCKS_PER_CLUSTER; i++)
+         if ((stat = readBlock (n + i, (unsigned char *) buf + i * BLOCK_SIZE)) != 0)
+            return stat;
+       return 0;
+     }
+
+  countAccess (n, 0);
+  if ((stat = getFreeNode (CLUSTER_NODE, &p)) != 0) return stat;
+  p->n = n;
+  if ((stat = devRead (n, BLOCKS_PER_CLUSTER, p->buffer)) != 0)
+     { putFreeNode (p);
+       return stat;
+     }
+  addNode (p);
+  memcpy (buf, p->buffer, CLUSTER_SIZE);
+
+  return 0;
+}
+
+/*
+ *  Implementation of soWriteCacheCluster (the caller holds the access lock).
+ */
+
+static int writeCluster (uint32_t n, void *buf)
+{
+  SOBufferCacheNode *p;                          /* pointer to the node where the cluster is stored */
+  uint32_t i;                                    /* counting variable */
+  int stat;                                      /* status of operation */
+
+  if (buf == NULL) return -EINVAL;               /* checking for null pointer */
+  if (bnmax == 0) return -EBADF;                 /* checking for device closed state */
+  if ((n + BLOCKS_PER_CLUSTER) > bnmax)          /* checking for cluster number */
+     return -EINVAL;
+  if (commType == UNBUF) return devWrite (n, BLOCKS_PER_CLUSTER, buf);
+
+  if ((p = searchCluster (n)) != NULL)           /* the cluster is already stored in the storage area */
+     { countAccess (n, 1);
+       memcpy (p->buffer, buf, CLUSTER_SIZE);
+       markChanged (p);
+       touchNode (p);
+       return 0;
+     }
+  if (clusterOverlaps (n))                       /* some of its blocks are stored in block nodes */
+     { for (i = 0; i < BLOCKS_PER_CLUSTER; i++)
+         if ((stat = writeBlock (n + i, (unsigned char *) buf + i * BLOCK_SIZE)) != 0)
+            return stat;
+       return 0;
+     }
+
+  countAccess (n, 0);
+  if ((stat = getFreeNode (CLUSTER_NODE, &p)) != 0) return stat;
+  p->n = n;
+  markChanged (p);
+  memcpy (p->buffer, buf, CLUSTER_SIZE);
+  addNode (p);
+
+  return 0;
+}
+
+/*
+ *  Implementation of soFlushCacheCluster (the caller holds the access lock).
+ */
+
+static int flushCluster (uint32_t n, void *buf)
+{
+  SOBufferCacheNode *p;                          /* pointer to the node where the cluster is stored */
+  uint32_t i;                                    /* counting variable */
+  int stat;                                      /* status of operation */
+
+  if (buf == NULL) return -EINVAL;               /* checking for null pointer */
+  if (bnmax == 0) return -EBADF;                 /* checking for device closed state */
+  if ((n + BLOCKS_PER_CLUSTER) > bnmax)          /* checking for cluster number */
+     return -EINVAL;
+  if (commType == UNBUF) return devFlush (n, BLOCKS_PER_CLUSTER, buf);
+
+  if ((p = searchIdleCluster (n)) != NULL)           /* the cluster is already stored in the storage area */
+     { memcpy (p->buffer, buf, CLUSTER_SIZE);
+       markChanged (p);
+       if (((stat = writeNode (p)) != 0) || ((stat = soSyncRawBlocks (n, BLOCKS_PER_CLUSTER)) != 0))
+          return stat;
+       touchNode (p);
+       return 0;
+     }
+  if (clusterOverlaps (n))                       /* some of its blocks are stored in block nodes */
+     { for (i = 0; i < BLOCKS_PER_CLUSTER; i++)
+         if ((stat = flushBlock (n + i, (unsigned char *) buf + i * BLOCK_SIZE)) != 0)
+            return stat;
+       return 0;
+     }
+
+  return devFlush (n, BLOCKS_PER_CLUSTER, buf);
+}
+
+/*
+ *  Implementation of soSyncCacheCluster (the caller holds the access lock).
+ */
+
+static int syncCluster (uint32_t n)
+{
+  SOBufferCacheNode *p;                          /* pointer to the node where the cluster is stored */
+  uint32_t i;                                    /* counting variable */
+  int stat;                                      /* status of operation */
+
+  if (bnmax == 0) return -EBADF;                 /* checking for device closed state */
+  if ((n + BLOCKS_PER_CLUSTER) > bnmax)          /* checking for cluster number */
+     return -EINVAL;
+  if (commType == UNBUF) return soSyncRawBlocks (n, BLOCKS_PER_CLUSTER);
+
+  if ((p = searchIdleCluster (n)) != NULL)           /* the cluster is already stored in the storage area */
+     { if (p->stat == CHANGED)
+          { if (((stat = writeNode (p)) != 0) || ((stat = soSyncRawBlocks (n, BLOCKS_PER_CLUSTER)) != 0))
+               return stat;
+            touchNode (p);
+          }
+       return 0;
+     }
+
+  for (i = 0; i < BLOCKS_PER_CLUSTER; i++)
+    if ((stat = syncBlock (n + i)) != 0)
+       return stat;
+
+  return 0;
+}
+
+/*
+ *  Implementation of soReadCacheClusters (the caller holds the access lock): the clusters already stored in the storage
+ *  area, or some of whose blocks are stored in block nodes, are read as soReadCacheCluster does; each run of the other
+ *  ones, of up to READ_RUN clusters, is assigned free nodes and read into them by a single vectored transfer; a long run
+ *  is read directly into the caller's buffer, instead.
+ */
+
+static int readClusters (uint32_t n, uint32_t count, void *buf)
+{
+  SOBufferCacheNode *run[READ_RUN];              /* nodes where a run of clusters is read into */
+  struct iovec iov[READ_RUN];                    /* buffer descriptors of the run */
+  uint32_t m;                                    /* physical number of the first block of a cluster */
+  uint32_t i, k, j;                              /* counting variables */
+  int stat;                                      /* status of operation */
+
+  if (buf == NULL) return -EINVAL;               /* checking for null pointer */
+  if (bnmax == 0) return -EBADF;                 /* checking for device closed state */
+  if ((count == 0) || (count > bnmax / BLOCKS_PER_CLUSTER) ||    /* checking for run */
+      ((n + (uint64_t) count * BLOCKS_PER_CLUSTER) > bnmax))
+     return -EINVAL;
+  if (commType == UNBUF) return devRead (n, count * BLOCKS_PER_CLUSTER, buf);
+  if (count >= DIRECT_RUN) return readDirect (n, count, buf);
+
+  i = 0;
+  while (i < count)
+  { for (k = 0; (k < READ_RUN) && (i + k < count); k++)
+    { m = n + (i + k) * BLOCKS_PER_CLUSTER;
+      if ((searchCluster (m) != NULL) || clusterOverlaps (m) || (getFreeNode (CLUSTER_NODE, &run[k]) != 0))
+         break;
+      run[k]->n = m;
+      iov[k].iov_base = run[k]->buffer;
+      iov[k].iov_len = CLUSTER_SIZE;
+    }
+    if (k == 0)                                  /* the cluster is read on its own */
+       { if ((stat = readCluster (n + i * BLOCKS_PER_CLUSTER, (unsigned char *) buf + (size_t) i * CLUSTER_SIZE)) != 0)
+            return stat;
+         i += 1;
+         continue;
+       }
+    if ((stat = soReadRawBlocks (run[0]->n, k, iov)) != 0)
+       { for (j = 0; j < k; j++)
+           putFreeNode (run[j]);
+         return stat;
+       }
+    for (j = 0; j < k; j++)
+    { countAccess (run[j]->n, 0);
+      addNode (run[j]);
+      memcpy ((unsigned char *) buf + (size_t) (i + j) * CLUSTER_SIZE, run[j]->buffer, CLUSTER_SIZE);
+    }
+    i += k;
+  }
+
+  return 0;
+}
+
+/*
+ *  Implementation of soWriteCacheClusters (the caller holds the access lock): a long run is written directly from the
+ *  caller's buffer, unless some of its clusters are pinned.
+ */
+
+static int writeClusters (uint32_t n, uint32_t count, void *buf)
+{
+  uint32_t i;                                    /* counting variable */
+  int stat;                                      /* status of operation */
+
+  if (buf == NULL) return -EINVAL;               /* checking for null pointer */
+  if (bnmax == 0) return -EBADF;                 /* checking for device closed state */
+  if ((count == 0) || (count > bnmax / BLOCKS_PER_CLUSTER) ||    /* checking for run */
+      ((n + (uint64_t) count * BLOCKS_PER_CLUSTER) > bnmax))
+     return -EINVAL;
+  if (commType == UNBUF) return devWrite (n, count * BLOCKS_PER_CLUSTER, buf);
+  if ((count >= DIRECT_RUN) && ((stat = writeDirect (n, count, buf)) != -EBUSY))
+     return stat;
+
+  for (i = 0; i < count; i++)
+    if ((stat = writeCluster (n + i * BLOCKS_PER_CLUSTER, (unsigned char *) buf + (size_t) i * CLUSTER_SIZE)) != 0)
+       return stat;
+
+  return 0;
+}
+
+/*
+ *  Read a long run of clusters directly into the caller's buffer (the caller holds the access lock): the clusters
+ *  already stored in the storage area, or some of whose blocks are stored in block nodes, are read as soReadCacheCluster
+ *  does; each run of the other ones is read by a single transfer and is not stored in the storage area.
+ */
+
+static int readDirect (uint32_t n, uint32_t count, void *buf)
+{
+  uint32_t m;                                    /* physical number of the first block of a cluster */
+  uint32_t i, k;                                 /* counting variables */
+  int stat;                                      /* status of operation */
+
+  i = 0;
+  while (i < count)
+  { for (k = 0; i + k < count; k++)
+    { m = n + (i + k) * BLOCKS_PER_CLUSTER;
+      if ((searchCluster (m) != NULL) || clusterOverlaps (m)) break;
+      countAccess (m, 0);
+    }
+    if (k == 0)                                  /* the cluster is read from the storage area */
+       { if ((stat = readCluster (n + i * BLOCKS_PER_CLUSTER, (unsigned char *) buf + (size_t) i * CLUSTER_SIZE)) != 0)
+            return stat;
+         i += 1;
+         continue;
+       }
+    if ((stat = devRead (n + i * BLOCKS_PER_CLUSTER, k * BLOCKS_PER_CLUSTER,
+                         (unsigned char *) buf + (size_t) i * CLUSTER_SIZE)) != 0)
+       return stat;
+    directBytes += (uint64_t) k * CLUSTER_SIZE;
+    i += k;
+  }
+
+  return 0;
+}
+
+/*
+ *  Write a long run of clusters directly from the caller's buffer (the caller holds the access lock): the copies of the
+ *  clusters in the storage area are discarded, once they are not being written back, and the run is written by a
+ *  single transfer. The clusters prefetched meanwhile are discarded afterwards. -EBUSY is returned, and nothing is
+ *  written, if some of the clusters are pinned.
+ */
+
+static int writeDirect (uint32_t n, uint32_t count, void *buf)
+{
+  SOBufferCacheNode *p;                          /* pointer to the node where a cluster is stored */
+  uint32_t m;                                    /* physical number of the first block of a cluster */
+  uint32_t i;                                    /* counting variable */
+  int stat;                                      /* status of operation */
+
+  for (i = 0; i < count; i++)                    /* the copies in the storage area are superseded */
+  { m = n + i * BLOCKS_PER_CLUSTER;
+    if ((p = searchIdleCluster (m)) != NULL)
+       { if (p->pin != 0) return -EBUSY;
+         countAccess (m, 1);
+         markSame (p);
+         dropNode (p);
+         putFreeNode (p);
+       }
+       else { countAccess (m, 0);
+              if ((stat = absorbOverlaps (m)) != 0) return stat;
+            }
+  }
+  if ((stat = devWrite (n, count * BLOCKS_PER_CLUSTER, buf)) != 0) return stat;
+  directBytes += (uint64_t) count * CLUSTER_SIZE;
+
+  for (i = 0; i < count; i++)                    /* while waiting for a write-back, some may have been prefetched */
+    if (((p = searchCluster (n + i * BLOCKS_PER_CLUSTER)) != NULL) && (p->pin == 0) && !p->wback &&
+        (p->stat != CHANGED))
+       { dropNode (p);
+         putFreeNode (p);
+       }
+
+  return 0;
+}
+
+/*
+ *  Implementation of soDiscardCacheClusters (the caller holds the access lock): the copies are dropped as writeDirect
+ *  does, but they are not superseded by new contents, and the storage device is not accessed if any is pinned.
+ */
+
+static int discardClusters (uint32_t n, uint32_t count)
+{
+  SOBufferCacheNode *p;                          /* pointer to the node where a cluster is stored */
+  uint32_t m;                                    /* physical number of the first block of a cluster */
+  uint32_t i;                                    /* counting variable */
+  int stat;                                      /* status of operation */
+
+  if (bnmax == 0) return -EBADF;                 /* checking for device closed state */
+  if ((count == 0) || (count > bnmax / BLOCKS_PER_CLUSTER) ||    /* checking for run */
+      ((n + (uint64_t) count * BLOCKS_PER_CLUSTER) > bnmax))
+     return -EINVAL;
+
+  if (commType == BUF)
+     for (i = 0; i < count; i++)
+     { m = n + i * BLOCKS_PER_CLUSTER;
+       if ((p = searchIdleCluster (m)) != NULL)
+          { if (p->pin != 0) return -EBUSY;
+            markSame (p);
+            dropNode (p);
+            putFreeNode (p);
+          }
+          else if ((stat = absorbOverlaps (m)) != 0) return stat;
+     }
+
+  return soDiscardRawBlocks (n, count * BLOCKS_PER_CLUSTER);
+}
+
+/*
+ *  Implementation of soPinCacheBlock (the caller holds the access lock).
+ */
+
+static int pinBlock (uint32_t n, void **p_buf)
+{
+  SOBufferCacheNode *p;                          /* pointer to the node where the block is stored */
+  uint32_t off;                                  /* offset of the block in the buffer area of the node */
+  int stat;                                      /* status of operation */
+
+  if (p_buf == NULL) return -EINVAL;             /* checking for null pointer */
+  if (bnmax == 0) return -EBADF;                 /* checking for device closed state */
+  if (n >= bnmax) return -EINVAL;                /* checking for block number */
+  if (commType == UNBUF) return soMapRawBlocks (n, 1, p_buf);   /* only if the device is memory-mapped */
+
+  if ((p = searchBlock (n, &off)) == NULL)       /* the block is not stored in the storage area yet */
+     { countAccess (n, 0);
+       if ((stat = getFreeNode (BLOCK_NODE, &p)) != 0) return stat;
+       p->n = n;
+       if ((stat = devRead (n, 1, p->buffer)) != 0)
+          { putFreeNode (p);
+            return stat;
+          }
+       addNode (p);
+       off = 0;
+     }
+     else { countAccess (n, 1);
+            touchNode (p);
+          }
+  p->pin += 1;
+  *p_buf = p->buffer + off;
+
+  return 0;
+}
+
+/*
+ *  Implementation of soUnpinCacheBlock (the caller holds the access lock).
+ */
+
+static int unpinBlock (uint32_t n)
+{
+  SOBufferCacheNode *p;                          /* pointer to the node where the block is stored */
+  uint32_t off;                                  /* offset of the block in the buffer area of the node */
+
+  if (bnmax == 0) return -EBADF;                 /* checking for device closed state */
+  if (n >= bnmax) return -EINVAL;                /* checking for block number */
+  if (commType == UNBUF) return (soGetDeviceBackend () == RAW_MMAP) ? 0 : -ENOTSUP;
+
+  if (((p = searchBlock (n, &off)) == NULL) || (p->pin == 0))
+     return -EINVAL;                             /* the block is not pinned */
+  p->pin -= 1;
+
+  return 0;
+}
+
+/*
+ *  Implementation of soMarkCacheBlockDirty (the caller holds the access lock).
+ */
+
+static int markBlockDirty (uint32_t n)
+{
+  SOBufferCacheNode *p;                          /* pointer to the node where the block is stored */
+  uint32_t off;                                  /* offset of the block in the buffer area of the node */
+
+  if (bnmax == 0) return -EBADF;                 /* checking for device closed state */
+  if (n >= bnmax) return -EINVAL;                /* checking for block number */
+  if (commType == UNBUF) return (soGetDeviceBackend () == RAW_MMAP) ? 0 : -ENOTSUP;
+
+  if ((p = searchBlock (n, &off)) == NULL)
+     return -EINVAL;                             /* the block is not stored in the storage area */
+  markChanged (p);
+
+  return 0;
+}
+
+/*
+ *  Implementation of soPinCacheCluster (the caller holds the access lock).
+ */
+
+static int pinCluster (uint32_t n, void **p_buf)
+{
+  SOBufferCacheNode *p;                          /* pointer to the node where the cluster is stored */
+  uint32_t reserve;                              /* number of nodes to be kept for replacement */
+  int stat;                                      /* status of operation */
+
+  if (p_buf == NULL) return -EINVAL;             /* checking for null pointer */
+  if (bnmax == 0) return -EBADF;                 /* checking for device closed state */
+  if ((n + BLOCKS_PER_CLUSTER) > bnmax)          /* checking for cluster number */
+     return -EINVAL;
+  if (commType == UNBUF) return soMapRawBlocks (n, BLOCKS_PER_CLUSTER, p_buf);
+
+  /* a new pin must leave enough nodes to be replaced by the accesses, the prefetcher and the write-back included */
+
+  reserve = nActive[CLUSTER_NODE] / 4;
+  if (reserve > PIN_RESERVE) reserve = PIN_RESERVE;
+  p = searchCluster (n);
+  if (((p == NULL) || (p->pin == 0)) && !spareNodes (CLUSTER_NODE, reserve + 1))
+     return -ENOBUFS;
+
+  if (p == NULL)                                 /* the cluster is not stored in the storage area yet */
+     { countAccess (n, 0);
+       if ((stat = absorbOverlaps (n)) != 0) return stat;
+       if ((stat = getFreeNode (CLUSTER_NODE, &p)) != 0) return stat;
+       p->n = n;
+       if ((stat = devRead (n, BLOCKS_PER_CLUSTER, p->buffer)) != 0)
+          { putFreeNode (p);
+            return stat;
+          }
+       addNode (p);
+     }
+     else { countAccess (n, 1);
+            touchNode (p);
+          }
+  p->pin += 1;
+  *p_buf = p->buffer;
+
+  return 0;
+}
+
+/*
+ *  Implementation of soUnpinCacheCluster (the caller holds the access lock).
+ */
+
+static int unpinCluster (uint32_t n)
+{
+  SOBufferCacheNode *p;                          /* pointer to the node where the cluster is stored */
+
+  if (bnmax == 0) return -EBADF;                 /* checking for device closed state */
+  if ((n + BLOCKS_PER_CLUSTER) > bnmax)          /* checking for cluster number */
+     return -EINVAL;
+  if (commType == UNBUF) return (soGetDeviceBackend () == RAW_MMAP) ? 0 : -ENOTSUP;
+
+  if (((p = searchCluster (n)) == NULL) || (p->pin == 0))
+     return -EINVAL;                             /* the cluster is not pinned */
+  p->pin -= 1;
+
+  return 0;
+}
+
+/*
+ *  Implementation of soMarkCacheClusterDirty (the caller holds the access lock).
+ */
+
+static int markClusterDirty (uint32_t n)
+{
+  SOBufferCacheNode *p;                          /* pointer to the node where the cluster is stored */
+
+  if (bnmax == 0) return -EBADF;                 /* checking for device closed state */
+  if ((n + BLOCKS_PER_CLUSTER) > bnmax)          /* checking for cluster number */
+     return -EINVAL;
+  if (commType == UNBUF) return (soGetDeviceBackend () == RAW_MMAP) ? 0 : -ENOTSUP;
+
+  if ((p = searchCluster (n)) == NULL)
+     return -EINVAL;                             /* the cluster is not stored in the storage area */
+  markChanged (p);
+
+  return 0;
+}
+
+/*
+ *  Implementation of soPrefetchCacheCluster (the caller holds the access lock).
+ */
+
+static int prefetchCluster (uint32_t n)
+{
+  uint32_t i;                                    /* counting variable */
+
+  if (bnmax == 0) return -EBADF;                 /* checking for device closed state */
+  if ((n + BLOCKS_PER_CLUSTER) > bnmax)          /* checking for cluster number */
+     return -EINVAL;
+  if ((commType == UNBUF) || !prefetcherRunning) return 0;
+
+  if ((searchCluster (n) != NULL) || clusterOverlaps (n) || (pfCount == PREFETCH_QUEUE))
+     return 0;
+  for (i = 0; i < pfCount; i++)                  /* it is already queued */
+    if (pfQueue[(pfHead + i) % PREFETCH_QUEUE] == n) return 0;
+  pfQueue[(pfHead + pfCount) % PREFETCH_QUEUE] = n;
+  pfCount += 1;
+  pthread_cond_signal (&prefetcherWakeUp);
+
+  return 0;
+}
+
+/*
+ *  Allocate the storage area as a single page-aligned slab: the array of nodes comes first, padded to a page
+ *  boundary, and is followed by the buffer areas of the nodes. A share of the data blocks is assigned to cluster
+ *  nodes, the remaining ones to block nodes.
+ */
+
+static int allocStorageArea (uint32_t nBlocks)
+{
+  uint32_t nKind[2];                             /* number of nodes of each kind */
+  size_t pageSize;                               /* size of a memory page */
+  int stat;                                      /* status of operation */
+
+  splitCapacity (nBlocks, nKind);
+  if ((slab = allocSlab (nKind[BLOCK_NODE], nKind[CLUSTER_NODE], &node)) == NULL)
+     return -ENOMEM;
+  if ((pageSize = (size_t) sysconf (_SC_PAGESIZE)) < BLOCK_SIZE)
+     pageSize = BLOCK_SIZE;
+  if (posix_memalign ((void **) &staging, pageSize, MAX_WBACK * BLOCK_SIZE) != 0)
+     { free (slab);
+       slab = NULL;
+       node = NULL;
+       staging = NULL;
+       return -ENOMEM;
+     }
+  if ((stat = initNodeIndex (nKind[BLOCK_NODE] + nKind[CLUSTER_NODE])) != 0)
+     { free (slab);
+       free (staging);
+       slab = NULL;
+       node = NULL;
+       staging = NULL;
+       return stat;
+     }
+
+  nDirty = 0;
+  freeList[BLOCK_NODE] = freeList[CLUSTER_NODE] = NULL;
+  spareList[BLOCK_NODE] = spareList[CLUSTER_NODE] = NULL;
+  initNodes (node, nKind[BLOCK_NODE], nKind[CLUSTER_NODE]);
+  nActive[BLOCK_NODE] = nKind[BLOCK_NODE];
+  nActive[CLUSTER_NODE] = nKind[CLUSTER_NODE];
+  nNodes = nAllocated = nKind[BLOCK_NODE] + nKind[CLUSTER_NODE];
+  nLHead = NULL;
+  lATLHead[BLOCK_NODE] = lATLHead[CLUSTER_NODE] = NULL;
+  lATLTail[BLOCK_NODE] = lATLTail[CLUSTER_NODE] = NULL;
+  fQHead[BLOCK_NODE] = fQHead[CLUSTER_NODE] = NULL;
+  fQTail[BLOCK_NODE] = fQTail[CLUSTER_NODE] = NULL;
+  nFirst[BLOCK_NODE] = nFirst[CLUSTER_NODE] = 0;
+  nPrio[BLOCK_NODE] = nPrio[CLUSTER_NODE] = 0;
+  if ((replPolicy == BC_2Q) && ((stat = initGhosts ()) != 0))
+     { freeStorageArea ();
+       return stat;
+     }
+
+  return 0;
+}
+
+/*
+ *  Release the storage area.
+ */
+
+static void freeStorageArea (void)
+{
+  uint32_t i;                                    /* counting variable */
+
+  if (slab == NULL) return;
+  freeNodeIndex ();
+  freeGhostIndex ();
+  for (i = 0; i < nExtSlabs; i++)
+    free (extSlab[i]);
+  free (extSlab);
+  free (slab);
+  free (staging);
+  extSlab = NULL;
+  nExtSlabs = 0;
+  slab = NULL;
+  staging = NULL;
+  nDirty = 0;
+  node = NULL;
+  nNodes = nAllocated = 0;
+  nActive[BLOCK_NODE] = nActive[CLUSTER_NODE] = 0;
+  freeList[BLOCK_NODE] = freeList[CLUSTER_NODE] = NULL;
+  spareList[BLOCK_NODE] = spareList[CLUSTER_NODE] = NULL;
+  nLHead = NULL;
+  lATLHead[BLOCK_NODE] = lATLHead[CLUSTER_NODE] = NULL;
+  lATLTail[BLOCK_NODE] = lATLTail[CLUSTER_NODE] = NULL;
+  fQHead[BLOCK_NODE] = fQHead[CLUSTER_NODE] = NULL;
+  fQTail[BLOCK_NODE] = fQTail[CLUSTER_NODE] = NULL;
+  nFirst[BLOCK_NODE] = nFirst[CLUSTER_NODE] = 0;
+  nPrio[BLOCK_NODE] = nPrio[CLUSTER_NODE] = 0;
+}
+
+/*
+ *  Split a number of data blocks between block and cluster nodes.
+ */
+
+static void splitCapacity (uint32_t nBlocks, uint32_t *nKind)
+{
+  nKind[CLUSTER_NODE] = nBlocks / 4 * CLUSTER_SHARE / BLOCKS_PER_CLUSTER;
+  if (nKind[CLUSTER_NODE] == 0) nKind[CLUSTER_NODE] = 1;
+  if (nBlocks <= nKind[CLUSTER_NODE] * BLOCKS_PER_CLUSTER)
+     nKind[BLOCK_NODE] = 1;
+     else nKind[BLOCK_NODE] = nBlocks - nKind[CLUSTER_NODE] * BLOCKS_PER_CLUSTER;
+}
+
+/*
+ *  Allocate a page-aligned slab for a number of block and cluster nodes: the array of nodes comes first, padded to a
+ *  page boundary, and is followed by their buffer areas. It returns the pointer to the slab, or NULL if there is no
+ *  memory; the buffer area of the first node is set to the beginning of the buffer areas.
+ */
+
+static void *allocSlab (uint32_t nBlk, uint32_t nClust, SOBufferCacheNode **p_nodes)
+{
+  size_t pageSize;                               /* size of a memory page */
+  size_t metaSize;                               /* size of the array of nodes, rounded up to a page boundary */
+  void *p;                                       /* pointer to the slab */
+
+  if ((pageSize = (size_t) sysconf (_SC_PAGESIZE)) < BLOCK_SIZE)
+     pageSize = BLOCK_SIZE;
+  metaSize = ((nBlk + nClust) * sizeof (SOBufferCacheNode) + pageSize - 1) / pageSize * pageSize;
+  if (posix_memalign (&p, pageSize, metaSize + ((size_t) nBlk + (size_t) nClust * BLOCKS_PER_CLUSTER) * BLOCK_SIZE)
+      != 0)
+     return NULL;
+  *p_nodes = (SOBufferCacheNode *) p;
+  ((SOBufferCacheNode *) p)->buffer = (unsigned char *) p + metaSize;  /* the location of the buffer areas */
+
+  return p;
+}
+
+/*
+ *  Initialize the nodes of a slab allocated by allocSlab and put them in the lists of free nodes. The cluster buffer
+ *  areas come first, so that they are aligned to a page boundary as well.
+ */
+
+static void initNodes (SOBufferCacheNode *nodes, uint32_t nBlk, uint32_t nClust)
+{
+  unsigned char *data;                           /* pointer to the next buffer area to be assigned */
+  uint32_t i;                                    /* counting variable */
+
+  data = nodes[0].buffer;
+  for (i = 0; i < nBlk + nClust; i++)
+  { nodes[i].nblks = (i < nClust) ? BLOCKS_PER_CLUSTER : 1;
+    nodes[i].buffer = data;
+    nodes[i].n = 0;
+    data += nodes[i].nblks * BLOCK_SIZE;
+  }
+  for (i = nBlk + nClust; i > 0; i--)
+    putFreeNode (&nodes[i-1]);
+}
+
+/*
+ *  Resize the storage area while it is in use. Nodes withdrawn before are reused first, when it grows, and a new
+ *  slab is only allocated for the remaining ones. When it shrinks, the free nodes are withdrawn first and then the
+ *  nodes not accessed for the longest time which are neither pinned nor being written back. The withdrawn nodes are
+ *  kept until the storage area is released, but the memory pages of their buffer areas are returned to the system.
+ */
+
+static int resizeStorageArea (uint32_t nBlocks)
+{
+  uint32_t nKind[2];                             /* number of nodes of each kind aimed at */
+  uint32_t nMore[2];                             /* number of nodes of each kind to be allocated */
+  SOBufferCacheNode *p;                          /* pointer to a node */
+  uint32_t kind;                                 /* kind of node */
+  int stat, err;                                 /* status of operation */
+
+  splitCapacity (nBlocks, nKind);
+  stat = 0;
+  for (kind = BLOCK_NODE; kind <= CLUSTER_NODE; kind++)
+  { err = 0;
+    while ((nActive[kind] > nKind[kind]) && (err == 0))
+      err = withdrawNode (kind);
+    if ((err != 0) && (stat == 0)) stat = err;
+    while ((nActive[kind] < nKind[kind]) && (spareList[kind] != NULL))
+    { p = spareList[kind];
+      spareList[kind] = p->n_next;
+      putFreeNode (p);
+      nActive[kind] += 1;
+    }
+    nMore[kind] = nKind[kind] - nActive[kind];
+    if (nActive[kind] > nKind[kind]) nMore[kind] = 0;
+  }
+  if (((nMore[BLOCK_NODE] != 0) || (nMore[CLUSTER_NODE] != 0)) &&
+      ((err = enlargeStorageArea (nMore[BLOCK_NODE], nMore[CLUSTER_NODE])) != 0) && (stat == 0))
+     stat = err;
+  nNodes = nActive[BLOCK_NODE] + nActive[CLUSTER_NODE];
+  if ((replPolicy == BC_2Q) && ((err = initGhosts ()) != 0) && (stat == 0))
+     stat = err;
+  if (nAllocated > nNodes)
+     releaseSpareMemory ();
+
+  return stat;
+}
+
+/*
+ *  Withdraw a node of a given kind from the storage area: a free node, if there is one, or else the node not accessed
+ *  for the longest time which is neither pinned nor being written back, after writing it back if it was changed.
+ */
+
+static int withdrawNode (uint32_t kind)
+{
+  SOBufferCacheNode *p;                          /* pointer to the node */
+  int stat;                                      /* status of operation */
+
+  if ((p = freeList[kind]) != NULL)
+     freeList[kind] = p->n_next;
+     else { if ((p = selectVictim (kind)) == NULL)
+               return -EBUSY;                    /* all nodes are pinned or being written back */
+            if ((p->stat == CHANGED) && ((stat = writeNode (p)) != 0))
+               return stat;
+            evictNode (p);
+          }
+  p->n_next = spareList[kind];
+  spareList[kind] = p;
+  nActive[kind] -= 1;
+
+  return 0;
+}
+
+/*
+ *  Enlarge the storage area with a new slab of block and cluster nodes.
+ */
+
+static int enlargeStorageArea (uint32_t nBlk, uint32_t nClust)
+{
+  void **ext;                                    /* pointer to the enlarged array of slabs */
+  SOBufferCacheNode *nodes;                      /* array of nodes of the new slab */
+  void *p;                                       /* pointer to the new slab */
+  int stat;                                      /* status of operation */
+
+  if ((ext = realloc (extSlab, (nExtSlabs + 1) * sizeof (void *))) == NULL)
+     return -ENOMEM;
+  extSlab = ext;
+  if ((p = allocSlab (nBlk, nClust, &nodes)) == NULL)
+     return -ENOMEM;
+  if ((stat = growNodeIndex (nAllocated + nBlk + nClust)) != 0)
+     { free (p);
+       return stat;
+     }
+  extSlab[nExtSlabs] = p;
+  nExtSlabs += 1;
+  initNodes (nodes, nBlk, nClust);
+  nActive[BLOCK_NODE] += nBlk;
+  nActive[CLUSTER_NODE] += nClust;
+  nAllocated += nBlk + nClust;
+
+  return 0;
+}
+
+/*
+ *  Return to the system the memory pages which only hold buffer areas of nodes withdrawn from the storage area. Their
+ *  contents is of no use, since a node is assigned to a block before its buffer area is accessed, and the pages are
+ *  mapped again, zeroed, when it is. The buffer areas are sorted by address, so that the runs of adjacent ones are
+ *  released together. Nothing is done if there is no memory to sort them.
+ */
+
+static void releaseSpareMemory (void)
+{
+  SOBufferCacheNode **spare;                     /* withdrawn nodes, sorted by the address of their buffer areas */
+  SOBufferCacheNode *p;                          /* pointer to a node */
+  uintptr_t start, end, lo, hi;                  /* limits of a run of buffer areas and of the pages it covers */
+  size_t pageSize;                               /* size of a memory page */
+  uint32_t nSpare, kind, i, j;                   /* number of withdrawn nodes, kind of node and counting variables */
+
+  if ((spare = malloc ((size_t) (nAllocated - nNodes) * sizeof (SOBufferCacheNode *))) == NULL)
+     return;
+  nSpare = 0;
+  for (kind = BLOCK_NODE; kind <= CLUSTER_NODE; kind++)
+    for (p = spareList[kind]; p != NULL; p = p->n_next)
+      spare[nSpare++] = p;
+  qsort (spare, nSpare, sizeof (SOBufferCacheNode *), cmpBuffer);
+
+  if ((pageSize = (size_t) sysconf (_SC_PAGESIZE)) < BLOCK_SIZE)
+     pageSize = BLOCK_SIZE;
+  for (i = 0; i < nSpare; i = j)
+  { start = (uintptr_t) spare[i]->buffer;
+    end = start + spare[i]->nblks * BLOCK_SIZE;
+    for (j = i + 1; (j < nSpare) && ((uintptr_t) spare[j]->buffer == end); j++)
+      end += spare[j]->nblks * BLOCK_SIZE;
+    lo = (start + pageSize - 1) / pageSize * pageSize;
+    hi = end / pageSize * pageSize;
+    if (hi > lo)
+       madvise ((void *) lo, hi - lo, MADV_DONTNEED);
+  }
+  free (spare);
+}
+
+/*
+ *  Order of two nodes by the address of their buffer areas.
+ */
+
+static int cmpBuffer (const void *a, const void *b)
+{
+  uintptr_t x = (uintptr_t) (*(SOBufferCacheNode * const *) a)->buffer;
+  uintptr_t y = (uintptr_t) (*(SOBufferCacheNode * const *) b)->buffer;
+
+  return (x > y) - (x < y);
+}
+
+/*
+ *  Region of the storage device a block belongs to.
+ */
+
+static uint32_t regionOf (uint32_t n)
+{
+  uint32_t r;                                    /* region */
+
+  if (regionStart[BC_DZONE] == 0)                /* the layout is not set */
+     return (n == 0) ? BC_SUPERBLOCK : BC_DZONE;
+  for (r = BC_DZONE; r > BC_SUPERBLOCK; r--)
+    if (n >= regionStart[r]) break;
+
+  return r;
+}
+
+/*
+ *  Account for an access to a block or a cluster.
+ */
+
+static void countAccess (uint32_t n, int hit)
+{
+  if (hit)
+     { hitCount[regionOf (n)] += 1;
+       soStatAdd (STAT_BC_HIT, 1);
+     }
+     else { missCount[regionOf (n)] += 1;
+            soStatAdd (STAT_BC_MISS, 1);
+          }
+}
+
+/*
+ *  Account for a node written back to the storage device.
+ */
+
+static void countWriteBack (uint32_t nblks)
+{
+  wbackBytes += (uint64_t) nblks * BLOCK_SIZE;
+  soStatAdd (STAT_BC_WBACK, 1);
+}
+
+/*
+ *  Create the index of ghost entries of the first-access queues anew, sized after the number of nodes.
+ */
+
+static int initGhosts (void)
+{
+  uint32_t nGhosts;                              /* number of ghost entries */
+
+  if ((nGhosts = (uint32_t) ((uint64_t) nNodes * GHOST_SHARE / 4)) == 0)
+     nGhosts = 1;
+
+  return initGhostIndex (nGhosts);
+}
+
+/*
+ *  Look up the node where a block is stored: it is either a block node, or a cluster node which starts at most
+ *  BLOCKS_PER_CLUSTER - 1 blocks before. The offset of the block in the buffer area of the node is also returned.
+ */
+
+static SOBufferCacheNode *searchBlock (uint32_t n, uint32_t *p_off)
+{
+  SOBufferCacheNode *p;                          /* pointer to the node */
+  uint32_t k;                                    /* counting variable */
+
+  for (k = 0; (k < BLOCKS_PER_CLUSTER) && (k <= n); k++)
+    if (((p = searchNodeOnN (n - k, nLHead)) != NULL) && (k < p->nblks))
+       { *p_off = k * BLOCK_SIZE;
+         return p;
+       }
+
+  return NULL;
+}
+
+/*
+ *  Look up the cluster node which starts at a given block.
+ */
+
+static SOBufferCacheNode *searchCluster (uint32_t n)
+{
+  SOBufferCacheNode *p;                          /* pointer to the node */
+
+  if (((p = searchNodeOnN (n, nLHead)) != NULL) && (p->nblks == BLOCKS_PER_CLUSTER))
+     return p;
+
+  return NULL;
+}
+
+/*
+ *  Search a block as searchBlock does, but wait for the flusher to complete the write-back of the node where it is
+ *  stored, so that the contents of the node may be written to the storage device without being overwritten later on by
+ *  an older copy (the caller holds the access lock).
+ */
+
+static SOBufferCacheNode *searchIdleBlock (uint32_t n, uint32_t *p_off)
+{
+  SOBufferCacheNode *p;                          /* pointer to the node where the block is stored */
+
+  while (((p = searchBlock (n, p_off)) != NULL) && p->wback)
+    pthread_cond_wait (&wbackDone, &accessCR);
+
+  return p;
+}
+
+/*
+ *  Search a cluster as searchCluster does, but wait for the flusher to complete the write-back of the node where it is
+ *  stored (the caller holds the access lock).
+ */
+
+static SOBufferCacheNode *searchIdleCluster (uint32_t n)
+{
+  SOBufferCacheNode *p;                          /* pointer to the node where the cluster is stored */
+
+  while (((p = searchCluster (n)) != NULL) && p->wback)
+    pthread_cond_wait (&wbackDone, &accessCR);
+
+  return p;
+}
+
+/*
+ *  Check if any of the blocks of a cluster, which is not stored in a cluster node starting at its first block, is
+ *  stored in another node of the storage area.
+ */
+
+static int clusterOverlaps (uint32_t n)
+{
+  uint32_t off;                                  /* offset of the block in the buffer area of the node */
+  uint32_t k;                                    /* counting variable */
+
+  for (k = 0; k < BLOCKS_PER_CLUSTER; k++)
+    if (searchBlock (n + k, &off) != NULL) return 1;
+
+  return 0;
+}
+
+/*
+ *  Release the nodes where some of the blocks of a cluster are stored, so that the cluster may be stored in a cluster
+ *  node of its own: their contents, if changed, is first written to the storage device.
+ */
+
+static int absorbOverlaps (uint32_t n)
+{
+  SOBufferCacheNode *p;                          /* pointer to the node */
+  uint32_t off;                                  /* offset of the block in the buffer area of the node */
+  uint32_t k;                                    /* counting variable */
+  int stat;                                      /* status of operation */
+
+  for (k = 0; k < BLOCKS_PER_CLUSTER; k++)
+    while ((p = searchBlock (n + k, &off)) != NULL)
+    { if (p->pin != 0) return -EBUSY;
+      if (p->wback)                              /* wait for the flusher to complete the write-back */
+         { pthread_cond_wait (&wbackDone, &accessCR);
+           continue;
+         }
+      if ((p->stat == CHANGED) && ((stat = writeNode (p)) != 0))
+         return stat;
+      dropNode (p);
+      putFreeNode (p);
+    }
+
+  return 0;
+}
+
+/*
+ *  Write the contents of a node to the storage device.
+ */
+
+static int writeNode (SOBufferCacheNode *p)
+{
+  int stat;                                      /* status of operation */
+
+  if ((stat = devWrite (p->n, p->nblks, p->buffer)) == 0)
+     { markSame (p);
+       countWriteBack (p->nblks);
+     }
+
+  return stat;
+}
+
+/*
+ *  Insert a node, just assigned to a block or a cluster, in the storage area. Under the scan-resistant policy, it
+ *  enters the first-access queue of its kind, unless its block was replaced from that queue recently.
+ */
+
+static void addNode (SOBufferCacheNode *p)
+{
+  p->prio = (prioRegions >> regionOf (p->n)) & 1;
+  if ((replPolicy == BC_2Q) && !takeGhost (p->n))
+     { p->queue = FIRST_Q;
+       nFirst[KIND(p)] += 1;
+     }
+     else p->queue = MAIN_Q;
+  nPrio[KIND(p)] += p->prio;
+  insertNode (p, &nLHead, HEAD(p), TAIL(p));
+}
+
+/*
+ *  Move a node, which has just been accessed, to the head of the double-linked list based on the last access time of
+ *  its kind (the nodes of the first-access queues are left in FIFO order).
+ */
+
+static void touchNode (SOBufferCacheNode *p)
+{
+  if (p->queue == MAIN_Q)
+     moveNodeAtHeadLAT (p, &lATLHead[KIND(p)], &lATLTail[KIND(p)]);
+}
+
+/*
+ *  Remove a node from the storage area.
+ */
+
+static void dropNode (SOBufferCacheNode *p)
+{
+  removeNode (p, &nLHead, HEAD(p), TAIL(p));
+  if (p->queue == FIRST_Q) nFirst[KIND(p)] -= 1;
+  nPrio[KIND(p)] -= p->prio;
+  p->queue = MAIN_Q;
+  p->prio = 0;
+}
+
+/*
+ *  Remove a node selected for replacement from the storage area: a ghost entry of its block is kept, if it comes from
+ *  a first-access queue.
+ */
+
+static void evictNode (SOBufferCacheNode *p)
+{
+  if (p->queue == FIRST_Q) addGhost (p->n);
+  dropNode (p);
+  evictCount += 1;
+  soStatAdd (STAT_BC_EVICT, 1);
+}
+
+/*
+ *  Select a node of a given kind for replacement. The first-access queue is searched first, if it holds more than its
+ *  share of the nodes, and the main list afterwards, or the other way round. The nodes with priority are only
+ *  selected if no other node may be, or if they hold more than their share of the nodes.
+ */
+
+static SOBufferCacheNode *selectVictim (uint32_t kind)
+{
+  SOBufferCacheNode *tail[2];                    /* tails of the lists in the order they are searched */
+  SOBufferCacheNode *p;                          /* pointer to the node */
+  int skipPrio;                                  /* signals if the nodes with priority are skipped */
+  uint32_t i;                                    /* counting variable */
+
+  if ((uint64_t) nFirst[kind] * 4 > (uint64_t) nActive[kind] * FIRST_SHARE)
+     { tail[0] = fQTail[kind];
+       tail[1] = lATLTail[kind];
+     }
+     else { tail[0] = lATLTail[kind];
+            tail[1] = fQTail[kind];
+          }
+  for (skipPrio = ((uint64_t) nPrio[kind] * 4 <= (uint64_t) nActive[kind] * PRIO_SHARE); skipPrio >= 0; skipPrio--)
+    for (i = 0; i < 2; i++)
+      if ((p = scanVictims (tail[i], skipPrio)) != NULL)
+         return p;
+
+  return NULL;
+}
+
+/*
+ *  Search a list for a node to be replaced, starting at its tail: the first unchanged node close to the tail, or the
+ *  first one that may be replaced if there is none; pinned nodes and nodes being written back are skipped.
+ */
+
+static SOBufferCacheNode *scanVictims (SOBufferCacheNode *tail, int skipPrio)
+{
+  SOBufferCacheNode *p;                          /* pointer to a node */
+  SOBufferCacheNode *victim;                     /* pointer to the node selected for replacement */
+  uint32_t i;                                    /* counting variable */
+
+  victim = NULL;
+  for (p = tail, i = 0; p != NULL; p = p->access_prev, i++)
+  { if ((p->pin != 0) || p->wback || (skipPrio && p->prio)) continue;
+    if (victim == NULL) victim = p;
+    if (p->stat == SAME)
+       { victim = p;
+         break;
+       }
+    if (i >= EVICT_SCAN) break;
+  }
+
+  return victim;
+}
+
+/*
+ *  Check if at least a given number of nodes of a given kind may be got by getFreeNode: the free ones and those in the
+ *  storage area which are neither pinned nor being written back.
+ */
+
+static int spareNodes (uint32_t kind, uint32_t want)
+{
+  SOBufferCacheNode *tail[2] = { lATLTail[kind], fQTail[kind] };      /* tails of the lists of the storage area */
+  SOBufferCacheNode *p;                          /* pointer to a node */
+  uint32_t n, i;                                 /* number of nodes found and counting variable */
+
+  for (p = freeList[kind], n = 0; (p != NULL) && (n < want); p = p->n_next)
+    n += 1;
+  for (i = 0; i < 2; i++)
+    for (p = tail[i]; (p != NULL) && (n < want); p = p->access_prev)
+      if ((p->pin == 0) && !p->wback) n += 1;
+
+  return n >= want;
+}
+
+/*
+ *  Get a node of a given kind for a block or a cluster which is not stored in the storage area: if there are no free
+ *  nodes of that kind left, the node that has not been accessed for the longest time is retrieved and its contents,
+ *  if changed, is written to the storage device.
+ */
+
+static int getFreeNode (uint32_t kind, SOBufferCacheNode **p_node)
+{
+  SOBufferCacheNode *p;                          /* pointer to a node */
+  int stat;                                      /* status of operation */
+
+  if (freeList[kind] != NULL)
+     { p = freeList[kind];
+       freeList[kind] = p->n_next;
+     }
+     else { if ((p = selectVictim (kind)) == NULL)
+               return -ENOBUFS;                  /* all nodes are pinned */
+            evictNode (p);
+            if ((p->stat == CHANGED) && ((stat = writeNode (p)) != 0))
+               { addNode (p);
+                 return stat;
+               }
+          }
+  p->stat = SAME;
+  p->pin = 0;
+  p->wback = 0;
+  p->n_prev = p->n_next = NULL;
+  p->access_prev = p->access_next = NULL;
+  *p_node = p;
+
+  return 0;
+}
+
+/*
+ *  Return a node which is not assigned to any block to the list of free nodes of its kind.
+ */
+
+static void putFreeNode (SOBufferCacheNode *p)
+{
+  p->stat = SAME;
+  p->pin = 0;
+  p->wback = 0;
+  p->queue = MAIN_Q;
+  p->prio = 0;
+  p->n_prev = p->access_prev = p->access_next = NULL;
+  p->n_next = freeList[KIND(p)];
+  freeList[KIND(p)] = p;
+}
+
+/*
+ *  Current time in seconds (monotonic clock).
+ */
+
+static uint32_t now (void)
+{
+  struct timespec ts;                            /* current time */
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (uint32_t) ts.tv_sec;
+}
+
+/*
+ *  Mark the contents of a node as changed: the time of the change is recorded and the flusher is woken up if the ratio
+ *  of changed nodes is exceeded.
+ */
+
+static void markChanged (SOBufferCacheNode *p)
+{
+  if (p->stat == CHANGED) return;
+  p->stat = CHANGED;
+  p->dtime = now ();
+  nDirty += 1;
+  if (flusherRunning && (flushPeriod != 0) && ((uint64_t) nDirty * 100 > (uint64_t) dirtyRatio * nNodes))
+     pthread_cond_signal (&flusherWakeUp);
+}
+
+/*
+ *  Mark the contents of a node as the same as the storage device.
+ */
+
+static void markSame (SOBufferCacheNode *p)
+{
+  if (p->stat != CHANGED) return;
+  p->stat = SAME;
+  nDirty -= 1;
+}
+
+/*
+ *  Read a number of successive blocks from the storage device (a single positioned transfer is carried out, so the
+ *  access lock need not be held).
+ */
+
+static int devRead (uint32_t n, uint32_t nblks, void *buf)
+{
+  struct iovec iov;                              /* buffer descriptor */
+
+  iov.iov_base = buf;
+  iov.iov_len = (size_t) nblks * BLOCK_SIZE;
+  return soReadRawBlocks (n, 1, &iov);
+}
+
+/*
+ *  Write a number of successive blocks to the storage device (a single positioned transfer is carried out, so the
+ *  access lock need not be held).
+ */
+
+static int devWrite (uint32_t n, uint32_t nblks, void *buf)
+{
+  struct iovec iov;                              /* buffer descriptor */
+
+  noteWrite (n, nblks);
+  iov.iov_base = buf;
+  iov.iov_len = (size_t) nblks * BLOCK_SIZE;
+  return soWriteRawBlocks (n, 1, &iov);
+}
+
+/*
+ *  Write a number of successive blocks to the storage device and make sure they reach the supporting file, if it is
+ *  memory-mapped.
+ */
+
+static int devFlush (uint32_t n, uint32_t nblks, void *buf)
+{
+  int stat;                                      /* status of operation */
+
+  if ((stat = devWrite (n, nblks, buf)) != 0)
+     return stat;
+
+  return soSyncRawBlocks (n, nblks);
+}
+
+/*
+ *  Add a changed node to the batch of runs of adjacent nodes to be written back (the caller holds the access lock): the
+ *  nodes must be added in ascending order of physical block number and the batch is submitted when it becomes full.
+ */
+
+static int addToBatch (SOBufferCacheNode *p)
+{
+  SOBufferCacheNode *last;                       /* last node added to the batch */
+  int stat;                                      /* status of operation */
+
+  last = (nBatchNode == 0) ? NULL : batchNode[nBatchNode-1];
+  if ((last == NULL) || (last->n + last->nblks != p->n) || (batchReq[nBatchReq-1].count == WRITE_RUN))
+     { /* open a new run */
+       if ((nBatchReq == WRITE_BATCH) && ((stat = submitBatch ()) != 0))
+          return stat;
+       batchReq[nBatchReq].wr = 1;
+       batchReq[nBatchReq].n = p->n;
+       batchReq[nBatchReq].count = 0;
+       batchReq[nBatchReq].iov = &batchIov[nBatchNode];
+       nBatchReq += 1;
+     }
+  noteWrite (p->n, p->nblks);
+  batchIov[nBatchNode].iov_base = p->buffer;
+  batchIov[nBatchNode].iov_len = (size_t) p->nblks * BLOCK_SIZE;
+  batchNode[nBatchNode++] = p;
+  batchReq[nBatchReq-1].count += 1;
+
+  return 0;
+}
+
+/*
+ *  Submit the batch of runs of adjacent nodes to be written back (the caller holds the access lock): the nodes of the
+ *  runs which were transferred are no longer changed.
+ */
+
+static int submitBatch (void)
+{
+  uint32_t i, j, k;                              /* counting variables */
+  int stat;                                      /* status of operation */
+
+  if (nBatchReq == 0) return 0;
+  stat = soSubmitRawRequests (batchReq, nBatchReq);
+  for (i = 0, k = 0; i < nBatchReq; i++)
+    for (j = 0; j < batchReq[i].count; j++, k++)
+      if (batchReq[i].stat == 0)
+         { markSame (batchNode[k]);
+           countWriteBack (batchNode[k]->nblks);
+         }
+  nBatchReq = nBatchNode = 0;
+
+  return stat;
+}
+
+/*
+ *  Flusher thread: it is activated periodically, or when the ratio of changed nodes is exceeded, and writes back the
+ *  changed nodes which are due.
+ */
+
+static void *flusher (void *arg __attribute__ ((unused)))
+{
+  struct timespec ts;                            /* time limit for the wait */
+
+  pthread_mutex_lock (&accessCR);
+  while (!flusherStop)
+  { if (flushPeriod == 0)                        /* it was disabled meanwhile: it idles until it is enabled again */
+       pthread_cond_wait (&flusherWakeUp, &accessCR);
+       else { clock_gettime (CLOCK_REALTIME, &ts);
+              ts.tv_sec += flushPeriod;
+              pthread_cond_timedwait (&flusherWakeUp, &accessCR, &ts);
+            }
+    while (!flusherStop && (flushPeriod != 0) && (writeBackStep () == MAX_WBACK));
+  }
+  pthread_mutex_unlock (&accessCR);
+
+  return NULL;
+}
+
+/*
+ *  Write back a step of changed nodes which are due, in ascending order of physical block number (the caller holds the
+ *  access lock).
+ *  Their contents is copied to the staging area and the nodes are marked as being written back, so that they are not
+ *  replaced meanwhile; the access lock is released while the transfers take place. Runs of nodes which are adjacent in
+ *  the storage device are transferred together, all the runs being submitted as a single batch.
+ *  It returns the number of data blocks that were copied to the staging area.
+ */
+
+static uint32_t writeBackStep (void)
+{
+  SOBufferCacheNode *p;                          /* pointer to a node */
+  uint32_t t;                                    /* current time */
+  int urgent;                                    /* signals the ratio of changed nodes is exceeded */
+  uint32_t nStaged, nBlks, nReq;                 /* number of staged nodes, blocks and requests */
+  uint32_t i, j, k, run;                         /* counting variables */
+
+  /* select and stage the nodes */
+
+  t = now ();
+  urgent = ((uint64_t) nDirty * 100 > (uint64_t) dirtyRatio * nNodes);
+  nStaged = nBlks = 0;
+  for (p = nLHead; (p != NULL) && (nBlks + BLOCKS_PER_CLUSTER <= MAX_WBACK); p = p->n_next)
+  { if ((p->stat != CHANGED) || (p->pin != 0) || p->wback) continue;
+    if (!urgent && (t - p->dtime < dirtyAge)) continue;
+    memcpy (staging + nBlks * BLOCK_SIZE, p->buffer, p->nblks * BLOCK_SIZE);
+    noteWrite (p->n, p->nblks);
+    markSame (p);
+    p->wback = 1;
+    stagedNode[nStaged++] = p;
+    nBlks += p->nblks;
+  }
+  if (nStaged == 0) return 0;
+
+  /* build the requests for the runs of adjacent nodes */
+
+  for (i = 0, j = 0, nReq = 0; i < nStaged; i += run, nReq++)
+  { for (run = 1, nBlks = stagedNode[i]->nblks; (i + run < nStaged) &&
+         (stagedNode[i+run-1]->n + stagedNode[i+run-1]->nblks == stagedNode[i+run]->n); run++)
+      nBlks += stagedNode[i+run]->nblks;
+    stagedIov[nReq].iov_base = staging + j * BLOCK_SIZE;
+    stagedIov[nReq].iov_len = (size_t) nBlks * BLOCK_SIZE;
+    stagedReq[nReq].wr = 1;
+    stagedReq[nReq].n = stagedNode[i]->n;
+    stagedReq[nReq].count = 1;
+    stagedReq[nReq].iov = &stagedIov[nReq];
+    j += nBlks;
+  }
+
+  /* transfer them as a batch without holding the access lock */
+
+  pthread_mutex_unlock (&accessCR);
+  soSubmitRawRequests (stagedReq, nReq);
+  pthread_mutex_lock (&accessCR);
+
+  /* release the nodes: the ones which failed are changed again */
+
+  for (i = 0, k = 0, nBlks = 0; k < nReq; k++)
+    for (run = 0; run < (stagedIov[k].iov_len / BLOCK_SIZE); run += stagedNode[i]->nblks, i++)
+    { if (stagedReq[k].stat != 0)
+         markChanged (stagedNode[i]);
+         else countWriteBack (stagedNode[i]->nblks);
+      stagedNode[i]->wback = 0;
+      nBlks += stagedNode[i]->nblks;
+    }
+  pthread_cond_broadcast (&wbackDone);
+
+  return nBlks;
+}
+
+/*
+ *  Prefetcher thread: it is activated when clusters are queued to be prefetched.
+ */
+
+static void *prefetcher (void *arg __attribute__ ((unused)))
+{
+  pthread_mutex_lock (&accessCR);
+  while (!prefetcherStop)
+  { if (pfCount == 0)
+       pthread_cond_wait (&prefetcherWakeUp, &accessCR);
+       else prefetchStep ();
+  }
+  pthread_mutex_unlock (&accessCR);
+
+  return NULL;
+}
+
+/*
+ *  Prefetch a step of queued clusters (the caller holds the access lock).
+ *  A free node is assigned to each cluster, which is not yet stored in the storage area, and the clusters are read as
+ *  a batch without holding the access lock. The nodes are only inserted in the storage area afterwards, if the cluster
+ *  was neither brought into the storage area nor written to the storage device meanwhile.
+ *  The nodes being prefetched can not be got by the accesses meanwhile, so a step takes at most a quarter of the
+ *  cluster nodes and only as long as as many others may still be got: otherwise, the clusters are not prefetched.
+ */
+
+static void prefetchStep (void)
+{
+  SOBufferCacheNode *p;                          /* pointer to a node */
+  uint32_t n, i;                                 /* physical number of a cluster and counting variable */
+  uint32_t batch;                                /* maximum number of clusters read in this step */
+
+  batch = nActive[CLUSTER_NODE] / 4;
+  if (batch > PREFETCH_BATCH) batch = PREFETCH_BATCH;
+
+  /* assign free nodes to the queued clusters, keeping as many nodes for the accesses */
+
+  nPfNode = 0;
+  while ((pfCount != 0) && (nPfNode < batch))
+  { n = pfQueue[pfHead];
+    pfHead = (pfHead + 1) % PREFETCH_QUEUE;
+    pfCount -= 1;
+    if ((searchCluster (n) != NULL) || clusterOverlaps (n)) continue;
+    for (i = 0; (i < nPfNode) && (pfNode[i]->n != n); i++);
+    if (i < nPfNode) continue;
+    if (!spareNodes (CLUSTER_NODE, batch + 1) || (getFreeNode (CLUSTER_NODE, &p) != 0))
+       break;                                    /* no node may be spared now */
+    p->n = n;
+    pfNode[nPfNode] = p;
+    pfStale[nPfNode] = 0;
+    pfIov[nPfNode].iov_base = p->buffer;
+    pfIov[nPfNode].iov_len = CLUSTER_SIZE;
+    pfReq[nPfNode].wr = 0;
+    pfReq[nPfNode].n = n;
+    pfReq[nPfNode].count = 1;
+    pfReq[nPfNode].iov = &pfIov[nPfNode];
+    nPfNode += 1;
+  }
+  if (nPfNode == 0)
+     { pfHead = pfCount = 0;                     /* the remaining requests are dropped */
+       return;
+     }
+
+  /* read the clusters as a batch without holding the access lock */
+
+  pthread_mutex_unlock (&accessCR);
+  soSubmitRawRequests (pfReq, nPfNode);
+  pthread_mutex_lock (&accessCR);
+
+  /* insert the nodes whose contents is still valid */
+
+  for (i = 0; i < nPfNode; i++)
+  { p = pfNode[i];
+    if ((pfReq[i].stat != 0) || pfStale[i] || (searchCluster (p->n) != NULL) || clusterOverlaps (p->n))
+       putFreeNode (p);
+       else addNode (p);
+  }
+  nPfNode = 0;
+}
+
+/*
+ *  Record that a number of successive blocks are about to be written to the storage device, so that the clusters being
+ *  prefetched which overlap them are discarded (the caller holds the access lock).
+ */
+
+static void noteWrite (uint32_t n, uint32_t nblks)
+{
+  uint32_t i;                                    /* counting variable */
+
+  for (i = 0; i < nPfNode; i++)
+    if ((pfNode[i]->n < n + nblks) && (n < pfNode[i]->n + BLOCKS_PER_CLUSTER))
+       pfStale[i] = 1;
+}
+
+/*
+ *  Start the write-back flusher (the caller holds the access lock).
+ */
+
+static void startFlusher (void)
+{
+  flusherStop = 0;
+  if (pthread_create (&flusherThread, NULL, flusher, NULL) == 0)
+     flusherRunning = 1;
+}
+
+/*
+ *  Stop the flusher and the prefetcher threads.
+ */
+
+static void stopThreads (void)
+{
+  pthread_mutex_lock (&accessCR);
+  flusherStop = prefetcherStop = 1;
+  pthread_cond_signal (&flusherWakeUp);
+  pthread_cond_signal (&prefetcherWakeUp);
+  pthread_mutex_unlock (&accessCR);
+  if (flusherRunning)
+     { pthread_join (flusherThread, NULL);
+       flusherRunning = 0;
+     }
+  if (prefetcherRunning)
+     { pthread_join (prefetcherThread, NULL);
+       prefetcherRunning = 0;
+     }
+}
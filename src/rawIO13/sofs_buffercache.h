@@ -10,7 +10,7 @@
  *  probability of access in the near future is higher.
  *
  *  The buffercache may be regarded as a storage area resident in main memory having the ability to store K data blocks
- *  of the device's storage space.
+ *  of the device's storage space. K may be set at run time, even while the storage area is assigned to the storage device.
  *  Data transfer between the main memory and the device works according to the following rules:
  *    \li every time a data block (cluster) is required for reading, it is looked up in the storage area: if it is
  *        there, the contents is copied to the supplied buffer location; otherwise, it is first read from the device
@@ -24,8 +24,23 @@
  *        available, the node that has not been accessed for the longest time is selected for replacement: its contents,
  *        if needed (the status is marked <em>changed</em>), is first transfered to the device, then it becomes
  *        available for a new assignment.
+ *    \li long runs of successive clusters (at least \c DIRECT_RUN) are transferred straight between the supplied
+ *        buffer and the device, the ones of them already stored in the storage area excepted, when reading, and the
+ *        copies in the storage area being discarded, when writing: a large sequential transfer neither goes through
+ *        the nodes of the storage area, nor replaces the nodes which are in use.
+ *
+ *  Instead of replacing the node that has not been accessed for the longest time (\e LRU), a scan-resistant policy
+ *  (\e 2Q) may be selected: a node accessed for the first time enters a first-access queue, which is replaced in FIFO
+ *  order while it holds more than its share of the nodes, and only moves to the main list, based on the last access
+ *  time, if its block is accessed again soon after being replaced. A single long sequential scan thus only replaces
+ *  nodes of the first-access queue. Besides, the nodes of some regions of the storage device (the superblock and the
+ *  table of inodes, for instance) may be given priority: they are only replaced when no other node may be, as long as
+ *  they hold at most half of the nodes of their kind.
  *
  *  The following operations are defined:
+ *    \li set the number of data blocks of the storage area
+ *    \li set the parameters of the write-back flusher
+ *    \li set the replacement policy and the regions of the storage device with priority
  *    \li initialize the storage area and assign it to the storage device
  *    \li unassign the storage area from the storage device and perform the required housekeeping duties
  *    \li read a block of data from the buffercache
@@ -35,7 +50,15 @@
  *    \li read a cluster of data from the buffercache
  *    \li write a cluster of data to the buffercache
  *    \li flush a cluster of data to the storage device
- *    \li synchronize a cluster of data with the same cluster in the storage device.
+ *    \li synchronize a cluster of data with the same cluster in the storage device
+ *    \li read a run of successive clusters of data from the buffercache
+ *    \li write a run of successive clusters of data to the buffercache
+ *    \li pin, unpin and mark as changed a block of data in the buffercache
+ *    \li pin, unpin and mark as changed a cluster of data in the buffercache
+ *    \li prefetch a cluster of data into the buffercache
+ *    \li discard a run of successive clusters of data
+ *    \li set the layout of the regions of the storage device
+ *    \li get, reset and report the statistics of the buffercache.
  *
  *  \author Artur Carneiro Pereira - September 2007
  *  \author Miguel Oliveira e Silva - September 2009
@@ -50,11 +73,146 @@
 #define SOFS_BUFFERCACHE_H_
 
 #include <stdint.h>
+#include <stddef.h>
+
+#include "sofs_const.h"
+
 /** \brief the communication channel to the storage device is buffered */
 #define BUF    0
 /** \brief the communication channel to the storage device is unbuffered */
 #define UNBUF  1
 
+/** \brief default number of data blocks of the storage area (K): 25 clusters, whatever their size */
+#define K_DEFAULT  (25 * BLOCKS_PER_CLUSTER)
+
+/** \brief default period (in seconds) of activation of the write-back flusher */
+#define FLUSH_PERIOD  5
+/** \brief default age (in seconds) above which a changed data block is written back */
+#define DIRTY_AGE  30
+/** \brief minimum number of successive clusters of a run which is transferred straight between the supplied buffer and
+ *         the device, bypassing the storage area */
+#define DIRECT_RUN  16
+
+/** \brief default percentage of changed data blocks of the storage area above which they are written back regardless
+ *         of their age */
+#define DIRTY_RATIO  10
+
+/* replacement policies */
+
+/** \brief the node that has not been accessed for the longest time is replaced */
+#define BC_LRU  0
+/** \brief scan-resistant policy: nodes accessed only once recently are replaced first, in FIFO order */
+#define BC_2Q   1
+
+/* regions of the storage device, as laid out by the file system */
+
+/** \brief superblock */
+#define BC_SUPERBLOCK  0
+/** \brief table of inodes */
+#define BC_ITABLE      1
+/** \brief mapping table cluster-to-inode */
+#define BC_CIUTABLE    2
+/** \brief bitmap table to free data clusters */
+#define BC_BITMAP      3
+/** \brief data zone */
+#define BC_DZONE       4
+/** \brief number of regions */
+#define BC_REGIONS     5
+
+/** \brief statistics and parameters of the buffercache */
+typedef struct soBufferCacheStats
+{
+  /** \brief number of accesses to blocks or clusters of each region found in the storage area */
+  uint64_t hits[BC_REGIONS];
+  /** \brief number of accesses to blocks or clusters of each region not found in the storage area */
+  uint64_t misses[BC_REGIONS];
+  /** \brief number of nodes replaced */
+  uint64_t evictions;
+  /** \brief number of bytes written back to the storage device */
+  uint64_t wbackBytes;
+  /** \brief number of bytes transferred straight between the supplied buffers and the storage device */
+  uint64_t directBytes;
+  /** \brief signals if the storage area is assigned to the storage device */
+  uint32_t inUse;
+  /** \brief number of data blocks of the storage area (the one to be allocated, if it is not in use) */
+  uint32_t capacity;
+  /** \brief number of nodes of the storage area */
+  uint32_t nodes;
+  /** \brief number of changed nodes of the storage area */
+  uint32_t dirty;
+  /** \brief number of pinned nodes of the storage area */
+  uint32_t pinned;
+  /** \brief period (in seconds) of activation of the write-back flusher */
+  uint32_t period;
+  /** \brief age (in seconds) above which a changed data block is written back */
+  uint32_t age;
+  /** \brief percentage of changed data blocks above which they are written back regardless of their age */
+  uint32_t ratio;
+  /** \brief replacement policy */
+  uint32_t policy;
+  /** \brief regions of the storage device with priority, one bit per region */
+  uint32_t prio;
+} SOBufferCacheStats;
+
+/**
+ *  \brief Set the number of data blocks of the storage area.
+ *
+ *  The value takes effect the next time the storage area is assigned to the storage device by \e soOpenBufferCache.
+ *  If the storage area is already in use and the communication channel is buffered, it is resized straight away:
+ *  nodes are added to it, or the nodes not accessed for the longest time, unless pinned or being written back, are
+ *  written back, if changed, and withdrawn from it (the nodes are kept, to be reused if it grows again, but the memory
+ *  pages which only hold their buffer areas are returned to the system).
+ *
+ *  \param nBlocks number of data blocks of the storage area
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>number of data blocks</em> is smaller than \c BLOCKS_PER_CLUSTER
+ *  \return -\c EBUSY, if the storage area could not be shrunk that much, because too many nodes are pinned or being
+ *          written back (it is shrunk as much as possible)
+ *  \return -\c ENOMEM, if there is no memory to enlarge the storage area
+ *  \return -\c EIO, if it fails on writing back a node
+ */
+
+extern int soSetBufferCacheCapacity (uint32_t nBlocks);
+
+/**
+ *  \brief Set the parameters of the write-back flusher.
+ *
+ *  When the communication channel is buffered, changed data blocks are written back to the storage device in the
+ *  background, in ascending order of physical block number, by a flusher thread which is activated periodically, or
+ *  whenever the ratio of changed data blocks of the storage area is exceeded.
+ *  The values take effect straight away, if the storage area is in use, the flusher being started, if it was not
+ *  running, or left idle while the period is zero, or the next time the storage area is assigned to the storage device
+ *  by \e soOpenBufferCache, otherwise.
+ *
+ *  \param period period (in seconds) of activation of the flusher (zero disables it)
+ *  \param age age (in seconds) above which a changed data block is written back
+ *  \param ratio percentage of changed data blocks of the storage area above which they are written back regardless of
+ *               their age
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>ratio</em> is greater than 100
+ */
+
+extern int soSetBufferCacheFlusher (uint32_t period, uint32_t age, uint32_t ratio);
+
+/**
+ *  \brief Set the replacement policy and the regions of the storage device with priority.
+ *
+ *  The values take effect straight away: if the policy changes while the storage area is in use, the nodes of the
+ *  first-access queue join the main list, or they all start in the main list, and the priority of every node is set
+ *  anew.
+ *
+ *  \param policy replacement policy (\c BC_LRU or \c BC_2Q)
+ *  \param prio regions of the storage device with priority, one bit per region (<tt>1 << BC_ITABLE</tt>, for instance)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>policy</em> is unknown or the <em>regions</em> do not exist
+ *  \return -\c ENOMEM, if there is no memory to keep track of the nodes replaced recently
+ */
+
+extern int soSetBufferCachePolicy (uint32_t policy, uint32_t prio);
+
 /**
  *  \brief Initialize the storage area and assign it to the storage device.
  *
@@ -69,12 +227,62 @@
  *  \return <tt>0 (zero)</tt>, on success
  *  \return -\c EINVAL, if the argument is \c NULL
  *  \return -\c EBUSY, if the storage area is already in use or the device is already opened
+ *  \return -\c ENOMEM, if there is no memory to allocate the storage area
  *  \return -\c ELIBBAD, if the supporting file size is invalid
  *  \return -<em>other specific error</em> issued by \e lseek system call
  */
 
 extern int soOpenBufferCache (const char *devname, uint32_t type);
 
+/**
+ *  \brief Set the layout of the regions of the storage device.
+ *
+ *  It only serves to account the accesses to each region separately. Until it is set, block zero is accounted to the
+ *  superblock and every other block to the data zone. It is reset when the storage area is unassigned.
+ *
+ *  \param itable physical number of the first block of the table of inodes
+ *  \param ciutable physical number of the first block of the mapping table cluster-to-inode
+ *  \param bitmap physical number of the first block of the bitmap table to free data clusters
+ *  \param dzone physical number of the first block of the data zone
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the regions are not laid out in this order after the superblock
+ */
+
+extern int soSetBufferCacheLayout (uint32_t itable, uint32_t ciutable, uint32_t bitmap, uint32_t dzone);
+
+/**
+ *  \brief Get the statistics and the parameters of the buffercache.
+ *
+ *  \param p_stats pointer to the location where they are to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the pointer is \c NULL
+ */
+
+extern int soGetBufferCacheStats (SOBufferCacheStats *p_stats);
+
+/**
+ *  \brief Reset the statistics of the buffercache.
+ */
+
+extern void soResetBufferCacheStats (void);
+
+/**
+ *  \brief Report the statistics and the parameters of the buffercache in a buffer.
+ *
+ *  The hit ratio of each region is reported, besides the values returned by \e soGetBufferCacheStats. As with
+ *  \e snprintf, at most <tt>size - 1</tt> characters are stored and the report is NUL-terminated, if \e size is not
+ *  zero.
+ *
+ *  \param buf pointer to the buffer where the report is to be stored (it may be \c NULL, if \e size is zero)
+ *  \param size size of the buffer
+ *
+ *  \return <em>length of the whole report</em>
+ */
+
+extern int soReportBufferCacheStats (char *buf, size_t size);
+
 /**
  *  \brief Unassign the storage area from the storage device and perform the required housekeeping duties.
  *
@@ -243,4 +451,210 @@ extern int soFlushCacheCluster (uint32_t n, void *buf);
 
 extern int soSyncCacheCluster (uint32_t n);
 
+/**
+ *  \brief Read a run of successive clusters of data from the buffercache.
+ *
+ *  The device is organized as a linear array of data blocks. A cluster is a group of successive blocks.
+ *  The physical number of the first block of the first data cluster of the run, the number of data clusters and a
+ *  pointer to a previously allocated buffer, large enough to hold all of them, are supplied as arguments.
+ *  The data clusters which are not stored in the storage area are read from the storage device by a single vectored
+ *  transfer for each run of them, instead of one transfer per data cluster. If the run is long (at least
+ *  \c DIRECT_RUN data clusters), they are read straight into the supplied buffer and are not stored in the storage
+ *  area.
+ *
+ *  \param n physical number of the first block of the first data cluster of the run to be read from
+ *  \param count number of data clusters of the run
+ *  \param buf pointer to the buffer where the data must be read into
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>buffer pointer</em> is \c NULL, the <em>number of data clusters</em> is zero or the
+ *          run is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+extern int soReadCacheClusters (uint32_t n, uint32_t count, void *buf);
+
+/**
+ *  \brief Write a run of successive clusters of data to the buffercache.
+ *
+ *  The device is organized as a linear array of data blocks. A cluster is a group of successive blocks.
+ *  The physical number of the first block of the first data cluster of the run, the number of data clusters and a
+ *  pointer to a previously allocated buffer containing all of them are supplied as arguments.
+ *  If the communication channel is unbuffered, or if the run is long (at least \c DIRECT_RUN data clusters), it is
+ *  written straight from the supplied buffer by a single transfer: the copies of its data clusters in the storage area,
+ *  if any, are discarded, unless some of them are pinned (the run is then written to the buffercache).
+ *
+ *  \param n physical number of the first block of the first data cluster of the run to be written into
+ *  \param count number of data clusters of the run
+ *  \param buf pointer to the buffer containing the data to be written from
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>buffer pointer</em> is \c NULL, the <em>number of data clusters</em> is zero or the
+ *          run is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+extern int soWriteCacheClusters (uint32_t n, uint32_t count, void *buf);
+
+/**
+ *  \brief Pin a block of data in the buffercache.
+ *
+ *  The block is brought into the storage area, if it is not there yet, and a pointer to its contents in the storage
+ *  area is returned. The node where it is stored is not selected for replacement until every pin on it is released.
+ *  The contents may be directly read and modified through the pointer; in the latter case, the block must be marked
+ *  as changed by calling \e soMarkCacheBlockDirty before it is unpinned.
+ *  Closing the buffercache releases all pins.
+ *  When the communication channel is unbuffered, but the storage device is memory-mapped, the pointer refers directly
+ *  to the mapping of the supporting file: the contents is changed as soon as it is modified and the operations which
+ *  release the pin and mark the block as changed do nothing.
+ *
+ *  \param n physical number of the data block to be pinned
+ *  \param p_buf pointer to a location where the pointer to the contents of the block is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>pointer</em> is \c NULL or the <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c ENOTSUP, if the communication channel is unbuffered and the storage device is not memory-mapped
+ *  \return -\c ENOBUFS, if all the nodes of the storage area are pinned
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+extern int soPinCacheBlock (uint32_t n, void **p_buf);
+
+/**
+ *  \brief Release a pin on a block of data in the buffercache.
+ *
+ *  \param n physical number of the data block to be unpinned
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>block number</em> is out of range or the block is not pinned
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c ENOTSUP, if the communication channel is unbuffered and the storage device is not memory-mapped
+ */
+
+extern int soUnpinCacheBlock (uint32_t n);
+
+/**
+ *  \brief Mark a block of data in the buffercache as changed.
+ *
+ *  It is meant to be used when the contents of a pinned block is modified through the pointer returned by
+ *  \e soPinCacheBlock.
+ *
+ *  \param n physical number of the data block to be marked
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>block number</em> is out of range or the block is not stored in the storage area
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c ENOTSUP, if the communication channel is unbuffered and the storage device is not memory-mapped
+ */
+
+extern int soMarkCacheBlockDirty (uint32_t n);
+
+/**
+ *  \brief Pin a cluster of data in the buffercache.
+ *
+ *  The device is organized as a linear array of data blocks. A cluster is a group of successive blocks.
+ *  The cluster is brought into the storage area as a whole, if it is not there yet, and a pointer to its contents in
+ *  the storage area is returned. The node where it is stored is not selected for replacement until every pin on it is
+ *  released. The contents may be directly read and modified through the pointer; in the latter case, the cluster must
+ *  be marked as changed by calling \e soMarkCacheClusterDirty before it is unpinned.
+ *  A cluster is not pinned if that would leave fewer than a reserve of nodes which may be replaced, so that the
+ *  other accesses never run out of nodes because of the pins.
+ *  Closing the buffercache releases all pins.
+ *  When the communication channel is unbuffered, but the storage device is memory-mapped, the pointer refers directly
+ *  to the mapping of the supporting file: the contents is changed as soon as it is modified and the operations which
+ *  release the pin and mark the cluster as changed do nothing.
+ *
+ *  \param n physical number of the first block of the data cluster to be pinned
+ *  \param p_buf pointer to a location where the pointer to the contents of the cluster is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>pointer</em> is \c NULL or the <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c ENOTSUP, if the communication channel is unbuffered and the storage device is not memory-mapped
+ *  \return -\c EBUSY, if some of the blocks of the cluster are pinned in another node
+ *  \return -\c ENOBUFS, if pinning it would leave too few nodes of the storage area to be replaced
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+extern int soPinCacheCluster (uint32_t n, void **p_buf);
+
+/**
+ *  \brief Release a pin on a cluster of data in the buffercache.
+ *
+ *  \param n physical number of the first block of the data cluster to be unpinned
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>block number</em> is out of range or the cluster is not pinned
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c ENOTSUP, if the communication channel is unbuffered and the storage device is not memory-mapped
+ */
+
+extern int soUnpinCacheCluster (uint32_t n);
+
+/**
+ *  \brief Mark a cluster of data in the buffercache as changed.
+ *
+ *  It is meant to be used when the contents of a pinned cluster is modified through the pointer returned by
+ *  \e soPinCacheCluster.
+ *
+ *  \param n physical number of the first block of the data cluster to be marked
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>block number</em> is out of range or the cluster is not stored in the storage area
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c ENOTSUP, if the communication channel is unbuffered and the storage device is not memory-mapped
+ */
+
+extern int soMarkCacheClusterDirty (uint32_t n);
+
+/**
+ *  \brief Prefetch a cluster of data into the buffercache.
+ *
+ *  The device is organized as a linear array of data blocks. A cluster is a group of successive blocks.
+ *  The cluster is queued to be read into the storage area in the background, so that a later access to it does not
+ *  have to wait for the storage device. Nothing is done if the communication channel is unbuffered, the cluster, or
+ *  some of its blocks, are already stored in the storage area, or the queue is full: it is only a hint.
+ *
+ *  \param n physical number of the first block of the data cluster to be prefetched
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>block number</em> is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ */
+
+extern int soPrefetchCacheCluster (uint32_t n);
+
+/**
+ *  \brief Discard a run of successive clusters of data.
+ *
+ *  The device is organized as a linear array of data blocks. A cluster is a group of successive blocks.
+ *  The contents of the run is no longer needed: its copies in the storage area are dropped, even if changed, so that
+ *  they are never written back, the nodes where only some of the blocks of a cluster are stored excepted, which are
+ *  written back first, if changed, and the run is discarded on the storage device, whose room may then be reclaimed.
+ *
+ *  \param n physical number of the first block of the first data cluster of the run to be discarded
+ *  \param count number of data clusters of the run
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>number of data clusters</em> is zero or the run is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EBUSY, if some of the data clusters are pinned (the run is not discarded on the storage device)
+ *  \return -\c EOPNOTSUPP, if the storage device does not allow it
+ *  \return -\c EIO, if it fails on writing
+ *  \return -<em>other specific error</em> issued by \e soDiscardRawBlocks
+ */
+
+extern int soDiscardCacheClusters (uint32_t n, uint32_t count);
+
 #endif /* SOFS_BUFFERCACHE_H_ */
@@ -0,0 +1,596 @@
+/**
+ *  \file sofs_buffercacheinternals.c (implementation file)
+ *
+ *  \brief Set of operations to internally manage the buffercache.
+ *
+ *  The buffercache is conceived as two double-linked lists: the first, based on the physical block number of the
+ *  storage device it is referencing; the second, based on the order of last access to the block. Hence, one needs to
+ *  define operations to insert, retrieve and access its nodes.
+ *  To keep the look up of a block independent of the number of nodes in the storage area, the nodes are also indexed
+ *  by physical block number in an open-addressed hash table with linear probing. The double-linked list based on the
+ *  physical block number is kept for ordered traversal.
+ *  The physical numbers of the blocks whose nodes were replaced recently may be kept in a bounded index of ghost
+ *  entries: a ring, in order of addition, whose entries are chained by home slot of a separate table.
+ *  One should notice that this module does not stand alone: it supposes a very tight coupling with the buffercache
+ *  implementation, its only application.
+ *
+ *  The following operations are defined:
+ *    \li create, destroy and enlarge the hash table that indexes the nodes of the storage area
+ *    \li create, destroy, add to and take from the index of ghost entries
+ *    \li access the first node of the double-linked list based on the physical block number of the storage device
+ *    \li access the next node of the double-linked list based on the physical block number of the storage device
+ *    \li check if a given block, whose physical number is given, has already been stored in the storage area
+ *    \li insert a node in the two double-linked lists infrastructure
+ *    \li retrieve a node from the two double-linked lists infrastructure
+ *    \li remove a given node from the two double-linked lists infrastructure
+ *    \li move a node already present in the storage area to the head of the double-linked list based on the last access
+ *        time.
+ *
+ *  \author António Rui Borges - July 2010 / August 2011
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include "sofs_buffercachenode.h"
+#include "sofs_buffercacheinternals.h"
+
+/*
+ *  Internal data structure
+ */
+
+/** \brief number of preceding block numbers that are looked up in the hash table to locate the insertion point in the
+ *         double-linked list based on the physical block number before falling back to a linear traversal */
+#define PRED_WINDOW  8
+
+/** \brief iterator of the double-linked list based on the physical block number */
+static SOBufferCacheNode *nodeIt = NULL;
+/** \brief hash table of pointers to the nodes stored in the storage area, indexed by physical block number */
+static SOBufferCacheNode **hTable = NULL;
+/** \brief log2 of the number of slots of the hash table */
+static uint32_t hashBits = 0;
+/** \brief number of slots of the hash table (minus one, it is used as a mask) */
+static uint32_t hashMask = 0;
+/** \brief number of nodes presently indexed in the hash table */
+static uint32_t nIndexed = 0;
+
+/** \brief end of a chain of ghost entries, or an empty entry of the ring */
+#define NO_GHOST  UINT32_MAX
+
+/** \brief ring of ghost entries (physical block numbers, NO_GHOST if empty) */
+static uint32_t *ghostRing = NULL;
+/** \brief next entry of the chain of each entry of the ring */
+static uint32_t *ghostLink = NULL;
+/** \brief first entry of the chain of each slot of the table of ghost entries */
+static uint32_t *ghostHead = NULL;
+/** \brief number of entries of the ring */
+static uint32_t nGhostRing = 0;
+/** \brief log2 of the number of slots of the table of ghost entries */
+static uint32_t ghostBits = 0;
+/** \brief entry of the ring to be filled next (the oldest one) */
+static uint32_t ghostPos = 0;
+
+/* Allusion to internal functions */
+
+static uint32_t hashSlot (uint32_t nBlock);
+static SOBufferCacheNode *hashLookup (uint32_t nBlock);
+static void hashInsert (SOBufferCacheNode *node);
+static void hashRemove (SOBufferCacheNode *node);
+static uint32_t ghostSlot (uint32_t nBlock);
+static void ghostUnlink (uint32_t k);
+
+/**
+ *  \brief Create the hash table that indexes the nodes of the storage area.
+ *
+ *  The number of slots is the smallest power of two which is at least twice the number of nodes, so that the load
+ *  factor never exceeds 1/2.
+ *
+ *  \param nNodes number of nodes of the storage area
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>number of nodes</em> is zero
+ *  \return -\c EBUSY, if the hash table already exists
+ *  \return -\c ENOMEM, if there is no memory to allocate the hash table
+ */
+
+int initNodeIndex (uint32_t nNodes)
+{
+  if (nNodes == 0) return -EINVAL;
+  if (hTable != NULL) return -EBUSY;
+
+  for (hashBits = 1; ((1UL << hashBits) < 2UL * nNodes) && (hashBits < 31); hashBits++);
+  hashMask = (1U << hashBits) - 1;
+  if ((hTable = calloc ((size_t) hashMask + 1, sizeof (SOBufferCacheNode *))) == NULL)
+     { hashBits = hashMask = 0;
+       return -ENOMEM;
+     }
+  nIndexed = 0;
+  nodeIt = NULL;
+
+  return 0;
+}
+
+/**
+ *  \brief Destroy the hash table that indexes the nodes of the storage area.
+ */
+
+void freeNodeIndex (void)
+{
+  free (hTable);
+  hTable = NULL;
+  hashBits = hashMask = 0;
+  nIndexed = 0;
+  nodeIt = NULL;
+}
+
+/**
+ *  \brief Enlarge the hash table that indexes the nodes of the storage area.
+ *
+ *  The hash table is rebuilt with as many slots as \e initNodeIndex would create for the new number of nodes, the
+ *  nodes presently indexed being indexed again. Nothing is done if it has enough slots already.
+ *
+ *  \param nNodes new number of nodes of the storage area
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the hash table does not exist
+ *  \return -\c ENOMEM, if there is no memory to allocate the new hash table
+ */
+
+int growNodeIndex (uint32_t nNodes)
+{
+  SOBufferCacheNode **oldTable;                  /* hash table being replaced */
+  uint32_t oldMask, bits, i;                     /* its mask, new log2 of the number of slots and slot index */
+
+  if (hTable == NULL) return -EINVAL;
+  for (bits = 1; ((1UL << bits) < 2UL * nNodes) && (bits < 31); bits++);
+  if (bits <= hashBits) return 0;                /* it is large enough */
+
+  oldTable = hTable;
+  oldMask = hashMask;
+  if ((hTable = calloc ((size_t) 1 << bits, sizeof (SOBufferCacheNode *))) == NULL)
+     { hTable = oldTable;
+       return -ENOMEM;
+     }
+  hashBits = bits;
+  hashMask = (1U << bits) - 1;
+  nIndexed = 0;
+  for (i = 0; i <= oldMask; i++)
+    if (oldTable[i] != NULL)
+       hashInsert (oldTable[i]);
+  free (oldTable);
+
+  return 0;
+}
+
+/**
+ *  \brief Create the index of ghost entries.
+ *
+ *  The index holds the physical numbers of at most a given number of blocks, the oldest entry being replaced when it
+ *  is full. If it already exists, it is destroyed and created anew (empty).
+ *
+ *  \param nGhosts maximum number of entries
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>maximum number of entries</em> is zero
+ *  \return -\c ENOMEM, if there is no memory to allocate the index
+ */
+
+int initGhostIndex (uint32_t nGhosts)
+{
+  uint32_t i;                                    /* counting variable */
+
+  if (nGhosts == 0) return -EINVAL;
+  freeGhostIndex ();
+
+  for (ghostBits = 1; ((1UL << ghostBits) < (unsigned long) nGhosts) && (ghostBits < 31); ghostBits++);
+  ghostRing = malloc ((size_t) nGhosts * sizeof (uint32_t));
+  ghostLink = malloc ((size_t) nGhosts * sizeof (uint32_t));
+  ghostHead = malloc (((size_t) 1 << ghostBits) * sizeof (uint32_t));
+  if ((ghostRing == NULL) || (ghostLink == NULL) || (ghostHead == NULL))
+     { freeGhostIndex ();
+       return -ENOMEM;
+     }
+  for (i = 0; i < nGhosts; i++)
+    ghostRing[i] = NO_GHOST;
+  for (i = 0; i < (1U << ghostBits); i++)
+    ghostHead[i] = NO_GHOST;
+  nGhostRing = nGhosts;
+  ghostPos = 0;
+
+  return 0;
+}
+
+/**
+ *  \brief Destroy the index of ghost entries.
+ */
+
+void freeGhostIndex (void)
+{
+  free (ghostRing);
+  free (ghostLink);
+  free (ghostHead);
+  ghostRing = ghostLink = ghostHead = NULL;
+  nGhostRing = ghostBits = ghostPos = 0;
+}
+
+/**
+ *  \brief Add a ghost entry.
+ *
+ *  The oldest entry is replaced, if the index is full. Nothing is done if the index does not exist.
+ *
+ *  \param nBlock physical block number
+ */
+
+void addGhost (uint32_t nBlock)
+{
+  uint32_t h;                                    /* slot of the table */
+
+  if (ghostRing == NULL) return;
+
+  if (ghostRing[ghostPos] != NO_GHOST)           /* the oldest entry is replaced */
+     ghostUnlink (ghostPos);
+  h = ghostSlot (nBlock);
+  ghostRing[ghostPos] = nBlock;
+  ghostLink[ghostPos] = ghostHead[h];
+  ghostHead[h] = ghostPos;
+  ghostPos = (ghostPos + 1) % nGhostRing;
+}
+
+/**
+ *  \brief Take a ghost entry out of the index, if it is present.
+ *
+ *  \param nBlock physical block number
+ *
+ *  \return \c 1, if the entry was present, or <tt>0 (zero)</tt>, otherwise
+ */
+
+int takeGhost (uint32_t nBlock)
+{
+  uint32_t k;                                    /* entry of the ring */
+
+  if (ghostRing == NULL) return 0;
+
+  for (k = ghostHead[ghostSlot (nBlock)]; k != NO_GHOST; k = ghostLink[k])
+    if (ghostRing[k] == nBlock)
+       { ghostUnlink (k);
+         ghostRing[k] = NO_GHOST;
+         return 1;
+       }
+
+  return 0;
+}
+
+/**
+ *  \brief Access the first node of the double-linked list based on the physical block number of the storage device.
+ *
+ *  An iterator internal variable is set to the value of the argument and a pointer to the node pointed to by the
+ *  iterator variable is returned.
+ *
+ *  \param head pointer to the head of the linked list based on the physical block number of the storage device
+ *
+ *  \return value of the <em>iterator</em> variable
+ */
+
+SOBufferCacheNode *getFirstNodeOnN (SOBufferCacheNode *head)
+{
+  nodeIt = head;
+  return nodeIt;
+}
+
+/**
+ *  \brief Access the next node of the double-linked list based on the physical block number of the storage device.
+ *
+ *  The iterator internal variable is iterated if it does not already point to the last node of the linked list, and
+ *  a pointer to the node pointed to by the iterator variable is returned.
+ *
+ *  \return value of the <em>iterator</em> variable
+ */
+
+SOBufferCacheNode *getNextNodeOnN (void)
+{
+  if (nodeIt != NULL)
+     nodeIt = nodeIt->n_next;
+  return nodeIt;
+}
+
+/**
+ *  \brief Check if a given block, whose physical number is given, has already been stored in the storage area.
+ *
+ *  The block is looked up in the hash table indexed by physical block number. The head of the double-linked list
+ *  based on the physical block number is only used to check if the storage area is empty.
+ *
+ *  \param nBlock physical block number
+ *  \param head pointer to the head of the linked list based on the block number of the storage device
+ *
+ *  \return pointer to the node where the block contents is stored, or \c NULL if the block has not been stored yet
+ */
+
+SOBufferCacheNode *searchNodeOnN (uint32_t nBlock, SOBufferCacheNode *head)
+{
+  if ((head == NULL) || (hTable == NULL))
+     return NULL;                                /* the storage area is empty */
+
+  return hashLookup (nBlock);
+}
+
+/**
+ *  \brief Insert a node in the two double-linked lists infrastructure.
+ *
+ *  A node whose contents belongs to a block of the storage device, which is supposed not to be stored in the storage
+ *  area yet, is inserted in the two double-linked lists infrastructure and in the hash table. If the node is already
+ *  present or the storage area is inconsistent, nothing is done.
+ *
+ *  \param node pointer to the node to be inserted
+ *  \param p_nLHead pointer to a location where the pointer to the head of the double linked list based on the physical
+ *                  block number of the storage device, is stored
+ *  \param p_lATLHead pointer to a location where the pointer to the head of the double-linked list based on the last
+ *                    access time, is stored
+ *  \param p_lATLTail pointer to a location where the pointer to the tail of the double-linked list based on the last
+ *                    access time, is stored
+ */
+
+void insertNode (SOBufferCacheNode *node, SOBufferCacheNode **p_nLHead, SOBufferCacheNode **p_lATLHead,
+                 SOBufferCacheNode **p_lATLTail)
+{
+  SOBufferCacheNode *prev;                       /* node after which the new one is inserted on the n-list */
+  uint32_t k;                                    /* auxiliary variable */
+
+  if ((node == NULL) || (p_nLHead == NULL) || (p_lATLHead == NULL) || (p_lATLTail == NULL))
+     return;
+  if ((*p_nLHead == NULL) && (*p_lATLHead != NULL)) return;  /* the storage area is inconsistent */
+  if ((*p_lATLHead == NULL) != (*p_lATLTail == NULL)) return;
+
+  if (hTable == NULL) return;                    /* the hash table does not exist */
+  if (hashLookup (node->n) != NULL) return;      /* the block is already present */
+  if (nIndexed > hashMask / 2) return;           /* the hash table is full */
+
+  /* find the insertion point on the double-linked list based on the physical block number: the nearest preceding
+     blocks are first looked up in the hash table, which is the usual case for sequential access */
+
+  prev = NULL;
+  for (k = 1; (k <= PRED_WINDOW) && (k <= node->n); k++)
+    if ((prev = hashLookup (node->n - k)) != NULL) break;
+  if (prev == NULL)
+     { if ((*p_nLHead != NULL) && ((*p_nLHead)->n < node->n))
+          { prev = *p_nLHead;
+            while ((prev->n_next != NULL) && (prev->n_next->n < node->n))
+              prev = prev->n_next;
+          }
+     }
+    else while ((prev->n_next != NULL) && (prev->n_next->n < node->n))
+           prev = prev->n_next;
+
+  /* insertion on the double-linked list based on the physical block number */
+
+  node->n_prev = prev;
+  if (prev == NULL)
+     { node->n_next = *p_nLHead;
+       *p_nLHead = node;
+     }
+     else { node->n_next = prev->n_next;
+            prev->n_next = node;
+          }
+  if (node->n_next != NULL)
+     node->n_next->n_prev = node;
+
+  /* insertion at the head of the double-linked list based on the last access time */
+
+  node->access_prev = NULL;
+  node->access_next = *p_lATLHead;
+  if (*p_lATLHead != NULL)
+     (*p_lATLHead)->access_prev = node;
+     else *p_lATLTail = node;
+  *p_lATLHead = node;
+
+  hashInsert (node);
+}
+
+/**
+ *  \brief Retrieve a node from the two double-linked lists infrastructure.
+ *
+ *  The node which the tail of the double-linked list based on last access time points to, is retrieved from the two
+ *  double-linked lists infrastructure and from the hash table. If the storage area is inconsistent, nothing is done.
+ *
+ *  \param p_nLHead pointer to a location where the pointer to the head of the double linked list based on the physical
+ *                  block number of the storage device, is stored
+ *  \param p_lATLHead pointer to a location where the pointer to the head of the double-linked list based on the last
+ *                    access time, is stored
+ *  \param p_lATLTail pointer to a location where the pointer to the tail of the double-linked list based on the last
+ *                    access time, is stored
+ *
+ *  \return pointer to the retrieved node, or \c NULL if the storage area is empty or inconsistent
+ */
+
+SOBufferCacheNode *retrieveNode (SOBufferCacheNode **p_nLHead, SOBufferCacheNode **p_lATLHead,
+                                 SOBufferCacheNode **p_lATLTail)
+{
+  SOBufferCacheNode *node;                       /* node to be retrieved */
+
+  if ((p_nLHead == NULL) || (p_lATLHead == NULL) || (p_lATLTail == NULL))
+     return NULL;
+  if ((*p_nLHead == NULL) || (*p_lATLHead == NULL) || (*p_lATLTail == NULL))
+     return NULL;                                /* the storage area is empty or inconsistent */
+  if (hTable == NULL) return NULL;
+  node = *p_lATLTail;
+  if (hashLookup (node->n) != node) return NULL; /* the storage area is inconsistent */
+
+  removeNode (node, p_nLHead, p_lATLHead, p_lATLTail);
+
+  return node;
+}
+
+/**
+ *  \brief Remove a given node from the two double-linked lists infrastructure.
+ *
+ *  The node, which is supposed to be stored in the storage area, is removed from the two double-linked lists
+ *  infrastructure and from the hash table. If the node is not present or the storage area is inconsistent, nothing is
+ *  done.
+ *
+ *  \param node pointer to the node to be removed
+ *  \param p_nLHead pointer to a location where the pointer to the head of the double linked list based on the physical
+ *                  block number of the storage device, is stored
+ *  \param p_lATLHead pointer to a location where the pointer to the head of the double-linked list based on the last
+ *                    access time, is stored
+ *  \param p_lATLTail pointer to a location where the pointer to the tail of the double-linked list based on the last
+ *                    access time, is stored
+ */
+
+void removeNode (SOBufferCacheNode *node, SOBufferCacheNode **p_nLHead, SOBufferCacheNode **p_lATLHead,
+                 SOBufferCacheNode **p_lATLTail)
+{
+  if ((node == NULL) || (p_nLHead == NULL) || (p_lATLHead == NULL) || (p_lATLTail == NULL))
+     return;
+  if ((*p_nLHead == NULL) || (*p_lATLHead == NULL) || (*p_lATLTail == NULL))
+     return;                                     /* the storage area is empty or inconsistent */
+  if ((hTable == NULL) || (hashLookup (node->n) != node))
+     return;                                     /* the node is not present */
+
+  /* removal from the double-linked list based on the last access time */
+
+  if (node->access_prev != NULL)
+     node->access_prev->access_next = node->access_next;
+     else *p_lATLHead = node->access_next;
+  if (node->access_next != NULL)
+     node->access_next->access_prev = node->access_prev;
+     else *p_lATLTail = node->access_prev;
+
+  /* removal from the double-linked list based on the physical block number */
+
+  if (node->n_prev != NULL)
+     node->n_prev->n_next = node->n_next;
+     else *p_nLHead = node->n_next;
+  if (node->n_next != NULL)
+     node->n_next->n_prev = node->n_prev;
+
+  hashRemove (node);
+
+  node->n_prev = node->n_next = NULL;
+  node->access_prev = node->access_next = NULL;
+}
+
+/**
+ *  \brief Move the node to the head of the double-linked list based on last access time.
+ *
+ *  The node which is supposed to have been accessed, is retrieved from its location in the double-linked list based on
+ *  the last access time and placed at the head of the list. If the node pointer is \c NULL or the storage area is
+ *  inconsistent, nothing is done.
+ *
+ *  \param node pointer to the node to be inserted
+ *  \param p_lATLHead pointer to a location where the pointer to the head of the double-linked list based on the last
+ *                    access time, is stored
+ *  \param p_lATLTail pointer to a location where the pointer to the tail of the double-linked list based on the last
+ *                    access time, is stored
+ */
+
+void moveNodeAtHeadLAT (SOBufferCacheNode *node, SOBufferCacheNode **p_lATLHead, SOBufferCacheNode **p_lATLTail)
+{
+  if ((node == NULL) || (p_lATLHead == NULL) || (p_lATLTail == NULL))
+     return;
+  if ((*p_lATLHead == NULL) || (*p_lATLTail == NULL))
+     return;                                     /* the storage area is inconsistent */
+  if (node == *p_lATLHead) return;               /* nothing to be done */
+
+  /* removal from its present location */
+
+  node->access_prev->access_next = node->access_next;
+  if (node->access_next != NULL)
+     node->access_next->access_prev = node->access_prev;
+     else *p_lATLTail = node->access_prev;
+
+  /* insertion at the head */
+
+  node->access_prev = NULL;
+  node->access_next = *p_lATLHead;
+  (*p_lATLHead)->access_prev = node;
+  *p_lATLHead = node;
+}
+
+/*
+ *  Internal functions
+ */
+
+/*
+ *  Home slot of a physical block number in the hash table (multiplicative hashing).
+ */
+
+static uint32_t hashSlot (uint32_t nBlock)
+{
+  return (uint32_t) (nBlock * 2654435761U) >> (32 - hashBits);
+}
+
+/*
+ *  Look up a physical block number in the hash table.
+ */
+
+static SOBufferCacheNode *hashLookup (uint32_t nBlock)
+{
+  uint32_t i;                                    /* slot index */
+
+  for (i = hashSlot (nBlock); hTable[i] != NULL; i = (i + 1) & hashMask)
+    if (hTable[i]->n == nBlock) return hTable[i];
+
+  return NULL;
+}
+
+/*
+ *  Index a node in the hash table (the block is supposed not to be present).
+ */
+
+static void hashInsert (SOBufferCacheNode *node)
+{
+  uint32_t i;                                    /* slot index */
+
+  for (i = hashSlot (node->n); hTable[i] != NULL; i = (i + 1) & hashMask);
+  hTable[i] = node;
+  nIndexed += 1;
+}
+
+/*
+ *  Remove a node from the hash table: the following entries of the probing sequence are shifted back so that no
+ *  tombstones are required.
+ */
+
+static void hashRemove (SOBufferCacheNode *node)
+{
+  uint32_t i, j, h;                              /* slot indexes */
+
+  for (i = hashSlot (node->n); hTable[i] != node; i = (i + 1) & hashMask)
+    if (hTable[i] == NULL) return;               /* not indexed */
+
+  hTable[i] = NULL;
+  nIndexed -= 1;
+  for (j = (i + 1) & hashMask; hTable[j] != NULL; j = (j + 1) & hashMask)
+  { h = hashSlot (hTable[j]->n);
+    /* the entry at slot j may fill the hole at slot i only if its home slot is not cyclically in ]i, j] */
+    if (((j > i) && ((h <= i) || (h > j))) || ((j < i) && ((h <= i) && (h > j))))
+       { hTable[i] = hTable[j];
+         hTable[j] = NULL;
+         i = j;
+       }
+  }
+}
+
+/*
+ *  Slot of a physical block number in the table of ghost entries (multiplicative hashing).
+ */
+
+static uint32_t ghostSlot (uint32_t nBlock)
+{
+  return (uint32_t) (nBlock * 2654435761U) >> (32 - ghostBits);
+}
+
+/*
+ *  Remove an entry of the ring from the chain of its slot.
+ */
+
+static void ghostUnlink (uint32_t k)
+{
+  uint32_t *p_k;                                 /* pointer to the link to the entry */
+
+  for (p_k = &ghostHead[ghostSlot (ghostRing[k])]; *p_k != NO_GHOST; p_k = &ghostLink[*p_k])
+    if (*p_k == k)
+       { *p_k = ghostLink[k];
+         return;
+       }
+}
@@ -9,12 +9,22 @@
  *  One should notice that this module does not stand alone: it supposes a very tight coupling with the buffercache
  *  implementation, its only application.
  *
+ *  The nodes are, furthermore, indexed by physical block number in a hash table, so that checking if a given block is
+ *  stored in the storage area takes constant time. The physical numbers of the blocks whose nodes were replaced
+ *  recently may be kept, besides, in a bounded index of ghost entries, which the scan-resistant replacement policy
+ *  relies on.
+ *
  *  The following operations are defined:
+ *    \li create the hash table that indexes the nodes of the storage area
+ *    \li destroy the hash table that indexes the nodes of the storage area
+ *    \li enlarge the hash table that indexes the nodes of the storage area
+ *    \li create, destroy, add to and take from the index of ghost entries
  *    \li access the first node of the double-linked list based on the physical block number of the storage device
  *    \li access the next node of the double-linked list based on the physical block number of the storage device
  *    \li check if a given block, whose physical number is given, has already been stored in the storage area
  *    \li insert a node in the two double-linked lists infrastructure
  *    \li retrieve a node from the two double-linked lists infrastructure
+ *    \li remove a given node from the two double-linked lists infrastructure
  *    \li move a node already present in the storage area to the head of the double-linked list based on the last access
  *        time.
  *
@@ -28,6 +38,84 @@
 
 #include "sofs_buffercachenode.h"
 
+/**
+ *  \brief Create the hash table that indexes the nodes of the storage area.
+ *
+ *  The number of slots is the smallest power of two which is at least twice the number of nodes, so that the load
+ *  factor never exceeds 1/2.
+ *
+ *  \param nNodes number of nodes of the storage area
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>number of nodes</em> is zero
+ *  \return -\c EBUSY, if the hash table already exists
+ *  \return -\c ENOMEM, if there is no memory to allocate the hash table
+ */
+
+extern int initNodeIndex (uint32_t nNodes);
+
+/**
+ *  \brief Destroy the hash table that indexes the nodes of the storage area.
+ */
+
+extern void freeNodeIndex (void);
+
+/**
+ *  \brief Enlarge the hash table that indexes the nodes of the storage area.
+ *
+ *  The hash table is rebuilt with as many slots as \e initNodeIndex would create for the new number of nodes, the
+ *  nodes presently indexed being indexed again. Nothing is done if it has enough slots already.
+ *
+ *  \param nNodes new number of nodes of the storage area
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the hash table does not exist
+ *  \return -\c ENOMEM, if there is no memory to allocate the new hash table
+ */
+
+extern int growNodeIndex (uint32_t nNodes);
+
+/**
+ *  \brief Create the index of ghost entries.
+ *
+ *  The index holds the physical numbers of at most a given number of blocks, the oldest entry being replaced when it
+ *  is full. If it already exists, it is destroyed and created anew (empty).
+ *
+ *  \param nGhosts maximum number of entries
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>maximum number of entries</em> is zero
+ *  \return -\c ENOMEM, if there is no memory to allocate the index
+ */
+
+extern int initGhostIndex (uint32_t nGhosts);
+
+/**
+ *  \brief Destroy the index of ghost entries.
+ */
+
+extern void freeGhostIndex (void);
+
+/**
+ *  \brief Add a ghost entry.
+ *
+ *  The oldest entry is replaced, if the index is full. Nothing is done if the index does not exist.
+ *
+ *  \param nBlock physical block number
+ */
+
+extern void addGhost (uint32_t nBlock);
+
+/**
+ *  \brief Take a ghost entry out of the index, if it is present.
+ *
+ *  \param nBlock physical block number
+ *
+ *  \return \c 1, if the entry was present, or <tt>0 (zero)</tt>, otherwise
+ */
+
+extern int takeGhost (uint32_t nBlock);
+
 /**
  *  \brief Access the first node of the double-linked list based on the physical block number of the storage device.
  *
@@ -55,9 +143,8 @@ extern SOBufferCacheNode *getNextNodeOnN (void);
 /**
  *  \brief Check if a given block, whose physical number is given, has already been stored in the storage area.
  *
- *  The double-linked list based on the physical block number of the storage device is traversed from the node pointed
- *  to by the second argument to find out if there is a node whose contents belongs to the block whose physical number
- *  is passed as the first argument.
+ *  The block is looked up in the hash table indexed by physical block number. The head of the double-linked list based
+ *  on the physical block number of the storage device is only used to check if the storage area is empty.
  *
  *  \param nBlock physical block number
  *  \param head pointer to the head of the linked list based on the block number of the storage device
@@ -105,6 +192,25 @@ extern void insertNode (SOBufferCacheNode *node, SOBufferCacheNode **p_nLHead, S
 extern SOBufferCacheNode *retrieveNode (SOBufferCacheNode **p_nLHead, SOBufferCacheNode **p_lATLHead,
                                         SOBufferCacheNode **p_lATLTail);
 
+/**
+ *  \brief Remove a given node from the two double-linked lists infrastructure.
+ *
+ *  The node, which is supposed to be stored in the storage area, is removed from the two double-linked lists
+ *  infrastructure and from the hash table. If the node is not present or the storage area is inconsistent, nothing is
+ *  done.
+ *
+ *  \param node pointer to the node to be removed
+ *  \param p_nLHead pointer to a location where the pointer to the head of the double linked list based on the physical
+ *                  block number of the storage device, is stored
+ *  \param p_lATLHead pointer to a location where the pointer to the head of the double-linked list based on the last
+ *                    access time, is stored
+ *  \param p_lATLTail pointer to a location where the pointer to the tail of the double-linked list based on the last
+ *                    access time, is stored
+ */
+
+extern void removeNode (SOBufferCacheNode *node, SOBufferCacheNode **p_nLHead, SOBufferCacheNode **p_lATLHead,
+                        SOBufferCacheNode **p_lATLTail);
+
 /**
  *  \brief Move the node to the head of the double-linked list based on last access time.
  *
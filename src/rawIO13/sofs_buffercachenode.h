@@ -19,23 +19,44 @@
  *  The buffercache is conceived as two double-linked lists: the first, based on the block number of the storage device
  *  it is referencing; the second, based on the order of last access to the block.
  *  So, besides the pointers which are required to implement this dynamic structure, each node contains:
- *    \li a buffer area to store locally the contents of the referenced block
- *    \li the physical block number
+ *    \li a pointer to the buffer area where the contents of the referenced block is locally stored (the buffer areas of
+ *        all nodes are packed in a separate page-aligned region, so that the node metadata is kept compact)
+ *    \li the physical block number and the number of blocks it stores (either one block, or a whole cluster)
  *    \li a status flag which signals whether the block contents is, or is not, synchronized with the contents of the
- *        corresponding block in the storage device.
+ *        corresponding block in the storage device
+ *    \li a reference count of pinned accesses to the buffer area
+ *    \li the write-back state and the time when the contents first became different from the storage device
+ *    \li the queue of the replacement policy it belongs to and whether it has priority on being kept.
  */
 
 typedef struct soBufferCacheNode
 {
-   /** \brief contents of the data block */
-    unsigned char buffer[BLOCK_SIZE];
-   /** \brief physical block number */
+   /** \brief pointer to the contents of the data block */
+    unsigned char *buffer;
+   /** \brief physical number of the (first) data block */
     uint32_t n;
+   /** \brief number of data blocks stored in the node: 1, for a block node, or \c BLOCKS_PER_CLUSTER, for a cluster
+    *         node */
+    uint32_t nblks;
    /** \brief status of the data block
     *  \li <em>same</em> - the contents is the same as the corresponding block in the storage device
     *  \li <em>changed</em> - the contents is potentially different
     */
     uint32_t stat;
+   /** \brief number of references to the buffer area presently held through the pinned access operations (a pinned
+    *         node is never selected for replacement) */
+    uint32_t pin;
+   /** \brief signals if the contents is presently being written back by the flusher (the node is never selected for
+    *         replacement meanwhile) */
+    uint32_t wback;
+   /** \brief time (in seconds) when the status of the data block changed from <em>same</em> to <em>changed</em> */
+    uint32_t dtime;
+   /** \brief queue of the replacement policy the node belongs to: <em>main</em>, the list based on the last access
+    *         time, or <em>first-access</em>, the queue of the nodes accessed only once recently */
+    uint32_t queue;
+   /** \brief signals if the node stores a block of a region with priority, which is only selected for replacement
+    *         when no other node may be */
+    uint32_t prio;
 
    /** \brief double-linked list based on block number:
     *         pointer to previous node */
@@ -58,4 +79,9 @@ typedef struct soBufferCacheNode
  *         storage device */
 #define CHANGED 1
 
+/** \brief the node belongs to the main queue of the replacement policy */
+#define MAIN_Q   0
+/** \brief the node belongs to the first-access queue of the replacement policy */
+#define FIRST_Q  1
+
 #endif /* SOFS_BUFFERCACHENODE_H_ */
@@ -0,0 +1,425 @@
+/**
+ *  \file sofs_cachebudget.c (implementation file)
+ *
+ *  \brief A budget of memory for the buffercaches shared by the volumes mounted on a host.
+ *
+ *  The table holds a header, with the budget, and an entry for each volume, with the identification of its process,
+ *  the time when it was last updated, a decaying average of the number of accesses its buffercache received in each
+ *  period and the capacity it took. The balancer reads the statistics of the buffercache without the write lock on the
+ *  file, which is only held while the table is updated, and resizes the buffercache after releasing it, since that may
+ *  take writing back changed nodes.
+ *
+ *  The following operations are defined:
+ *    \li join a budget and start the balancer
+ *    \li stop the balancer and leave the budget.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "sofs_probe.h"
+#include "sofs_const.h"
+#include "sofs_buffercache.h"
+#include "sofs_cachebudget.h"
+
+/*
+ *  Internal data structure
+ */
+
+/** \brief magic number of the header of the table */
+#define BUDGET_MAGIC    (0x534F4342)
+/** \brief version of the layout of the table */
+#define BUDGET_VERSION  1
+/** \brief fraction of the capacity of the buffercache by which its share must exceed it for it to be enlarged */
+#define BUDGET_SLACK    16
+
+/** \brief entry of a volume */
+typedef struct soBudgetSlot
+{
+  /** \brief identification of the process which serves the volume (zero, if the entry is free) */
+  int32_t pid;
+  /** \brief number of data blocks of the buffercache, as last given by the balancer */
+  uint32_t capacity;
+  /** \brief decaying average of the number of accesses to the buffercache in each period */
+  uint64_t demand;
+  /** \brief time when the entry was last updated, in seconds since the Epoch */
+  uint64_t stamp;
+} SOBudgetSlot;
+
+/** \brief table shared by the volumes */
+typedef struct soBudgetTable
+{
+  /** \brief magic number (should be BUDGET_MAGIC macro value) */
+  uint32_t magic;
+  /** \brief version of the layout (should be BUDGET_VERSION macro value) */
+  uint32_t version;
+  /** \brief number of data blocks of the budget */
+  uint32_t budget;
+  /** \brief reserved area */
+  uint32_t reserved;
+  /** \brief entries of the volumes */
+  SOBudgetSlot slot[BUDGET_SLOTS];
+} SOBudgetTable;
+
+/** \brief access lock to the state of the balancer */
+static pthread_mutex_t budgetCR = PTHREAD_MUTEX_INITIALIZER;
+/** \brief condition the balancer waits on until it is due */
+static pthread_cond_t budgetWakeUp = PTHREAD_COND_INITIALIZER;
+/** \brief balancer thread */
+static pthread_t budgetThread;
+/** \brief signals if the balancer is running */
+static bool budgetRunning = false;
+/** \brief signals if the balancer is to stop */
+static bool budgetStop = false;
+/** \brief file descriptor of the file where the table is kept */
+static int budgetFd = -1;
+/** \brief table, mapped into memory */
+static SOBudgetTable *table = NULL;
+/** \brief index of the entry of the volume */
+static uint32_t mySlot = BUDGET_SLOTS;
+/** \brief identification of the process */
+static int32_t myPid = 0;
+/** \brief number of accesses to the buffercache at the last activation of the balancer */
+static uint64_t lastAccesses = 0;
+
+/* Allusion to internal functions */
+
+static void *balancer (void *arg);
+static void balanceStep (void);
+static int openTable (const char *name, uint32_t nBlocks);
+static void closeTable (void);
+static int lockTable (short type);
+static int takeSlot (uint64_t t);
+static bool isLive (uint32_t n, uint64_t t);
+static uint32_t shareOf (uint32_t n, uint64_t t);
+static uint64_t countAccesses (SOBufferCacheStats *p_stats);
+
+/**
+ *  \brief Join a budget and start the balancer.
+ *
+ *  \param name path to the file where the table is kept
+ *  \param nBlocks number of data blocks of the budget
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the pointer is \c NULL or the <em>number of data blocks</em> is smaller than
+ *          \c BLOCKS_PER_CLUSTER
+ *  \return -\c EBUSY, if the budget was already joined
+ *  \return -\c EILSEQ, if the file does not hold a table of this version
+ *  \return -\c ENOSPC, if \c BUDGET_SLOTS volumes already share the budget
+ *  \return -<em>other specific error</em> issued by \e open, \e fcntl, \e ftruncate, \e mmap or \e pthread_create
+ */
+
+int soJoinCacheBudget (const char *name, uint32_t nBlocks)
+{
+  soColorProbe (838, "07;31", "soJoinCacheBudget (\"%s\", %"PRIu32")\n", (name != NULL) ? name : "(null)", nBlocks);
+
+  SOBufferCacheStats st;                         /* statistics of the buffercache */
+  int stat;                                      /* status of operation */
+
+  if ((name == NULL) || (nBlocks < BLOCKS_PER_CLUSTER)) return -EINVAL;
+
+  pthread_mutex_lock (&budgetCR);
+  if (budgetRunning)
+     { pthread_mutex_unlock (&budgetCR);
+       return -EBUSY;
+     }
+  myPid = (int32_t) getpid ();
+  soGetBufferCacheStats (&st);
+  lastAccesses = countAccesses (&st);
+  if ((stat = openTable (name, nBlocks)) != 0)
+     { closeTable ();
+       pthread_mutex_unlock (&budgetCR);
+       return stat;
+     }
+  balanceStep ();                                /* the buffercache is given its share straight away */
+  budgetStop = false;
+  if ((stat = pthread_create (&budgetThread, NULL, balancer, NULL)) != 0)
+     { if (lockTable (F_WRLCK) == 0)
+          { table->slot[mySlot].pid = 0;
+            lockTable (F_UNLCK);
+          }
+       closeTable ();
+     }
+     else budgetRunning = true;
+  pthread_mutex_unlock (&budgetCR);
+
+  return -stat;
+}
+
+/**
+ *  \brief Stop the balancer and leave the budget.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -<em>other specific error</em> issued by \e fcntl
+ */
+
+int soLeaveCacheBudget (void)
+{
+  soColorProbe (839, "07;31", "soLeaveCacheBudget ()\n");
+
+  int stat;                                      /* status of operation */
+
+  pthread_mutex_lock (&budgetCR);
+  if (!budgetRunning)
+     { pthread_mutex_unlock (&budgetCR);
+       return 0;
+     }
+  budgetStop = true;
+  pthread_cond_signal (&budgetWakeUp);
+  pthread_mutex_unlock (&budgetCR);
+  pthread_join (budgetThread, NULL);
+
+  pthread_mutex_lock (&budgetCR);
+  if ((stat = lockTable (F_WRLCK)) == 0)
+     { if (table->slot[mySlot].pid == myPid)     /* unless it was reclaimed meanwhile */
+          table->slot[mySlot].pid = 0;
+       stat = lockTable (F_UNLCK);
+     }
+  closeTable ();
+  budgetRunning = false;
+  pthread_mutex_unlock (&budgetCR);
+
+  return stat;
+}
+
+/*
+ *  Internal functions
+ */
+
+/*
+ *  Balancer thread: it is activated periodically and gives the buffercache its share of the budget. An error is left
+ *  to be tried again on the next activation.
+ */
+
+static void *balancer (void *arg __attribute__ ((unused)))
+{
+  struct timespec ts;                            /* time limit for the wait */
+
+  pthread_mutex_lock (&budgetCR);
+  while (!budgetStop)
+  { clock_gettime (CLOCK_REALTIME, &ts);
+    ts.tv_sec += BUDGET_PERIOD;
+    pthread_cond_timedwait (&budgetWakeUp, &budgetCR, &ts);
+    if (budgetStop) break;
+    pthread_mutex_unlock (&budgetCR);
+    balanceStep ();
+    pthread_mutex_lock (&budgetCR);
+  }
+  pthread_mutex_unlock (&budgetCR);
+
+  return NULL;
+}
+
+/*
+ *  Update the entry of the volume with the accesses to the buffercache since the last activation and resize it to its
+ *  share: it is shrunk as soon as its share is smaller, so that the budget is kept, but only enlarged when its share
+ *  exceeds its capacity by a fraction of it, so that it is not resized for every small change of the accesses.
+ */
+
+static void balanceStep (void)
+{
+  SOBufferCacheStats st;                         /* statistics of the buffercache */
+  SOBudgetSlot *p;                               /* entry of the volume */
+  uint64_t accesses, delta, t;                   /* accesses to the buffercache, since last time, and current time */
+  uint32_t share;                                /* share of the budget */
+
+  if (soGetBufferCacheStats (&st) != 0) return;
+  accesses = countAccesses (&st);
+  delta = (accesses >= lastAccesses) ? accesses - lastAccesses : accesses;   /* the statistics were reset meanwhile */
+  lastAccesses = accesses;
+  t = (uint64_t) time (NULL);
+
+  if (lockTable (F_WRLCK) != 0) return;
+  if ((table->slot[mySlot].pid != myPid) && (takeSlot (t) != 0))             /* it was reclaimed meanwhile */
+     { lockTable (F_UNLCK);
+       return;
+     }
+  p = &table->slot[mySlot];
+  p->demand = (p->demand + delta) / 2;
+  p->stamp = t;
+  share = shareOf (mySlot, t);
+  p->capacity = share;
+  lockTable (F_UNLCK);
+
+  if ((share < st.capacity) || (share - st.capacity >= st.capacity / BUDGET_SLACK))
+     soSetBufferCacheCapacity (share);           /* if it is not shrunk that much, it is tried again next time */
+}
+
+/*
+ *  Open the file where the table is kept, creating it, if it does not exist, map it into memory and take an entry for
+ *  the volume, the entries of the volumes which are gone being reclaimed first. If no other volume shares the budget,
+ *  it is set.
+ */
+
+static int openTable (const char *name, uint32_t nBlocks)
+{
+  struct stat st;                                /* attributes of the file */
+  void *p;                                       /* pointer to the mapping */
+  uint64_t t;                                    /* current time */
+  uint32_t i;                                    /* counting variable */
+  bool alone;                                    /* signals if no other volume shares the budget */
+  int stat, err;                                 /* status of operation */
+
+  if ((budgetFd = open (name, O_RDWR | O_CREAT, 0666)) < 0) return -errno;
+  if ((stat = lockTable (F_WRLCK)) != 0) return stat;
+  if (fstat (budgetFd, &st) != 0)
+     stat = -errno;
+     else if ((st.st_size < (off_t) sizeof (SOBudgetTable)) && (ftruncate (budgetFd, sizeof (SOBudgetTable)) != 0))
+             stat = -errno;
+     else if ((p = mmap (NULL, sizeof (SOBudgetTable), PROT_READ | PROT_WRITE, MAP_SHARED, budgetFd, 0)) == MAP_FAILED)
+             stat = -errno;
+     else table = (SOBudgetTable *) p;
+
+  if (stat == 0)
+     { if (table->magic == 0)                    /* the file was just created */
+          { memset (table, 0, sizeof (SOBudgetTable));
+            table->magic = BUDGET_MAGIC;
+            table->version = BUDGET_VERSION;
+          }
+       if ((table->magic != BUDGET_MAGIC) || (table->version != BUDGET_VERSION))
+          stat = -EILSEQ;
+     }
+  if (stat == 0)
+     { t = (uint64_t) time (NULL);
+       alone = true;
+       for (i = 0; i < BUDGET_SLOTS; i++)
+         if (isLive (i, t))
+            alone = false;
+            else table->slot[i].pid = 0;
+       if (alone) table->budget = nBlocks;
+       stat = takeSlot (t);
+     }
+  if (((err = lockTable (F_UNLCK)) != 0) && (stat == 0))
+     stat = err;
+
+  return stat;
+}
+
+/*
+ *  Unmap the table and close the file where it is kept.
+ */
+
+static void closeTable (void)
+{
+  if (table != NULL)
+     munmap (table, sizeof (SOBudgetTable));
+  if (budgetFd >= 0)
+     close (budgetFd);
+  table = NULL;
+  budgetFd = -1;
+  mySlot = BUDGET_SLOTS;
+}
+
+/*
+ *  Take (F_WRLCK) or release (F_UNLCK) the write lock on the file where the table is kept.
+ */
+
+static int lockTable (short type)
+{
+  struct flock fl;                               /* description of the lock */
+
+  fl.l_type = type;
+  fl.l_whence = SEEK_SET;
+  fl.l_start = 0;
+  fl.l_len = 0;                                  /* the whole file */
+  while (fcntl (budgetFd, F_SETLKW, &fl) != 0)
+    if (errno != EINTR) return -errno;
+
+  return 0;
+}
+
+/*
+ *  Take a free entry for the volume (the caller holds the write lock).
+ */
+
+static int takeSlot (uint64_t t)
+{
+  SOBufferCacheStats st;                         /* statistics of the buffercache */
+  uint32_t i;                                    /* counting variable */
+
+  for (i = 0; i < BUDGET_SLOTS; i++)
+    if ((table->slot[i].pid == 0) || !isLive (i, t)) break;
+  if (i == BUDGET_SLOTS) return -ENOSPC;
+
+  soGetBufferCacheStats (&st);
+  table->slot[i].pid = myPid;
+  table->slot[i].capacity = st.capacity;
+  table->slot[i].demand = 0;
+  table->slot[i].stamp = t;
+  mySlot = i;
+
+  return 0;
+}
+
+/*
+ *  Check if an entry belongs to a volume which still shares the budget: its process exists and it was updated
+ *  recently.
+ */
+
+static bool isLive (uint32_t n, uint64_t t)
+{
+  const SOBudgetSlot *p = &table->slot[n];       /* entry */
+
+  if (p->pid <= 0) return false;
+  if (p->stamp + (uint64_t) BUDGET_STALE * BUDGET_PERIOD < t) return false;
+  if (p->pid == myPid) return (n == mySlot);     /* a stale entry of the process itself */
+
+  return (kill ((pid_t) p->pid, 0) == 0) || (errno != ESRCH);
+}
+
+/*
+ *  Share of the budget of a volume (the caller holds the write lock): a floor, and a part of the remainder of the
+ *  budget proportional to its accesses, or an equal part, if no volume was accessed. The entries of the volumes which
+ *  are gone are reclaimed on the way.
+ */
+
+static uint32_t shareOf (uint32_t n, uint64_t t)
+{
+  uint64_t total;                                /* accesses of all volumes */
+  uint32_t nLive, floor, rest, share, i;         /* number of volumes, floor, remainder, share and counting variable */
+
+  nLive = 0;
+  total = 0;
+  for (i = 0; i < BUDGET_SLOTS; i++)
+    if ((i == n) || isLive (i, t))
+       { nLive += 1;
+         total += table->slot[i].demand;
+       }
+       else table->slot[i].pid = 0;
+
+  if ((floor = table->budget / nLive) > K_DEFAULT)
+     floor = K_DEFAULT;
+  rest = table->budget - floor * nLive;
+  if (total != 0)
+     share = floor + (uint32_t) ((double) rest * (double) table->slot[n].demand / (double) total);
+     else share = floor + rest / nLive;
+  share -= share % BLOCKS_PER_CLUSTER;
+
+  return (share < BLOCKS_PER_CLUSTER) ? BLOCKS_PER_CLUSTER : share;
+}
+
+/*
+ *  Number of accesses to the buffercache, found in the storage area or not.
+ */
+
+static uint64_t countAccesses (SOBufferCacheStats *p_stats)
+{
+  uint64_t n;                                    /* number of accesses */
+  uint32_t r;                                    /* region */
+
+  for (r = 0, n = 0; r < BC_REGIONS; r++)
+    n += p_stats->hits[r] + p_stats->misses[r];
+
+  return n;
+}
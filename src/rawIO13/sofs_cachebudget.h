@@ -0,0 +1,74 @@
+/**
+ *  \file sofs_cachebudget.h (interface file)
+ *
+ *  \brief A budget of memory for the buffercaches shared by the volumes mounted on a host.
+ *
+ *  Each volume is served by a process of its own, whose buffercache would otherwise have a fixed capacity, even while
+ *  the volume is idle. The volumes which join the same budget share a table, kept in a file mapped into the memory of
+ *  each of them, where every one of them records how many accesses its buffercache received recently and which
+ *  capacity it took.
+ *  A balancer thread periodically updates the entry of its volume and gives its buffercache a fair share of the budget:
+ *  every volume is granted a floor (\c K_DEFAULT data blocks, or an equal split of the budget, if smaller) and the
+ *  remainder is divided in proportion to the recent accesses of each volume, so that the idle volumes shrink down to
+ *  the floor, the memory pages they give up being returned to the system, and the busy ones grow. Each volume only
+ *  resizes its own buffercache, so the capacities add up to the budget only once all of them have taken their turn.
+ *
+ *  The table is updated holding a write lock on the file, which is released by the system should the process
+ *  terminate. The entries of the processes which are gone, or which did not update them for \c BUDGET_STALE periods,
+ *  are reclaimed.
+ *
+ *  The following operations are defined:
+ *    \li join a budget and start the balancer
+ *    \li stop the balancer and leave the budget.
+ *
+ *  \remarks In case an error occurs, all functions return a negative value which is the symmetric of the system error
+ *           that better represents the error cause.
+ *           (execute command <em>man errno</em> to get the list of system errors)
+ */
+
+#ifndef SOFS_CACHEBUDGET_H_
+#define SOFS_CACHEBUDGET_H_
+
+#include <stdint.h>
+
+/** \brief maximum number of volumes sharing a budget */
+#define BUDGET_SLOTS   256
+/** \brief period (in seconds) of activation of the balancer */
+#define BUDGET_PERIOD  2
+/** \brief number of periods after which the entry of a volume which was not updated is reclaimed */
+#define BUDGET_STALE   30
+
+/**
+ *  \brief Join a budget and start the balancer.
+ *
+ *  The file where the table is kept is created, if it does not exist. The budget is set by the volume which joins it
+ *  while no other volume shares it; the ones which join it later take it as it is. The buffercache is given its share
+ *  straight away.
+ *
+ *  \param name path to the file where the table is kept
+ *  \param nBlocks number of data blocks of the budget
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the pointer is \c NULL or the <em>number of data blocks</em> is smaller than
+ *          \c BLOCKS_PER_CLUSTER
+ *  \return -\c EBUSY, if the budget was already joined
+ *  \return -\c EILSEQ, if the file does not hold a table of this version
+ *  \return -\c ENOSPC, if \c BUDGET_SLOTS volumes already share the budget
+ *  \return -<em>other specific error</em> issued by \e open, \e fcntl, \e ftruncate, \e mmap or \e pthread_create
+ */
+
+extern int soJoinCacheBudget (const char *name, uint32_t nBlocks);
+
+/**
+ *  \brief Stop the balancer and leave the budget.
+ *
+ *  The entry of the volume is released, so that the other volumes share the budget at their next activation. The
+ *  capacity of the buffercache is left as it is. Nothing is done if the budget was not joined.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -<em>other specific error</em> issued by \e fcntl
+ */
+
+extern int soLeaveCacheBudget (void);
+
+#endif /* SOFS_CACHEBUDGET_H_ */
@@ -19,8 +19,20 @@
 /** \brief block size (in bits) */
 #define BITS_PER_BLOCK (8 * BLOCK_SIZE)
 
-/** \brief number of contiguous blocks in a cluster */
+/** \brief number of contiguous blocks in a cluster
+ *
+ *  It may be set at build time (<tt>-DBLOCKS_PER_CLUSTER=n</tt>, with \e n a power of two from 4 to 128, so that
+ *  clusters are 2, 4, 8, 16, 32 or 64 KiB long): the file system can then only be installed and mounted with clusters
+ *  of that size, which is recorded in the superblock, every operation keeping compile-time constant arithmetic.
+ *  The prebuilt libraries (system calls and quick consistency checks) only support the default, so the tools which
+ *  call the system calls (mount_sofs13 and replay_sofs13) may only be built with it.
+ */
+#ifndef BLOCKS_PER_CLUSTER
 #define BLOCKS_PER_CLUSTER (4)
+#endif
+
+_Static_assert ((BLOCKS_PER_CLUSTER >= 4) && (BLOCKS_PER_CLUSTER <= 128) &&
+                ((BLOCKS_PER_CLUSTER & (BLOCKS_PER_CLUSTER - 1)) == 0), "unsupported number of blocks per cluster");
 
 /** \brief cluster size (in bytes) */
 #define CLUSTER_SIZE (BLOCKS_PER_CLUSTER * BLOCK_SIZE)
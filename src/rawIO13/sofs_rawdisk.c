@@ -3,14 +3,29 @@
  *
  *  \brief Access to raw disk blocks and clusters.
  *
- *  The storage device is presently a Linux file which simulates a magnetic disk.
+ *  The storage device is presently a Linux file which simulates a magnetic disk, or a Linux block device.
  *  The following operations are defined:
  *    \li open a communication channel with the storage device
  *    \li close the communication channel previously established
  *    \li read a block of data from the storage device
  *    \li write a block of data to the storage device
  *    \li read a cluster of data from the storage device
- *    \li write a cluster of data to the storage device.
+ *    \li write a cluster of data to the storage device
+ *    \li read a run of successive blocks of data from the storage device into a vector of buffers
+ *    \li write a run of successive blocks of data from a vector of buffers to the storage device
+ *    \li select the mechanism used to carry out the transfers
+ *    \li carry out a batch of transfers of runs of successive blocks
+ *    \li get direct access to a run of successive blocks of data, when the storage device is memory-mapped
+ *    \li synchronize a run of successive blocks of data with the supporting file, when the storage device is
+ *        memory-mapped
+ *    \li fill a run of successive blocks of the storage device with zeros
+ *    \li discard a run of successive blocks of the storage device.
+ *
+ *  Each transfer is carried out by a single positioned system call, whenever possible. Batches of transfers may,
+ *  furthermore, be carried out asynchronously through the Linux io_uring interface, so that the storage device is kept
+ *  busy with several requests at a time.
+ *  Alternatively, the supporting file may be mapped into memory, the transfers being carried out by plain copies from
+ *  and to the mapping, which may also be accessed directly.
  *
  *  \author Artur Carneiro Pereira - September 2007
  *  \author Miguel Oliveira e Silva - September 2009
@@ -18,15 +33,33 @@
  */
 
 #include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#undef BLOCK_SIZE                                  /* the kernel block size is not the one of the storage device */
 #include <unistd.h>
 #include <inttypes.h>
 #include <stdio.h>
+#include <string.h>
 #include <errno.h>
 #define __USE_GNU
 #include <fcntl.h>
 
 #include "sofs_const.h"
 #include "sofs_probe.h"
+#include "sofs_stats.h"
+#include "sofs_rawdisk.h"
+#include "sofs_rawuring.h"
+
+/** \brief maximum number of buffers transferred by each vectored system call */
+#define RAW_IOV_MAX  64
+
+/* Allusion to internal functions */
+
+static int checkRun (uint32_t n, uint32_t count, const struct iovec *iov);
+static int rawTransfer (int wr, uint32_t n, uint32_t count, const struct iovec *iov);
+static uint64_t runSize (uint32_t count, const struct iovec *iov);
 
 /*
  *  Internal data structure
@@ -35,13 +68,22 @@
 static int fd = -1;
 /** \brief Number of blocks of the storage device */
 static uint32_t bnmax = 0;
+/** \brief Mechanism selected to carry out the transfers */
+static uint32_t backend = RAW_SYNC;
+/** \brief Mechanism presently used to carry out the transfers */
+static uint32_t backendInUse = RAW_SYNC;
+/** \brief Mapping of the Linux file that simulates the magnetic disk, if it is memory-mapped */
+static unsigned char *map = NULL;
+/** \brief Signals if the storage device is a Linux block device, rather than a regular file */
+static int blkdev = 0;
 
 /**
  *  \brief Open the storage device.
  *
  *  A communication channel is established with the storage device.
  *  It is supposed that no communication channel was previously established.
- *  The Linux file that simulates the storage device must exist and have a size multiple of the block size.
+ *  The Linux file that simulates the storage device, or the block device, must exist and have a size multiple of the
+ *  block size.
  *
  *  \param devname absolute path to the Linux file that simulates the storage device
  *  \param p_bnmax pointer to a location where the number of blocks of the device is to be stored
@@ -69,12 +111,32 @@ int soOpenDevice (const char *devname, uint32_t *p_bnmax)
   /* checking device for conformity */
 
   struct stat st;
-  if (stat (devname, &st) == -1) return -errno;
+  if (fstat (fd, &st) == -1) return -errno;
+  blkdev = S_ISBLK (st.st_mode);
+  if (blkdev)                                    /* the size of a block device is got from the driver */
+     { uint64_t size;
+       if (ioctl (fd, BLKGETSIZE64, &size) == -1) return -errno;
+       st.st_size = (off_t) size;
+     }
   if ((st.st_size % BLOCK_SIZE) != 0) return -ELIBBAD;
 
   bnmax = st.st_size / BLOCK_SIZE;               /* get number of blocks of the device */
   *p_bnmax = bnmax;
 
+  /* set up the io_uring queues, or map the supporting file into memory, if selected; the transfers are carried out
+     synchronously when it fails */
+
+  backendInUse = RAW_SYNC;
+  if ((backend == RAW_URING) && (uringOpen (fd, RAW_URING_DEPTH) == 0))
+     backendInUse = RAW_URING;
+  if ((backend == RAW_MMAP) && (bnmax != 0) && ((off_t) (size_t) st.st_size == st.st_size))
+     { void *addr = mmap (NULL, (size_t) st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+       if (addr != MAP_FAILED)
+          { map = addr;
+            backendInUse = RAW_MMAP;
+          }
+     }
+
   return 0;
 }
 
@@ -93,14 +155,61 @@ int soCloseDevice (void)
 
   if (fd == -1) return -EBADF;                   /* checking for device close state */
 
+  uringClose ();                                 /* tear down the io_uring queues, if set up */
+  if (map != NULL)                               /* unmap the supporting file, if mapped */
+     { munmap (map, (size_t) bnmax * BLOCK_SIZE);
+       map = NULL;
+     }
+  backendInUse = RAW_SYNC;
   close (fd);                                    /* close the device */
   bnmax = 0;                                     /* reset number of blocks of the storage device */
+  blkdev = 0;
   fd = -1;                                       /* reset file descriptor of the Linux file that simulates the
                                                     magnetic disk */
 
   return 0;
 }
 
+/**
+ *  \brief Select the mechanism used to carry out the transfers.
+ *
+ *  The selection takes effect the next time a communication channel is established with the storage device by
+ *  \e soOpenDevice. When \c RAW_URING is selected, but the Linux io_uring interface is not available, or \c RAW_MMAP is
+ *  selected, but the supporting file can not be mapped into memory, the transfers are carried out synchronously.
+ *
+ *  \param type mechanism to be used (\c RAW_SYNC, \c RAW_URING or \c RAW_MMAP)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>mechanism</em> is not valid
+ *  \return -\c EBUSY, if the device is already opened
+ */
+
+int soSetDeviceBackend (uint32_t type)
+{
+  soColorProbe (859, "07;31", "soSetDeviceBackend(%"PRIu32")\n", type);
+
+  if ((type != RAW_SYNC) && (type != RAW_URING) && (type != RAW_MMAP)) return -EINVAL;
+  if (fd != -1) return -EBUSY;                   /* checking for device open state */
+
+  backend = type;
+
+  return 0;
+}
+
+/**
+ *  \brief Get the mechanism presently used to carry out the transfers.
+ *
+ *  \return \c RAW_URING, if the device is opened and batches of transfers are carried out through the Linux io_uring
+ *          interface
+ *  \return \c RAW_MMAP, if the device is opened and the supporting file is mapped into memory
+ *  \return \c RAW_SYNC, otherwise
+ */
+
+uint32_t soGetDeviceBackend (void)
+{
+  return backendInUse;
+}
+
 /**
  *  \brief Read a block of data from the storage device.
  *
@@ -115,21 +224,29 @@ int soCloseDevice (void)
  *  \return -\c EINVAL, if the <em>buffer pointer</em> is \c NULL or the <em>block number</em> is out of range
  *  \return -\c EBADF, if the device is not already opened
  *  \return -\c EIO, if it fails on reading
- *  \return -<em>other specific error</em> issued by \e lseek system call
+ *  \return -<em>other specific error</em> issued by \e pread system call
  */
 
 int soReadRawBlock (uint32_t n, void *buf)
 {
   soColorProbe (853, "07;31", "soReadRawBlock(%"PRIu32", %p)\n", n, buf);
 
+  soStatScope (STAT_RAW_READ);
+
   if (buf == NULL) return -EINVAL;               /* checking for null pointer */
   if (n >= bnmax) return -EINVAL;                /* checking for block number */
   if (fd == -1) return -EBADF;                   /* checking for device closed state */
+  soStatAdd (STAT_RAW_RDBYTES, BLOCK_SIZE);
 
-  /* set file current position to the required block and read its contents */
+  /* read the contents of the required block */
 
-  if (lseek (fd, BLOCK_SIZE * n, SEEK_SET) == -1) return -errno;
-  if (read (fd, buf, BLOCK_SIZE) != BLOCK_SIZE) return -EIO;
+  if (map != NULL)
+     { memcpy (buf, map + (size_t) BLOCK_SIZE * n, BLOCK_SIZE);
+       return 0;
+     }
+  ssize_t nb = pread (fd, buf, BLOCK_SIZE, (off_t) BLOCK_SIZE * n);
+  if (nb == -1) return -errno;
+  if (nb != BLOCK_SIZE) return -EIO;
 
   return 0;
 }
@@ -148,21 +265,29 @@ int soReadRawBlock (uint32_t n, void *buf)
  *  \return -\c EINVAL, if <em>buffer pointer</em> is \c NULL or <em>block number</em> is out of range
  *  \return -\c EBADF, if the device is not already opened
  *  \return -\c EIO, if it fails on writing
- *  \return -<em>other specific error</em> issued by \e lseek system call
+ *  \return -<em>other specific error</em> issued by \e pwrite system call
  */
 
 int soWriteRawBlock (uint32_t n, void *buf)
 {
   soColorProbe (854, "07;31", "soWriteRawBlock(%"PRIu32", %p)\n", n, buf);
 
+  soStatScope (STAT_RAW_WRITE);
+
   if (buf == NULL) return -EINVAL;               /* checking for null pointer */
   if (n >= bnmax) return -EINVAL;                /* checking for block number */
   if (fd == -1) return -EBADF;                   /* checking for device closed state */
+  soStatAdd (STAT_RAW_WRBYTES, BLOCK_SIZE);
 
-  /* set file current position to the required block and write its contents */
+  /* write the contents of the required block */
 
-  if (lseek (fd, BLOCK_SIZE * n, SEEK_SET) == -1) return -errno;
-  if (write (fd, buf, BLOCK_SIZE) != BLOCK_SIZE) return -EIO;
+  if (map != NULL)
+     { memcpy (map + (size_t) BLOCK_SIZE * n, buf, BLOCK_SIZE);
+       return 0;
+     }
+  ssize_t nb = pwrite (fd, buf, BLOCK_SIZE, (off_t) BLOCK_SIZE * n);
+  if (nb == -1) return -errno;
+  if (nb != BLOCK_SIZE) return -EIO;
 
   return 0;
 }
@@ -181,22 +306,30 @@ int soWriteRawBlock (uint32_t n, void *buf)
  *  \return -\c EINVAL, if the <em>buffer pointer</em> is \c NULL or the <em>block number</em> is out of range
  *  \return -\c EBADF, if the device is not already opened
  *  \return -\c EIO, if it fails on reading
- *  \return -<em>other specific error</em> issued by \e lseek system call
+ *  \return -<em>other specific error</em> issued by \e pread system call
  */
 
 int soReadRawCluster (uint32_t n, void *buf)
 {
   soColorProbe (855, "07;31", "soReadRawCluster(%"PRIu32", %p)\n", n, buf);
 
+  soStatScope (STAT_RAW_READ);
+
   if (buf == NULL) return -EINVAL;               /* checking for null pointer */
   if ((n + BLOCKS_PER_CLUSTER) > bnmax)          /* checking for cluster number */
      return -EINVAL;
   if (fd == -1) return -EBADF;                   /* checking for device closed state */
+  soStatAdd (STAT_RAW_RDBYTES, CLUSTER_SIZE);
 
-  /* Set file current position to first block of the required cluster and read blocks contents in succession */
+  /* read the contents of the blocks of the required cluster in succession */
 
-  if (lseek (fd, BLOCK_SIZE * n, SEEK_SET) == -1) return -errno;
-  if (read (fd, buf, CLUSTER_SIZE) != CLUSTER_SIZE) return -EIO;
+  if (map != NULL)
+     { memcpy (buf, map + (size_t) BLOCK_SIZE * n, CLUSTER_SIZE);
+       return 0;
+     }
+  ssize_t nb = pread (fd, buf, CLUSTER_SIZE, (off_t) BLOCK_SIZE * n);
+  if (nb == -1) return -errno;
+  if (nb != CLUSTER_SIZE) return -EIO;
 
   return 0;
 }
@@ -215,22 +348,412 @@ int soReadRawCluster (uint32_t n, void *buf)
  *  \return -\c EINVAL, if <em>buffer pointer</em> is \c NULL or <em>block number</em> is out of range
  *  \return -\c EBADF, if the device is not already opened
  *  \return -\c EIO, if it fails on writing
- *  \return -<em>other specific error</em> issued by \e lseek system call
+ *  \return -<em>other specific error</em> issued by \e pwrite system call
  */
 
 int soWriteRawCluster (uint32_t n, void *buf)
 {
   soColorProbe (856, "07;31", "soWriteRawCluster(%"PRIu32", %p)\n", n, buf);
 
+  soStatScope (STAT_RAW_WRITE);
+
   if (buf == NULL) return -EINVAL;               /* checking for null pointer */
   if ((n + BLOCKS_PER_CLUSTER) > bnmax)          /* checking for cluster number */
      return -EINVAL;
   if (fd == -1) return -EBADF;                   /* checking for device closed state */
+  soStatAdd (STAT_RAW_WRBYTES, CLUSTER_SIZE);
+
+  /* write the contents of the blocks of the required cluster in succession */
+
+  if (map != NULL)
+     { memcpy (map + (size_t) BLOCK_SIZE * n, buf, CLUSTER_SIZE);
+       return 0;
+     }
+  ssize_t nb = pwrite (fd, buf, CLUSTER_SIZE, (off_t) BLOCK_SIZE * n);
+  if (nb == -1) return -errno;
+  if (nb != CLUSTER_SIZE) return -EIO;
+
+  return 0;
+}
+
+/**
+ *  \brief Read a run of successive blocks of data from the storage device into a vector of buffers.
+ *
+ *  The device is organized as a linear array of data blocks.
+ *  The physical number of the first data block of the run and a vector of previously allocated buffers are supplied as
+ *  arguments. The buffers are filled in succession and the size of each of them must be a multiple of the block size,
+ *  the run comprising as many blocks as the buffers may hold altogether.
+ *
+ *  \param n physical number of the first data block of the run to be read from
+ *  \param count number of elements of the vector of buffers
+ *  \param iov pointer to the vector of buffers where the data must be read into
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>vector pointer</em> or any <em>buffer pointer</em> is \c NULL, the <em>number of
+ *          elements</em> is zero, the size of any buffer is not a multiple of the block size or the run is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading
+ *  \return -<em>other specific error</em> issued by \e preadv system call
+ */
+
+int soReadRawBlocks (uint32_t n, uint32_t count, const struct iovec *iov)
+{
+  soColorProbe (857, "07;31", "soReadRawBlocks(%"PRIu32", %"PRIu32", %p)\n", n, count, iov);
+
+  soStatScope (STAT_RAW_READ);
+  int stat;                                      /* status of operation */
+
+  if ((stat = rawTransfer (0, n, count, iov)) == 0)
+     soStatAdd (STAT_RAW_RDBYTES, runSize (count, iov));
+
+  return stat;
+}
+
+/**
+ *  \brief Write a run of successive blocks of data from a vector of buffers to the storage device.
+ *
+ *  The device is organized as a linear array of data blocks.
+ *  The physical number of the first data block of the run and a vector of previously allocated buffers are supplied as
+ *  arguments. The buffers are written in succession and the size of each of them must be a multiple of the block size,
+ *  the run comprising as many blocks as the buffers hold altogether.
+ *
+ *  \param n physical number of the first data block of the run to be written into
+ *  \param count number of elements of the vector of buffers
+ *  \param iov pointer to the vector of buffers containing the data to be written from
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>vector pointer</em> or any <em>buffer pointer</em> is \c NULL, the <em>number of
+ *          elements</em> is zero, the size of any buffer is not a multiple of the block size or the run is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -<em>other specific error</em> issued by \e pwritev system call
+ */
 
-  /* Set file current position to first block of the required cluster and write blocks contents in succession */
+int soWriteRawBlocks (uint32_t n, uint32_t count, const struct iovec *iov)
+{
+  soColorProbe (858, "07;31", "soWriteRawBlocks(%"PRIu32", %"PRIu32", %p)\n", n, count, iov);
+
+  soStatScope (STAT_RAW_WRITE);
+  int stat;                                      /* status of operation */
 
-  if (lseek (fd, BLOCK_SIZE * n, SEEK_SET) == -1) return -errno;
-  if (write (fd, buf, CLUSTER_SIZE) != CLUSTER_SIZE) return -EIO;
+  if ((stat = rawTransfer (1, n, count, iov)) == 0)
+     soStatAdd (STAT_RAW_WRBYTES, runSize (count, iov));
+
+  return stat;
+}
+
+/**
+ *  \brief Carry out a batch of transfers of runs of successive blocks.
+ *
+ *  The transfers are supposed to be independent of one another and may be carried out in any order, concurrently, if
+ *  the batches are carried out through the Linux io_uring interface, or in succession, otherwise. The operation only
+ *  returns when all of them are completed and the status of each one is stored in the corresponding request.
+ *
+ *  \param req pointer to the array of requests
+ *  \param count number of requests
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>array pointer</em> is \c NULL, or any request is not valid (no transfer is carried
+ *          out, then)
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -<em>status of the first transfer which failed</em>, otherwise
+ */
+
+int soSubmitRawRequests (SORawRequest *req, uint32_t count)
+{
+  soColorProbe (860, "07;31", "soSubmitRawRequests(%p, %"PRIu32")\n", req, count);
+
+  soStatScope (STAT_RAW_BATCH);
+  uint32_t i;                                    /* counting variable */
+  int stat;                                      /* status of operation */
+
+  if ((req == NULL) && (count != 0)) return -EINVAL;       /* checking for null pointer */
+  for (i = 0; i < count; i++)                    /* checking requests for conformity */
+    if ((stat = checkRun (req[i].n, req[i].count, req[i].iov)) != 0)
+       return stat;
+  if (fd == -1) return -EBADF;                   /* checking for device closed state */
+
+  /* carry out the batch asynchronously, if possible; the transfers that were only partially carried out, or not carried
+     out at all, are redone synchronously */
+
+  for (i = 0; (i < count) && (req[i].count <= RAW_IOV_MAX); i++);
+  if ((backendInUse == RAW_URING) && (count > 1) && (i == count))
+     { if (uringSubmit (req, count) != 0)
+          backendInUse = RAW_SYNC;               /* the io_uring queues were torn down */
+     }
+     else for (i = 0; i < count; i++)
+            req[i].stat = -EAGAIN;
+  for (i = 0; i < count; i++)
+    if (req[i].stat == -EAGAIN)
+       req[i].stat = rawTransfer (req[i].wr, req[i].n, req[i].count, req[i].iov);
+  for (i = 0; i < count; i++)
+    if (req[i].stat == 0)
+       soStatAdd (req[i].wr ? STAT_RAW_WRBYTES : STAT_RAW_RDBYTES, runSize (req[i].count, req[i].iov));
+  for (i = 0; i < count; i++)
+    if (req[i].stat != 0) return req[i].stat;
 
   return 0;
 }
+
+/**
+ *  \brief Get direct access to a run of successive blocks of data, when the storage device is memory-mapped.
+ *
+ *  The address of the first block of the run in the mapping of the supporting file is returned. Whatever is written
+ *  there becomes the contents of the storage device, as if it were written by \e soWriteRawBlock.
+ *
+ *  \param n physical number of the first data block of the run
+ *  \param nblks number of blocks of the run
+ *  \param p_addr pointer to a location where the address of the run in the mapping is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>pointer</em> is \c NULL or the run is empty or out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c ENOTSUP, if the supporting file is not mapped into memory
+ */
+
+int soMapRawBlocks (uint32_t n, uint32_t nblks, void **p_addr)
+{
+  soColorProbe (861, "07;31", "soMapRawBlocks(%"PRIu32", %"PRIu32", %p)\n", n, nblks, p_addr);
+
+  if (p_addr == NULL) return -EINVAL;            /* checking for null pointer */
+  if ((nblks == 0) || ((uint64_t) n + nblks > bnmax)) return -EINVAL;  /* checking for run of blocks */
+  if (fd == -1) return -EBADF;                   /* checking for device closed state */
+  if (map == NULL) return -ENOTSUP;              /* checking for the supporting file mapped into memory */
+
+  *p_addr = map + (size_t) BLOCK_SIZE * n;
+
+  return 0;
+}
+
+/**
+ *  \brief Synchronize a run of successive blocks of data with the supporting file, when the storage device is
+ *         memory-mapped.
+ *
+ *  The pages of the mapping which contain the run are written back to the supporting file. Nothing is done if the
+ *  supporting file is not mapped into memory, since the transfers are then carried out by system calls.
+ *
+ *  \param n physical number of the first data block of the run
+ *  \param nblks number of blocks of the run
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the run is empty or out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -<em>other specific error</em> issued by \e msync system call
+ */
+
+int soSyncRawBlocks (uint32_t n, uint32_t nblks)
+{
+  soColorProbe (862, "07;31", "soSyncRawBlocks(%"PRIu32", %"PRIu32")\n", n, nblks);
+
+  soStatScope (STAT_RAW_SYNC);
+  size_t pageSize, start, end;                   /* page aligned limits of the run in the mapping */
+
+  if ((nblks == 0) || ((uint64_t) n + nblks > bnmax)) return -EINVAL;  /* checking for run of blocks */
+  if (fd == -1) return -EBADF;                   /* checking for device closed state */
+  if (map == NULL) return 0;
+
+  pageSize = (size_t) sysconf (_SC_PAGESIZE);
+  start = ((size_t) BLOCK_SIZE * n) / pageSize * pageSize;
+  end = (size_t) BLOCK_SIZE * (n + nblks);
+  if (msync (map + start, end - start, MS_SYNC) == -1) return -errno;
+
+  return 0;
+}
+
+/**
+ *  \brief Fill a run of successive blocks of the storage device with zeros.
+ *
+ *  The space the run takes in the supporting file is deallocated, whenever the file system where the supporting file
+ *  is stored allows it, so that nothing has to be transferred. Otherwise, the run is written from a buffer of zeros, by
+ *  large vectored transfers.
+ *
+ *  \param n physical number of the first data block of the run
+ *  \param nblks number of blocks of the run
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the run is empty or out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -<em>other specific error</em> issued by \e pwritev system call
+ */
+
+int soZeroRawBlocks (uint32_t n, uint32_t nblks)
+{
+  soColorProbe (863, "07;31", "soZeroRawBlocks(%"PRIu32", %"PRIu32")\n", n, nblks);
+
+  static const unsigned char zero[CLUSTER_SIZE];  /* buffer of zeros */
+  struct iovec iov[RAW_IOV_MAX];                 /* vector of buffers */
+  uint32_t i, k, m;                              /* counting variables */
+  int stat;                                      /* status of operation */
+
+  if ((nblks == 0) || ((uint64_t) n + nblks > bnmax)) return -EINVAL;  /* checking for run of blocks */
+  if (fd == -1) return -EBADF;                   /* checking for device closed state */
+
+  if (map != NULL)                               /* the supporting file is mapped into memory */
+     { memset (map + (size_t) BLOCK_SIZE * n, 0, (size_t) BLOCK_SIZE * nblks);
+       return 0;
+     }
+
+  /* deallocate the run in the supporting file, which is read as zeros afterwards (the contents of a block device is
+     not guaranteed to be zero after a discard) */
+
+  if (!blkdev && (soDiscardRawBlocks (n, nblks) == 0)) return 0;
+
+  /* write the run, otherwise, RAW_IOV_MAX clusters at a time */
+
+  for (k = 0; k < RAW_IOV_MAX; k++)
+    iov[k].iov_base = (void *) zero;
+  for (i = 0; i < nblks; i += m)
+  { m = ((nblks - i) < RAW_IOV_MAX * BLOCKS_PER_CLUSTER) ? (nblks - i) : RAW_IOV_MAX * BLOCKS_PER_CLUSTER;
+    for (k = 0; k * BLOCKS_PER_CLUSTER < m; k++)
+      iov[k].iov_len = ((m - k * BLOCKS_PER_CLUSTER) < BLOCKS_PER_CLUSTER) ? (m - k * BLOCKS_PER_CLUSTER) * BLOCK_SIZE
+                                                                           : CLUSTER_SIZE;
+    if ((stat = rawTransfer (1, n + i, k, iov)) != 0) return stat;
+  }
+
+  return 0;
+}
+
+/**
+ *  \brief Discard a run of successive blocks of the storage device.
+ *
+ *  The storage device is told that the contents of the run is no longer needed, so that the room it takes may be
+ *  reclaimed: the space the run takes in the supporting file is deallocated, the file size being kept, and it is read
+ *  as zeros afterwards; a block device is issued a discard request, after which the contents of the run is undefined.
+ *  When the storage device is memory-mapped, the mapping reflects the change straight away.
+ *
+ *  \param n physical number of the first data block of the run
+ *  \param nblks number of blocks of the run
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the run is empty or out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EOPNOTSUPP, if neither the storage device nor the file system where the supporting file is stored allow
+ *          it
+ *  \return -<em>other specific error</em> issued by \e fallocate system call or \e ioctl system call
+ */
+
+int soDiscardRawBlocks (uint32_t n, uint32_t nblks)
+{
+  soColorProbe (864, "07;31", "soDiscardRawBlocks(%"PRIu32", %"PRIu32")\n", n, nblks);
+
+  if ((nblks == 0) || ((uint64_t) n + nblks > bnmax)) return -EINVAL;  /* checking for run of blocks */
+  if (fd == -1) return -EBADF;                   /* checking for device closed state */
+
+  if (blkdev)
+     {
+#ifdef BLKDISCARD
+       uint64_t range[2] = { (uint64_t) BLOCK_SIZE * n, (uint64_t) BLOCK_SIZE * nblks };
+                                                 /* [byte] position and length of the run */
+       if (ioctl (fd, BLKDISCARD, range) == -1)
+          return ((errno == ENOTTY) || (errno == EINVAL)) ? -EOPNOTSUPP : -errno;
+       return 0;
+#else
+       return -EOPNOTSUPP;
+#endif
+     }
+
+#if defined(FALLOC_FL_PUNCH_HOLE) && defined(FALLOC_FL_KEEP_SIZE)
+  if (fallocate (fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, (off_t) BLOCK_SIZE * n, (off_t) BLOCK_SIZE * nblks)
+      == -1)
+     return (errno == ENOSYS) ? -EOPNOTSUPP : -errno;
+  return 0;
+#else
+  return -EOPNOTSUPP;
+#endif
+}
+
+/*
+ *  Internal functions
+ */
+
+/*
+ *  Check a run of successive blocks of data and the vector of buffers it is to be transferred from, or to, for
+ *  conformity.
+ */
+
+static int checkRun (uint32_t n, uint32_t count, const struct iovec *iov)
+{
+  uint64_t nblks;                                /* number of blocks of the run */
+  uint32_t i;                                    /* counting variable */
+
+  if ((iov == NULL) || (count == 0)) return -EINVAL;       /* checking for null pointer and empty vector */
+  for (i = 0, nblks = 0; i < count; i++)
+  { if ((iov[i].iov_base == NULL) || (iov[i].iov_len == 0) || ((iov[i].iov_len % BLOCK_SIZE) != 0))
+       return -EINVAL;                           /* checking for buffer conformity */
+    nblks += iov[i].iov_len / BLOCK_SIZE;
+  }
+  if ((n + nblks) > bnmax) return -EINVAL;       /* checking for run of blocks */
+
+  return 0;
+}
+
+/*
+ *  Transfer a run of successive blocks of data between the storage device and a vector of buffers: the vector is split
+ *  in chunks of at most RAW_IOV_MAX elements and partial transfers are resumed where they stopped.
+ */
+
+static int rawTransfer (int wr, uint32_t n, uint32_t count, const struct iovec *iov)
+{
+  struct iovec vec[RAW_IOV_MAX];                 /* chunk of the vector of buffers being transferred */
+  off_t off;                                     /* offset in the storage device */
+  uint32_t i, k, m;                              /* counting variables */
+  ssize_t nb;                                    /* number of bytes transferred */
+  int stat;                                      /* status of operation */
+
+  if ((stat = checkRun (n, count, iov)) != 0) return stat;
+  if (fd == -1) return -EBADF;                   /* checking for device closed state */
+
+  if (map != NULL)                               /* the supporting file is mapped into memory */
+     { for (i = 0, off = (off_t) BLOCK_SIZE * n; i < count; off += iov[i].iov_len, i++)
+         if (wr)
+            memcpy (map + off, iov[i].iov_base, iov[i].iov_len);
+            else memcpy (iov[i].iov_base, map + off, iov[i].iov_len);
+       return 0;
+     }
+
+  off = (off_t) BLOCK_SIZE * n;
+  for (i = 0; i < count; i += m)
+  { /* copy a chunk of the vector, so that it may be advanced after a partial transfer */
+    m = ((count - i) < RAW_IOV_MAX) ? (count - i) : RAW_IOV_MAX;
+    for (k = 0; k < m; k++)
+      vec[k] = iov[i+k];
+    k = 0;
+    while (k < m)
+    { if (wr)
+         nb = (m - k == 1) ? pwrite (fd, vec[k].iov_base, vec[k].iov_len, off) : pwritev (fd, vec + k, m - k, off);
+         else nb = (m - k == 1) ? pread (fd, vec[k].iov_base, vec[k].iov_len, off) : preadv (fd, vec + k, m - k, off);
+      if (nb == -1)
+         { if (errno == EINTR) continue;
+           return -errno;
+         }
+      if (nb == 0) return -EIO;                  /* end of the supporting file */
+      off += nb;
+      while ((k < m) && ((size_t) nb >= vec[k].iov_len))
+      { nb -= vec[k].iov_len;
+        k += 1;
+      }
+      if (k < m)
+         { vec[k].iov_base = (unsigned char *) vec[k].iov_base + nb;
+           vec[k].iov_len -= nb;
+         }
+    }
+  }
+
+  return 0;
+}
+
+/*
+ *  Get the number of bytes a vector of buffers holds altogether.
+ */
+
+static uint64_t runSize (uint32_t count, const struct iovec *iov)
+{
+  uint64_t size;                                 /* number of bytes */
+  uint32_t i;                                    /* counting variable */
+
+  for (i = 0, size = 0; i < count; i++)
+    size += iov[i].iov_len;
+
+  return size;
+}
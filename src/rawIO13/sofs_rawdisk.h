@@ -3,14 +3,23 @@
  *
  *  \brief Access to raw disk blocks and clusters.
  *
- *  The storage device is presently a Linux file which simulates a magnetic disk.
+ *  The storage device is presently a Linux file which simulates a magnetic disk, or a Linux block device.
  *  The following operations are defined:
  *    \li open a communication channel with the storage device
  *    \li close the communication channel previously established
  *    \li read a block of data from the storage device
  *    \li write a block of data to the storage device
  *    \li read a cluster of data from the storage device
- *    \li write a cluster of data to the storage device.
+ *    \li write a cluster of data to the storage device
+ *    \li read a run of successive blocks of data from the storage device into a vector of buffers
+ *    \li write a run of successive blocks of data from a vector of buffers to the storage device
+ *    \li select the mechanism used to carry out the transfers
+ *    \li carry out a batch of transfers of runs of successive blocks
+ *    \li get direct access to a run of successive blocks of data, when the storage device is memory-mapped
+ *    \li synchronize a run of successive blocks of data with the supporting file, when the storage device is
+ *        memory-mapped
+ *    \li fill a run of successive blocks of the storage device with zeros
+ *    \li discard a run of successive blocks of the storage device.
  *
  *  \author Artur Carneiro Pereira - September 2007
  *  \author Miguel Oliveira e Silva - September 2009
@@ -25,6 +34,36 @@
 #define SOFS_RAWDISK_H_
 
 #include <stdint.h>
+#include <sys/uio.h>
+
+/** \brief transfers are carried out synchronously by positioned system calls */
+#define RAW_SYNC   0
+/** \brief batches of transfers are carried out asynchronously through the Linux io_uring interface */
+#define RAW_URING  1
+/** \brief the supporting file is mapped into memory and the transfers are carried out by copies from and to the
+ *         mapping */
+#define RAW_MMAP   2
+
+/** \brief number of entries of the io_uring submission queue */
+#define RAW_URING_DEPTH  64
+
+/**
+ *  \brief Definition of a request for the transfer of a run of successive blocks.
+ */
+
+typedef struct soRawRequest
+{
+   /** \brief kind of transfer: write, if not zero, read, otherwise */
+    uint32_t wr;
+   /** \brief physical number of the first data block of the run */
+    uint32_t n;
+   /** \brief number of elements of the vector of buffers */
+    uint32_t count;
+   /** \brief pointer to the vector of buffers (the size of each of them must be a multiple of the block size) */
+    const struct iovec *iov;
+   /** \brief status of the transfer, once carried out */
+    int stat;
+} SORawRequest;
 
 /**
  *  \brief Open the storage device.
@@ -45,6 +84,33 @@
 
 extern int soOpenDevice (const char *devname, uint32_t *p_bnmax);
 
+/**
+ *  \brief Select the mechanism used to carry out the transfers.
+ *
+ *  The selection takes effect the next time a communication channel is established with the storage device by
+ *  \e soOpenDevice. When \c RAW_URING is selected, but the Linux io_uring interface is not available, or \c RAW_MMAP is
+ *  selected, but the supporting file can not be mapped into memory, the transfers are carried out synchronously.
+ *
+ *  \param backend mechanism to be used (\c RAW_SYNC, \c RAW_URING or \c RAW_MMAP)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>mechanism</em> is not valid
+ *  \return -\c EBUSY, if the device is already opened
+ */
+
+extern int soSetDeviceBackend (uint32_t backend);
+
+/**
+ *  \brief Get the mechanism presently used to carry out the transfers.
+ *
+ *  \return \c RAW_URING, if the device is opened and batches of transfers are carried out through the Linux io_uring
+ *          interface
+ *  \return \c RAW_MMAP, if the device is opened and the supporting file is mapped into memory
+ *  \return \c RAW_SYNC, otherwise
+ */
+
+extern uint32_t soGetDeviceBackend (void);
+
 /**
  *  \brief Close the storage device.
  *
@@ -70,7 +136,7 @@ extern int soCloseDevice (void);
  *  \return -\c EINVAL, if the <em>buffer pointer</em> is \c NULL or the <em>block number</em> is out of range
  *  \return -\c EBADF, if the device is not already opened
  *  \return -\c EIO, if it fails on reading
- *  \return -<em>other specific error</em> issued by \e lseek system call
+ *  \return -<em>other specific error</em> issued by \e pread system call
  */
 
 extern int soReadRawBlock (uint32_t n, void *buf);
@@ -89,7 +155,7 @@ extern int soReadRawBlock (uint32_t n, void *buf);
  *  \return -\c EINVAL, if <em>buffer pointer</em> is \c NULL or <em>block number</em> is out of range
  *  \return -\c EBADF, if the device is not already opened
  *  \return -\c EIO, if it fails on writing
- *  \return -<em>other specific error</em> issued by \e lseek system call
+ *  \return -<em>other specific error</em> issued by \e pwrite system call
  */
 
 extern int soWriteRawBlock (uint32_t n, void *buf);
@@ -108,7 +174,7 @@ extern int soWriteRawBlock (uint32_t n, void *buf);
  *  \return -\c EINVAL, if the <em>buffer pointer</em> is \c NULL or the <em>block number</em> is out of range
  *  \return -\c EBADF, if the device is not already opened
  *  \return -\c EIO, if it fails on reading
- *  \return -<em>other specific error</em> issued by \e lseek system call
+ *  \return -<em>other specific error</em> issued by \e pread system call
  */
 
 extern int soReadRawCluster (uint32_t n, void *buf);
@@ -127,9 +193,148 @@ extern int soReadRawCluster (uint32_t n, void *buf);
  *  \return -\c EINVAL, if <em>buffer pointer</em> is \c NULL or <em>block number</em> is out of range
  *  \return -\c EBADF, if the device is not already opened
  *  \return -\c EIO, if it fails on writing
- *  \return -<em>other specific error</em> issued by \e lseek system call
+ *  \return -<em>other specific error</em> issued by \e pwrite system call
  */
 
 extern int soWriteRawCluster (uint32_t n, void *buf);
 
+/**
+ *  \brief Read a run of successive blocks of data from the storage device into a vector of buffers.
+ *
+ *  The device is organized as a linear array of data blocks.
+ *  The physical number of the first data block of the run and a vector of previously allocated buffers are supplied as
+ *  arguments. The buffers are filled in succession and the size of each of them must be a multiple of the block size,
+ *  the run comprising as many blocks as the buffers may hold altogether.
+ *
+ *  \param n physical number of the first data block of the run to be read from
+ *  \param count number of elements of the vector of buffers
+ *  \param iov pointer to the vector of buffers where the data must be read into
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>vector pointer</em> or any <em>buffer pointer</em> is \c NULL, the <em>number of
+ *          elements</em> is zero, the size of any buffer is not a multiple of the block size or the run is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading
+ *  \return -<em>other specific error</em> issued by \e preadv system call
+ */
+
+extern int soReadRawBlocks (uint32_t n, uint32_t count, const struct iovec *iov);
+
+/**
+ *  \brief Write a run of successive blocks of data from a vector of buffers to the storage device.
+ *
+ *  The device is organized as a linear array of data blocks.
+ *  The physical number of the first data block of the run and a vector of previously allocated buffers are supplied as
+ *  arguments. The buffers are written in succession and the size of each of them must be a multiple of the block size,
+ *  the run comprising as many blocks as the buffers hold altogether.
+ *
+ *  \param n physical number of the first data block of the run to be written into
+ *  \param count number of elements of the vector of buffers
+ *  \param iov pointer to the vector of buffers containing the data to be written from
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>vector pointer</em> or any <em>buffer pointer</em> is \c NULL, the <em>number of
+ *          elements</em> is zero, the size of any buffer is not a multiple of the block size or the run is out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -<em>other specific error</em> issued by \e pwritev system call
+ */
+
+extern int soWriteRawBlocks (uint32_t n, uint32_t count, const struct iovec *iov);
+
+/**
+ *  \brief Carry out a batch of transfers of runs of successive blocks.
+ *
+ *  The transfers are supposed to be independent of one another and may be carried out in any order, concurrently, if
+ *  the batches are carried out through the Linux io_uring interface, or in succession, otherwise. The operation only
+ *  returns when all of them are completed and the status of each one is stored in the corresponding request.
+ *
+ *  \param req pointer to the array of requests
+ *  \param count number of requests
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>array pointer</em> is \c NULL, or any request is not valid (no transfer is carried
+ *          out, then)
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -<em>status of the first transfer which failed</em>, otherwise
+ */
+
+extern int soSubmitRawRequests (SORawRequest *req, uint32_t count);
+
+/**
+ *  \brief Get direct access to a run of successive blocks of data, when the storage device is memory-mapped.
+ *
+ *  The address of the first block of the run in the mapping of the supporting file is returned. Whatever is written
+ *  there becomes the contents of the storage device, as if it were written by \e soWriteRawBlock.
+ *
+ *  \param n physical number of the first data block of the run
+ *  \param nblks number of blocks of the run
+ *  \param p_addr pointer to a location where the address of the run in the mapping is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>pointer</em> is \c NULL or the run is empty or out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c ENOTSUP, if the supporting file is not mapped into memory
+ */
+
+extern int soMapRawBlocks (uint32_t n, uint32_t nblks, void **p_addr);
+
+/**
+ *  \brief Synchronize a run of successive blocks of data with the supporting file, when the storage device is
+ *         memory-mapped.
+ *
+ *  The pages of the mapping which contain the run are written back to the supporting file. Nothing is done if the
+ *  supporting file is not mapped into memory, since the transfers are then carried out by system calls.
+ *
+ *  \param n physical number of the first data block of the run
+ *  \param nblks number of blocks of the run
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the run is empty or out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -<em>other specific error</em> issued by \e msync system call
+ */
+
+extern int soSyncRawBlocks (uint32_t n, uint32_t nblks);
+
+/**
+ *  \brief Fill a run of successive blocks of the storage device with zeros.
+ *
+ *  The space the run takes in the supporting file is deallocated, whenever the file system where the supporting file
+ *  is stored allows it, so that nothing has to be transferred. Otherwise, the run is written from a buffer of zeros, by
+ *  large vectored transfers.
+ *
+ *  \param n physical number of the first data block of the run
+ *  \param nblks number of blocks of the run
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the run is empty or out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on writing
+ *  \return -<em>other specific error</em> issued by \e pwritev system call
+ */
+
+extern int soZeroRawBlocks (uint32_t n, uint32_t nblks);
+
+/**
+ *  \brief Discard a run of successive blocks of the storage device.
+ *
+ *  The storage device is told that the contents of the run is no longer needed, so that the room it takes may be
+ *  reclaimed: the space the run takes in the supporting file is deallocated, the file size being kept, and it is read
+ *  as zeros afterwards; a block device is issued a discard request, after which the contents of the run is undefined.
+ *  When the storage device is memory-mapped, the mapping reflects the change straight away.
+ *
+ *  \param n physical number of the first data block of the run
+ *  \param nblks number of blocks of the run
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the run is empty or out of range
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EOPNOTSUPP, if neither the storage device nor the file system where the supporting file is stored allow
+ *          it
+ *  \return -<em>other specific error</em> issued by \e fallocate system call or \e ioctl system call
+ */
+
+extern int soDiscardRawBlocks (uint32_t n, uint32_t nblks);
+
 #endif /* SOFS_RAWDISK_H_ */
@@ -0,0 +1,311 @@
+/**
+ *  \file sofs_rawuring.c (implementation file)
+ *
+ *  \brief Asynchronous access to raw disk blocks through the Linux io_uring interface.
+ *
+ *  A submission and a completion queue are shared with the kernel, so that a batch of transfers may be submitted by a
+ *  single system call and carried out concurrently by the storage device.
+ *  The queues are set up directly through the \e io_uring_setup and \e io_uring_enter system calls, so no supporting
+ *  library is required. They are accessed in mutual exclusion.
+ *  One should notice that this module does not stand alone: it supposes a very tight coupling with the raw disk
+ *  implementation, its only application.
+ *
+ *  The following operations are defined:
+ *    \li set up the submission and the completion queues for a given file descriptor
+ *    \li tear down the submission and the completion queues
+ *    \li carry out a batch of transfers.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+#include "sofs_rawdisk.h"
+#include "sofs_rawuring.h"
+
+#ifdef __NR_io_uring_setup
+
+#include <sys/mman.h>
+#include <linux/io_uring.h>
+
+/* <linux/io_uring.h> pulls in the kernel definition of BLOCK_SIZE, which is not the one of the storage device */
+#undef BLOCK_SIZE
+#include "sofs_const.h"
+
+/*
+ *  Internal data structure
+ */
+
+/** \brief access lock to the queues */
+static pthread_mutex_t ringCR = PTHREAD_MUTEX_INITIALIZER;
+/** \brief file descriptor of the queues */
+static int ringFd = -1;
+/** \brief file descriptor of the Linux file that simulates the storage device */
+static int devFd = -1;
+/** \brief number of entries of the submission queue */
+static uint32_t sqEntries = 0;
+/** \brief mapping of the submission queue ring */
+static void *sqRing = MAP_FAILED;
+/** \brief size of the mapping of the submission queue ring */
+static size_t sqRingSize = 0;
+/** \brief mapping of the completion queue ring (it may be the same as the submission queue ring) */
+static void *cqRing = MAP_FAILED;
+/** \brief size of the mapping of the completion queue ring */
+static size_t cqRingSize = 0;
+/** \brief mapping of the array of submission queue entries */
+static struct io_uring_sqe *sqes = MAP_FAILED;
+/** \brief size of the mapping of the array of submission queue entries */
+static size_t sqesSize = 0;
+
+/** \brief submission queue tail */
+static uint32_t *sqTail;
+/** \brief submission queue mask */
+static uint32_t sqMask;
+/** \brief submission queue array of indexes to the entries */
+static uint32_t *sqArray;
+/** \brief completion queue head */
+static uint32_t *cqHead;
+/** \brief completion queue tail */
+static uint32_t *cqTail;
+/** \brief completion queue mask */
+static uint32_t cqMask;
+/** \brief completion queue entries */
+static struct io_uring_cqe *cqes;
+
+/* Allusion to internal functions */
+
+static void unmapRings (void);
+static uint64_t reqSize (const SORawRequest *req);
+
+/**
+ *  \brief Set up the submission and the completion queues.
+ *
+ *  \param fd file descriptor of the Linux file that simulates the storage device
+ *  \param depth number of entries of the submission queue
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBUSY, if the queues are already set up
+ *  \return -\c ENOSYS, if the Linux io_uring interface is not available
+ *  \return -<em>other specific error</em> issued by \e io_uring_setup or \e mmap system calls
+ */
+
+int uringOpen (int fd, uint32_t depth)
+{
+  struct io_uring_params par;                    /* queue parameters */
+  int stat;                                      /* status of operation */
+
+  pthread_mutex_lock (&ringCR);
+  if (ringFd != -1)
+     { pthread_mutex_unlock (&ringCR);
+       return -EBUSY;
+     }
+
+  memset (&par, 0, sizeof (par));
+  if ((ringFd = (int) syscall (__NR_io_uring_setup, depth, &par)) == -1)
+     { stat = -errno;
+       pthread_mutex_unlock (&ringCR);
+       return stat;
+     }
+
+  /* map the rings and the array of submission queue entries */
+
+  sqRingSize = par.sq_off.array + par.sq_entries * sizeof (uint32_t);
+  cqRingSize = par.cq_off.cqes + par.cq_entries * sizeof (struct io_uring_cqe);
+  if (par.features & IORING_FEAT_SINGLE_MMAP)
+     { if (cqRingSize > sqRingSize) sqRingSize = cqRingSize;
+       cqRingSize = sqRingSize;
+     }
+  sqRing = mmap (NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+  if (sqRing != MAP_FAILED)
+     { if (par.features & IORING_FEAT_SINGLE_MMAP)
+          cqRing = sqRing;
+          else cqRing = mmap (NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd,
+                              IORING_OFF_CQ_RING);
+     }
+  sqesSize = par.sq_entries * sizeof (struct io_uring_sqe);
+  if (cqRing != MAP_FAILED)
+     sqes = mmap (NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED)
+     { stat = -errno;
+       unmapRings ();
+       pthread_mutex_unlock (&ringCR);
+       return stat;
+     }
+
+  sqTail = (uint32_t *) ((char *) sqRing + par.sq_off.tail);
+  sqMask = *(uint32_t *) ((char *) sqRing + par.sq_off.ring_mask);
+  sqArray = (uint32_t *) ((char *) sqRing + par.sq_off.array);
+  cqHead = (uint32_t *) ((char *) cqRing + par.cq_off.head);
+  cqTail = (uint32_t *) ((char *) cqRing + par.cq_off.tail);
+  cqMask = *(uint32_t *) ((char *) cqRing + par.cq_off.ring_mask);
+  cqes = (struct io_uring_cqe *) ((char *) cqRing + par.cq_off.cqes);
+  sqEntries = par.sq_entries;
+  devFd = fd;
+  pthread_mutex_unlock (&ringCR);
+
+  return 0;
+}
+
+/**
+ *  \brief Tear down the submission and the completion queues.
+ *
+ *  Nothing is done if the queues were not set up.
+ */
+
+void uringClose (void)
+{
+  pthread_mutex_lock (&ringCR);
+  if (ringFd != -1) unmapRings ();
+  pthread_mutex_unlock (&ringCR);
+}
+
+/**
+ *  \brief Carry out a batch of transfers.
+ *
+ *  The requests are submitted as many at a time as the submission queue may hold and the operation only returns when
+ *  all of them are completed. The status of each request is set to <tt>0 (zero)</tt>, if the transfer was fully carried
+ *  out, to -\c EAGAIN, if it was only partially carried out and must be redone, or to the symmetric of the system error
+ *  that occurred.
+ *  The requests are supposed to have already been checked for conformity.
+ *
+ *  \param req pointer to the array of requests
+ *  \param count number of requests
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c ENODEV, if the queues are not set up
+ *  \return -<em>other specific error</em> issued by \e io_uring_enter system call (the queues are torn down)
+ */
+
+int uringSubmit (SORawRequest *req, uint32_t count)
+{
+  struct io_uring_sqe *sqe;                      /* pointer to a submission queue entry */
+  struct io_uring_cqe *cqe;                      /* pointer to a completion queue entry */
+  uint32_t next, done, inFlight, toSubmit;       /* request counters */
+  uint32_t tail, head, i;                        /* queue indexes */
+  int ret;                                       /* value returned by io_uring_enter */
+
+  pthread_mutex_lock (&ringCR);
+  if (ringFd == -1)
+     { pthread_mutex_unlock (&ringCR);
+       return -ENODEV;
+     }
+
+  for (i = 0; i < count; i++)
+    req[i].stat = -EAGAIN;                       /* not carried out, so far */
+  next = done = inFlight = toSubmit = 0;
+  while (done < count)
+  { /* fill in the submission queue */
+    tail = *sqTail;
+    while ((next < count) && (inFlight < sqEntries))
+    { sqe = &sqes[tail & sqMask];
+      memset (sqe, 0, sizeof (*sqe));
+      sqe->opcode = (req[next].wr) ? IORING_OP_WRITEV : IORING_OP_READV;
+      sqe->fd = devFd;
+      sqe->off = (uint64_t) BLOCK_SIZE * req[next].n;
+      sqe->addr = (uint64_t) (uintptr_t) req[next].iov;
+      sqe->len = req[next].count;
+      sqe->user_data = next;
+      sqArray[tail & sqMask] = tail & sqMask;
+      tail += 1;
+      next += 1;
+      inFlight += 1;
+      toSubmit += 1;
+    }
+    __atomic_store_n (sqTail, tail, __ATOMIC_RELEASE);
+
+    /* submit the new entries and wait for at least one completion */
+
+    ret = (int) syscall (__NR_io_uring_enter, ringFd, toSubmit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+    if (ret == -1)
+       { if (errno == EINTR) continue;
+         ret = -errno;
+         unmapRings ();                          /* the transfers in flight are cancelled */
+         pthread_mutex_unlock (&ringCR);
+         return ret;                             /* the requests not carried out keep -EAGAIN */
+       }
+    toSubmit -= (uint32_t) ret;
+
+    /* reap the completions */
+
+    head = *cqHead;
+    while (head != __atomic_load_n (cqTail, __ATOMIC_ACQUIRE))
+    { cqe = &cqes[head & cqMask];
+      i = (uint32_t) cqe->user_data;
+      if (cqe->res < 0)
+         req[i].stat = (cqe->res == -EINTR) ? -EAGAIN : cqe->res;
+         else req[i].stat = ((uint64_t) cqe->res == reqSize (&req[i])) ? 0 : -EAGAIN;
+      head += 1;
+      done += 1;
+      inFlight -= 1;
+    }
+    __atomic_store_n (cqHead, head, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock (&ringCR);
+
+  return 0;
+}
+
+/*
+ *  Internal functions
+ */
+
+/*
+ *  Unmap the rings and close the queues (the caller holds the access lock).
+ */
+
+static void unmapRings (void)
+{
+  if (sqes != MAP_FAILED) munmap (sqes, sqesSize);
+  if ((cqRing != MAP_FAILED) && (cqRing != sqRing)) munmap (cqRing, cqRingSize);
+  if (sqRing != MAP_FAILED) munmap (sqRing, sqRingSize);
+  sqes = MAP_FAILED;
+  cqRing = sqRing = MAP_FAILED;
+  close (ringFd);
+  ringFd = devFd = -1;
+  sqEntries = 0;
+}
+
+/*
+ *  Number of bytes transferred by a request.
+ */
+
+static uint64_t reqSize (const SORawRequest *req)
+{
+  uint64_t size;                                 /* number of bytes */
+  uint32_t i;                                    /* counting variable */
+
+  for (i = 0, size = 0; i < req->count; i++)
+    size += req->iov[i].iov_len;
+
+  return size;
+}
+
+#else /* __NR_io_uring_setup */
+
+/*
+ *  The Linux io_uring interface is not available: the raw disk implementation always falls back to synchronous
+ *  transfers.
+ */
+
+int uringOpen (int fd, uint32_t depth)
+{
+  (void) fd;
+  (void) depth;
+  return -ENOSYS;
+}
+
+void uringClose (void)
+{
+}
+
+int uringSubmit (SORawRequest *req, uint32_t count)
+{
+  (void) req;
+  (void) count;
+  return -ENODEV;
+}
+
+#endif /* __NR_io_uring_setup */
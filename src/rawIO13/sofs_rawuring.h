@@ -0,0 +1,70 @@
+/**
+ *  \file sofs_rawuring.h (interface file)
+ *
+ *  \brief Asynchronous access to raw disk blocks through the Linux io_uring interface.
+ *
+ *  A submission and a completion queue are shared with the kernel, so that a batch of transfers may be submitted by a
+ *  single system call and carried out concurrently by the storage device.
+ *  One should notice that this module does not stand alone: it supposes a very tight coupling with the raw disk
+ *  implementation, its only application. When the Linux io_uring interface is not available, either at compile time or
+ *  at run time, the queues can not be set up and the raw disk implementation falls back to synchronous transfers.
+ *
+ *  The following operations are defined:
+ *    \li set up the submission and the completion queues for a given file descriptor
+ *    \li tear down the submission and the completion queues
+ *    \li carry out a batch of transfers.
+ *
+ *  \remarks In case an error occurs, all functions return a negative value which is the symmetric of the system error
+ *           that better represents the error cause.
+ *           (execute command <em>man errno</em> to get the list of system errors)
+ */
+
+#ifndef SOFS_RAWURING_H_
+#define SOFS_RAWURING_H_
+
+#include <stdint.h>
+
+#include "sofs_rawdisk.h"
+
+/**
+ *  \brief Set up the submission and the completion queues.
+ *
+ *  \param fd file descriptor of the Linux file that simulates the storage device
+ *  \param depth number of entries of the submission queue
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBUSY, if the queues are already set up
+ *  \return -\c ENOSYS, if the Linux io_uring interface is not available
+ *  \return -<em>other specific error</em> issued by \e io_uring_setup or \e mmap system calls
+ */
+
+extern int uringOpen (int fd, uint32_t depth);
+
+/**
+ *  \brief Tear down the submission and the completion queues.
+ *
+ *  Nothing is done if the queues were not set up.
+ */
+
+extern void uringClose (void);
+
+/**
+ *  \brief Carry out a batch of transfers.
+ *
+ *  The requests are submitted as many at a time as the submission queue may hold and the operation only returns when
+ *  all of them are completed. The status of each request is set to <tt>0 (zero)</tt>, if the transfer was fully carried
+ *  out, to -\c EAGAIN, if it was only partially carried out and must be redone, or to the symmetric of the system error
+ *  that occurred.
+ *  The requests are supposed to have already been checked for conformity.
+ *
+ *  \param req pointer to the array of requests
+ *  \param count number of requests
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c ENODEV, if the queues are not set up
+ *  \return -<em>other specific error</em> issued by \e io_uring_enter system call (the queues are torn down)
+ */
+
+extern int uringSubmit (SORawRequest *req, uint32_t count);
+
+#endif /* SOFS_RAWURING_H_ */
@@ -16,6 +16,9 @@
  *      \li cluster contents as a sub-array of directory entries
  *      \li block/cluster contents as a sub-array of data cluster references.
  *
+ *  The unit may also be read through the buffercache, after the superblock, and the statistics of the buffercache are
+ *  then displayed after it.
+ *
  *  SINOPSIS:
  *  <P><PRE>                   showblock_sofs13 OPTIONS supp-file
  *
@@ -32,6 +35,7 @@
  *                 -D clusterNumber --- show the cluster contents as a sub-array of directory entries
  *                 -r blockNumber   --- show the block contents as a sub-array of data cluster references
  *                 -R clusterNumber --- show the cluster contents as a sub-array of data cluster references
+ *                 -c               --- read through the buffercache and show its statistics (with one of the above)
  *                 -h               --- print this help.</PRE>
  *
  *  \remarks All cluster and block numbers in OPTIONS are physical numbers (indexes of the array of blocks that
@@ -56,12 +60,15 @@
 
 #include "sofs_const.h"
 #include "sofs_rawdisk.h"
+#include "sofs_buffercache.h"
+#include "sofs_basicoper.h"
 #include "sofs_blockviews.h"
 
 /* Allusion to internal functions */
 
 static void printUsage (char *cmd_name);
 static void printError (int errcode, char *cmd_name);
+static int printCacheStats (void);
 
 /* The main function */
 
@@ -72,12 +79,18 @@ int main (int argc, char *argv[])
   char *msg = NULL;                                        /* type of display */
   bool isCluster;                                          /* type of unit to display */
   int unitNumber = 0;                                      /* unit number (default, zero) */
+  bool viaCache = false;                                   /* read through the buffercache */
 
   /* process command line options */
 
   int opt;                                       /* selected option */
+  int opt2;                                      /* next option */
 
-  if ((opt = getopt (argc, argv, "x:X:a:A:b:B:s:i:T:D:r:R:h")) == -1)
+  if ((opt = getopt (argc, argv, "x:X:a:A:b:B:s:i:T:D:r:R:ch")) == 'c')
+     { viaCache = true;
+       opt = getopt (argc, argv, "x:X:a:A:b:B:s:i:T:D:r:R:h");
+     }
+  if (opt == -1)
      { fprintf (stderr, "%s: An option is needed.\n", basename (argv[0]));
        printUsage (basename (argv[0]));
        return EXIT_FAILURE;
@@ -98,7 +111,11 @@ int main (int argc, char *argv[])
        printUsage (basename (argv[0]));
        return EXIT_FAILURE;
      }
-  if (getopt (argc, argv, "x:X:a:A:b:B:s:i:T:D:R:h") != -1)
+  if (((opt2 = getopt (argc, argv, "x:X:a:A:b:B:s:i:T:D:r:R:ch")) == 'c') && !viaCache)
+     { viaCache = true;
+       opt2 = getopt (argc, argv, "x:X:a:A:b:B:s:i:T:D:r:R:h");
+     }
+  if (opt2 != -1)
      { fprintf (stderr, "%s: Too many options.\n", basename (argv[0]));
        printUsage (basename (argv[0]));
        return EXIT_FAILURE;
@@ -195,20 +212,28 @@ int main (int argc, char *argv[])
   unsigned char buffer[CLUSTER_SIZE];            /* buffer to store block/cluster contents */
   int status;                                    /* status of operation */
 
-  /* open a direct communication channel with the storage device */
+  /* open a direct communication channel with the storage device, or a buffered one, whose regions are set up by
+     loading the superblock */
 
   uint32_t dummy;                                /* dummy variable */
 
-  if ((status = soOpenDevice (argv[optind], &dummy)) != 0)
+  if (viaCache)
+     { if (((status = soOpenBufferCache (argv[optind], BUF)) == 0) && ((status = soLoadSuperBlock ()) != 0))
+          soCloseBufferCache ();
+     }
+     else status = soOpenDevice (argv[optind], &dummy);
+  if (status != 0)
      { printError (status, basename (argv[0]));
        return EXIT_FAILURE;
      }
 
   /* read block/cluster */
 
-  if (isCluster)
-     status = soReadRawCluster (unitNumber, buffer);
-     else status = soReadRawBlock (unitNumber, buffer);
+  if (viaCache)
+     status = (isCluster) ? soReadCacheCluster (unitNumber, buffer) : soReadCacheBlock (unitNumber, buffer);
+     else if (isCluster)
+             status = soReadRawCluster (unitNumber, buffer);
+             else status = soReadRawBlock (unitNumber, buffer);
   if (status == -EINVAL)
      { fprintf (stderr, "%s: Unit number too large.\n", basename (argv[0]));
        return EXIT_FAILURE;
@@ -234,9 +259,17 @@ int main (int argc, char *argv[])
             print2 (buffer, isCluster);
           }
 
+  /* display the statistics of the buffercache */
+
+  if (viaCache && ((status = printCacheStats ()) != 0))
+     { printError (status, basename (argv[0]));
+       soCloseBufferCache ();
+       return EXIT_FAILURE;
+     }
+
   /* close the communication channel with the storage device */
 
-  if ((status = soCloseDevice ()) != 0)
+  if ((status = (viaCache) ? soCloseBufferCache () : soCloseDevice ()) != 0)
      { printError (status, basename (argv[0]));
        return EXIT_FAILURE;
      }
@@ -267,9 +300,29 @@ static void printUsage (char *cmd_name)
           "  -D clusterNumber --- show the cluster contents as a sub-array of directory entries\n"
           "  -r blockNumber   --- show the block contents as a sub-array of data cluster references\n"
           "  -R clusterNumber --- show the cluster contents as a sub-array of data cluster references\n"
+          "  -c               --- read through the buffercache and show its statistics (with one of the above)\n"
           "  -h               --- print this help\n", cmd_name);
 }
 
+/*
+ * print the statistics of the buffercache
+ */
+
+static int printCacheStats (void)
+{
+  char *report;                                  /* report of the statistics */
+  int len;                                       /* length of the report */
+
+  len = soReportBufferCacheStats (NULL, 0);
+  if ((report = malloc ((size_t) len + 1)) == NULL)
+     return -ENOMEM;
+  soReportBufferCacheStats (report, (size_t) len + 1);
+  printf ("Buffercache statistics\n%s", report);
+  free (report);
+
+  return 0;
+}
+
 /*
  * print error message
  */
@@ -16,6 +16,9 @@
  *      \li cluster contents as a sub-array of directory entries
  *      \li block/cluster contents as a sub-array of data cluster references.
  *
+ *  The unit may also be read through the buffercache, after the superblock, and the statistics of the buffercache are
+ *  then displayed after it.
+ *
  *  SINOPSIS:
  *  <P><PRE>                   showblock_sofs13 OPTIONS supp-file
  *
@@ -32,6 +35,7 @@
  *                 -D clusterNumber --- show the cluster contents as a sub-array of directory entries
  *                 -r blockNumber   --- show the block contents as a sub-array of data cluster references
  *                 -R clusterNumber --- show the cluster contents as a sub-array of data cluster references
+ *                 -c               --- read through the buffercache and show its statistics (with one of the above)
  *                 -h               --- print this help.</PRE>
  *
  *  \remarks All cluster and block numbers in OPTIONS are physical numbers (indexes of the array of blocks that
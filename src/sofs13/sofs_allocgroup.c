@@ -0,0 +1,421 @@
+/**
+ *  \file sofs_allocgroup.c (implementation file)
+ *
+ *  \brief Allocation groups of the data zone and per-thread reservations of free data clusters.
+ *
+ *  The cursor of each group is guarded by the lock of the superblock, as are the bitmap table and the summary of its
+ *  free data clusters, which provides the number of free clusters of each group. The reservations are kept in a fixed
+ *  set of slots, each one owned by a thread at a time and guarded by a lock of its own, which is only contended when
+ *  the reserved clusters are given back: a thread claims a free slot the first time it needs one and releases it when
+ *  it exits, the clusters reserved in it being left there.
+ *
+ *  The operations are:
+ *      \li enable or disable the allocation groups the next time they are opened
+ *      \li build the allocation groups of the mounted file system
+ *      \li give back the reserved clusters and release the allocation groups
+ *      \li take free data clusters from the reservation of the calling thread
+ *      \li get the run of the bitmap table where the next reservation of the calling thread is to be drawn from
+ *      \li store a new reservation for the calling thread
+ *      \li give back all reserved clusters to the bitmap table
+ *      \li get the run of data clusters of the group of a data cluster.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "sofs_probe.h"
+#include "sofs_const.h"
+#include "sofs_superblock.h"
+#include "sofs_datacluster.h"
+#include "sofs_basicoper.h"
+#include "sofs_freesummary.h"
+#include "sofs_allocgroup.h"
+
+/*
+ *  Internal data structure
+ */
+
+/** \brief reservation of free data clusters of a thread */
+typedef struct soResSlot
+{
+  /** \brief lock of the slot */
+  pthread_mutex_t lock;
+  /** \brief signals if the slot is owned by a thread */
+  int owned;
+  /** \brief index of the group the clusters were drawn from (\c UINT32_MAX, if none yet) */
+  uint32_t group;
+  /** \brief index of the next cluster to be taken */
+  uint32_t next;
+  /** \brief number of clusters reserved */
+  uint32_t count;
+  /** \brief logical numbers of the clusters reserved, in increasing order */
+  uint32_t ref[AG_RESERVE];
+} SOResSlot;
+
+/** \brief signals if the allocation groups are to be built the next time they are opened */
+static bool enabled = false;
+/** \brief signals if the allocation groups are open */
+static int agOpen = 0;
+/** \brief number of allocation groups */
+static uint32_t nGroups = 0;
+/** \brief total number of data clusters of the data zone */
+static uint32_t nTotal = 0;
+/** \brief reference where the search for free data clusters goes on in each group */
+static uint32_t *groupCursor = NULL;
+
+/** \brief slots of the reservations */
+static SOResSlot slot[AG_SLOTS];
+/** \brief slots initialization flag */
+static pthread_once_t slotInit = PTHREAD_ONCE_INIT;
+/** \brief key whose destructor releases the slot of a thread which exits */
+static pthread_key_t slotKey;
+/** \brief index of the slot owned by the thread (-1, if none) */
+static __thread int mySlot = -1;
+
+/* Allusion to internal functions */
+
+static void initSlots (void);
+static void releaseSlot (void *arg);
+static SOResSlot *ownSlot (void);
+static int giveBack (SOSuperBlock *p_sb, uint32_t *nClust, uint32_t n);
+static int cmpClust (const void *a, const void *b);
+
+/**
+ *  \brief Enable or disable the allocation groups the next time they are opened.
+ *
+ *  It is disabled by default.
+ *
+ *  \param on signals if the data clusters are to be allocated from allocation groups through per-thread reservations
+ */
+
+void soSetAllocGroups (bool on)
+{
+  enabled = on;
+}
+
+/**
+ *  \brief Build the allocation groups of the mounted file system.
+ *
+ *  The number of free clusters of each group is got from the summary of the free data clusters, which must be built
+ *  beforehand. Nothing is done if the allocation groups are not enabled.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the summary of the free data clusters is not built
+ *  \return -\c EBUSY, if the allocation groups are already open
+ *  \return -\c ENOMEM, if there is no memory for the allocation groups
+ *  \return -<em>other specific error</em> issued by \e soLoadSuperBlock
+ */
+
+int soOpenAllocGroups (void)
+{
+  soColorProbe (758, "07;31", "soOpenAllocGroups ()\n");
+
+  SOSuperBlock *p_sb;                            /* pointer to the superblock */
+  uint32_t g;                                    /* index of a group */
+  int stat;                                      /* status of operation */
+
+  if (!enabled) return 0;
+  if (__atomic_load_n (&agOpen, __ATOMIC_ACQUIRE)) return -EBUSY;
+  pthread_once (&slotInit, initSlots);
+
+  soLockSuperBlock ();
+  if ((stat = soLoadSuperBlock ()) != 0)
+     { soUnlockSuperBlock ();
+       return stat;
+     }
+  p_sb = soGetSuperBlock ();
+  if (soGetFreeSummary (0) == FSUM_UNKNOWN)
+     { soUnlockSuperBlock ();
+       return -EINVAL;
+     }
+  nTotal = p_sb->dzone_total;
+  nGroups = (nTotal + AG_CLUSTERS - 1) / AG_CLUSTERS;
+  if ((groupCursor = calloc (nGroups, sizeof (uint32_t))) == NULL)
+     { soUnlockSuperBlock ();
+       return -ENOMEM;
+     }
+  for (g = 0; g < nGroups; g++)
+    groupCursor[g] = g * AG_CLUSTERS;
+  __atomic_store_n (&agOpen, 1, __ATOMIC_RELEASE);
+  soUnlockSuperBlock ();
+
+  return 0;
+}
+
+/**
+ *  \brief Give back the reserved clusters and release the allocation groups.
+ *
+ *  Nothing is done if the allocation groups are not open.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -<em>other specific error</em> issued by \e soReclaimReserved
+ */
+
+int soCloseAllocGroups (void)
+{
+  soColorProbe (759, "07;31", "soCloseAllocGroups ()\n");
+
+  int stat;                                      /* status of operation */
+
+  if (!__atomic_load_n (&agOpen, __ATOMIC_ACQUIRE)) return 0;
+
+  soLockSuperBlock ();
+  if ((stat = soLoadSuperBlock ()) == 0)
+     stat = soReclaimReserved (soGetSuperBlock ());
+  __atomic_store_n (&agOpen, 0, __ATOMIC_RELEASE);
+  free (groupCursor);
+  groupCursor = NULL;
+  soUnlockSuperBlock ();
+
+  return stat;
+}
+
+/**
+ *  \brief Take free data clusters from the reservation of the calling thread.
+ *
+ *  The clusters are taken in order for as long as there is no hint, or, for the first one, it follows the hint and,
+ *  for the others, the one taken before. When clusters anywhere in the group are accepted, the reservation must have
+ *  been drawn from the group of the hint. The clusters taken are clean and already accounted as not free.
+ *
+ *  \param hint logical number of the data cluster the clusters should follow (\c NULL_CLUSTER, if there is none)
+ *  \param inGroup signals if any cluster of the group of the hint is accepted, rather than only the next one
+ *  \param count number of data clusters wanted
+ *  \param nClust pointer to the array where the logical numbers of the data clusters are to be stored
+ *  \param p_n pointer to the number of clusters already stored in the array, which is updated
+ */
+
+void soTakeReserved (uint32_t hint, bool inGroup, uint32_t count, uint32_t *nClust, uint32_t *p_n)
+{
+  SOResSlot *p;                                  /* pointer to the slot of the thread */
+  uint32_t prev;                                 /* the cluster the next one should follow */
+
+  if (!__atomic_load_n (&agOpen, __ATOMIC_ACQUIRE) || (*p_n >= count) || ((p = ownSlot ()) == NULL)) return;
+
+  pthread_mutex_lock (&p->lock);
+  if (inGroup && ((hint == NULL_CLUSTER) || (hint / AG_CLUSTERS != p->group)))
+     inGroup = false;
+  prev = hint;
+  while ((*p_n < count) && (p->next < p->count) &&
+         (inGroup || (prev == NULL_CLUSTER) || (p->ref[p->next] == prev + 1)))
+  { nClust[*p_n] = p->ref[p->next];
+    *p_n += 1;
+    p->next += 1;
+    if (hint != NULL_CLUSTER) prev = nClust[*p_n - 1];
+  }
+  pthread_mutex_unlock (&p->lock);
+}
+
+/**
+ *  \brief Get the run of the bitmap table where the next reservation of the calling thread is to be drawn from.
+ *
+ *  It starts at the cursor of the group of the thread, while it has free clusters, or of the group with most of them,
+ *  otherwise, and ends with the group.
+ *
+ *  \param p_start pointer to the location where the reference of the first data cluster of the run is to be stored
+ *  \param p_end pointer to the location where the reference past the last data cluster of the run is to be stored
+ *
+ *  \return \c true, if there is such a run, or \c false, if the allocation groups are not open, the calling thread
+ *          may hold no reservation, or no group has free clusters in the bitmap table
+ */
+
+bool soGetReserveRange (uint32_t *p_start, uint32_t *p_end)
+{
+  SOResSlot *p;                                  /* pointer to the slot of the thread */
+  uint32_t g, best, k;                           /* indexes of the groups and counting variable */
+
+  if (!__atomic_load_n (&agOpen, __ATOMIC_ACQUIRE) || ((p = ownSlot ()) == NULL)) return false;
+
+  /* the threads start from groups spread over the data zone, so that they do not mix their files */
+
+  g = p->group;
+  if ((g >= nGroups) || (soGetFreeSummary (g) == 0))
+     { best = (uint32_t) mySlot * nGroups / AG_SLOTS;
+       for (k = 1; k < nGroups; k++)
+       { g = ((uint32_t) mySlot * nGroups / AG_SLOTS + k) % nGroups;
+         if (soGetFreeSummary (g) > soGetFreeSummary (best)) best = g;
+       }
+       if (soGetFreeSummary (best) == 0) return false;
+       g = best;
+     }
+  p->group = g;
+
+  *p_end = (nTotal - g * AG_CLUSTERS < AG_CLUSTERS) ? nTotal : (g + 1) * AG_CLUSTERS;
+  if (groupCursor[g] >= *p_end) groupCursor[g] = g * AG_CLUSTERS;
+  *p_start = groupCursor[g];
+
+  return true;
+}
+
+/**
+ *  \brief Store a new reservation for the calling thread.
+ *
+ *  The reservation must be empty and the clusters must have been drawn from the run got by \e soGetReserveRange, in
+ *  order, and be already clean and accounted as not free.
+ *
+ *  \param nClust pointer to the array of the logical numbers of the data clusters
+ *  \param n number of data clusters (at most \c AG_RESERVE)
+ *  \param pos reference past the last data cluster examined in the bitmap table, where the cursor of the group is left
+ */
+
+void soPutReserved (const uint32_t *nClust, uint32_t n, uint32_t pos)
+{
+  SOResSlot *p;                                  /* pointer to the slot of the thread */
+
+  if (!__atomic_load_n (&agOpen, __ATOMIC_ACQUIRE) || ((p = ownSlot ()) == NULL) || (p->group >= nGroups)) return;
+
+  pthread_mutex_lock (&p->lock);
+  memcpy (p->ref, nClust, n * sizeof (uint32_t));
+  p->next = 0;
+  p->count = n;
+  pthread_mutex_unlock (&p->lock);
+  groupCursor[p->group] = pos;
+}
+
+/**
+ *  \brief Give back all reserved clusters to the bitmap table.
+ *
+ *  The reservations of all threads are emptied and the clusters are accounted as free again in the superblock.
+ *
+ *  \param p_sb pointer to a buffer where the superblock data is stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -<em>other specific error</em> issued by \e soLoadBlockBMapT, \e soStoreBlockBMapT or
+ *          \e soStoreSuperBlock
+ */
+
+int soReclaimReserved (SOSuperBlock *p_sb)
+{
+  uint32_t nClust[AG_SLOTS * AG_RESERVE];        /* logical numbers of the clusters reserved */
+  uint32_t n, k;                                 /* number of clusters and counting variable */
+
+  if (!__atomic_load_n (&agOpen, __ATOMIC_ACQUIRE)) return 0;
+
+  for (k = 0, n = 0; k < AG_SLOTS; k++)
+  { pthread_mutex_lock (&slot[k].lock);
+    memcpy (nClust + n, slot[k].ref + slot[k].next, (slot[k].count - slot[k].next) * sizeof (uint32_t));
+    n += slot[k].count - slot[k].next;
+    slot[k].next = slot[k].count = 0;
+    pthread_mutex_unlock (&slot[k].lock);
+  }
+  if (n == 0) return 0;
+
+  return giveBack (p_sb, nClust, n);
+}
+
+/**
+ *  \brief Get the run of data clusters of the group of a data cluster.
+ *
+ *  \param nClust logical number of the data cluster
+ *  \param p_start pointer to the location where the reference of the first data cluster of the group is to be stored
+ *  \param p_end pointer to the location where the reference past the last data cluster of the group is to be stored
+ *
+ *  \return \c true, if the allocation groups are open, or \c false, otherwise
+ */
+
+bool soGetGroupRange (uint32_t nClust, uint32_t *p_start, uint32_t *p_end)
+{
+  if (!__atomic_load_n (&agOpen, __ATOMIC_ACQUIRE) || (nClust >= nTotal)) return false;
+
+  *p_start = nClust / AG_CLUSTERS * AG_CLUSTERS;
+  *p_end = (nTotal - *p_start < AG_CLUSTERS) ? nTotal : *p_start + AG_CLUSTERS;
+
+  return true;
+}
+
+/*
+ *  Internal functions
+ */
+
+/*
+ *  Initialize the slots of the reservations and the key which releases them.
+ */
+
+static void initSlots (void)
+{
+  uint32_t k;                                    /* counting variable */
+
+  for (k = 0; k < AG_SLOTS; k++)
+  { pthread_mutex_init (&slot[k].lock, NULL);
+    slot[k].owned = 0;
+    slot[k].group = UINT32_MAX;
+    slot[k].next = slot[k].count = 0;
+  }
+  pthread_key_create (&slotKey, releaseSlot);
+}
+
+/*
+ *  Release the slot of a thread which exits: the clusters reserved in it are kept for the next owner.
+ */
+
+static void releaseSlot (void *arg)
+{
+  __atomic_store_n (&((SOResSlot *) arg)->owned, 0, __ATOMIC_RELEASE);
+}
+
+/*
+ *  Get the slot owned by the calling thread, claiming a free one the first time (NULL, if there is none).
+ */
+
+static SOResSlot *ownSlot (void)
+{
+  int expected;                                  /* value of a free slot */
+  uint32_t k;                                    /* counting variable */
+
+  if (mySlot >= 0) return &slot[mySlot];
+
+  pthread_once (&slotInit, initSlots);
+  for (k = 0; k < AG_SLOTS; k++)
+  { expected = 0;
+    if (__atomic_compare_exchange_n (&slot[k].owned, &expected, 1, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+       { mySlot = (int) k;
+         pthread_setspecific (slotKey, &slot[k]);
+         return &slot[k];
+       }
+  }
+
+  return NULL;
+}
+
+/*
+ *  Insert the references of a group of clusters into the bitmap table, each block of it being loaded and stored only
+ *  once, and account them as free in the superblock.
+ */
+
+static int giveBack (SOSuperBlock *p_sb, uint32_t *nClust, uint32_t n)
+{
+  unsigned char *fcBMapT;                        /* pointer to a block of the bitmap table */
+  uint32_t nBlk, nByte, nBit;                    /* location of a reference in the bitmap table */
+  uint32_t first, last;                          /* indexes of the references of a block */
+  int stat;                                      /* status of operation */
+
+  qsort (nClust, n, sizeof (uint32_t), cmpClust);
+  for (first = 0; first < n; first = last)
+  { if ((stat = soConvertRefBMapT (nClust[first], &nBlk, &nByte, &nBit)) != 0) return stat;
+    if ((stat = soLoadBlockBMapT (nBlk)) != 0) return stat;
+    if ((fcBMapT = soGetBlockBMapT ()) == NULL) return -ELIBBAD;
+    for (last = first; (last < n) && (nClust[last] / BITS_PER_BLOCK == nBlk); last++)
+    { fcBMapT[(nClust[last] % BITS_PER_BLOCK) / 8] |= 0x80 >> (nClust[last] % 8);
+      soUpdateFreeSummary (nClust[last], 1);
+    }
+    if ((stat = soStoreBlockBMapT ()) != 0) return stat;
+  }
+  p_sb->dzone_free += n;
+
+  return soStoreSuperBlock ();
+}
+
+/*
+ *  Compare two data cluster references (for sorting).
+ */
+
+static int cmpClust (const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+
+  return (x > y) - (x < y);
+}
@@ -0,0 +1,163 @@
+/**
+ *  \file sofs_allocgroup.h (interface file)
+ *
+ *  \brief Allocation groups of the data zone and per-thread reservations of free data clusters.
+ *
+ *  The data zone is split into allocation groups, each one made of the data clusters described by a block of the
+ *  bitmap table to free data clusters, whose number of free clusters is kept by the summary of the free data clusters
+ *  and which keep in memory a cursor where the search for free clusters goes on. They are built when the file system is
+ *  mounted, if it is so set.
+ *
+ *  Each thread draws from a single group, at a time, a reservation of up to \c AG_RESERVE free data clusters, which
+ *  are taken from the bitmap table, cleaned and accounted as no longer free in the superblock all at once. The clusters
+ *  it allocates afterwards are taken from its reservation without the lock of the superblock, nor any access to the
+ *  shared metadata, as long as there is no hint, or the reserved cluster that is next follows the hint, so that the
+ *  files written by a thread stay within its group and are laid out contiguously. A thread keeps drawing from its group
+ *  while there are free clusters in it, and then moves to the group with most. The reservation of a thread which
+ *  exits is inherited by the next one.
+ *
+ *  The reserved clusters are given back to the bitmap table when the file system runs out of free clusters and when
+ *  the groups are closed, before the file system is unmounted; they are lost after an unclean shutdown, until the
+ *  consistency of the file system is checked.
+ *
+ *  All operations, but setting, opening, closing and taking clusters from a reservation, are supposed to be called
+ *  with the lock of the superblock held.
+ *
+ *  The operations are:
+ *      \li enable or disable the allocation groups the next time they are opened
+ *      \li build the allocation groups of the mounted file system
+ *      \li give back the reserved clusters and release the allocation groups
+ *      \li take free data clusters from the reservation of the calling thread
+ *      \li get the run of the bitmap table where the next reservation of the calling thread is to be drawn from
+ *      \li store a new reservation for the calling thread
+ *      \li give back all reserved clusters to the bitmap table
+ *      \li get the run of data clusters of the group of a data cluster.
+ *
+ *  \remarks In case an error occurs, all functions return a negative value which is the symmetric of the system error
+ *           that better represents the error cause.
+ *           (execute command <em>man errno</em> to get the list of system errors)
+ */
+
+#ifndef SOFS_ALLOCGROUP_H_
+#define SOFS_ALLOCGROUP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sofs_const.h"
+#include "sofs_superblock.h"
+
+/** \brief number of data clusters of an allocation group (those described by a block of the bitmap table) */
+#define AG_CLUSTERS  BITS_PER_BLOCK
+/** \brief maximum number of free data clusters reserved by a thread at a time (a word of the bitmap table) */
+#define AG_RESERVE   64
+/** \brief maximum number of threads holding reservations */
+#define AG_SLOTS     32
+
+/**
+ *  \brief Enable or disable the allocation groups the next time they are opened.
+ *
+ *  It is disabled by default.
+ *
+ *  \param on signals if the data clusters are to be allocated from allocation groups through per-thread reservations
+ */
+
+extern void soSetAllocGroups (bool on);
+
+/**
+ *  \brief Build the allocation groups of the mounted file system.
+ *
+ *  The number of free clusters of each group is got from the summary of the free data clusters, which must be built
+ *  beforehand. Nothing is done if the allocation groups are not enabled.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the summary of the free data clusters is not built
+ *  \return -\c EBUSY, if the allocation groups are already open
+ *  \return -\c ENOMEM, if there is no memory for the allocation groups
+ *  \return -<em>other specific error</em> issued by \e soLoadSuperBlock
+ */
+
+extern int soOpenAllocGroups (void);
+
+/**
+ *  \brief Give back the reserved clusters and release the allocation groups.
+ *
+ *  Nothing is done if the allocation groups are not open.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -<em>other specific error</em> issued by \e soReclaimReserved
+ */
+
+extern int soCloseAllocGroups (void);
+
+/**
+ *  \brief Take free data clusters from the reservation of the calling thread.
+ *
+ *  The clusters are taken in order for as long as there is no hint, or, for the first one, it follows the hint and,
+ *  for the others, the one taken before. When clusters anywhere in the group are accepted, the reservation must have
+ *  been drawn from the group of the hint. The clusters taken are clean and already accounted as not free.
+ *
+ *  \param hint logical number of the data cluster the clusters should follow (\c NULL_CLUSTER, if there is none)
+ *  \param inGroup signals if any cluster of the group of the hint is accepted, rather than only the next one
+ *  \param count number of data clusters wanted
+ *  \param nClust pointer to the array where the logical numbers of the data clusters are to be stored
+ *  \param p_n pointer to the number of clusters already stored in the array, which is updated
+ */
+
+extern void soTakeReserved (uint32_t hint, bool inGroup, uint32_t count, uint32_t *nClust, uint32_t *p_n);
+
+/**
+ *  \brief Get the run of the bitmap table where the next reservation of the calling thread is to be drawn from.
+ *
+ *  It starts at the cursor of the group of the thread, while it has free clusters, or of the group with most of them,
+ *  otherwise, and ends with the group.
+ *
+ *  \param p_start pointer to the location where the reference of the first data cluster of the run is to be stored
+ *  \param p_end pointer to the location where the reference past the last data cluster of the run is to be stored
+ *
+ *  \return \c true, if there is such a run, or \c false, if the allocation groups are not open, the calling thread
+ *          may hold no reservation, or no group has free clusters in the bitmap table
+ */
+
+extern bool soGetReserveRange (uint32_t *p_start, uint32_t *p_end);
+
+/**
+ *  \brief Store a new reservation for the calling thread.
+ *
+ *  The reservation must be empty and the clusters must have been drawn from the run got by \e soGetReserveRange, in
+ *  order, and be already clean and accounted as not free.
+ *
+ *  \param nClust pointer to the array of the logical numbers of the data clusters
+ *  \param n number of data clusters (at most \c AG_RESERVE)
+ *  \param pos reference past the last data cluster examined in the bitmap table, where the cursor of the group is left
+ */
+
+extern void soPutReserved (const uint32_t *nClust, uint32_t n, uint32_t pos);
+
+/**
+ *  \brief Give back all reserved clusters to the bitmap table.
+ *
+ *  The reservations of all threads are emptied and the clusters are accounted as free again in the superblock.
+ *
+ *  \param p_sb pointer to a buffer where the superblock data is stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -<em>other specific error</em> issued by \e soLoadBlockBMapT, \e soStoreBlockBMapT or
+ *          \e soStoreSuperBlock
+ */
+
+extern int soReclaimReserved (SOSuperBlock *p_sb);
+
+/**
+ *  \brief Get the run of data clusters of the group of a data cluster.
+ *
+ *  \param nClust logical number of the data cluster
+ *  \param p_start pointer to the location where the reference of the first data cluster of the group is to be stored
+ *  \param p_end pointer to the location where the reference past the last data cluster of the group is to be stored
+ *
+ *  \return \c true, if the allocation groups are open, or \c false, otherwise
+ */
+
+extern bool soGetGroupRange (uint32_t nClust, uint32_t *p_start, uint32_t *p_end);
+
+#endif /* SOFS_ALLOCGROUP_H_ */
@@ -0,0 +1,223 @@
+/**
+ *  \file sofs_atime.c (implementation file)
+ *
+ *  \brief Coalesced update of the time of last access of inodes.
+ *
+ *  The times of last access which were not written yet are kept in a direct mapped table, indexed by the number of the
+ *  inode modulo its size, each element recording when the time was first kept, so that it is written after
+ *  \c ATIME_DELAY seconds at most. An inode whose element is taken by another one has its time written straight
+ *  away. The table is accessed in mutual exclusion, the table of inodes being accessed outside the critical region.
+ *
+ *  The operations are:
+ *      \li set the policy of update of the time of last access
+ *      \li get the time of last access to be reported on reading an inode
+ *      \li forget the time of last access of an inode that was written
+ *      \li write the time of last access of an inode into the table of inodes
+ *      \li write the times of last access of all inodes into the table of inodes.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "sofs_probe.h"
+#include "sofs_inode.h"
+#include "sofs_basicoper.h"
+#include "sofs_atime.h"
+
+/*
+ *  Internal data structure
+ */
+
+/** \brief element of the table of times of last access */
+typedef struct soAtime
+{
+  /** \brief signals if the element holds a time which was not written yet */
+  bool used;
+  /** \brief number of the inode */
+  uint32_t nInode;
+  /** \brief time of last access */
+  uint32_t atime;
+  /** \brief time when the element was taken */
+  uint32_t since;
+} SOAtime;
+
+/** \brief table of times of last access */
+static SOAtime atTable[ATIME_SLOTS];
+/** \brief access lock to the table of times of last access */
+static pthread_mutex_t atCR = PTHREAD_MUTEX_INITIALIZER;
+/** \brief policy of update of the time of last access */
+static int atPolicy = ATIME_STRICT;
+
+/**
+ *  \brief Set the policy of update of the time of last access.
+ *
+ *  \param policy policy of update (ATIME_STRICT, ATIME_RELATIME, ATIME_NONE)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the policy is invalid
+ */
+
+int soSetAtimePolicy (int policy)
+{
+  soColorProbe (805, "07;31", "soSetAtimePolicy (%d)\n", policy);
+
+  if ((policy != ATIME_STRICT) && (policy != ATIME_RELATIME) && (policy != ATIME_NONE))
+     return -EINVAL;
+  atPolicy = policy;
+
+  return 0;
+}
+
+/**
+ *  \brief Get the time of last access to be reported on reading an inode.
+ *
+ *  The inode is supposed to be in use. The time is updated, according to the policy, and either kept in internal
+ *  storage or, if it has been kept for too long or there is no room to keep it, handed to the caller for it to be
+ *  written into the table of inodes.
+ *
+ *  \param nInode number of the inode
+ *  \param p_inode pointer to the inode as stored in the table of inodes
+ *  \param p_atime pointer to the location where the time of last access to be reported is to be stored
+ *
+ *  \return \c true, if the time must be written into the table of inodes by the caller
+ *  \return \c false, otherwise
+ */
+
+bool soAtimeAccess (uint32_t nInode, const SOInode *p_inode, uint32_t *p_atime)
+{
+  SOAtime *p_at;                                 /* pointer to the element of the table */
+  uint32_t now, cur;                             /* current time and time of last access */
+  bool kept, update, store;                      /* state of the element and decisions */
+
+  now = (uint32_t) time (NULL);
+  store = false;
+
+  pthread_mutex_lock (&atCR);
+  p_at = &atTable[nInode % ATIME_SLOTS];
+  kept = p_at->used && (p_at->nInode == nInode);
+  cur = p_inode->vD1.atime;
+  if (kept && (p_at->atime > cur))
+     cur = p_at->atime;
+  switch (atPolicy)
+  { case ATIME_STRICT:   update = (cur < now);
+                         break;
+    case ATIME_RELATIME: update = (cur <= p_inode->vD2.mtime) || (now >= cur + ATIME_REL_AGE);
+                         break;
+    default:             update = false;
+  }
+  if (update) cur = now;
+  if (kept)
+     { p_at->atime = cur;
+       if (now >= p_at->since + ATIME_DELAY)     /* it has been kept for too long */
+          { p_at->used = false;
+            store = true;
+          }
+     }
+     else if (update && !p_at->used)
+             { p_at->used = true;
+               p_at->nInode = nInode;
+               p_at->atime = cur;
+               p_at->since = now;
+             }
+     else if (update)                            /* the element is taken by another inode */
+             store = true;
+  pthread_mutex_unlock (&atCR);
+  *p_atime = cur;
+
+  return store;
+}
+
+/**
+ *  \brief Forget the time of last access of an inode that was written.
+ *
+ *  It must be called when the inode is written into the table of inodes, the time of last access being then set.
+ *
+ *  \param nInode number of the inode
+ */
+
+void soAtimeDrop (uint32_t nInode)
+{
+  SOAtime *p_at;                                 /* pointer to the element of the table */
+
+  pthread_mutex_lock (&atCR);
+  p_at = &atTable[nInode % ATIME_SLOTS];
+  if (p_at->used && (p_at->nInode == nInode))
+     p_at->used = false;
+  pthread_mutex_unlock (&atCR);
+}
+
+/**
+ *  \brief Write the time of last access of an inode into the table of inodes.
+ *
+ *  Nothing is done if it has already been written.
+ *
+ *  \param nInode number of the inode
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -<em>other specific error</em> issued by \e soConvertRefInT, \e soLoadBlockInT or \e soStoreBlockInT
+ */
+
+int soAtimeSync (uint32_t nInode)
+{
+  soColorProbe (806, "07;31", "soAtimeSync (%"PRIu32")\n", nInode);
+
+  SOAtime *p_at;                                 /* pointer to the element of the table */
+  SOInode *p_inode;                              /* pointer to the inode in the table of inodes */
+  uint32_t atime, nBlk, offset;                  /* time of last access and location of the inode */
+  bool kept;                                     /* state of the element */
+  int stat;                                      /* status of operation */
+
+  pthread_mutex_lock (&atCR);
+  p_at = &atTable[nInode % ATIME_SLOTS];
+  if ((kept = p_at->used && (p_at->nInode == nInode)))
+     { atime = p_at->atime;
+       p_at->used = false;
+     }
+  pthread_mutex_unlock (&atCR);
+  if (!kept) return 0;
+
+  if ((stat = soConvertRefInT (nInode, &nBlk, &offset)) != 0)
+     return stat;
+  if ((stat = soLoadBlockInT (nBlk)) != 0)
+     return stat;
+  p_inode = soGetBlockInT () + offset;
+  if ((p_inode->mode & INODE_FREE) || ((p_inode->mode & INODE_TYPE_MASK) == 0) || (p_inode->vD1.atime >= atime))
+     return 0;                                   /* the inode was freed or written meanwhile */
+  p_inode->vD1.atime = atime;
+
+  return soStoreBlockInT ();
+}
+
+/**
+ *  \brief Write the times of last access of all inodes into the table of inodes.
+ *
+ *  No other operation may be in progress (it is supposed to be called when the file system is unmounted).
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -<em>first specific error</em> issued by \e soAtimeSync
+ */
+
+int soAtimeSyncAll (void)
+{
+  soColorProbe (807, "07;31", "soAtimeSyncAll ()\n");
+
+  uint32_t i, nInode;                            /* element index and number of the inode */
+  bool kept;                                     /* state of the element */
+  int stat, first;                               /* status of operation */
+
+  first = 0;
+  for (i = 0; i < ATIME_SLOTS; i++)
+  { pthread_mutex_lock (&atCR);
+    kept = atTable[i].used;
+    nInode = atTable[i].nInode;
+    pthread_mutex_unlock (&atCR);
+    if (kept && ((stat = soAtimeSync (nInode)) != 0) && (first == 0))
+       first = stat;
+  }
+
+  return first;
+}
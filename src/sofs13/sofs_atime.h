@@ -0,0 +1,112 @@
+/**
+ *  \file sofs_atime.h (interface file)
+ *
+ *  \brief Coalesced update of the time of last access of inodes.
+ *
+ *  Reading an inode in use sets its <em>time of last file access</em>, which, when written straight away, makes every
+ *  read of a file write a block of the table of inodes. Instead, the new time is kept in internal storage, reported by
+ *  the subsequent reads of the inode, and only written into the table of inodes when the inode is next read after
+ *  \c ATIME_DELAY seconds, when it is written for some other reason, or when it is synchronized. Which accesses update
+ *  the time is chosen by a policy, set when the file system is mounted.
+ *
+ *  The caller must hold the lock of the inode, in exclusion for synchronizing it. Times which were not written yet are
+ *  lost if the file system is not properly unmounted.
+ *
+ *  The operations are:
+ *      \li set the policy of update of the time of last access
+ *      \li get the time of last access to be reported on reading an inode
+ *      \li forget the time of last access of an inode that was written
+ *      \li write the time of last access of an inode into the table of inodes
+ *      \li write the times of last access of all inodes into the table of inodes.
+ *
+ *  \remarks In case an error occurs, all functions return a negative value which is the symmetric of the system error
+ *           that better represents the error cause.
+ *           (execute command <em>man errno</em> to get the list of system errors)
+ */
+
+#ifndef SOFS_ATIME_H_
+#define SOFS_ATIME_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sofs_inode.h"
+
+/** \brief policy: every access updates the time of last access */
+#define ATIME_STRICT    0
+/** \brief policy: an access updates the time of last access if it is not later than the time of last modification,
+ *         or older than \c ATIME_REL_AGE seconds */
+#define ATIME_RELATIME  1
+/** \brief policy: the time of last access is never updated */
+#define ATIME_NONE      2
+
+/** \brief age (in seconds) of the time of last access after which it is updated under the relative policy */
+#define ATIME_REL_AGE  (24 * 60 * 60)
+/** \brief maximum delay (in seconds) of the writing of a time of last access that was updated */
+#define ATIME_DELAY    30
+/** \brief number of inodes whose time of last access may be kept in internal storage */
+#define ATIME_SLOTS    256
+
+/**
+ *  \brief Set the policy of update of the time of last access.
+ *
+ *  \param policy policy of update (ATIME_STRICT, ATIME_RELATIME, ATIME_NONE)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the policy is invalid
+ */
+
+extern int soSetAtimePolicy (int policy);
+
+/**
+ *  \brief Get the time of last access to be reported on reading an inode.
+ *
+ *  The inode is supposed to be in use. The time is updated, according to the policy, and either kept in internal
+ *  storage or, if it has been kept for too long or there is no room to keep it, handed to the caller for it to be
+ *  written into the table of inodes.
+ *
+ *  \param nInode number of the inode
+ *  \param p_inode pointer to the inode as stored in the table of inodes
+ *  \param p_atime pointer to the location where the time of last access to be reported is to be stored
+ *
+ *  \return \c true, if the time must be written into the table of inodes by the caller
+ *  \return \c false, otherwise
+ */
+
+extern bool soAtimeAccess (uint32_t nInode, const SOInode *p_inode, uint32_t *p_atime);
+
+/**
+ *  \brief Forget the time of last access of an inode that was written.
+ *
+ *  It must be called when the inode is written into the table of inodes, the time of last access being then set.
+ *
+ *  \param nInode number of the inode
+ */
+
+extern void soAtimeDrop (uint32_t nInode);
+
+/**
+ *  \brief Write the time of last access of an inode into the table of inodes.
+ *
+ *  Nothing is done if it has already been written.
+ *
+ *  \param nInode number of the inode
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -<em>other specific error</em> issued by \e soConvertRefInT, \e soLoadBlockInT or \e soStoreBlockInT
+ */
+
+extern int soAtimeSync (uint32_t nInode);
+
+/**
+ *  \brief Write the times of last access of all inodes into the table of inodes.
+ *
+ *  No other operation may be in progress (it is supposed to be called when the file system is unmounted).
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -<em>first specific error</em> issued by \e soAtimeSync
+ */
+
+extern int soAtimeSyncAll (void);
+
+#endif /* SOFS_ATIME_H_ */
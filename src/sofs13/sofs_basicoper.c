@@ -44,14 +44,62 @@
  *          storage
  *      \li get a pointer to the contents of a specific cluster of the table of direct references to data clusters
  *      \li store the contents of a specific cluster of the table of direct references to data clusters resident in
- *          internal storage to the storage device.
+ *          internal storage to the storage device
+ *      \li load the contents of a specific block of the table of inodes into a slot of internal storage and get a
+ *          handle to it
+ *      \li get a pointer to the contents of the block of the table of inodes held in a slot
+ *      \li store the contents of the block of the table of inodes held in a slot to the storage device
+ *      \li load the contents of a specific block of the table of cluster-to-inode mapping into a slot of internal
+ *          storage and get a handle to it
+ *      \li get a pointer to the contents of the block of the table of cluster-to-inode mapping held in a slot
+ *      \li store the contents of the block of the table of cluster-to-inode mapping held in a slot to the storage
+ *          device
+ *      \li load the contents of a specific block of the bitmap table to free data clusters into a slot of internal
+ *          storage and get a handle to it
+ *      \li get a pointer to the contents of the block of the bitmap table to free data clusters held in a slot
+ *      \li store the contents of the block of the bitmap table to free data clusters held in a slot to the storage
+ *          device
+ *      \li load the contents of a specific cluster of references to data clusters into a slot of internal storage and
+ *          get a handle to it
+ *      \li get a pointer to the contents of the cluster of references to data clusters held in a slot
+ *      \li store the contents of the cluster of references to data clusters held in a slot to the storage device
+ *      \li lock the superblock for the manipulation of the lists of free inodes and free data clusters
+ *      \li unlock the superblock
+ *      \li open a transaction
+ *      \li commit a transaction
+ *      \li carry out at once the stores put off by transactions
+ *      \li check if no transaction is open.
+ *
+ *  Besides the single storage area of each kind, every thread has a few slots of each kind, managed on a least
+ *  recently used basis, so that alternating access to several blocks or clusters does not reload them.
+ *
+ *  Every thread has its own internal storage for the blocks and clusters of metadata, so that operations on different
+ *  files may proceed concurrently. The copy a thread holds is refreshed on load whenever any other thread has stored
+ *  metadata in the meantime, and, on store, only the entries the thread has changed since it last read the block or
+ *  cluster are merged into the current contents. Conflicting changes to the same entry are supposed to be excluded by
+ *  the caller: the superblock lock for the free lists and the metadata they thread through, a lock per inode for the
+ *  rest.
+ *
+ *  Within a transaction, the store of the superblock is only flagged and carried out on commit, once for all the
+ *  transactions that overlap. The stores of blocks of the tables made while the superblock is locked are flagged as
+ *  well, in the storage area or the slot, and carried out when it is reassigned to another block, when the thread gets
+ *  the same block through a storage area of another kind (so that its own copies never diverge), or when it unlocks the
+ *  superblock, at the latest: other threads, which only manipulate the free lists while holding the lock, always find
+ *  them up to date.
+ *
+ *  When the journal is open (see sofs_journal.h), every block of the superblock or of the tables that is stored is
+ *  logged in its running transaction, which is committed once no transaction is open any longer, or straight away,
+ *  if the block is stored outside transactions.
  *
  *  \author António Rui Borges - August 2010 - September 2013
  */
 
 #include <stdio.h>
+#include <string.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <time.h>
+#include <pthread.h>
 
 #include "sofs_probe.h"
 #include "sofs_const.h"
@@ -60,12 +108,14 @@
 #include "sofs_inode.h"
 #include "sofs_datacluster.h"
 #include "sofs_direntry.h"
+#include "sofs_basicoper.h"
+#include "sofs_journal.h"
 
 /*
  *  Internal data structure
  */
 
-/** \brief Storage area for superblock */
+/** \brief Storage area for superblock (shared by all threads) */
 static SOSuperBlock sb;
 /** \brief area validation: -1 - an error has occurred while reading or writing superblock data
  *                           0 - superblock data has not been read yet
@@ -74,64 +124,238 @@ static SOSuperBlock sb;
 static int sbLoaded = 0;
 /** \brief status of reading or writing superblock data */
 static int sbError = 0;
-
-/** \brief storage area for one block of the table of inodes */
-static SOInode inode[IPB];
+/** \brief access lock to the superblock (it is recursive, since the operations on the free lists nest) */
+static pthread_mutex_t sbCR;
+/** \brief initialization control of the access lock to the superblock */
+static pthread_once_t sbCROnce = PTHREAD_ONCE_INIT;
+
+/** \brief access lock to the metadata shared by all threads, while it is merged and stored */
+static pthread_mutex_t metaCR = PTHREAD_MUTEX_INITIALIZER;
+/** \brief number of stores of blocks and clusters of metadata carried out so far */
+static uint32_t metaStamp = 0;
+
+/** \brief number of threads with a transaction open */
+static uint32_t txOpen = 0;
+/** \brief signals if the store of the superblock has been put off */
+static int sbPending = 0;
+/** \brief time of the last store of the superblock */
+static time_t sbStored = 0;
+/** \brief nesting depth of the transactions of the thread */
+static __thread uint32_t txDepth = 0;
+/** \brief number of times the thread has locked the superblock without unlocking it */
+static __thread uint32_t sbDepth = 0;
+/** \brief status of the first store put off by the thread which failed since its transaction was opened */
+static __thread int txError = 0;
+
+/* storage areas and sets of slots with stores put off */
+
+/** \brief single storage area for a block of the table of inodes */
+#define PEND_INT     0x01
+/** \brief single storage area for a block of the table of cluster-to-inode mapping */
+#define PEND_CTINMT  0x02
+/** \brief single storage area for a block of the bitmap table to free data clusters */
+#define PEND_BMAPT   0x04
+/** \brief slots for blocks of the table of inodes */
+#define PEND_INTH    0x08
+/** \brief slots for blocks of the table of cluster-to-inode mapping */
+#define PEND_CTINMTH 0x10
+/** \brief slots for blocks of the bitmap table to free data clusters */
+#define PEND_BMAPTH  0x20
+/** \brief all of them */
+#define PEND_ALL     0x3F
+
+/** \brief storage areas and sets of slots of the thread with stores put off */
+static __thread uint32_t areaPending = 0;
+
+/** \brief maximum number of clusters of references pinned in the buffercache by all threads together (the buffercache
+ *         refuses sooner, with -ENOBUFS, a pin which would leave too few nodes to be replaced) */
+#define MAX_REF_PINS  8
+/** \brief number of clusters of references currently pinned in the buffercache */
+static uint32_t refPins = 0;
+
+/** \brief storage area for one block of the table of inodes (one per thread) */
+static __thread SOInode inode[IPB];
+/** \brief contents of the block of the table of inodes when it was last read or written */
+static __thread SOInode inodeOrig[IPB];
 /** \brief validation area: -2 - an error occurred while reading or writing a data block
  *                          -1 - no block of the table of inodes has been read yet
  *                           * - logical block number of table of inodes that has been read
  */
-static int nBlkInTLoaded = -1;
+static __thread int nBlkInTLoaded = -1;
 /** \brief status of reading or writing a data block of the table of inodes */
-static int intError = 0;
-
-/** \brief storage area for a block of the table of cluster-to-inode mapping */
-static uint32_t blockCTInMT[RPB];
+static __thread int intError = 0;
+/** \brief number of stores of metadata when the block of the table of inodes was last read or written */
+static __thread uint32_t intStamp = 0;
+
+/** \brief storage area for a block of the table of cluster-to-inode mapping (one per thread) */
+static __thread uint32_t blockCTInMT[RPB];
+/** \brief contents of the block of the table of cluster-to-inode mapping when it was last read or written */
+static __thread uint32_t blockCTInMTOrig[RPB];
 /** \brief validation area: -2 - an error occurred while reading or writing a data block
  *                          -1 - no block of the table of cluster-to-inode mapping has been read yet
  *                           * - logic block number of table of cluster-to-inode mapping that has been read
  */
-static int nBlkCTInMTLoaded = -1;
+static __thread int nBlkCTInMTLoaded = -1;
 /** \brief status of reading or writing a data block of the table of cluster-to-inode mapping */
-static int ctinmtError = 0;
-
-/** \brief storage area for one block of the bitmap table to free data clusters */
-static unsigned char bMap[BLOCK_SIZE];
+static __thread int ctinmtError = 0;
+/** \brief number of stores of metadata when the block of the table of cluster-to-inode mapping was last read or
+ *         written */
+static __thread uint32_t ctinmtStamp = 0;
+
+/** \brief storage area for one block of the bitmap table to free data clusters (one per thread) */
+static __thread unsigned char bMap[BLOCK_SIZE];
+/** \brief contents of the block of the bitmap table to free data clusters when it was last read or written */
+static __thread unsigned char bMapOrig[BLOCK_SIZE];
 /** \brief validation area: -2 - an error occurred while reading or writing a data block
  *                          -1 - no block of the bitmap table to free data clusters has been read yet
  *                           * - logical block number of the bitmap table to free data clusters that has been read
  */
-static int nBlkBMapTLoaded = -1;
+static __thread int nBlkBMapTLoaded = -1;
 /** \brief status of reading or writing a data block of the bitmap table to free data clusters */
-static int bmaptError = 0;
-
-/** \brief storage area for a cluster of single indirect references to data clusters */
-static SODataClust sngIndRefClust;
+static __thread int bmaptError = 0;
+/** \brief number of stores of metadata when the block of the bitmap table to free data clusters was last read or
+ *         written */
+static __thread uint32_t bmaptStamp = 0;
+
+/** \brief storage area for a cluster of single indirect references to data clusters, when the buffercache is
+ *         unbuffered (one per thread) */
+static __thread SODataClust sngIndRefClust;
+/** \brief contents of the cluster of single indirect references to data clusters when it was last read or written */
+static __thread SODataClust sngIndRefClustOrig;
+/** \brief pointer to the cluster of single indirect references to data clusters: either it is pinned in the
+ *         buffercache, or it points to the storage area above */
+static __thread SODataClust *p_sngIndRefClust = NULL;
+/** \brief signals if the cluster of single indirect references to data clusters is pinned in the buffercache */
+static __thread int sircPinned = 0;
 /** \brief validation area: -2 - an error occurred while reading or writing a data cluster
  *                          -1 - no cluster of single indirect references to data clusters has been read yet
  *                           * - physical cluster number of single indirect references to data clusters that has been
  *                               read
  */
-static int nClustSIRef = 0;
+static __thread int nClustSIRef = 0;
 /** \brief status of reading or writing a cluster of single indirect references to data clusters */
-static int sircError = 0;
-
-/** \brief storage area for a cluster of direct references to data clusters */
-static SODataClust dirRefClust;
+static __thread int sircError = 0;
+/** \brief number of stores of metadata when the cluster of single indirect references to data clusters was last read
+ *         or written */
+static __thread uint32_t sircStamp = 0;
+
+/** \brief storage area for a cluster of direct references to data clusters, when the buffercache is unbuffered (one
+ *         per thread) */
+static __thread SODataClust dirRefClust;
+/** \brief contents of the cluster of direct references to data clusters when it was last read or written */
+static __thread SODataClust dirRefClustOrig;
+/** \brief pointer to the cluster of direct references to data clusters: either it is pinned in the buffercache, or it
+ *         points to the storage area above */
+static __thread SODataClust *p_dirRefClust = NULL;
+/** \brief signals if the cluster of direct references to data clusters is pinned in the buffercache */
+static __thread int drcPinned = 0;
 /** \brief validation area: -2 - an error occurred while reading or writing a data cluster
  *                          -1 - no cluster of direct references to data clusters has been read yet
  *                           * - physical cluster number of direct references to data clusters that has been read
  */
-static int nClustDRef = 0;
+static __thread int nClustDRef = 0;
 /** \brief status of reading or writing a cluster of direct references to data clusters */
-static int drcError = 0;
+static __thread int drcError = 0;
+/** \brief number of stores of metadata when the cluster of direct references to data clusters was last read or
+ *         written */
+static __thread uint32_t drcStamp = 0;
+
+/** \brief number of slots of internal storage for blocks of each table, per thread */
+#define BLOCK_SLOTS  4
+/** \brief number of slots of internal storage for clusters of references, per thread */
+#define CLUSTER_SLOTS  6
+
+/** \brief slot of internal storage for a block or a cluster of metadata */
+typedef struct soSlot
+{
+  /** \brief signals if the slot holds a block or a cluster */
+  int valid;
+  /** \brief physical number of the block or cluster held */
+  uint32_t n;
+  /** \brief generation of the slot: it is incremented whenever the slot is assigned to another block or cluster */
+  uint32_t gen;
+  /** \brief time of last use */
+  uint32_t used;
+  /** \brief number of stores of metadata when the contents was last read or written */
+  uint32_t stamp;
+  /** \brief signals if the cluster is pinned in the buffercache */
+  int pinned;
+  /** \brief signals if the store of the contents has been put off */
+  int pending;
+  /** \brief pointer to the contents: either the cluster pinned in the buffercache, or the local storage area */
+  void *p_data;
+} SOSlot;
+
+/** \brief set of slots for the blocks of a table */
+typedef struct soBlockSlots
+{
+  /** \brief slots */
+  SOSlot slot[BLOCK_SLOTS];
+  /** \brief local storage areas */
+  unsigned char data[BLOCK_SLOTS][BLOCK_SIZE];
+  /** \brief contents of the local storage areas when they were last read or written */
+  unsigned char orig[BLOCK_SLOTS][BLOCK_SIZE];
+  /** \brief clock for the time of last use */
+  uint32_t clock;
+} SOBlockSlots;
+
+/** \brief set of slots for the clusters of references */
+typedef struct soClusterSlots
+{
+  /** \brief slots */
+  SOSlot slot[CLUSTER_SLOTS];
+  /** \brief local storage areas */
+  SODataClust data[CLUSTER_SLOTS];
+  /** \brief contents of the local storage areas when they were last read or written */
+  SODataClust orig[CLUSTER_SLOTS];
+  /** \brief clock for the time of last use */
+  uint32_t clock;
+} SOClusterSlots;
+
+/** \brief handle to a slot: the index of the slot in the lower byte, its generation in the upper ones */
+#define HANDLE(i,gen)  (((gen) << 8) | (i))
+
+/** \brief slots for blocks of the table of inodes (one set per thread) */
+static __thread SOBlockSlots inTSlots;
+/** \brief slots for blocks of the table of cluster-to-inode mapping (one set per thread) */
+static __thread SOBlockSlots cTInMTSlots;
+/** \brief slots for blocks of the bitmap table to free data clusters (one set per thread) */
+static __thread SOBlockSlots bMapTSlots;
+/** \brief slots for clusters of references to data clusters (one set per thread) */
+static __thread SOClusterSlots refSlots;
+
+/* Allusion to internal functions */
+
+static void initSBLock (void);
+static int loadShared (uint32_t n, uint32_t nblks, void *buf, void *orig, uint32_t unit, int loaded, uint32_t *p_stamp);
+static int storeShared (uint32_t n, uint32_t nblks, void *buf, void *orig, uint32_t unit, uint32_t *p_stamp);
+static int pinRefClust (uint32_t nClust, SODataClust **pp_clust, SODataClust *p_local, SODataClust *p_orig, int nPrev,
+                        int *p_pinned, uint32_t *p_stamp);
+static int loadSlot (SOSlot *slot, uint32_t nSlots, uint32_t *p_clock, unsigned char *data, unsigned char *orig,
+                     uint32_t nblks, uint32_t unit, uint32_t n, uint32_t *p_h);
+static SOSlot *getSlot (SOSlot *slot, uint32_t nSlots, uint32_t h);
+static int storeSlot (SOSlot *slot, uint32_t nSlots, unsigned char *orig, uint32_t nblks, uint32_t unit, uint32_t h,
+                      uint32_t pend);
+static int flushSlots (SOSlot *slot, uint32_t nSlots, unsigned char *orig, uint32_t nblks, uint32_t unit);
+static int flushPending (uint32_t mask);
+static int storeSB (void);
+static int storeInT (void);
+static int storeCTInMT (void);
+static int storeBMapT (void);
+static int deferStore (void);
+static int commitAlone (void);
+static int commitJournal (void);
 
 /**
  *  \brief Load the contents of the superblock into internal storage.
  *
- *  Any type of previous error on loading / storing the superblock data will disable the operation.
+ *  Any type of previous error on loading / storing the superblock data will disable the operation. A file system
+ *  installed with data clusters of another size than \c CLUSTER_SIZE (which follows from the layout of its data zone)
+ *  is not loaded.
  *
  *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the magic number is the one characteristic of SOFS13, but the number of blocks of a data
+ *                      cluster is not \c BLOCKS_PER_CLUSTER
  *  \return -\c EBADF, if the device is not already opened
  *  \return -\c EIO, if it fails on reading or writing
  *  \return -\c ELIBBAD, if the buffercache is inconsistent or the superblock was not previously loaded on a previous
@@ -145,14 +369,25 @@ int soLoadSuperBlock (void)
 
   int stat;                                      /* status of operation */
 
-  if (sbError != 0) return sbError;              /* a previous error has occurred */
-  if (sbLoaded == 1) return 0;                   /* superblock has already been read */
-  stat = soReadCacheBlock (0, &sb);
-  if (stat == 0)
-     sbLoaded = 1;                               /* operation carried out with success */
-     else { sbLoaded = -1;
-            sbError = stat;                      /* an error has occurred while reading */
+  if (__atomic_load_n (&sbLoaded, __ATOMIC_ACQUIRE) == 1)
+     return 0;                                   /* superblock has already been read */
+  soLockSuperBlock ();
+  if ((stat = sbError) == 0)                     /* a previous error has occurred */
+     { if (sbLoaded != 1)
+          { stat = soReadCacheBlock (0, &sb);
+            if ((stat == 0) && (sb.magic == MAGIC_NUMBER) && !SB_CLUST_FITS (&sb))
+               stat = -EINVAL;                   /* another geometry: the error is not kept, so that it may be
+                                                    installed anew */
+               else if (stat == 0)
+                       { soSetBufferCacheLayout (sb.itable_start, sb.ciutable_start, sb.fctable_start, sb.dzone_start);
+                         __atomic_store_n (&sbLoaded, 1, __ATOMIC_RELEASE);  /* operation carried out with success */
+                       }
+                       else { sbLoaded = -1;
+                              sbError = stat;    /* an error has occurred while reading */
+                            }
           }
+     }
+  soUnlockSuperBlock ();
 
   return stat;
 }
@@ -179,7 +414,8 @@ SOSuperBlock *soGetSuperBlock (void)
 /**
  *  \brief Store the contents of the superblock resident in internal storage to the storage device.
  *
- *  Any type of previous / current error on loading / storing the superblock data will disable the operation.
+ *  Any type of previous / current error on loading / storing the superblock data will disable the operation. Within a
+ *  transaction, the store is put off until the transaction is committed.
  *
  *  \return <tt>0 (zero)</tt>, on success
  *  \return -\c EBADF, if the device is not already opened
@@ -195,17 +431,24 @@ int soStoreSuperBlock (void)
 
   int stat;                                      /* status of operation */
 
-  if (sbError != 0) return sbError;              /* a previous error has occurred */
+  soLockSuperBlock ();
+  if ((stat = sbError) != 0)                     /* a previous error has occurred */
+     { soUnlockSuperBlock ();
+       return stat;
+     }
   if (sbLoaded == 0)
      { sbLoaded = -1;
        sbError = -ELIBBAD;                       /* superblock has not been read yet */
+       soUnlockSuperBlock ();
        return sbError;
      }
-  stat = soWriteCacheBlock (0, &sb);
-  if (stat != 0)
-     { sbLoaded = -1;
-       sbError = stat;                           /* an error has occurred while writing */
+  if (txDepth > 0)
+     { sbPending = 1;                            /* the store is put off until the transaction is committed */
+       soUnlockSuperBlock ();
+       return 0;
      }
+  stat = storeSB ();
+  soUnlockSuperBlock ();
 
   return stat;
 }
@@ -270,8 +513,9 @@ int soLoadBlockInT (uint32_t nBlk)
   if (nBlk >= sb.itable_size) return -EINVAL;
 
   if (intError != 0) return intError;            /* a previous error has occurred */
-  if (nBlk == nBlkInTLoaded) return 0;           /* the block has already been read */
-  stat = soReadCacheBlock (sb.itable_start + nBlk, inode);
+  if ((stat = flushPending (PEND_INTH | (((int) nBlk != nBlkInTLoaded) ? PEND_INT : 0))) != 0) return stat;
+  stat = loadShared (sb.itable_start + nBlk, 1, inode, inodeOrig, sizeof (SOInode), (int) nBlk == nBlkInTLoaded,
+                     &intStamp);
   if (stat == 0)
      nBlkInTLoaded = nBlk;                       /* operation carried out with success */
      else { nBlkInTLoaded = -1;
@@ -317,8 +561,6 @@ int soStoreBlockInT (void)
 {
   soColorProbe (717, "07;31", "soStoreBlockInT ()\n");
 
-  int stat;                                      /* status of operation */
-
   if (intError != 0) return intError;            /* a previous error has occurred */
   if (nBlkInTLoaded < 0)
      { nBlkInTLoaded = -2;
@@ -326,13 +568,12 @@ int soStoreBlockInT (void)
                                                     read yet */
        return intError;
      }
-  stat = soWriteCacheBlock (sb.itable_start + nBlkInTLoaded, inode);
-  if (stat != 0)
-     { nBlkInTLoaded = -2;
-       intError = stat;                          /* an error has occurred while writing */
+  if (deferStore ())
+     { areaPending |= PEND_INT;                  /* the store is put off */
+       return 0;
      }
 
-  return stat;
+  return storeInT ();
 }
 
 /**
@@ -400,8 +641,9 @@ int soLoadBlockCTInMT (uint32_t nBlk)
   if (nBlk >= sb.ciutable_size) return -EINVAL;
 
   if (ctinmtError != 0) return ctinmtError;      /* a previous error has occurred */
-  if (nBlk == nBlkCTInMTLoaded) return 0;        /* the block has already been read */
-  stat = soReadCacheBlock (sb.ciutable_start + nBlk, blockCTInMT);
+  if ((stat = flushPending (PEND_CTINMTH | (((int) nBlk != nBlkCTInMTLoaded) ? PEND_CTINMT : 0))) != 0) return stat;
+  stat = loadShared (sb.ciutable_start + nBlk, 1, blockCTInMT, blockCTInMTOrig, sizeof (uint32_t),
+                     (int) nBlk == nBlkCTInMTLoaded, &ctinmtStamp);
   if (stat == 0)
      nBlkCTInMTLoaded = nBlk;                    /* operation carried out with success */
      else { nBlkCTInMTLoaded = -2;
@@ -448,8 +690,6 @@ int soStoreBlockCTInMT (void)
 {
   soColorProbe (721, "07;31", "soStoreBlockCTInMT ()\n");
 
-  int stat;                                      /* status of operation */
-
   if (ctinmtError != 0) return ctinmtError;      /* a previous error has occurred */
   if (nBlkCTInMTLoaded < 0)
      { nBlkCTInMTLoaded = -2;
@@ -457,13 +697,12 @@ int soStoreBlockCTInMT (void)
                                                     read yet */
        return ctinmtError;
      }
-  stat = soWriteCacheBlock (sb.ciutable_start + nBlkCTInMTLoaded, blockCTInMT);
-  if (stat != 0)
-     { nBlkCTInMTLoaded = -2;
-       ctinmtError = stat;                       /* an error has occurred while writing */
+  if (deferStore ())
+     { areaPending |= PEND_CTINMT;               /* the store is put off */
+       return 0;
      }
 
-  return stat;
+  return storeCTInMT ();
 }
 
 /**
@@ -528,8 +767,8 @@ int soLoadBlockBMapT (uint32_t nBlk)
   if (nBlk >= sb.fctable_size) return -EINVAL;
 
   if (bmaptError != 0) return bmaptError;        /* a previous error has occurred */
-  if (nBlk == nBlkBMapTLoaded) return 0;         /* the block has already been read */
-  stat = soReadCacheBlock (sb.fctable_start + nBlk, bMap);
+  if ((stat = flushPending (PEND_BMAPTH | (((int) nBlk != nBlkBMapTLoaded) ? PEND_BMAPT : 0))) != 0) return stat;
+  stat = loadShared (sb.fctable_start + nBlk, 1, bMap, bMapOrig, 1, (int) nBlk == nBlkBMapTLoaded, &bmaptStamp);
   if (stat == 0)
      nBlkBMapTLoaded = nBlk;                     /* operation carried out with success */
      else { nBlkBMapTLoaded = -1;
@@ -576,8 +815,6 @@ int soStoreBlockBMapT (void)
 {
   soColorProbe (725, "07;31", "soStoreBlockBMapT ()\n");
 
-  int stat;                                      /* status of operation */
-
   if (bmaptError != 0) return bmaptError;        /* a previous error has occurred */
   if (nBlkBMapTLoaded < 0)
      { nBlkBMapTLoaded = -2;
@@ -585,13 +822,12 @@ int soStoreBlockBMapT (void)
                                                     read yet */
        return bmaptError;
      }
-  stat = soWriteCacheBlock (sb.fctable_start + nBlkBMapTLoaded, bMap);
-  if (stat != 0)
-     { nBlkBMapTLoaded = -2;
-       bmaptError = stat;                        /* an error has occurred while writing */
+  if (deferStore ())
+     { areaPending |= PEND_BMAPT;                /* the store is put off */
+       return 0;
      }
 
-  return stat;
+  return storeBMapT ();
 }
 
 /**
@@ -693,8 +929,8 @@ int soLoadSngIndRefClust (uint32_t nClust)
      return -EINVAL;
 
   if (sircError != 0) return sircError;          /* a previous error has occurred */
-  if (nClust == nClustSIRef) return 0;           /* the cluster has already been read */
-  stat = soReadCacheCluster (nClust, &sngIndRefClust);
+  stat = pinRefClust (nClust, &p_sngIndRefClust, &sngIndRefClust, &sngIndRefClustOrig, nClustSIRef, &sircPinned,
+                      &sircStamp);
   if (stat == 0)
      nClustSIRef = nClust;                       /* operation carried out with success */
      else { nClustSIRef = -2;
@@ -721,7 +957,7 @@ SODataClust *soGetSngIndRefClust (void)
   soColorProbe (729, "07;31", "soGetSngIndRefClust ()\n");
 
   if (nClustSIRef >= 0)
-     return &sngIndRefClust;
+     return p_sngIndRefClust;
      else return NULL;
 }
 
@@ -753,7 +989,10 @@ int soStoreSngIndRefClust (void)
                                                     read yet */
        return sircError;
      }
-  stat = soWriteCacheCluster (nClustSIRef, &sngIndRefClust);
+  if (sircPinned)
+     stat = soMarkCacheClusterDirty (nClustSIRef);
+     else stat = storeShared (nClustSIRef, BLOCKS_PER_CLUSTER, &sngIndRefClust, &sngIndRefClustOrig,
+                              sizeof (uint32_t), &sircStamp);
   if (stat != 0)
      { nClustSIRef = -2;
        sircError = stat;                          /* an error has occurred while writing */
@@ -792,8 +1031,7 @@ int soLoadDirRefClust (uint32_t nClust)
      return -EINVAL;
 
   if (drcError != 0) return drcError;            /* a previous error has occurred */
-  if (nClust == nClustDRef) return 0;            /* the cluster has already been read */
-  stat = soReadCacheCluster (nClust, &dirRefClust);
+  stat = pinRefClust (nClust, &p_dirRefClust, &dirRefClust, &dirRefClustOrig, nClustDRef, &drcPinned, &drcStamp);
   if (stat == 0)
 	  nClustDRef = nClust;                       /* operation carried out with success */
      else { nClustDRef = -2;
@@ -819,7 +1057,7 @@ SODataClust *soGetDirRefClust (void)
   soColorProbe (732, "07;31", "soGetDirRefClust ()\n");
 
   if (nClustDRef >= 0)
-     return &dirRefClust;
+     return p_dirRefClust;
      else return NULL;
 }
 
@@ -851,7 +1089,10 @@ int soStoreDirRefClust (void)
                                                     read yet */
        return sircError;
      }
-  stat = soWriteCacheCluster (nClustDRef, &dirRefClust);
+  if (drcPinned)
+     stat = soMarkCacheClusterDirty (nClustDRef);
+     else stat = storeShared (nClustDRef, BLOCKS_PER_CLUSTER, &dirRefClust, &dirRefClustOrig, sizeof (uint32_t),
+                              &drcStamp);
   if (stat != 0)
      { nClustDRef = -2;
        drcError = stat;                          /* an error has occurred while writing */
@@ -859,3 +1100,836 @@ int soStoreDirRefClust (void)
 
   return stat;
 }
+
+/**
+ *  \brief Load the contents of a specific block of the table of inodes into a slot of internal storage.
+ *
+ *  If the block is already held in one of the slots of the calling thread, it is brought up to date, keeping the
+ *  changes not yet stored; otherwise, the slot least recently used is reassigned to it, any handle to that slot
+ *  becoming invalid.
+ *
+ *  \param nBlk logical number of the block to be read
+ *  \param p_h pointer to the location where the handle to the slot is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if logical block number is out of range or the pointer is \c NULL
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent or the superblock was not previously loaded on a previous
+ *                       store operation
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soLoadBlockInTH (uint32_t nBlk, uint32_t *p_h)
+{
+  soColorProbe (734, "07;31", "soLoadBlockInTH (%"PRIu32", %p)\n", nBlk, p_h);
+
+  int stat;                                      /* status of operation */
+
+  if ((stat = soLoadSuperBlock ()) != 0) return stat;
+  if ((nBlk >= sb.itable_size) || (p_h == NULL)) return -EINVAL;
+  if ((stat = flushPending (PEND_INT)) != 0) return stat;
+
+  return loadSlot (inTSlots.slot, BLOCK_SLOTS, &inTSlots.clock, inTSlots.data[0], inTSlots.orig[0], 1,
+                   sizeof (SOInode), sb.itable_start + nBlk, p_h);
+}
+
+/**
+ *  \brief Get a pointer to the contents of the block of the table of inodes held in a slot.
+ *
+ *  \param h handle to the slot
+ *
+ *  \return pointer to the block, on success
+ *  \return -\c NULL, if the handle is invalid
+ */
+
+SOInode *soGetBlockInTH (uint32_t h)
+{
+  soColorProbe (735, "07;31", "soGetBlockInTH (%"PRIu32")\n", h);
+
+  SOSlot *p;                                     /* pointer to the slot */
+
+  if ((p = getSlot (inTSlots.slot, BLOCK_SLOTS, h)) == NULL) return NULL;
+  return (SOInode *) p->p_data;
+}
+
+/**
+ *  \brief Store the contents of the block of the table of inodes held in a slot to the storage device.
+ *
+ *  Only the inodes changed since the block was last read or written are stored.
+ *
+ *  \param h handle to the slot
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the handle is invalid or the buffercache is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soStoreBlockInTH (uint32_t h)
+{
+  soColorProbe (736, "07;31", "soStoreBlockInTH (%"PRIu32")\n", h);
+
+  return storeSlot (inTSlots.slot, BLOCK_SLOTS, inTSlots.orig[0], 1, sizeof (SOInode), h, PEND_INTH);
+}
+
+/**
+ *  \brief Load the contents of a specific block of the table of cluster-to-inode mapping into a slot of internal
+ *         storage.
+ *
+ *  If the block is already held in one of the slots of the calling thread, it is brought up to date, keeping the
+ *  changes not yet stored; otherwise, the slot least recently used is reassigned to it, any handle to that slot
+ *  becoming invalid.
+ *
+ *  \param nBlk logic number of the block to be read
+ *  \param p_h pointer to the location where the handle to the slot is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if logic block number is out of range or the pointer is \c NULL
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent or the superblock was not previously loaded on a previous
+ *                       store operation
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soLoadBlockCTInMTH (uint32_t nBlk, uint32_t *p_h)
+{
+  soColorProbe (737, "07;31", "soLoadBlockCTInMTH (%"PRIu32", %p)\n", nBlk, p_h);
+
+  int stat;                                      /* status of operation */
+
+  if ((stat = soLoadSuperBlock ()) != 0) return stat;
+  if ((nBlk >= sb.ciutable_size) || (p_h == NULL)) return -EINVAL;
+  if ((stat = flushPending (PEND_CTINMT)) != 0) return stat;
+
+  return loadSlot (cTInMTSlots.slot, BLOCK_SLOTS, &cTInMTSlots.clock, cTInMTSlots.data[0], cTInMTSlots.orig[0], 1,
+                   sizeof (uint32_t), sb.ciutable_start + nBlk, p_h);
+}
+
+/**
+ *  \brief Get a pointer to the contents of the block of the table of cluster-to-inode mapping held in a slot.
+ *
+ *  \param h handle to the slot
+ *
+ *  \return pointer to the block, on success
+ *  \return -\c NULL, if the handle is invalid
+ */
+
+uint32_t *soGetBlockCTInMTH (uint32_t h)
+{
+  soColorProbe (738, "07;31", "soGetBlockCTInMTH (%"PRIu32")\n", h);
+
+  SOSlot *p;                                     /* pointer to the slot */
+
+  if ((p = getSlot (cTInMTSlots.slot, BLOCK_SLOTS, h)) == NULL) return NULL;
+  return (uint32_t *) p->p_data;
+}
+
+/**
+ *  \brief Store the contents of the block of the table of cluster-to-inode mapping held in a slot to the storage
+ *         device.
+ *
+ *  Only the entries changed since the block was last read or written are stored.
+ *
+ *  \param h handle to the slot
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the handle is invalid or the buffercache is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soStoreBlockCTInMTH (uint32_t h)
+{
+  soColorProbe (739, "07;31", "soStoreBlockCTInMTH (%"PRIu32")\n", h);
+
+  return storeSlot (cTInMTSlots.slot, BLOCK_SLOTS, cTInMTSlots.orig[0], 1, sizeof (uint32_t), h, PEND_CTINMTH);
+}
+
+/**
+ *  \brief Load the contents of a specific block of the bitmap table to free data clusters into a slot of internal
+ *         storage.
+ *
+ *  If the block is already held in one of the slots of the calling thread, it is brought up to date, keeping the
+ *  changes not yet stored; otherwise, the slot least recently used is reassigned to it, any handle to that slot
+ *  becoming invalid.
+ *
+ *  \param nBlk logical number of the block to be read
+ *  \param p_h pointer to the location where the handle to the slot is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if logical block number is out of range or the pointer is \c NULL
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent or the superblock was not previously loaded on a previous
+ *                       store operation
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soLoadBlockBMapTH (uint32_t nBlk, uint32_t *p_h)
+{
+  soColorProbe (740, "07;31", "soLoadBlockBMapTH (%"PRIu32", %p)\n", nBlk, p_h);
+
+  int stat;                                      /* status of operation */
+
+  if ((stat = soLoadSuperBlock ()) != 0) return stat;
+  if ((nBlk >= sb.fctable_size) || (p_h == NULL)) return -EINVAL;
+  if ((stat = flushPending (PEND_BMAPT)) != 0) return stat;
+
+  return loadSlot (bMapTSlots.slot, BLOCK_SLOTS, &bMapTSlots.clock, bMapTSlots.data[0], bMapTSlots.orig[0], 1, 1,
+                   sb.fctable_start + nBlk, p_h);
+}
+
+/**
+ *  \brief Get a pointer to the contents of the block of the bitmap table to free data clusters held in a slot.
+ *
+ *  \param h handle to the slot
+ *
+ *  \return pointer to the block, on success
+ *  \return -\c NULL, if the handle is invalid
+ */
+
+unsigned char *soGetBlockBMapTH (uint32_t h)
+{
+  soColorProbe (741, "07;31", "soGetBlockBMapTH (%"PRIu32")\n", h);
+
+  SOSlot *p;                                     /* pointer to the slot */
+
+  if ((p = getSlot (bMapTSlots.slot, BLOCK_SLOTS, h)) == NULL) return NULL;
+  return (unsigned char *) p->p_data;
+}
+
+/**
+ *  \brief Store the contents of the block of the bitmap table to free data clusters held in a slot to the storage
+ *         device.
+ *
+ *  Only the bytes changed since the block was last read or written are stored.
+ *
+ *  \param h handle to the slot
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the handle is invalid or the buffercache is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soStoreBlockBMapTH (uint32_t h)
+{
+  soColorProbe (742, "07;31", "soStoreBlockBMapTH (%"PRIu32")\n", h);
+
+  return storeSlot (bMapTSlots.slot, BLOCK_SLOTS, bMapTSlots.orig[0], 1, 1, h, PEND_BMAPTH);
+}
+
+/**
+ *  \brief Load the contents of a specific cluster of references to data clusters (single indirect or direct) into a
+ *         slot of internal storage.
+ *
+ *  If the cluster is already held in one of the slots of the calling thread, it is brought up to date, keeping the
+ *  changes not yet stored; otherwise, the slot least recently used is reassigned to it, any handle to that slot
+ *  becoming invalid. The cluster is pinned in the buffercache, if possible, and accessed in place.
+ *
+ *  \param nClust physical number of the cluster to be read
+ *  \param p_h pointer to the location where the handle to the slot is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if physical cluster number is out of range or the pointer is \c NULL
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent or the superblock was not previously loaded on a previous
+ *                       store operation
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soLoadRefClustH (uint32_t nClust, uint32_t *p_h)
+{
+  soColorProbe (743, "07;31", "soLoadRefClustH (%"PRIu32", %p)\n", nClust, p_h);
+
+  int stat;                                      /* status of operation */
+
+  if ((stat = soLoadSuperBlock ()) != 0) return stat;
+  if ((nClust < sb.dzone_start) || (((nClust - sb.dzone_start) % BLOCKS_PER_CLUSTER) != 0) ||
+      (nClust >= (sb.dzone_start + sb.dzone_total * BLOCKS_PER_CLUSTER)) || (p_h == NULL))
+     return -EINVAL;
+
+  return loadSlot (refSlots.slot, CLUSTER_SLOTS, &refSlots.clock, (unsigned char *) refSlots.data,
+                   (unsigned char *) refSlots.orig, BLOCKS_PER_CLUSTER, sizeof (uint32_t), nClust, p_h);
+}
+
+/**
+ *  \brief Get a pointer to the contents of the cluster of references to data clusters held in a slot.
+ *
+ *  \param h handle to the slot
+ *
+ *  \return pointer to the cluster, on success
+ *  \return -\c NULL, if the handle is invalid
+ */
+
+SODataClust *soGetRefClustH (uint32_t h)
+{
+  soColorProbe (744, "07;31", "soGetRefClustH (%"PRIu32")\n", h);
+
+  SOSlot *p;                                     /* pointer to the slot */
+
+  if ((p = getSlot (refSlots.slot, CLUSTER_SLOTS, h)) == NULL) return NULL;
+  return (SODataClust *) p->p_data;
+}
+
+/**
+ *  \brief Store the contents of the cluster of references to data clusters held in a slot to the storage device.
+ *
+ *  Only the references changed since the cluster was last read or written are stored.
+ *
+ *  \param h handle to the slot
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the handle is invalid or the buffercache is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soStoreRefClustH (uint32_t h)
+{
+  soColorProbe (745, "07;31", "soStoreRefClustH (%"PRIu32")\n", h);
+
+  return storeSlot (refSlots.slot, CLUSTER_SLOTS, (unsigned char *) refSlots.orig, BLOCKS_PER_CLUSTER,
+                    sizeof (uint32_t), h, 0);
+}
+
+/**
+ *  \brief Lock the superblock for the manipulation of the lists of free inodes and free data clusters.
+ *
+ *  The lock is recursive: it may be acquired again by the thread that already holds it. The operations which allocate
+ *  and free inodes and data clusters hold it throughout, so that the free lists, the free data clusters caches and the
+ *  metadata they thread through are changed by one thread at a time.
+ */
+
+void soLockSuperBlock (void)
+{
+  pthread_once (&sbCROnce, initSBLock);
+  pthread_mutex_lock (&sbCR);
+  sbDepth += 1;
+}
+
+/**
+ *  \brief Unlock the superblock.
+ *
+ *  When the thread releases the lock for the last time, the stores of blocks of the tables it put off meanwhile are
+ *  carried out, so that other threads find them up to date. The status of a failure is reported on commit.
+ */
+
+void soUnlockSuperBlock (void)
+{
+  int stat;                                      /* status of operation */
+
+  if ((sbDepth == 1) && ((stat = flushPending (PEND_ALL)) != 0) && (txError == 0))
+     txError = stat;
+  sbDepth -= 1;
+  pthread_mutex_unlock (&sbCR);
+}
+
+/**
+ *  \brief Open a transaction.
+ *
+ *  Transactions may be nested: only the outermost one is effective.
+ */
+
+void soBeginTransaction (void)
+{
+  soColorProbe (746, "07;31", "soBeginTransaction ()\n");
+
+  if (txDepth++ > 0) return;                     /* nested transaction */
+  soLockSuperBlock ();
+  txOpen += 1;
+  soUnlockSuperBlock ();
+}
+
+/**
+ *  \brief Commit a transaction.
+ *
+ *  The stores of metadata put off by the thread are carried out and so is the store of the superblock, if no
+ *  transaction of any other thread is open, or \c TX_WINDOW seconds have elapsed since it was last stored.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if no transaction is open
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call, either now or on any store put off since the
+ *          transaction was opened
+ */
+
+int soCommitTransaction (void)
+{
+  soColorProbe (747, "07;31", "soCommitTransaction ()\n");
+
+  int stat, st;                                  /* status of operation */
+
+  if (txDepth == 0) return -EINVAL;
+  if (--txDepth > 0) return 0;                   /* nested transaction */
+
+  soLockSuperBlock ();
+  stat = flushPending (PEND_ALL);
+  if (stat == 0) stat = txError;
+  txError = 0;
+  txOpen -= 1;
+  if (sbPending && ((txOpen == 0) || (time (NULL) - sbStored >= TX_WINDOW)) &&        /* group commit */
+      ((st = storeSB ()) != 0) && (stat == 0))
+     stat = st;
+  if ((txOpen == 0) && ((st = commitJournal ()) != 0) && (stat == 0))              /* all updates are complete */
+     stat = st;
+  soUnlockSuperBlock ();
+
+  return stat;
+}
+
+/**
+ *  \brief Carry out at once the stores put off by transactions.
+ *
+ *  The stores of metadata put off by the thread are carried out and so is the store of the superblock, if it was put
+ *  off by any thread: it is meant to be called before the storage device is synchronized.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soFlushTransactions (void)
+{
+  soColorProbe (748, "07;31", "soFlushTransactions ()\n");
+
+  int stat;                                      /* status of operation */
+
+  soLockSuperBlock ();
+  stat = flushPending (PEND_ALL);
+  if ((stat == 0) && sbPending)
+     stat = storeSB ();
+  if (stat == 0) stat = commitJournal ();
+  soUnlockSuperBlock ();
+
+  return stat;
+}
+
+/**
+ *  \brief Check if no transaction is open.
+ *
+ *  It tells whether the file system is idle, so that background work may be carried out without delaying the
+ *  operations in progress; the answer may be outdated as soon as it is given.
+ *
+ *  \return \c true, if no transaction of any thread is open, or \c false, otherwise
+ */
+
+bool soTransactionsIdle (void)
+{
+  bool idle;                                     /* signals if no transaction is open */
+
+  soLockSuperBlock ();
+  idle = (txOpen == 0);
+  soUnlockSuperBlock ();
+
+  return idle;
+}
+
+/*
+ *  Internal functions
+ */
+
+/*
+ *  Set up the access lock to the superblock as a recursive mutex.
+ */
+
+static void initSBLock (void)
+{
+  pthread_mutexattr_t attr;                      /* mutex attributes */
+
+  pthread_mutexattr_init (&attr);
+  pthread_mutexattr_settype (&attr, PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init (&sbCR, &attr);
+  pthread_mutexattr_destroy (&attr);
+}
+
+/*
+ *  Bring the local copy of a block or cluster of metadata up to date: if it is already held and no store of metadata
+ *  took place since it was last read or written, nothing is done; otherwise, its current contents is read and, when it
+ *  is already held, the entries (of unit bytes) changed locally and not yet stored are kept.
+ */
+
+static int loadShared (uint32_t n, uint32_t nblks, void *buf, void *orig, uint32_t unit, int loaded, uint32_t *p_stamp)
+{
+  unsigned char cur[CLUSTER_SIZE];               /* current contents */
+  uint32_t size = nblks * BLOCK_SIZE;            /* size in bytes */
+  uint32_t i;                                    /* byte offset */
+  int stat;                                      /* status of operation */
+
+  if (loaded && (*p_stamp == __atomic_load_n (&metaStamp, __ATOMIC_ACQUIRE)))
+     return 0;                                   /* the local copy is up to date */
+
+  pthread_mutex_lock (&metaCR);
+  if (nblks == 1)
+     stat = soReadCacheBlock (n, cur);
+     else stat = soReadCacheCluster (n, cur);
+  if (stat == 0)
+     { if (loaded)
+          { for (i = 0; i < size; i += unit)
+              if (memcmp ((unsigned char *) buf + i, (unsigned char *) orig + i, unit) == 0)
+                 memcpy ((unsigned char *) buf + i, cur + i, unit);
+          }
+          else memcpy (buf, cur, size);
+       memcpy (orig, cur, size);
+       *p_stamp = metaStamp;
+     }
+  pthread_mutex_unlock (&metaCR);
+
+  return stat;
+}
+
+/*
+ *  Store the local copy of a block or cluster of metadata: the entries (of unit bytes) changed locally since it was
+ *  last read or written are merged into its current contents, which is then written and becomes the local copy.
+ */
+
+static int storeShared (uint32_t n, uint32_t nblks, void *buf, void *orig, uint32_t unit, uint32_t *p_stamp)
+{
+  unsigned char cur[CLUSTER_SIZE];               /* current contents */
+  uint32_t size = nblks * BLOCK_SIZE;            /* size in bytes */
+  uint32_t i;                                    /* byte offset */
+  int stat;                                      /* status of operation */
+
+  pthread_mutex_lock (&metaCR);
+  if (nblks == 1)
+     { if ((stat = soJournalBlock (n)) == 0)
+          stat = soReadCacheBlock (n, cur);
+     }
+     else stat = soReadCacheCluster (n, cur);
+  if (stat == 0)
+     { for (i = 0; i < size; i += unit)
+         if (memcmp ((unsigned char *) buf + i, (unsigned char *) orig + i, unit) != 0)
+            memcpy (cur + i, (unsigned char *) buf + i, unit);
+       if (nblks == 1)
+          stat = soWriteCacheBlock (n, cur);
+          else stat = soWriteCacheCluster (n, cur);
+     }
+  if (stat == 0)
+     { memcpy (buf, cur, size);
+       memcpy (orig, cur, size);
+       __atomic_store_n (&metaStamp, metaStamp + 1, __ATOMIC_RELEASE);
+       *p_stamp = metaStamp;
+       if (nblks == 1) stat = commitAlone ();
+     }
+  pthread_mutex_unlock (&metaCR);
+
+  return stat;
+}
+
+/*
+ *  Make a cluster of references accessible: it is pinned in the buffercache, so that it is accessed in place, and the
+ *  cluster previously pinned, if any, is released; when the buffercache is unbuffered, or too many clusters of
+ *  references are already pinned by the threads as a whole, or the buffercache has too few nodes left to be replaced
+ *  (the ones held by the prefetcher and the write-back included), the cluster is read into the local storage area, or
+ *  brought up to date if it is already held there.
+ */
+
+static int pinRefClust (uint32_t nClust, SODataClust **pp_clust, SODataClust *p_local, SODataClust *p_orig, int nPrev,
+                        int *p_pinned, uint32_t *p_stamp)
+{
+  void *p_clust;                                 /* pointer to the cluster in the buffercache */
+  int stat;                                      /* status of operation */
+
+  if ((int) nClust == nPrev)                     /* the cluster has already been read */
+     { if (*p_pinned) return 0;
+       return loadShared (nClust, BLOCKS_PER_CLUSTER, p_local, p_orig, sizeof (uint32_t), 1, p_stamp);
+     }
+  if (*p_pinned)                                 /* release the cluster previously pinned */
+     { soUnpinCacheCluster ((uint32_t) nPrev);
+       __atomic_sub_fetch (&refPins, 1, __ATOMIC_RELAXED);
+       *p_pinned = 0;
+     }
+  if (__atomic_add_fetch (&refPins, 1, __ATOMIC_RELAXED) <= MAX_REF_PINS)
+     { if ((stat = soPinCacheCluster (nClust, &p_clust)) == 0)
+          { *pp_clust = (SODataClust *) p_clust;
+            *p_pinned = 1;
+            return 0;
+          }
+       __atomic_sub_fetch (&refPins, 1, __ATOMIC_RELAXED);
+       if ((stat != -ENOTSUP) && (stat != -ENOBUFS)) return stat;
+     }
+     else __atomic_sub_fetch (&refPins, 1, __ATOMIC_RELAXED);
+
+  *pp_clust = p_local;                           /* the buffercache is unbuffered, or too many nodes are pinned */
+  return loadShared (nClust, BLOCKS_PER_CLUSTER, p_local, p_orig, sizeof (uint32_t), 0, p_stamp);
+}
+
+/*
+ *  Load a block or a cluster of metadata into one of a set of slots: if it is already held, it is brought up to date;
+ *  otherwise, the slot least recently used is reassigned to it. Clusters of references are pinned in the buffercache,
+ *  if possible.
+ */
+
+static int loadSlot (SOSlot *slot, uint32_t nSlots, uint32_t *p_clock, unsigned char *data, unsigned char *orig,
+                     uint32_t nblks, uint32_t unit, uint32_t n, uint32_t *p_h)
+{
+  uint32_t size = nblks * BLOCK_SIZE;            /* size in bytes of the block or cluster */
+  uint32_t i, v;                                 /* slot indexes */
+  SOSlot *p;                                     /* pointer to the slot */
+  void *p_clust;                                 /* pointer to the cluster in the buffercache */
+  int stat;                                      /* status of operation */
+
+  for (i = 0, v = 0; i < nSlots; i++)
+  { if (slot[i].valid && (slot[i].n == n)) break;
+    if (!slot[i].valid || (slot[v].valid && (slot[i].used < slot[v].used))) v = i;
+  }
+
+  if (i < nSlots)                                /* the block or cluster is already held */
+     { p = &slot[i];
+       if (!p->pinned &&
+           ((stat = loadShared (n, nblks, p->p_data, orig + i * size, unit, 1, &p->stamp)) != 0))
+          { p->valid = 0;
+            return stat;
+          }
+     }
+     else { p = &slot[i = v];                    /* reassign the slot least recently used */
+            if (p->valid && p->pending)          /* its store was put off */
+               { p->pending = 0;
+                 if ((stat = storeShared (p->n, nblks, p->p_data, orig + i * size, unit, &p->stamp)) != 0)
+                    { p->valid = 0;
+                      return stat;
+                    }
+               }
+            if (p->valid && p->pinned)
+               { soUnpinCacheCluster (p->n);
+                 __atomic_sub_fetch (&refPins, 1, __ATOMIC_RELAXED);
+               }
+            p->valid = 0;
+            p->pinned = 0;
+            p->gen = (p->gen + 1) & 0xFFFFFF;
+            p->n = n;
+            stat = -ENOTSUP;
+            if ((nblks > 1) && (__atomic_add_fetch (&refPins, 1, __ATOMIC_RELAXED) <= MAX_REF_PINS))
+               { if ((stat = soPinCacheCluster (n, &p_clust)) == 0)
+                    { p->p_data = p_clust;
+                      p->pinned = 1;
+                    }
+                    else __atomic_sub_fetch (&refPins, 1, __ATOMIC_RELAXED);
+               }
+               else if (nblks > 1) __atomic_sub_fetch (&refPins, 1, __ATOMIC_RELAXED);
+            if ((stat != 0) && (stat != -ENOTSUP) && (stat != -ENOBUFS)) return stat;
+            if (!p->pinned)
+               { p->p_data = data + i * size;
+                 if ((stat = loadShared (n, nblks, p->p_data, orig + i * size, unit, 0, &p->stamp)) != 0)
+                    return stat;
+               }
+            p->valid = 1;
+          }
+  p->used = ++(*p_clock);
+  *p_h = HANDLE (i, p->gen);
+
+  return 0;
+}
+
+/*
+ *  Get the slot a handle refers to, or NULL, if the handle is no longer valid.
+ */
+
+static SOSlot *getSlot (SOSlot *slot, uint32_t nSlots, uint32_t h)
+{
+  uint32_t i = h & 0xFF;                         /* slot index */
+
+  if ((i >= nSlots) || !slot[i].valid || (slot[i].gen != (h >> 8))) return NULL;
+  return &slot[i];
+}
+
+/*
+ *  Store the block or cluster of metadata held in a slot: a pinned cluster is just marked as changed, otherwise the
+ *  local changes are merged into its current contents; the store is put off, if it may be, and the set of slots admits
+ *  it (pend is not zero).
+ */
+
+static int storeSlot (SOSlot *slot, uint32_t nSlots, unsigned char *orig, uint32_t nblks, uint32_t unit, uint32_t h,
+                      uint32_t pend)
+{
+  SOSlot *p;                                     /* pointer to the slot */
+
+  if ((p = getSlot (slot, nSlots, h)) == NULL) return -ELIBBAD;
+  if (p->pinned) return soMarkCacheClusterDirty (p->n);
+  if ((pend != 0) && deferStore ())
+     { p->pending = 1;
+       areaPending |= pend;
+       return 0;
+     }
+  p->pending = 0;
+  return storeShared (p->n, nblks, p->p_data, orig + (h & 0xFF) * nblks * BLOCK_SIZE, unit, &p->stamp);
+}
+
+/*
+ *  Carry out the stores put off of the blocks held in a set of slots.
+ */
+
+static int flushSlots (SOSlot *slot, uint32_t nSlots, unsigned char *orig, uint32_t nblks, uint32_t unit)
+{
+  uint32_t i;                                    /* slot index */
+  int stat, st;                                  /* status of operation */
+
+  stat = 0;
+  for (i = 0; i < nSlots; i++)
+    if (slot[i].valid && slot[i].pending)
+       { slot[i].pending = 0;
+         if ((st = storeShared (slot[i].n, nblks, slot[i].p_data, orig + i * nblks * BLOCK_SIZE, unit,
+                                &slot[i].stamp)) != 0)
+            { slot[i].valid = 0;
+              if (stat == 0) stat = st;
+            }
+       }
+
+  return stat;
+}
+
+/*
+ *  Carry out the stores put off of the storage areas and sets of slots of the thread selected by mask.
+ */
+
+static int flushPending (uint32_t mask)
+{
+  int stat, st;                                  /* status of operation */
+
+  if ((mask &= areaPending) == 0) return 0;
+  areaPending &= ~mask;
+
+  stat = 0;
+  if ((mask & PEND_INT) && ((st = storeInT ()) != 0) && (stat == 0)) stat = st;
+  if ((mask & PEND_CTINMT) && ((st = storeCTInMT ()) != 0) && (stat == 0)) stat = st;
+  if ((mask & PEND_BMAPT) && ((st = storeBMapT ()) != 0) && (stat == 0)) stat = st;
+  if ((mask & PEND_INTH) &&
+      ((st = flushSlots (inTSlots.slot, BLOCK_SLOTS, inTSlots.orig[0], 1, sizeof (SOInode))) != 0) && (stat == 0))
+     stat = st;
+  if ((mask & PEND_CTINMTH) &&
+      ((st = flushSlots (cTInMTSlots.slot, BLOCK_SLOTS, cTInMTSlots.orig[0], 1, sizeof (uint32_t))) != 0) &&
+      (stat == 0))
+     stat = st;
+  if ((mask & PEND_BMAPTH) && ((st = flushSlots (bMapTSlots.slot, BLOCK_SLOTS, bMapTSlots.orig[0], 1, 1)) != 0) &&
+      (stat == 0))
+     stat = st;
+
+  return stat;
+}
+
+/*
+ *  Write the superblock (the caller holds its lock).
+ */
+
+static int storeSB (void)
+{
+  int stat;                                      /* status of operation */
+
+  if (sbError != 0) return sbError;              /* a previous error has occurred */
+  pthread_mutex_lock (&metaCR);
+  if ((stat = soJournalBlock (0)) == 0)
+     stat = soWriteCacheBlock (0, &sb);
+  if (stat == 0) stat = commitAlone ();
+  pthread_mutex_unlock (&metaCR);
+  if (stat == 0)
+     { sbPending = 0;
+       sbStored = time (NULL);
+     }
+     else { sbLoaded = -1;
+            sbError = stat;                      /* an error has occurred while writing */
+          }
+
+  return stat;
+}
+
+/*
+ *  Store the block of the table of inodes held in the single storage area.
+ */
+
+static int storeInT (void)
+{
+  int stat;                                      /* status of operation */
+
+  if (intError != 0) return intError;            /* a previous error has occurred */
+  stat = storeShared (sb.itable_start + nBlkInTLoaded, 1, inode, inodeOrig, sizeof (SOInode), &intStamp);
+  if (stat != 0)
+     { nBlkInTLoaded = -2;
+       intError = stat;                          /* an error has occurred while writing */
+     }
+
+  return stat;
+}
+
+/*
+ *  Store the block of the table of cluster-to-inode mapping held in the single storage area.
+ */
+
+static int storeCTInMT (void)
+{
+  int stat;                                      /* status of operation */
+
+  if (ctinmtError != 0) return ctinmtError;      /* a previous error has occurred */
+  stat = storeShared (sb.ciutable_start + nBlkCTInMTLoaded, 1, blockCTInMT, blockCTInMTOrig, sizeof (uint32_t),
+                      &ctinmtStamp);
+  if (stat != 0)
+     { nBlkCTInMTLoaded = -2;
+       ctinmtError = stat;                       /* an error has occurred while writing */
+     }
+
+  return stat;
+}
+
+/*
+ *  Store the block of the bitmap table to free data clusters held in the single storage area.
+ */
+
+static int storeBMapT (void)
+{
+  int stat;                                      /* status of operation */
+
+  if (bmaptError != 0) return bmaptError;        /* a previous error has occurred */
+  stat = storeShared (sb.fctable_start + nBlkBMapTLoaded, 1, bMap, bMapOrig, 1, &bmaptStamp);
+  if (stat != 0)
+     { nBlkBMapTLoaded = -2;
+       bmaptError = stat;                        /* an error has occurred while writing */
+     }
+
+  return stat;
+}
+
+/*
+ *  Check if the store of a block of the tables may be put off: the thread has a transaction open and holds the lock of
+ *  the superblock.
+ */
+
+static int deferStore (void)
+{
+  return (txDepth > 0) && (sbDepth > 0);
+}
+
+/*
+ *  Commit the running transaction of the journal after a block of metadata is stored outside transactions, unless
+ *  it joins the ones of other threads which are open (the caller holds the access lock to the metadata).
+ */
+
+static int commitAlone (void)
+{
+  if ((txDepth > 0) || (__atomic_load_n (&txOpen, __ATOMIC_RELAXED) != 0)) return 0;
+  return soJournalCommit ();
+}
+
+/*
+ *  Commit the running transaction of the journal, excluding concurrent stores of metadata.
+ */
+
+static int commitJournal (void)
+{
+  int stat;                                      /* status of operation */
+
+  pthread_mutex_lock (&metaCR);
+  stat = soJournalCommit ();
+  pthread_mutex_unlock (&metaCR);
+
+  return stat;
+}
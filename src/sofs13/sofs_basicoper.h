@@ -44,7 +44,51 @@
  *          storage
  *      \li get a pointer to the contents of a specific cluster of the table of direct references to data clusters
  *      \li store the contents of a specific cluster of the table of direct references to data clusters resident in
- *          internal storage to the storage device.
+ *          internal storage to the storage device
+ *      \li load the contents of a specific block of the table of inodes into a slot of internal storage and get a
+ *          handle to it
+ *      \li get a pointer to the contents of the block of the table of inodes held in a slot
+ *      \li store the contents of the block of the table of inodes held in a slot to the storage device
+ *      \li load the contents of a specific block of the table of cluster-to-inode mapping into a slot of internal
+ *          storage and get a handle to it
+ *      \li get a pointer to the contents of the block of the table of cluster-to-inode mapping held in a slot
+ *      \li store the contents of the block of the table of cluster-to-inode mapping held in a slot to the storage
+ *          device
+ *      \li load the contents of a specific block of the bitmap table to free data clusters into a slot of internal
+ *          storage and get a handle to it
+ *      \li get a pointer to the contents of the block of the bitmap table to free data clusters held in a slot
+ *      \li store the contents of the block of the bitmap table to free data clusters held in a slot to the storage
+ *          device
+ *      \li load the contents of a specific cluster of references to data clusters into a slot of internal storage and
+ *          get a handle to it
+ *      \li get a pointer to the contents of the cluster of references to data clusters held in a slot
+ *      \li store the contents of the cluster of references to data clusters held in a slot to the storage device
+ *      \li lock the superblock for the manipulation of the lists of free inodes and free data clusters
+ *      \li unlock the superblock
+ *      \li open a transaction
+ *      \li commit a transaction
+ *      \li carry out at once the stores put off by transactions
+ *      \li check if no transaction is open.
+ *
+ *  Besides the single storage area of each kind, every thread has a few slots of each kind (four for the blocks of each
+ *  table and six for the clusters of references), managed on a least recently used basis and accessed through
+ *  handles, so that alternating access to several blocks or clusters does not reload them.
+ *
+ *  Internal storage for the blocks and clusters of metadata is kept per thread, so that operations on different files
+ *  may proceed concurrently: on store, only the entries changed by the thread are merged into the current contents.
+ *
+ *  The updates of metadata of a high-level operation may be grouped in a transaction. While a transaction is open, the
+ *  stores of the superblock are put off until it is committed and, when transactions of several threads overlap, a
+ *  single store is carried out for all of them, by the last one to be committed (or by the first one committed after
+ *  \c TX_WINDOW seconds since the previous store, so that a steady flow of operations does not put it off
+ *  indefinitely). Besides, the stores of the blocks of the table of inodes, the table of cluster-to-inode mapping and
+ *  the bitmap table to free data clusters made while the superblock is locked are put off until either the thread
+ *  moves the storage area to another block, or it unlocks the superblock: a block changed many times while the free
+ *  lists are manipulated is thus stored once. Outside transactions, every store is carried out at once.
+ *
+ *  When the file system has a journal and it is open (see sofs_journal.h), the blocks of the superblock and of the
+ *  tables are logged as they are stored, and the running transaction of the journal is committed when the last
+ *  transaction open is committed, so that the updates of all of them reach the storage device atomically.
  *
  *  \author António Rui Borges - August 2010 - September 2013
  *
@@ -57,16 +101,23 @@
 #define SOFS_BASICOPER_H_
 
 #include <stdint.h>
+#include <stdbool.h>
 
 #include "sofs_superblock.h"
 #include "sofs_inode.h"
 
+/** \brief maximum time (in seconds) the store of the superblock may be put off by overlapping transactions */
+#define TX_WINDOW  1
+
 /**
  *  \brief Load the contents of the superblock into internal storage.
  *
- *  Any type of previous error on loading / storing the superblock data will disable the operation.
+ *  Any type of previous error on loading / storing the superblock data will disable the operation. A file system
+ *  installed with data clusters of another size than \c CLUSTER_SIZE is not loaded.
  *
  *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the magic number is the one characteristic of SOFS13, but the number of blocks of a data
+ *                      cluster is not \c BLOCKS_PER_CLUSTER
  *  \return -\c EBADF, if the device is not already opened
  *  \return -\c EIO, if it fails on reading or writing
  *  \return -\c ELIBBAD, if the buffercache is inconsistent or the superblock was not previously loaded on a previous
@@ -91,7 +142,8 @@ extern SOSuperBlock *soGetSuperBlock (void);
 /**
  *  \brief Store the contents of the superblock resident in internal storage to the storage device.
  *
- *  Any type of previous / current error on loading / storing the superblock data will disable the operation.
+ *  Any type of previous / current error on loading / storing the superblock data will disable the operation. Within a
+ *  transaction, the store is put off until the transaction is committed.
  *
  *  \return <tt>0 (zero)</tt>, on success
  *  \return -\c EBADF, if the device is not already opened
@@ -449,4 +501,270 @@ extern SODataClust *soGetDirRefClust (void);
 
 extern int soStoreDirRefClust (void);
 
+/**
+ *  \brief Load the contents of a specific block of the table of inodes into a slot of internal storage.
+ *
+ *  If the block is already held in one of the slots of the calling thread, it is brought up to date, keeping the
+ *  changes not yet stored; otherwise, the slot least recently used is reassigned to it, any handle to that slot
+ *  becoming invalid.
+ *
+ *  \param nBlk logical number of the block to be read
+ *  \param p_h pointer to the location where the handle to the slot is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if logical block number is out of range or the pointer is \c NULL
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent or the superblock was not previously loaded on a previous
+ *                       store operation
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+extern int soLoadBlockInTH (uint32_t nBlk, uint32_t *p_h);
+
+/**
+ *  \brief Get a pointer to the contents of the block of the table of inodes held in a slot.
+ *
+ *  \param h handle to the slot
+ *
+ *  \return pointer to the block, on success
+ *  \return -\c NULL, if the handle is invalid
+ */
+
+extern SOInode *soGetBlockInTH (uint32_t h);
+
+/**
+ *  \brief Store the contents of the block of the table of inodes held in a slot to the storage device.
+ *
+ *  Only the inodes changed since the block was last read or written are stored.
+ *
+ *  \param h handle to the slot
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the handle is invalid or the buffercache is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+extern int soStoreBlockInTH (uint32_t h);
+
+/**
+ *  \brief Load the contents of a specific block of the table of cluster-to-inode mapping into a slot of internal
+ *         storage.
+ *
+ *  If the block is already held in one of the slots of the calling thread, it is brought up to date, keeping the
+ *  changes not yet stored; otherwise, the slot least recently used is reassigned to it, any handle to that slot
+ *  becoming invalid.
+ *
+ *  \param nBlk logic number of the block to be read
+ *  \param p_h pointer to the location where the handle to the slot is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if logic block number is out of range or the pointer is \c NULL
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent or the superblock was not previously loaded on a previous
+ *                       store operation
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+extern int soLoadBlockCTInMTH (uint32_t nBlk, uint32_t *p_h);
+
+/**
+ *  \brief Get a pointer to the contents of the block of the table of cluster-to-inode mapping held in a slot.
+ *
+ *  \param h handle to the slot
+ *
+ *  \return pointer to the block, on success
+ *  \return -\c NULL, if the handle is invalid
+ */
+
+extern uint32_t *soGetBlockCTInMTH (uint32_t h);
+
+/**
+ *  \brief Store the contents of the block of the table of cluster-to-inode mapping held in a slot to the storage
+ *         device.
+ *
+ *  Only the entries changed since the block was last read or written are stored.
+ *
+ *  \param h handle to the slot
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the handle is invalid or the buffercache is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+extern int soStoreBlockCTInMTH (uint32_t h);
+
+/**
+ *  \brief Load the contents of a specific block of the bitmap table to free data clusters into a slot of internal
+ *         storage.
+ *
+ *  If the block is already held in one of the slots of the calling thread, it is brought up to date, keeping the
+ *  changes not yet stored; otherwise, the slot least recently used is reassigned to it, any handle to that slot
+ *  becoming invalid.
+ *
+ *  \param nBlk logical number of the block to be read
+ *  \param p_h pointer to the location where the handle to the slot is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if logical block number is out of range or the pointer is \c NULL
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent or the superblock was not previously loaded on a previous
+ *                       store operation
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+extern int soLoadBlockBMapTH (uint32_t nBlk, uint32_t *p_h);
+
+/**
+ *  \brief Get a pointer to the contents of the block of the bitmap table to free data clusters held in a slot.
+ *
+ *  \param h handle to the slot
+ *
+ *  \return pointer to the block, on success
+ *  \return -\c NULL, if the handle is invalid
+ */
+
+extern unsigned char *soGetBlockBMapTH (uint32_t h);
+
+/**
+ *  \brief Store the contents of the block of the bitmap table to free data clusters held in a slot to the storage
+ *         device.
+ *
+ *  Only the bytes changed since the block was last read or written are stored.
+ *
+ *  \param h handle to the slot
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the handle is invalid or the buffercache is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+extern int soStoreBlockBMapTH (uint32_t h);
+
+/**
+ *  \brief Load the contents of a specific cluster of references to data clusters (single indirect or direct) into a
+ *         slot of internal storage.
+ *
+ *  If the cluster is already held in one of the slots of the calling thread, it is brought up to date, keeping the
+ *  changes not yet stored; otherwise, the slot least recently used is reassigned to it, any handle to that slot
+ *  becoming invalid. The cluster is pinned in the buffercache, if possible, and accessed in place.
+ *
+ *  \param nClust physical number of the cluster to be read
+ *  \param p_h pointer to the location where the handle to the slot is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if physical cluster number is out of range or the pointer is \c NULL
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent or the superblock was not previously loaded on a previous
+ *                       store operation
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+extern int soLoadRefClustH (uint32_t nClust, uint32_t *p_h);
+
+/**
+ *  \brief Get a pointer to the contents of the cluster of references to data clusters held in a slot.
+ *
+ *  \param h handle to the slot
+ *
+ *  \return pointer to the cluster, on success
+ *  \return -\c NULL, if the handle is invalid
+ */
+
+extern SODataClust *soGetRefClustH (uint32_t h);
+
+/**
+ *  \brief Store the contents of the cluster of references to data clusters held in a slot to the storage device.
+ *
+ *  Only the references changed since the cluster was last read or written are stored.
+ *
+ *  \param h handle to the slot
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the handle is invalid or the buffercache is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+extern int soStoreRefClustH (uint32_t h);
+
+/**
+ *  \brief Lock the superblock for the manipulation of the lists of free inodes and free data clusters.
+ *
+ *  The lock is recursive: it may be acquired again by the thread that already holds it. The operations which allocate
+ *  and free inodes and data clusters hold it throughout, so that the free lists, the free data clusters caches and the
+ *  metadata they thread through are changed by one thread at a time.
+ */
+
+extern void soLockSuperBlock (void);
+
+/**
+ *  \brief Unlock the superblock.
+ */
+
+extern void soUnlockSuperBlock (void);
+
+/**
+ *  \brief Open a transaction.
+ *
+ *  Transactions may be nested: only the outermost one is effective.
+ */
+
+extern void soBeginTransaction (void);
+
+/**
+ *  \brief Commit a transaction.
+ *
+ *  The stores of metadata put off by the thread are carried out and so is the store of the superblock, if no
+ *  transaction of any other thread is open, or \c TX_WINDOW seconds have elapsed since it was last stored. The running
+ *  transaction of the journal is committed as well, if no transaction of any other thread is open.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if no transaction is open
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call, either now or on any store put off since the
+ *          transaction was opened
+ */
+
+extern int soCommitTransaction (void);
+
+/**
+ *  \brief Carry out at once the stores put off by transactions.
+ *
+ *  The stores of metadata put off by the thread are carried out and so is the store of the superblock, if it was put
+ *  off by any thread, and the running transaction of the journal is committed: it is meant to be called before the
+ *  storage device is synchronized.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+extern int soFlushTransactions (void);
+
+/**
+ *  \brief Check if no transaction is open.
+ *
+ *  It tells whether the file system is idle, so that background work may be carried out without delaying the
+ *  operations in progress; the answer may be outdated as soon as it is given.
+ *
+ *  \return \c true, if no transaction of any thread is open, or \c false, otherwise
+ */
+
+extern bool soTransactionsIdle (void);
+
 #endif /* SOFS_BASICOPER_H_ */
@@ -304,6 +304,20 @@ void printSuperBlock (void *buf)
   printf ("   Number of blocks that the bitmap table to data clusters comprises  = %"PRIu32"\n", p_sb->fctable_size);
   printf ("   Search point index for the bitmap table envisaged as an array of bits (circular parsing)  = %"PRIu32"\n",
           p_sb->fctable_pos);
+
+  /* geometry */
+
+  printf ("Geometry\n");
+  printf ("   Number of blocks per cluster  = %"PRIu32"\n", SB_CLUST_SIZE (p_sb));
+
+  /* journal metadata */
+
+  printf ("Journal metadata\n");
+  if ((p_sb->jnl_size == 0) || (p_sb->jnl_start != p_sb->ntotal))
+     printf ("   No journal\n");
+     else { printf ("   Physical number of the block where the journal starts  = %"PRIu32"\n", p_sb->jnl_start);
+            printf ("   Number of blocks that the journal comprises  = %"PRIu32"\n", p_sb->jnl_size);
+          }
 }
 
 /**
@@ -322,6 +336,8 @@ void printInode (SOInode *p_inode, uint32_t nInode)
   int i;                                         /* counting variable */
   int m;                                         /* mask variable */
   char timebuf[30];                              /* date and time string */
+  SOExtent root[N_ROOT_EXTENTS];                 /* entries of the root of a tree of extents */
+  unsigned char *c;                              /* contents stored in the inode */
 
   /* print inode number */
 
@@ -372,6 +388,36 @@ void printInode (SOInode *p_inode, uint32_t nInode)
             printf ("mtime = %s\n", timebuf);
           }
 
+  /* print the root of the tree of extents, if it describes the file information content */
+
+  if (p_inode->mode & INODE_EXTENTS)
+     { memcpy (root, p_inode->d, sizeof (root));
+       printf ("extents (depth %"PRIu32") = {", (p_inode->mode & INODE_EXT_DEPTH_MASK) >> INODE_EXT_DEPTH_SHIFT);
+       for (i = 0; i < N_ROOT_EXTENTS; i++)
+       { if (i > 0) printf (" ");
+         if (root[i].nClust == NULL_CLUSTER)
+            printf ("(nil)");
+            else printf ("%"PRIu32":%"PRIu32"@%"PRIu32"", root[i].first, root[i].count, root[i].nClust);
+       }
+       printf ("}\n");
+       printf ("----------------\n");
+       return;
+     }
+
+  /* print the bytes stored in the inode, if it holds the file information content */
+
+  if (INODE_IS_INLINE (p_inode->mode))
+     { c = (unsigned char *) p_inode->d;
+       printf ("inline = {");
+       for (i = 0; i < INLINE_SIZE; i++)
+       { if (i > 0) printf (" ");
+         printf ("%02x", c[i]);
+       }
+       printf ("}\n");
+       printf ("----------------\n");
+       return;
+     }
+
   /* print references to the data clusters that comprise the file information content */
 
   printf ("d[] = {");
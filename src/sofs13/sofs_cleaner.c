@@ -0,0 +1,335 @@
+/**
+ *  \file sofs_cleaner.c (implementation file)
+ *
+ *  \brief Background cleaning of the free inodes and data clusters in the dirty state.
+ *
+ *  The search for an inode to be cleaned and its cleaning are done holding the lock of the superblock, so that no other
+ *  transaction may be opened in between and the inode can not be allocated meanwhile.
+ *
+ *  The operations are:
+ *      \li start the cleaner
+ *      \li record that an inode was freed and wake up the cleaner
+ *      \li stop the cleaner.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "sofs_probe.h"
+#include "sofs_superblock.h"
+#include "sofs_inode.h"
+#include "sofs_datacluster.h"
+#include "sofs_basicoper.h"
+#include "sofs_ifuncs_2.h"
+#include "sofs_cleaner.h"
+
+/*
+ *  Internal data structure
+ */
+
+/** \brief access lock to the state of the cleaner */
+static pthread_mutex_t cleanCR = PTHREAD_MUTEX_INITIALIZER;
+/** \brief condition the cleaner waits on until it is due */
+static pthread_cond_t cleanWakeUp = PTHREAD_COND_INITIALIZER;
+/** \brief cleaner thread */
+static pthread_t cleanThread;
+/** \brief signals if the cleaner is running */
+static bool cleanRunning = false;
+/** \brief signals if the cleaner is to stop */
+static bool cleanStop = false;
+/** \brief signals if the cleaner was woken up ahead of time */
+static bool cleanKicked = false;
+/** \brief time between successive passes of the cleaner (s) */
+static uint32_t cleanPeriod = 0;
+/** \brief inodes freed since the last pass of the cleaner, in a circular queue */
+static uint32_t cleanQueue[CLEAN_QUEUE];
+/** \brief index of the first inode in the queue */
+static uint32_t queueHead = 0;
+/** \brief number of inodes in the queue */
+static uint32_t queueCount = 0;
+
+/* Allusion to internal functions */
+
+static void *cleaner (void *arg);
+static void waitFor (uint32_t ms);
+static int cleanStep (void);
+static bool popFreedInode (uint32_t *p_nInode);
+static int findDirtyInode (uint32_t *p_nInode);
+static int isDirty (uint32_t nInode, bool *p_dirty, uint32_t *p_next);
+
+/**
+ *  \brief Start the cleaner.
+ *
+ *  \param period time between successive passes of the cleaner (s)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the period is zero
+ *  \return -\c EBUSY, if the cleaner is already running
+ *  \return -<em>other specific error</em> issued by \e pthread_create
+ */
+
+int soStartCleaner (uint32_t period)
+{
+  soColorProbe (760, "07;31", "soStartCleaner (%"PRIu32")\n", period);
+
+  int stat;                                      /* status of operation */
+
+  if (period == 0) return -EINVAL;
+
+  pthread_mutex_lock (&cleanCR);
+  if (cleanRunning)
+     { pthread_mutex_unlock (&cleanCR);
+       return -EBUSY;
+     }
+  cleanPeriod = period;
+  cleanStop = cleanKicked = false;
+  queueHead = queueCount = 0;
+  if ((stat = pthread_create (&cleanThread, NULL, cleaner, NULL)) == 0)
+     cleanRunning = true;
+  pthread_mutex_unlock (&cleanCR);
+
+  return -stat;
+}
+
+/**
+ *  \brief Record that an inode was freed and wake up the cleaner.
+ *
+ *  Nothing is done if the cleaner is not running.
+ *
+ *  \param nInode number of the inode
+ */
+
+void soNoteFreedInode (uint32_t nInode)
+{
+  pthread_mutex_lock (&cleanCR);
+  if (cleanRunning)
+     { if (queueCount < CLEAN_QUEUE)             /* otherwise, it is left for the allocation to clean */
+          cleanQueue[(queueHead + queueCount++) % CLEAN_QUEUE] = nInode;
+       if (!cleanKicked)
+          { cleanKicked = true;
+            pthread_cond_signal (&cleanWakeUp);
+          }
+     }
+  pthread_mutex_unlock (&cleanCR);
+}
+
+/**
+ *  \brief Stop the cleaner.
+ *
+ *  The inode being cleaned, if any, is completed first. Nothing is done if the cleaner is not running.
+ */
+
+void soStopCleaner (void)
+{
+  soColorProbe (764, "07;31", "soStopCleaner ()\n");
+
+  pthread_mutex_lock (&cleanCR);
+  if (!cleanRunning)
+     { pthread_mutex_unlock (&cleanCR);
+       return;
+     }
+  cleanStop = true;
+  pthread_cond_signal (&cleanWakeUp);
+  pthread_mutex_unlock (&cleanCR);
+  pthread_join (cleanThread, NULL);
+  pthread_mutex_lock (&cleanCR);
+  cleanRunning = false;
+  pthread_mutex_unlock (&cleanCR);
+}
+
+/*
+ *  Internal functions
+ */
+
+/*
+ *  Cleaner thread: it is activated periodically, or when an inode is freed, and cleans the inodes in the dirty state
+ *  one at a time, while there are any, waiting for the file system to be idle. A pass is ended by an error, to be
+ *  tried again on the next one, or when it has cleaned as many inodes as it may look at, should the cleaning of any of
+ *  them leave it dirty (the inodes freed meanwhile are looked at anyway).
+ */
+
+static void *cleaner (void *arg __attribute__ ((unused)))
+{
+  struct timespec ts;                            /* time limit for the wait */
+  uint32_t n;                                    /* number of inodes cleaned in the pass */
+  int stat;                                      /* status of operation */
+
+  pthread_mutex_lock (&cleanCR);
+  while (!cleanStop)
+  { if (!cleanKicked)
+       { clock_gettime (CLOCK_REALTIME, &ts);
+         ts.tv_sec += cleanPeriod;
+         pthread_cond_timedwait (&cleanWakeUp, &cleanCR, &ts);
+       }
+    cleanKicked = false;
+    n = 0;
+    while (!cleanStop && ((n < CLEAN_AHEAD + DZONE_CACHE_SIZE) || (queueCount > 0)))
+    { pthread_mutex_unlock (&cleanCR);
+      stat = cleanStep ();
+      if (stat == -EBUSY) waitFor (CLEAN_IDLE_WAIT);
+      pthread_mutex_lock (&cleanCR);
+      if ((stat != -EBUSY) && (stat <= 0)) break;
+      if (stat > 0) n += 1;
+    }
+  }
+  pthread_mutex_unlock (&cleanCR);
+
+  return NULL;
+}
+
+/*
+ *  Wait for a number of milliseconds, unless the cleaner is to stop meanwhile.
+ */
+
+static void waitFor (uint32_t ms)
+{
+  struct timespec ts;                            /* time limit for the wait */
+
+  clock_gettime (CLOCK_REALTIME, &ts);
+  ts.tv_sec += ms / 1000;
+  ts.tv_nsec += (long) (ms % 1000) * 1000000L;
+  if (ts.tv_nsec >= 1000000000L)
+     { ts.tv_sec += 1;
+       ts.tv_nsec -= 1000000000L;
+     }
+  pthread_mutex_lock (&cleanCR);
+  if (!cleanStop) pthread_cond_timedwait (&cleanWakeUp, &cleanCR, &ts);
+  pthread_mutex_unlock (&cleanCR);
+}
+
+/*
+ *  Clean an inode in the dirty state, if the file system is idle and there is any.
+ *  It returns 1, if an inode was cleaned, 0 (zero), if there is none to be cleaned, -EBUSY, if a transaction is open,
+ *  or the error issued otherwise.
+ */
+
+static int cleanStep (void)
+{
+  uint32_t nInode;                               /* number of the inode to be cleaned */
+  int stat, st;                                  /* status of operation */
+
+  soLockSuperBlock ();
+  if (!soTransactionsIdle ())                    /* no transaction may be opened until the lock is released */
+     { soUnlockSuperBlock ();
+       return -EBUSY;
+     }
+  if ((stat = findDirtyInode (&nInode)) != 0)
+     { soUnlockSuperBlock ();
+       return stat;
+     }
+  if (nInode == NULL_INODE)
+     { soUnlockSuperBlock ();
+       return 0;
+     }
+  soBeginTransaction ();
+  stat = soCleanInode (nInode);
+  if (((st = soCommitTransaction ()) != 0) && (stat == 0))
+     stat = st;
+  soUnlockSuperBlock ();
+
+  return (stat == 0) ? 1 : stat;
+}
+
+/*
+ *  Take the first inode out of the queue of the inodes freed (false, if it is empty).
+ */
+
+static bool popFreedInode (uint32_t *p_nInode)
+{
+  bool found;                                    /* signals if the queue was not empty */
+
+  pthread_mutex_lock (&cleanCR);
+  if ((found = (queueCount > 0)))
+     { *p_nInode = cleanQueue[queueHead];
+       queueHead = (queueHead + 1) % CLEAN_QUEUE;
+       queueCount -= 1;
+     }
+  pthread_mutex_unlock (&cleanCR);
+
+  return found;
+}
+
+/*
+ *  Find a free inode in the dirty state among the inodes freed since the last pass, the first CLEAN_AHEAD of the list
+ *  of free inodes and, failing that, the inodes the data clusters in the retrieval cache are associated to (the
+ *  caller holds the lock of the superblock). NULL_INODE is stored in *p_nInode, if there is none.
+ */
+
+static int findDirtyInode (uint32_t *p_nInode)
+{
+  SOSuperBlock *p_sb;                            /* pointer to the superblock */
+  uint32_t *cTInT;                               /* pointer to a block of the table of cluster-to-inode mapping */
+  uint32_t nInode, next, nBlk, offset, k;        /* numbers of inodes, location of a mapping and counting variable */
+  bool dirty;                                    /* signals if an inode is free in the dirty state */
+  int stat;                                      /* status of operation */
+
+  *p_nInode = NULL_INODE;
+  if ((stat = soLoadSuperBlock ()) != 0) return stat;
+  p_sb = soGetSuperBlock ();
+
+  /* the inodes freed meanwhile, which may have been allocated again since */
+
+  while (popFreedInode (&nInode))
+  { if ((stat = isDirty (nInode, &dirty, &next)) != 0) return stat;
+    if (dirty)
+       { *p_nInode = nInode;
+         return 0;
+       }
+  }
+
+  /* the inodes next to be allocated */
+
+  for (k = 0, nInode = p_sb->ihead; (k < CLEAN_AHEAD) && (nInode != NULL_INODE); k++, nInode = next)
+  { if ((stat = isDirty (nInode, &dirty, &next)) != 0) return stat;
+    if (dirty)
+       { *p_nInode = nInode;
+         return 0;
+       }
+  }
+
+  /* the inodes the data clusters next to be allocated are associated to */
+
+  for (k = p_sb->dzone_retriev.cache_idx; k < DZONE_CACHE_SIZE; k++)
+  { if ((stat = soConvertRefCInMT (p_sb->dzone_retriev.cache[k], &nBlk, &offset)) != 0) return stat;
+    if ((stat = soLoadBlockCTInMT (nBlk)) != 0) return stat;
+    if ((cTInT = soGetBlockCTInMT ()) == NULL) return -ELIBBAD;
+    if ((nInode = cTInT[offset]) == NULL_INODE) continue;
+    if ((stat = isDirty (nInode, &dirty, &next)) != 0) return stat;
+    if (dirty)
+       { *p_nInode = nInode;
+         return 0;
+       }
+  }
+
+  return 0;
+}
+
+/*
+ *  Check if an inode is free in the dirty state, that is, if it is free and still holds references to data clusters,
+ *  and store the number of the next inode in the list of free inodes in *p_next.
+ */
+
+static int isDirty (uint32_t nInode, bool *p_dirty, uint32_t *p_next)
+{
+  SOInode *p_blk;                                /* pointer to the block of the table of inodes */
+  uint32_t nBlk, offset, i;                      /* location of the inode and counting variable */
+  int stat;                                      /* status of operation */
+
+  if ((stat = soConvertRefInT (nInode, &nBlk, &offset)) != 0) return stat;
+  if ((stat = soLoadBlockInT (nBlk)) != 0) return stat;
+  if ((p_blk = soGetBlockInT ()) == NULL) return -ELIBBAD;
+
+  *p_dirty = false;
+  *p_next = NULL_INODE;
+  if ((p_blk[offset].mode & INODE_FREE) == 0) return 0;
+  *p_next = p_blk[offset].vD2.next;
+  *p_dirty = (p_blk[offset].i1 != NULL_CLUSTER) || (p_blk[offset].i2 != NULL_CLUSTER);
+  for (i = 0; (i < N_DIRECT) && !*p_dirty; i++)
+    *p_dirty = (p_blk[offset].d[i] != NULL_CLUSTER);
+
+  return 0;
+}
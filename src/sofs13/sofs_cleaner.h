@@ -0,0 +1,72 @@
+/**
+ *  \file sofs_cleaner.h (interface file)
+ *
+ *  \brief Background cleaning of the free inodes and data clusters in the dirty state.
+ *
+ *  A file which is deleted leaves its inode free in the dirty state, still holding the references to its data
+ *  clusters, which stay associated to it in the table of cluster-to-inode mapping. Otherwise, they are only dissociated
+ *  when they are allocated again, which delays the allocation by walking the lists of references of the inode.
+ *
+ *  The cleaner is a thread which, periodically and shortly after an inode is freed, cleans the free inodes in the dirty
+ *  state: those which were freed since its last pass, up to \c CLEAN_QUEUE of them, those that are next to be
+ *  allocated, at the head of the list of free inodes, and those the data clusters next to be allocated, in the
+ *  retrieval cache, are still associated to, so that a pool of clean inodes and data clusters is kept ready. An inode
+ *  is cleaned as a whole, all its data clusters being dissociated at once. It only works while no transaction is open,
+ *  one inode at a time, each in a transaction of its own and holding the lock of the superblock.
+ *
+ *  The cleaner is supposed to be started after the file system is mounted and stopped before it is unmounted.
+ *
+ *  The operations are:
+ *      \li start the cleaner
+ *      \li record that an inode was freed and wake up the cleaner
+ *      \li stop the cleaner.
+ *
+ *  \remarks In case an error occurs, all functions return a negative value which is the symmetric of the system error
+ *           that better represents the error cause.
+ *           (execute command <em>man errno</em> to get the list of system errors)
+ */
+
+#ifndef SOFS_CLEANER_H_
+#define SOFS_CLEANER_H_
+
+#include <stdint.h>
+
+/** \brief number of free inodes at the head of the list of free inodes which are kept clean */
+#define CLEAN_AHEAD      32
+/** \brief maximum number of inodes freed since the last pass of the cleaner which are recorded */
+#define CLEAN_QUEUE      1024
+/** \brief time the cleaner waits for the file system to be idle before trying again (ms) */
+#define CLEAN_IDLE_WAIT  50
+
+/**
+ *  \brief Start the cleaner.
+ *
+ *  \param period time between successive passes of the cleaner (s)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the period is zero
+ *  \return -\c EBUSY, if the cleaner is already running
+ *  \return -<em>other specific error</em> issued by \e pthread_create
+ */
+
+extern int soStartCleaner (uint32_t period);
+
+/**
+ *  \brief Record that an inode was freed and wake up the cleaner.
+ *
+ *  Nothing is done if the cleaner is not running.
+ *
+ *  \param nInode number of the inode
+ */
+
+extern void soNoteFreedInode (uint32_t nInode);
+
+/**
+ *  \brief Stop the cleaner.
+ *
+ *  The inode being cleaned, if any, is completed first. Nothing is done if the cleaner is not running.
+ */
+
+extern void soStopCleaner (void);
+
+#endif /* SOFS_CLEANER_H_ */
@@ -0,0 +1,337 @@
+/**
+ *  \file sofs_clustmap.c (implementation file)
+ *
+ *  \brief Map of the logical numbers of the data clusters of open files.
+ *
+ *  A fixed number of maps is kept, each one being reference counted by the open-file handles of the file. The map of a
+ *  file is split in segments which mirror the storage of the references: one for the direct references, one for the
+ *  single indirect references and one for each cluster of references pointed by the double indirect references. The
+ *  segments are allocated when they are first stored into and an entry whose logical number is not known is marked
+ *  as such. The maps are accessed in mutual exclusion.
+ *
+ *  The operations are:
+ *      \li attach a map to a file
+ *      \li detach a map from a file
+ *      \li look up the logical number of a data cluster of a file, populating the map if necessary
+ *      \li get the logical numbers of a group of successive data clusters of a file from the map
+ *      \li store the logical numbers of a group of successive data clusters of a file in the map
+ *      \li forget the logical numbers of a group of successive data clusters of a file.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "sofs_probe.h"
+#include "sofs_inode.h"
+#include "sofs_datacluster.h"
+#include "sofs_ifuncs_3.h"
+#include "sofs_clustmap.h"
+
+/** \brief number of segments of a map */
+#define CMAP_SEGS  (2 + RPC)
+
+/** \brief entry whose logical number is not known (it never matches a logical number, nor \c NULL_CLUSTER) */
+#define CMAP_UNKNOWN  (NULL_CLUSTER - 1)
+
+/*
+ *  Internal data structure
+ */
+
+/** \brief map of a file */
+typedef struct soClustMap
+{
+  /** \brief number of open-file handles the map is attached to (zero, if the map is not in use) */
+  uint32_t refs;
+  /** \brief number of the inode associated to the file */
+  uint32_t nInode;
+  /** \brief segments of the map (\c NULL, if nothing was stored in the segment) */
+  uint32_t *seg[CMAP_SEGS];
+} SOClustMap;
+
+/** \brief maps of the files */
+static SOClustMap cmap[CMAP_FILES];
+/** \brief access lock to the maps */
+static pthread_mutex_t cmapCR = PTHREAD_MUTEX_INITIALIZER;
+
+/* Allusion to internal functions */
+
+static SOClustMap *findMap (uint32_t nInode);
+static void freeMap (SOClustMap *p_map);
+static uint32_t segOf (uint32_t clustInd, uint32_t *p_off);
+static uint32_t segFirst (uint32_t s);
+static uint32_t segSize (uint32_t s);
+
+/**
+ *  \brief Attach a map to a file.
+ *
+ *  Each call must be matched by a call to \e soClustMapDetach. The map of a file is shared by all the open-file
+ *  handles of the file.
+ *
+ *  \param nInode number of the inode associated to the file
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c ENFILE, if there is no room for another map (the file is dealt with as having no map)
+ */
+
+int soClustMapAttach (uint32_t nInode)
+{
+  soColorProbe (801, "07;31", "soClustMapAttach (%"PRIu32")\n", nInode);
+
+  SOClustMap *p_map;                             /* pointer to the map of the file */
+  uint32_t i;                                    /* map index */
+
+  pthread_mutex_lock (&cmapCR);
+  if ((p_map = findMap (nInode)) == NULL)
+     { i = 0;
+       while ((i < CMAP_FILES) && (cmap[i].refs != 0)) i++;
+       if (i == CMAP_FILES)
+          { pthread_mutex_unlock (&cmapCR);
+            return -ENFILE;
+          }
+       p_map = &cmap[i];
+       p_map->nInode = nInode;
+     }
+  p_map->refs += 1;
+  pthread_mutex_unlock (&cmapCR);
+
+  return 0;
+}
+
+/**
+ *  \brief Detach a map from a file.
+ *
+ *  The map is released when it is detached from the last open-file handle of the file.
+ *
+ *  \param nInode number of the inode associated to the file
+ */
+
+void soClustMapDetach (uint32_t nInode)
+{
+  soColorProbe (802, "07;31", "soClustMapDetach (%"PRIu32")\n", nInode);
+
+  SOClustMap *p_map;                             /* pointer to the map of the file */
+
+  pthread_mutex_lock (&cmapCR);
+  if (((p_map = findMap (nInode)) != NULL) && (--p_map->refs == 0))
+     freeMap (p_map);
+  pthread_mutex_unlock (&cmapCR);
+}
+
+/**
+ *  \brief Look up the logical number of a data cluster of a file, populating the map if necessary.
+ *
+ *  If the logical number is not known yet, the logical numbers of all the data clusters whose references are stored
+ *  in the same cluster of references (or in the inode itself, for the direct references) are got by
+ *  \e soGetFileClusters and stored in the map.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param clustInd index to the list of direct references belonging to the inode of the data cluster
+ *  \param p_nClust pointer to the location where the logical number of the data cluster is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c ENOENT, if the file has no map
+ *  \return -<em>other specific error</em> issued by \e soGetFileClusters
+ */
+
+int soClustMapLookup (uint32_t nInode, uint32_t clustInd, uint32_t *p_nClust)
+{
+  soColorProbe (803, "07;31", "soClustMapLookup (%"PRIu32", %"PRIu32", %p)\n", nInode, clustInd, p_nClust);
+
+  uint32_t refs[RPC];                            /* logical numbers of the data clusters of the segment */
+  uint32_t s, off;                               /* segment and offset within it */
+  int stat;                                      /* status of operation */
+
+  if ((stat = soClustMapGet (nInode, clustInd, 1, p_nClust)) != -ENODATA)
+     return stat;
+
+  s = segOf (clustInd, &off);                    /* the map is populated by soGetFileClusters */
+  if ((stat = soGetFileClusters (nInode, segFirst (s), segSize (s), refs)) != 0)
+     return stat;
+  *p_nClust = refs[off];
+
+  return 0;
+}
+
+/**
+ *  \brief Get the logical numbers of a group of successive data clusters of a file from the map.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param firstInd index to the list of direct references belonging to the inode of the first data cluster
+ *  \param count number of data clusters
+ *  \param nClust pointer to the array where the logical numbers of the data clusters are to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c ENOENT, if the file has no map
+ *  \return -\c ENODATA, if the logical number of some of the data clusters is not known
+ */
+
+int soClustMapGet (uint32_t nInode, uint32_t firstInd, uint32_t count, uint32_t *nClust)
+{
+  SOClustMap *p_map;                             /* pointer to the map of the file */
+  uint32_t ind, s, off;                          /* data cluster index, segment and offset within it */
+
+  if ((uint64_t) firstInd + count > MAX_FILE_CLUSTERS) return -ENODATA;
+
+  pthread_mutex_lock (&cmapCR);
+  if ((p_map = findMap (nInode)) == NULL)
+     { pthread_mutex_unlock (&cmapCR);
+       return -ENOENT;
+     }
+  for (ind = firstInd; ind < firstInd + count; ind++)
+  { s = segOf (ind, &off);
+    if ((p_map->seg[s] == NULL) || (p_map->seg[s][off] == CMAP_UNKNOWN))
+       { pthread_mutex_unlock (&cmapCR);
+         return -ENODATA;
+       }
+    nClust[ind-firstInd] = p_map->seg[s][off];
+  }
+  pthread_mutex_unlock (&cmapCR);
+
+  return 0;
+}
+
+/**
+ *  \brief Store the logical numbers of a group of successive data clusters of a file in the map.
+ *
+ *  Nothing is done if the file has no map.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param firstInd index to the list of direct references belonging to the inode of the first data cluster
+ *  \param count number of data clusters
+ *  \param nClust pointer to the array where the logical numbers of the data clusters are stored
+ */
+
+void soClustMapSet (uint32_t nInode, uint32_t firstInd, uint32_t count, const uint32_t *nClust)
+{
+  SOClustMap *p_map;                             /* pointer to the map of the file */
+  uint32_t ind, s, off, i;                       /* data cluster index, segment and offset within it */
+
+  if ((uint64_t) firstInd + count > MAX_FILE_CLUSTERS) return;
+
+  pthread_mutex_lock (&cmapCR);
+  if ((p_map = findMap (nInode)) != NULL)
+     for (ind = firstInd; ind < firstInd + count; ind++)
+     { s = segOf (ind, &off);
+       if (p_map->seg[s] == NULL)                /* the segment is allocated on demand */
+          { if ((p_map->seg[s] = malloc (RPC * sizeof (uint32_t))) == NULL) continue;
+            for (i = 0; i < RPC; i++)
+              p_map->seg[s][i] = CMAP_UNKNOWN;
+          }
+       p_map->seg[s][off] = nClust[ind-firstInd];
+     }
+  pthread_mutex_unlock (&cmapCR);
+}
+
+/**
+ *  \brief Forget the logical numbers of a group of successive data clusters of a file.
+ *
+ *  It must be called when data clusters of the file are freed or dissociated from the inode.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param firstInd index to the list of direct references belonging to the inode of the first data cluster
+ *  \param count number of data clusters (it is clipped to the maximum number of data clusters of a file)
+ */
+
+void soClustMapInvalidate (uint32_t nInode, uint32_t firstInd, uint32_t count)
+{
+  soColorProbe (804, "07;31", "soClustMapInvalidate (%"PRIu32", %"PRIu32", %"PRIu32")\n", nInode, firstInd, count);
+
+  SOClustMap *p_map;                             /* pointer to the map of the file */
+  uint32_t ind, end, s, off;                     /* data cluster indexes, segment and offset within it */
+
+  if (firstInd >= MAX_FILE_CLUSTERS) return;
+  end = (count > MAX_FILE_CLUSTERS - firstInd) ? MAX_FILE_CLUSTERS : firstInd + count;
+
+  pthread_mutex_lock (&cmapCR);
+  if ((p_map = findMap (nInode)) != NULL)
+     for (ind = firstInd; ind < end; )
+     { s = segOf (ind, &off);
+       if ((p_map->seg[s] != NULL) && (off == 0) && (end - ind >= segSize (s)))
+          { free (p_map->seg[s]);                /* the whole segment is forgotten */
+            p_map->seg[s] = NULL;
+          }
+          else if (p_map->seg[s] != NULL)
+                  for (; (off < segSize (s)) && (ind < end); off++, ind++)
+                    p_map->seg[s][off] = CMAP_UNKNOWN;
+       if (p_map->seg[s] == NULL)                /* skip to the next segment */
+          ind = segFirst (s) + segSize (s);
+     }
+  pthread_mutex_unlock (&cmapCR);
+}
+
+/*
+ *  Internal functions
+ */
+
+/*
+ *  Find the map of a file (the caller holds the access lock).
+ */
+
+static SOClustMap *findMap (uint32_t nInode)
+{
+  uint32_t i;                                    /* map index */
+
+  for (i = 0; i < CMAP_FILES; i++)
+    if ((cmap[i].refs != 0) && (cmap[i].nInode == nInode)) return &cmap[i];
+
+  return NULL;
+}
+
+/*
+ *  Release the segments of a map (the caller holds the access lock).
+ */
+
+static void freeMap (SOClustMap *p_map)
+{
+  uint32_t s;                                    /* segment index */
+
+  for (s = 0; s < CMAP_SEGS; s++)
+  { free (p_map->seg[s]);
+    p_map->seg[s] = NULL;
+  }
+  p_map->refs = 0;
+}
+
+/*
+ *  Get the segment of a map where a data cluster is kept and its offset within the segment.
+ */
+
+static uint32_t segOf (uint32_t clustInd, uint32_t *p_off)
+{
+  if (clustInd < N_DIRECT)
+     { *p_off = clustInd;
+       return 0;
+     }
+  if (clustInd < N_DIRECT + RPC)
+     { *p_off = clustInd - N_DIRECT;
+       return 1;
+     }
+  *p_off = (clustInd - N_DIRECT - RPC) % RPC;
+
+  return 2 + (clustInd - N_DIRECT - RPC) / RPC;
+}
+
+/*
+ *  Get the index of the first data cluster kept in a segment of a map.
+ */
+
+static uint32_t segFirst (uint32_t s)
+{
+  if (s == 0) return 0;
+  if (s == 1) return N_DIRECT;
+
+  return N_DIRECT + RPC + (s - 2) * RPC;
+}
+
+/*
+ *  Get the number of data clusters kept in a segment of a map.
+ */
+
+static uint32_t segSize (uint32_t s)
+{
+  return (s == 0) ? N_DIRECT : RPC;
+}
@@ -0,0 +1,118 @@
+/**
+ *  \file sofs_clustmap.h (interface file)
+ *
+ *  \brief Map of the logical numbers of the data clusters of open files.
+ *
+ *  For each file that is open, the logical numbers of its data clusters are kept in internal storage as they become
+ *  known, indexed by their position in the list of references of the inode, so that getting the logical number of a
+ *  data cluster that was already looked up does not require the inode, nor the clusters of references, to be read
+ *  again. The map of a file is populated lazily, a whole cluster of references at a time, and is kept up to date by
+ *  the operations which allocate, free or dissociate data clusters of the file.
+ *
+ *  Files are identified by the number of their inode and the map of a file lasts while it is attached to an open-file
+ *  handle. The caller must hold the lock of the inode, in exclusion for the operations which change the map.
+ *
+ *  The operations are:
+ *      \li attach a map to a file
+ *      \li detach a map from a file
+ *      \li look up the logical number of a data cluster of a file, populating the map if necessary
+ *      \li get the logical numbers of a group of successive data clusters of a file from the map
+ *      \li store the logical numbers of a group of successive data clusters of a file in the map
+ *      \li forget the logical numbers of a group of successive data clusters of a file.
+ *
+ *  \remarks In case an error occurs, all functions return a negative value which is the symmetric of the system error
+ *           that better represents the error cause.
+ *           (execute command <em>man errno</em> to get the list of system errors)
+ */
+
+#ifndef SOFS_CLUSTMAP_H_
+#define SOFS_CLUSTMAP_H_
+
+#include <stdint.h>
+
+/** \brief maximum number of files with a map at a time */
+#define CMAP_FILES  32
+
+/**
+ *  \brief Attach a map to a file.
+ *
+ *  Each call must be matched by a call to \e soClustMapDetach. The map of a file is shared by all the open-file
+ *  handles of the file.
+ *
+ *  \param nInode number of the inode associated to the file
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c ENFILE, if there is no room for another map (the file is dealt with as having no map)
+ */
+
+extern int soClustMapAttach (uint32_t nInode);
+
+/**
+ *  \brief Detach a map from a file.
+ *
+ *  The map is released when it is detached from the last open-file handle of the file.
+ *
+ *  \param nInode number of the inode associated to the file
+ */
+
+extern void soClustMapDetach (uint32_t nInode);
+
+/**
+ *  \brief Look up the logical number of a data cluster of a file, populating the map if necessary.
+ *
+ *  If the logical number is not known yet, the logical numbers of all the data clusters whose references are stored
+ *  in the same cluster of references (or in the inode itself, for the direct references) are got by
+ *  \e soGetFileClusters and stored in the map.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param clustInd index to the list of direct references belonging to the inode of the data cluster
+ *  \param p_nClust pointer to the location where the logical number of the data cluster is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c ENOENT, if the file has no map
+ *  \return -<em>other specific error</em> issued by \e soGetFileClusters
+ */
+
+extern int soClustMapLookup (uint32_t nInode, uint32_t clustInd, uint32_t *p_nClust);
+
+/**
+ *  \brief Get the logical numbers of a group of successive data clusters of a file from the map.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param firstInd index to the list of direct references belonging to the inode of the first data cluster
+ *  \param count number of data clusters
+ *  \param nClust pointer to the array where the logical numbers of the data clusters are to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c ENOENT, if the file has no map
+ *  \return -\c ENODATA, if the logical number of some of the data clusters is not known
+ */
+
+extern int soClustMapGet (uint32_t nInode, uint32_t firstInd, uint32_t count, uint32_t *nClust);
+
+/**
+ *  \brief Store the logical numbers of a group of successive data clusters of a file in the map.
+ *
+ *  Nothing is done if the file has no map.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param firstInd index to the list of direct references belonging to the inode of the first data cluster
+ *  \param count number of data clusters
+ *  \param nClust pointer to the array where the logical numbers of the data clusters are stored
+ */
+
+extern void soClustMapSet (uint32_t nInode, uint32_t firstInd, uint32_t count, const uint32_t *nClust);
+
+/**
+ *  \brief Forget the logical numbers of a group of successive data clusters of a file.
+ *
+ *  It must be called when data clusters of the file are freed or dissociated from the inode.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param firstInd index to the list of direct references belonging to the inode of the first data cluster
+ *  \param count number of data clusters (it is clipped to the maximum number of data clusters of a file)
+ */
+
+extern void soClustMapInvalidate (uint32_t nInode, uint32_t firstInd, uint32_t count);
+
+#endif /* SOFS_CLUSTMAP_H_ */
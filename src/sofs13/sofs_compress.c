@@ -0,0 +1,743 @@
+/**
+ *  \file sofs_compress.c (implementation file)
+ *
+ *  \brief Information content of regular files compressed in groups of data clusters.
+ *
+ *  The data clusters of a group are got, allocated and freed one by one through the operations of the file clusters,
+ *  so that the lists of references and the table of cluster-to-inode mapping are dealt with as for any other file, and
+ *  their contents are read and written through the buffercache. The compressed bytes of a group follow its header and
+ *  fill its first data clusters in succession, the rest of the last one being zero. The compressor keeps, for each
+ *  hash of four bytes, the position where they were last found and takes the match found there, if it is one, which
+ *  makes it a single pass over the group; the decoder fails, rather than write out of bounds, on a corrupt group. The
+ *  cache of decompressed groups is accessed in mutual exclusion and its entries are replaced in LRU order.
+ *
+ *  The operations are:
+ *      \li enable or disable the compression of the regular files created from now on
+ *      \li get the format for the information content of a new inode
+ *      \li read a group of successive data clusters of a compressed file
+ *      \li write a group of successive data clusters of a compressed file
+ *      \li clear the data clusters of a compressed file from a given index up to the end of its group
+ *      \li drop the groups of a compressed file from the cache of decompressed groups.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "sofs_probe.h"
+#include "sofs_buffercache.h"
+#include "sofs_superblock.h"
+#include "sofs_inode.h"
+#include "sofs_datacluster.h"
+#include "sofs_basicoper.h"
+#include "sofs_ifuncs_3.h"
+#include "sofs_compress.h"
+
+/** \brief operation allocate a new data cluster and associate it to the inode which describes the file */
+#define ALLOC       1
+/** \brief operation free the referenced data cluster and dissociate it from the inode which describes the file */
+#define FREE_CLEAN  3
+
+/** \brief number of bytes of a group */
+#define GROUP_SIZE  (COMPRESS_GROUP * BSLPC)
+
+/** \brief codec of a compressed group (LZ4 block format) */
+#define CODEC_LZ  1
+
+/** \brief group whose data clusters are all holes */
+#define GRP_HOLE    0
+/** \brief group stored as it is */
+#define GRP_RAW     1
+/** \brief group compressed into its first data clusters */
+#define GRP_PACKED  2
+
+/** \brief minimum length of a match */
+#define LZ_MIN_MATCH      4
+/** \brief number of bits of the hash of four bytes */
+#define LZ_HASH_BITS      12
+/** \brief number of bytes at the end of the input which are always literals */
+#define LZ_LAST_LITERALS  5
+/** \brief number of bytes at the end of the input where no match may start */
+#define LZ_MF_LIMIT       12
+/** \brief maximum distance of a match */
+#define LZ_MAX_OFFSET     65535
+
+/*
+ *  Internal data structure
+ */
+
+/** \brief header of a compressed group, at the beginning of its data cluster of index 0 */
+typedef struct soCompressHeader
+{
+  /** \brief codec the group was compressed with */
+  uint32_t codec;
+  /** \brief number of compressed bytes, which follow the header */
+  uint32_t csize;
+  /** \brief number of uncompressed bytes (the rest of the group is zero) */
+  uint32_t usize;
+} SOCompressHeader;
+
+/** \brief decompressed group */
+typedef struct soCompressEntry
+{
+  /** \brief signals if the entry is in use */
+  bool used;
+  /** \brief number of the inode associated to the file */
+  uint32_t nInode;
+  /** \brief index of the group within the file */
+  uint32_t group;
+  /** \brief time of last access (for LRU replacement) */
+  uint64_t stamp;
+  /** \brief contents of the group */
+  unsigned char data[GROUP_SIZE];
+} SOCompressEntry;
+
+/** \brief signals if the data clusters of the regular files created from now on are to be compressed */
+static bool compressFiles = false;
+/** \brief cache of decompressed groups */
+static SOCompressEntry cache[COMPRESS_CACHE];
+/** \brief clock of the accesses to the cache */
+static uint64_t cacheClock = 0;
+/** \brief access lock to the cache */
+static pthread_mutex_t cacheCR = PTHREAD_MUTEX_INITIALIZER;
+
+/* Allusion to internal functions */
+
+static uint32_t groupSlots (uint32_t group);
+static int groupKind (const uint32_t *map, uint32_t n, uint32_t *p_k);
+static int readGroups (SOSuperBlock *p_sb, uint32_t nInode, uint32_t firstInd, uint32_t count, unsigned char *p_buff,
+                       unsigned char *data);
+static int writeGroups (SOSuperBlock *p_sb, uint32_t nInode, uint32_t firstInd, uint32_t count,
+                        const unsigned char *p_buff, unsigned char *data);
+static int trimGroup (SOSuperBlock *p_sb, uint32_t nInode, uint32_t group, uint32_t first, unsigned char *data);
+static int loadGroup (SOSuperBlock *p_sb, uint32_t nInode, uint32_t group, const uint32_t *map, unsigned char *data,
+                      unsigned char *packed);
+static int storeGroup (SOSuperBlock *p_sb, uint32_t nInode, uint32_t group, uint32_t *map, unsigned char *data,
+                       unsigned char *packed);
+static int readSlots (SOSuperBlock *p_sb, const uint32_t *map, uint32_t count, unsigned char *buf);
+static bool isZero (const unsigned char *buf, uint32_t n);
+static uint32_t lzCompress (const unsigned char *src, uint32_t n, unsigned char *dst, uint32_t cap);
+static bool lzEmit (unsigned char *dst, uint32_t cap, uint32_t *p_op, const unsigned char *lit, uint32_t nLit,
+                    uint32_t off, uint32_t mlen);
+static bool lzDecompress (const unsigned char *src, uint32_t n, unsigned char *dst, uint32_t cap, uint32_t *p_len);
+static bool cacheGet (uint32_t nInode, uint32_t group, unsigned char *data);
+static void cachePut (uint32_t nInode, uint32_t group, const unsigned char *data);
+static void cacheDrop (uint32_t nInode, uint32_t group);
+
+/**
+ *  \brief Enable or disable the compression of the regular files created from now on.
+ *
+ *  It is disabled by default and it concerns only the regular files described by lists of references. The files
+ *  already created keep the format of their information content.
+ *
+ *  \param on signals if the data clusters of the new regular files are to be compressed
+ */
+
+void soSetCompression (bool on)
+{
+  compressFiles = on;
+}
+
+/**
+ *  \brief Get the format for the information content of a new inode.
+ *
+ *  \param type the inode type (either a regular file, or a directory, or a symbolic link)
+ *
+ *  \return \c INODE_COMPRESSED, if the data clusters are to be compressed, or <tt>0 (zero)</tt>, otherwise
+ */
+
+uint32_t soGetCompressFormat (uint32_t type)
+{
+  return (compressFiles && (type == INODE_FILE)) ? INODE_COMPRESSED : 0;
+}
+
+/**
+ *  \brief Read a group of successive data clusters of a compressed file.
+ *
+ *  The data clusters which are holes are returned filled with zeros.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param firstInd index to the list of direct references of the first data cluster
+ *  \param count number of data clusters to be read
+ *  \param buff pointer to the buffer where data must be read into (it must hold <tt>count</tt> data clusters)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>range of indexes to the list of direct references</em> is out of range or the
+ *                      <em>pointer to the buffer area</em> is \c NULL
+ *  \return -\c ENOMEM, if there is no memory for the contents of a group
+ *  \return -\c ELIBBAD, if a compressed group is corrupt
+ *  \return -<em>other specific error</em> issued by \e soGetFileClusters or when reading the data clusters
+ */
+
+int soCompressRead (uint32_t nInode, uint32_t firstInd, uint32_t count, void *buff)
+{
+  soColorProbe (840, "07;31", "soCompressRead (%"PRIu32", %"PRIu32", %"PRIu32", %p)\n", nInode, firstInd, count, buff);
+
+  SOSuperBlock *p_sb;                            /* pointer to the superblock */
+  unsigned char *data;                           /* contents of a compressed group and of its data clusters */
+  int stat;                                      /* status of operation */
+
+  if ((buff == NULL) || ((uint64_t) firstInd + count > MAX_FILE_CLUSTERS)) return -EINVAL;
+  if ((stat = soLoadSuperBlock ()) != 0) return stat;
+  p_sb = soGetSuperBlock ();
+
+  /* the contents of a group may be too large for the stack, when the data clusters are large */
+
+  if ((data = malloc (2 * GROUP_SIZE)) == NULL) return -ENOMEM;
+  stat = readGroups (p_sb, nInode, firstInd, count, buff, data);
+  free (data);
+
+  return stat;
+}
+
+/**
+ *  \brief Write a group of successive data clusters of a compressed file.
+ *
+ *  Each group involved is compressed again and the data clusters it needs are allocated, while those it no longer
+ *  needs are freed.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param firstInd index to the list of direct references of the first data cluster
+ *  \param count number of data clusters to be written
+ *  \param buff pointer to the buffer where data must be written from (it must hold <tt>count</tt> data clusters)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>range of indexes to the list of direct references</em> is out of range or the
+ *                      <em>pointer to the buffer area</em> is \c NULL
+ *  \return -\c ENOMEM, if there is no memory for the contents of a group
+ *  \return -\c ELIBBAD, if a compressed group which is partly written is corrupt
+ *  \return -<em>other specific error</em> issued by \e soGetFileClusters, \e soHandleFileCluster or when reading or
+ *          writing the data clusters
+ */
+
+int soCompressWrite (uint32_t nInode, uint32_t firstInd, uint32_t count, const void *buff)
+{
+  soColorProbe (841, "07;31", "soCompressWrite (%"PRIu32", %"PRIu32", %"PRIu32", %p)\n", nInode, firstInd, count,
+                buff);
+
+  SOSuperBlock *p_sb;                            /* pointer to the superblock */
+  unsigned char *data;                           /* contents of a group and of its compressed data clusters */
+  int stat;                                      /* status of operation */
+
+  if ((buff == NULL) || ((uint64_t) firstInd + count > MAX_FILE_CLUSTERS)) return -EINVAL;
+  if ((stat = soLoadSuperBlock ()) != 0) return stat;
+  p_sb = soGetSuperBlock ();
+
+  if ((data = malloc (2 * GROUP_SIZE)) == NULL) return -ENOMEM;
+  stat = writeGroups (p_sb, nInode, firstInd, count, buff, data);
+  free (data);
+
+  return stat;
+}
+
+/**
+ *  \brief Clear the data clusters of a compressed file from a given index up to the end of its group.
+ *
+ *  It is meant to precede freeing the data clusters of a file from a given index onwards, which must then start at the
+ *  beginning of a group.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param clustInd index to the list of direct references of the first data cluster to be cleared
+ *  \param p_ind pointer to the location where the index of the first data cluster of the next group is to be stored
+ *               (or \e clustInd, if it is the first of its group)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>index to the list of direct references</em> is out of range or the pointer to the
+ *                      location is \c NULL
+ *  \return -\c ENOMEM, if there is no memory for the contents of the group
+ *  \return -\c ELIBBAD, if the group is corrupt
+ *  \return -<em>other specific error</em> issued by \e soGetFileClusters, \e soHandleFileCluster or when reading or
+ *          writing the data clusters
+ */
+
+int soCompressTrim (uint32_t nInode, uint32_t clustInd, uint32_t *p_ind)
+{
+  soColorProbe (842, "07;31", "soCompressTrim (%"PRIu32", %"PRIu32", %p)\n", nInode, clustInd, p_ind);
+
+  SOSuperBlock *p_sb;                            /* pointer to the superblock */
+  unsigned char *data;                           /* contents of the group and of its compressed data clusters */
+  uint32_t group, first;                         /* index of the group and of its first data cluster to be cleared */
+  int stat;                                      /* status of operation */
+
+  if ((clustInd >= MAX_FILE_CLUSTERS) || (p_ind == NULL)) return -EINVAL;
+  group = clustInd / COMPRESS_GROUP;
+  first = clustInd % COMPRESS_GROUP;
+  if (first == 0)
+     { *p_ind = clustInd;
+       return 0;
+     }
+  *p_ind = group * COMPRESS_GROUP + groupSlots (group);
+
+  if ((stat = soLoadSuperBlock ()) != 0) return stat;
+  p_sb = soGetSuperBlock ();
+  if ((data = malloc (2 * GROUP_SIZE)) == NULL) return -ENOMEM;
+  stat = trimGroup (p_sb, nInode, group, first, data);
+  free (data);
+
+  return stat;
+}
+
+/**
+ *  \brief Drop the groups of a compressed file from the cache of decompressed groups.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param clustInd index to the list of direct references of a data cluster: the groups holding it and the ones after
+ *                  it are dropped
+ */
+
+void soCompressDrop (uint32_t nInode, uint32_t clustInd)
+{
+  soColorProbe (843, "07;31", "soCompressDrop (%"PRIu32", %"PRIu32")\n", nInode, clustInd);
+
+  uint32_t i;                                    /* entry index */
+
+  pthread_mutex_lock (&cacheCR);
+  for (i = 0; i < COMPRESS_CACHE; i++)
+    if (cache[i].used && (cache[i].nInode == nInode) && (cache[i].group >= clustInd / COMPRESS_GROUP))
+       cache[i].used = false;
+  pthread_mutex_unlock (&cacheCR);
+}
+
+/*
+ *  Read count data clusters of a compressed file, starting at index firstInd, into p_buff. The buffer data must hold
+ *  two groups: the contents of a group and those of its compressed data clusters.
+ */
+
+static int readGroups (SOSuperBlock *p_sb, uint32_t nInode, uint32_t firstInd, uint32_t count, unsigned char *p_buff,
+                       unsigned char *data)
+{
+  uint32_t map[COMPRESS_GROUP];                  /* logical numbers of the data clusters of a group */
+  uint32_t ind, end, group, first, n, k;         /* indexes of the data clusters and part of the group being read */
+  int kind, stat;                                /* kind of group and status of operation */
+
+  end = firstInd + count;
+  for (ind = firstInd; ind < end; ind += k, p_buff += (size_t) k * BSLPC)
+  { group = ind / COMPRESS_GROUP;
+    first = ind % COMPRESS_GROUP;
+    n = groupSlots (group);
+    k = (end - ind < n - first) ? end - ind : n - first;
+    if ((stat = soGetFileClusters (nInode, group * COMPRESS_GROUP, n, map)) != 0) return stat;
+    if ((kind = groupKind (map, n, NULL)) < 0) return kind;
+    switch (kind)
+    { case GRP_HOLE:
+        memset (p_buff, 0, (size_t) k * BSLPC);
+        break;
+      case GRP_RAW:                              /* only the data clusters requested are read */
+        if ((stat = readSlots (p_sb, map + first, k, p_buff)) != 0) return stat;
+        break;
+      default:
+        if ((stat = loadGroup (p_sb, nInode, group, map, data, data + GROUP_SIZE)) != 0) return stat;
+        memcpy (p_buff, data + (size_t) first * BSLPC, (size_t) k * BSLPC);
+    }
+  }
+
+  return 0;
+}
+
+/*
+ *  Write count data clusters of a compressed file, starting at index firstInd, from p_buff. The buffer data must hold
+ *  two groups, as for readGroups.
+ */
+
+static int writeGroups (SOSuperBlock *p_sb, uint32_t nInode, uint32_t firstInd, uint32_t count,
+                        const unsigned char *p_buff, unsigned char *data)
+{
+  uint32_t map[COMPRESS_GROUP];                  /* logical numbers of the data clusters of a group */
+  uint32_t ind, end, group, first, n, k;         /* indexes of the data clusters and part of the group being written */
+  int stat;                                      /* status of operation */
+
+  end = firstInd + count;
+  for (ind = firstInd; ind < end; ind += k, p_buff += (size_t) k * BSLPC)
+  { group = ind / COMPRESS_GROUP;
+    first = ind % COMPRESS_GROUP;
+    n = groupSlots (group);
+    k = (end - ind < n - first) ? end - ind : n - first;
+    if ((stat = soGetFileClusters (nInode, group * COMPRESS_GROUP, n, map)) != 0) return stat;
+
+    /* a group which is only partly written is read first */
+
+    if ((k < n) && ((stat = loadGroup (p_sb, nInode, group, map, data, data + GROUP_SIZE)) != 0)) return stat;
+    memcpy (data + (size_t) first * BSLPC, p_buff, (size_t) k * BSLPC);
+    if ((stat = storeGroup (p_sb, nInode, group, map, data, data + GROUP_SIZE)) != 0) return stat;
+  }
+
+  return 0;
+}
+
+/*
+ *  Clear the data clusters of a group of a compressed file from its index first onwards. The buffer data must hold two
+ *  groups, as for readGroups.
+ */
+
+static int trimGroup (SOSuperBlock *p_sb, uint32_t nInode, uint32_t group, uint32_t first, unsigned char *data)
+{
+  uint32_t map[COMPRESS_GROUP];                  /* logical numbers of the data clusters of the group */
+  uint32_t n;                                    /* number of data clusters of the group */
+  int kind, stat;                                /* kind of group and status of operation */
+
+  n = groupSlots (group);
+  if ((stat = soGetFileClusters (nInode, group * COMPRESS_GROUP, n, map)) != 0) return stat;
+  if ((kind = groupKind (map, n, NULL)) < 0) return kind;
+  if (kind == GRP_HOLE) return 0;
+  if ((stat = loadGroup (p_sb, nInode, group, map, data, data + GROUP_SIZE)) != 0) return stat;
+  memset (data + (size_t) first * BSLPC, 0, (size_t) (n - first) * BSLPC);
+
+  return storeGroup (p_sb, nInode, group, map, data, data + GROUP_SIZE);
+}
+
+/*
+ *  Get the number of data clusters of a group: only the last group of the largest file has fewer than COMPRESS_GROUP.
+ */
+
+static uint32_t groupSlots (uint32_t group)
+{
+  uint32_t first = group * COMPRESS_GROUP;       /* index of the first data cluster of the group */
+
+  return (MAX_FILE_CLUSTERS - first < COMPRESS_GROUP) ? MAX_FILE_CLUSTERS - first : COMPRESS_GROUP;
+}
+
+/*
+ *  Tell the kind of a group from the logical numbers of its n data clusters and, for a compressed group, the number of
+ *  data clusters holding it (in *p_k, if p_k is not NULL). A compressed group whose data clusters do not come first is
+ *  corrupt.
+ */
+
+static int groupKind (const uint32_t *map, uint32_t n, uint32_t *p_k)
+{
+  uint32_t k, i;                                 /* number of data clusters in use and counting variable */
+
+  for (i = 0; (i < n) && (map[i] == NULL_CLUSTER); i++);
+  if (i == n) return GRP_HOLE;
+  if ((n < COMPRESS_GROUP) || (map[n - 1] != NULL_CLUSTER)) return GRP_RAW;
+
+  for (k = 0; (k < n) && (map[k] != NULL_CLUSTER); k++);
+  for (i = k; i < n; i++)
+    if (map[i] != NULL_CLUSTER) return -ELIBBAD;
+  if (p_k != NULL) *p_k = k;
+
+  return GRP_PACKED;
+}
+
+/*
+ *  Get the contents of a group, whatever its kind, from the logical numbers of its data clusters, using packed (of the
+ *  size of a group) for its compressed data clusters. A compressed group is taken from the cache, if it is there, or
+ *  is put in it, otherwise.
+ */
+
+static int loadGroup (SOSuperBlock *p_sb, uint32_t nInode, uint32_t group, const uint32_t *map, unsigned char *data,
+                      unsigned char *packed)
+{
+  SOCompressHeader hdr;                          /* header of a compressed group */
+  uint32_t n, k, len;                            /* number of data clusters of the group and of those in use, length */
+  int kind, stat;                                /* kind of group and status of operation */
+
+  n = groupSlots (group);
+  if ((kind = groupKind (map, n, &k)) < 0) return kind;
+  if (n < COMPRESS_GROUP)
+     memset (data + (size_t) n * BSLPC, 0, (size_t) (COMPRESS_GROUP - n) * BSLPC);
+  if (kind == GRP_HOLE)
+     { memset (data, 0, (size_t) n * BSLPC);
+       return 0;
+     }
+  if (kind == GRP_RAW) return readSlots (p_sb, map, n, data);
+  if (cacheGet (nInode, group, data)) return 0;
+
+  /* the header must agree with the number of data clusters in use */
+
+  if ((stat = readSlots (p_sb, map, k, packed)) != 0) return stat;
+  memcpy (&hdr, packed, sizeof (hdr));
+  if ((hdr.codec != CODEC_LZ) || (hdr.usize > GROUP_SIZE) || (hdr.csize > k * BSLPC - sizeof (hdr)) ||
+      ((sizeof (hdr) + hdr.csize + BSLPC - 1) / BSLPC != k))
+     return -ELIBBAD;
+  if (!lzDecompress (packed + sizeof (hdr), hdr.csize, data, hdr.usize, &len) || (len != hdr.usize))
+     return -ELIBBAD;
+  memset (data + len, 0, GROUP_SIZE - len);
+  cachePut (nInode, group, data);
+
+  return 0;
+}
+
+/*
+ *  Store the contents of a group, given the logical numbers of its data clusters, which are updated, using packed (of
+ *  the size of a group) for its compressed data clusters: it is compressed, if that takes fewer data clusters than
+ *  storing it as it is, and it is freed, if it holds only zeros.
+ */
+
+static int storeGroup (SOSuperBlock *p_sb, uint32_t nInode, uint32_t group, uint32_t *map, unsigned char *data,
+                       unsigned char *packed)
+{
+  SOCompressHeader hdr;                          /* header of the compressed group */
+  bool used[COMPRESS_GROUP];                     /* signals which data clusters are not all zero */
+  uint32_t n, nz, raw, k, last, i;               /* numbers of data clusters and counting variable */
+  unsigned char *p_clust;                        /* pointer to the contents of the data cluster being written */
+  int stat;                                      /* status of operation */
+
+  n = groupSlots (group);
+  for (i = nz = 0, last = 0; i < n; i++)
+    if ((used[i] = !isZero (data + (size_t) i * BSLPC, BSLPC)))
+       { nz += 1;
+         last = i;
+       }
+
+  /* a group stored as it is needs its last data cluster, even if it holds only zeros, unless it is a hole */
+
+  k = 0;
+  raw = nz + (((nz != 0) && (n == COMPRESS_GROUP) && !used[n - 1]) ? 1 : 0);
+  if ((n == COMPRESS_GROUP) && (raw > 1))
+     { hdr.usize = (last + 1) * BSLPC;           /* the trailing zeros are not compressed */
+       while (data[hdr.usize - 1] == 0) hdr.usize--;
+       hdr.codec = CODEC_LZ;
+       hdr.csize = lzCompress (data, hdr.usize, packed + sizeof (hdr), (raw - 1) * BSLPC - sizeof (hdr));
+       if (hdr.csize != 0)
+          { k = (sizeof (hdr) + hdr.csize + BSLPC - 1) / BSLPC;
+            memcpy (packed, &hdr, sizeof (hdr));
+            memset (packed + sizeof (hdr) + hdr.csize, 0, k * BSLPC - sizeof (hdr) - hdr.csize);
+          }
+     }
+
+  for (i = 0; i < n; i++)
+  { if (k != 0)
+       p_clust = (i < k) ? packed + (size_t) i * BSLPC : NULL;
+       else p_clust = (used[i] || ((raw > nz) && (i == n - 1))) ? data + (size_t) i * BSLPC : NULL;
+    if (p_clust == NULL)
+       { if ((map[i] != NULL_CLUSTER) &&
+             ((stat = soHandleFileCluster (nInode, group * COMPRESS_GROUP + i, FREE_CLEAN, NULL)) != 0))
+            return stat;
+         map[i] = NULL_CLUSTER;
+         continue;
+       }
+    if ((map[i] == NULL_CLUSTER) &&
+        ((stat = soHandleFileCluster (nInode, group * COMPRESS_GROUP + i, ALLOC, &map[i])) != 0))
+       return stat;
+    if ((stat = soWriteCacheCluster (p_sb->dzone_start + map[i] * BLOCKS_PER_CLUSTER, p_clust)) != 0)
+       return stat;
+  }
+
+  /* the cache is written through */
+
+  if (k != 0)
+     cachePut (nInode, group, data);
+     else cacheDrop (nInode, group);
+
+  return 0;
+}
+
+/*
+ *  Read count data clusters, given their logical numbers, into buf: those which are holes are filled with zeros and
+ *  those which are stored in successive clusters of the data zone are read by a single transfer.
+ */
+
+static int readSlots (SOSuperBlock *p_sb, const uint32_t *map, uint32_t count, unsigned char *buf)
+{
+  uint32_t i, run;                               /* counting variable and length of a run of data clusters */
+  int stat;                                      /* status of operation */
+
+  for (i = 0; i < count; i += run)
+  { if (map[i] == NULL_CLUSTER)
+       { memset (buf + (size_t) i * BSLPC, 0, BSLPC);
+         run = 1;
+         continue;
+       }
+    for (run = 1; (i + run < count) && (map[i + run] == map[i] + run); run++);
+    if ((stat = soReadCacheClusters (p_sb->dzone_start + map[i] * BLOCKS_PER_CLUSTER, run,
+                                     buf + (size_t) i * BSLPC)) != 0)
+       return stat;
+  }
+
+  return 0;
+}
+
+/*
+ *  Check if a buffer of n bytes holds only zeros.
+ */
+
+static bool isZero (const unsigned char *buf, uint32_t n)
+{
+  return (n == 0) || ((buf[0] == 0) && (memcmp (buf, buf + 1, n - 1) == 0));
+}
+
+/*
+ *  Compress n bytes from src into dst, whose size is cap, in the format of LZ4 blocks. It returns the number of bytes
+ *  produced, or zero, if they do not fit.
+ */
+
+static uint32_t lzCompress (const unsigned char *src, uint32_t n, unsigned char *dst, uint32_t cap)
+{
+  uint32_t table[1 << LZ_HASH_BITS];             /* last position (plus one) of each hash of four bytes (zero, none) */
+  uint32_t ip, anchor, op, ref, len, h, v;       /* positions in the buffers, length of a match and hash */
+
+  memset (table, 0, sizeof (table));
+  ip = anchor = op = 0;
+  while (ip + LZ_MF_LIMIT <= n)
+  { memcpy (&v, src + ip, sizeof (v));
+    h = (v * 2654435761U) >> (32 - LZ_HASH_BITS);
+    ref = table[h];
+    table[h] = ip + 1;
+    if ((ref == 0) || (ip - (ref - 1) > LZ_MAX_OFFSET) || (memcmp (src + ref - 1, src + ip, LZ_MIN_MATCH) != 0))
+       { ip += 1;
+         continue;
+       }
+    ref -= 1;
+    for (len = LZ_MIN_MATCH; (ip + len < n - LZ_LAST_LITERALS) && (src[ref + len] == src[ip + len]); len++);
+    if (!lzEmit (dst, cap, &op, src + anchor, ip - anchor, ip - ref, len)) return 0;
+    ip += len;
+    anchor = ip;
+  }
+
+  /* the block ends with a run of literals which is not followed by a match */
+
+  if (!lzEmit (dst, cap, &op, src + anchor, n - anchor, 0, 0)) return 0;
+
+  return op;
+}
+
+/*
+ *  Append a sequence to dst (of size cap), at position *p_op: a run of nLit literals followed by a match of mlen bytes
+ *  at distance off, or by none, if mlen is zero. It returns false, if the sequence does not fit.
+ */
+
+static bool lzEmit (unsigned char *dst, uint32_t cap, uint32_t *p_op, const unsigned char *lit, uint32_t nLit,
+                    uint32_t off, uint32_t mlen)
+{
+  uint32_t op = *p_op;                           /* position in the output */
+  uint32_t need, ml, r;                          /* bytes needed, length of the match to be coded and remainder */
+
+  ml = (mlen != 0) ? mlen - LZ_MIN_MATCH : 0;
+  need = 1 + nLit + ((nLit >= 15) ? (nLit - 15) / 255 + 1 : 0);
+  if (mlen != 0) need += 2 + ((ml >= 15) ? (ml - 15) / 255 + 1 : 0);
+  if (need > cap - op) return false;
+
+  dst[op++] = (unsigned char) ((((nLit < 15) ? nLit : 15) << 4) | ((ml < 15) ? ml : 15));
+  if (nLit >= 15)
+     { for (r = nLit - 15; r >= 255; r -= 255)
+         dst[op++] = 255;
+       dst[op++] = (unsigned char) r;
+     }
+  memcpy (dst + op, lit, nLit);
+  op += nLit;
+  if (mlen != 0)
+     { dst[op++] = (unsigned char) (off & 0xff);
+       dst[op++] = (unsigned char) (off >> 8);
+       if (ml >= 15)
+          { for (r = ml - 15; r >= 255; r -= 255)
+              dst[op++] = 255;
+            dst[op++] = (unsigned char) r;
+          }
+     }
+  *p_op = op;
+
+  return true;
+}
+
+/*
+ *  Decompress n bytes of a block in the format of LZ4 from src into dst, whose size is cap, storing the number of bytes
+ *  produced in *p_len. It returns false, if the block is corrupt: every length and offset is checked against the
+ *  bounds of both buffers.
+ */
+
+static bool lzDecompress (const unsigned char *src, uint32_t n, unsigned char *dst, uint32_t cap, uint32_t *p_len)
+{
+  uint32_t ip, op, lit, ml, off, i;              /* positions in the buffers, lengths and distance of a match */
+  unsigned char token, b;                        /* token of a sequence and byte of a length */
+
+  ip = op = 0;
+  while (true)
+  { if (ip >= n) return false;                   /* the block must end with a run of literals */
+    token = src[ip++];
+    lit = token >> 4;
+    if (lit == 15)
+       do
+       { if (ip >= n) return false;
+         b = src[ip++];
+         lit += b;
+       } while (b == 255);
+    if ((lit > n - ip) || (lit > cap - op)) return false;
+    memcpy (dst + op, src + ip, lit);
+    ip += lit;
+    op += lit;
+    if (ip == n) break;
+
+    if (n - ip < 2) return false;
+    off = src[ip] | ((uint32_t) src[ip + 1] << 8);
+    ip += 2;
+    if ((off == 0) || (off > op)) return false;
+    ml = token & 15;
+    if (ml == 15)
+       do
+       { if (ip >= n) return false;
+         b = src[ip++];
+         ml += b;
+       } while (b == 255);
+    ml += LZ_MIN_MATCH;
+    if (ml > cap - op) return false;
+    for (i = 0; i < ml; i++, op++)               /* the match may overlap the bytes it produces */
+      dst[op] = dst[op - off];
+  }
+  *p_len = op;
+
+  return true;
+}
+
+/*
+ *  Get a group from the cache into data. It returns false, if the group is not there.
+ */
+
+static bool cacheGet (uint32_t nInode, uint32_t group, unsigned char *data)
+{
+  uint32_t i;                                    /* entry index */
+
+  pthread_mutex_lock (&cacheCR);
+  for (i = 0; (i < COMPRESS_CACHE) && (!cache[i].used || (cache[i].nInode != nInode) || (cache[i].group != group));
+       i++);
+  if (i < COMPRESS_CACHE)
+     { memcpy (data, cache[i].data, GROUP_SIZE);
+       cache[i].stamp = ++cacheClock;
+     }
+  pthread_mutex_unlock (&cacheCR);
+
+  return i < COMPRESS_CACHE;
+}
+
+/*
+ *  Put a group in the cache, replacing the entry of the same group, if there is one, or the least recently used one.
+ */
+
+static void cachePut (uint32_t nInode, uint32_t group, const unsigned char *data)
+{
+  uint32_t i, v;                                 /* entry index and index of the entry to be replaced */
+
+  pthread_mutex_lock (&cacheCR);
+  for (i = 0, v = 0; i < COMPRESS_CACHE; i++)
+  { if (cache[i].used && (cache[i].nInode == nInode) && (cache[i].group == group))
+       { v = i;
+         break;
+       }
+    if (cache[v].used && (!cache[i].used || (cache[i].stamp < cache[v].stamp)))
+       v = i;
+  }
+  cache[v].used = true;
+  cache[v].nInode = nInode;
+  cache[v].group = group;
+  cache[v].stamp = ++cacheClock;
+  memcpy (cache[v].data, data, GROUP_SIZE);
+  pthread_mutex_unlock (&cacheCR);
+}
+
+/*
+ *  Drop a group from the cache.
+ */
+
+static void cacheDrop (uint32_t nInode, uint32_t group)
+{
+  uint32_t i;                                    /* entry index */
+
+  pthread_mutex_lock (&cacheCR);
+  for (i = 0; i < COMPRESS_CACHE; i++)
+    if (cache[i].used && (cache[i].nInode == nInode) && (cache[i].group == group))
+       cache[i].used = false;
+  pthread_mutex_unlock (&cacheCR);
+}
@@ -0,0 +1,150 @@
+/**
+ *  \file sofs_compress.h (interface file)
+ *
+ *  \brief Information content of regular files compressed in groups of data clusters.
+ *
+ *  The data clusters of a regular file may be compressed, when it is signaled in the inode mode. The file is then seen
+ *  as a sequence of groups of \c COMPRESS_GROUP data clusters with successive indexes, starting at index 0, each one
+ *  stored in the data clusters of the group itself, which are referenced as usual by the lists of references. What a
+ *  group holds is told by which of them are allocated:
+ *      \li none: the group is a hole, whose data clusters all read as zeros
+ *      \li the last one: the group is stored as it is, each data cluster holding its own bytes (or being a hole)
+ *      \li some, but not the last one: the group is compressed into its first data clusters, the one of index 0
+ *          starting with a header which gives the codec and the sizes of the compressed and of the uncompressed bytes.
+ *
+ *  So, a group is compressed only if it takes fewer data clusters that way and the data clusters of a compressed file
+ *  are still data clusters of the file for the consistency checks. A group which holds only zeros is freed. The last
+ *  group of the largest file has fewer data clusters than the others and is always stored as it is.
+ *
+ *  The codec is a byte-oriented compressor of the family of LZ77, with the format of LZ4 blocks (a sequence of runs of
+ *  literals, each one followed by a match of at least four bytes within the last 64 KiB), fast enough to compress a
+ *  group at each write and whose decoder checks every length and offset against the bounds of the buffers.
+ *
+ *  Reading a data cluster of a compressed group requires the whole group to be decompressed, so the groups most
+ *  recently decompressed are kept in a small cache, which is written through and whose entries are dropped when the
+ *  data clusters of the group are freed. Writing into a group rewrites the whole of it, after reading it, unless the
+ *  group is fully written.
+ *
+ *  The caller must hold the lock of the inode.
+ *
+ *  The operations are:
+ *      \li enable or disable the compression of the regular files created from now on
+ *      \li get the format for the information content of a new inode
+ *      \li read a group of successive data clusters of a compressed file
+ *      \li write a group of successive data clusters of a compressed file
+ *      \li clear the data clusters of a compressed file from a given index up to the end of its group
+ *      \li drop the groups of a compressed file from the cache of decompressed groups.
+ *
+ *  \remarks In case an error occurs, all functions return a negative value which is the symmetric of the system error
+ *           that better represents the error cause.
+ *           (execute command <em>man errno</em> to get the list of system errors)
+ */
+
+#ifndef SOFS_COMPRESS_H_
+#define SOFS_COMPRESS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/** \brief number of data clusters of a group which is compressed as a whole */
+#define COMPRESS_GROUP  8
+
+/** \brief number of groups kept in the cache of decompressed groups */
+#define COMPRESS_CACHE  16
+
+/**
+ *  \brief Enable or disable the compression of the regular files created from now on.
+ *
+ *  It is disabled by default and it concerns only the regular files described by lists of references. The files
+ *  already created keep the format of their information content.
+ *
+ *  \param on signals if the data clusters of the new regular files are to be compressed
+ */
+
+extern void soSetCompression (bool on);
+
+/**
+ *  \brief Get the format for the information content of a new inode.
+ *
+ *  \param type the inode type (either a regular file, or a directory, or a symbolic link)
+ *
+ *  \return \c INODE_COMPRESSED, if the data clusters are to be compressed, or <tt>0 (zero)</tt>, otherwise
+ */
+
+extern uint32_t soGetCompressFormat (uint32_t type);
+
+/**
+ *  \brief Read a group of successive data clusters of a compressed file.
+ *
+ *  The data clusters which are holes are returned filled with zeros.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param firstInd index to the list of direct references of the first data cluster
+ *  \param count number of data clusters to be read
+ *  \param buff pointer to the buffer where data must be read into (it must hold <tt>count</tt> data clusters)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>range of indexes to the list of direct references</em> is out of range or the
+ *                      <em>pointer to the buffer area</em> is \c NULL
+ *  \return -\c ENOMEM, if there is no memory for the contents of a group
+ *  \return -\c ELIBBAD, if a compressed group is corrupt
+ *  \return -<em>other specific error</em> issued by \e soGetFileClusters or when reading the data clusters
+ */
+
+extern int soCompressRead (uint32_t nInode, uint32_t firstInd, uint32_t count, void *buff);
+
+/**
+ *  \brief Write a group of successive data clusters of a compressed file.
+ *
+ *  Each group involved is compressed again and the data clusters it needs are allocated, while those it no longer
+ *  needs are freed.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param firstInd index to the list of direct references of the first data cluster
+ *  \param count number of data clusters to be written
+ *  \param buff pointer to the buffer where data must be written from (it must hold <tt>count</tt> data clusters)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>range of indexes to the list of direct references</em> is out of range or the
+ *                      <em>pointer to the buffer area</em> is \c NULL
+ *  \return -\c ENOMEM, if there is no memory for the contents of a group
+ *  \return -\c ELIBBAD, if a compressed group which is partly written is corrupt
+ *  \return -<em>other specific error</em> issued by \e soGetFileClusters, \e soHandleFileCluster or when reading or
+ *          writing the data clusters
+ */
+
+extern int soCompressWrite (uint32_t nInode, uint32_t firstInd, uint32_t count, const void *buff);
+
+/**
+ *  \brief Clear the data clusters of a compressed file from a given index up to the end of its group.
+ *
+ *  It is meant to precede freeing the data clusters of a file from a given index onwards, which must then start at the
+ *  beginning of a group.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param clustInd index to the list of direct references of the first data cluster to be cleared
+ *  \param p_ind pointer to the location where the index of the first data cluster of the next group is to be stored
+ *               (or \e clustInd, if it is the first of its group)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>index to the list of direct references</em> is out of range or the pointer to the
+ *                      location is \c NULL
+ *  \return -\c ENOMEM, if there is no memory for the contents of the group
+ *  \return -\c ELIBBAD, if the group is corrupt
+ *  \return -<em>other specific error</em> issued by \e soGetFileClusters, \e soHandleFileCluster or when reading or
+ *          writing the data clusters
+ */
+
+extern int soCompressTrim (uint32_t nInode, uint32_t clustInd, uint32_t *p_ind);
+
+/**
+ *  \brief Drop the groups of a compressed file from the cache of decompressed groups.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param clustInd index to the list of direct references of a data cluster: the groups holding it and the ones after
+ *                  it are dropped
+ */
+
+extern void soCompressDrop (uint32_t nInode, uint32_t clustInd);
+
+#endif /* SOFS_COMPRESS_H_ */
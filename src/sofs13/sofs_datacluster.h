@@ -31,6 +31,28 @@
 /** \brief number of directory entries per data cluster */
 #define DPC (CLUSTER_SIZE / sizeof (SODirEntry))
 
+/**
+ *  \brief Definition of an extent: a run of data clusters of a file with successive indexes, whose logical numbers are
+ *         successive as well.
+ *
+ *  In the nodes of a tree of extents which are not leaves, it describes instead a node of the level below: \e first is
+ *  then a lower bound of the indexes of the data clusters described there, \e count is not used (zero) and \e nClust
+ *  is its logical number. An entry not in use has all fields set to \c NULL_CLUSTER.
+ */
+
+typedef struct soExtent
+{
+   /** \brief index to the list of direct references of the first data cluster */
+    uint32_t first;
+   /** \brief number of data clusters */
+    uint32_t count;
+   /** \brief logical number of the first data cluster (or of the node below) */
+    uint32_t nClust;
+} SOExtent;
+
+/** \brief number of extents per data cluster */
+#define EPC (CLUSTER_SIZE / sizeof (SOExtent))
+
 /**
  *  \brief Definition of the data cluster data type.
  *
@@ -39,7 +61,8 @@
  *  It may either contain:
  *     \li a stream of bytes
  *     \li a sub-array of data cluster references
- *     \li a sub-array of directory entries.
+ *     \li a sub-array of directory entries
+ *     \li a sub-array of extents (a node of a tree of extents).
  */
 
 typedef union soDataClust
@@ -50,6 +73,8 @@ typedef union soDataClust
     uint32_t ref[RPC];
    /** \brief sub-array of directory entries */
     SODirEntry de[DPC];
+   /** \brief sub-array of extents */
+    SOExtent ext[EPC];
 } SODataClust;
 
 #endif /* SOFS_DATACLUSTER_H_ */
@@ -0,0 +1,415 @@
+/**
+ *  \file sofs_delalloc.c (implementation file)
+ *
+ *  \brief Delayed allocation of the data clusters of regular files.
+ *
+ *  The write buffers are kept in a table with a fixed number of elements, accessed in mutual exclusion. The contents of
+ *  a buffer is only changed, or read, by the holder of the lock of the inode, so the access lock to the table is not
+ *  held while it is flushed: the element is detached from the table first.
+ *
+ *  The operations are:
+ *      \li write data into the buffer of a file
+ *      \li overlay the buffered data of a file on data that was read from it
+ *      \li get the size of a file, taking into account its buffered data
+ *      \li flush the buffer of a file
+ *      \li flush the buffers of all files
+ *      \li drop the buffered data of a file from a given position onwards.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "sofs_probe.h"
+#include "sofs_buffercache.h"
+#include "sofs_superblock.h"
+#include "sofs_inode.h"
+#include "sofs_datacluster.h"
+#include "sofs_basicoper.h"
+#include "sofs_ifuncs_2.h"
+#include "sofs_ifuncs_3.h"
+#include "sofs_delalloc.h"
+
+/*
+ *  Internal data structure
+ */
+
+/** \brief write buffer of a file */
+typedef struct soDelAllocBuf
+{
+  /** \brief signals if the element holds a buffer */
+  bool used;
+  /** \brief number of the inode associated to the file */
+  uint32_t nInode;
+  /** \brief [byte] position in the file data continuum of the first byte of the buffer */
+  uint32_t pos;
+  /** \brief number of bytes buffered */
+  uint32_t len;
+  /** \brief size of the storage area */
+  uint32_t size;
+  /** \brief storage area */
+  unsigned char *data;
+} SODelAllocBuf;
+
+/** \brief table of write buffers */
+static SODelAllocBuf daBuf[DA_FILES];
+/** \brief overall size of the storage areas of the write buffers */
+static uint32_t daBytes = 0;
+/** \brief access lock to the table of write buffers */
+static pthread_mutex_t daCR = PTHREAD_MUTEX_INITIALIZER;
+
+/* Allusion to internal functions */
+
+static SODelAllocBuf *findBuf (uint32_t nInode);
+static int flushBuf (SODelAllocBuf *p_buf);
+static int writePartial (uint32_t nInode, uint32_t clustInd, uint32_t off, const unsigned char *data, uint32_t n);
+
+/**
+ *  \brief Write data into the buffer of a file.
+ *
+ *  If the data can not be buffered, whatever was buffered for the file is flushed and the caller must write the data
+ *  directly into the file.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param buff pointer to the buffer where data to be written is stored
+ *  \param count number of bytes to be written
+ *  \param pos starting [byte] position in the file data continuum where data is to be written into
+ *  \param p_buffered pointer to the location where the indication of the data having been buffered is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -<em>other specific error</em> issued by \e soDelAllocFlush
+ */
+
+int soDelAllocWrite (uint32_t nInode, const void *buff, uint32_t count, uint32_t pos, bool *p_buffered)
+{
+  soColorProbe (781, "07;31", "soDelAllocWrite (%"PRIu32", %p, %"PRIu32", %"PRIu32", %p)\n", nInode, buff, count, pos,
+                p_buffered);
+
+  SODelAllocBuf *p_buf;                          /* pointer to the buffer of the file */
+  uint32_t need;                                 /* size required for the buffer */
+  uint32_t size;                                 /* new size of the storage area */
+  unsigned char *data;                           /* new storage area */
+  uint32_t i;                                    /* element index */
+  int stat;                                      /* status of operation */
+
+  *p_buffered = false;
+  if ((count == 0) || (count > DA_FILE_BYTES) || ((uint64_t) pos + count > MAX_FILE_SIZE))
+     return soDelAllocFlush (nInode);
+
+  pthread_mutex_lock (&daCR);
+  p_buf = findBuf (nInode);
+
+  /* the data must either overlap the buffer or immediately follow it */
+
+  if ((p_buf != NULL) &&
+      ((pos < p_buf->pos) || (pos > p_buf->pos + p_buf->len) || (pos + count - p_buf->pos > DA_FILE_BYTES)))
+     { pthread_mutex_unlock (&daCR);
+       if ((stat = soDelAllocFlush (nInode)) != 0) return stat;
+       pthread_mutex_lock (&daCR);
+       p_buf = NULL;
+     }
+  if (p_buf == NULL)
+     { i = 0;
+       while ((i < DA_FILES) && daBuf[i].used) i++;
+       if (i == DA_FILES)                        /* the table is full: the data has to be written directly */
+          { pthread_mutex_unlock (&daCR);
+            return 0;
+          }
+       p_buf = &daBuf[i];
+       p_buf->used = true;
+       p_buf->nInode = nInode;
+       p_buf->pos = pos;
+       p_buf->len = 0;
+       p_buf->size = 0;
+       p_buf->data = NULL;
+     }
+
+  /* the storage area grows geometrically, as long as the overall limit is not surpassed */
+
+  need = pos + count - p_buf->pos;
+  if (need > p_buf->size)
+     { size = (2 * p_buf->size > need) ? 2 * p_buf->size : need;
+       if (size > DA_FILE_BYTES) size = DA_FILE_BYTES;
+       if ((daBytes - p_buf->size + size > DA_TOTAL_BYTES) || ((data = realloc (p_buf->data, size)) == NULL))
+          { pthread_mutex_unlock (&daCR);
+            return soDelAllocFlush (nInode);
+          }
+       daBytes += size - p_buf->size;
+       p_buf->data = data;
+       p_buf->size = size;
+     }
+  memcpy (p_buf->data + (pos - p_buf->pos), buff, count);
+  if (need > p_buf->len) p_buf->len = need;
+  *p_buffered = true;
+  pthread_mutex_unlock (&daCR);
+
+  return 0;
+}
+
+/**
+ *  \brief Overlay the buffered data of a file on data that was read from it.
+ *
+ *  The bytes of the buffer of the file that lie within the range which was read replace the ones read from the data
+ *  clusters. If the buffered data extends the range past the end of the data that was read, the gap is filled with
+ *  zeros.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param buff pointer to the buffer where the data read is stored
+ *  \param count number of bytes that were requested
+ *  \param pos starting [byte] position in the file data continuum where data was read from
+ *  \param nRead number of bytes that were effectively read
+ *
+ *  \return <em>number of bytes effectively read</em>, taking into account the buffered data
+ */
+
+uint32_t soDelAllocRead (uint32_t nInode, void *buff, uint32_t count, uint32_t pos, uint32_t nRead)
+{
+  soColorProbe (782, "07;31", "soDelAllocRead (%"PRIu32", %p, %"PRIu32", %"PRIu32", %"PRIu32")\n", nInode, buff,
+                count, pos, nRead);
+
+  SODelAllocBuf *p_buf;                          /* pointer to the buffer of the file */
+  uint32_t first, end;                           /* range of the overlay */
+
+  pthread_mutex_lock (&daCR);
+  if (((p_buf = findBuf (nInode)) != NULL) && (pos < p_buf->pos + p_buf->len) && (pos + count > p_buf->pos))
+     { first = (pos > p_buf->pos) ? pos : p_buf->pos;
+       end = (pos + count < p_buf->pos + p_buf->len) ? pos + count : p_buf->pos + p_buf->len;
+       if (end - pos > nRead)
+          { memset ((unsigned char *) buff + nRead, 0, end - pos - nRead);
+            nRead = end - pos;
+          }
+       memcpy ((unsigned char *) buff + (first - pos), p_buf->data + (first - p_buf->pos), end - first);
+     }
+  pthread_mutex_unlock (&daCR);
+
+  return nRead;
+}
+
+/**
+ *  \brief Get the size of a file, taking into account its buffered data.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param p_size pointer to the location where the size of the file, as stored in its inode, is passed and where its
+ *                size, extended by the buffered data, is to be stored
+ */
+
+void soDelAllocSize (uint32_t nInode, uint32_t *p_size)
+{
+  soColorProbe (783, "07;31", "soDelAllocSize (%"PRIu32", %p)\n", nInode, p_size);
+
+  SODelAllocBuf *p_buf;                          /* pointer to the buffer of the file */
+
+  pthread_mutex_lock (&daCR);
+  if (((p_buf = findBuf (nInode)) != NULL) && (p_buf->pos + p_buf->len > *p_size))
+     *p_size = p_buf->pos + p_buf->len;
+  pthread_mutex_unlock (&daCR);
+}
+
+/**
+ *  \brief Flush the buffer of a file.
+ *
+ *  The data clusters the buffered data goes into are allocated, if they were not yet, the buffered data is written into
+ *  them and the <em>size</em> field of the inode is updated. The buffer is released even if an error occurs.
+ *
+ *  \param nInode number of the inode associated to the file
+ *
+ *  \return <tt>0 (zero)</tt>, on success (or if there is no buffered data)
+ *  \return -<em>other specific error</em> issued by \e soReadFileCluster, \e soWriteFileCluster,
+ *          \e soWriteFileClusters, \e soReadInode or \e soWriteInode
+ */
+
+int soDelAllocFlush (uint32_t nInode)
+{
+  soColorProbe (784, "07;31", "soDelAllocFlush (%"PRIu32")\n", nInode);
+
+  SODelAllocBuf *p_buf;                          /* pointer to the buffer of the file */
+  SODelAllocBuf buf;                             /* detached buffer */
+  int stat;                                      /* status of operation */
+
+  pthread_mutex_lock (&daCR);
+  if ((p_buf = findBuf (nInode)) == NULL)
+     { pthread_mutex_unlock (&daCR);
+       return 0;
+     }
+  buf = *p_buf;
+  p_buf->used = false;
+  pthread_mutex_unlock (&daCR);
+
+  stat = flushBuf (&buf);
+
+  free (buf.data);
+  pthread_mutex_lock (&daCR);
+  daBytes -= buf.size;
+  pthread_mutex_unlock (&daCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Flush the buffers of all files.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -<em>first specific error</em> issued by \e soDelAllocFlush
+ */
+
+int soDelAllocFlushAll (void)
+{
+  soColorProbe (785, "07;31", "soDelAllocFlushAll ()\n");
+
+  uint32_t i;                                    /* element index */
+  uint32_t nInode;                               /* number of the inode associated to the file */
+  int stat, error;                               /* status of operation */
+
+  error = 0;
+  for (i = 0; i < DA_FILES; i++)
+  { pthread_mutex_lock (&daCR);
+    nInode = daBuf[i].used ? daBuf[i].nInode : NULL_INODE;
+    pthread_mutex_unlock (&daCR);
+    if ((nInode != NULL_INODE) && ((stat = soDelAllocFlush (nInode)) != 0) && (error == 0))
+       error = stat;
+  }
+
+  return error;
+}
+
+/**
+ *  \brief Drop the buffered data of a file from a given position onwards.
+ *
+ *  It must be called when the file is truncated (the position is the new size) or removed (the position is zero).
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param pos [byte] position in the file data continuum from which the buffered data is to be dropped
+ */
+
+void soDelAllocDrop (uint32_t nInode, uint32_t pos)
+{
+  soColorProbe (786, "07;31", "soDelAllocDrop (%"PRIu32", %"PRIu32")\n", nInode, pos);
+
+  SODelAllocBuf *p_buf;                          /* pointer to the buffer of the file */
+
+  pthread_mutex_lock (&daCR);
+  if ((p_buf = findBuf (nInode)) != NULL)
+     { if (pos <= p_buf->pos)
+          { free (p_buf->data);
+            daBytes -= p_buf->size;
+            p_buf->used = false;
+          }
+          else if (pos < p_buf->pos + p_buf->len)
+                  p_buf->len = pos - p_buf->pos;
+     }
+  pthread_mutex_unlock (&daCR);
+}
+
+/*
+ *  Internal functions
+ */
+
+/*
+ *  Find the buffer of a file (the caller holds the access lock to the table).
+ */
+
+static SODelAllocBuf *findBuf (uint32_t nInode)
+{
+  uint32_t i;                                    /* element index */
+
+  for (i = 0; i < DA_FILES; i++)
+    if (daBuf[i].used && (daBuf[i].nInode == nInode))
+       return &daBuf[i];
+
+  return NULL;
+}
+
+/*
+ *  Write the buffered data into the data clusters of the file, in ascending order (the whole data clusters as a single
+ *  group), and update the size of the file.
+ */
+
+static int flushBuf (SODelAllocBuf *p_buf)
+{
+  uint32_t done, n;                              /* number of bytes written / to be written into a data cluster */
+  uint32_t clustInd, off;                        /* index of the data cluster and offset within it */
+  SOInode inode;                                 /* inode associated to the file */
+  int stat;                                      /* status of operation */
+
+  if (p_buf->len == 0) return 0;
+
+  for (done = 0; done < p_buf->len; done += n)
+  { clustInd = (p_buf->pos + done) / BSLPC;
+    off = (p_buf->pos + done) % BSLPC;
+    if ((off == 0) && (p_buf->len - done >= BSLPC))     /* whole data clusters are written as a group */
+       { n = (p_buf->len - done) / BSLPC;
+         if ((stat = soWriteFileClusters (p_buf->nInode, clustInd, n, p_buf->data + done)) != 0)
+            return stat;
+         n *= BSLPC;
+         continue;
+       }
+    n = (BSLPC - off < p_buf->len - done) ? BSLPC - off : p_buf->len - done;
+    if ((stat = writePartial (p_buf->nInode, clustInd, off, p_buf->data + done, n)) != 0)
+       return stat;
+  }
+
+  if ((stat = soReadInode (&inode, p_buf->nInode, IUIN)) != 0)
+     return stat;
+  if (p_buf->pos + p_buf->len > inode.size)
+     inode.size = p_buf->pos + p_buf->len;
+
+  return soWriteInode (&inode, p_buf->nInode, IUIN);
+}
+
+/*
+ *  Write part of a data cluster of the file: the data cluster is allocated, if it was not yet, and modified in place in
+ *  the buffercache, where it is pinned meanwhile. The rest of a data cluster just allocated is filled with zeros. If
+ *  the data cluster can not be pinned (the communication channel is unbuffered, for instance), it is read, modified and
+ *  written through a temporary copy. If the contents of the file are stored in the inode, or its data clusters are
+ *  compressed, the data cluster is read, modified and written through the operations of the file clusters, so that
+ *  the contents stay in the inode while they fit and the group of the data cluster is compressed again.
+ */
+
+static int writePartial (uint32_t nInode, uint32_t clustInd, uint32_t off, const unsigned char *data, uint32_t n)
+{
+  unsigned char clust[BSLPC];                    /* contents of the data cluster (unbuffered channel) */
+  unsigned char *p_clust;                        /* pointer to the contents of the data cluster in the buffercache */
+  uint32_t nClust, nBlk;                         /* logical number of the data cluster and number of its first block */
+  bool fresh;                                    /* signals if the data cluster was just allocated */
+  SOInode inode;                                 /* inode associated to the file */
+  int stat;                                      /* status of operation */
+
+  if ((stat = soReadInode (&inode, nInode, IUIN)) != 0)
+     return stat;
+  if (INODE_IS_INLINE (inode.mode) || INODE_IS_COMPRESSED (inode.mode))
+     { if ((stat = soReadFileCluster (nInode, clustInd, clust)) != 0)
+          return stat;
+       memcpy (clust + off, data, n);
+       return soWriteFileCluster (nInode, clustInd, clust);
+     }
+
+  if ((stat = soHandleFileCluster (nInode, clustInd, GET, &nClust)) != 0)
+     return stat;
+  if ((fresh = (nClust == NULL_CLUSTER)) && ((stat = soHandleFileCluster (nInode, clustInd, ALLOC, &nClust)) != 0))
+     return stat;
+  if ((stat = soLoadSuperBlock ()) != 0)
+     return stat;
+  nBlk = soGetSuperBlock ()->dzone_start + nClust * BLOCKS_PER_CLUSTER;
+
+  if ((stat = soPinCacheCluster (nBlk, (void **) &p_clust)) == 0)
+     { if (fresh) memset (p_clust, 0, BSLPC);
+       memcpy (p_clust + off, data, n);
+       if ((stat = soMarkCacheClusterDirty (nBlk)) != 0)
+          { soUnpinCacheCluster (nBlk);
+            return stat;
+          }
+       return soUnpinCacheCluster (nBlk);
+     }
+  if ((stat != -ENOTSUP) && (stat != -EBUSY) && (stat != -ENOBUFS)) return stat;
+
+  if (fresh) memset (clust, 0, BSLPC);
+     else if ((stat = soReadCacheCluster (nBlk, clust)) != 0)
+             return stat;
+  memcpy (clust + off, data, n);
+
+  return soWriteCacheCluster (nBlk, clust);
+}
@@ -0,0 +1,129 @@
+/**
+ *  \file sofs_delalloc.h (interface file)
+ *
+ *  \brief Delayed allocation of the data clusters of regular files.
+ *
+ *  The data written into a regular file is kept in a write buffer of the file, in internal storage, instead of being
+ *  transferred at once to the data clusters of the file. Data clusters are only allocated, and the inode updated, when
+ *  the buffer is flushed, the whole buffered range at once and in ascending order, so that many small appends turn into
+ *  a single contiguous allocation and files that are removed before being flushed never touch the data zone.
+ *
+ *  A write buffer holds a single contiguous range of bytes of the file, which is extended by the writes that overlap it
+ *  or immediately follow it. A write elsewhere, or one which would make the buffer exceed \c DA_FILE_BYTES, or the
+ *  whole set of buffers exceed \c DA_TOTAL_BYTES, flushes the buffer of the file first and, if there is still no room
+ *  for it, has to be carried out directly.
+ *
+ *  Buffers are identified by the number of the inode associated to the file, so they are not affected by renaming or
+ *  linking. The caller must hold the lock of the inode, in exclusion for all the operations but reading and getting
+ *  the size, for which it may be shared.
+ *
+ *  The operations are:
+ *      \li write data into the buffer of a file
+ *      \li overlay the buffered data of a file on data that was read from it
+ *      \li get the size of a file, taking into account its buffered data
+ *      \li flush the buffer of a file
+ *      \li flush the buffers of all files
+ *      \li drop the buffered data of a file from a given position onwards.
+ *
+ *  \remarks In case an error occurs, all functions return a negative value which is the symmetric of the system error
+ *           that better represents the error cause.
+ *           (execute command <em>man errno</em> to get the list of system errors)
+ *           Notice that errors related to the allocation of data clusters, namely -\c ENOSPC, are only reported when the
+ *           buffer is flushed.
+ */
+
+#ifndef SOFS_DELALLOC_H_
+#define SOFS_DELALLOC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/** \brief maximum number of files with buffered data */
+#define DA_FILES  64
+/** \brief maximum size of the write buffer of a file (in bytes) */
+#define DA_FILE_BYTES  (1024 * 1024)
+/** \brief maximum size of the whole set of write buffers (in bytes) */
+#define DA_TOTAL_BYTES  (16 * 1024 * 1024)
+
+/**
+ *  \brief Write data into the buffer of a file.
+ *
+ *  If the data can not be buffered, whatever was buffered for the file is flushed and the caller must write the data
+ *  directly into the file.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param buff pointer to the buffer where data to be written is stored
+ *  \param count number of bytes to be written
+ *  \param pos starting [byte] position in the file data continuum where data is to be written into
+ *  \param p_buffered pointer to the location where the indication of the data having been buffered is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -<em>other specific error</em> issued by \e soDelAllocFlush
+ */
+
+extern int soDelAllocWrite (uint32_t nInode, const void *buff, uint32_t count, uint32_t pos, bool *p_buffered);
+
+/**
+ *  \brief Overlay the buffered data of a file on data that was read from it.
+ *
+ *  The bytes of the buffer of the file that lie within the range which was read replace the ones read from the data
+ *  clusters. If the buffered data extends the range past the end of the data that was read, the gap is filled with
+ *  zeros.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param buff pointer to the buffer where the data read is stored
+ *  \param count number of bytes that were requested
+ *  \param pos starting [byte] position in the file data continuum where data was read from
+ *  \param nRead number of bytes that were effectively read
+ *
+ *  \return <em>number of bytes effectively read</em>, taking into account the buffered data
+ */
+
+extern uint32_t soDelAllocRead (uint32_t nInode, void *buff, uint32_t count, uint32_t pos, uint32_t nRead);
+
+/**
+ *  \brief Get the size of a file, taking into account its buffered data.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param p_size pointer to the location where the size of the file, as stored in its inode, is passed and where its
+ *                size, extended by the buffered data, is to be stored
+ */
+
+extern void soDelAllocSize (uint32_t nInode, uint32_t *p_size);
+
+/**
+ *  \brief Flush the buffer of a file.
+ *
+ *  The data clusters the buffered data goes into are allocated, if they were not yet, the buffered data is written into
+ *  them and the <em>size</em> field of the inode is updated. The buffer is released even if an error occurs.
+ *
+ *  \param nInode number of the inode associated to the file
+ *
+ *  \return <tt>0 (zero)</tt>, on success (or if there is no buffered data)
+ *  \return -<em>other specific error</em> issued by \e soReadFileCluster, \e soWriteFileCluster,
+ *          \e soWriteFileClusters, \e soReadInode or \e soWriteInode
+ */
+
+extern int soDelAllocFlush (uint32_t nInode);
+
+/**
+ *  \brief Flush the buffers of all files.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -<em>first specific error</em> issued by \e soDelAllocFlush
+ */
+
+extern int soDelAllocFlushAll (void);
+
+/**
+ *  \brief Drop the buffered data of a file from a given position onwards.
+ *
+ *  It must be called when the file is truncated (the position is the new size) or removed (the position is zero).
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param pos [byte] position in the file data continuum from which the buffered data is to be dropped
+ */
+
+extern void soDelAllocDrop (uint32_t nInode, uint32_t pos);
+
+#endif /* SOFS_DELALLOC_H_ */
@@ -0,0 +1,193 @@
+/**
+ *  \file sofs_direntcache.c (implementation file)
+ *
+ *  \brief Cache of directory entries for path resolution.
+ *
+ *  The cache maps a pair (directory inode number, entry name) either into the number of the inode associated to the
+ *  entry or into the information that no such entry exists (negative entry).
+ *  It is organized as a hash table of buckets with a fixed number of ways each, managed on a least recently used
+ *  basis, and is accessed in mutual exclusion. The generation numbers of the directories are kept in a separate table,
+ *  indexed by the inode number, so that invalidation takes constant time; directories that share an element of the
+ *  table invalidate each other's entries, which is harmless.
+ *
+ *  The operations are:
+ *      \li look up an entry
+ *      \li insert an entry
+ *      \li invalidate all the entries of a directory.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "sofs_probe.h"
+#include "sofs_inode.h"
+#include "sofs_direntry.h"
+#include "sofs_direntcache.h"
+
+/** \brief number of buckets of the hash table (it must be a power of 2) */
+#define DC_BUCKETS  512
+/** \brief number of ways of each bucket */
+#define DC_WAYS  4
+/** \brief number of elements of the table of generation numbers (it must be a power of 2) */
+#define DC_GENS  1024
+
+/*
+ *  Internal data structure
+ */
+
+/** \brief cached directory entry */
+typedef struct soDirEntCache
+{
+  /** \brief signals if the element holds an entry */
+  bool valid;
+  /** \brief number of the inode associated to the directory */
+  uint32_t nInodeDir;
+  /** \brief generation of the directory when the entry was inserted */
+  uint32_t gen;
+  /** \brief number of the inode associated to the entry (\c NULL_INODE, if the entry does not exist) */
+  uint32_t nInodeEnt;
+  /** \brief time of last use */
+  uint32_t used;
+  /** \brief name of the entry */
+  char name[MAX_NAME+1];
+} SODirEntCache;
+
+/** \brief hash table */
+static SODirEntCache dcache[DC_BUCKETS][DC_WAYS];
+/** \brief generation numbers of the directories */
+static uint32_t dcGen[DC_GENS];
+/** \brief clock for the time of last use */
+static uint32_t dcClock = 0;
+/** \brief access lock to the hash table */
+static pthread_mutex_t dcCR = PTHREAD_MUTEX_INITIALIZER;
+
+/* Allusion to internal functions */
+
+static uint32_t hashEntry (uint32_t nInodeDir, const char *eName);
+
+/**
+ *  \brief Look up an entry.
+ *
+ *  \param nInodeDir number of the inode associated to the directory
+ *  \param eName pointer to the string holding the name of the entry
+ *  \param p_nInodeEnt pointer to the location where the number of the inode associated to the entry is to be stored
+ *  \param p_gen pointer to the location where the current generation of the directory is to be stored (it must be
+ *               passed on to the insertion of the entry, in case of a miss)
+ *
+ *  \return <tt>0 (zero)</tt>, if the entry is cached and exists
+ *  \return -\c ENOENT, if the entry is cached and does not exist
+ *  \return -\c ENODATA, if the entry is not cached
+ */
+
+int soLookupDirEntCache (uint32_t nInodeDir, const char *eName, uint32_t *p_nInodeEnt, uint32_t *p_gen)
+{
+  soColorProbe (751, "07;31", "soLookupDirEntCache (%"PRIu32", \"%s\", %p, %p)\n", nInodeDir, eName, p_nInodeEnt,
+                p_gen);
+
+  SODirEntCache *bucket;                         /* pointer to the bucket */
+  uint32_t gen;                                  /* current generation of the directory */
+  uint32_t w;                                    /* way index */
+  int stat;                                      /* status of operation */
+
+  gen = __atomic_load_n (&dcGen[nInodeDir & (DC_GENS - 1)], __ATOMIC_ACQUIRE);
+  *p_gen = gen;
+  if (strlen (eName) > MAX_NAME) return -ENODATA;
+
+  bucket = dcache[hashEntry (nInodeDir, eName)];
+  stat = -ENODATA;
+  pthread_mutex_lock (&dcCR);
+  for (w = 0; w < DC_WAYS; w++)
+    if (bucket[w].valid && (bucket[w].nInodeDir == nInodeDir) && (strcmp (bucket[w].name, eName) == 0))
+       { if (bucket[w].gen != gen)
+            bucket[w].valid = false;             /* the directory was changed meanwhile */
+            else { bucket[w].used = ++dcClock;
+                   *p_nInodeEnt = bucket[w].nInodeEnt;
+                   stat = (bucket[w].nInodeEnt == NULL_INODE) ? -ENOENT : 0;
+                 }
+         break;
+       }
+  pthread_mutex_unlock (&dcCR);
+
+  return stat;
+}
+
+/**
+ *  \brief Insert an entry.
+ *
+ *  Nothing is done if the generation of the directory changed since the lookup or if the name is too long.
+ *
+ *  \param nInodeDir number of the inode associated to the directory
+ *  \param eName pointer to the string holding the name of the entry
+ *  \param nInodeEnt number of the inode associated to the entry (\c NULL_INODE, if the entry does not exist)
+ *  \param gen generation of the directory returned by the lookup
+ */
+
+void soInsertDirEntCache (uint32_t nInodeDir, const char *eName, uint32_t nInodeEnt, uint32_t gen)
+{
+  soColorProbe (752, "07;31", "soInsertDirEntCache (%"PRIu32", \"%s\", %"PRIu32", %"PRIu32")\n", nInodeDir, eName,
+                nInodeEnt, gen);
+
+  SODirEntCache *bucket;                         /* pointer to the bucket */
+  uint32_t w, v;                                 /* way indexes */
+
+  if (strlen (eName) > MAX_NAME) return;
+
+  bucket = dcache[hashEntry (nInodeDir, eName)];
+  pthread_mutex_lock (&dcCR);
+  if (__atomic_load_n (&dcGen[nInodeDir & (DC_GENS - 1)], __ATOMIC_ACQUIRE) != gen)
+     { pthread_mutex_unlock (&dcCR);
+       return;
+     }
+  for (w = 0, v = 0; w < DC_WAYS; w++)
+  { if (bucket[w].valid && (bucket[w].nInodeDir == nInodeDir) && (strcmp (bucket[w].name, eName) == 0))
+       { v = w;
+         break;
+       }
+    if (!bucket[w].valid || (bucket[v].valid && (bucket[w].used < bucket[v].used))) v = w;
+  }
+  bucket[v].valid = true;
+  bucket[v].nInodeDir = nInodeDir;
+  bucket[v].gen = gen;
+  bucket[v].nInodeEnt = nInodeEnt;
+  bucket[v].used = ++dcClock;
+  strcpy (bucket[v].name, eName);
+  pthread_mutex_unlock (&dcCR);
+}
+
+/**
+ *  \brief Invalidate all the entries of a directory.
+ *
+ *  \param nInodeDir number of the inode associated to the directory
+ */
+
+void soInvalidateDirEntCache (uint32_t nInodeDir)
+{
+  soColorProbe (753, "07;31", "soInvalidateDirEntCache (%"PRIu32")\n", nInodeDir);
+
+  __atomic_add_fetch (&dcGen[nInodeDir & (DC_GENS - 1)], 1, __ATOMIC_RELEASE);
+}
+
+/*
+ *  Internal functions
+ */
+
+/*
+ *  Bucket of the hash table of an entry (FNV-1a hash of the directory inode number and the name).
+ */
+
+static uint32_t hashEntry (uint32_t nInodeDir, const char *eName)
+{
+  uint32_t h = 2166136261u;                      /* hash value */
+  uint32_t i;                                    /* counting variable */
+
+  for (i = 0; i < sizeof (uint32_t); i++)
+    h = (h ^ ((nInodeDir >> (8 * i)) & 0xFF)) * 16777619u;
+  for (; *eName != '\0'; eName++)
+    h = (h ^ (unsigned char) *eName) * 16777619u;
+
+  return h & (DC_BUCKETS - 1);
+}
@@ -0,0 +1,67 @@
+/**
+ *  \file sofs_direntcache.h (interface file)
+ *
+ *  \brief Cache of directory entries for path resolution.
+ *
+ *  The cache maps a pair (directory inode number, entry name) either into the number of the inode associated to the
+ *  entry or into the information that no such entry exists (negative entry), so that the resolution of a path does
+ *  not need to parse the contents of every directory along it.
+ *
+ *  Each directory is assigned a generation number, which is incremented whenever its contents is changed: all the
+ *  entries which were cached under a previous generation of the directory are thus invalidated at once. An entry is
+ *  only inserted if the generation of the directory has not changed since the lookup that missed it, so that the
+ *  result of parsing contents which was changed in the meanwhile is never cached.
+ *
+ *  The operations are:
+ *      \li look up an entry
+ *      \li insert an entry
+ *      \li invalidate all the entries of a directory.
+ *
+ *  \remarks In case an error occurs, all functions return a negative value which is the symmetric of the system error
+ *           that better represents the error cause.
+ *           (execute command <em>man errno</em> to get the list of system errors)
+ */
+
+#ifndef SOFS_DIRENTCACHE_H_
+#define SOFS_DIRENTCACHE_H_
+
+#include <stdint.h>
+
+/**
+ *  \brief Look up an entry.
+ *
+ *  \param nInodeDir number of the inode associated to the directory
+ *  \param eName pointer to the string holding the name of the entry
+ *  \param p_nInodeEnt pointer to the location where the number of the inode associated to the entry is to be stored
+ *  \param p_gen pointer to the location where the current generation of the directory is to be stored (it must be
+ *               passed on to the insertion of the entry, in case of a miss)
+ *
+ *  \return <tt>0 (zero)</tt>, if the entry is cached and exists
+ *  \return -\c ENOENT, if the entry is cached and does not exist
+ *  \return -\c ENODATA, if the entry is not cached
+ */
+
+extern int soLookupDirEntCache (uint32_t nInodeDir, const char *eName, uint32_t *p_nInodeEnt, uint32_t *p_gen);
+
+/**
+ *  \brief Insert an entry.
+ *
+ *  Nothing is done if the generation of the directory changed since the lookup or if the name is too long.
+ *
+ *  \param nInodeDir number of the inode associated to the directory
+ *  \param eName pointer to the string holding the name of the entry
+ *  \param nInodeEnt number of the inode associated to the entry (\c NULL_INODE, if the entry does not exist)
+ *  \param gen generation of the directory returned by the lookup
+ */
+
+extern void soInsertDirEntCache (uint32_t nInodeDir, const char *eName, uint32_t nInodeEnt, uint32_t gen);
+
+/**
+ *  \brief Invalidate all the entries of a directory.
+ *
+ *  \param nInodeDir number of the inode associated to the directory
+ */
+
+extern void soInvalidateDirEntCache (uint32_t nInodeDir);
+
+#endif /* SOFS_DIRENTCACHE_H_ */
@@ -0,0 +1,387 @@
+/**
+ *  \file sofs_dirindex.c (implementation file)
+ *
+ *  \brief Hashed index of the entries of large directories.
+ *
+ *  A fixed number of directories is indexed at a time, managed on a least recently used basis. The index of a
+ *  directory holds, for each of its entries, the hash of the name and the state (free, in use or removed, but still
+ *  recoverable), the entries in use being chained in a hash table. A count of the free entries of each data cluster
+ *  allows the first free entry to be found without parsing the directory. The indexes are accessed in mutual exclusion.
+ *
+ *  The operations are:
+ *      \li look up an entry by name in a directory
+ *      \li reindex a data cluster of a directory that was written
+ *      \li drop the index of a directory.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "sofs_probe.h"
+#include "sofs_inode.h"
+#include "sofs_direntry.h"
+#include "sofs_datacluster.h"
+#include "sofs_ifuncs_3.h"
+#include "sofs_dirindex.h"
+
+/** \brief number of directories indexed at a time */
+#define DIRX_SLOTS  8
+
+/** \brief state of an entry: free */
+#define DE_FREE     0
+/** \brief state of an entry: in use */
+#define DE_USED     1
+/** \brief state of an entry: removed, but still recoverable */
+#define DE_REMOVED  2
+
+/** \brief end of a chain of the hash table */
+#define DE_NONE  (-1)
+
+/*
+ *  Internal data structure
+ */
+
+/** \brief index of a directory */
+typedef struct soDirIndex
+{
+  /** \brief signals if the index is in use */
+  bool valid;
+  /** \brief number of the inode associated to the directory */
+  uint32_t nInodeDir;
+  /** \brief number of data clusters of the directory */
+  uint32_t nClusters;
+  /** \brief number of data clusters the arrays have room for */
+  uint32_t capacity;
+  /** \brief time of last use */
+  uint32_t used;
+  /** \brief number of chains of the hash table (a power of 2) */
+  uint32_t nChains;
+  /** \brief heads of the chains of the hash table */
+  int32_t *head;
+  /** \brief next entry in the chain, for each entry */
+  int32_t *next;
+  /** \brief hash of the name, for each entry */
+  uint32_t *hash;
+  /** \brief state, for each entry */
+  unsigned char *state;
+  /** \brief number of free entries, for each data cluster */
+  uint32_t *nFree;
+} SODirIndex;
+
+/** \brief indexes of the directories */
+static SODirIndex dirx[DIRX_SLOTS];
+/** \brief clock for the time of last use */
+static uint32_t dirxClock = 0;
+/** \brief access lock to the indexes */
+static pthread_mutex_t dirxCR = PTHREAD_MUTEX_INITIALIZER;
+
+/* Allusion to internal functions */
+
+static SODirIndex *findIndex (uint32_t nInodeDir);
+static void freeIndex (SODirIndex *p_dx);
+static int buildIndex (SODirIndex *p_dx, uint32_t nInodeDir, uint32_t nClusters);
+static int growIndex (SODirIndex *p_dx, uint32_t nClusters);
+static void indexCluster (SODirIndex *p_dx, uint32_t clustInd, const SODirEntry *de);
+static void unchain (SODirIndex *p_dx, int32_t e);
+static uint32_t hashName (const char *eName);
+
+/**
+ *  \brief Look up an entry by name in a directory.
+ *
+ *  The directory is supposed to be in use, to be of the directory type and to have been checked for consistency.
+ *
+ *  \param nInodeDir number of the inode associated to the directory
+ *  \param nClusters number of data clusters of the directory
+ *  \param eName pointer to the string holding the name of the entry
+ *  \param p_nInodeEnt pointer to the location where the number of the inode associated to the entry is to be stored
+ *  \param p_idx pointer to the location where the index of the entry is to be stored, if it is found, or the index of
+ *               the first free entry, if it is not
+ *
+ *  \return <tt>0 (zero)</tt>, if the entry is found
+ *  \return -\c ENOENT, if the entry is not found
+ *  \return -\c ENODATA, if the directory can not be indexed (it must be parsed instead)
+ *  \return -<em>other specific error</em> issued by \e soReadFileCluster while the index is built or the entry read
+ */
+
+int soDirIndexLookup (uint32_t nInodeDir, uint32_t nClusters, const char *eName, uint32_t *p_nInodeEnt,
+                      uint32_t *p_idx)
+{
+  soColorProbe (761, "07;31", "soDirIndexLookup (%"PRIu32", %"PRIu32", \"%s\", %p, %p)\n", nInodeDir, nClusters,
+                eName, p_nInodeEnt, p_idx);
+
+  SODirIndex *p_dx;                              /* pointer to the index of the directory */
+  SODataClust clust;                             /* data cluster of the directory */
+  uint32_t h, c, nClust;                         /* hash of the name and cluster indexes */
+  int32_t e;                                     /* entry index */
+  uint32_t i, v;                                 /* index slots */
+  int stat;                                      /* status of operation */
+
+  if (nClusters < DIRX_MIN_CLUSTERS) return -ENODATA;
+
+  pthread_mutex_lock (&dirxCR);
+  if (((p_dx = findIndex (nInodeDir)) == NULL) || (p_dx->nClusters != nClusters))
+     { if (p_dx == NULL)                         /* reassign the index least recently used */
+          { for (i = 0, v = 0; i < DIRX_SLOTS; i++)
+              if (!dirx[i].valid || (dirx[v].valid && (dirx[i].used < dirx[v].used))) v = i;
+            p_dx = &dirx[v];
+          }
+       freeIndex (p_dx);
+       if ((stat = buildIndex (p_dx, nInodeDir, nClusters)) != 0)
+          { freeIndex (p_dx);
+            pthread_mutex_unlock (&dirxCR);
+            return stat;
+          }
+     }
+  p_dx->used = ++dirxClock;
+
+  /* go through the chain of the name: only the data clusters with candidate entries are read */
+
+  h = hashName (eName);
+  nClust = NULL_CLUSTER;
+  for (e = p_dx->head[h & (p_dx->nChains - 1)]; e != DE_NONE; e = p_dx->next[e])
+  { if (p_dx->hash[e] != h) continue;
+    c = (uint32_t) e / DPC;
+    if ((c != nClust) && ((stat = soReadFileCluster (nInodeDir, c, &clust)) != 0))
+       { freeIndex (p_dx);
+         pthread_mutex_unlock (&dirxCR);
+         return stat;
+       }
+    nClust = c;
+    if (strcmp ((const char *) clust.de[e % DPC].name, eName) == 0)
+       { *p_nInodeEnt = clust.de[e % DPC].nInode;
+         *p_idx = (uint32_t) e;
+         pthread_mutex_unlock (&dirxCR);
+         return 0;
+       }
+  }
+
+  /* the entry was not found: locate the first free entry */
+
+  c = 0;
+  while ((c < p_dx->nClusters) && (p_dx->nFree[c] == 0)) c += 1;
+  if (c == p_dx->nClusters)
+     *p_idx = c * DPC;                           /* the directory must grow */
+     else { e = (int32_t) (c * DPC);
+            while (p_dx->state[e] != DE_FREE) e += 1;
+            *p_idx = (uint32_t) e;
+          }
+  pthread_mutex_unlock (&dirxCR);
+
+  return -ENOENT;
+}
+
+/**
+ *  \brief Reindex a data cluster of a directory that was written.
+ *
+ *  Nothing is done if the directory is not indexed.
+ *
+ *  \param nInodeDir number of the inode associated to the directory
+ *  \param clustInd index of the data cluster in the list of references of the directory
+ *  \param de pointer to the array of directory entries the data cluster holds
+ */
+
+void soDirIndexUpdate (uint32_t nInodeDir, uint32_t clustInd, const SODirEntry *de)
+{
+  soColorProbe (762, "07;31", "soDirIndexUpdate (%"PRIu32", %"PRIu32", %p)\n", nInodeDir, clustInd, de);
+
+  SODirIndex *p_dx;                              /* pointer to the index of the directory */
+
+  pthread_mutex_lock (&dirxCR);
+  if ((p_dx = findIndex (nInodeDir)) != NULL)
+     { if (clustInd < p_dx->nClusters)
+          indexCluster (p_dx, clustInd, de);
+          else if ((clustInd == p_dx->nClusters) && (growIndex (p_dx, clustInd + 1) == 0))
+                  { p_dx->nClusters += 1;
+                    indexCluster (p_dx, clustInd, de);
+                  }
+                  else freeIndex (p_dx);         /* the directory grew with holes or there is no memory */
+     }
+  pthread_mutex_unlock (&dirxCR);
+}
+
+/**
+ *  \brief Drop the index of a directory.
+ *
+ *  \param nInodeDir number of the inode associated to the directory
+ */
+
+void soDirIndexDrop (uint32_t nInodeDir)
+{
+  soColorProbe (763, "07;31", "soDirIndexDrop (%"PRIu32")\n", nInodeDir);
+
+  SODirIndex *p_dx;                              /* pointer to the index of the directory */
+
+  pthread_mutex_lock (&dirxCR);
+  if ((p_dx = findIndex (nInodeDir)) != NULL) freeIndex (p_dx);
+  pthread_mutex_unlock (&dirxCR);
+}
+
+/*
+ *  Internal functions
+ */
+
+/*
+ *  Index of a directory, or NULL, if it is not indexed (the caller holds the access lock).
+ */
+
+static SODirIndex *findIndex (uint32_t nInodeDir)
+{
+  uint32_t i;                                    /* index slot */
+
+  for (i = 0; i < DIRX_SLOTS; i++)
+    if (dirx[i].valid && (dirx[i].nInodeDir == nInodeDir)) return &dirx[i];
+
+  return NULL;
+}
+
+/*
+ *  Release the storage of an index (the caller holds the access lock).
+ */
+
+static void freeIndex (SODirIndex *p_dx)
+{
+  free (p_dx->head);
+  free (p_dx->next);
+  free (p_dx->hash);
+  free (p_dx->state);
+  free (p_dx->nFree);
+  memset (p_dx, 0, sizeof (SODirIndex));
+}
+
+/*
+ *  Build the index of a directory by parsing its contents (the caller holds the access lock).
+ */
+
+static int buildIndex (SODirIndex *p_dx, uint32_t nInodeDir, uint32_t nClusters)
+{
+  SODataClust clust;                             /* data cluster of the directory */
+  uint32_t c;                                    /* cluster index */
+  int stat;                                      /* status of operation */
+
+  if (growIndex (p_dx, nClusters) != 0) return -ENODATA;
+  for (c = 0; c < nClusters; c++)
+  { if ((stat = soReadFileCluster (nInodeDir, c, &clust)) != 0) return stat;
+    p_dx->nClusters = c + 1;
+    indexCluster (p_dx, c, clust.de);
+  }
+  p_dx->nInodeDir = nInodeDir;
+  p_dx->valid = true;
+
+  return 0;
+}
+
+/*
+ *  Make room in an index for a given number of data clusters, doubling the capacity and rehashing the entries, if
+ *  necessary (the caller holds the access lock).
+ */
+
+static int growIndex (SODirIndex *p_dx, uint32_t nClusters)
+{
+  uint32_t capacity, nChains;                    /* new dimensions */
+  int32_t *head, *next;                          /* new chains */
+  uint32_t *hash, *nFree;                        /* new arrays of hashes and free entry counts */
+  unsigned char *state;                          /* new array of states */
+  uint32_t e;                                    /* entry index */
+
+  if (nClusters <= p_dx->capacity) return 0;
+
+  capacity = (p_dx->capacity == 0) ? DIRX_MIN_CLUSTERS : p_dx->capacity;
+  while (capacity < nClusters) capacity *= 2;
+  nChains = 1;
+  while (nChains < 2 * capacity * DPC) nChains *= 2;
+  head = malloc (nChains * sizeof (int32_t));
+  next = realloc (p_dx->next, capacity * DPC * sizeof (int32_t));
+  if (next != NULL) p_dx->next = next;
+  hash = realloc (p_dx->hash, capacity * DPC * sizeof (uint32_t));
+  if (hash != NULL) p_dx->hash = hash;
+  state = realloc (p_dx->state, capacity * DPC);
+  if (state != NULL)
+     { memset (state + p_dx->capacity * DPC, DE_FREE, (capacity - p_dx->capacity) * DPC);
+       p_dx->state = state;
+     }
+  nFree = realloc (p_dx->nFree, capacity * sizeof (uint32_t));
+  if (nFree != NULL) p_dx->nFree = nFree;
+  if ((head == NULL) || (next == NULL) || (hash == NULL) || (state == NULL) || (nFree == NULL))
+     { free (head);
+       return -ENOMEM;
+     }
+
+  /* rehash the entries in use */
+
+  free (p_dx->head);
+  p_dx->head = head;
+  p_dx->nChains = nChains;
+  p_dx->capacity = capacity;
+  for (e = 0; e < nChains; e++)
+    head[e] = DE_NONE;
+  for (e = 0; e < p_dx->nClusters * DPC; e++)
+    if (state[e] == DE_USED)
+       { next[e] = head[hash[e] & (nChains - 1)];
+         head[hash[e] & (nChains - 1)] = (int32_t) e;
+       }
+
+  return 0;
+}
+
+/*
+ *  Index the entries of a data cluster, replacing the ones previously indexed, if any (the caller holds the access
+ *  lock and the cluster is within the size of the index).
+ */
+
+static void indexCluster (SODirIndex *p_dx, uint32_t clustInd, const SODirEntry *de)
+{
+  uint32_t i, h;                                 /* entry offset and hash of the name */
+  int32_t e;                                     /* entry index */
+
+  p_dx->nFree[clustInd] = 0;
+  for (i = 0; i < DPC; i++)
+  { e = (int32_t) (clustInd * DPC + i);
+    if (p_dx->state[e] == DE_USED) unchain (p_dx, e);
+    if ((de[i].name[0] == '\0') && (de[i].name[1] == '\0'))
+       { p_dx->state[e] = DE_FREE;
+         p_dx->nFree[clustInd] += 1;
+       }
+       else if (de[i].name[0] == '\0')
+               p_dx->state[e] = DE_REMOVED;
+               else { h = hashName ((const char *) de[i].name);
+                      p_dx->state[e] = DE_USED;
+                      p_dx->hash[e] = h;
+                      p_dx->next[e] = p_dx->head[h & (p_dx->nChains - 1)];
+                      p_dx->head[h & (p_dx->nChains - 1)] = e;
+                    }
+  }
+}
+
+/*
+ *  Remove an entry from its chain (the caller holds the access lock).
+ */
+
+static void unchain (SODirIndex *p_dx, int32_t e)
+{
+  int32_t *p_e;                                  /* pointer to the link to the entry */
+
+  for (p_e = &p_dx->head[p_dx->hash[e] & (p_dx->nChains - 1)]; *p_e != DE_NONE; p_e = &p_dx->next[*p_e])
+    if (*p_e == e)
+       { *p_e = p_dx->next[e];
+         break;
+       }
+}
+
+/*
+ *  Hash of a name (FNV-1a).
+ */
+
+static uint32_t hashName (const char *eName)
+{
+  uint32_t h = 2166136261u;                      /* hash value */
+
+  for (; *eName != '\0'; eName++)
+    h = (h ^ (unsigned char) *eName) * 16777619u;
+
+  return h;
+}
@@ -0,0 +1,75 @@
+/**
+ *  \file sofs_dirindex.h (interface file)
+ *
+ *  \brief Hashed index of the entries of large directories.
+ *
+ *  Directories whose contents spans at least \c DIRX_MIN_CLUSTERS data clusters are indexed in internal storage by the
+ *  hash of the name of their entries, so that locating an entry by name requires reading a single data cluster, on
+ *  average, instead of parsing the whole directory. The index also keeps track of the free entries of the directory.
+ *
+ *  The index of a directory is built on its first lookup, by parsing the whole directory once, and is kept up to date
+ *  afterwards by reindexing every data cluster of the directory that is written. It is dropped when the directory is
+ *  removed and rebuilt whenever its size does not match the size of the directory.
+ *
+ *  The operations are:
+ *      \li look up an entry by name in a directory
+ *      \li reindex a data cluster of a directory that was written
+ *      \li drop the index of a directory.
+ *
+ *  \remarks In case an error occurs, all functions return a negative value which is the symmetric of the system error
+ *           that better represents the error cause.
+ *           (execute command <em>man errno</em> to get the list of system errors)
+ */
+
+#ifndef SOFS_DIRINDEX_H_
+#define SOFS_DIRINDEX_H_
+
+#include <stdint.h>
+
+#include "sofs_direntry.h"
+
+/** \brief minimum number of data clusters of a directory for it to be indexed */
+#define DIRX_MIN_CLUSTERS  4
+
+/**
+ *  \brief Look up an entry by name in a directory.
+ *
+ *  The directory is supposed to be in use, to be of the directory type and to have been checked for consistency.
+ *
+ *  \param nInodeDir number of the inode associated to the directory
+ *  \param nClusters number of data clusters of the directory
+ *  \param eName pointer to the string holding the name of the entry
+ *  \param p_nInodeEnt pointer to the location where the number of the inode associated to the entry is to be stored
+ *  \param p_idx pointer to the location where the index of the entry is to be stored, if it is found, or the index of
+ *               the first free entry, if it is not
+ *
+ *  \return <tt>0 (zero)</tt>, if the entry is found
+ *  \return -\c ENOENT, if the entry is not found
+ *  \return -\c ENODATA, if the directory can not be indexed (it must be parsed instead)
+ *  \return -<em>other specific error</em> issued by \e soReadFileCluster while the index is built or the entry read
+ */
+
+extern int soDirIndexLookup (uint32_t nInodeDir, uint32_t nClusters, const char *eName, uint32_t *p_nInodeEnt,
+                             uint32_t *p_idx);
+
+/**
+ *  \brief Reindex a data cluster of a directory that was written.
+ *
+ *  Nothing is done if the directory is not indexed.
+ *
+ *  \param nInodeDir number of the inode associated to the directory
+ *  \param clustInd index of the data cluster in the list of references of the directory
+ *  \param de pointer to the array of directory entries the data cluster holds
+ */
+
+extern void soDirIndexUpdate (uint32_t nInodeDir, uint32_t clustInd, const SODirEntry *de);
+
+/**
+ *  \brief Drop the index of a directory.
+ *
+ *  \param nInodeDir number of the inode associated to the directory
+ */
+
+extern void soDirIndexDrop (uint32_t nInodeDir);
+
+#endif /* SOFS_DIRINDEX_H_ */
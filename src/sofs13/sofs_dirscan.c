@@ -0,0 +1,196 @@
+/**
+ *  \file sofs_dirscan.c (implementation file)
+ *
+ *  \brief Scanning of the directory entries of a data cluster.
+ *
+ *  There are three implementations of the scan: a plain one, one which uses SSE2 instructions and one which uses AVX2
+ *  instructions. The vector ones load the first 16 or 32 characters of the name of an entry at a time: the masks of
+ *  the NUL characters tell whether the entry is in use or free and the mask of the characters equal to the given name,
+ *  restricted to the characters up to its terminating NUL, whether the entry is a candidate to match. A candidate is
+ *  only compared in full if the given name is longer than the vector.
+ *  The vector implementations are compiled for their instruction set through function attributes and are only called
+ *  if the processor supports it, so that no special compiler flags are required.
+ *
+ *  The operations are:
+ *      \li scan a group of directory entries of a data cluster.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "sofs_probe.h"
+#include "sofs_direntry.h"
+#include "sofs_datacluster.h"
+#include "sofs_dirscan.h"
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#define DIRSCAN_X86
+#include <immintrin.h>
+#endif
+
+/* the directory entries of a group must fit in a 32 bit mask and the ones of a data cluster form whole groups */
+
+_Static_assert ((DIRSCAN_ENTS <= 32) && ((DPC % DIRSCAN_ENTS) == 0), "bad number of directory entries of a group");
+
+/*
+ *  Internal data structure
+ */
+
+/** \brief type of an implementation of the scan */
+typedef void (*SOScanFunc) (const SODirEntry *de, const char *eName, size_t len, uint32_t *p_match,
+                            uint32_t *p_free, uint32_t *p_used);
+
+/** \brief implementation of the scan in use (chosen on the first call) */
+static SOScanFunc scanFunc = NULL;
+
+/* Allusion to internal functions */
+
+static void scanPlain (const SODirEntry *de, const char *eName, size_t len, uint32_t *p_match, uint32_t *p_free,
+                       uint32_t *p_used);
+#ifdef DIRSCAN_X86
+static void scanSSE2 (const SODirEntry *de, const char *eName, size_t len, uint32_t *p_match, uint32_t *p_free,
+                      uint32_t *p_used);
+static void scanAVX2 (const SODirEntry *de, const char *eName, size_t len, uint32_t *p_match, uint32_t *p_free,
+                      uint32_t *p_used);
+#endif
+
+/**
+ *  \brief Scan a group of directory entries of a data cluster.
+ *
+ *  \param de pointer to the first of the \c DIRSCAN_ENTS directory entries of the group
+ *  \param eName pointer to the string holding the name to be matched against (no entry matches if \c NULL)
+ *  \param p_match pointer to the location where the mask of the entries whose name is <tt>eName</tt> is to be stored
+ *                 (nothing is stored if \c NULL)
+ *  \param p_free pointer to the location where the mask of the free entries is to be stored
+ *                (nothing is stored if \c NULL)
+ *  \param p_used pointer to the location where the mask of the entries in use is to be stored
+ *                (nothing is stored if \c NULL)
+ */
+
+void soScanDirCluster (const SODirEntry *de, const char *eName, uint32_t *p_match, uint32_t *p_free,
+                       uint32_t *p_used)
+{
+  soColorProbe (771, "07;31", "soScanDirCluster (%p, \"%s\", %p, %p, %p)\n", de, (eName == NULL) ? "" : eName,
+                p_match, p_free, p_used);
+
+  uint32_t match, freeEnt, used;                 /* masks of entries */
+  SOScanFunc func;                               /* implementation of the scan */
+
+  if ((func = __atomic_load_n (&scanFunc, __ATOMIC_RELAXED)) == NULL)
+     { func = scanPlain;
+#ifdef DIRSCAN_X86
+       __builtin_cpu_init ();
+       if (__builtin_cpu_supports ("avx2"))
+          func = scanAVX2;
+          else if (__builtin_cpu_supports ("sse2"))
+                  func = scanSSE2;
+#endif
+       __atomic_store_n (&scanFunc, func, __ATOMIC_RELAXED);
+     }
+
+  func (de, eName, (eName == NULL) ? 0 : strlen (eName), &match, &freeEnt, &used);
+  if (p_match != NULL) *p_match = match;
+  if (p_free != NULL) *p_free = freeEnt;
+  if (p_used != NULL) *p_used = used;
+}
+
+/*
+ *  Internal functions
+ */
+
+/*
+ *  Plain implementation of the scan.
+ */
+
+static void scanPlain (const SODirEntry *de, const char *eName, size_t len, uint32_t *p_match, uint32_t *p_free,
+                       uint32_t *p_used)
+{
+  uint32_t i;                                    /* entry index */
+
+  (void) len;
+  *p_match = *p_free = *p_used = 0;
+  for (i = 0; i < DIRSCAN_ENTS; i++)
+    if (de[i].name[0] != '\0')
+       { *p_used |= 1u << i;
+         if ((eName != NULL) && (strcmp ((const char *) de[i].name, eName) == 0)) *p_match |= 1u << i;
+       }
+       else if (de[i].name[1] == '\0') *p_free |= 1u << i;
+}
+
+#ifdef DIRSCAN_X86
+
+/*
+ *  Implementation of the scan with SSE2 instructions: the first 16 characters of the names are compared at once.
+ */
+
+__attribute__ ((target ("sse2")))
+static void scanSSE2 (const SODirEntry *de, const char *eName, size_t len, uint32_t *p_match, uint32_t *p_free,
+                      uint32_t *p_used)
+{
+  unsigned char prefix[16];                      /* first characters of the name, padded with NUL characters */
+  uint32_t relevant;                             /* mask of the characters that are compared */
+  uint32_t nul, eq;                              /* masks of NUL characters and of characters equal to the name */
+  __m128i zero, name, v;                         /* vectors */
+  uint32_t i;                                    /* entry index */
+
+  memset (prefix, 0, sizeof (prefix));
+  if (eName != NULL) memcpy (prefix, eName, (len < sizeof (prefix)) ? len : sizeof (prefix));
+  relevant = (len + 1 < sizeof (prefix)) ? (1u << (len + 1)) - 1 : 0xFFFF;
+  zero = _mm_setzero_si128 ();
+  name = _mm_loadu_si128 ((const __m128i *) prefix);
+
+  *p_match = *p_free = *p_used = 0;
+  for (i = 0; i < DIRSCAN_ENTS; i++)
+  { v = _mm_loadu_si128 ((const __m128i *) de[i].name);
+    nul = (uint32_t) _mm_movemask_epi8 (_mm_cmpeq_epi8 (v, zero));
+    if ((nul & 1) == 0)
+       { *p_used |= 1u << i;
+         if (eName == NULL) continue;
+         eq = (uint32_t) _mm_movemask_epi8 (_mm_cmpeq_epi8 (v, name));
+         if (((eq & relevant) == relevant) &&
+             ((len + 1 <= sizeof (prefix)) || (strcmp ((const char *) de[i].name, eName) == 0)))
+            *p_match |= 1u << i;
+       }
+       else if (nul & 2) *p_free |= 1u << i;
+  }
+}
+
+/*
+ *  Implementation of the scan with AVX2 instructions: the first 32 characters of the names are compared at once.
+ */
+
+__attribute__ ((target ("avx2")))
+static void scanAVX2 (const SODirEntry *de, const char *eName, size_t len, uint32_t *p_match, uint32_t *p_free,
+                      uint32_t *p_used)
+{
+  unsigned char prefix[32];                      /* first characters of the name, padded with NUL characters */
+  uint32_t relevant;                             /* mask of the characters that are compared */
+  uint32_t nul, eq;                              /* masks of NUL characters and of characters equal to the name */
+  __m256i zero, name, v;                         /* vectors */
+  uint32_t i;                                    /* entry index */
+
+  memset (prefix, 0, sizeof (prefix));
+  if (eName != NULL) memcpy (prefix, eName, (len < sizeof (prefix)) ? len : sizeof (prefix));
+  relevant = (len + 1 < sizeof (prefix)) ? (1u << (len + 1)) - 1 : 0xFFFFFFFFu;
+  zero = _mm256_setzero_si256 ();
+  name = _mm256_loadu_si256 ((const __m256i *) prefix);
+
+  *p_match = *p_free = *p_used = 0;
+  for (i = 0; i < DIRSCAN_ENTS; i++)
+  { v = _mm256_loadu_si256 ((const __m256i *) de[i].name);
+    nul = (uint32_t) _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (v, zero));
+    if ((nul & 1) == 0)
+       { *p_used |= 1u << i;
+         if (eName == NULL) continue;
+         eq = (uint32_t) _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (v, name));
+         if (((eq & relevant) == relevant) &&
+             ((len + 1 <= sizeof (prefix)) || (strcmp ((const char *) de[i].name, eName) == 0)))
+            *p_match |= 1u << i;
+       }
+       else if (nul & 2) *p_free |= 1u << i;
+  }
+}
+
+#endif /* DIRSCAN_X86 */
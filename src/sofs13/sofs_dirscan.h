@@ -0,0 +1,49 @@
+/**
+ *  \file sofs_dirscan.h (interface file)
+ *
+ *  \brief Scanning of the directory entries of a data cluster.
+ *
+ *  All the directory entries of a data cluster, or of a group of \c DIRSCAN_ENTS of them, when the data cluster holds
+ *  more, are classified in a single pass, the entries being represented by the bits of a mask (bit \e i stands for
+ *  entry \e i of the group). An entry is
+ *      \li <em>in use</em>, if the first character of its name is not NUL
+ *      \li <em>free</em>, if the first two characters of its name are NUL (it was never used, nor is it recoverable)
+ *      \li <em>matching</em>, if it is in use and its name is equal to a given name.
+ *
+ *  Where the processor supports it, the first 16 (SSE2) or 32 (AVX2) characters of the name of every entry are
+ *  compared at once against the given name, only the entries that pass the comparison being compared in full; the
+ *  choice of the implementation is made at run time.
+ *
+ *  The operations are:
+ *      \li scan a group of directory entries of a data cluster.
+ */
+
+#ifndef SOFS_DIRSCAN_H_
+#define SOFS_DIRSCAN_H_
+
+#include <stdint.h>
+
+#include "sofs_direntry.h"
+#include "sofs_datacluster.h"
+
+/** \brief number of directory entries of a group, which are scanned at a time (all the entries of a data cluster,
+ *         unless it holds more than 32) */
+#define DIRSCAN_ENTS ((DPC < 32) ? DPC : 32)
+
+/**
+ *  \brief Scan a group of directory entries of a data cluster.
+ *
+ *  \param de pointer to the first of the \c DIRSCAN_ENTS directory entries of the group
+ *  \param eName pointer to the string holding the name to be matched against (no entry matches if \c NULL)
+ *  \param p_match pointer to the location where the mask of the entries whose name is <tt>eName</tt> is to be stored
+ *                 (nothing is stored if \c NULL)
+ *  \param p_free pointer to the location where the mask of the free entries is to be stored
+ *                (nothing is stored if \c NULL)
+ *  \param p_used pointer to the location where the mask of the entries in use is to be stored
+ *                (nothing is stored if \c NULL)
+ */
+
+extern void soScanDirCluster (const SODirEntry *de, const char *eName, uint32_t *p_match, uint32_t *p_free,
+                              uint32_t *p_used);
+
+#endif /* SOFS_DIRSCAN_H_ */
@@ -0,0 +1,93 @@
+/**
+ *  \file sofs_discard.c (implementation file)
+ *
+ *  \brief Discard of the free data clusters on the storage device.
+ *
+ *  Each run of successive clusters of a batch is discarded through the buffercache, which drops its copies of them
+ *  and passes the request on to the storage device.
+ *
+ *  The operations are:
+ *      \li enable or disable the discard of the data clusters freed from now on
+ *      \li discard a batch of data clusters just freed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <errno.h>
+
+#include "sofs_probe.h"
+#include "sofs_buffercache.h"
+#include "sofs_superblock.h"
+#include "sofs_journal.h"
+#include "sofs_discard.h"
+
+/* Allusion to internal functions */
+
+static int cmpClust (const void *a, const void *b);
+
+/*
+ *  Internal data structure
+ */
+
+/** \brief signals if the data clusters freed are to be discarded on the storage device */
+static bool discard = false;
+
+/**
+ *  \brief Enable or disable the discard of the data clusters freed from now on.
+ *
+ *  It is disabled by default.
+ *
+ *  \param on signals if the data clusters freed are to be discarded on the storage device
+ */
+
+void soSetDiscard (bool on)
+{
+  discard = on;
+}
+
+/**
+ *  \brief Discard a batch of data clusters just freed.
+ *
+ *  Nothing is done if the discard mode is disabled, or the journal is open. The caller must hold the lock of the
+ *  superblock and the clusters must be free already.
+ *
+ *  \param p_sb pointer to a buffer where the superblock data is stored
+ *  \param count number of data clusters
+ *  \param nClust pointer to the array of the logical numbers of the data clusters (it is sorted in place)
+ */
+
+void soDiscardClusters (SOSuperBlock *p_sb, uint32_t count, uint32_t *nClust)
+{
+  soColorProbe (757, "07;31", "soDiscardClusters (%p, %"PRIu32", %p)\n", p_sb, count, nClust);
+
+  uint32_t first, last;                          /* indexes of the first cluster of a run and of the one past it */
+
+  if (!discard || (p_sb == NULL) || (count == 0) || (nClust == NULL) || soJournalInUse ()) return;
+
+  qsort (nClust, count, sizeof (uint32_t), cmpClust);
+  for (first = 0; first < count; first = last)
+  { last = first + 1;
+    while ((last < count) && (nClust[last] == nClust[last-1] + 1)) last++;
+    if (soDiscardCacheClusters (p_sb->dzone_start + nClust[first] * BLOCKS_PER_CLUSTER, last - first) == -EOPNOTSUPP)
+       { discard = false;                        /* the storage device does not allow it */
+         return;
+       }
+  }
+}
+
+/*
+ *  Internal functions
+ */
+
+/*
+ *  Compare two data cluster references (for sorting).
+ */
+
+static int cmpClust (const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+
+  return (x > y) - (x < y);
+}
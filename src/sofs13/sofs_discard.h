@@ -0,0 +1,58 @@
+/**
+ *  \file sofs_discard.h (interface file)
+ *
+ *  \brief Discard of the free data clusters on the storage device.
+ *
+ *  The contents of a free data cluster is never read again before the cluster is allocated and written, so the room
+ *  it takes on the storage device may be reclaimed: when the supporting file is a sparse file, or the storage device
+ *  is thin-provisioned, the clusters freed are discarded, on request, so that the storage device knows they are no
+ *  longer needed.
+ *
+ *  The clusters are dealt with in batches, as they leave the insertion cache of references to free data clusters for
+ *  the bitmap table, when it is depleted, or as a group of them is freed at once: the batch is sorted and each run of
+ *  successive clusters is discarded by a single request. As it takes place with the lock of the superblock held, right
+ *  after the bitmap table is changed, none of them may be allocated again meanwhile. The copies of the clusters in the
+ *  buffercache are dropped beforehand, so that they are never written back afterwards.
+ *
+ *  Discarding is only a hint: the errors are not reported and, when the storage device does not allow it, the discard
+ *  mode is turned off. It is not carried out either while the journal is open, since a discard could reach the storage
+ *  device before the transaction that freed the clusters is committed and the replay after an unclean shutdown would
+ *  give them back to their files.
+ *
+ *  The operations are:
+ *      \li enable or disable the discard of the data clusters freed from now on
+ *      \li discard a batch of data clusters just freed.
+ */
+
+#ifndef SOFS_DISCARD_H_
+#define SOFS_DISCARD_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sofs_superblock.h"
+
+/**
+ *  \brief Enable or disable the discard of the data clusters freed from now on.
+ *
+ *  It is disabled by default.
+ *
+ *  \param on signals if the data clusters freed are to be discarded on the storage device
+ */
+
+extern void soSetDiscard (bool on);
+
+/**
+ *  \brief Discard a batch of data clusters just freed.
+ *
+ *  Nothing is done if the discard mode is disabled, or the journal is open. The caller must hold the lock of the
+ *  superblock and the clusters must be free already.
+ *
+ *  \param p_sb pointer to a buffer where the superblock data is stored
+ *  \param count number of data clusters
+ *  \param nClust pointer to the array of the logical numbers of the data clusters (it is sorted in place)
+ */
+
+extern void soDiscardClusters (SOSuperBlock *p_sb, uint32_t count, uint32_t *nClust);
+
+#endif /* SOFS_DISCARD_H_ */
@@ -0,0 +1,933 @@
+/**
+ *  \file sofs_extent.c (implementation file)
+ *
+ *  \brief Trees of extents describing the information content of regular files.
+ *
+ *  The entries of the root and of each node are kept packed at their beginning, sorted by the index of their first
+ *  data cluster, the remaining ones having all fields set to \c NULL_CLUSTER. The lower bound kept for each node of
+ *  the level below is not greater than the index of its first data cluster and greater than the index of the last
+ *  data cluster described by the node which precedes it, so that a data cluster is looked for in the node whose lower
+ *  bound is the greatest one which is not greater than its index (or in the first one).
+ *
+ *  A change descends the tree once, copying the nodes on the path from the root to a leaf into internal storage. The
+ *  nodes which will be needed, if the leaf overflows, are reserved beforehand; the entries are then changed in the
+ *  copies, whose nodes are split from the bottom up when they overflow, and the copies which were changed are written
+ *  back. Splitting leaves the node which overflows full when the new entry is its last one, as it is the case when a
+ *  file is written in succession, and halves it otherwise. Nodes are not merged when they shrink: they are only freed
+ *  when they become empty.
+ *
+ *  The operations are:
+ *      \li enable or disable the tree of extents for the regular files created from now on
+ *      \li get the format for the information content of a new inode
+ *      \li quick check of an inode in use, whatever the format of its information content
+ *      \li quick check of a free inode in the dirty state, whatever the format of its information content
+ *      \li get the logical numbers of a group of successive data clusters of a file
+ *      \li insert a data cluster in the tree of extents of a file
+ *      \li remove a data cluster from the tree of extents of a file
+ *      \li remove all data clusters from a given point onwards from the tree of extents of a file
+ *      \li synchronize the nodes of the tree of extents of a file.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+
+#include "sofs_probe.h"
+#include "sofs_buffercache.h"
+#include "sofs_superblock.h"
+#include "sofs_inode.h"
+#include "sofs_datacluster.h"
+#include "sofs_basicoper.h"
+#include "sofs_basicconsist.h"
+#include "sofs_ifuncs_1.h"
+#include "sofs_extent.h"
+
+_Static_assert (offsetof (SOInode, i2) + sizeof (uint32_t) - offsetof (SOInode, d) ==
+                N_ROOT_EXTENTS * sizeof (SOExtent), "the root of the tree of extents must fill the references");
+
+/*
+ *  Internal data structures
+ */
+
+/** \brief copy in internal storage of a node on the path from the root to a leaf */
+typedef struct soExtNode
+{
+  /** \brief entries (there is room for one more than a node may hold, the one which overflows it) */
+  SOExtent ent[EPC+1];
+  /** \brief number of entries in use */
+  uint32_t cnt;
+  /** \brief logical number of the node (\c NULL_CLUSTER, for the root) */
+  uint32_t nClust;
+  /** \brief index of the entry the path goes through (for a leaf, of the first one beyond the data cluster) */
+  uint32_t pos;
+  /** \brief signals if the copy was changed */
+  bool dirty;
+} SOExtNode;
+
+/** \brief logical numbers of the clusters collected by a traversal of a tree of extents */
+typedef struct soExtCollect
+{
+  /** \brief size of both arrays */
+  uint32_t max;
+  /** \brief logical numbers of the data clusters */
+  uint32_t *data;
+  /** \brief number of data clusters */
+  uint32_t nData;
+  /** \brief logical numbers of the nodes */
+  uint32_t *nodes;
+  /** \brief number of nodes */
+  uint32_t nNodes;
+} SOExtCollect;
+
+/** \brief signals if the regular files created from now on are to be described by a tree of extents */
+static bool extFiles = false;
+
+/* Allusion to internal functions */
+
+static uint32_t getDepth (const SOInode *p_inode);
+static void setDepth (SOInode *p_inode, uint32_t depth);
+static uint32_t getRoot (const SOInode *p_inode, SOExtent *ent);
+static void putRoot (SOInode *p_inode, const SOExtent *ent, uint32_t cnt);
+static int checkRoot (SOSuperBlock *p_sb, SOInode *p_inode);
+static int loadNode (SOSuperBlock *p_sb, uint32_t nClust, SOExtent *ent, uint32_t *p_cnt);
+static int storeNode (SOSuperBlock *p_sb, uint32_t nClust, const SOExtent *ent, uint32_t cnt);
+static uint32_t upperBound (const SOExtent *ent, uint32_t cnt, uint32_t clustInd);
+static void insertEntry (SOExtNode *p_node, uint32_t at, const SOExtent *p_ext);
+static void deleteEntry (SOExtNode *p_node, uint32_t at);
+static int descend (SOSuperBlock *p_sb, SOInode *p_inode, uint32_t clustInd, SOExtNode *path);
+static int reserveNodes (uint32_t nInode, SOInode *p_inode, SOExtNode *path, uint32_t *nNode);
+static int commitPath (SOSuperBlock *p_sb, SOInode *p_inode, SOExtNode *path, uint32_t at, const uint32_t *nNode);
+static int shrinkTree (SOSuperBlock *p_sb, SOInode *p_inode, SOExtent *buf, uint32_t *nodes, uint32_t *p_n);
+static int releaseNodes (uint32_t nInode, SOInode *p_inode, uint32_t count, uint32_t *nNode);
+static int mapNode (uint32_t nInode, uint32_t nClust, bool on);
+static int truncNode (SOSuperBlock *p_sb, SOExtent *ent, uint32_t *p_cnt, uint32_t level, uint32_t depth,
+                      uint32_t clustInd, bool keep, SOExtCollect *p_col);
+static int syncNode (SOSuperBlock *p_sb, const SOExtent *ent, uint32_t cnt, uint32_t level, uint32_t depth);
+
+/**
+ *  \brief Enable or disable the tree of extents for the regular files created from now on.
+ *
+ *  It is disabled by default. The files already created keep the format of their information content.
+ *
+ *  \param on signals if the regular files are to be described by a tree of extents
+ */
+
+void soSetExtentFormat (bool on)
+{
+  extFiles = on;
+}
+
+/**
+ *  \brief Get the format for the information content of a new inode.
+ *
+ *  \param type the inode type (either a regular file, or a directory, or a symbolic link)
+ *
+ *  \return the flags of the inode mode setting the format (\c INODE_EXTENTS, or <tt>0 (zero)</tt> for the lists of
+ *          references)
+ */
+
+uint32_t soGetExtentFormat (uint32_t type)
+{
+  return (extFiles && (type == INODE_FILE)) ? INODE_EXTENTS : 0;
+}
+
+/**
+ *  \brief Quick check of an inode in use, whatever the format of its information content.
+ *
+ *  It is equivalent to \e soQCheckInodeIU for an inode whose information content is described by lists of references.
+ *  Otherwise, the fields which do not concern the information content are checked by \e soQCheckInodeIU and the root
+ *  of the tree of extents is checked in itself (the nodes are not read), or, if the information content is stored in
+ *  the inode, the inode must describe either a regular file or a symbolic link and have no data clusters. An inode
+ *  whose data clusters are compressed must describe a regular file and is checked by \e soQCheckInodeIU without the
+ *  flag which signals it.
+ *
+ *  \param p_sb pointer to a buffer where the superblock data is stored
+ *  \param p_inode pointer to the inode to be checked
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EIUININVAL, if the inode in use is inconsistent
+ *  \return -\c ELDCININVAL, if the root of the tree of extents is inconsistent
+ *  \return -<em>other specific error</em> issued by \e soQCheckInodeIU
+ */
+
+int soQCheckInodeExtIU (SOSuperBlock *p_sb, SOInode *p_inode)
+{
+  SOInode inode;                                 /* inode without its information content */
+  uint32_t i;                                    /* reference index */
+  int stat;                                      /* status of operation */
+
+  if ((p_inode != NULL) && INODE_IS_INLINE (p_inode->mode))
+     { if (((p_inode->mode & INODE_FMT_MASK) != INODE_INLINE) || (p_inode->clucount != 0) ||
+           (((p_inode->mode & INODE_TYPE_MASK) != INODE_FILE) && ((p_inode->mode & INODE_TYPE_MASK) != INODE_SYMLINK)))
+          return -EIUININVAL;
+     }
+     else if ((p_inode != NULL) && INODE_IS_COMPRESSED (p_inode->mode))
+             { if ((p_inode->mode & INODE_TYPE_MASK) != INODE_FILE) return -EIUININVAL;
+               inode = *p_inode;
+               inode.mode &= ~INODE_COMPRESSED;
+               return soQCheckInodeIU (p_sb, &inode);
+             }
+     else if ((p_inode == NULL) || !(p_inode->mode & INODE_EXTENTS))
+             { if ((p_inode != NULL) && (p_inode->mode & INODE_EXT_DEPTH_MASK)) return -EIUININVAL;
+               return soQCheckInodeIU (p_sb, p_inode);
+             }
+     else if ((p_inode->mode & INODE_TYPE_MASK) != INODE_FILE) return -EIUININVAL;
+
+  inode = *p_inode;
+  inode.mode &= ~INODE_FMT_MASK;
+  inode.clucount = 0;
+  for (i = 0; i < N_DIRECT; i++)
+    inode.d[i] = NULL_CLUSTER;
+  inode.i1 = inode.i2 = NULL_CLUSTER;
+  if ((stat = soQCheckInodeIU (p_sb, &inode)) != 0) return stat;
+
+  return INODE_IS_INLINE (p_inode->mode) ? 0 : checkRoot (p_sb, p_inode);
+}
+
+/**
+ *  \brief Quick check of a free inode in the dirty state, whatever the format of its information content.
+ *
+ *  It is equivalent to \e soQCheckFDInode for an inode whose information content is described by lists of references.
+ *  Otherwise, the fields which do not concern the information content are checked by \e soQCheckFDInode and the root
+ *  of the tree of extents is checked in itself (the nodes are not read). A free inode never has its information
+ *  content stored in it.
+ *
+ *  \param p_sb pointer to a buffer where the superblock data is stored
+ *  \param p_inode pointer to the inode to be checked
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EFDININVAL, if the free inode in the dirty state is inconsistent
+ *  \return -\c ELDCININVAL, if the root of the tree of extents is inconsistent
+ *  \return -<em>other specific error</em> issued by \e soQCheckFDInode
+ */
+
+int soQCheckFDInodeExt (SOSuperBlock *p_sb, SOInode *p_inode)
+{
+  SOInode inode;                                 /* inode without its information content */
+  uint32_t i;                                    /* reference index */
+  int stat;                                      /* status of operation */
+
+  if ((p_inode == NULL) || !(p_inode->mode & INODE_EXTENTS))
+     { if ((p_inode != NULL) && (p_inode->mode & INODE_EXT_DEPTH_MASK)) return -EFDININVAL;
+       return soQCheckFDInode (p_sb, p_inode);
+     }
+
+  inode = *p_inode;
+  inode.mode &= ~INODE_FMT_MASK;
+  inode.clucount = 0;
+  for (i = 0; i < N_DIRECT; i++)
+    inode.d[i] = NULL_CLUSTER;
+  inode.i1 = inode.i2 = NULL_CLUSTER;
+  if ((stat = soQCheckFDInode (p_sb, &inode)) != 0) return stat;
+
+  return checkRoot (p_sb, p_inode);
+}
+
+/**
+ *  \brief Get the logical numbers of a group of successive data clusters of a file.
+ *
+ *  Each leaf involved is reached by a single descent of the tree.
+ *
+ *  \param p_inode pointer to the inode associated to the file
+ *  \param firstInd index to the list of direct references of the first data cluster
+ *  \param count number of data clusters
+ *  \param nClust pointer to the array where the logical numbers of the data clusters are to be stored (\c NULL_CLUSTER,
+ *                for those which have not been allocated yet)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails reading or writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soExtentLookup (SOInode *p_inode, uint32_t firstInd, uint32_t count, uint32_t *nClust)
+{
+  soColorProbe (772, "07;31", "soExtentLookup (%p, %"PRIu32", %"PRIu32", %p)\n", p_inode, firstInd, count, nClust);
+
+  SOSuperBlock *p_sb;                            /* pointer to the superblock */
+  SOExtent ent[EPC];                             /* entries of the node being searched */
+  uint32_t depth, level, cnt, j;                 /* depth of the tree, level, number of entries and entry index */
+  uint32_t ind, end, limit, stop, val;           /* indexes of data clusters and logical number */
+  int stat;                                      /* status of operation */
+
+  if ((stat = soLoadSuperBlock ()) != 0) return stat;
+  p_sb = soGetSuperBlock ();
+  depth = getDepth (p_inode);
+
+  end = firstInd + count;
+  for (ind = firstInd; ind < end; )
+  { /* descent to the leaf where the data cluster is (limit is the lower bound of the next leaf) */
+    cnt = getRoot (p_inode, ent);
+    limit = end;
+    for (level = 0; level < depth; level++)
+    { if (cnt == 0) return -ELDCININVAL;
+      j = upperBound (ent, cnt, ind);
+      j = (j > 0) ? j - 1 : 0;
+      if ((j + 1 < cnt) && (ent[j+1].first < limit)) limit = ent[j+1].first;
+      if ((stat = loadNode (p_sb, ent[j].nClust, ent, &cnt)) != 0) return stat;
+    }
+
+    /* the extents of the leaf and the gaps between them are gone through */
+    j = upperBound (ent, cnt, ind);
+    while (ind < limit)
+    { if ((j > 0) && (ind - ent[j-1].first < ent[j-1].count))
+         { stop = ent[j-1].first + ent[j-1].count;
+           val = ent[j-1].nClust + (ind - ent[j-1].first);
+         }
+         else { stop = (j < cnt) ? ent[j].first : limit;
+                val = NULL_CLUSTER;
+              }
+      if (stop > limit) stop = limit;
+      for (; ind < stop; ind++)
+        nClust[ind-firstInd] = (val == NULL_CLUSTER) ? NULL_CLUSTER : val++;
+      if ((j < cnt) && (ind >= ent[j].first)) j++;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ *  \brief Insert a data cluster in the tree of extents of a file.
+ *
+ *  The data cluster extends the extent which precedes it, or the one which follows it, when they are contiguous in the
+ *  data zone, and is a new extent otherwise. The nodes which are needed when a node overflows are allocated before
+ *  the tree is changed and are associated to the inode, so that nothing is changed if the allocation fails. The data
+ *  cluster itself is supposed to be already allocated and associated to the inode.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param p_inode pointer to the inode associated to the file
+ *  \param clustInd index to the list of direct references of the data cluster
+ *  \param nClust logical number of the data cluster
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EDCARDYIL, if the index is already in the tree of extents
+ *  \return -\c EFBIG, if the tree of extents has no room for another extent
+ *  \return -<em>other specific error</em> issued by \e soAllocDataClusters or when reading or writing the nodes
+ */
+
+int soExtentInsert (uint32_t nInode, SOInode *p_inode, uint32_t clustInd, uint32_t nClust)
+{
+  soColorProbe (773, "07;31", "soExtentInsert (%"PRIu32", %p, %"PRIu32", %"PRIu32")\n",
+                nInode, p_inode, clustInd, nClust);
+
+  SOSuperBlock *p_sb;                            /* pointer to the superblock */
+  SOExtNode path[EXT_MAX_DEPTH+1];               /* copies of the nodes on the path from the root to the leaf */
+  SOExtNode *p_leaf;                             /* pointer to the copy of the leaf */
+  SOExtent ext;                                  /* new extent */
+  uint32_t nNode[EXT_MAX_DEPTH+1];               /* logical numbers of the nodes reserved */
+  uint32_t depth, level, j;                      /* depth of the tree, level and entry index */
+  bool prev, next;                               /* signal if the extent before / after is extended */
+  int stat;                                      /* status of operation */
+
+  if ((stat = soLoadSuperBlock ()) != 0) return stat;
+  p_sb = soGetSuperBlock ();
+  depth = getDepth (p_inode);
+  if ((stat = descend (p_sb, p_inode, clustInd, path)) != 0) return stat;
+  p_leaf = &path[depth];
+  j = p_leaf->pos;
+
+  if ((j > 0) && (clustInd - p_leaf->ent[j-1].first < p_leaf->ent[j-1].count)) return -EDCARDYIL;
+  prev = (j > 0) && (p_leaf->ent[j-1].first + p_leaf->ent[j-1].count == clustInd) &&
+         (p_leaf->ent[j-1].nClust + p_leaf->ent[j-1].count == nClust);
+  next = (j < p_leaf->cnt) && (p_leaf->ent[j].first == clustInd + 1) && (p_leaf->ent[j].nClust == nClust + 1);
+
+  if (prev)
+     { p_leaf->ent[j-1].count += 1;
+       if (next)                                 /* the data cluster fills the gap between two extents */
+          { p_leaf->ent[j-1].count += p_leaf->ent[j].count;
+            deleteEntry (p_leaf, j);
+          }
+     }
+     else if (next)
+             { p_leaf->ent[j].first -= 1;
+               p_leaf->ent[j].nClust -= 1;
+             }
+             else { if ((stat = reserveNodes (nInode, p_inode, path, nNode)) != 0) return stat;
+                    ext.first = clustInd;
+                    ext.count = 1;
+                    ext.nClust = nClust;
+                    insertEntry (p_leaf, j, &ext);
+                  }
+  p_leaf->dirty = true;
+
+  /* the lower bounds on the path must not be greater than the index of the data cluster */
+  for (level = 0; level < depth; level++)
+    if (path[level].ent[path[level].pos].first > clustInd)
+       { path[level].ent[path[level].pos].first = clustInd;
+         path[level].dirty = true;
+       }
+
+  return commitPath (p_sb, p_inode, path, j, nNode);
+}
+
+/**
+ *  \brief Remove a data cluster from the tree of extents of a file.
+ *
+ *  The extent it belongs to is shrunk, or split in two when the data cluster lies in its middle. The nodes left empty
+ *  are dissociated from the inode and freed, and the tree loses a level when the root may again hold the entries of
+ *  its only node. The data cluster itself is neither dissociated from the inode nor freed.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param p_inode pointer to the inode associated to the file
+ *  \param clustInd index to the list of direct references of the data cluster
+ *  \param p_nClust pointer to a location where the logical number of the data cluster is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EDCNOTIL, if the index is not in the tree of extents
+ *  \return -\c EFBIG, if the tree of extents has no room for the extent split in two
+ *  \return -<em>other specific error</em> issued by \e soAllocDataClusters, \e soFreeDataCluster or when reading or
+ *          writing the nodes
+ */
+
+int soExtentRemove (uint32_t nInode, SOInode *p_inode, uint32_t clustInd, uint32_t *p_nClust)
+{
+  soColorProbe (774, "07;31", "soExtentRemove (%"PRIu32", %p, %"PRIu32", %p)\n", nInode, p_inode, clustInd, p_nClust);
+
+  SOSuperBlock *p_sb;                            /* pointer to the superblock */
+  SOExtNode path[EXT_MAX_DEPTH+1];               /* copies of the nodes on the path from the root to the leaf */
+  SOExtNode *p_leaf;                             /* pointer to the copy of the leaf */
+  SOExtent ext, tail;                            /* extent the data cluster belongs to and what follows it */
+  uint32_t nNode[EXT_MAX_DEPTH+1];               /* logical numbers of the nodes reserved */
+  uint32_t freed[2*EXT_MAX_DEPTH];               /* logical numbers of the nodes to be freed */
+  uint32_t depth, level, j, off, nFreed;         /* depth of the tree, level, entry index, offset and node count */
+  int stat;                                      /* status of operation */
+
+  if ((stat = soLoadSuperBlock ()) != 0) return stat;
+  p_sb = soGetSuperBlock ();
+  depth = getDepth (p_inode);
+  if ((stat = descend (p_sb, p_inode, clustInd, path)) != 0) return stat;
+  p_leaf = &path[depth];
+  j = p_leaf->pos;
+
+  if ((j == 0) || (clustInd - p_leaf->ent[j-1].first >= p_leaf->ent[j-1].count)) return -EDCNOTIL;
+  ext = p_leaf->ent[j-1];
+  off = clustInd - ext.first;
+  *p_nClust = ext.nClust + off;
+
+  if ((off > 0) && (off < ext.count - 1))        /* the extent is split in two */
+     { if ((stat = reserveNodes (nInode, p_inode, path, nNode)) != 0) return stat;
+       p_leaf->ent[j-1].count = off;
+       tail.first = clustInd + 1;
+       tail.count = ext.count - off - 1;
+       tail.nClust = *p_nClust + 1;
+       insertEntry (p_leaf, j, &tail);
+     }
+     else if (ext.count == 1)
+             deleteEntry (p_leaf, j - 1);
+             else if (off == 0)
+                     { p_leaf->ent[j-1].first += 1;
+                       p_leaf->ent[j-1].nClust += 1;
+                       p_leaf->ent[j-1].count -= 1;
+                     }
+                     else p_leaf->ent[j-1].count -= 1;
+  p_leaf->dirty = true;
+
+  /* the nodes left empty are removed from the level above */
+  nFreed = 0;
+  for (level = depth; (level > 0) && (path[level].cnt == 0); level--)
+  { freed[nFreed++] = path[level].nClust;
+    path[level].dirty = false;
+    deleteEntry (&path[level-1], path[level-1].pos);
+  }
+
+  if ((stat = commitPath (p_sb, p_inode, path, j, nNode)) != 0) return stat;
+  if ((stat = shrinkTree (p_sb, p_inode, path[0].ent, freed, &nFreed)) != 0) return stat;
+
+  return releaseNodes (nInode, p_inode, nFreed, freed);
+}
+
+/**
+ *  \brief Remove all data clusters from a given point onwards from the tree of extents of a file.
+ *
+ *  The tree is traversed only once, collecting the logical numbers of the data clusters involved and of the nodes
+ *  left empty, which are neither dissociated from the inode nor freed, as it is up to the caller. The field
+ *  <em>clucount</em> of the inode is not updated either. If the tree is just to be traversed, it is not changed.
+ *
+ *  \param p_inode pointer to the inode associated to the file
+ *  \param clustInd index to the list of direct references of the first data cluster to be removed
+ *  \param keep signals if the tree is to be kept unchanged
+ *  \param max size of both arrays
+ *  \param data pointer to the array where the logical numbers of the data clusters are to be stored
+ *  \param p_nData pointer to a location where the number of data clusters is to be stored
+ *  \param nodes pointer to the array where the logical numbers of the nodes left empty are to be stored
+ *  \param p_nNodes pointer to a location where the number of nodes is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c ELDCININVAL, if the tree of extents describes more clusters than the arrays may hold
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails reading or writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soExtentTruncate (SOInode *p_inode, uint32_t clustInd, bool keep, uint32_t max, uint32_t *data,
+                      uint32_t *p_nData, uint32_t *nodes, uint32_t *p_nNodes)
+{
+  soColorProbe (775, "07;31", "soExtentTruncate (%p, %"PRIu32", %d, %"PRIu32", %p, %p, %p, %p)\n",
+                p_inode, clustInd, keep, max, data, p_nData, nodes, p_nNodes);
+
+  SOSuperBlock *p_sb;                            /* pointer to the superblock */
+  SOExtent root[EPC];                            /* entries of the root (and of the node pulled up into it) */
+  SOExtCollect col;                              /* clusters collected */
+  uint32_t cnt, depth;                           /* number of entries of the root and depth of the tree */
+  int stat;                                      /* status of operation */
+
+  if ((stat = soLoadSuperBlock ()) != 0) return stat;
+  p_sb = soGetSuperBlock ();
+
+  col.max = max;
+  col.data = data;
+  col.nData = 0;
+  col.nodes = nodes;
+  col.nNodes = 0;
+  depth = getDepth (p_inode);
+  cnt = getRoot (p_inode, root);
+  if ((stat = truncNode (p_sb, root, &cnt, 0, depth, clustInd, keep, &col)) != 0) return stat;
+
+  if (!keep)
+     { putRoot (p_inode, root, cnt);
+       if (cnt == 0) setDepth (p_inode, 0);
+       if (col.max - col.nNodes < depth) return -ELDCININVAL;
+       if ((stat = shrinkTree (p_sb, p_inode, root, col.nodes, &col.nNodes)) != 0) return stat;
+     }
+  *p_nData = col.nData;
+  *p_nNodes = col.nNodes;
+
+  return 0;
+}
+
+/**
+ *  \brief Synchronize the nodes of the tree of extents of a file.
+ *
+ *  \param p_inode pointer to the inode associated to the file
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails reading or writing
+ *  \return -<em>other specific error</em> issued by \e soSyncCacheCluster
+ */
+
+int soExtentSync (SOInode *p_inode)
+{
+  soColorProbe (776, "07;31", "soExtentSync (%p)\n", p_inode);
+
+  SOSuperBlock *p_sb;                            /* pointer to the superblock */
+  SOExtent root[N_ROOT_EXTENTS];                 /* entries of the root */
+  uint32_t cnt;                                  /* number of entries of the root */
+  int stat;                                      /* status of operation */
+
+  if ((stat = soLoadSuperBlock ()) != 0) return stat;
+  p_sb = soGetSuperBlock ();
+
+  cnt = getRoot (p_inode, root);
+
+  return syncNode (p_sb, root, cnt, 0, getDepth (p_inode));
+}
+
+/*
+ *  Get the depth of the tree of extents of an inode.
+ */
+
+static uint32_t getDepth (const SOInode *p_inode)
+{
+  return (p_inode->mode & INODE_EXT_DEPTH_MASK) >> INODE_EXT_DEPTH_SHIFT;
+}
+
+/*
+ *  Set the depth of the tree of extents of an inode.
+ */
+
+static void setDepth (SOInode *p_inode, uint32_t depth)
+{
+  p_inode->mode = (p_inode->mode & ~INODE_EXT_DEPTH_MASK) | (depth << INODE_EXT_DEPTH_SHIFT);
+}
+
+/*
+ *  Copy the entries of the root of the tree of extents of an inode (the array must hold N_ROOT_EXTENTS entries) and
+ *  get how many are in use.
+ */
+
+static uint32_t getRoot (const SOInode *p_inode, SOExtent *ent)
+{
+  uint32_t cnt;                                  /* number of entries in use */
+
+  memcpy (ent, p_inode->d, N_ROOT_EXTENTS * sizeof (SOExtent));
+  for (cnt = 0; (cnt < N_ROOT_EXTENTS) && (ent[cnt].nClust != NULL_CLUSTER); cnt++);
+
+  return cnt;
+}
+
+/*
+ *  Store the entries of the root of the tree of extents of an inode, the ones not in use being cleared.
+ */
+
+static void putRoot (SOInode *p_inode, const SOExtent *ent, uint32_t cnt)
+{
+  SOExtent root[N_ROOT_EXTENTS];                 /* entries of the root */
+
+  memset (root, 0xFF, sizeof (root));
+  memcpy (root, ent, cnt * sizeof (SOExtent));
+  memcpy (p_inode->d, root, sizeof (root));
+}
+
+/*
+ *  Check the root of the tree of extents of an inode: the entries in use must be packed at its beginning, sorted and
+ *  refer to clusters of the data zone and, if the tree is made of the root alone, the extents must not overlap, must
+ *  lie within the maximum size of a file and must account for all the data clusters of the file.
+ */
+
+static int checkRoot (SOSuperBlock *p_sb, SOInode *p_inode)
+{
+  SOExtent ent[N_ROOT_EXTENTS];                  /* entries of the root */
+  uint32_t depth, cnt, i, total;                 /* depth of the tree, number of entries, entry index and count */
+
+  depth = getDepth (p_inode);
+  cnt = getRoot (p_inode, ent);
+  if ((depth > EXT_MAX_DEPTH) || ((depth > 0) && (cnt == 0))) return -ELDCININVAL;
+  for (i = cnt; i < N_ROOT_EXTENTS; i++)
+    if ((ent[i].first != NULL_CLUSTER) || (ent[i].count != NULL_CLUSTER) || (ent[i].nClust != NULL_CLUSTER))
+       return -ELDCININVAL;
+
+  total = 0;
+  for (i = 0; i < cnt; i++)
+  { if (ent[i].nClust >= p_sb->dzone_total) return -ELDCININVAL;
+    if (depth > 0)
+       { if ((ent[i].count != 0) || ((i > 0) && (ent[i].first <= ent[i-1].first))) return -ELDCININVAL;
+         continue;
+       }
+    if ((ent[i].count == 0) || (ent[i].first >= MAX_FILE_CLUSTERS) ||
+        (ent[i].count > MAX_FILE_CLUSTERS - ent[i].first) || (ent[i].count > p_sb->dzone_total - ent[i].nClust) ||
+        ((i > 0) && (ent[i].first < ent[i-1].first + ent[i-1].count)))
+       return -ELDCININVAL;
+    total += ent[i].count;
+  }
+  if ((depth == 0) ? (total != p_inode->clucount) : (p_inode->clucount < cnt)) return -ELDCININVAL;
+
+  return 0;
+}
+
+/*
+ *  Copy the entries of a node into internal storage (the array must hold EPC entries) and get how many are in use.
+ */
+
+static int loadNode (SOSuperBlock *p_sb, uint32_t nClust, SOExtent *ent, uint32_t *p_cnt)
+{
+  SODataClust *p_clt;                            /* pointer to the node */
+  uint32_t h, cnt;                               /* handle and number of entries in use */
+  int stat;                                      /* status of operation */
+
+  if (nClust >= p_sb->dzone_total) return -ELDCININVAL;
+  if ((stat = soLoadRefClustH (p_sb->dzone_start + nClust * BLOCKS_PER_CLUSTER, &h)) != 0) return stat;
+  if ((p_clt = soGetRefClustH (h)) == NULL) return -ELIBBAD;
+  memcpy (ent, p_clt->ext, EPC * sizeof (SOExtent));
+  for (cnt = 0; (cnt < EPC) && (ent[cnt].nClust != NULL_CLUSTER); cnt++);
+  *p_cnt = cnt;
+
+  return 0;
+}
+
+/*
+ *  Store the entries of a node from internal storage, the ones not in use being cleared.
+ */
+
+static int storeNode (SOSuperBlock *p_sb, uint32_t nClust, const SOExtent *ent, uint32_t cnt)
+{
+  SODataClust *p_clt;                            /* pointer to the node */
+  uint32_t h;                                    /* handle */
+  int stat;                                      /* status of operation */
+
+  if ((stat = soLoadRefClustH (p_sb->dzone_start + nClust * BLOCKS_PER_CLUSTER, &h)) != 0) return stat;
+  if ((p_clt = soGetRefClustH (h)) == NULL) return -ELIBBAD;
+  memset (p_clt, 0xFF, sizeof (SODataClust));
+  memcpy (p_clt->ext, ent, cnt * sizeof (SOExtent));
+
+  return soStoreRefClustH (h);
+}
+
+/*
+ *  Get the index of the first entry whose first data cluster has an index greater than the given one (binary search).
+ */
+
+static uint32_t upperBound (const SOExtent *ent, uint32_t cnt, uint32_t clustInd)
+{
+  uint32_t lo, hi, mid;                          /* bounds of the search */
+
+  lo = 0;
+  hi = cnt;
+  while (lo < hi)
+  { mid = lo + (hi - lo) / 2;
+    if (ent[mid].first <= clustInd)
+       lo = mid + 1;
+       else hi = mid;
+  }
+
+  return lo;
+}
+
+/*
+ *  Insert an entry in the copy of a node (it may overflow the node by one entry).
+ */
+
+static void insertEntry (SOExtNode *p_node, uint32_t at, const SOExtent *p_ext)
+{
+  memmove (&p_node->ent[at+1], &p_node->ent[at], (p_node->cnt - at) * sizeof (SOExtent));
+  p_node->ent[at] = *p_ext;
+  p_node->cnt += 1;
+  p_node->dirty = true;
+}
+
+/*
+ *  Delete an entry from the copy of a node.
+ */
+
+static void deleteEntry (SOExtNode *p_node, uint32_t at)
+{
+  memmove (&p_node->ent[at], &p_node->ent[at+1], (p_node->cnt - at - 1) * sizeof (SOExtent));
+  p_node->cnt -= 1;
+  p_node->dirty = true;
+}
+
+/*
+ *  Copy the nodes on the path from the root to the leaf where a data cluster is, or is to be inserted, into internal
+ *  storage (path[0] is the root and path[depth] the leaf).
+ */
+
+static int descend (SOSuperBlock *p_sb, SOInode *p_inode, uint32_t clustInd, SOExtNode *path)
+{
+  uint32_t depth, level, j;                      /* depth of the tree, level and entry index */
+  int stat;                                      /* status of operation */
+
+  depth = getDepth (p_inode);
+  path[0].cnt = getRoot (p_inode, path[0].ent);
+  path[0].nClust = NULL_CLUSTER;
+  path[0].dirty = false;
+  for (level = 0; level < depth; level++)
+  { if (path[level].cnt == 0) return -ELDCININVAL;
+    j = upperBound (path[level].ent, path[level].cnt, clustInd);
+    path[level].pos = (j > 0) ? j - 1 : 0;
+    path[level+1].nClust = path[level].ent[path[level].pos].nClust;
+    path[level+1].dirty = false;
+    if ((stat = loadNode (p_sb, path[level+1].nClust, path[level+1].ent, &path[level+1].cnt)) != 0) return stat;
+  }
+  path[depth].pos = upperBound (path[depth].ent, path[depth].cnt, clustInd);
+
+  return 0;
+}
+
+/*
+ *  Allocate the nodes needed for an entry to be added to the leaf of a path (one for each full node, from the leaf
+ *  upwards, and one more if the root is full as well) and associate them to the inode.
+ */
+
+static int reserveNodes (uint32_t nInode, SOInode *p_inode, SOExtNode *path, uint32_t *nNode)
+{
+  uint32_t depth, level, n, i;                   /* depth of the tree, level and number of nodes */
+  int stat;                                      /* status of operation */
+
+  depth = getDepth (p_inode);
+  for (level = depth, n = 0; (level > 0) && (path[level].cnt == EPC); level--)
+    n++;
+  if ((level == 0) && (path[0].cnt == N_ROOT_EXTENTS))
+     { if (depth == EXT_MAX_DEPTH) return -EFBIG;
+       n++;
+     }
+  if (n == 0) return 0;
+
+  if ((stat = soAllocDataClusters (NULL_CLUSTER, n, nNode)) != 0) return stat;
+  for (i = 0; i < n; i++)
+    if ((stat = mapNode (nInode, nNode[i], true)) != 0) return stat;
+  p_inode->clucount += n;
+
+  return 0;
+}
+
+/*
+ *  Write back the copies of the nodes of a path which were changed, splitting those which overflow from the bottom up
+ *  (at is the index of the entry added to the leaf) into the nodes reserved, and the root into the inode.
+ */
+
+static int commitPath (SOSuperBlock *p_sb, SOInode *p_inode, SOExtNode *path, uint32_t at, const uint32_t *nNode)
+{
+  SOExtent ext;                                  /* entry of the new node in the level above */
+  uint32_t depth, level, left, used;             /* depth of the tree, level, entries kept and nodes used */
+  int stat;                                      /* status of operation */
+
+  depth = getDepth (p_inode);
+  used = 0;
+  for (level = depth; (level > 0) && (path[level].cnt > EPC); level--)
+  { left = (at == path[level].cnt - 1) ? path[level].cnt - 1 : path[level].cnt / 2;
+    ext.first = path[level].ent[left].first;
+    ext.count = 0;
+    ext.nClust = nNode[used++];
+    if ((stat = storeNode (p_sb, ext.nClust, &path[level].ent[left], path[level].cnt - left)) != 0) return stat;
+    path[level].cnt = left;
+    at = path[level-1].pos + 1;
+    insertEntry (&path[level-1], at, &ext);
+  }
+  for (level = 1; level <= depth; level++)
+    if (path[level].dirty && ((stat = storeNode (p_sb, path[level].nClust, path[level].ent, path[level].cnt)) != 0))
+       return stat;
+
+  /* the root which overflows is moved into a new node and the tree grows a level */
+  if (path[0].cnt > N_ROOT_EXTENTS)
+     { ext.first = path[0].ent[0].first;
+       ext.count = 0;
+       ext.nClust = nNode[used++];
+       if ((stat = storeNode (p_sb, ext.nClust, path[0].ent, path[0].cnt)) != 0) return stat;
+       path[0].ent[0] = ext;
+       path[0].cnt = 1;
+       depth += 1;
+     }
+  if (path[0].cnt == 0) depth = 0;
+  putRoot (p_inode, path[0].ent, path[0].cnt);
+  setDepth (p_inode, depth);
+
+  return 0;
+}
+
+/*
+ *  Pull the only node below the root up into it, as long as it fits there, collecting the nodes which are no longer
+ *  in use (the array buf must hold EPC entries).
+ */
+
+static int shrinkTree (SOSuperBlock *p_sb, SOInode *p_inode, SOExtent *buf, uint32_t *nodes, uint32_t *p_n)
+{
+  uint32_t depth, cnt, nClust;                   /* depth of the tree, number of entries and node */
+  int stat;                                      /* status of operation */
+
+  depth = getDepth (p_inode);
+  while ((depth > 0) && (getRoot (p_inode, buf) == 1))
+  { nClust = buf[0].nClust;
+    if ((stat = loadNode (p_sb, nClust, buf, &cnt)) != 0) return stat;
+    if (cnt > N_ROOT_EXTENTS) break;
+    putRoot (p_inode, buf, cnt);
+    nodes[(*p_n)++] = nClust;
+    depth -= 1;
+    setDepth (p_inode, (cnt == 0) ? 0 : depth);
+  }
+
+  return 0;
+}
+
+/*
+ *  Dissociate a group of nodes from the inode and free them.
+ */
+
+static int releaseNodes (uint32_t nInode, SOInode *p_inode, uint32_t count, uint32_t *nNode)
+{
+  uint32_t i;                                    /* node index */
+  int stat;                                      /* status of operation */
+
+  for (i = 0; i < count; i++)
+  { if ((stat = mapNode (nInode, nNode[i], false)) != 0) return stat;
+    p_inode->clucount -= 1;
+  }
+
+  return (count == 0) ? 0 : soFreeDataClusters (count, nNode);
+}
+
+/*
+ *  Associate a node to the inode, or dissociate it, in the table of cluster-to-inode mapping.
+ */
+
+static int mapNode (uint32_t nInode, uint32_t nClust, bool on)
+{
+  uint32_t *cTInT, nBlk, off;                    /* table of cluster-to-inode mapping, block and offset */
+  int stat;                                      /* status of operation */
+
+  if ((stat = soConvertRefCInMT (nClust, &nBlk, &off)) != 0) return stat;
+  if ((stat = soLoadBlockCTInMT (nBlk)) != 0) return stat;
+  if ((cTInT = soGetBlockCTInMT ()) == NULL) return -ELIBBAD;
+  if (!on && (cTInT[off] != nInode)) return -EDCMINVAL;
+  cTInT[off] = on ? nInode : NULL_INODE;
+
+  return soStoreBlockCTInMT ();
+}
+
+/*
+ *  Collect the data clusters described by a node (or by the root), from index clustInd onwards, and, unless the tree
+ *  is to be kept unchanged, the nodes below which become empty. The entries left are stored in place (the array must
+ *  hold EPC entries) and the nodes below which were changed are written back, but the node itself is not.
+ */
+
+static int truncNode (SOSuperBlock *p_sb, SOExtent *ent, uint32_t *p_cnt, uint32_t level, uint32_t depth,
+                      uint32_t clustInd, bool keep, SOExtCollect *p_col)
+{
+  SOExtent child[EPC];                           /* entries of the node below */
+  uint32_t i, k, off, c, cnt, before;            /* entry index, entries kept, offset, counts */
+  int stat;                                      /* status of operation */
+
+  if (level == depth)                            /* leaf: the extents are cut short */
+     { for (i = 0, k = 0; i < *p_cnt; i++)
+       { if (ent[i].first >= clustInd)
+            off = 0;
+            else if (clustInd - ent[i].first < ent[i].count)
+                    off = clustInd - ent[i].first;
+                    else { k++;
+                           continue;
+                         }
+         if (ent[i].count - off > p_col->max - p_col->nData) return -ELDCININVAL;
+         for (c = off; c < ent[i].count; c++)
+           p_col->data[p_col->nData++] = ent[i].nClust + c;
+         if (off > 0)
+            { ent[i].count = off;
+              k++;
+            }
+       }
+       *p_cnt = k;
+       return 0;
+     }
+
+  /* the nodes whose lower bound is not less than clustInd are gone through in full, the one before in part */
+  k = (clustInd == 0) ? 0 : upperBound (ent, *p_cnt, clustInd - 1);
+  for (i = k; i < *p_cnt; i++)
+  { if ((stat = loadNode (p_sb, ent[i].nClust, child, &cnt)) != 0) return stat;
+    if ((stat = truncNode (p_sb, child, &cnt, level + 1, depth, 0, keep, p_col)) != 0) return stat;
+    if (!keep)
+       { if (p_col->nNodes == p_col->max) return -ELDCININVAL;
+         p_col->nodes[p_col->nNodes++] = ent[i].nClust;
+       }
+  }
+  if (k > 0)
+     { if ((stat = loadNode (p_sb, ent[k-1].nClust, child, &cnt)) != 0) return stat;
+       before = p_col->nData + p_col->nNodes;
+       if ((stat = truncNode (p_sb, child, &cnt, level + 1, depth, clustInd, keep, p_col)) != 0) return stat;
+       if (!keep && (cnt == 0))
+          { if (p_col->nNodes == p_col->max) return -ELDCININVAL;
+            p_col->nodes[p_col->nNodes++] = ent[k-1].nClust;
+            k--;
+          }
+          else if (!keep && (p_col->nData + p_col->nNodes != before) &&
+                   ((stat = storeNode (p_sb, ent[k-1].nClust, child, cnt)) != 0))
+                  return stat;
+     }
+  *p_cnt = k;
+
+  return 0;
+}
+
+/*
+ *  Synchronize the nodes below a node (or the root).
+ */
+
+static int syncNode (SOSuperBlock *p_sb, const SOExtent *ent, uint32_t cnt, uint32_t level, uint32_t depth)
+{
+  SOExtent child[EPC];                           /* entries of the node below */
+  uint32_t i, n;                                 /* entry index and number of entries of the node below */
+  int stat;                                      /* status of operation */
+
+  if (level == depth) return 0;
+  for (i = 0; i < cnt; i++)
+  { if ((stat = loadNode (p_sb, ent[i].nClust, child, &n)) != 0) return stat;
+    if ((stat = syncNode (p_sb, child, n, level + 1, depth)) != 0) return stat;
+    if ((stat = soSyncCacheCluster (p_sb->dzone_start + ent[i].nClust * BLOCKS_PER_CLUSTER)) != 0) return stat;
+  }
+
+  return 0;
+}
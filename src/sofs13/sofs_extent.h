@@ -0,0 +1,213 @@
+/**
+ *  \file sofs_extent.h (interface file)
+ *
+ *  \brief Trees of extents describing the information content of regular files.
+ *
+ *  As an alternative to the lists of direct, single indirect and double indirect references, the data clusters of a
+ *  regular file may be described by a tree of extents, signaled in the inode mode: each extent stands for a run of data
+ *  clusters with successive indexes stored in successive clusters of the data zone, so that a file allocated
+ *  contiguously takes a handful of them and the logical number of a data cluster is found by a binary search at each
+ *  level.
+ *
+ *  The root of the tree takes the place of the references in the inode and holds up to \c N_ROOT_EXTENTS entries. When
+ *  it overflows, its entries are moved into a node, a data cluster holding up to \c EPC entries, and the tree grows a
+ *  level, up to three levels of nodes below the root. The leaves hold the extents, sorted by the index of their first
+ *  data cluster; the other nodes, the root included when the tree has more than one level, hold the lower bounds of
+ *  the indexes of the data clusters described by each node of the level below. The nodes are data clusters attached
+ *  to the file, accounted for in the field <em>clucount</em> of the inode and associated to it in the table of
+ *  cluster-to-inode mapping, as the clusters of references are.
+ *
+ *  All operations work on a copy of the inode in internal storage, which the caller is supposed to write afterwards
+ *  if it was changed, and the caller must hold the lock of the inode.
+ *
+ *  The operations are:
+ *      \li enable or disable the tree of extents for the regular files created from now on
+ *      \li get the format for the information content of a new inode
+ *      \li quick check of an inode in use, whatever the format of its information content
+ *      \li quick check of a free inode in the dirty state, whatever the format of its information content
+ *      \li get the logical numbers of a group of successive data clusters of a file
+ *      \li insert a data cluster in the tree of extents of a file
+ *      \li remove a data cluster from the tree of extents of a file
+ *      \li remove all data clusters from a given point onwards from the tree of extents of a file
+ *      \li synchronize the nodes of the tree of extents of a file.
+ *
+ *  \remarks In case an error occurs, all functions return a negative value which is the symmetric of the system error
+ *           that better represents the error cause.
+ *           (execute command <em>man errno</em> to get the list of system errors)
+ */
+
+#ifndef SOFS_EXTENT_H_
+#define SOFS_EXTENT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sofs_superblock.h"
+#include "sofs_inode.h"
+
+/** \brief maximum depth of a tree of extents (number of levels of nodes below the root) */
+#define EXT_MAX_DEPTH  3
+
+/**
+ *  \brief Enable or disable the tree of extents for the regular files created from now on.
+ *
+ *  It is disabled by default. The files already created keep the format of their information content.
+ *
+ *  \param on signals if the regular files are to be described by a tree of extents
+ */
+
+extern void soSetExtentFormat (bool on);
+
+/**
+ *  \brief Get the format for the information content of a new inode.
+ *
+ *  \param type the inode type (either a regular file, or a directory, or a symbolic link)
+ *
+ *  \return the flags of the inode mode setting the format (\c INODE_EXTENTS, or <tt>0 (zero)</tt> for the lists of
+ *          references)
+ */
+
+extern uint32_t soGetExtentFormat (uint32_t type);
+
+/**
+ *  \brief Quick check of an inode in use, whatever the format of its information content.
+ *
+ *  It is equivalent to \e soQCheckInodeIU for an inode whose information content is described by lists of references.
+ *  Otherwise, the fields which do not concern the information content are checked by \e soQCheckInodeIU and the root
+ *  of the tree of extents is checked in itself (the nodes are not read), or, if the information content is stored in
+ *  the inode, the inode must describe either a regular file or a symbolic link and have no data clusters.
+ *
+ *  \param p_sb pointer to a buffer where the superblock data is stored
+ *  \param p_inode pointer to the inode to be checked
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EIUININVAL, if the inode in use is inconsistent
+ *  \return -\c ELDCININVAL, if the root of the tree of extents is inconsistent
+ *  \return -<em>other specific error</em> issued by \e soQCheckInodeIU
+ */
+
+extern int soQCheckInodeExtIU (SOSuperBlock *p_sb, SOInode *p_inode);
+
+/**
+ *  \brief Quick check of a free inode in the dirty state, whatever the format of its information content.
+ *
+ *  It is equivalent to \e soQCheckFDInode for an inode whose information content is described by lists of references.
+ *  Otherwise, the fields which do not concern the information content are checked by \e soQCheckFDInode and the root
+ *  of the tree of extents is checked in itself (the nodes are not read). A free inode never has its information
+ *  content stored in it.
+ *
+ *  \param p_sb pointer to a buffer where the superblock data is stored
+ *  \param p_inode pointer to the inode to be checked
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EFDININVAL, if the free inode in the dirty state is inconsistent
+ *  \return -\c ELDCININVAL, if the root of the tree of extents is inconsistent
+ *  \return -<em>other specific error</em> issued by \e soQCheckFDInode
+ */
+
+extern int soQCheckFDInodeExt (SOSuperBlock *p_sb, SOInode *p_inode);
+
+/**
+ *  \brief Get the logical numbers of a group of successive data clusters of a file.
+ *
+ *  Each leaf involved is reached by a single descent of the tree.
+ *
+ *  \param p_inode pointer to the inode associated to the file
+ *  \param firstInd index to the list of direct references of the first data cluster
+ *  \param count number of data clusters
+ *  \param nClust pointer to the array where the logical numbers of the data clusters are to be stored (\c NULL_CLUSTER,
+ *                for those which have not been allocated yet)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails reading or writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+extern int soExtentLookup (SOInode *p_inode, uint32_t firstInd, uint32_t count, uint32_t *nClust);
+
+/**
+ *  \brief Insert a data cluster in the tree of extents of a file.
+ *
+ *  The data cluster extends the extent which precedes it, or the one which follows it, when they are contiguous in the
+ *  data zone, and is a new extent otherwise. The nodes which are needed when a node overflows are allocated before
+ *  the tree is changed and are associated to the inode, so that nothing is changed if the allocation fails. The data
+ *  cluster itself is supposed to be already allocated and associated to the inode.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param p_inode pointer to the inode associated to the file
+ *  \param clustInd index to the list of direct references of the data cluster
+ *  \param nClust logical number of the data cluster
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EDCARDYIL, if the index is already in the tree of extents
+ *  \return -\c EFBIG, if the tree of extents has no room for another extent
+ *  \return -<em>other specific error</em> issued by \e soAllocDataClusters or when reading or writing the nodes
+ */
+
+extern int soExtentInsert (uint32_t nInode, SOInode *p_inode, uint32_t clustInd, uint32_t nClust);
+
+/**
+ *  \brief Remove a data cluster from the tree of extents of a file.
+ *
+ *  The extent it belongs to is shrunk, or split in two when the data cluster lies in its middle. The nodes left empty
+ *  are dissociated from the inode and freed, and the tree loses a level when the root may again hold the entries of
+ *  its only node. The data cluster itself is neither dissociated from the inode nor freed.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param p_inode pointer to the inode associated to the file
+ *  \param clustInd index to the list of direct references of the data cluster
+ *  \param p_nClust pointer to a location where the logical number of the data cluster is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EDCNOTIL, if the index is not in the tree of extents
+ *  \return -\c EFBIG, if the tree of extents has no room for the extent split in two
+ *  \return -<em>other specific error</em> issued by \e soAllocDataClusters, \e soFreeDataCluster or when reading or
+ *          writing the nodes
+ */
+
+extern int soExtentRemove (uint32_t nInode, SOInode *p_inode, uint32_t clustInd, uint32_t *p_nClust);
+
+/**
+ *  \brief Remove all data clusters from a given point onwards from the tree of extents of a file.
+ *
+ *  The tree is traversed only once, collecting the logical numbers of the data clusters involved and of the nodes
+ *  left empty, which are neither dissociated from the inode nor freed, as it is up to the caller. The field
+ *  <em>clucount</em> of the inode is not updated either. If the tree is just to be traversed, it is not changed.
+ *
+ *  \param p_inode pointer to the inode associated to the file
+ *  \param clustInd index to the list of direct references of the first data cluster to be removed
+ *  \param keep signals if the tree is to be kept unchanged
+ *  \param max size of both arrays
+ *  \param data pointer to the array where the logical numbers of the data clusters are to be stored
+ *  \param p_nData pointer to a location where the number of data clusters is to be stored
+ *  \param nodes pointer to the array where the logical numbers of the nodes left empty are to be stored
+ *  \param p_nNodes pointer to a location where the number of nodes is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c ELDCININVAL, if the tree of extents describes more clusters than the arrays may hold
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails reading or writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+extern int soExtentTruncate (SOInode *p_inode, uint32_t clustInd, bool keep, uint32_t max, uint32_t *data,
+                             uint32_t *p_nData, uint32_t *nodes, uint32_t *p_nNodes);
+
+/**
+ *  \brief Synchronize the nodes of the tree of extents of a file.
+ *
+ *  \param p_inode pointer to the inode associated to the file
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails reading or writing
+ *  \return -<em>other specific error</em> issued by \e soSyncCacheCluster
+ */
+
+extern int soExtentSync (SOInode *p_inode);
+
+#endif /* SOFS_EXTENT_H_ */
@@ -0,0 +1,300 @@
+/**
+ *  \file sofs_freesummary.c (implementation file)
+ *
+ *  \brief Summary of the free data clusters of each block of the bitmap table.
+ *
+ *  The region of the summary is read and written directly on the storage device, bypassing the buffercache and the
+ *  journal, since it lies past the end of the file system proper.
+ *
+ *  The operations are:
+ *      \li build the summary of the mounted file system
+ *      \li store the summary and release it
+ *      \li get the number of free data clusters of a block of the bitmap table
+ *      \li account for a change of the bitmap table.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <errno.h>
+
+#include "sofs_probe.h"
+#include "sofs_const.h"
+#include "sofs_rawdisk.h"
+#include "sofs_buffercache.h"
+#include "sofs_superblock.h"
+#include "sofs_basicoper.h"
+#include "sofs_freesummary.h"
+
+/*
+ *  Internal data structure
+ */
+
+/** \brief number of blocks of the bitmap table described (zero, if the summary is not built) */
+static uint32_t nBlocks = 0;
+/** \brief number of free data clusters of each block of the bitmap table */
+static uint32_t *blkFree = NULL;
+/** \brief physical number of the block where the region of the summary starts (\c NULL_BLOCK, if there is none) */
+static uint32_t regionStart = NULL_BLOCK;
+/** \brief signals if the stored summary was already marked as not valid while the summary is not built */
+static bool invalidated = false;
+
+/* Allusion to internal functions */
+
+static int findRegion (SOSuperBlock *p_sb, SOFreeSummaryHeader *p_hdr, bool *p_found);
+static int readSummary (SOSuperBlock *p_sb, bool *p_ok);
+static int countSummary (SOSuperBlock *p_sb);
+static int writeHeader (uint32_t valid);
+
+/**
+ *  \brief Build the summary of the mounted file system.
+ *
+ *  The summary is read back from its region of the storage device, if there is one and it is valid, or counted in the
+ *  bitmap table, otherwise. The region is afterwards marked as not valid until the summary is stored again.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBUSY, if the summary is already built
+ *  \return -\c ENOMEM, if there is no memory for the summary
+ *  \return -<em>other specific error</em> issued by \e soLoadSuperBlock, \e soLoadBlockBMapT, \e soReadRawBlock,
+ *          \e soWriteRawBlock or \e soSyncRawBlocks
+ */
+
+int soOpenFreeSummary (void)
+{
+  soColorProbe (767, "07;31", "soOpenFreeSummary ()\n");
+
+  SOSuperBlock *p_sb;                            /* pointer to the superblock */
+  SOFreeSummaryHeader hdr;                       /* header of the region of the summary */
+  bool found, ok;                                /* signal if there is a region and if the summary was read back */
+  int stat;                                      /* status of operation */
+
+  soLockSuperBlock ();
+  if (nBlocks != 0)
+     { soUnlockSuperBlock ();
+       return -EBUSY;
+     }
+  if ((stat = soLoadSuperBlock ()) != 0)
+     { soUnlockSuperBlock ();
+       return stat;
+     }
+  p_sb = soGetSuperBlock ();
+  if ((blkFree = calloc (p_sb->fctable_size, sizeof (uint32_t))) == NULL)
+     { soUnlockSuperBlock ();
+       return -ENOMEM;
+     }
+
+  ok = false;
+  if (((stat = findRegion (p_sb, &hdr, &found)) == 0) && found && hdr.valid)
+     stat = readSummary (p_sb, &ok);
+  if ((stat == 0) && !ok)
+     stat = countSummary (p_sb);
+  regionStart = found ? FSUM_START (p_sb) : NULL_BLOCK;
+  if ((stat == 0) && found)
+     stat = writeHeader (0);                     /* the stored summary no longer describes the bitmap table */
+  if (stat == 0)
+     { nBlocks = p_sb->fctable_size;
+       invalidated = false;
+     }
+     else { free (blkFree);
+            blkFree = NULL;
+            regionStart = NULL_BLOCK;
+          }
+  soUnlockSuperBlock ();
+
+  return stat;
+}
+
+/**
+ *  \brief Store the summary and release it.
+ *
+ *  It is meant to be called after the last change of the bitmap table: the superblock and the bitmap table are
+ *  written back first, so that the summary stored describes them. Nothing is done if the summary is not built.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -<em>other specific error</em> issued by \e soSyncCacheBlock, \e soWriteRawBlock or \e soSyncRawBlocks
+ */
+
+int soCloseFreeSummary (void)
+{
+  soColorProbe (768, "07;31", "soCloseFreeSummary ()\n");
+
+  SOSuperBlock *p_sb;                            /* pointer to the superblock */
+  uint16_t blk[FSUM_PER_BLOCK];                  /* block of the region of the summary */
+  uint32_t nBlk, i;                              /* index of a block of the region and counting variable */
+  int stat;                                      /* status of operation */
+
+  soLockSuperBlock ();
+  if (nBlocks == 0)
+     { soUnlockSuperBlock ();
+       return 0;
+     }
+
+  stat = 0;
+  if ((regionStart != NULL_BLOCK) && ((stat = soLoadSuperBlock ()) == 0))
+     { p_sb = soGetSuperBlock ();
+       for (nBlk = 0; (stat == 0) && (nBlk < FSUM_SIZE (nBlocks) - 1); nBlk++)
+       { memset (blk, 0, sizeof (blk));
+         for (i = 0; (i < FSUM_PER_BLOCK) && (nBlk * FSUM_PER_BLOCK + i < nBlocks); i++)
+           blk[i] = (uint16_t) blkFree[nBlk * FSUM_PER_BLOCK + i];
+         stat = soWriteRawBlock (regionStart + 1 + nBlk, blk);
+       }
+       if (stat == 0)
+          stat = soSyncRawBlocks (regionStart + 1, FSUM_SIZE (nBlocks) - 1);
+       for (nBlk = 0; (stat == 0) && (nBlk < p_sb->fctable_size); nBlk++)
+         stat = soSyncCacheBlock (p_sb->fctable_start + nBlk);
+       if (stat == 0)
+          stat = soSyncCacheBlock (0);
+       if (stat == 0)
+          stat = writeHeader (1);
+     }
+  free (blkFree);
+  blkFree = NULL;
+  nBlocks = 0;
+  regionStart = NULL_BLOCK;
+  invalidated = false;
+  soUnlockSuperBlock ();
+
+  return stat;
+}
+
+/**
+ *  \brief Get the number of free data clusters of a block of the bitmap table.
+ *
+ *  \param nBlk index of the block in the bitmap table
+ *
+ *  \return the number of free data clusters whose references the block holds, or \c FSUM_UNKNOWN, if the summary is
+ *          not built or the index is out of range
+ */
+
+uint32_t soGetFreeSummary (uint32_t nBlk)
+{
+  return (nBlk < nBlocks) ? blkFree[nBlk] : FSUM_UNKNOWN;
+}
+
+/**
+ *  \brief Account for a change of the bitmap table.
+ *
+ *  If the summary is not built, the stored summary, if there is one, is marked as not valid the first time.
+ *
+ *  \param nClust logical number of the data cluster whose reference was inserted into, or removed from, the bitmap
+ *                table
+ *  \param delta +1, if it was inserted, or -1, if it was removed
+ */
+
+void soUpdateFreeSummary (uint32_t nClust, int delta)
+{
+  SOFreeSummaryHeader hdr;                       /* header of the region of the summary */
+  bool found;                                    /* signals if there is a region */
+
+  if (nBlocks != 0)
+     { if (nClust / BITS_PER_BLOCK < nBlocks)
+          blkFree[nClust / BITS_PER_BLOCK] += (uint32_t) delta;
+       return;
+     }
+
+  /* a failure is caught when the summary is next read back, since its numbers no longer add up */
+
+  if (invalidated) return;
+  invalidated = true;
+  if ((soLoadSuperBlock () == 0) && (findRegion (soGetSuperBlock (), &hdr, &found) == 0) && found && hdr.valid)
+     { regionStart = FSUM_START (soGetSuperBlock ());
+       writeHeader (0);
+       regionStart = NULL_BLOCK;
+     }
+}
+
+/*
+ *  Internal functions
+ */
+
+/*
+ *  Read the header of the region of the summary, if the storage device extends that far and it describes the bitmap
+ *  table (*p_found tells whether it does).
+ */
+
+static int findRegion (SOSuperBlock *p_sb, SOFreeSummaryHeader *p_hdr, bool *p_found)
+{
+  int stat;                                      /* status of operation */
+
+  *p_found = false;
+  if (p_sb->jnl_start != p_sb->ntotal) return 0;    /* the file system is older than the journal and the summary */
+  if ((stat = soReadRawBlock (FSUM_START (p_sb), p_hdr)) == -EINVAL) return 0;   /* past the end of the device */
+  if (stat != 0) return stat;
+  *p_found = (p_hdr->magic == FSUM_MAGIC) && (p_hdr->nblocks == p_sb->fctable_size);
+
+  return 0;
+}
+
+/*
+ *  Read back the stored summary and check it against the superblock: each number must fit its block and, together
+ *  with the references in the caches, they must add up to the number of free data clusters (*p_ok tells whether they
+ *  do).
+ */
+
+static int readSummary (SOSuperBlock *p_sb, bool *p_ok)
+{
+  uint16_t blk[FSUM_PER_BLOCK];                  /* block of the region of the summary */
+  uint32_t nBlk, i, n, nBits;                    /* indexes of the blocks and number of clusters of one */
+  uint64_t sum;                                  /* number of free data clusters of the summary */
+  int stat;                                      /* status of operation */
+
+  *p_ok = false;
+  sum = (DZONE_CACHE_SIZE - p_sb->dzone_retriev.cache_idx) + p_sb->dzone_insert.cache_idx;
+  for (nBlk = 0; nBlk < FSUM_SIZE (p_sb->fctable_size) - 1; nBlk++)
+  { if ((stat = soReadRawBlock (FSUM_START (p_sb) + 1 + nBlk, blk)) != 0) return stat;
+    for (i = 0; (i < FSUM_PER_BLOCK) && ((n = nBlk * FSUM_PER_BLOCK + i) < p_sb->fctable_size); i++)
+    { nBits = (p_sb->dzone_total - n * BITS_PER_BLOCK < BITS_PER_BLOCK) ? p_sb->dzone_total - n * BITS_PER_BLOCK
+                                                                        : BITS_PER_BLOCK;
+      if (blk[i] > nBits) return 0;
+      blkFree[n] = blk[i];
+      sum += blk[i];
+    }
+  }
+  *p_ok = (sum == p_sb->dzone_free);
+
+  return 0;
+}
+
+/*
+ *  Count the free data clusters of each block of the bitmap table (the clusters past the end of the data zone are
+ *  never free, so only whole bytes need to be counted).
+ */
+
+static int countSummary (SOSuperBlock *p_sb)
+{
+  unsigned char *fcBMapT;                        /* pointer to a block of the bitmap table */
+  uint32_t nBlk, nBits, i;                       /* index of a block, number of its clusters and counting variable */
+  int stat;                                      /* status of operation */
+
+  for (nBlk = 0; nBlk < p_sb->fctable_size; nBlk++)
+  { if ((stat = soLoadBlockBMapT (nBlk)) != 0) return stat;
+    if ((fcBMapT = soGetBlockBMapT ()) == NULL) return -ELIBBAD;
+    nBits = (p_sb->dzone_total - nBlk * BITS_PER_BLOCK < BITS_PER_BLOCK) ? p_sb->dzone_total - nBlk * BITS_PER_BLOCK
+                                                                         : BITS_PER_BLOCK;
+    blkFree[nBlk] = 0;
+    for (i = 0; i < (nBits + 7) / 8; i++)
+      blkFree[nBlk] += (uint32_t) __builtin_popcount (fcBMapT[i]);
+  }
+
+  return 0;
+}
+
+/*
+ *  Write and synchronize the header of the region of the summary.
+ */
+
+static int writeHeader (uint32_t valid)
+{
+  SOFreeSummaryHeader hdr;                       /* header of the region of the summary */
+  int stat;                                      /* status of operation */
+
+  memset (&hdr, 0, sizeof (hdr));
+  hdr.magic = FSUM_MAGIC;
+  hdr.valid = valid;
+  hdr.nblocks = (nBlocks != 0) ? nBlocks : soGetSuperBlock ()->fctable_size;
+  if ((stat = soWriteRawBlock (regionStart, &hdr)) != 0) return stat;
+
+  return soSyncRawBlocks (regionStart, 1);
+}
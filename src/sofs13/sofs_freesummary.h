@@ -0,0 +1,118 @@
+/**
+ *  \file sofs_freesummary.h (interface file)
+ *
+ *  \brief Summary of the free data clusters of each block of the bitmap table.
+ *
+ *  The summary keeps, for each block of the bitmap table to free data clusters, the number of free clusters whose
+ *  references it holds, so that the blocks which hold none are skipped when the retrieval cache is replenished, or a
+ *  reservation is drawn, without reading them, and the allocation groups know how many free clusters each one has.
+ *  It is built when the file system is mounted and kept up to date, in memory, by the operations which insert
+ *  references into, or remove them from, the bitmap table.
+ *
+ *  The formatting tool may lay out a region of the storage device, past the end of the file system proper and of the
+ *  journal, where the summary is stored when the file system is unmounted, so that it is read back, instead of being
+ *  counted in the whole bitmap table, the next time the file system is mounted. A header marks the stored summary as
+ *  valid only from the moment it is written until the file system is mounted again: after an unclean shutdown, or if
+ *  the bitmap table was changed meanwhile by a program which does not keep the summary, it is counted again. The sum
+ *  of the numbers read back is checked against the number of free data clusters of the superblock, which only takes
+ *  reading the region, as large as a block for every \c FSUM_PER_BLOCK blocks of the bitmap table.
+ *
+ *  All operations, but opening and closing the summary, are supposed to be called with the lock of the superblock held.
+ *
+ *  The operations are:
+ *      \li build the summary of the mounted file system
+ *      \li store the summary and release it
+ *      \li get the number of free data clusters of a block of the bitmap table
+ *      \li account for a change of the bitmap table.
+ *
+ *  \remarks In case an error occurs, all functions return a negative value which is the symmetric of the system error
+ *           that better represents the error cause.
+ *           (execute command <em>man errno</em> to get the list of system errors)
+ */
+
+#ifndef SOFS_FREESUMMARY_H_
+#define SOFS_FREESUMMARY_H_
+
+#include <stdint.h>
+
+#include "sofs_const.h"
+#include "sofs_superblock.h"
+
+/** \brief magic number of the header of the region of the summary */
+#define FSUM_MAGIC      (0x46534D13)
+/** \brief number of blocks of the bitmap table described by a block of the region of the summary */
+#define FSUM_PER_BLOCK  (BLOCK_SIZE / sizeof (uint16_t))
+/** \brief number of blocks of the region of the summary of a bitmap table of n blocks (the header and the numbers) */
+#define FSUM_SIZE(n)    (1 + ((n) + FSUM_PER_BLOCK - 1) / FSUM_PER_BLOCK)
+/** \brief physical number of the block where the region of the summary starts, right past the journal */
+#define FSUM_START(p_sb) ((p_sb)->ntotal + (((p_sb)->jnl_start != (p_sb)->ntotal) ? 0 : (p_sb)->jnl_size))
+/** \brief value returned for the number of free data clusters of a block when the summary is not built */
+#define FSUM_UNKNOWN    (UINT32_MAX)
+
+/**
+ *  \brief Definition of the header of the region of the summary (its first block).
+ */
+
+typedef struct soFreeSummaryHeader
+{
+   /** \brief magic number (should be FSUM_MAGIC macro value) */
+    uint32_t magic;
+   /** \brief signals if the numbers stored in the region describe the bitmap table */
+    uint32_t valid;
+   /** \brief number of blocks of the bitmap table described */
+    uint32_t nblocks;
+   /** \brief reserved area */
+    unsigned char reserved[BLOCK_SIZE - 3 * sizeof (uint32_t)];
+} SOFreeSummaryHeader;
+
+/**
+ *  \brief Build the summary of the mounted file system.
+ *
+ *  The summary is read back from its region of the storage device, if there is one and it is valid, or counted in the
+ *  bitmap table, otherwise. The region is afterwards marked as not valid until the summary is stored again.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBUSY, if the summary is already built
+ *  \return -\c ENOMEM, if there is no memory for the summary
+ *  \return -<em>other specific error</em> issued by \e soLoadSuperBlock, \e soLoadBlockBMapT, \e soReadRawBlock,
+ *          \e soWriteRawBlock or \e soSyncRawBlocks
+ */
+
+extern int soOpenFreeSummary (void);
+
+/**
+ *  \brief Store the summary and release it.
+ *
+ *  It is meant to be called after the last change of the bitmap table: the superblock and the bitmap table are
+ *  written back first, so that the summary stored describes them. Nothing is done if the summary is not built.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -<em>other specific error</em> issued by \e soSyncCacheBlock, \e soWriteRawBlock or \e soSyncRawBlocks
+ */
+
+extern int soCloseFreeSummary (void);
+
+/**
+ *  \brief Get the number of free data clusters of a block of the bitmap table.
+ *
+ *  \param nBlk index of the block in the bitmap table
+ *
+ *  \return the number of free data clusters whose references the block holds, or \c FSUM_UNKNOWN, if the summary is
+ *          not built or the index is out of range
+ */
+
+extern uint32_t soGetFreeSummary (uint32_t nBlk);
+
+/**
+ *  \brief Account for a change of the bitmap table.
+ *
+ *  If the summary is not built, the stored summary, if there is one, is marked as not valid the first time.
+ *
+ *  \param nClust logical number of the data cluster whose reference was inserted into, or removed from, the bitmap
+ *                table
+ *  \param delta +1, if it was inserted, or -1, if it was removed
+ */
+
+extern void soUpdateFreeSummary (uint32_t nClust, int delta);
+
+#endif /* SOFS_FREESUMMARY_H_ */
@@ -8,9 +8,12 @@
  *
  *  The operations are:
  *      \li allocate a free inode
+ *      \li allocate a free inode near a given one
  *      \li free the referenced inode
  *      \li allocate a free data cluster
- *      \li free the referenced data cluster.
+ *      \li allocate a group of free data clusters, laid out contiguously whenever possible
+ *      \li free the referenced data cluster
+ *      \li free a group of data clusters.
  *
  *  \author Artur Carneiro Pereira September 2008
  *  \author Miguel Oliveira e Silva September 2009
@@ -33,12 +36,14 @@
  *  first.
  *
  *  Upon initialization, the new inode has:
- *     \li the field mode set to the given type, while the free flag and the permissions are reset
+ *     \li the field mode set to the given type, while the free flag and the permissions are reset (a regular file is
+ *         described by a tree of extents, if it is enabled, and the contents of a regular file or of a symbolic link
+ *         are stored in the inode, if it is so set)
  *     \li the owner and group fields set to current userid and groupid
  *     \li the <em>prev</em> and <em>next</em> fields, pointers in the double-linked list of free inodes, change their
  *         meaning: they are replaced by the <em>time of last file modification</em> and <em>time of last file
  *         access</em> which are set to current time
- *     \li the reference fields set to NULL_CLUSTER
+ *     \li the reference fields set to NULL_CLUSTER (or zeroed, if the contents are stored in the inode)
  *     \li all other fields reset.
 
  *  \param type the inode type (it must represent either a regular file, or a directory, or a symbolic link)
@@ -58,6 +63,32 @@
 
 extern int soAllocInode (uint32_t type, uint32_t* p_nInode);
 
+/**
+ *  \brief Allocate a free inode near a given one.
+ *
+ *  The inode is the free inode nearest to the given one in the table of inodes, found by the index of the free
+ *  inodes, which is taken out of the list of free inodes wherever it lies; if the index is not built, or there is no
+ *  free inode near the given one, it is retrieved from the list as in <em>soAllocInode</em>. It is initialized in the
+ *  same way.
+ *
+ *  \param type the inode type (it must represent either a regular file, or a directory, or a symbolic link)
+ *  \param nInodeNear number of the inode the new one should be near, usually the one of its parent directory
+ *  \param p_nInode pointer to the location where the number of the just allocated inode is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>type</em> is illegal or the <em>pointer to inode number</em> is \c NULL
+ *  \return -\c ENOSPC, if the list of free inodes is empty
+ *  \return -\c ESBTINPINVAL, if the table of inodes metadata in the superblock is inconsistent
+ *  \return -\c ETINDLLINVAL, if the double-linked list of free inodes is inconsistent
+ *  \return -\c EFININVAL, if a free inode is inconsistent
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails reading or writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+extern int soAllocInodeNear (uint32_t type, uint32_t nInodeNear, uint32_t* p_nInode);
+
 /**
  *  \brief Free the referenced inode.
  *
@@ -68,6 +99,8 @@ extern int soAllocInode (uint32_t type, uint32_t* p_nInode);
  *
  *  The only affected fields are:
  *     \li the free flag of mode field, which is set
+ *     \li the reference fields, which are set to NULL_CLUSTER together with the format flags of the mode field being
+ *         reset, if the contents of the file were stored in the inode
  *     \li the <em>time of last file modification</em> and <em>time of last file access</em> fields, which change their
  *         meaning: they are replaced by the <em>prev</em> and <em>next</em> pointers in the double-linked list of free
  *         inodes.
@@ -113,6 +146,39 @@ extern int soFreeInode (uint32_t nInode);
 
 extern int soAllocDataCluster (uint32_t *p_nClust);
 
+/**
+ *  \brief Allocate a group of free data clusters, laid out contiguously whenever possible.
+ *
+ *  The clusters are preferably the ones that immediately follow the cluster <tt>hint</tt>, usually the last data
+ *  cluster that was allocated to the same file. Those which are not free are replaced by the first free clusters
+ *  found in the bitmap table to free data clusters from that point onwards, so that the group is made of as few
+ *  contiguous runs as possible. The clusters may also be taken from the retrieval cache; when there is no hint, or the
+ *  bitmap table has no free clusters left, they are retrieved from it as in <em>soAllocDataCluster</em>. The data
+ *  clusters in the dirty state are cleaned first.
+ *
+ *  Either all the clusters are allocated, or none is.
+ *
+ *  \param hint logical number of the data cluster the group should follow (\c NULL_CLUSTER, if there is none)
+ *  \param count number of data clusters to be allocated
+ *  \param nClust pointer to the array where the logical numbers of the allocated data clusters are to be stored, in the
+ *                order they should be used
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>pointer to the array</em> is \c NULL, <tt>count</tt> is zero or the <em>hint</em> is
+ *                      out of range
+ *  \return -\c ENOSPC, if there are not enough free data clusters
+ *  \return -\c ESBDZINVAL, if the data zone metadata in the superblock is inconsistent
+ *  \return -\c ESBFCCINVAL, if the free data clusters caches in the superblock are inconsistent
+ *  \return -\c EFCTINVAL, if the number of free data clusters is overall inconsistent
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EDCMINVAL, if the mapping association of the data cluster is invalid
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails reading or writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+extern int soAllocDataClusters (uint32_t hint, uint32_t count, uint32_t *nClust);
+
 /**
  *  \brief Free the referenced data cluster.
  *
@@ -138,4 +204,32 @@ extern int soAllocDataCluster (uint32_t *p_nClust);
 
 extern int soFreeDataCluster (uint32_t nClust);
 
+/**
+ *  \brief Free a group of data clusters.
+ *
+ *  The clusters are sorted and returned straight to the bitmap table to free data clusters, bypassing the insertion
+ *  cache: each block of the table is loaded and stored only once and the superblock is stored at the end. Like in
+ *  <em>soFreeDataCluster</em>, they must have been previously allocated (which means that although free, they will be
+ *  in the dirty state, unless their mapping association was previously removed).
+ *
+ *  Either all the clusters are freed, or none is.
+ *
+ *  \param count number of data clusters
+ *  \param nClust pointer to the array of the logical numbers of the data clusters (it is sorted in place)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>pointer to the array</em> is \c NULL or any <em>data cluster number</em> is out of
+ *                      range
+ *  \return -\c EDCNALINVAL, if any data cluster has not been previously allocated, or it appears twice
+ *  \return -\c ESBDZINVAL, if the data zone metadata in the superblock is inconsistent
+ *  \return -\c ESBFCCINVAL, if the free data clusters caches in the superblock are inconsistent
+ *  \return -\c EFCTINVAL, if the number of free data clusters is overall inconsistent
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails reading or writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+extern int soFreeDataClusters (uint32_t count, uint32_t *nClust);
+
 #endif /* SOFS_IFUNCS_1_H_ */
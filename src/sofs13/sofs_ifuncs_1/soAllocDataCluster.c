@@ -19,11 +19,24 @@
 #include "sofs_datacluster.h"
 #include "sofs_basicoper.h"
 #include "sofs_basicconsist.h"
+#include "sofs_ifuncs_1.h"
+#include "sofs_ifuncs_3.h"
+#include "sofs_allocgroup.h"
+#include "sofs_freesummary.h"
 
 /* Allusion to internal functions */
 
 int soReplenish (SOSuperBlock *p_sb);
 int soDeplete (SOSuperBlock *p_sb);
+static int allocDataCluster (uint32_t *p_nClust);
+static int allocDataClusters (uint32_t hint, uint32_t count, uint32_t *nClust);
+static int takeCluster (SOSuperBlock *p_sb, uint32_t nClust, bool *p_taken);
+static int takeRun (SOSuperBlock *p_sb, uint32_t start, uint32_t *nClust, uint32_t count, uint32_t *p_n);
+static int findFreeWord (uint32_t start, uint32_t end, uint32_t *p_ref);
+static int takeFreeClusters (uint32_t start, uint32_t end, uint32_t *dest, uint32_t size, uint32_t *p_n,
+                             uint32_t *p_pos);
+static int cleanIfDirty (uint32_t nClust);
+static int reserveClusters (SOSuperBlock *p_sb);
 
 /**
  *  \brief Allocate a free data cluster.
@@ -32,6 +45,9 @@ int soDeplete (SOSuperBlock *p_sb);
  *  be replenished before the retrieval may take place.  If the data cluster is in the dirty state, it has to be cleaned
  *  first.
  *
+ *  When the allocation groups are open, the cluster is taken instead from the reservation of the calling thread,
+ *  without the lock of the superblock, and the reservation is drawn again from the bitmap table when it is empty.
+ *
  *  \param p_nClust pointer to the location where the logical number of the allocated data cluster is to be stored
  *
  *  \return <tt>0 (zero)</tt>, on success
@@ -49,21 +65,32 @@ int soDeplete (SOSuperBlock *p_sb);
 int soAllocDataCluster (uint32_t *p_nClust)
 {
 	soColorProbe (613, "07;33", "soAllocDataCluster (%p)\n", p_nClust);
-  
-	int err;
-	SOSuperBlock *p_sb;
-  
-	uint32_t *cTInT;
-	/* pointer to the location where the contents
-	of a block of the mapping table cluster to inode is to be stored */
-	uint32_t nBlk;
-	/* logic block number of the mapping
-	table cluster to inode */
-	uint32_t off;
-	/* offset within a block of the mapping
-	table cluster to inode */
 
+	int stat;
+	uint32_t n = 0;
 
+	/*first from the reserve of the thread, without the lock of the superblock*/
+	if(p_nClust != NULL)
+	{
+		soTakeReserved(NULL_CLUSTER, false, 1, p_nClust, &n);
+		if(n == 1)
+			return 0;
+	}
+
+	soLockSuperBlock();
+	stat = allocDataCluster(p_nClust);
+	soUnlockSuperBlock();
+
+	return stat;
+}
+
+/* Implementation of soAllocDataCluster (the caller holds the lock of the superblock). */
+
+static int allocDataCluster (uint32_t *p_nClust)
+{
+	int err;
+	SOSuperBlock *p_sb;
+	uint32_t n;
 
 	/*Ponteiro para o SuperBlock*/
 	if((err = soLoadSuperBlock()) != 0)
@@ -74,7 +101,9 @@ int soAllocDataCluster (uint32_t *p_nClust)
 	if(p_sb == NULL)
 		return -EINVAL;
 		
-	/*Verifica se não há data clusters livres*/
+	/*Check if there are no free data clusters, once the reserves of the threads are given back*/
+	if((p_sb->dzone_free == 0) && ((err = soReclaimReserved(p_sb)) != 0))
+		return err;
 	if(p_sb->dzone_free == 0)
 		return -ENOSPC;
 
@@ -85,6 +114,18 @@ int soAllocDataCluster (uint32_t *p_nClust)
 	/*Verifica os erros ESBDZINVAL, ESBFCCINVAL, EFCTINVAL, EBADF, EIO e ELIBBAD */
 	if((err = soQCheckDZ(p_sb)) != 0)
 		return err;
+
+	/*With allocation groups, the reserve of the thread is refilled from the bitmap, if it is empty*/
+	n = 0;
+	soTakeReserved(NULL_CLUSTER, false, 1, p_nClust, &n);
+	if(n == 0)
+	{
+		if((err = reserveClusters(p_sb)) != 0)
+			return err;
+		soTakeReserved(NULL_CLUSTER, false, 1, p_nClust, &n);
+	}
+	if(n == 1)
+		return 0;
 		
 	/*Se a cache estiver vazia executa a função replenish*/
 	if(p_sb->dzone_retriev.cache_idx == DZONE_CACHE_SIZE)
@@ -95,15 +136,8 @@ int soAllocDataCluster (uint32_t *p_nClust)
 	/*Aloca o data cluster*/
 	*p_nClust = p_sb->dzone_retriev.cache[p_sb->dzone_retriev.cache_idx];
 
-	if ((err = soConvertRefCInMT (*p_nClust, &nBlk, &off)) != 0)
+	if ((err = cleanIfDirty (*p_nClust)) != 0)
 		return err;
-	if ((err = soLoadBlockCTInMT (nBlk)) != 0) return err;
-		cTInT = soGetBlockCTInMT ();
-	if (cTInT[off] != NULL_INODE) /* check if the data cluster is dirty */
-	{ /* it is, clean it */
-		if ((err = soCleanDataCluster (cTInT[off], *p_nClust)) != 0)
-			return err;
-	}
 
 	p_sb->dzone_retriev.cache[p_sb->dzone_retriev.cache_idx] = NULL_CLUSTER;
 	p_sb->dzone_retriev.cache_idx++;
@@ -117,6 +151,153 @@ int soAllocDataCluster (uint32_t *p_nClust)
 	return 0;
 }
 
+/**
+ *  \brief Allocate a group of free data clusters, laid out contiguously whenever possible.
+ *
+ *  The clusters are preferably the ones that immediately follow the cluster <tt>hint</tt>, usually the last data
+ *  cluster that was allocated to the same file. Those which are not free are replaced by the first free clusters
+ *  found in the bitmap table to free data clusters from that point onwards, so that the group is made of as few
+ *  contiguous runs as possible. The clusters may also be taken from the retrieval cache; when there is no hint, or the
+ *  bitmap table has no free clusters left, they are retrieved from it as in <em>soAllocDataCluster</em>. The data
+ *  clusters in the dirty state are cleaned first.
+ *
+ *  When the allocation groups are open, the clusters that follow the hint are first taken from the reservation of the
+ *  calling thread, without the lock of the superblock, and the search is kept within the group of the hint before it
+ *  goes on through the whole bitmap table.
+ *
+ *  Either all the clusters are allocated, or none is.
+ *
+ *  \param hint logical number of the data cluster the group should follow (\c NULL_CLUSTER, if there is none)
+ *  \param count number of data clusters to be allocated
+ *  \param nClust pointer to the array where the logical numbers of the allocated data clusters are to be stored, in the
+ *                order they should be used
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>pointer to the array</em> is \c NULL, <tt>count</tt> is zero or the <em>hint</em> is
+ *                      out of range
+ *  \return -\c ENOSPC, if there are not enough free data clusters
+ *  \return -\c ESBDZINVAL, if the data zone metadata in the superblock is inconsistent
+ *  \return -\c ESBFCCINVAL, if the free data clusters caches in the superblock are inconsistent
+ *  \return -\c EFCTINVAL, if the number of free data clusters is overall inconsistent
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EDCMINVAL, if the mapping association of the data cluster is invalid
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails reading or writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soAllocDataClusters (uint32_t hint, uint32_t count, uint32_t *nClust)
+{
+	soColorProbe (615, "07;33", "soAllocDataClusters (%"PRIu32", %"PRIu32", %p)\n", hint, count, nClust);
+
+	int stat;
+	uint32_t n = 0;
+
+	/*first those following the reference one in the reserve of the thread, without the lock of the superblock*/
+	if((nClust != NULL) && (count != 0))
+	{
+		soTakeReserved(hint, false, count, nClust, &n);
+		if(n == count)
+			return 0;
+	}
+
+	soLockSuperBlock();
+	stat = allocDataClusters((n > 0) ? nClust[n-1] : hint, count - n, nClust + n);
+	soUnlockSuperBlock();
+
+	/*if the remaining ones can not be allocated, those taken from the reserve are freed*/
+	if((stat != 0) && (n > 0))
+		soFreeDataClusters(n, nClust);
+
+	return stat;
+}
+
+/* Implementation of soAllocDataClusters (the caller holds the lock of the superblock). */
+
+static int allocDataClusters (uint32_t hint, uint32_t count, uint32_t *nClust)
+{
+	int stat;
+	SOSuperBlock *p_sb;
+	uint32_t n, res, start, end, pos, i;
+
+	if((stat = soLoadSuperBlock()) != 0)
+		return stat;
+	if((p_sb = soGetSuperBlock()) == NULL)
+		return -ELIBBAD;
+
+	if((nClust == NULL) || (count == 0))
+		return -EINVAL;
+	if((hint != NULL_CLUSTER) && (hint >= p_sb->dzone_total))
+		return -EINVAL;
+
+	/*Check if there are enough free data clusters, once the reserves of the threads are given back*/
+	if((p_sb->dzone_free < count) && ((stat = soReclaimReserved(p_sb)) != 0))
+		return stat;
+	if(p_sb->dzone_free < count)
+		return -ENOSPC;
+
+	if((stat = soQCheckDZ(p_sb)) != 0)
+		return stat;
+
+	n = 0;
+	if(hint != NULL_CLUSTER)
+	{
+		/*the clusters following the reference one, while they are free*/
+		start = (hint + 1) % p_sb->dzone_total;
+		if((stat = takeRun(p_sb, start, nClust, count, &n)) != 0)
+			return stat;
+
+		/*with allocation groups, the reserve of the thread, if it belongs to the group of the reference one, and then
+		  a fully free word of the group, so that the file stays in it*/
+		res = n;
+		if(n < count)
+			soTakeReserved(hint, true, count, nClust, &n);
+		res = n - res;
+		if((n < count) && soGetGroupRange(hint, &start, &end))
+		{
+			if((stat = findFreeWord(start, end, &pos)) != 0)
+				return stat;
+			if((pos != NULL_CLUSTER) && ((stat = takeRun(p_sb, pos, nClust, count, &n)) != 0))
+				return stat;
+		}
+		start = (hint + 1) % p_sb->dzone_total;
+
+		/*otherwise, the start of a fully free word of the bitmap, so that the file may grow apart from
+		  the others*/
+		if(n < count)
+		{
+			if((stat = findFreeWord(start, p_sb->dzone_total, &pos)) != 0)
+				return stat;
+			if((pos == NULL_CLUSTER) && ((stat = findFreeWord(0, start, &pos)) != 0))
+				return stat;
+			if((pos != NULL_CLUSTER) && ((stat = takeRun(p_sb, pos, nClust, count, &n)) != 0))
+				return stat;
+		}
+
+		/*the remaining ones are the first free ones in the bitmap from there on, wrapping around once*/
+		if((n < count) && ((stat = takeFreeClusters(start, p_sb->dzone_total, nClust, count, &n, &pos)) != 0))
+			return stat;
+		if((n < count) && ((stat = takeFreeClusters(0, start, nClust, count, &n, &pos)) != 0))
+			return stat;
+
+		/*the clusters taken from the bitmap (or from the retrieval cache) are cleaned, if they are dirty; those of
+		  the reserve already were and no longer count as free*/
+		for(i = 0; i < n; i++)
+			if((stat = cleanIfDirty(nClust[i])) != 0)
+				return stat;
+		p_sb->dzone_free -= n - res;
+		if((stat = soStoreSuperBlock()) != 0)
+			return stat;
+	}
+
+	/*those still missing come from the retrieval cache*/
+	for(; n < count; n++)
+		if((stat = allocDataCluster(&nClust[n])) != 0)
+			return stat;
+
+	return 0;
+}
+
 /**
  *  \brief Replenish the retrieval cache of references to free data clusters.
  *
@@ -131,56 +312,292 @@ int soAllocDataCluster (uint32_t *p_nClust)
 
 int soReplenish (SOSuperBlock *p_sb)
 {   
-
-                     /* insert your code here */
-    	uint32_t nclustt = (p_sb->dzone_free < DZONE_CACHE_SIZE) ? p_sb->dzone_free : DZONE_CACHE_SIZE;
+	uint32_t nclustt = (p_sb->dzone_free < DZONE_CACHE_SIZE) ? p_sb->dzone_free : DZONE_CACHE_SIZE;
 	uint32_t pos = p_sb->fctable_pos;
-	uint32_t nByte,nBit,nBlk,mask;
-	int n = DZONE_CACHE_SIZE - nclustt;
+	uint32_t n = DZONE_CACHE_SIZE - nclustt;
+	int stat;
+
+	/* scan the bitmap table from the current position, wrapping around once */
+	if((stat = takeFreeClusters(pos, p_sb->dzone_total, p_sb->dzone_retriev.cache, DZONE_CACHE_SIZE, &n, &pos)) != 0)
+		return stat;
+	if((n < DZONE_CACHE_SIZE) && (p_sb->fctable_pos != 0))
+	{
+		if((stat = takeFreeClusters(0, p_sb->fctable_pos, p_sb->dzone_retriev.cache, DZONE_CACHE_SIZE, &n, &pos)) != 0)
+			return stat;
+	}
+
+	/* there are not enough free clusters in the table: deplete the insertion cache and scan it again */
+	if(n != DZONE_CACHE_SIZE){
+		if((stat = soDeplete(p_sb)) != 0)
+			return stat;
+		pos %= p_sb->dzone_total;
+		if((stat = takeFreeClusters(pos, p_sb->dzone_total, p_sb->dzone_retriev.cache, DZONE_CACHE_SIZE, &n, &pos)) != 0)
+			return stat;
+		if(n < DZONE_CACHE_SIZE)
+		{
+			if((stat = takeFreeClusters(0, pos, p_sb->dzone_retriev.cache, DZONE_CACHE_SIZE, &n, &pos)) != 0)
+				return stat;
+		}
+		if(n != DZONE_CACHE_SIZE)
+			return -ELIBBAD;
+	}
+	p_sb->dzone_retriev.cache_idx = DZONE_CACHE_SIZE - nclustt;
+	p_sb->fctable_pos = pos % p_sb->dzone_total;
+
+  return 0;
+}
+
+/*
+ *  Take the data cluster nClust, if it is free and either its reference is in the bitmap table to free data clusters or
+ *  in the retrieval cache (*p_taken tells whether it was).
+ */
+
+static int takeCluster (SOSuperBlock *p_sb, uint32_t nClust, bool *p_taken)
+{
+	uint32_t nBlk, nByte, nBit, i;
+	unsigned char *fcBMapT;
+	int stat;
+
+	*p_taken = false;
+
+	/* in the bitmap */
+	if((stat = soConvertRefBMapT(nClust, &nBlk, &nByte, &nBit)) != 0)
+		return stat;
+	if((stat = soLoadBlockBMapT(nBlk)) != 0)
+		return stat;
+	if((fcBMapT = soGetBlockBMapT()) == NULL)
+		return -EIO;
+	if(fcBMapT[nByte] & (0x80 >> nBit))
+	{
+		fcBMapT[nByte] &= ~(0x80 >> nBit);
+		soUpdateFreeSummary(nClust, -1);
+		*p_taken = true;
+		return soStoreBlockBMapT();
+	}
+
+	/* in the retrieval cache: it is swapped with the first reference of the cache, which is then retrieved */
+	for(i = p_sb->dzone_retriev.cache_idx; i < DZONE_CACHE_SIZE; i++)
+		if(p_sb->dzone_retriev.cache[i] == nClust)
+		{
+			p_sb->dzone_retriev.cache[i] = p_sb->dzone_retriev.cache[p_sb->dzone_retriev.cache_idx];
+			p_sb->dzone_retriev.cache[p_sb->dzone_retriev.cache_idx] = NULL_CLUSTER;
+			p_sb->dzone_retriev.cache_idx++;
+			*p_taken = true;
+			break;
+		}
+
+	return 0;
+}
+
+/*
+ *  Take the free data clusters that follow nClust[*p_n - 1], starting at cluster start, and store them in the array
+ *  nClust, while they are free and the array is not full.
+ */
+
+static int takeRun (SOSuperBlock *p_sb, uint32_t start, uint32_t *nClust, uint32_t count, uint32_t *p_n)
+{
+	bool taken;
 	int stat;
-	unsigned char* fcBMapT;
 
-	do{
-		soConvertRefBMapT(pos,&nBlk,&nByte,&nBit);
+	for(; (*p_n < count) && (start < p_sb->dzone_total); start++)
+	{
+		if((stat = takeCluster(p_sb, start, &taken)) != 0)
+			return stat;
+		if(!taken)
+			break;
+		nClust[*p_n] = start;
+		*p_n += 1;
+	}
+
+	return 0;
+}
+
+/*
+ *  Find the first 64 bit word of the bitmap table to free data clusters which lies within [start, end) and whose
+ *  clusters are all free, and store the reference of its first cluster in *p_ref (NULL_CLUSTER, if there is none).
+ *  The blocks which the summary of the free data clusters tells to have fewer than 64 free clusters are skipped.
+ */
+
+static int findFreeWord (uint32_t start, uint32_t end, uint32_t *p_ref)
+{
+	const uint32_t bitsPerBlk = 8 * BLOCK_SIZE;
+	uint32_t nBlk, blkStart, ref;
+	unsigned char *fcBMapT;
+	int stat, i;
+
+	*p_ref = NULL_CLUSTER;
+	ref = (start + 63) & ~63u;
+	while(ref + 64 <= end)
+	{
+		nBlk = ref / bitsPerBlk;
+		blkStart = nBlk * bitsPerBlk;
+
+		/* blocks with fewer than 64 free clusters, according to the summary, are not read */
+		if(soGetFreeSummary(nBlk) < 64)
+		{
+			ref = blkStart + bitsPerBlk;
+			continue;
+		}
 		if((stat = soLoadBlockBMapT(nBlk)) != 0)
 			return stat;
 		if((fcBMapT = soGetBlockBMapT()) == NULL)
 			return -EIO;
-		mask = 0x80 >> nBit;
-       		if((fcBMapT[nByte]& mask) == mask){
-		    	p_sb->dzone_retriev.cache[n] = pos;
-			fcBMapT[nByte] &= ~mask;
-			n++;
+		for(; (ref + 64 <= end) && (ref < blkStart + bitsPerBlk); ref += 64)
+		{
+			for(i = 0; (i < 8) && (fcBMapT[(ref - blkStart) / 8 + i] == 0xFF); i++)
+				;
+			if(i == 8)
+			{
+				*p_ref = ref;
+				return 0;
+			}
 		}
-		pos = (pos + 1) % p_sb->dzone_total;
-		if ((stat = soStoreBlockBMapT()) != 0) 
+	}
+
+	return 0;
+}
+
+/*
+ *  Move free data clusters whose references lie in [start, end) from the bitmap table to free data clusters to the
+ *  array dest, whose size is size, starting at position *p_n of the array, until it is full.
+ *  The table is examined 64 bits at a time (the most significant bit of each byte stands for the lowest reference) and
+ *  each block is loaded and stored only once, the blocks which the summary of the free data clusters tells to have none
+ *  being skipped. The position that follows the last reference examined is stored in
+ *  *p_pos.
+ */
+
+static int takeFreeClusters (uint32_t start, uint32_t end, uint32_t *dest, uint32_t size, uint32_t *p_n,
+                             uint32_t *p_pos)
+{
+	const uint32_t bitsPerBlk = 8 * BLOCK_SIZE;
+	uint32_t nBlk, blkStart, blkEnd, w, ref, first, last, bit;
+	uint64_t word, mask;
+	unsigned char *fcBMapT;
+	bool changed;
+	int stat, i;
+
+	*p_pos = start;
+	while((start < end) && (*p_n < size))
+	{
+		nBlk = start / bitsPerBlk;
+		blkStart = nBlk * bitsPerBlk;
+		blkEnd = (end < blkStart + bitsPerBlk) ? end : blkStart + bitsPerBlk;
+
+		/* blocks with no free clusters, according to the summary, are not read */
+		if(soGetFreeSummary(nBlk) == 0)
+		{
+			*p_pos = blkEnd;
+			start = blkEnd;
+			continue;
+		}
+
+		/* each block is read only once */
+		if((stat = soLoadBlockBMapT(nBlk)) != 0)
 			return stat;
-	}while((n < DZONE_CACHE_SIZE) && (pos != p_sb->fctable_pos));
+		if((fcBMapT = soGetBlockBMapT()) == NULL)
+			return -EIO;
+		changed = false;
 
-	if(n!= DZONE_CACHE_SIZE){
-		soDeplete(p_sb);
-		do{
-			soConvertRefBMapT(pos,&nBlk,&nByte,&nBit);
-			if((stat = soLoadBlockBMapT(nByte)) != 0)
-				return stat;
-			if((fcBMapT = soGetBlockBMapT()) == NULL)
-				return -EIO;
-			mask = 0x80 >> nBit;
-
-			if((fcBMapT[nByte] & mask) == mask){
-				p_sb->dzone_retriev.cache[n] = pos;
-				fcBMapT[nByte] &= ~mask;
-				n++;
+		for(w = (start - blkStart) / 64; (blkStart + 64 * w < blkEnd) && (*p_n < size); w++)
+		{
+			/* 64-bit word, with the lowest reference in the most significant bit */
+			for(i = 0, word = 0; i < 8; i++)
+				word = (word << 8) | fcBMapT[8 * w + i];
+
+			/* so interessam as referencias em [start, blkEnd) */
+			ref = blkStart + 64 * w;
+			first = (start > ref) ? start - ref : 0;
+			last = (blkEnd - ref < 64) ? blkEnd - ref : 64;
+			mask = (~(uint64_t) 0 >> first) & ((last == 64) ? ~(uint64_t) 0 : ~(~(uint64_t) 0 >> last));
+			word &= mask;
+
+			/* words with no free clusters are skipped */
+			while((word != 0) && (*p_n < size))
+			{
+				bit = __builtin_clzll(word);
+				word &= ~((uint64_t) 1 << (63 - bit));
+				dest[*p_n] = ref + bit;
+				fcBMapT[8 * w + bit / 8] &= ~(0x80 >> (bit % 8));
+				soUpdateFreeSummary(ref + bit, -1);
+				*p_n += 1;
+				*p_pos = ref + bit + 1;
+				changed = true;
 			}
-			pos = (pos+1) % p_sb->dzone_total;
-			if ((stat = soStoreBlockBMapT()) != 0) 
-				return stat;
-		}while(n < DZONE_CACHE_SIZE);
+			if(*p_n < size)
+				*p_pos = ref + last;
+		}
+
+		/* it is written only once, if it was changed */
+		if(changed && ((stat = soStoreBlockBMapT()) != 0))
+			return stat;
+		start = blkEnd;
 	}
-	p_sb->dzone_retriev.cache_idx = DZONE_CACHE_SIZE - nclustt;
-	p_sb->fctable_pos = pos;
 
+	return 0;
+}
 
+/*
+ *  Clean the data cluster nClust, if it is in the dirty state.
+ */
 
-  return 0;
+static int cleanIfDirty (uint32_t nClust)
+{
+	uint32_t *cTInT;
+	/* pointer to the location where the contents
+	of a block of the mapping table cluster to inode is to be stored */
+	uint32_t nBlk;
+	/* logic block number of the mapping
+	table cluster to inode */
+	uint32_t off;
+	/* offset within a block of the mapping
+	table cluster to inode */
+	int err;
+
+	if ((err = soConvertRefCInMT (nClust, &nBlk, &off)) != 0)
+		return err;
+	if ((err = soLoadBlockCTInMT (nBlk)) != 0) return err;
+		cTInT = soGetBlockCTInMT ();
+	if (cTInT[off] != NULL_INODE) /* check if the data cluster is dirty */
+	{ /* it is, clean it */
+		if ((err = soCleanDataCluster (cTInT[off], nClust)) != 0)
+			return err;
+	}
+
+	return 0;
+}
+
+/*
+ *  Draw a new reservation of free data clusters for the calling thread from the bitmap table to free data clusters,
+ *  when the allocation groups are open; the clusters are cleaned and no longer accounted as free. The search starts at
+ *  the cursor of the group and goes round it once.
+ */
+
+static int reserveClusters (SOSuperBlock *p_sb)
+{
+	uint32_t ref[AG_RESERVE];
+	uint32_t start, end, pos, n, i, k;
+	int stat;
+
+	for(k = 0; k < 2; k++)
+	{
+		if(!soGetReserveRange(&start, &end))
+			return 0;
+		n = 0;
+		if((stat = takeFreeClusters(start, end, ref, AG_RESERVE, &n, &pos)) != 0)
+			return stat;
+		for(i = 0; i < n; i++)
+			if((stat = cleanIfDirty(ref[i])) != 0)
+				return stat;
+		if(n > 0)
+		{
+			p_sb->dzone_free -= n;
+			if((stat = soStoreSuperBlock()) != 0)
+				return stat;
+		}
+		soPutReserved(ref, n, pos);
+		if(n > 0)
+			break;
+	}
+
+	return 0;
 }
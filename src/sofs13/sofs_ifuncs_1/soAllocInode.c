@@ -20,6 +20,14 @@
     #include "sofs_datacluster.h"
     #include "sofs_basicoper.h"
     #include "sofs_basicconsist.h"
+    #include "sofs_extent.h"
+    #include "sofs_inline.h"
+    #include "sofs_compress.h"
+    #include "sofs_inodeindex.h"
+
+    /* Allusion to internal function */
+
+    static int allocInode (uint32_t type, uint32_t near, uint32_t* p_nInode);
 
     /**
      *  \brief Allocate a free inode.
@@ -29,12 +37,15 @@
      *  first.
      *
      *  Upon initialization, the new inode has:
-     *     \li the field mode set to the given type, while the free flag and the permissions are reset
+     *     \li the field mode set to the given type, while the free flag and the permissions are reset (a regular file is
+     *         described by a tree of extents, if it is enabled, and the contents of a regular file or of a symbolic link
+     *         are stored in the inode, if it is so set; otherwise, the data clusters of a regular file are compressed,
+     *         if it is enabled)
      *     \li the owner and group fields set to current userid and groupid
      *     \li the <em>prev</em> and <em>next</em> fields, pointers in the double-linked list of free inodes, change their
      *         meaning: they are replaced by the <em>time of last file modification</em> and <em>time of last file
      *         access</em> which are set to current time
-     *     \li the reference fields set to NULL_CLUSTER
+     *     \li the reference fields set to NULL_CLUSTER (or zeroed, if the contents are stored in the inode)
      *     \li all other fields reset.
 
      *  \param type the inode type (it must represent either a regular file, or a directory, or a symbolic link)
@@ -56,9 +67,59 @@
     {
             soColorProbe (611, "07;31", "soAllocInode (%"PRIu32", %p)\n", type, p_nInode);
 
+    	int stat;
+
+    	soLockSuperBlock();
+    	stat = allocInode(type, NULL_INODE, p_nInode);
+    	soUnlockSuperBlock();
+
+    	return stat;
+    }
+
+    /**
+     *  \brief Allocate a free inode near a given one.
+     *
+     *  The inode is the free inode nearest to the given one in the table of inodes, found by the index of the
+     *  free inodes, which is taken out of the list of free inodes wherever it lies; if the index is not built, or
+     *  there is no free inode near the given one, it is retrieved from the list as in <em>soAllocInode</em>. It is
+     *  initialized in the same way.
+     *
+     *  \param type the inode type (it must represent either a regular file, or a directory, or a symbolic link)
+     *  \param nInodeNear number of the inode the new one should be near, usually the one of its parent directory
+     *  \param p_nInode pointer to the location where the number of the just allocated inode is to be stored
+     *
+     *  \return <tt>0 (zero)</tt>, on success
+     *  \return -\c EINVAL, if the <em>type</em> is illegal or the <em>pointer to inode number</em> is \c NULL
+     *  \return -\c ENOSPC, if the list of free inodes is empty
+     *  \return -\c ESBTINPINVAL, if the table of inodes metadata in the superblock is inconsistent
+     *  \return -\c ETINDLLINVAL, if the double-linked list of free inodes is inconsistent
+     *  \return -\c EFININVAL, if a free inode is inconsistent
+     *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+     *  \return -\c EBADF, if the device is not already opened
+     *  \return -\c EIO, if it fails reading or writing
+     *  \return -<em>other specific error</em> issued by \e lseek system call
+     */
+
+    int soAllocInodeNear (uint32_t type, uint32_t nInodeNear, uint32_t* p_nInode)
+    {
+    	soColorProbe (617, "07;31", "soAllocInodeNear (%"PRIu32", %"PRIu32", %p)\n", type, nInodeNear, p_nInode);
+
+    	int stat;
+
+    	soLockSuperBlock();
+    	stat = allocInode(type, nInodeNear, p_nInode);
+    	soUnlockSuperBlock();
+
+    	return stat;
+    }
+
+    /* Implementation of soAllocInode and soAllocInodeNear (the caller holds the lock of the superblock). */
+
+    static int allocInode (uint32_t type, uint32_t near, uint32_t* p_nInode)
+    {
         	SOInode *array;
         	SOSuperBlock *p_sb;
-        	uint32_t numBlock, offset, next;
+        	uint32_t numBlock, offset, prev, next, hInode, hPrev, hNext, fmt, n;
         	int status, i;
 
             // Se o type não existe ou ponteiro p_nInode é nulo
@@ -84,25 +145,37 @@
         	{
         		return status;
         	}
+        	// The free inode closest to the given one, if the index finds it; otherwise, the head of the list
         	*p_nInode = p_sb->ihead;
+        	if ((near != NULL_INODE) && ((n = soFindFreeInodeNear(near)) != NULL_INODE))
+        		*p_nInode = n;
 
         	// Obter nº bloco e o offset do inode
-        	if ((status = soConvertRefInT(p_sb->ihead, &numBlock, &offset)))
+        	if ((status = soConvertRefInT(*p_nInode, &numBlock, &offset)))
         	{
         		return status;
         	}
 
-        	// Ler o bloco do primeiro nó livre
-        	if ((status = soLoadBlockInT(numBlock)))
+        	// Read the block of the free inode
+        	if ((status = soLoadBlockInTH(numBlock, &hInode)))
         	{
         		return status;
         	}
 
-        	array = soGetBlockInT();
+        	array = soGetBlockInTH(hInode);
+        	if ((status = soQCheckFInode(&array[offset])) != 0)
+        	{
+        		return status;
+        	}
+        	prev = array[offset].vD1.prev;
         	next = array[offset].vD2.next;
 
         	// Preenchimento
-        	array[offset].mode = type | 0x0;
+        	if ((fmt = soGetInlineFormat(type)) == 0)
+        		fmt = soGetExtentFormat(type);
+        	if (fmt == 0)
+        		fmt = soGetCompressFormat(type);
+        	array[offset].mode = type | fmt;
         	array[offset].refcount = 0;
         	array[offset].owner = getuid();
         	array[offset].group = getgid();
@@ -116,47 +189,56 @@
 
         	array[offset].i1 = NULL_CLUSTER;
         	array[offset].i2 = NULL_CLUSTER;
+        	if (INODE_IS_INLINE(array[offset].mode))
+        		soInlineTrim(&array[offset], 0);
 
         	array[offset].vD1.atime = time(NULL);
         	array[offset].vD2.mtime = time(NULL);
 
-        	// Algoritmo
-        	if (p_sb->ifree == 1)
+        	// Store the inode
+        	if ((status = soStoreBlockInTH(hInode)) != 0)
         	{
-            	// A lista só tem um elemento
-        		p_sb->ihead = NULL_INODE;
-        		p_sb->itail = NULL_INODE;
-        		if ((status = soStoreBlockInT()) != 0)
-        		{
-        			return status;
-        		}
+        		return status;
         	}
-        	else{
-        		// A lista tem dois ou mais elementos
 
-        		// Actualiza ihead do bloco
+        	// Algorithm: the inode is removed from the list, wherever it is
+        	if (prev == NULL_INODE)
+        	{
         		p_sb->ihead = next;
-
-        		// Guarda o inode
-        		if ((status = soStoreBlockInT()) != 0)
+        	}
+        	else{
+        		if ((status = soConvertRefInT(prev, &numBlock, &offset)) != 0)
         		{
         			return status;
         		}
-        		// Nº Bloco e Offset inode head
-        		if ((status = soConvertRefInT (next, &numBlock, &offset)) != 0)
+        		if ((status = soLoadBlockInTH(numBlock, &hPrev)) != 0)
         		{
         			return status;
         		}
-        		// Como a lista não está vazia, vamos alterar o ihead
-        		if ((status = soLoadBlockInT(numBlock)) != 0)
+        		array = soGetBlockInTH(hPrev);
+        		array[offset].vD2.next = next;
+        		if ((status = soStoreBlockInTH(hPrev)) != 0)
         		{
         			return status;
         		}
-        		array = soGetBlockInT();
-        		array[offset].vD1.prev = NULL_INODE;
+        	}
 
-        		// Guarda o inode
-        		if ((status = soStoreBlockInT()) != 0)
+        	if (next == NULL_INODE)
+        	{
+        		p_sb->itail = prev;
+        	}
+        	else{
+        		if ((status = soConvertRefInT(next, &numBlock, &offset)) != 0)
+        		{
+        			return status;
+        		}
+        		if ((status = soLoadBlockInTH(numBlock, &hNext)) != 0)
+        		{
+        			return status;
+        		}
+        		array = soGetBlockInTH(hNext);
+        		array[offset].vD1.prev = prev;
+        		if ((status = soStoreBlockInTH(hNext)) != 0)
         		{
         			return status;
         		}
@@ -164,6 +246,7 @@
 
         	// Decrementa o numero de free inodes
         	p_sb->ifree--;
+        	soUpdateInodeIndex(*p_nInode, false);
 
         	// Guarda inode
         	if ((status = soStoreSuperBlock()) != 0)
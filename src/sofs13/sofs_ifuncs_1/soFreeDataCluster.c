@@ -5,9 +5,11 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <errno.h>
 #include <inttypes.h>
 #include <stdbool.h>
+#include <string.h>
 #include <time.h>
 #include <unistd.h>
 #include <sys/types.h>
@@ -19,10 +21,16 @@
 #include "sofs_datacluster.h"
 #include "sofs_basicoper.h"
 #include "sofs_basicconsist.h"
+#include "sofs_discard.h"
+#include "sofs_freesummary.h"
 
 /* Allusion to internal functions */
 
 int soDeplete (SOSuperBlock *p_sb);
+static int freeDataCluster (uint32_t nClust);
+static int freeDataClusters (uint32_t count, uint32_t *nClust);
+static bool inCache (const uint32_t *cache, uint32_t first, uint32_t nClust);
+static int cmpClust (const void *a, const void *b);
 
 /**
  *  \brief Free the referenced data cluster.
@@ -51,6 +59,19 @@ int soFreeDataCluster (uint32_t nClust)
 {
 	soColorProbe (614, "07;33", "soFreeDataCluster (%"PRIu32")\n", nClust);
 
+	int stat;
+
+	soLockSuperBlock();
+	stat = freeDataCluster(nClust);
+	soUnlockSuperBlock();
+
+	return stat;
+}
+
+/* Implementation of soFreeDataCluster (the caller holds the lock of the superblock). */
+
+static int freeDataCluster (uint32_t nClust)
+{
 	SOSuperBlock *p_sb;
   	uint32_t data_stat;
   	uint32_t ERRO;
@@ -101,6 +122,141 @@ int soFreeDataCluster (uint32_t nClust)
   	return 0;
 }
 
+/**
+ *  \brief Free a group of data clusters.
+ *
+ *  The clusters are sorted and returned straight to the bitmap table to free data clusters, bypassing the insertion
+ *  cache: each block of the table is loaded and stored only once and the superblock is stored at the end. Like in
+ *  <em>soFreeDataCluster</em>, they must have been previously allocated (which means that although free, they will be
+ *  in the dirty state, unless their mapping association was previously removed).
+ *
+ *  Either all the clusters are freed, or none is.
+ *
+ *  \param count number of data clusters
+ *  \param nClust pointer to the array of the logical numbers of the data clusters (it is sorted in place)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>pointer to the array</em> is \c NULL or any <em>data cluster number</em> is out of
+ *                      range
+ *  \return -\c EDCNALINVAL, if any data cluster has not been previously allocated, or it appears twice
+ *  \return -\c ESBDZINVAL, if the data zone metadata in the superblock is inconsistent
+ *  \return -\c ESBFCCINVAL, if the free data clusters caches in the superblock are inconsistent
+ *  \return -\c EFCTINVAL, if the number of free data clusters is overall inconsistent
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails reading or writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soFreeDataClusters (uint32_t count, uint32_t *nClust)
+{
+	soColorProbe (616, "07;33", "soFreeDataClusters (%"PRIu32", %p)\n", count, nClust);
+
+	int stat;
+
+	if(count == 0)
+		return 0;
+	if(nClust == NULL)
+		return -EINVAL;
+
+	qsort(nClust, count, sizeof(uint32_t), cmpClust);
+
+	soLockSuperBlock();
+	stat = freeDataClusters(count, nClust);
+	soUnlockSuperBlock();
+
+	return stat;
+}
+
+/* Implementation of soFreeDataClusters (the caller holds the lock of the superblock and the array is sorted). */
+
+static int freeDataClusters (uint32_t count, uint32_t *nClust)
+{
+	SOSuperBlock *p_sb;
+	unsigned char *fcBMapT;
+	uint32_t nBlk, nByte, nBit, first, last, pass;
+	int stat;
+
+	if((stat = soLoadSuperBlock()) != 0)
+		return stat;
+	if((p_sb = soGetSuperBlock()) == NULL)
+		return -EIO;
+	if((stat = soQCheckDZ(p_sb)) != 0)
+		return stat;
+
+	// the cluster of the root directory is never freed
+	if((nClust[0] == 0) || (nClust[count-1] >= p_sb->dzone_total))
+		return -EINVAL;
+
+	/* the first pass checks that all of them are allocated; the second one frees them, block by block of the bitmap */
+	for(pass = 0; pass < 2; pass++)
+		for(first = 0; first < count; first = last)
+		{
+			if((stat = soConvertRefBMapT(nClust[first], &nBlk, &nByte, &nBit)) != 0)
+				return stat;
+			if((stat = soLoadBlockBMapT(nBlk)) != 0)
+				return stat;
+			if((fcBMapT = soGetBlockBMapT()) == NULL)
+				return -EIO;
+			for(last = first; (last < count) && (nClust[last] / (8 * BLOCK_SIZE) == nBlk); last++)
+			{
+				nByte = (nClust[last] % (8 * BLOCK_SIZE)) / 8;
+				nBit = nClust[last] % 8;
+				if(pass == 0)
+				{
+					// a free cluster is in the bitmap or in one of the caches
+					if((fcBMapT[nByte] & (0x80 >> nBit)) || ((last > 0) && (nClust[last-1] == nClust[last])) ||
+					   inCache(p_sb->dzone_retriev.cache, p_sb->dzone_retriev.cache_idx, nClust[last]) ||
+					   inCache(p_sb->dzone_insert.cache, 0, nClust[last]))
+						return -EDCNALINVAL;
+				}
+				else
+				{
+					fcBMapT[nByte] |= (0x80 >> nBit);
+					soUpdateFreeSummary(nClust[last], 1);
+				}
+			}
+			if((pass == 1) && ((stat = soStoreBlockBMapT()) != 0))
+				return stat;
+		}
+
+	p_sb->dzone_free += count;
+
+	if((stat = soStoreSuperBlock()) != 0)
+		return stat;
+
+	// the freed clusters are discarded on the device, if requested
+	soDiscardClusters(p_sb, count, nClust);
+
+	return 0;
+}
+
+/*
+ *  Check if a reference is in a cache of free data cluster references, from position first onwards.
+ */
+
+static bool inCache (const uint32_t *cache, uint32_t first, uint32_t nClust)
+{
+	uint32_t i;
+
+	for(i = first; i < DZONE_CACHE_SIZE; i++)
+		if(cache[i] == nClust)
+			return true;
+
+	return false;
+}
+
+/*
+ *  Compare two data cluster references (for sorting).
+ */
+
+static int cmpClust (const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+
+	return (x > y) - (x < y);
+}
+
 /**
  *  \brief Deplete the insertion cache of references to free data clusters.
  *
@@ -121,6 +277,12 @@ int soDeplete (SOSuperBlock *p_sb)
   uint32_t p_nBlk;
   uint32_t p_byteOff;
   uint32_t p_bitOff;
+  uint32_t batch[DZONE_CACHE_SIZE];
+  uint32_t count;
+
+  // keep the references to be discarded, once they are moved to the table of free clusters
+  count = p_sb->dzone_insert.cache_idx;
+  memcpy(batch, p_sb->dzone_insert.cache, count * sizeof(uint32_t));
 
   for(n = 0;n < p_sb->dzone_insert.cache_idx; n++)
   {
@@ -134,6 +296,7 @@ int soDeplete (SOSuperBlock *p_sb)
 
     // actualiza os valores da tabela de clusters livres
     fcBMapT[p_byteOff] |= (0x80 >> p_bitOff);
+    soUpdateFreeSummary(p_sb->dzone_insert.cache[n], 1);
 
     // poe referencia nula na cache de insercao
     p_sb->dzone_insert.cache[n] = NULL_CLUSTER;
@@ -153,5 +316,8 @@ int soDeplete (SOSuperBlock *p_sb)
   if((error = soQCheckDZ(p_sb)) != 0)
     return error;
 
+  // discard the clusters on the device, if requested
+  soDiscardClusters(p_sb, count, batch);
+
   return 0;
 }
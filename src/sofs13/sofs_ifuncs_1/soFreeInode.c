@@ -18,6 +18,14 @@
 #include "sofs_datacluster.h"
 #include "sofs_basicoper.h"
 #include "sofs_basicconsist.h"
+#include "sofs_extent.h"
+#include "sofs_compress.h"
+#include "sofs_cleaner.h"
+#include "sofs_inodeindex.h"
+
+/* Allusion to internal function */
+
+static int freeInode (uint32_t nInode);
 
 /**
  *  \brief Free the referenced inode.
@@ -29,6 +37,9 @@
  *
  *  The only affected fields are:
  *     \li the free flag of mode field, which is set
+ *     \li the reference fields, which are set to NULL_CLUSTER together with the format flags of the mode field being
+ *         reset, if the contents of the file were stored in the inode
+ *     \li the compression flag of the mode field, which is reset, so that the references are plain lists of references
  *     \li the <em>time of last file modification</em> and <em>time of last file access</em> fields, which change their
  *         meaning: they are replaced by the <em>prev</em> and <em>next</em> pointers in the double-linked list of free
  *         inodes.
@@ -52,6 +63,23 @@ int soFreeInode (uint32_t nInode)
 {
 	soColorProbe (612, "07;31", "soFreeInode (%"PRIu32")\n", nInode);
 
+	int stat;
+
+	soLockSuperBlock();
+	stat = freeInode(nInode);
+	soUnlockSuperBlock();
+
+	/* the cleaner cleans it in the background, if it is running */
+	if (stat == 0)
+		soNoteFreedInode(nInode);
+
+	return stat;
+}
+
+/* Implementation of soFreeInode (the caller holds the lock of the superblock). */
+
+static int freeInode (uint32_t nInode)
+{
 	int error;
 
 	SOSuperBlock *sb;
@@ -61,9 +89,11 @@ int soFreeInode (uint32_t nInode)
 
 	uint32_t p_blk;
 	uint32_t p_blkTail;
+	uint32_t hInode, hTail;
 	uint32_t p_offseTail;
 	uint32_t p_offset;
 	uint32_t next;
+	uint32_t i;
 
 	if (nInode == 0)
 		return -EINVAL;
@@ -83,14 +113,30 @@ int soFreeInode (uint32_t nInode)
 
 
 	/* Load of iNode */
-	if((error = soLoadBlockInT(p_blk)) != 0)
+	if((error = soLoadBlockInTH(p_blk, &hInode)) != 0)
    			return error;
 
-	p_inode = soGetBlockInT();
+	p_inode = soGetBlockInTH(hInode);
 
-   	if( (error = soQCheckInodeIU(sb,&p_inode[p_offset])) != 0)
+   	if( (error = soQCheckInodeExtIU(sb,&p_inode[p_offset])) != 0)
    		return error;
 
+	/* A file whose contents are stored in the iNode leaves it with no data clusters */
+	if (INODE_IS_INLINE(p_inode[p_offset].mode))
+	{
+		p_inode[p_offset].mode &= ~INODE_FMT_MASK;
+		for (i = 0; i < N_DIRECT; i++)
+			p_inode[p_offset].d[i] = NULL_CLUSTER;
+		p_inode[p_offset].i1 = p_inode[p_offset].i2 = NULL_CLUSTER;
+	}
+
+	/* A free iNode is described by plain lists of references and its decompressed groups are no longer valid */
+	if (INODE_IS_COMPRESSED(p_inode[p_offset].mode))
+	{
+		p_inode[p_offset].mode &= ~INODE_COMPRESSED;
+		soCompressDrop(nInode, 0);
+	}
+
 	next = p_inode[p_offset].vD2.next;
 
 	/* Actualize the double linked list with the freed iNode */
@@ -100,7 +146,7 @@ int soFreeInode (uint32_t nInode)
 		p_inode[p_offset].vD1.prev = p_inode[p_offset].vD2.next = NULL_INODE;
 		sb->ihead = sb->itail = nInode;
 
-		if ((error = soStoreBlockInT() ) != 0)
+		if ((error = soStoreBlockInTH(hInode) ) != 0)
 			return error;
 	}
 
@@ -113,26 +159,27 @@ int soFreeInode (uint32_t nInode)
 		p_inode[p_offset].group = 0;
 		p_inode[p_offset].mode |= INODE_FREE;
 
-		if ((error = soStoreBlockInT()) != 0)
+		if ((error = soStoreBlockInTH(hInode)) != 0)
 			return error;
 
 		if ((error = soConvertRefInT(sb->itail, &p_blkTail, &p_offseTail)) != 0)
 			return error;
 
-		if ((error = soLoadBlockInT(p_blkTail)) != 0)
+		if ((error = soLoadBlockInTH(p_blkTail, &hTail)) != 0)
 			return error;
 
-		if ((arr = soGetBlockInT() ) == NULL)
+		if ((arr = soGetBlockInTH(hTail) ) == NULL)
 			return -EIO;
 
 		arr[p_offseTail].vD2.next = nInode;
 		sb -> itail = nInode;
 
-		if ((error = soStoreBlockInT() ) != 0)
+		if ((error = soStoreBlockInTH(hTail) ) != 0)
 			return error;
 	}
 
 	sb -> ifree++;
+	soUpdateInodeIndex(nInode, true);
 
 	/* Stores the SuperBlock */
 	if ((error = soStoreSuperBlock() ) != 0)
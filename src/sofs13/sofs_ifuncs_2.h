@@ -68,7 +68,9 @@ extern int soReadInode (SOInode *p_inode, uint32_t nInode, uint32_t status);
  *
  *  The inode may be either in use and belong to one of the legal file types or be free in the dirty state.
  *  Upon writing, the <em>time of last file modification</em> and <em>time of last file access</em> fields are set to
- *  current time, if the inode is in use.
+ *  current time, if the inode is in use. An inode in use keeps the format of its information content if the mode
+ *  which is given does not signal any and, if its information content is stored in the inode, the bytes past the new
+ *  size are cleared when the size decreases.
  *
  *  \param p_inode pointer to the buffer containing the data to be written from
  *  \param nInode number of the inode to be written into
@@ -16,6 +16,7 @@
 #include "sofs_inode.h"
 #include "sofs_basicoper.h"
 #include "sofs_basicconsist.h"
+#include "sofs_extent.h"
 
 /** \brief inode in use status */
 #define IUIN  0
@@ -82,7 +83,7 @@ int soAccessGranted (uint32_t nInode, uint32_t opRequested)
   	  return stat;
   if((stat = soReadInode(&checkinode, nInode,IUIN))!=0)
 	  return stat;
-  if((stat = soQCheckInodeIU(p_sb, &checkinode))!=0)
+  if((stat = soQCheckInodeExtIU(p_sb, &checkinode))!=0)
 	  return stat;
   if((stat = soConvertRefInT(nInode, &p_nBlk, &p_offset))!= 0)
 	  return stat;
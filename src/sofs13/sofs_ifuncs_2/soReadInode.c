@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include <errno.h>
 #include <inttypes.h>
+#include <stdbool.h>
 #include <time.h>
 #include <unistd.h>
 #include <sys/types.h>
@@ -16,6 +17,8 @@
 #include "sofs_inode.h"
 #include "sofs_basicoper.h"
 #include "sofs_basicconsist.h"
+#include "sofs_extent.h"
+#include "sofs_atime.h"
 
 /** \brief inode in use status */
 #define IUIN  0
@@ -26,7 +29,9 @@
  *  \brief Read specific inode data from the table of inodes.
  *
  *  The inode must be either in use and belong to one of the legal file types or be free in the dirty state.
- *  Upon reading, the <em>time of last file access</em> field is set to current time, if the inode is in use.
+ *  Upon reading, the <em>time of last file access</em> field is set to current time, if the inode is in use, according
+ *  to the policy of update in force. The new time is only written into the table of inodes now and then (see
+ *  sofs_atime.h), so that reading an inode seldom requires the block where it is stored to be written.
  *
  *  \param p_inode pointer to the buffer where inode data must be read into
  *  \param nInode number of the inode to be read from
@@ -51,8 +56,9 @@ int soReadInode (SOInode *p_inode, uint32_t nInode, uint32_t status)
 	/* funcao criada por Joao Ribeiro */
   int error, i;
   SOSuperBlock* p_sb;
-  uint32_t p_nBlk, p_offset, blockin;
+  uint32_t p_nBlk, p_offset, blockin, atime;
   SOInode* cr_inode;
+  bool store;
 
   // VALIDACAO DE CONFORMIDADE
   
@@ -92,7 +98,7 @@ int soReadInode (SOInode *p_inode, uint32_t nInode, uint32_t status)
   {
     if(!((cr_inode->mode >> 12) & 0x01))
       return -EFDININVAL;
-    if((error = soQCheckFDInode(p_sb, cr_inode)) != 0)
+    if((error = soQCheckFDInodeExt(p_sb, cr_inode)) != 0)
       return error;
   }
   
@@ -103,15 +109,16 @@ int soReadInode (SOInode *p_inode, uint32_t nInode, uint32_t status)
     || ((cr_inode->mode >> 10) & 0x01)
     || ((cr_inode->mode >> 11) & 0x01)))
       return -EIUININVAL;
-    if((error = soQCheckInodeIU (p_sb, cr_inode)) != 0)
+    if((error = soQCheckInodeExtIU (p_sb, cr_inode)) != 0)
       return error;
 
   }
 
   //  leitura do inode
-  // actualiza o ultimo tempo de acesso caso necessario
-  if(status == IUIN)
-    cr_inode->vD1.atime = time(NULL);
+  // the time of last access is updated in memory and only stored now and then
+  store = (status == IUIN) && soAtimeAccess(nInode, cr_inode, &atime);
+  if(store)
+    cr_inode->vD1.atime = atime;
   p_inode->mode = cr_inode->mode;
   p_inode->refcount = cr_inode->refcount;
   p_inode->owner = cr_inode->owner;
@@ -124,10 +131,13 @@ int soReadInode (SOInode *p_inode, uint32_t nInode, uint32_t status)
   p_inode->i2 = cr_inode->i2;
   for(i = 0; i < N_DIRECT; i++)
     p_inode->d[i] = cr_inode->d[i];
+  if(status == IUIN)
+    p_inode->vD1.atime = atime;
 
-  // guarda alteracoes
-  if((error = soStoreBlockInT()) != 0)
-    return error;
+  // store the changes, if there are any
+  if(store)
+    if((error = soStoreBlockInT()) != 0)
+      return error;
 
   return 0;
 }
@@ -16,6 +16,9 @@
 #include "sofs_inode.h"
 #include "sofs_basicoper.h"
 #include "sofs_basicconsist.h"
+#include "sofs_extent.h"
+#include "sofs_inline.h"
+#include "sofs_atime.h"
 
 /** \brief inode in use status */
 #define IUIN  0
@@ -27,7 +30,9 @@
  *
  *  The inode may be either in use and belong to one of the legal file types or be free in the dirty state.
  *  Upon writing, the <em>time of last file modification</em> and <em>time of last file access</em> fields are set to
- *  current time, if the inode is in use.
+ *  current time, if the inode is in use. An inode in use keeps the format of its information content if the mode
+ *  which is given does not signal any and, if its information content is stored in the inode, the bytes past the new
+ *  size are cleared when the size decreases.
  *
  *  \param p_inode pointer to the buffer containing the data to be written from
  *  \param nInode number of the inode to be written into
@@ -75,15 +80,31 @@ int soWriteInode (SOInode *p_inode, uint32_t nInode, uint32_t status)
 	  return -EINVAL;
   }
 
+  if(status == IUIN)
+  {
+	  soConvertRefInT(nInode, &nBloco, &offset);
+	  if((error = soLoadBlockInT(nBloco)) != 0)
+		  return error;
+	  SOInode *stored = &soGetBlockInT()[offset];
+
+	  // an inode in use keeps the format of its contents, if the given mode sets none (soChmod, for instance)
+	  if(!(p_inode->mode & INODE_FMT_MASK))
+		  p_inode->mode |= stored->mode & INODE_FMT_MASK;
+
+	  // the contents stored in the inode itself are cleared past the new size, when the file is truncated
+	  if(INODE_IS_INLINE(p_inode->mode) && (p_inode->size < stored->size))
+		  soInlineTrim(p_inode, p_inode->size);
+  }
+
   if(status == IUIN){	// verifica consistência do nó-i em uso
-		if((error = soQCheckInodeIU(p_sb,  p_inode)) != 0)
+		if((error = soQCheckInodeExtIU(p_sb,  p_inode)) != 0)
 		{
  			return error;
 		}
   }
   else					// verifica consistência do nó-i em dirty state
   {
-		if((error = soQCheckFDInode(p_sb,p_inode)) != 0)
+		if((error = soQCheckFDInodeExt(p_sb,p_inode)) != 0)
 		{
 			return error;
 		}
@@ -107,5 +128,8 @@ int soWriteInode (SOInode *p_inode, uint32_t nInode, uint32_t status)
 	if((error = soStoreBlockInT ()))
 		return error;
 
+	// the time of last access kept in memory is no longer needed
+	soAtimeDrop(nInode);
+
   return 0;
 }
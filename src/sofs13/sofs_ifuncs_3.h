@@ -8,7 +8,10 @@
  *  The operations are:
  *      \li read a specific data cluster
  *      \li write to a specific data cluster
+ *      \li read a group of successive data clusters
+ *      \li write to a group of successive data clusters
  *      \li handle a file data cluster
+ *      \li get the logical numbers of a group of successive data clusters
  *      \li free and clean all data clusters from the list of references starting at a given point
  *      \li clean a data cluster from the inode describing a file which was previously deleted.
  *
@@ -47,7 +50,8 @@
  *  file, a directory or a symbolic link). Thus, the inode must be in use and belong to one of the legal file types.
  *
  *  If the cluster has not been allocated yet, the returned data will consist of a cluster whose byte stream contents
- *  is filled with the character null (ascii code 0).
+ *  is filled with the character null (ascii code 0). If the information content of the file is stored in the inode
+ *  itself, it is returned as the data cluster of index 0.
  *
  *  \param nInode number of the inode associated to the file
  *  \param clustInd index to the list of direct references belonging to the inode where data is to be read from
@@ -73,7 +77,9 @@ extern int soReadFileCluster (uint32_t nInode, uint32_t clustInd, void *buff);
  *  associated to a file (a regular file, a directory or a symbolic link). Thus, the inode must be in use and belong
  *  to one of the legal file types.
  *
- *  If the cluster has not been allocated yet, it will be allocated now so that data can be stored there.
+ *  If the cluster has not been allocated yet, it will be allocated now so that data can be stored there. If the
+ *  information content of the file is stored in the inode itself, it stays there when the data cluster of index 0 is
+ *  written and its bytes past the first \c INLINE_SIZE are zero; otherwise, it is moved out into a data cluster first.
  *
  *  \param nInode number of the inode associated to the file
  *  \param clustInd index to the list of direct references belonging to the inode where data is to be written into
@@ -93,6 +99,68 @@ extern int soReadFileCluster (uint32_t nInode, uint32_t clustInd, void *buff);
 
 extern int soWriteFileCluster (uint32_t nInode, uint32_t clustInd, void *buff);
 
+/**
+ *  \brief Read a group of successive data clusters.
+ *
+ *  Data is read from <tt>count</tt> successive data clusters, starting at a given index to the list of direct
+ *  references, which are supposed to belong to an inode associated to a file (a regular file, a directory or a
+ *  symbolic link). Thus, the inode must be in use and belong to one of the legal file types.
+ *
+ *  The logical numbers of the data clusters are got once for each cluster of references involved and the data clusters
+ *  which are stored in successive clusters of the data zone are read by a single transfer. The data clusters which
+ *  have not been allocated yet are returned filled with the character null (ascii code 0). If the information content
+ *  of the file is stored in the inode itself, it is returned as the data cluster of index 0.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param firstInd index to the list of direct references belonging to the inode where data is to be read from
+ *  \param count number of data clusters to be read
+ *  \param buff pointer to the buffer where data must be read into (it must hold <tt>count</tt> data clusters)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>inode number</em> or the <em>range of indexes to the list of direct references</em>
+ *                      are out of range or the <em>pointer to the buffer area</em> is \c NULL
+ *  \return -\c EIUININVAL, if the inode in use is inconsistent
+ *  \return -\c ELDCININVAL, if the list of data cluster references belonging to an inode is inconsistent
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails reading or writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+extern int soReadFileClusters (uint32_t nInode, uint32_t firstInd, uint32_t count, void *buff);
+
+/**
+ *  \brief Write to a group of successive data clusters.
+ *
+ *  Data is written into the information content of <tt>count</tt> successive data clusters, starting at a given index
+ *  to the list of direct references, which are supposed to belong to an inode associated to a file (a regular file, a
+ *  directory or a symbolic link). Thus, the inode must be in use and belong to one of the legal file types.
+ *
+ *  The logical numbers of the data clusters are got once for each cluster of references involved, those which have not
+ *  been allocated yet are allocated now and the data clusters which are stored in successive clusters of the data zone
+ *  are written by a single transfer. If the information content of the file is stored in the inode itself, it is moved
+ *  out into a data cluster first, unless only the data cluster of index 0 is written (as by \e soWriteFileCluster).
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param firstInd index to the list of direct references belonging to the inode where data is to be written into
+ *  \param count number of data clusters to be written
+ *  \param buff pointer to the buffer where data must be written from (it must hold <tt>count</tt> data clusters)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>inode number</em> or the <em>range of indexes to the list of direct references</em>
+ *                      are out of range or the <em>pointer to the buffer area</em> is \c NULL
+ *  \return -\c EIUININVAL, if the inode in use is inconsistent
+ *  \return -\c ELDCININVAL, if the list of data cluster references belonging to an inode is inconsistent
+ *  \return -\c EDCMINVAL, if the mapping association of the data cluster is invalid
+ *  \return -\c ENOSPC, if there are no free data clusters
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails reading or writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+extern int soWriteFileClusters (uint32_t nInode, uint32_t firstInd, uint32_t count, void *buff);
+
 /**
  *  \brief Handle of a file data cluster.
  *
@@ -111,6 +179,9 @@ extern int soWriteFileCluster (uint32_t nInode, uint32_t clustInd, void *buff);
  *  Depending on the operation, the field <em>clucount</em> and the lists of direct references, single indirect
  *  references and double indirect references to data clusters of the inode associated to the file are updated.
  *
+ *  If the information content of the file is stored in the inode itself, it has no data clusters: the operation
+ *  ALLOC moves it out into the data cluster of index 0 beforehand, the others finding none.
+ *
  *  Thus, the inode must be in use and belong to one of the legal file types for the operations GET, ALLOC, FREE and
  *  FREE_CLEAN and must be free in the dirty state for the operation CLEAN.
  *
@@ -140,6 +211,35 @@ extern int soWriteFileCluster (uint32_t nInode, uint32_t clustInd, void *buff);
 
 extern int soHandleFileCluster (uint32_t nInode, uint32_t clustInd, uint32_t op, uint32_t *p_outVal);
 
+/**
+ *  \brief Get the logical numbers of a group of successive data clusters of a file.
+ *
+ *  The file (a regular file, a directory or a symlink) is described by the inode it is associated to, which must be in
+ *  use and belong to one of the legal file types.
+ *
+ *  It is equivalent to applying the operation GET of \e soHandleFileCluster to each of the data clusters, but the
+ *  inode is read only once and each cluster of references (or leaf of the tree of extents) involved is loaded only
+ *  once.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param firstInd index to the list of direct references belonging to the inode of the first data cluster
+ *  \param count number of data clusters
+ *  \param nClust pointer to the array where the logical numbers of the data clusters are to be stored (\c NULL_CLUSTER,
+ *                for those which have not been allocated yet)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>inode number</em> or the <em>range of indexes to the list of direct references</em>
+ *                      are out of range or the <em>pointer to the array</em> is \c NULL
+ *  \return -\c EIUININVAL, if the inode in use is inconsistent
+ *  \return -\c ELDCININVAL, if the list of data cluster references belonging to an inode is inconsistent
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails reading or writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+extern int soGetFileClusters (uint32_t nInode, uint32_t firstInd, uint32_t count, uint32_t *nClust);
+
 /**
  *  \brief Handle all data clusters from the list of references starting at a given point.
  *
@@ -157,7 +257,9 @@ extern int soHandleFileCluster (uint32_t nInode, uint32_t clustInd, uint32_t op,
  *                    describes the file.
  *
  *  Depending on the operation, the field <em>clucount</em> and the lists of direct references, single indirect
- *  references and double indirect references to data clusters of the inode associated to the file are updated.
+ *  references and double indirect references to data clusters of the inode associated to the file are updated (or its
+ *  tree of extents, if the inode mode signals it). If the information content of the file is stored in the inode
+ *  itself, there are no data clusters and it is just cleared by the operation FREE_CLEAN from index 0 onwards.
  *
  *  Thus, the inode must be in use and belong to one of the legal file types for the operations FREE and FREE_CLEAN and
  *  must be free in the dirty state for the operation CLEAN.
@@ -18,6 +18,9 @@
 #include "sofs_basicconsist.h"
 #include "sofs_ifuncs_1.h"
 #include "sofs_ifuncs_2.h"
+#include "sofs_clustmap.h"
+#include "sofs_extent.h"
+#include "sofs_inline.h"
 
 /** \brief operation get the physical number of the referenced data cluster */
 #define GET         0
@@ -38,8 +41,11 @@ static int soHandleSIndirect (SOSuperBlock *p_sb, uint32_t nInode, SOInode *p_in
                               uint32_t *p_outVal);
 static int soHandleDIndirect (SOSuperBlock *p_sb, uint32_t nInode, SOInode *p_inode, uint32_t nClust, uint32_t op,
                               uint32_t *p_outVal);
+static int soHandleExtent (SOSuperBlock *p_sb, uint32_t nInode, SOInode *p_inode, uint32_t clustInd, uint32_t op,
+                           uint32_t *p_outVal);
 static int soMapDCtoIn (uint32_t nInode, uint32_t nClust);
 static int soUnmapDCtoIn (uint32_t nInode, uint32_t nClust);
+static int soGetRefs (SOSuperBlock *p_sb, uint32_t nRefClust, uint32_t first, uint32_t count, uint32_t *nClust);
 
 /**
  *  \brief Handle of a file data cluster.
@@ -57,7 +63,11 @@ static int soUnmapDCtoIn (uint32_t nInode, uint32_t nClust);
  *    \li CLEAN:      dissociate the referenced data cluster from the inode which describes the file.
  *
  *  Depending on the operation, the field <em>clucount</em> and the lists of direct references, single indirect
- *  references and double indirect references to data clusters of the inode associated to the file are updated.
+ *  references and double indirect references to data clusters of the inode associated to the file are updated (or its
+ *  tree of extents, if the inode mode signals it).
+ *
+ *  If the information content of the file is stored in the inode itself, it has no data clusters: the operation
+ *  ALLOC moves it out into the data cluster of index 0 beforehand, the others finding none.
  *
  *  Thus, the inode must be in use and belong to one of the legal file types for the operations GET, ALLOC, FREE and
  *  FREE_CLEAN and must be free in the dirty state for the operation CLEAN.
@@ -115,6 +125,10 @@ int soHandleFileCluster (uint32_t nInode, uint32_t clustInd, uint32_t op, uint32
   if(p_outVal != NULL && (op == FREE || op == FREE_CLEAN || op == CLEAN))
     return -EINVAL; 
 
+  // open files keep the logical numbers of their data clusters in memory
+  if((op == GET) && (clustInd < MAX_FILE_CLUSTERS) && (soClustMapLookup(nInode, clustInd, p_outVal) == 0))
+    return 0;
+
   if(op == CLEAN)
     inode_status = 1;
   else
@@ -125,15 +139,37 @@ int soHandleFileCluster (uint32_t nInode, uint32_t clustInd, uint32_t op, uint32
 
   // validacao de consistencia
   if(op != CLEAN)
-    if ((error = soQCheckInodeIU(p_sb, &p_inode)) != 0)
+    if ((error = soQCheckInodeExtIU(p_sb, &p_inode)) != 0)
       return error;
 
   if(op == CLEAN)
-    if((error = soQCheckFDInode(p_sb, &p_inode)) != 0)
+    if((error = soQCheckFDInodeExt(p_sb, &p_inode)) != 0)
       return error;
 
+  // the map of the open file is no longer valid for the data cluster
+  if(op != GET)
+    soClustMapInvalidate(nInode, clustInd, 1);
+
+  // contents stored in the inode itself: only an allocation moves them to a data cluster, and then goes on
+  if(INODE_IS_INLINE(p_inode.mode))
+  {
+    if(op == GET)
+    {
+      *p_outVal = NULL_CLUSTER;
+      return 0;
+    }
+    if(op != ALLOC)
+      return -EDCNOTIL;
+    if((error = soInlineSpill(nInode, &p_inode)) != 0)
+      return error;
+  }
+
+  // tree of extents
+  if(p_inode.mode & INODE_EXTENTS)
+    status = soHandleExtent(p_sb, nInode, &p_inode, clustInd, op, p_outVal);
+
   // para referencias directas
-  if(clustInd < N_DIRECT)
+  else if(clustInd < N_DIRECT)
     status = soHandleDirect(p_sb, nInode, &p_inode, clustInd, op, p_outVal);
 
   // para referencias simplesmente indirectas
@@ -152,12 +188,135 @@ int soHandleFileCluster (uint32_t nInode, uint32_t clustInd, uint32_t op, uint32
     if((error = soWriteInode(&p_inode, nInode, inode_status)) != 0)
       return error;
 
+  // the map of the open file records the allocated data cluster
+  if((op == ALLOC) && (status == 0))
+    soClustMapSet(nInode, clustInd, 1, p_outVal);
+
   // guarda o superbloco
   if((error = soStoreSuperBlock()) != 0)
     return error;
   return status;
 }
 
+/**
+ *  \brief Get the logical numbers of a group of successive data clusters of a file.
+ *
+ *  The file (a regular file, a directory or a symlink) is described by the inode it is associated to, which must be in
+ *  use and belong to one of the legal file types.
+ *
+ *  It is equivalent to applying the operation GET of \e soHandleFileCluster to each of the data clusters, but the
+ *  inode is read only once and each cluster of references (or leaf of the tree of extents) involved is loaded only
+ *  once. If the file is open, the logical numbers are taken from its map in internal storage, when they are known, and
+ *  are stored there otherwise. A file whose information content is stored in the inode itself has no data clusters.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param firstInd index to the list of direct references belonging to the inode of the first data cluster
+ *  \param count number of data clusters
+ *  \param nClust pointer to the array where the logical numbers of the data clusters are to be stored (\c NULL_CLUSTER,
+ *                for those which have not been allocated yet)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>inode number</em> or the <em>range of indexes to the list of direct references</em>
+ *                      are out of range or the <em>pointer to the array</em> is \c NULL
+ *  \return -\c EIUININVAL, if the inode in use is inconsistent
+ *  \return -\c ELDCININVAL, if the list of data cluster references belonging to an inode is inconsistent
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails reading or writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soGetFileClusters (uint32_t nInode, uint32_t firstInd, uint32_t count, uint32_t *nClust)
+{
+  soColorProbe (418, "07;31", "soGetFileClusters (%"PRIu32", %"PRIu32", %"PRIu32", %p)\n",
+                nInode, firstInd, count, nClust);
+
+  int error;
+  SOSuperBlock *p_sb;
+  SOInode inode;
+  SODataClust *p_clt;
+  uint32_t hD, ind, end, k, nSI, *map;
+
+  // load the superblock
+  if((error = soLoadSuperBlock()) != 0)
+    return error;
+  p_sb = soGetSuperBlock();
+
+  // parameters verification
+  if((nInode >= p_sb->itotal) || (nClust == NULL) || ((uint64_t) firstInd + count > MAX_FILE_CLUSTERS))
+    return -EINVAL;
+
+  // open files keep the logical numbers of their data clusters in memory
+  if(soClustMapGet(nInode, firstInd, count, nClust) == 0)
+    return 0;
+
+  // load the inode and check its consistency
+  if((error = soReadInode(&inode, nInode, IUIN)) != 0)
+    return error;
+  if((error = soQCheckInodeExtIU(p_sb, &inode)) != 0)
+    return error;
+
+  // information content stored in the inode itself: there are no data clusters
+  if(INODE_IS_INLINE(inode.mode))
+  {
+    for(k = 0; k < count; k++)
+      nClust[k] = NULL_CLUSTER;
+    return 0;
+  }
+
+  // tree of extents: each leaf involved is reached by a single descent
+  if(inode.mode & INODE_EXTENTS)
+  {
+    if((error = soExtentLookup(&inode, firstInd, count, nClust)) != 0)
+      return error;
+    soClustMapSet(nInode, firstInd, count, nClust);
+    return 0;
+  }
+
+  end = firstInd + count;
+  ind = firstInd;
+  map = nClust;
+
+  // direct references
+  for(; (ind < end) && (ind < N_DIRECT); ind++)
+    *nClust++ = inode.d[ind];
+
+  // single indirect references: the cluster of references is loaded once
+  if((ind < end) && (ind < N_DIRECT + RPC))
+  {
+    k = ((end < N_DIRECT + RPC) ? end : N_DIRECT + RPC) - ind;
+    if((error = soGetRefs(p_sb, inode.i1, ind - N_DIRECT, k, nClust)) != 0)
+      return error;
+    nClust += k;
+    ind += k;
+  }
+
+  // double indirect references: each cluster of references is loaded once
+  while(ind < end)
+  {
+    k = RPC - (ind - N_DIRECT - RPC) % RPC;
+    if(k > end - ind)
+      k = end - ind;
+    nSI = NULL_CLUSTER;
+    if(inode.i2 != NULL_CLUSTER)
+    {
+      if((error = soLoadRefClustH(p_sb->dzone_start + inode.i2 * BLOCKS_PER_CLUSTER, &hD)) != 0)
+        return error;
+      if((p_clt = soGetRefClustH(hD)) == NULL)
+        return -ELIBBAD;
+      nSI = p_clt->ref[(ind - N_DIRECT - RPC) / RPC];
+    }
+    if((error = soGetRefs(p_sb, nSI, (ind - N_DIRECT - RPC) % RPC, k, nClust)) != 0)
+      return error;
+    nClust += k;
+    ind += k;
+  }
+
+  soClustMapSet(nInode, firstInd, count, map);
+
+  return 0;
+}
+
 
 /**
  *  \brief Handle of a file data cluster which belongs to the direct references list.
@@ -204,8 +363,8 @@ static int soHandleDirect (SOSuperBlock *p_sb, uint32_t nInode, SOInode *p_inode
 		if(p_inode->d[clustInd] != NULL_CLUSTER)
 			return -EDCARDYIL;
 
-		// alloc a data cluster to put on the table of direct references
-		if((error = soAllocDataCluster(p_outVal)))
+		// alloc a data cluster to put on the table of direct references, right after the previous one, if possible
+		if((error = soAllocDataClusters((clustInd > 0) ? p_inode->d[clustInd-1] : NULL_CLUSTER, 1, p_outVal)))
 			return error;
 
 		//insert the logical number of the data cluster on the table of direct references
@@ -291,7 +450,8 @@ static int soHandleSIndirect (SOSuperBlock *p_sb, uint32_t nInode, SOInode *p_in
 
   int error, iflag, i;
   SODataClust *p_clt;
-  uint32_t pcn, n_cluster;
+  uint32_t hD;
+  uint32_t pcn, n_cluster, hint;
 
   switch(op)
   {
@@ -313,9 +473,9 @@ static int soHandleSIndirect (SOSuperBlock *p_sb, uint32_t nInode, SOInode *p_in
       pcn = p_sb->dzone_start + p_inode->i1 * BLOCKS_PER_CLUSTER;
         
       // loads and retrieves cluster references
-      if((error = soLoadDirRefClust(pcn)) != 0)	
+      if((error = soLoadRefClustH(pcn, &hD)) != 0)	
         return error;
-      p_clt = soGetDirRefClust();
+      p_clt = soGetRefClustH(hD);
 
       // sets out value
       *p_outVal = p_clt->ref[clustInd-N_DIRECT];
@@ -334,8 +494,8 @@ static int soHandleSIndirect (SOSuperBlock *p_sb, uint32_t nInode, SOInode *p_in
       // if the indirect cluster reference cluster is not allocated
       if(p_inode->i1 == NULL_CLUSTER)
       {
-        // allocates indirect cluster reference cluster
-        if((error = soAllocDataCluster(&n_cluster)) != 0)
+        // allocates indirect cluster reference cluster, after the last direct reference
+        if((error = soAllocDataClusters(p_inode->d[N_DIRECT-1], 1, &n_cluster)) != 0)
           return error;
         p_inode->i1 = n_cluster;
         // maps new cluster to inode
@@ -349,9 +509,9 @@ static int soHandleSIndirect (SOSuperBlock *p_sb, uint32_t nInode, SOInode *p_in
       pcn = p_sb->dzone_start + p_inode->i1 * BLOCKS_PER_CLUSTER;
 
       // loads and retrieves cluster references
-      if((error = soLoadDirRefClust(pcn)) != 0)
+      if((error = soLoadRefClustH(pcn, &hD)) != 0)
         return error;
-      p_clt = soGetDirRefClust();
+      p_clt = soGetRefClustH(hD);
 
       // if the indirect cluster reference cluster was allocated
       if(iflag)
@@ -363,18 +523,23 @@ static int soHandleSIndirect (SOSuperBlock *p_sb, uint32_t nInode, SOInode *p_in
       if(p_clt->ref[clustInd-N_DIRECT] != NULL_CLUSTER)
         return -EDCARDYIL;
 
+      // the new cluster should follow the previous one, or the indirect references cluster
+      hint = p_inode->i1;
+      if(clustInd > N_DIRECT && p_clt->ref[clustInd-N_DIRECT-1] != NULL_CLUSTER)
+        hint = p_clt->ref[clustInd-N_DIRECT-1];
+
       // saves cluster (alloc may alter it)
-      if((error = soStoreDirRefClust()) != 0)
+      if((error = soStoreRefClustH(hD)) != 0)
         return error;
 
       // allocates cluster
-      if((error = soAllocDataCluster(&n_cluster)) != 0)
+      if((error = soAllocDataClusters(hint, 1, &n_cluster)) != 0)
         return error;
 
       // loads cluster again
-      if((error = soLoadDirRefClust(pcn)) != 0)
+      if((error = soLoadRefClustH(pcn, &hD)) != 0)
         return error;
-      p_clt = soGetDirRefClust();
+      p_clt = soGetRefClustH(hD);
 
       p_clt->ref[clustInd-N_DIRECT] = n_cluster;
       // increments inode cluster count
@@ -384,7 +549,7 @@ static int soHandleSIndirect (SOSuperBlock *p_sb, uint32_t nInode, SOInode *p_in
       if((error = soMapDCtoIn (nInode, n_cluster)) != 0)
         return error;
       // stores indirect references cluster
-      if((error = soStoreDirRefClust()) != 0)
+      if((error = soStoreRefClustH(hD)) != 0)
         return error;
 
       // sets return value
@@ -403,9 +568,9 @@ static int soHandleSIndirect (SOSuperBlock *p_sb, uint32_t nInode, SOInode *p_in
       // loads and retrieves the cluster references
       pcn = p_sb->dzone_start + p_inode->i1 * BLOCKS_PER_CLUSTER;
 
-      if((error = soLoadDirRefClust(pcn)) != 0)
+      if((error = soLoadRefClustH(pcn, &hD)) != 0)
         return error;
-      p_clt = soGetDirRefClust();
+      p_clt = soGetRefClustH(hD);
 
       n_cluster = clustInd-N_DIRECT;
       // checks if there is valid cluster reference
@@ -428,7 +593,7 @@ static int soHandleSIndirect (SOSuperBlock *p_sb, uint32_t nInode, SOInode *p_in
         p_inode->clucount--;
 
         // stores change to ref cluster
-        if((error = soStoreDirRefClust()) != 0)
+        if((error = soStoreRefClustH(hD)) != 0)
           return error;
 
         // checks if direct references cluster has 0 references
@@ -497,6 +662,7 @@ static int soHandleDIndirect (SOSuperBlock *p_sb, uint32_t nInode, SOInode *p_in
   int error, iflagSI, iflagD, i;
   uint32_t pcn, kSI, kD, n_cluster, refSI, refD;
   SODataClust *p_cltD, *p_cltSI;
+  uint32_t hD, hSI;
 
   if(op == ALLOC)
   {
@@ -507,7 +673,7 @@ static int soHandleDIndirect (SOSuperBlock *p_sb, uint32_t nInode, SOInode *p_in
       //checks if single indirect refs cluster is allocated
       if(p_inode->i2 == NULL_CLUSTER)
       {
-        if((error = soAllocDataCluster(&n_cluster)) != 0)
+        if((error = soAllocDataClusters(p_inode->i1, 1, &n_cluster)) != 0)
           return error;
         iflagSI = 1;
         p_inode->i2 = n_cluster;
@@ -519,9 +685,9 @@ static int soHandleDIndirect (SOSuperBlock *p_sb, uint32_t nInode, SOInode *p_in
       // calculates cluster phisical number
       pcn = p_sb->dzone_start + p_inode->i2 * BLOCKS_PER_CLUSTER;
       // loads single indirect references cluster
-      if((error = soLoadSngIndRefClust(pcn)) != 0)
+      if((error = soLoadRefClustH(pcn, &hSI)) != 0)
         return error;
-      p_cltSI = soGetSngIndRefClust();
+      p_cltSI = soGetRefClustH(hSI);
 
       // if single indirect references cluster has been allocated, put null references
       if(iflagSI)
@@ -529,7 +695,7 @@ static int soHandleDIndirect (SOSuperBlock *p_sb, uint32_t nInode, SOInode *p_in
           p_cltSI->ref[i] = NULL_CLUSTER;
 
       // saves refs cluster (alloc may change it)
-      if((error = soStoreSngIndRefClust()) != 0)
+      if((error = soStoreRefClustH(hSI)) != 0)
         return error;
 
       // calculates single indirect references index
@@ -539,14 +705,16 @@ static int soHandleDIndirect (SOSuperBlock *p_sb, uint32_t nInode, SOInode *p_in
       refSI = p_cltSI->ref[kSI];
       if(refSI == NULL_CLUSTER)
       {
-        // allocs new cluster
-        if((error = soAllocDataCluster(&n_cluster)) != 0)
+        // allocs new cluster, after the previous direct references cluster or the single indirect one
+        if((error = soAllocDataClusters((kSI > 0 && p_cltSI->ref[kSI-1] != NULL_CLUSTER) ? p_cltSI->ref[kSI-1]
+                                                                                         : p_inode->i2,
+                                        1, &n_cluster)) != 0)
           return error;
         // loads it again
         pcn = p_sb->dzone_start + p_inode->i2 * BLOCKS_PER_CLUSTER;
-        if((error = soLoadSngIndRefClust(pcn)) != 0)
+        if((error = soLoadRefClustH(pcn, &hSI)) != 0)
           return error;
-        p_cltSI = soGetSngIndRefClust();
+        p_cltSI = soGetRefClustH(hSI);
 
         iflagD = 1;
         p_cltSI->ref[kSI] = n_cluster;
@@ -554,7 +722,7 @@ static int soHandleDIndirect (SOSuperBlock *p_sb, uint32_t nInode, SOInode *p_in
         p_inode->clucount++;
 
         // stores single ind refs cluster
-        if((error = soStoreSngIndRefClust()) != 0)
+        if((error = soStoreRefClustH(hSI)) != 0)
           return error;
 
         // map new cluster
@@ -564,9 +732,9 @@ static int soHandleDIndirect (SOSuperBlock *p_sb, uint32_t nInode, SOInode *p_in
 
       // calculates direct references cluster phisical number
       pcn = p_sb->dzone_start + refSI * BLOCKS_PER_CLUSTER;
-      if((error = soLoadDirRefClust(pcn)) != 0)
+      if((error = soLoadRefClustH(pcn, &hD)) != 0)
         return error;
-      p_cltD = soGetDirRefClust();
+      p_cltD = soGetRefClustH(hD);
 
       // if the direct reference cluster has been allocated, fills the references of that cluster with NULL_CLUSTER
       if(iflagD)
@@ -574,7 +742,7 @@ static int soHandleDIndirect (SOSuperBlock *p_sb, uint32_t nInode, SOInode *p_in
           p_cltD->ref[i] = NULL_CLUSTER;
 
       // saves dir refs cluster
-      if((error = soStoreDirRefClust()) != 0)
+      if((error = soStoreRefClustH(hD)) != 0)
         return error;
 
       // calculates index for direct references
@@ -584,21 +752,22 @@ static int soHandleDIndirect (SOSuperBlock *p_sb, uint32_t nInode, SOInode *p_in
       if(refD != NULL_CLUSTER)
         return -EDCARDYIL;
 
-      // allocs data cluster
-      if((error = soAllocDataCluster(&n_cluster)) != 0)
+      // allocs data cluster, after the previous one or the direct references cluster
+      if((error = soAllocDataClusters((kD > 0 && p_cltD->ref[kD-1] != NULL_CLUSTER) ? p_cltD->ref[kD-1] : refSI,
+                                      1, &n_cluster)) != 0)
         return error;
 
       // loads dir refs cluster again
       pcn = p_sb->dzone_start + refSI * BLOCKS_PER_CLUSTER;
-      if((error = soLoadDirRefClust(pcn)) != 0)
+      if((error = soLoadRefClustH(pcn, &hD)) != 0)
         return error;
-      p_cltD = soGetDirRefClust();
+      p_cltD = soGetRefClustH(hD);
 
       p_cltD->ref[kD] = n_cluster;
       p_inode->clucount++;
 
       // stores direct references cluster
-      if((error = soStoreDirRefClust()) != 0)
+      if((error = soStoreRefClustH(hD)) != 0)
         return error;
 
       // maps new cluster
@@ -625,9 +794,9 @@ static int soHandleDIndirect (SOSuperBlock *p_sb, uint32_t nInode, SOInode *p_in
       // calculates phisical cluster number
       pcn = p_sb->dzone_start + p_inode->i2*BLOCKS_PER_CLUSTER;
       // loads single indirect references cluster
-      if((error = soLoadSngIndRefClust(pcn)) != 0)
+      if((error = soLoadRefClustH(pcn, &hSI)) != 0)
         return error;
-      p_cltSI = soGetSngIndRefClust();
+      p_cltSI = soGetRefClustH(hSI);
 
       // calculates single indirect reference index
       kSI = (clustInd-N_DIRECT-RPC)/RPC;
@@ -641,9 +810,9 @@ static int soHandleDIndirect (SOSuperBlock *p_sb, uint32_t nInode, SOInode *p_in
       // calculates phisical cluster number
       pcn = p_sb->dzone_start + (p_cltSI->ref[kSI] * BLOCKS_PER_CLUSTER);
       // loads sdirect references data cluster
-      if((error = soLoadDirRefClust(pcn)) != 0)
+      if((error = soLoadRefClustH(pcn, &hD)) != 0)
         return error;
-      p_cltD = soGetDirRefClust();
+      p_cltD = soGetRefClustH(hD);
 
       // calculates direct reference index
       kD = clustInd-N_DIRECT-(RPC*(kSI+1));
@@ -666,9 +835,9 @@ static int soHandleDIndirect (SOSuperBlock *p_sb, uint32_t nInode, SOInode *p_in
       // calculates phisical number single indirect references cluster
       pcn = p_sb->dzone_start + p_inode->i2 * BLOCKS_PER_CLUSTER;
       // loads single indirect references cluster
-      if((error = soLoadSngIndRefClust(pcn)) != 0)
+      if((error = soLoadRefClustH(pcn, &hSI)) != 0)
         return error;
-      p_cltSI = soGetSngIndRefClust();
+      p_cltSI = soGetRefClustH(hSI);
 
       // calculates single indirect references index
       kSI = (clustInd-N_DIRECT-RPC)/RPC;
@@ -679,9 +848,9 @@ static int soHandleDIndirect (SOSuperBlock *p_sb, uint32_t nInode, SOInode *p_in
       // calculates phisical number of direct references cluster
       pcn = p_sb->dzone_start + p_cltSI->ref[kSI] * BLOCKS_PER_CLUSTER;
       // loads direct references cluster
-      if((error = soLoadDirRefClust(pcn)) != 0)
+      if((error = soLoadRefClustH(pcn, &hD)) != 0)
         return error;
-      p_cltD = soGetDirRefClust();
+      p_cltD = soGetRefClustH(hD);
 
       // calculates direct references index
       kD = clustInd-N_DIRECT-(RPC*(kSI+1));
@@ -706,7 +875,7 @@ static int soHandleDIndirect (SOSuperBlock *p_sb, uint32_t nInode, SOInode *p_in
         p_inode->clucount--;
 
 	// stores changes to direct refs cluster
-        if((error = soStoreDirRefClust()) != 0)
+        if((error = soStoreRefClustH(hD)) != 0)
           return error;
 
         // checks if direct references cluster has 0 references
@@ -729,14 +898,14 @@ static int soHandleDIndirect (SOSuperBlock *p_sb, uint32_t nInode, SOInode *p_in
           // decrement inode cluster count
           p_inode->clucount--;
           // stores changes to ind refs cluster
-          if((error = soStoreSngIndRefClust()) != 0)
+          if((error = soStoreRefClustH(hSI)) != 0)
             return error;
 
         }
         pcn = p_sb->dzone_start + p_inode->i2 * BLOCKS_PER_CLUSTER;
-        if((error = soLoadSngIndRefClust(pcn)) != 0)
+        if((error = soLoadRefClustH(pcn, &hSI)) != 0)
           return error;
-        p_cltSI = soGetSngIndRefClust();
+        p_cltSI = soGetRefClustH(hSI);
 
         // checks if single indirect references cluster has 0 references
         iflagSI = 1;
@@ -766,6 +935,102 @@ static int soHandleDIndirect (SOSuperBlock *p_sb, uint32_t nInode, SOInode *p_in
   return 0;
 }
 
+/**
+ *  \brief Handle of a file data cluster which belongs to the tree of extents.
+ *
+ *  \param p_sb pointer to a buffer where the superblock data is stored
+ *  \param nInode number of the inode associated to the file
+ *  \param p_inode pointer to a buffer which stores the inode contents
+ *  \param clustInd index to the list of direct references belonging to the inode which is referred
+ *  \param op operation to be performed (GET, ALLOC, FREE, FREE AND CLEAN, CLEAN)
+ *  \param p_outVal pointer to a location where the physical number of the data cluster is to be stored (GET / ALLOC);
+ *                  in the other cases (FREE / FREE AND CLEAN / CLEAN) it is not used (in these cases, it should be set
+ *                  to \c NULL)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EDCMINVAL, if the mapping association of the data cluster is invalid
+ *  \return -\c EDCARDYIL, if the referenced data cluster is already in the tree of extents (ALLOC)
+ *  \return -\c EDCNOTIL, if the referenced data cluster is not in the tree of extents (FREE / FREE AND CLEAN / CLEAN)
+ *  \return -\c EFBIG, if the tree of extents has no room for another extent
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails reading or writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+static int soHandleExtent (SOSuperBlock *p_sb, uint32_t nInode, SOInode *p_inode, uint32_t clustInd, uint32_t op,
+                           uint32_t *p_outVal)
+{
+  int error;
+  uint32_t map[2], n_cluster;
+
+  switch(op)
+  {
+    case GET:
+      return soExtentLookup(p_inode, clustInd, 1, p_outVal);
+
+    case ALLOC:
+    {
+      // the new cluster should follow the previous one, so that it extends its extent
+      if(clustInd > 0)
+      {
+        if((error = soExtentLookup(p_inode, clustInd - 1, 2, map)) != 0)
+          return error;
+      }
+      else
+      {
+        map[0] = NULL_CLUSTER;
+        if((error = soExtentLookup(p_inode, 0, 1, &map[1])) != 0)
+          return error;
+      }
+      if(map[1] != NULL_CLUSTER)
+        return -EDCARDYIL;
+
+      if((error = soAllocDataClusters(map[0], 1, p_outVal)) != 0)
+        return error;
+      if((error = soMapDCtoIn(nInode, *p_outVal)) != 0)
+        return error;
+      p_inode->clucount++;
+
+      // if there is no room for it in the tree, the cluster is given back
+      if((error = soExtentInsert(nInode, p_inode, clustInd, *p_outVal)) != 0)
+      {
+        soUnmapDCtoIn(nInode, *p_outVal);
+        soFreeDataCluster(*p_outVal);
+        p_inode->clucount--;
+        return error;
+      }
+      return 0;
+    }
+
+    case FREE:
+    {
+      if((error = soExtentLookup(p_inode, clustInd, 1, &n_cluster)) != 0)
+        return error;
+      if(n_cluster == NULL_CLUSTER)
+        return -EDCNOTIL;
+      return soFreeDataCluster(n_cluster);
+    }
+
+    case FREE_CLEAN:
+    case CLEAN:
+    {
+      // the cluster is removed from the tree before it is freed and dissociated from the inode
+      if((error = soExtentRemove(nInode, p_inode, clustInd, &n_cluster)) != 0)
+        return error;
+      if(op == FREE_CLEAN)
+        if((error = soFreeDataCluster(n_cluster)) != 0)
+          return error;
+      if((error = soUnmapDCtoIn(nInode, n_cluster)) != 0)
+        return error;
+      p_inode->clucount--;
+      return 0;
+    }
+  }
+
+  return -EINVAL;
+}
+
 /**
  *  \brief Associate the data cluster to the inode which describes the file.
  *
@@ -790,7 +1055,7 @@ static int soMapDCtoIn (uint32_t nInode, uint32_t nClust)
 	p_sb = soGetSuperBlock();
 	if(nClust<1 || (nClust > p_sb-> dzone_total -1))
 		return -EINVAL;
-	if(nInode == 0 || nInode >= (p_sb->itotal))
+	if(nInode >= (p_sb->itotal))
 		return -EINVAL;
 	
 	if((stat = soConvertRefCInMT(nClust, &p_blk, &p_off))!= 0)
@@ -833,7 +1098,7 @@ static int soUnmapDCtoIn (uint32_t nInode, uint32_t nClust)
 	if(nClust<1 || (nClust > p_sb-> dzone_total -1))
 		return -EINVAL;
 
-	if(nInode == 0 || nInode >= (p_sb->itotal))
+	if(nInode >= (p_sb->itotal))
 		return -EINVAL;
 	
 	if((stat = soConvertRefCInMT(nClust, &p_blk, &p_off))!= 0)
@@ -857,3 +1122,31 @@ static int soUnmapDCtoIn (uint32_t nInode, uint32_t nClust)
 
   	return 0;
 }
+
+/*
+ *  Get count successive references of a cluster of references, starting at index first (they are all NULL_CLUSTER, if
+ *  the cluster of references has not been allocated yet).
+ */
+
+static int soGetRefs (SOSuperBlock *p_sb, uint32_t nRefClust, uint32_t first, uint32_t count, uint32_t *nClust)
+{
+  int error;
+  uint32_t hD, i;
+  SODataClust *p_clt;
+
+  if(nRefClust == NULL_CLUSTER)
+  {
+    for(i = 0; i < count; i++)
+      nClust[i] = NULL_CLUSTER;
+    return 0;
+  }
+
+  if((error = soLoadRefClustH(p_sb->dzone_start + nRefClust * BLOCKS_PER_CLUSTER, &hD)) != 0)
+    return error;
+  if((p_clt = soGetRefClustH(hD)) == NULL)
+    return -ELIBBAD;
+  for(i = 0; i < count; i++)
+    nClust[i] = p_clt->ref[first + i];
+
+  return 0;
+}
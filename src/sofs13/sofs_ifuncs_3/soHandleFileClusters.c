@@ -5,6 +5,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <inttypes.h>
 #include <stdbool.h>
 #include <errno.h>
@@ -18,6 +19,10 @@
 #include "sofs_basicconsist.h"
 #include "sofs_ifuncs_1.h"
 #include "sofs_ifuncs_2.h"
+#include "sofs_clustmap.h"
+#include "sofs_extent.h"
+#include "sofs_inline.h"
+#include "sofs_compress.h"
 
 /** \brief operation get the physical number of the referenced data cluster */
 #define GET         0
@@ -30,9 +35,14 @@
 /** \brief operation dissociate the referenced data cluster from the inode which describes the file */
 #define CLEAN       4
 
-/* Allusion to external function */
+/* Allusion to internal functions */
 
-extern int soHandleFileCluster (uint32_t nInode, uint32_t clustInd, uint32_t op, uint32_t *p_outVal);
+static int handleRefClust (SOSuperBlock *p_sb, uint32_t nRefClust, uint32_t first, uint32_t op, uint32_t *nClust,
+                           uint32_t max, uint32_t *p_n, bool *p_empty);
+static int loadRefClust (SOSuperBlock *p_sb, uint32_t nRefClust, SODataClust *p_clust);
+static int storeRefClust (SOSuperBlock *p_sb, uint32_t nRefClust, const SODataClust *p_clust);
+static int unmapClusters (uint32_t nInode, uint32_t count, uint32_t *nClust, bool strict);
+static int cmpClust (const void *a, const void *b);
 
 /**
  *  \brief Handle all data clusters from the list of references starting at a given point.
@@ -51,11 +61,21 @@ extern int soHandleFileCluster (uint32_t nInode, uint32_t clustInd, uint32_t op,
  *                    describes the file.
  *
  *  Depending on the operation, the field <em>clucount</em> and the lists of direct references, single indirect
- *  references and double indirect references to data clusters of the inode associated to the file are updated.
+ *  references and double indirect references to data clusters of the inode associated to the file are updated (or its
+ *  tree of extents, if the inode mode signals it). If the information content of the file is stored in the inode
+ *  itself, there are no data clusters and it is just cleared by the operation FREE_CLEAN from index 0 onwards. If the
+ *  data clusters of the file are compressed, the group holding the referenced data cluster, if it is not the first of
+ *  its group, is compressed again without the data clusters from it onwards and the following groups are freed.
  *
  *  Thus, the inode must be in use and belong to one of the legal file types for the operations FREE and FREE_CLEAN and
  *  must be free in the dirty state for the operation CLEAN.
  *
+ *  The lists of references are traversed only once, collecting the logical numbers of the data clusters involved, and
+ *  the inode is written only once. The mapping associations are then removed and the clusters freed in batches, block
+ *  by block of the tables involved, the former always before the latter, so that a cluster can not be reallocated
+ *  while it is still associated to the inode. On the operation CLEAN, the data clusters which were meanwhile
+ *  reallocated to another file are just dropped from the lists of references.
+ *
  *  \param nInode number of the inode associated to the file
  *  \param clustIndIn index to the list of direct references belonging to the inode which is referred (it contains the
  *                    index of the first data cluster to be processed)
@@ -67,6 +87,9 @@ extern int soHandleFileCluster (uint32_t nInode, uint32_t clustInd, uint32_t op,
  *  \return -\c EIUININVAL, if the inode in use is inconsistent
  *  \return -\c EFDININVAL, if the free inode in the dirty state is inconsistent
  *  \return -\c ELDCININVAL, if the list of data cluster references belonging to an inode is inconsistent
+ *  \return -\c EDCMINVAL, if the mapping association of the data cluster is invalid
+ *  \return -\c EDCNALINVAL, if a data cluster to be freed has not been previously allocated
+ *  \return -\c ENOMEM, if there is no memory to hold the logical numbers of the data clusters
  *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
  *  \return -\c EBADF, if the device is not already opened
  *  \return -\c EIO, if it fails reading or writing
@@ -79,10 +102,11 @@ int soHandleFileClusters (uint32_t nInode, uint32_t clustIndIn, uint32_t op)
 
 	/*Declaracao de Variaveis*/
 	SOSuperBlock *p_sb;
-	SODataClust *p_ref;
-	SODataClust ref1,ref2;
-	uint32_t nclust;
-	int stat, offset,idx;	
+	SODataClust cltSI;
+	uint32_t *data, *nodes, refs[RPC+2];
+	uint32_t nData, nRefs, before, first, idx, i;
+	int stat;
+	bool empty, changed, ext;
 	SOInode p_inode;
 
 	/*Validacao de parametros*/
@@ -90,19 +114,15 @@ int soHandleFileClusters (uint32_t nInode, uint32_t clustIndIn, uint32_t op)
 	if((stat = soLoadSuperBlock())!=0)
 		return stat;
 	p_sb = soGetSuperBlock();
-	
-	
-     
+
 	/* Validacao do nInode */
 	if(nInode >= p_sb->itotal)
 		return -EINVAL;
-	
-	     
+
 	/* Validacao da op*/
 	if(op != FREE && op != FREE_CLEAN && op != CLEAN)
 		return -EINVAL;
-	
-	
+
 	if(op !=CLEAN){
 		if((stat = soReadInode(&p_inode, nInode, IUIN)) !=0)
 			return stat;
@@ -111,83 +131,253 @@ int soHandleFileClusters (uint32_t nInode, uint32_t clustIndIn, uint32_t op)
 		if((stat = soReadInode(&p_inode, nInode, FDIN)) !=0)
 			return stat;
 	}
-	     
+
 	/* Verifica se ClustIndIn está fora do range permitido*/ 
 	if(clustIndIn >= MAX_FILE_CLUSTERS)
 		return -EINVAL;
 
-	/*Execucao da operacao pretendida*/
-	//Duplamente Indirectas
-	if(p_inode.i2!= NULL_CLUSTER){
-		nclust = (p_sb->dzone_start + (p_inode.i2*BLOCKS_PER_CLUSTER));
-		if((stat = soLoadSngIndRefClust(nclust))!=0)
+	/*The map of the open file is no longer valid from clustIndIn on*/
+	soClustMapInvalidate(nInode, clustIndIn, MAX_FILE_CLUSTERS);
+
+	/*Contents stored in the inode itself: there are no clusters, only cleaning from index 0 applies*/
+	if(INODE_IS_INLINE(p_inode.mode)){
+		if((op != FREE_CLEAN) || (clustIndIn != 0))
+			return 0;
+		soInlineTrim(&p_inode, 0);
+		return soWriteInode(&p_inode, nInode, IUIN);
+	}
+
+	/*Compressed clusters: the group split by the index is rewritten and only the following groups are freed*/
+	if(INODE_IS_COMPRESSED(p_inode.mode) && (op != CLEAN)){
+		if((stat = soCompressTrim(nInode, clustIndIn, &clustIndIn)) != 0)
+			return stat;
+		soCompressDrop(nInode, clustIndIn);
+		if(clustIndIn >= MAX_FILE_CLUSTERS)
+			return 0;
+		if((stat = soReadInode(&p_inode, nInode, IUIN)) != 0)
 			return stat;
-		
-		p_ref = soGetSngIndRefClust();
-		ref1 = *p_ref;
-		if(clustIndIn >= N_DIRECT+RPC){
-				idx = (clustIndIn - (N_DIRECT+RPC))/RPC;
-				offset = (clustIndIn -(N_DIRECT+RPC))%RPC;
+	}
 
+	/*The data clusters (and the reference clusters left empty) are collected in a single traversal*/
+	if((data = malloc((p_inode.clucount + 1) * sizeof(uint32_t))) == NULL)
+		return -ENOMEM;
+	nData = nRefs = 0;
+	stat = 0;
+
+	//Tree of extents: the nodes left empty are collected as the reference clusters are
+	ext = (p_inode.mode & INODE_EXTENTS) != 0;
+	nodes = refs;
+	if(ext){
+		if((nodes = malloc((p_inode.clucount + 1) * sizeof(uint32_t))) == NULL){
+			free(data);
+			return -ENOMEM;
 		}
-		else{
-			idx =offset= 0;
-		}
+		stat = soExtentTruncate(&p_inode, clustIndIn, op == FREE, p_inode.clucount + 1, data, &nData, nodes, &nRefs);
+		//a cleaned inode no longer has a tree of extents
+		if((stat == 0) && (op == CLEAN) && (clustIndIn == 0))
+			p_inode.mode &= ~INODE_FMT_MASK;
+	}
+	else{
+		//Directas
+		for(i = clustIndIn; (i < N_DIRECT) && (stat == 0); i++)
+			if(p_inode.d[i] != NULL_CLUSTER){
+				if(nData == p_inode.clucount)
+					stat = -ELDCININVAL;
+				else data[nData++] = p_inode.d[i];
+				if(op != FREE)
+					p_inode.d[i] = NULL_CLUSTER;
+			}
 
-		for(; idx<RPC;idx++){
-			if(ref1.ref[idx]!=NULL_CLUSTER){
-				nclust = p_sb->dzone_start + (ref1.ref[idx]*BLOCKS_PER_CLUSTER);
-				if((stat = soLoadSngIndRefClust(nclust))!=0)
-					return stat;
-				p_ref= soGetSngIndRefClust();
-				ref2 = *p_ref;
+		//Indirectas
+		if((stat == 0) && (p_inode.i1 != NULL_CLUSTER) && (clustIndIn < N_DIRECT + RPC)){
+			first = (clustIndIn > N_DIRECT) ? clustIndIn - N_DIRECT : 0;
+			stat = handleRefClust(p_sb, p_inode.i1, first, op, data, p_inode.clucount, &nData, &empty);
+			if((stat == 0) && (op != FREE) && empty){
+				refs[nRefs++] = p_inode.i1;
+				p_inode.i1 = NULL_CLUSTER;
+			}
+		}
 
-				for(; offset<RPC; offset++){
-					if(ref2.ref[offset]!= NULL_CLUSTER)
-						if((stat = soHandleFileCluster(nInode, (offset+(idx*RPC) + RPC + N_DIRECT),op,NULL))!=-0) 
-							return stat;
+		//Duplamente Indirectas
+		if((stat == 0) && (p_inode.i2 != NULL_CLUSTER)){
+			if(clustIndIn >= N_DIRECT + RPC){
+				idx = (clustIndIn - (N_DIRECT + RPC)) / RPC;
+				first = (clustIndIn - (N_DIRECT + RPC)) % RPC;
+			}
+			else idx = first = 0;
 
+			if((stat = loadRefClust(p_sb, p_inode.i2, &cltSI)) == 0){
+				changed = false;
+				for(; (idx < RPC) && (stat == 0); idx++, first = 0)
+					if(cltSI.ref[idx] != NULL_CLUSTER){
+						stat = handleRefClust(p_sb, cltSI.ref[idx], first, op, data, p_inode.clucount, &nData, &empty);
+						if((stat == 0) && (op != FREE) && empty){
+							refs[nRefs++] = cltSI.ref[idx];
+							cltSI.ref[idx] = NULL_CLUSTER;
+							changed = true;
+						}
+					}
+				if(stat == 0){
+					for(i = 0, empty = true; (i < RPC) && empty; i++)
+						empty = (cltSI.ref[i] == NULL_CLUSTER);
+					if((op != FREE) && empty){
+						refs[nRefs++] = p_inode.i2;
+						p_inode.i2 = NULL_CLUSTER;
+					}
+					else if(changed)
+						stat = storeRefClust(p_sb, p_inode.i2, &cltSI);
 				}
-		
-
 			}
-			offset = 0;
 		}
-
 	}
-	//Indirectas
-	if(p_inode.i1!=NULL_CLUSTER && clustIndIn < N_DIRECT +RPC){
-		nclust = (p_sb->dzone_start + (p_inode.i1*BLOCKS_PER_CLUSTER));
-		if((stat = soLoadSngIndRefClust(nclust))!=0)
-			return stat;
-		p_ref = soGetSngIndRefClust();
-		ref1 = *p_ref;
-		if(clustIndIn >= N_DIRECT){
-			idx = clustIndIn - N_DIRECT;
-		}
-		else
-			idx = 0;
-
-		for(; idx<RPC; idx++){
-			if(ref1.ref[idx] != NULL_CLUSTER){
-				if((stat = soHandleFileCluster(nInode, idx + N_DIRECT,op,NULL))!=0)
-					return stat;
-			
-			}
 
+	/*The inode is written only once*/
+	if((stat == 0) && (op != FREE)){
+		before = p_inode.clucount;
+		if(nData + nRefs > before)
+			stat = -ELDCININVAL;
+		else{
+			p_inode.clucount -= nData + nRefs;
+			stat = soWriteInode(&p_inode, nInode, (op == CLEAN) ? FDIN : IUIN);
 		}
 	}
-	//Directas
-	if(clustIndIn < N_DIRECT){
-		for(;clustIndIn<N_DIRECT; clustIndIn++){
-			if(p_inode.d[clustIndIn]!= NULL_CLUSTER){
-				if((stat = soHandleFileCluster(nInode,clustIndIn,op, NULL)) != 0)
-					return stat;
-			}
+
+	/*The clusters are dissociated before they are freed*/
+	if((stat == 0) && (op != FREE))
+		stat = unmapClusters(nInode, nData, data, op != CLEAN);
+	if((stat == 0) && (op != FREE))
+		stat = unmapClusters(nInode, nRefs, nodes, true);
+	if((stat == 0) && (op != CLEAN))
+		stat = soFreeDataClusters(nData, data);
+	if(stat == 0)
+		stat = soFreeDataClusters(nRefs, nodes);
+
+	free(data);
+	if(ext)
+		free(nodes);
+
+	return stat;
+}
+
+/*
+ *  Collect the data clusters referenced by a cluster of direct references, from index first onwards, into the array
+ *  nClust, whose size is max, starting at position *p_n. Unless the operation is FREE, the references are cleared and
+ *  the cluster is stored, except if it became empty (*p_empty tells whether it did), since it is then to be freed.
+ */
+
+static int handleRefClust (SOSuperBlock *p_sb, uint32_t nRefClust, uint32_t first, uint32_t op, uint32_t *nClust,
+                           uint32_t max, uint32_t *p_n, bool *p_empty)
+{
+	SODataClust clt;
+	uint32_t i;
+	int stat;
+
+	if((stat = loadRefClust(p_sb, nRefClust, &clt)) != 0)
+		return stat;
+
+	for(i = first; i < RPC; i++)
+		if(clt.ref[i] != NULL_CLUSTER){
+			if(*p_n == max)
+				return -ELDCININVAL;
+			nClust[*p_n] = clt.ref[i];
+			*p_n += 1;
+			if(op != FREE)
+				clt.ref[i] = NULL_CLUSTER;
 		}
+
+	for(i = 0, *p_empty = true; (i < RPC) && *p_empty; i++)
+		*p_empty = (clt.ref[i] == NULL_CLUSTER);
+
+	if((op != FREE) && !*p_empty && (first < RPC))
+		return storeRefClust(p_sb, nRefClust, &clt);
+
+	return 0;
+}
+
+/*
+ *  Copy a cluster of references into internal storage.
+ */
+
+static int loadRefClust (SOSuperBlock *p_sb, uint32_t nRefClust, SODataClust *p_clust)
+{
+	uint32_t h;
+	SODataClust *p_ref;
+	int stat;
+
+	if((stat = soLoadRefClustH(p_sb->dzone_start + nRefClust * BLOCKS_PER_CLUSTER, &h)) != 0)
+		return stat;
+	if((p_ref = soGetRefClustH(h)) == NULL)
+		return -ELIBBAD;
+	*p_clust = *p_ref;
+
+	return 0;
+}
+
+/*
+ *  Write a cluster of references from internal storage.
+ */
+
+static int storeRefClust (SOSuperBlock *p_sb, uint32_t nRefClust, const SODataClust *p_clust)
+{
+	uint32_t h;
+	SODataClust *p_ref;
+	int stat;
+
+	if((stat = soLoadRefClustH(p_sb->dzone_start + nRefClust * BLOCKS_PER_CLUSTER, &h)) != 0)
+		return stat;
+	if((p_ref = soGetRefClustH(h)) == NULL)
+		return -ELIBBAD;
+	*p_ref = *p_clust;
+
+	return soStoreRefClustH(h);
+}
+
+/*
+ *  Remove the mapping association of a group of data clusters to the inode, block by block of the table of
+ *  cluster-to-inode mapping (the array is sorted in place). If strict is false, clusters associated to another inode are
+ *  skipped, otherwise they are an error.
+ */
+
+static int unmapClusters (uint32_t nInode, uint32_t count, uint32_t *nClust, bool strict)
+{
+	uint32_t *cTInT, nBlk, off, loaded, i;
+	int stat;
+
+	qsort(nClust, count, sizeof(uint32_t), cmpClust);
+
+	loaded = NULL_CLUSTER;
+	cTInT = NULL;
+	for(i = 0; i < count; i++){
+		if((stat = soConvertRefCInMT(nClust[i], &nBlk, &off)) != 0)
+			return stat;
+		if(nBlk != loaded){
+			if((loaded != NULL_CLUSTER) && ((stat = soStoreBlockCTInMT()) != 0))
+				return stat;
+			if((stat = soLoadBlockCTInMT(nBlk)) != 0)
+				return stat;
+			if((cTInT = soGetBlockCTInMT()) == NULL)
+				return -ELIBBAD;
+			loaded = nBlk;
+		}
+		if(cTInT[off] == nInode)
+			cTInT[off] = NULL_INODE;
+		else if(strict)
+			return -EDCMINVAL;
 	}
-	
-	
 
-  return 0;
+	if(loaded != NULL_CLUSTER)
+		return soStoreBlockCTInMT();
+
+	return 0;
+}
+
+/*
+ *  Compare two data cluster references (for sorting).
+ */
+
+static int cmpClust (const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+
+	return (x > y) - (x < y);
 }
@@ -8,6 +8,8 @@
 #include <inttypes.h>
 #include <stdbool.h>
 #include <errno.h>
+#include <string.h>
+#include <pthread.h>
 
 #include "sofs_probe.h"
 #include "sofs_buffercache.h"
@@ -16,8 +18,12 @@
 #include "sofs_datacluster.h"
 #include "sofs_basicoper.h"
 #include "sofs_basicconsist.h"
+#include "sofs_extent.h"
+#include "sofs_inline.h"
+#include "sofs_compress.h"
 #include "sofs_ifuncs_1.h"
 #include "sofs_ifuncs_2.h"
+#include "sofs_ifuncs_3.h"
 
 /** \brief operation get the physical number of the referenced data cluster */
 #define GET         0
@@ -30,9 +36,41 @@
 /** \brief operation dissociate the referenced data cluster from the inode which describes the file */
 #define CLEAN       4
 
-/* Allusion to external function */
+/** \brief number of inodes whose sequential access is tracked */
+#define RA_SLOTS       16
+/** \brief initial number of data clusters prefetched, once sequential access is detected */
+#define RA_MIN_WINDOW  4
+/** \brief maximum number of data clusters prefetched ahead of the one being read */
+#define RA_MAX_WINDOW  64
+/** \brief number of data clusters whose logical numbers are got at a time, when a group of them is read */
+#define MAP_RUN        64
 
-extern int soHandleFileCluster (uint32_t nInode, uint32_t clustInd, uint32_t op, uint32_t *p_outVal);
+/** \brief sequential access state of an inode */
+typedef struct soReadAhead
+{
+   /** \brief signals if the slot is in use */
+    uint32_t used;
+   /** \brief number of the inode */
+    uint32_t nInode;
+   /** \brief index of the data cluster last read */
+    uint32_t lastInd;
+   /** \brief number of data clusters to be kept prefetched ahead of the one being read (zero, if the access is not
+    *         sequential) */
+    uint32_t window;
+   /** \brief index of the next data cluster to be prefetched */
+    uint32_t nextInd;
+} SOReadAhead;
+
+/** \brief sequential access state of the inodes most recently read */
+static SOReadAhead ra[RA_SLOTS];
+/** \brief next slot to be reused */
+static uint32_t raVictim = 0;
+/** \brief access lock to the sequential access state */
+static pthread_mutex_t raCR = PTHREAD_MUTEX_INITIALIZER;
+
+/* Allusion to internal function */
+
+static void readAhead (SOSuperBlock *p_sb, uint32_t nInode, uint32_t firstInd, uint32_t lastInd);
 
 /**
  *  \brief Read a specific data cluster.
@@ -41,7 +79,12 @@ extern int soHandleFileCluster (uint32_t nInode, uint32_t clustInd, uint32_t op,
  *  file, a directory or a symbolic link). Thus, the inode must be in use and belong to one of the legal file types.
  *
  *  If the cluster has not been allocated yet, the returned data will consist of a cluster whose byte stream contents
- *  is filled with the character null (ascii code 0).
+ *  is filled with the character null (ascii code 0). If the information content of the file is stored in the inode
+ *  itself, it is returned as the data cluster of index 0. If the data clusters of the file are compressed, the group
+ *  holding the data cluster is decompressed.
+ *
+ *  When the data clusters of a file are read in succession, the following ones are prefetched into the buffercache in
+ *  the background, the number of data clusters kept ahead growing while the access remains sequential.
  *
  *  \param nInode number of the inode associated to the file
  *  \param clustInd index to the list of direct references belonging to the inode where data is to be read from
@@ -68,6 +111,13 @@ int soReadFileCluster (uint32_t nInode, uint32_t clustInd, void *buff)
 	uint32_t p_outVal;
 	uint32_t nBloco,offset;
 
+	if((error = soLoadSuperBlock()) != 0)
+	{
+		return error;
+	}
+
+	p_sb = soGetSuperBlock();
+
 	// o número do nó-i tem que ter valores válidos
 	if(nInode >= p_sb->itotal || nInode < 0)
 		return -EINVAL;
@@ -80,24 +130,30 @@ int soReadFileCluster (uint32_t nInode, uint32_t clustInd, void *buff)
 	if(buff == NULL)
 		return -EINVAL;
 
-	if((error = soLoadSuperBlock()) != 0)
-	{
-		return error;
-	}
-
-	p_sb = soGetSuperBlock();
-
 	// Validação de consistência
 	soConvertRefInT(nInode, &nBloco, &offset);
 	soLoadBlockInT(nBloco);
 	SOInode *p_inode = soGetBlockInT();
 
 	// o nó-i referenciado tem que estar em uso e estar associado a um tipo válido
-	if((error = soQCheckInodeIU(p_sb,  p_inode)) != 0)
+	if((error = soQCheckInodeExtIU(p_sb,  &p_inode[offset])) != 0)
 	{
 		return error;
 	}
 
+	// the contents stored in the inode itself are read from the block of the table of inodes just loaded
+	if(INODE_IS_INLINE(p_inode[offset].mode))
+	{
+		if(clustInd == 0)
+			soInlineRead(&p_inode[offset], buff);
+		else memset(buff, 0, BSLPC);
+		return 0;
+	}
+
+	// compressed clusters are got from their group, once it is decompressed
+	if(INODE_IS_COMPRESSED(p_inode[offset].mode))
+		return soCompressRead(nInode, clustInd, 1, buff);
+
 	// obter o número lógico do cluster
 	if((error = soHandleFileCluster(nInode, clustInd, GET, &p_outVal)))
 		return error;
@@ -113,9 +169,187 @@ int soReadFileCluster (uint32_t nInode, uint32_t clustInd, void *buff)
 	else
 			soReadCacheCluster(p_outVal*BLOCKS_PER_CLUSTER + p_sb->dzone_start, buff);
 
+	// prefetch the following clusters, if the access is sequential
+	readAhead(p_sb, nInode, clustInd, clustInd);
+
 	// guarda as alterações
 	if((error = soStoreSuperBlock()))
 		return error;
 
 	return 0;
 	}
+
+/**
+ *  \brief Read a group of successive data clusters.
+ *
+ *  Data is read from <tt>count</tt> successive data clusters, starting at a given index to the list of direct
+ *  references, which are supposed to belong to an inode associated to a file (a regular file, a directory or a
+ *  symbolic link). Thus, the inode must be in use and belong to one of the legal file types.
+ *
+ *  The logical numbers of the data clusters are got once for each cluster of references involved and the data clusters
+ *  which are stored in successive clusters of the data zone are read by a single transfer. The data clusters which
+ *  have not been allocated yet are returned filled with the character null (ascii code 0). If the information content
+ *  of the file is stored in the inode itself, it is returned as the data cluster of index 0. If the data clusters of
+ *  the file are compressed, each group involved is decompressed once.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param firstInd index to the list of direct references belonging to the inode where data is to be read from
+ *  \param count number of data clusters to be read
+ *  \param buff pointer to the buffer where data must be read into (it must hold <tt>count</tt> data clusters)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>inode number</em> or the <em>range of indexes to the list of direct references</em>
+ *                      are out of range or the <em>pointer to the buffer area</em> is \c NULL
+ *  \return -\c EIUININVAL, if the inode in use is inconsistent
+ *  \return -\c ELDCININVAL, if the list of data cluster references belonging to an inode is inconsistent
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails reading or writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soReadFileClusters (uint32_t nInode, uint32_t firstInd, uint32_t count, void *buff)
+{
+	soColorProbe (416, "07;31", "soReadFileClusters (%"PRIu32", %"PRIu32", %"PRIu32", %p)\n", nInode, firstInd, count,
+	              buff);
+
+	int error;
+	SOSuperBlock *p_sb;
+	SOInode inode;
+	uint32_t map[MAP_RUN];
+	uint32_t ind, k, i, run;
+	unsigned char *p_buff = buff;
+
+	if((error = soLoadSuperBlock()) != 0)
+		return error;
+	p_sb = soGetSuperBlock();
+
+	// the parameters must have valid values
+	if((nInode >= p_sb->itotal) || (buff == NULL) || ((uint64_t) firstInd + count > MAX_FILE_CLUSTERS))
+		return -EINVAL;
+	if(count == 0)
+		return 0;
+
+	// the contents stored in the inode itself are the only cluster which is not zero
+	if((error = soReadInode(&inode, nInode, IUIN)) != 0)
+		return error;
+	if((firstInd == 0) && INODE_IS_INLINE(inode.mode))
+	{
+		soInlineRead(&inode, p_buff);
+		memset(p_buff + BSLPC, 0, (size_t) (count - 1) * BSLPC);
+		return 0;
+	}
+
+	// compressed clusters are got from their groups, each one decompressed only once
+	if(INODE_IS_COMPRESSED(inode.mode))
+		return soCompressRead(nInode, firstInd, count, buff);
+
+	for(ind = firstInd; ind < firstInd + count; ind += k)
+	{
+		// get the logical numbers of a group of clusters (which also checks the consistency of the inode)
+		k = (firstInd + count - ind < MAP_RUN) ? firstInd + count - ind : MAP_RUN;
+		if((error = soGetFileClusters(nInode, ind, k, map)) != 0)
+			return error;
+
+		// the unallocated clusters are zeroed and those contiguous in the data zone are read at once
+		for(i = 0; i < k; i += run)
+		{
+			if(map[i] == NULL_CLUSTER)
+			{
+				memset(p_buff + (size_t) (ind - firstInd + i) * BSLPC, 0, BSLPC);
+				run = 1;
+				continue;
+			}
+			for(run = 1; (i + run < k) && (map[i + run] == map[i] + run); run++);
+			if((error = soReadCacheClusters(p_sb->dzone_start + map[i] * BLOCKS_PER_CLUSTER, run,
+			                                p_buff + (size_t) (ind - firstInd + i) * BSLPC)) != 0)
+				return error;
+		}
+	}
+
+	// prefetch the following clusters, if the access is sequential (long groups are read directly from the
+	// device, bypassing the buffercache, and there is no gain in keeping the following ones in it)
+	if(count < DIRECT_RUN)
+		readAhead(p_sb, nInode, firstInd, firstInd + count - 1);
+
+	// store the changes
+	if((error = soStoreSuperBlock()))
+		return error;
+
+	return 0;
+}
+
+/*
+ *  Prefetch the data clusters which follow the ones just read (from index firstInd to index lastInd), if the data
+ *  clusters of the file are being read in succession: the number of data clusters kept ahead starts at RA_MIN_WINDOW
+ *  and doubles at each sequential read, up to RA_MAX_WINDOW. Prefetching stops at the first data cluster not allocated.
+ */
+
+static void readAhead (SOSuperBlock *p_sb, uint32_t nInode, uint32_t firstInd, uint32_t lastInd)
+{
+	SOReadAhead *p_ra;
+	uint32_t map[MAP_RUN];
+	uint32_t i, j, k, first, last;
+
+	pthread_mutex_lock(&raCR);
+	for(i = 0; (i < RA_SLOTS) && (!ra[i].used || (ra[i].nInode != nInode)); i++);
+	if(i == RA_SLOTS)
+	{
+		// first read of the inode: a slot is reused
+		p_ra = &ra[raVictim];
+		raVictim = (raVictim + 1) % RA_SLOTS;
+		p_ra->used = 1;
+		p_ra->nInode = nInode;
+		p_ra->lastInd = lastInd;
+		p_ra->window = 0;
+		p_ra->nextInd = lastInd + 1;
+		pthread_mutex_unlock(&raCR);
+		return;
+	}
+	p_ra = &ra[i];
+
+	if(firstInd == p_ra->lastInd + 1)
+		p_ra->window = (p_ra->window == 0) ? RA_MIN_WINDOW :
+		               ((2 * p_ra->window > RA_MAX_WINDOW) ? RA_MAX_WINDOW : 2 * p_ra->window);
+	else if(firstInd != p_ra->lastInd)
+		p_ra->window = 0;							// the access is no longer sequential
+	p_ra->lastInd = lastInd;
+	if(p_ra->window == 0)
+	{
+		pthread_mutex_unlock(&raCR);
+		return;
+	}
+
+	if((p_ra->nextInd <= lastInd) || (p_ra->nextInd > lastInd + 1 + p_ra->window))
+		p_ra->nextInd = lastInd + 1;
+	first = p_ra->nextInd;
+	last = lastInd + p_ra->window;
+	if(last >= MAX_FILE_CLUSTERS)
+		last = MAX_FILE_CLUSTERS - 1;
+	p_ra->nextInd = last + 1;
+	pthread_mutex_unlock(&raCR);
+
+	// the clusters are requested outside the critical region (their logical numbers are got as a group)
+	for(i = first; i <= last; i += k)
+	{
+		k = (last - i + 1 < MAP_RUN) ? last - i + 1 : MAP_RUN;
+		if(soGetFileClusters(nInode, i, k, map) != 0)
+			break;
+		for(j = 0; (j < k) && (map[j] != NULL_CLUSTER); j++)
+			soPrefetchCacheCluster(map[j]*BLOCKS_PER_CLUSTER + p_sb->dzone_start);
+		if(j < k)
+		{
+			i += j;
+			break;
+		}
+	}
+
+	if(i <= last)
+	{
+		// stopped at an unallocated cluster: it is tried again on the next read
+		pthread_mutex_lock(&raCR);
+		if(p_ra->used && (p_ra->nInode == nInode) && (p_ra->nextInd > i))
+			p_ra->nextInd = i;
+		pthread_mutex_unlock(&raCR);
+	}
+}
@@ -16,8 +16,12 @@
 #include "sofs_datacluster.h"
 #include "sofs_basicoper.h"
 #include "sofs_basicconsist.h"
+#include "sofs_direntcache.h"
+#include "sofs_dirindex.h"
 #include "sofs_ifuncs_1.h"
 #include "sofs_ifuncs_2.h"
+#include "sofs_inline.h"
+#include "sofs_compress.h"
 
 /** \brief operation get the physical number of the referenced data cluster */
 #define GET         0
@@ -30,9 +34,13 @@
 /** \brief operation dissociate the referenced data cluster from the inode which describes the file */
 #define CLEAN       4
 
-/* Allusion to external function */
+/** \brief number of data clusters whose logical numbers are got at a time, when a group of them is written */
+#define MAP_RUN     64
+
+/* Allusion to external functions */
 
 extern int soHandleFileCluster (uint32_t nInode, uint32_t clustInd, uint32_t op, uint32_t *p_outVal);
+extern int soGetFileClusters (uint32_t nInode, uint32_t firstInd, uint32_t count, uint32_t *nClust);
 
 /**
  *  \brief Write a specific data cluster.
@@ -41,7 +49,10 @@ extern int soHandleFileCluster (uint32_t nInode, uint32_t clustInd, uint32_t op,
  *  associated to a file (a regular file, a directory or a symbolic link). Thus, the inode must be in use and belong
  *  to one of the legal file types.
  *
- *  If the cluster has not been allocated yet, it will be allocated now so that data can be stored there.
+ *  If the cluster has not been allocated yet, it will be allocated now so that data can be stored there. If the
+ *  information content of the file is stored in the inode itself, it stays there when the data cluster of index 0 is
+ *  written and its bytes past the first \c INLINE_SIZE are zero; otherwise, it is moved out into a data cluster first.
+ *  If the data clusters of the file are compressed, the group holding the data cluster is compressed again.
  *
  *  \param nInode number of the inode associated to the file
  *  \param clustInd index to the list of direct references belonging to the inode where data is to be written into
@@ -63,8 +74,10 @@ int soWriteFileCluster (uint32_t nInode, uint32_t clustInd, void *buff)
 {
   soColorProbe (412, "07;31", "soWriteFileCluster (%"PRIu32", %"PRIu32", %p)\n", nInode, clustInd, buff);
 
-  uint32_t ERRO, nBlk, offset, nLogicalDC, nBlocoC;
+  uint32_t ERRO, nBlk, offset, nLogicalDC, nBlocoC, mode;
+  bool isDir;
   SOSuperBlock *p_sb;
+  SOInode ino;
 
   //Ler o superblock
   if((ERRO = soLoadSuperBlock()) != 0)
@@ -87,6 +100,27 @@ int soWriteFileCluster (uint32_t nInode, uint32_t clustInd, void *buff)
   //o inode não foi alocado
   if(inode[offset].mode == INODE_FREE)
 	  return -EINVAL;
+  isDir = ((inode[offset].mode & INODE_TYPE_MASK) == INODE_DIR);
+  mode = inode[offset].mode;
+
+  //contents stored in the inode itself: they stay there while they fit, otherwise they move to a data cluster
+  if(INODE_IS_INLINE(mode))
+  {
+	  if((ERRO = soReadInode(&ino, nInode, IUIN)) != 0)
+		  return ERRO;
+	  if((clustInd == 0) && soInlineFits(buff))
+	  {
+		  soInlineWrite(&ino, buff);
+		  return soWriteInode(&ino, nInode, IUIN);
+	  }
+	  if((ERRO = soInlineSpill(nInode, &ino)) != 0)
+		  return ERRO;
+	  mode = ino.mode;
+  }
+
+  //compressed clusters: the group of the cluster is compressed again
+  if(INODE_IS_COMPRESSED(mode))
+	  return soCompressWrite(nInode, clustInd, 1, buff);
 
   if((ERRO = soHandleFileCluster(nInode, clustInd, GET,&nLogicalDC)) != 0)
 	  return ERRO;
@@ -110,5 +144,131 @@ int soWriteFileCluster (uint32_t nInode, uint32_t clustInd, void *buff)
   if((ERRO = soWriteCacheCluster(nBlocoC, buff)) != 0)
   	return ERRO;
 
+  //the contents of a directory changed: its cached entries are no longer valid and the cluster is indexed again
+  if(isDir)
+  {
+	  soInvalidateDirEntCache(nInode);
+	  soDirIndexUpdate(nInode, clustInd, (const SODirEntry *) buff);
+  }
+
+  return 0;
+}
+
+/**
+ *  \brief Write to a group of successive data clusters.
+ *
+ *  Data is written into the information content of <tt>count</tt> successive data clusters, starting at a given index
+ *  to the list of direct references, which are supposed to belong to an inode associated to a file (a regular file, a
+ *  directory or a symbolic link). Thus, the inode must be in use and belong to one of the legal file types.
+ *
+ *  The logical numbers of the data clusters are got once for each cluster of references involved, those which have not
+ *  been allocated yet are allocated now and the data clusters which are stored in successive clusters of the data zone
+ *  are written by a single transfer. If the information content of the file is stored in the inode itself, it is moved
+ *  out into a data cluster first, unless only the data cluster of index 0 is written (as by \e soWriteFileCluster).
+ *  If the data clusters of the file are compressed, each group involved is compressed again once.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param firstInd index to the list of direct references belonging to the inode where data is to be written into
+ *  \param count number of data clusters to be written
+ *  \param buff pointer to the buffer where data must be written from (it must hold <tt>count</tt> data clusters)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>inode number</em> or the <em>range of indexes to the list of direct references</em>
+ *                      are out of range or the <em>pointer to the buffer area</em> is \c NULL
+ *  \return -\c EIUININVAL, if the inode in use is inconsistent
+ *  \return -\c ELDCININVAL, if the list of data cluster references belonging to an inode is inconsistent
+ *  \return -\c EDCMINVAL, if the mapping association of the data cluster is invalid
+ *  \return -\c ENOSPC, if there are no free data clusters
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails reading or writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soWriteFileClusters (uint32_t nInode, uint32_t firstInd, uint32_t count, void *buff)
+{
+  soColorProbe (417, "07;31", "soWriteFileClusters (%"PRIu32", %"PRIu32", %"PRIu32", %p)\n", nInode, firstInd, count,
+                buff);
+
+  int ERRO;
+  uint32_t nBlk, offset, ind, k, i, run;
+  uint32_t map[MAP_RUN];
+  unsigned char *p_buff = buff;
+  uint32_t mode;
+  bool isDir;
+  SOSuperBlock *p_sb;
+  SOInode ino;
+
+  //Load the superblock
+  if((ERRO = soLoadSuperBlock()) != 0)
+	  return ERRO;
+  p_sb = soGetSuperBlock();
+
+  // invalid arguments
+  if(nInode >= p_sb->itotal || buff == NULL || (uint64_t) firstInd + count > MAX_FILE_CLUSTERS)
+	  return -EINVAL;
+  if(count == 0)
+	  return 0;
+
+  soConvertRefInT(nInode, &nBlk, &offset);
+  if((ERRO = soLoadBlockInT(nBlk)) != 0)
+	  return ERRO;
+  SOInode *inode = soGetBlockInT();
+
+  //the inode is not allocated
+  if(inode[offset].mode == INODE_FREE)
+	  return -EINVAL;
+  isDir = ((inode[offset].mode & INODE_TYPE_MASK) == INODE_DIR);
+  mode = inode[offset].mode;
+
+  //contents stored in the inode itself: a single cluster may stay there, otherwise it moves to a data cluster
+  if(INODE_IS_INLINE(mode))
+  {
+	  if((firstInd == 0) && (count == 1))
+		  return soWriteFileCluster(nInode, 0, buff);
+	  if((ERRO = soReadInode(&ino, nInode, IUIN)) != 0)
+		  return ERRO;
+	  if((ERRO = soInlineSpill(nInode, &ino)) != 0)
+		  return ERRO;
+	  mode = ino.mode;
+  }
+
+  //compressed clusters: each group involved is compressed again only once
+  if(INODE_IS_COMPRESSED(mode))
+	  return soCompressWrite(nInode, firstInd, count, buff);
+
+  for(ind = firstInd; ind < firstInd + count; ind += k)
+  {
+	  //get the logical numbers of a group of clusters and allocate the missing ones
+	  k = (firstInd + count - ind < MAP_RUN) ? firstInd + count - ind : MAP_RUN;
+	  if((ERRO = soGetFileClusters(nInode, ind, k, map)) != 0)
+		  return ERRO;
+	  for(i = 0; i < k; i++)
+		  if(map[i] == NULL_CLUSTER)
+			  if((ERRO = soHandleFileCluster(nInode, ind + i, ALLOC, &map[i])) != 0)
+				  return ERRO;
+
+	  //the clusters contiguous in the data zone are written at once
+	  for(i = 0; i < k; i += run)
+	  {
+		  for(run = 1; (i + run < k) && (map[i + run] == map[i] + run); run++);
+		  if((ERRO = soWriteCacheClusters(map[i]*BLOCKS_PER_CLUSTER + p_sb->dzone_start, run,
+		                                  p_buff + (size_t) (ind - firstInd + i) * BSLPC)) != 0)
+			  return ERRO;
+	  }
+  }
+
+  //store the superblock
+  if((ERRO = soStoreSuperBlock()) != 0)
+	  return ERRO;
+
+  //the contents of a directory changed: its cached entries are no longer valid and the clusters are indexed again
+  if(isDir)
+  {
+	  soInvalidateDirEntCache(nInode);
+	  for(i = 0; i < count; i++)
+		  soDirIndexUpdate(nInode, firstInd + i, (const SODirEntry *) (p_buff + (size_t) i * BSLPC));
+  }
+
   return 0;
 }
@@ -18,6 +18,7 @@
 #include "sofs_direntry.h"
 #include "sofs_basicoper.h"
 #include "sofs_basicconsist.h"
+#include "sofs_direntcache.h"
 #include "sofs_ifuncs_1.h"
 #include "sofs_ifuncs_2.h"
 #include "sofs_ifuncs_3.h"
@@ -91,7 +92,7 @@ int soAddAttDirEntry (uint32_t nInodeDir, const char *eName, uint32_t nInodeEnt,
   soColorProbe (313, "07;31", "soAddAttDirEntry (%"PRIu32", \"%s\", %"PRIu32", %"PRIu32")\n", nInodeDir,
                 eName, nInodeEnt, op);
 
-  	int estado, i, j;
+  	int estado, j;
   	SOInode inodedir, inodeent;
   	uint32_t indice;
   	SODataClust clust1, clust2;
@@ -115,7 +116,7 @@ int soAddAttDirEntry (uint32_t nInodeDir, const char *eName, uint32_t nInodeEnt,
   	if(strlen(eName)>MAX_NAME)
   		return -ENAMETOOLONG;
 
-	if((eName == ".") || (eName == "..")){
+	if(!strcmp(eName, ".") || !strcmp(eName, "..")){
 		return -EINVAL;
 	}
 
@@ -216,11 +217,12 @@ int soAddAttDirEntry (uint32_t nInodeDir, const char *eName, uint32_t nInodeEnt,
   	else if(op == ATTACH)
   	{
   		// Check if we're adding a folder
-  		if(((inodeent.mode & INODE_TYPE_MASK) == INODE_DIR))
-  			return -EIUININVAL;
+  		if(((inodeent.mode & INODE_TYPE_MASK) != INODE_DIR))
+  			return -ENOTDIR;
 
+		// A directory always holds at least the cluster with '.' and '..'
 		if (inodeent.size == 0)
-              			  return -1;
+			return -EDIRINVAL;
 
   		if((estado = soReadFileCluster(nInodeEnt, 0, &clust1))!=0)
   			return estado;
@@ -234,7 +236,7 @@ int soAddAttDirEntry (uint32_t nInodeDir, const char *eName, uint32_t nInodeEnt,
 		if((estado =soReadInode(&inodeent, nInodeEnt, IUIN))!=0)
 			return estado;
 		inodedir.refcount++;
-		inodeent.refcount+=2;
+		inodeent.refcount++;
 
 		if((estado = soWriteInode(&inodedir,nInodeDir,IUIN))!=0)
 			return estado;
@@ -251,8 +253,10 @@ int soAddAttDirEntry (uint32_t nInodeDir, const char *eName, uint32_t nInodeEnt,
 	if((estado = soReadFileCluster(nInodeDir, indicecluster, &clust2))!=0)
 		return estado;
  
-	if(idir == 0){
-		for(j =1; j < DPC; j++){
+	// Only a free entry past the end of the directory lies in a new cluster, which is initialised and grows it;
+	// a free entry of an existing cluster (left by REM or DETACH) is reused as it is
+	if((uint32_t) indicecluster * BSLPC == inodedir.size){
+		for(j =0; j < DPC; j++){
 			memset(clust2.de[j].name, '\0', MAX_NAME+1);		
 			clust2.de[j].nInode = NULL_INODE;
 		}
@@ -271,5 +275,10 @@ int soAddAttDirEntry (uint32_t nInodeDir, const char *eName, uint32_t nInodeEnt,
 	if((estado = soWriteInode(&inodeent, nInodeEnt,IUIN))!=0)
 		return estado;
 
+	// Invalidate the cached entries of the directory (and of the entry, whose ".." may have changed)
+	soInvalidateDirEntCache(nInodeDir);
+	if((inodeent.mode & INODE_TYPE_MASK) == INODE_DIR)
+		soInvalidateDirEntCache(nInodeEnt);
+
     return 0;
 }
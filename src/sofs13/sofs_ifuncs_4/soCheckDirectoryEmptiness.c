@@ -0,0 +1,99 @@
+/**
+ *  \file soCheckDirectoryEmptiness.c (implementation file)
+ *
+ *  \author
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <string.h>
+
+#include "sofs_probe.h"
+#include "sofs_buffercache.h"
+#include "sofs_superblock.h"
+#include "sofs_inode.h"
+#include "sofs_direntry.h"
+#include "sofs_datacluster.h"
+#include "sofs_basicoper.h"
+#include "sofs_basicconsist.h"
+#include "sofs_dirscan.h"
+#include "sofs_ifuncs_1.h"
+#include "sofs_ifuncs_2.h"
+#include "sofs_ifuncs_3.h"
+
+/**
+ *  \brief Check a directory status of emptiness.
+ *
+ *  The directory contents is parsed to assert if all its entries, except for the first two, are free. Thus, the inode
+ *  associated to the directory must be in use and belong to the directory type.
+ *
+ *  The two first aforementioned entries must be in use and be named, respectively, "." and "..".
+ *
+ *  \param nInodeDir number of the inode associated to the directory
+ *
+ *  \return <tt>0 (zero)</tt>, if the directory is empty
+ *  \return -\c ENOTEMPTY, if the directory is not empty
+ *  \return -\c EINVAL, if the <em>inode number</em> is out of range
+ *  \return -\c ENOTDIR, if the inode type is not a directory
+ *  \return -\c ENOTEMPTY, if the directory is not empty
+ *  \return -\c EDIRINVAL, if the directory is inconsistent
+ *  \return -\c EDEINVAL, if the directory entry is inconsistent
+ *  \return -\c EIUININVAL, if the inode in use is inconsistent
+ *  \return -\c ELDCININVAL, if the list of data cluster references belonging to an inode is inconsistent
+ *  \return -\c ELIBBAD, if some kind of inconsistency was detected at some internal storage lower level
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails reading or writing
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soCheckDirectoryEmptiness (uint32_t nInodeDir)
+{
+  soColorProbe (316, "07;31", "soCheckDirectoryEmptiness (%"PRIu32")\n", nInodeDir);
+
+	int stat;
+	uint32_t i, g;
+	uint32_t used;
+	SOSuperBlock *p_sb;
+	SOInode inode;
+	SODataClust clust;
+
+	//load the superblock
+	if((stat = soLoadSuperBlock()) != 0)
+		return stat;
+	if((p_sb = soGetSuperBlock()) == NULL)
+		return -ELIBBAD;
+
+	//check if nInodeDir is within range
+	if(nInodeDir >= p_sb->itotal)
+		return -EINVAL;
+
+	if((stat = soReadInode(&inode, nInodeDir, IUIN)) != 0)
+		return stat;
+
+	//check if the inode is a directory
+	if((inode.mode & INODE_TYPE_MASK) != INODE_DIR)
+		return -ENOTDIR;
+
+	//check its consistency (the first two entries are "." and "..")
+	if((stat = soQCheckDirCont(p_sb, &inode)) != 0)
+		return stat;
+
+	//only the first two entries of the first cluster may be in use
+	for(i = 0; i < (inode.size / BSLPC); i++)
+	{
+		if((stat = soReadFileCluster(nInodeDir, i, &clust)) != 0)
+			return stat;
+		for(g = 0; g < DPC; g += DIRSCAN_ENTS)
+		{
+			soScanDirCluster(clust.de + g, NULL, NULL, NULL, &used);
+			if((i == 0) && (g == 0))
+				used &= ~3u;
+			if(used != 0)
+				return -ENOTEMPTY;
+		}
+	}
+
+	return 0;
+}
@@ -21,6 +21,8 @@
 #include "sofs_ifuncs_1.h"
 #include "sofs_ifuncs_2.h"
 #include "sofs_ifuncs_3.h"
+#include "sofs_dirindex.h"
+#include "sofs_dirscan.h"
 
 /**
  *  \brief Get an entry by name.
@@ -65,11 +67,12 @@ int soGetDirEntryByName (uint32_t nInodeDir, const char *eName, uint32_t *p_nIno
                 nInodeDir, eName, p_nInodeEnt, p_idx);
 
 	int stat;
-	int i,j;
+	int i,j,g;
 	SOSuperBlock *p_sb;
 	SOInode inode;
 	SODataClust clust;
 	uint32_t nInodeEnt=0,indice =-1;
+	uint32_t match, livres;
 	char name[MAX_NAME+1];
 	char *base;
 
@@ -77,16 +80,17 @@ int soGetDirEntryByName (uint32_t nInodeDir, const char *eName, uint32_t *p_nIno
 	
 	if(eName == NULL)
 		return -EINVAL;
-	strcpy(name, eName);
-	base = basename(name);
-	if (strcmp(base, eName) != 0) {
-		return -EINVAL;
-	}	
 	if(strlen(eName) == 0)
 		return -EINVAL;
 		
 	if(strlen(eName)>MAX_NAME)
 		return -ENAMETOOLONG;
+
+	strcpy(name, eName);
+	base = basename(name);
+	if (strcmp(base, eName) != 0) {
+		return -EINVAL;
+	}	
 		
 	if(p_nInodeEnt == NULL)
 		p_nInodeEnt = &nInodeEnt;
@@ -118,6 +122,17 @@ int soGetDirEntryByName (uint32_t nInodeDir, const char *eName, uint32_t *p_nIno
 	if((stat = soQCheckDirCont(p_sb,&inode)) != 0)
 		return stat;
 		
+	//large directories are indexed: only the cluster holding the entry is read
+	stat = soDirIndexLookup(nInodeDir, inode.size/BSLPC, eName, p_nInodeEnt, &indice);
+	if(stat != -ENODATA)
+	{
+		if(stat == -ENOENT)
+			*p_nInodeEnt = NULL_INODE;
+		if(((stat == 0) || (stat == -ENOENT)) && (p_idx != NULL))
+			*p_idx = indice;
+		return stat;
+	}
+	indice = -1;
 	
 	for(i = 0; i<(inode.size/(DPC*sizeof(SODirEntry))); i++)
 	{
@@ -125,26 +140,21 @@ int soGetDirEntryByName (uint32_t nInodeDir, const char *eName, uint32_t *p_nIno
 		if((stat = soReadFileCluster(nInodeDir,i,&clust)) != 0)
 			return stat;
 			
-		//percorre todas as referencias
-		for(j=0; j<DPC; j++)
+		//classify the entries of the cluster at once, group by group
+		for(g = 0; g < DPC; g += DIRSCAN_ENTS)
 		{
-			if(clust.de[j].name[0] == '\0' && clust.de[j].name[1] == '\0')
-			{
-				if(indice == -1)
-					indice = (i * DPC) + j;
-			}
-			else if(strcmp((const char*) clust.de[j].name, eName) == 0)
+			soScanDirCluster(clust.de + g, eName, &match, &livres, NULL);
+			if((indice == -1) && (livres != 0))
+				indice = (i * DPC) + g + __builtin_ctz(livres);
+			if(match != 0)
 			{
+				j = g + __builtin_ctz(match);
 				if(p_nInodeEnt != NULL)
 					*p_nInodeEnt = clust.de[j].nInode;
 				if(p_idx != NULL)
 					*p_idx = (i * DPC) +j ;
 				return 0;
 			}
-			
-
-			
-		
 		}
 	}
 	
@@ -153,7 +163,7 @@ int soGetDirEntryByName (uint32_t nInodeDir, const char *eName, uint32_t *p_nIno
 	if(p_idx != NULL){
 	
 		if(indice == -1)
-			*p_idx = j;
+			*p_idx = i * DPC;
 		else
 			*p_idx = indice;
 
@@ -18,6 +18,7 @@
 #include "sofs_direntry.h"
 #include "sofs_basicoper.h"
 #include "sofs_basicconsist.h"
+#include "sofs_direntcache.h"
 #include "sofs_ifuncs_1.h"
 #include "sofs_ifuncs_2.h"
 #include "sofs_ifuncs_3.h"
@@ -30,13 +31,13 @@ int soGetDirEntryByName (uint32_t nInodeDir, const char *eName, uint32_t *p_nIno
 
 static int soTraversePath (const char *ePath, uint32_t *p_nInodeDir, uint32_t *p_nInodeEnt);
 
-/** \brief Number of symbolic links in the path */
+/** \brief Number of symbolic links in the path (one per thread) */
 
-static uint32_t nSymLinks = 0;
+static __thread uint32_t nSymLinks = 0;
 
-/** \brief Old directory inode number */
+/** \brief Old directory inode number (one per thread) */
 
-static uint32_t oldNInodeDir = 0;
+static __thread uint32_t oldNInodeDir = 0;
 
 /**
  *  \brief Get an entry by path.
@@ -143,6 +144,7 @@ static int soTraversePath (const char *ePath, uint32_t *p_nInodeDir, uint32_t *p
 	SOInode inode;
 	uint32_t nInodeEnt;
 	uint32_t nInodeDir;
+	uint32_t gen;						// generation of the directory in the cache
 
 	strncpy((char *)path, (char *)ePath, MAX_PATH + 1);
 	p_path = dirname(path);
@@ -187,8 +189,20 @@ static int soTraversePath (const char *ePath, uint32_t *p_nInodeDir, uint32_t *p
 	if ((err = soAccessGranted(nInodeDir,X) ) !=0 )
 		return err;
 
-	/* saves the iNode number with the current directory */
-	if ((err = soGetDirEntryByName(nInodeDir, p_name, &nInodeEnt, NULL) ) != 0)
+	/* the cache only holds entries of directories */
+	if ((inode.mode & INODE_TYPE_MASK) != INODE_DIR)
+		return -ENOTDIR;
+
+	/* saves the iNode number with the current directory: the cache is looked up first, and the directory is only
+	   parsed on a miss */
+	err = soLookupDirEntCache(nInodeDir, p_name, &nInodeEnt, &gen);
+	if (err == -ENODATA)
+	{
+		err = soGetDirEntryByName(nInodeDir, p_name, &nInodeEnt, NULL);
+		if ((err == 0) || (err == -ENOENT))
+			soInsertDirEntCache(nInodeDir, p_name, (err == 0) ? nInodeEnt : NULL_INODE, gen);
+	}
+	if (err != 0)
 		return err;
 
 	/* reads the iNode on the entry  */
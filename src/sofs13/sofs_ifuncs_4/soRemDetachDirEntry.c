@@ -18,6 +18,8 @@
 #include "sofs_direntry.h"
 #include "sofs_basicoper.h"
 #include "sofs_basicconsist.h"
+#include "sofs_direntcache.h"
+#include "sofs_dirindex.h"
 #include "sofs_ifuncs_1.h"
 #include "sofs_ifuncs_2.h"
 #include "sofs_ifuncs_3.h"
@@ -115,7 +117,7 @@ nome do string que é passado como parâmetro de entrada
 		return -EPERM;
 
 	// le o nInodeDir para a memória inodeDir
-	if((error = soReadInode(&inodeDir, nInodeDir, op)))
+	if((error = soReadInode(&inodeDir, nInodeDir, IUIN)))
 		return error;
 
 	// verificamos se inodeDir é um directorio
@@ -141,7 +143,7 @@ nome do string que é passado como parâmetro de entrada
 	if((error = soReadFileCluster (nInodeDir, (uint32_t) i, cluster.de)))
 		return error;
 
-	if((error = soReadInode(&inodeEnt, nInodeEnt, op)))
+	if((error = soReadInode(&inodeEnt, nInodeEnt, IUIN)))
 		return error;
 
 	if(op == REM)	// REMOVER
@@ -179,12 +181,12 @@ nome do string que é passado como parâmetro de entrada
 	if((inodeEnt.mode & INODE_DIR) && op==REM)
 		inodeEnt.refcount--;
 
-    soWriteInode(&inodeEnt, nInodeEnt, op);
-    soWriteInode(&inodeDir, nInodeDir, op);
+    soWriteInode(&inodeEnt, nInodeEnt, IUIN);
+    soWriteInode(&inodeDir, nInodeDir, IUIN);
 
     if(op==REM && (inodeEnt.refcount == 0 || (inodeEnt.refcount==1 && (inodeEnt.mode & INODE_DIR))))
     {
-		if((error=soHandleFileClusters(nInodeEnt, 0, op)))
+		if((error=soHandleFileClusters(nInodeEnt, 0, FREE)))
 			return error;
 		if((error=soFreeInode(nInodeEnt)))
 			return error;
@@ -193,6 +195,14 @@ nome do string que é passado como parâmetro de entrada
     if((error = soWriteFileCluster (nInodeDir, (uint32_t) i, cluster.de)))
 		return error;
 
+	// invalidate the cached entries of the directory (and of the entry, if it is a directory, whose index is dropped)
+	soInvalidateDirEntCache(nInodeDir);
+	if(inodeEnt.mode & INODE_DIR)
+	{
+		soInvalidateDirEntCache(nInodeEnt);
+		soDirIndexDrop(nInodeEnt);
+	}
+
   return 0;
 
 
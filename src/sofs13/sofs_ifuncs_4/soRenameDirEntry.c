@@ -18,6 +18,7 @@
 #include "sofs_direntry.h"
 #include "sofs_basicoper.h"
 #include "sofs_basicconsist.h"
+#include "sofs_direntcache.h"
 #include "sofs_ifuncs_1.h"
 #include "sofs_ifuncs_2.h"
 #include "sofs_ifuncs_3.h"
@@ -129,6 +130,9 @@ int soRenameDirEntry (uint32_t nInodeDir, const char *oldName, const char *newNa
 
 	if((stat = soWriteFileCluster(nInodeDir, Ncluster, Direc))!=0)
 		return stat;
+
+	// invalidate the cached entries of the directory
+	soInvalidateDirEntCache(nInodeDir);
 	
   	return 0;
 }
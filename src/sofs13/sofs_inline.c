@@ -0,0 +1,194 @@
+/**
+ *  \file sofs_inline.c (implementation file)
+ *
+ *  \brief Information content of small files and symbolic links stored in the inode itself.
+ *
+ *  The bytes are stored in the fields of the references, \c d, \c i1 and \c i2, taken in succession as an array of
+ *  \c INLINE_SIZE bytes. The change of format when the information content is moved out is written straight into the
+ *  table of inodes, as \e soWriteInode keeps the format of an inode in use when the mode it is given does not signal
+ *  any.
+ *
+ *  The operations are:
+ *      \li enable or disable the storage of the information content in the inode for the files created from now on
+ *      \li get the format for the information content of a new inode
+ *      \li get the information content stored in the inode as a data cluster
+ *      \li check if the contents of a data cluster may be stored in the inode
+ *      \li store the contents of a data cluster in the inode
+ *      \li clear the bytes stored in the inode past a given size
+ *      \li move the information content stored in the inode out into a data cluster.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+
+#include "sofs_probe.h"
+#include "sofs_superblock.h"
+#include "sofs_inode.h"
+#include "sofs_datacluster.h"
+#include "sofs_basicoper.h"
+#include "sofs_ifuncs_2.h"
+#include "sofs_ifuncs_3.h"
+#include "sofs_extent.h"
+#include "sofs_inline.h"
+#include "sofs_compress.h"
+
+_Static_assert (offsetof (SOInode, i2) + sizeof (uint32_t) - offsetof (SOInode, d) == INLINE_SIZE,
+                "the information content stored in the inode must fill the references");
+
+/*
+ *  Internal data structure
+ */
+
+/** \brief signals if the information content of the files created from now on is to be stored in the inode */
+static bool inlineFiles = false;
+
+/**
+ *  \brief Enable or disable the storage of the information content in the inode for the files created from now on.
+ *
+ *  It is disabled by default and it concerns only regular files and symbolic links. The files already created keep
+ *  the format of their information content.
+ *
+ *  \param on signals if the information content of the new files is to be stored in the inode while it fits
+ */
+
+void soSetInlineData (bool on)
+{
+  inlineFiles = on;
+}
+
+/**
+ *  \brief Get the format for the information content of a new inode.
+ *
+ *  \param type the inode type (either a regular file, or a directory, or a symbolic link)
+ *
+ *  \return \c INODE_INLINE, if the information content is to be stored in the inode, or <tt>0 (zero)</tt>, otherwise
+ */
+
+uint32_t soGetInlineFormat (uint32_t type)
+{
+  return (inlineFiles && ((type == INODE_FILE) || (type == INODE_SYMLINK))) ? INODE_INLINE : 0;
+}
+
+/**
+ *  \brief Get the information content stored in the inode as a data cluster.
+ *
+ *  \param p_inode pointer to the inode
+ *  \param buff pointer to the buffer where the contents of the data cluster of index 0 are to be stored
+ */
+
+void soInlineRead (const SOInode *p_inode, void *buff)
+{
+  memcpy (buff, p_inode->d, INLINE_SIZE);
+  memset ((unsigned char *) buff + INLINE_SIZE, 0, BSLPC - INLINE_SIZE);
+}
+
+/**
+ *  \brief Check if the contents of a data cluster may be stored in the inode.
+ *
+ *  \param buff pointer to the buffer holding the contents of the data cluster
+ *
+ *  \return \c true, if the bytes past the first \c INLINE_SIZE are zero, or \c false, otherwise
+ */
+
+bool soInlineFits (const void *buff)
+{
+  const unsigned char *c = buff;                 /* pointer to the contents of the data cluster */
+  uint32_t i;                                    /* counting variable */
+
+  for (i = INLINE_SIZE; i < BSLPC; i++)
+    if (c[i] != 0) return false;
+
+  return true;
+}
+
+/**
+ *  \brief Store the contents of a data cluster in the inode.
+ *
+ *  Only the first \c INLINE_SIZE bytes are stored, the others being supposed to be zero.
+ *
+ *  \param p_inode pointer to the inode
+ *  \param buff pointer to the buffer holding the contents of the data cluster
+ */
+
+void soInlineWrite (SOInode *p_inode, const void *buff)
+{
+  memcpy (p_inode->d, buff, INLINE_SIZE);
+}
+
+/**
+ *  \brief Clear the bytes stored in the inode past a given size.
+ *
+ *  \param p_inode pointer to the inode
+ *  \param size the new size of the file in bytes
+ */
+
+void soInlineTrim (SOInode *p_inode, uint32_t size)
+{
+  if (size < INLINE_SIZE)
+     memset ((unsigned char *) p_inode->d + size, 0, INLINE_SIZE - size);
+}
+
+/**
+ *  \brief Move the information content stored in the inode out into a data cluster.
+ *
+ *  The inode changes to the format of a new inode of its type, either lists of references, whose data clusters may be
+ *  compressed, or a tree of extents, and the bytes it held are written into the data cluster of index 0, unless they
+ *  are all zero. If the data cluster can not be written, the inode is restored. The copy of the inode is read again
+ *  afterwards.
+ *
+ *  \param nInode number of the inode
+ *  \param p_inode pointer to the inode, whose information content is stored in it
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the information content is not stored in the inode
+ *  \return -<em>other specific error</em> issued by \e soWriteFileCluster, \e soReadInode or when reading or writing
+ *          the table of inodes
+ */
+
+int soInlineSpill (uint32_t nInode, SOInode *p_inode)
+{
+  soColorProbe (779, "07;31", "soInlineSpill (%"PRIu32", %p)\n", nInode, p_inode);
+
+  SODataClust clust;                             /* information content as a data cluster */
+  SOInode *p_blk;                                /* pointer to the block of the table of inodes */
+  uint32_t nBlk, offset, h, i;                   /* location of the inode, handle and counting variable */
+  uint32_t fmt;                                  /* format of a new inode of its type */
+  bool empty;                                    /* signals if the bytes stored are all zero */
+  int stat;                                      /* status of operation */
+
+  if ((p_inode == NULL) || !INODE_IS_INLINE (p_inode->mode)) return -EINVAL;
+
+  soInlineRead (p_inode, &clust);
+  for (i = 0, empty = true; (i < INLINE_SIZE) && empty; i++)
+    empty = (clust.data[i] == 0);
+
+  /* the format is changed in the table of inodes itself */
+
+  if ((stat = soConvertRefInT (nInode, &nBlk, &offset)) != 0) return stat;
+  if ((stat = soLoadBlockInTH (nBlk, &h)) != 0) return stat;
+  if ((p_blk = soGetBlockInTH (h)) == NULL) return -ELIBBAD;
+  if ((fmt = soGetExtentFormat (p_blk[offset].mode & INODE_TYPE_MASK)) == 0)
+     fmt = soGetCompressFormat (p_blk[offset].mode & INODE_TYPE_MASK);
+  p_blk[offset].mode = (p_blk[offset].mode & ~INODE_FMT_MASK) | fmt;
+  for (i = 0; i < N_DIRECT; i++)
+    p_blk[offset].d[i] = NULL_CLUSTER;
+  p_blk[offset].i1 = p_blk[offset].i2 = NULL_CLUSTER;
+  if ((stat = soStoreBlockInTH (h)) != 0) return stat;
+
+  /* the bytes are written into a data cluster: if it fails, the inode gets them back */
+
+  if (!empty && ((stat = soWriteFileCluster (nInode, 0, &clust)) != 0))
+     { if ((soLoadBlockInTH (nBlk, &h) == 0) && ((p_blk = soGetBlockInTH (h)) != NULL))
+          { p_blk[offset].mode = p_inode->mode;
+            soInlineWrite (&p_blk[offset], &clust);
+            soStoreBlockInTH (h);
+          }
+       return stat;
+     }
+
+  return soReadInode (p_inode, nInode, IUIN);
+}
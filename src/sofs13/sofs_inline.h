@@ -0,0 +1,121 @@
+/**
+ *  \file sofs_inline.h (interface file)
+ *
+ *  \brief Information content of small files and symbolic links stored in the inode itself.
+ *
+ *  The information content of a regular file or of a symbolic link may be stored in the inode, in place of its
+ *  references (up to \c INLINE_SIZE bytes), when it is signaled in the inode mode. Such a file has no data clusters,
+ *  so reading it requires only the block of the table of inodes where the inode is stored. It is seen as a file whose
+ *  data cluster of index 0 holds the bytes stored in the inode followed by zeros, all the other ones having not been
+ *  allocated, and the bytes stored in the inode past the file size are always zero.
+ *
+ *  A file is created with its information content stored in the inode, if it is so set, and keeps it while a single
+ *  data cluster whose bytes past the first \c INLINE_SIZE are zero is written into it. Otherwise, the information
+ *  content is moved out into a data cluster and the file is described from then on by lists of references, or by a
+ *  tree of extents, as any new file of its type.
+ *
+ *  All operations, but setting, work on a copy of the inode in internal storage and the caller must hold the lock of
+ *  the inode.
+ *
+ *  The operations are:
+ *      \li enable or disable the storage of the information content in the inode for the files created from now on
+ *      \li get the format for the information content of a new inode
+ *      \li get the information content stored in the inode as a data cluster
+ *      \li check if the contents of a data cluster may be stored in the inode
+ *      \li store the contents of a data cluster in the inode
+ *      \li clear the bytes stored in the inode past a given size
+ *      \li move the information content stored in the inode out into a data cluster.
+ *
+ *  \remarks In case an error occurs, all functions return a negative value which is the symmetric of the system error
+ *           that better represents the error cause.
+ *           (execute command <em>man errno</em> to get the list of system errors)
+ */
+
+#ifndef SOFS_INLINE_H_
+#define SOFS_INLINE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sofs_inode.h"
+
+/**
+ *  \brief Enable or disable the storage of the information content in the inode for the files created from now on.
+ *
+ *  It is disabled by default and it concerns only regular files and symbolic links. The files already created keep
+ *  the format of their information content.
+ *
+ *  \param on signals if the information content of the new files is to be stored in the inode while it fits
+ */
+
+extern void soSetInlineData (bool on);
+
+/**
+ *  \brief Get the format for the information content of a new inode.
+ *
+ *  \param type the inode type (either a regular file, or a directory, or a symbolic link)
+ *
+ *  \return \c INODE_INLINE, if the information content is to be stored in the inode, or <tt>0 (zero)</tt>, otherwise
+ */
+
+extern uint32_t soGetInlineFormat (uint32_t type);
+
+/**
+ *  \brief Get the information content stored in the inode as a data cluster.
+ *
+ *  \param p_inode pointer to the inode
+ *  \param buff pointer to the buffer where the contents of the data cluster of index 0 are to be stored
+ */
+
+extern void soInlineRead (const SOInode *p_inode, void *buff);
+
+/**
+ *  \brief Check if the contents of a data cluster may be stored in the inode.
+ *
+ *  \param buff pointer to the buffer holding the contents of the data cluster
+ *
+ *  \return \c true, if the bytes past the first \c INLINE_SIZE are zero, or \c false, otherwise
+ */
+
+extern bool soInlineFits (const void *buff);
+
+/**
+ *  \brief Store the contents of a data cluster in the inode.
+ *
+ *  Only the first \c INLINE_SIZE bytes are stored, the others being supposed to be zero.
+ *
+ *  \param p_inode pointer to the inode
+ *  \param buff pointer to the buffer holding the contents of the data cluster
+ */
+
+extern void soInlineWrite (SOInode *p_inode, const void *buff);
+
+/**
+ *  \brief Clear the bytes stored in the inode past a given size.
+ *
+ *  \param p_inode pointer to the inode
+ *  \param size the new size of the file in bytes
+ */
+
+extern void soInlineTrim (SOInode *p_inode, uint32_t size);
+
+/**
+ *  \brief Move the information content stored in the inode out into a data cluster.
+ *
+ *  The inode changes to the format of a new inode of its type, either lists of references, whose data clusters may be
+ *  compressed, or a tree of extents, and the bytes it held are written into the data cluster of index 0, unless they
+ *  are all zero. If the data cluster can not be written, the inode is restored. The copy of the inode is read again
+ *  afterwards.
+ *
+ *  \param nInode number of the inode
+ *  \param p_inode pointer to the inode, whose information content is stored in it
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the information content is not stored in the inode
+ *  \return -<em>other specific error</em> issued by \e soWriteFileCluster, \e soReadInode or when reading or writing
+ *          the table of inodes
+ */
+
+extern int soInlineSpill (uint32_t nInode, SOInode *p_inode);
+
+#endif /* SOFS_INLINE_H_ */
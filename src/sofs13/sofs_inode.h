@@ -40,6 +40,31 @@
 /** \brief inode type mask */
 #define INODE_TYPE_MASK (INODE_DIR | INODE_FILE | INODE_SYMLINK)
 
+/** \brief flag signaling the information content is described by a tree of extents, instead of lists of references */
+#define INODE_EXTENTS (1<<13)
+
+/** \brief position of the depth of the tree of extents in the inode mode */
+#define INODE_EXT_DEPTH_SHIFT (14)
+
+/** \brief depth of the tree of extents mask (number of levels of nodes below the root, which is kept in the inode) */
+#define INODE_EXT_DEPTH_MASK (3<<INODE_EXT_DEPTH_SHIFT)
+
+/** \brief flag signaling the information content is stored in the inode itself (only if INODE_EXTENTS is not set) */
+#define INODE_INLINE (1<<14)
+
+/** \brief flag signaling the data clusters are compressed in groups (only if neither INODE_EXTENTS nor INODE_INLINE is
+ *         set) */
+#define INODE_COMPRESSED (1<<15)
+
+/** \brief format of the information content mask */
+#define INODE_FMT_MASK (INODE_EXTENTS | INODE_EXT_DEPTH_MASK)
+
+/** \brief test if the information content of an inode is stored in the inode itself, given its mode */
+#define INODE_IS_INLINE(mode) (((mode) & (INODE_EXTENTS | INODE_INLINE)) == INODE_INLINE)
+
+/** \brief test if the data clusters of an inode are compressed in groups, given its mode */
+#define INODE_IS_COMPRESSED(mode) (((mode) & (INODE_EXTENTS | INODE_INLINE | INODE_COMPRESSED)) == INODE_COMPRESSED)
+
 /** \brief flag signaling owner - read permission */
 #define INODE_RD_USR (0400)
 
@@ -79,6 +104,12 @@
 /** \brief maximum size of a file in cluster count */
 #define MAX_CLUSTER_COUNT (MAX_FILE_CLUSTERS + 2 + RPC)
 
+/** \brief number of extents of the root of a tree of extents (it takes the place of the references in the inode) */
+#define N_ROOT_EXTENTS ((N_DIRECT + 2) * sizeof (uint32_t) / sizeof (SOExtent))
+
+/** \brief number of bytes of the information content which may be stored in the inode (in place of the references) */
+#define INLINE_SIZE ((N_DIRECT + 2) * sizeof (uint32_t))
+
 /** \brief Different interpretations for the variable context of the inode depending on the inode status (in use/free):
  *         type 1 context.
  *
@@ -135,7 +166,9 @@ typedef struct soInode
     *     \li bit 10 is set if it represents a regular file
     *     \li bit 11 is set if it represents a directory
     *     \li bit 12 is set if it is free
-    *     \li the other bits are presently reserved
+    *     \li bit 13 is set if the information content is described by a tree of extents
+    *     \li bits 15-14 depth of the tree of extents, if bit 13 is set; otherwise, bit 14 is set if the information
+    *         content is stored in the inode itself and bit 15 is clear
     */
     uint16_t mode;
    /** \brief reference count: number of hard links (directory entries) associated to the inode */
@@ -157,7 +190,9 @@ typedef struct soInode
    /** \brief variable context of type 2 depending on the inode status: in use/free */
     union inodeSecond vD2;
 
-   /** \brief direct references to the data clusters that comprise the file information content */
+   /** \brief direct references to the data clusters that comprise the file information content (together with the
+    *         fields i1 and i2, the root of the tree of extents or the information content itself, if the inode mode
+    *         signals it) */
     uint32_t d[N_DIRECT];
    /** \brief reference to the data cluster that holds the next group of direct references to the data clusters that
     *         comprise the file information content */
@@ -0,0 +1,189 @@
+/**
+ *  \file sofs_inodeindex.c (implementation file)
+ *
+ *  \brief In-memory index of the free inodes.
+ *
+ *  The bitmap has a bit per inode, set if it is free, the inodes of a block of the table of inodes being described by
+ *  successive bits.
+ *
+ *  The operations are:
+ *      \li build the index of the free inodes of the mounted file system
+ *      \li release the index
+ *      \li find a free inode near a given one
+ *      \li account for an inode which was allocated or freed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <errno.h>
+
+#include "sofs_probe.h"
+#include "sofs_superblock.h"
+#include "sofs_inode.h"
+#include "sofs_basicoper.h"
+#include "sofs_inodeindex.h"
+
+/*
+ *  Internal data structure
+ */
+
+/** \brief number of inodes described by the index (zero, if it is not built) */
+static uint32_t nInodes = 0;
+/** \brief number of blocks of the table of inodes */
+static uint32_t nBlocks = 0;
+/** \brief bitmap of the free inodes */
+static unsigned char *freeMap = NULL;
+/** \brief number of free inodes of each block of the table of inodes */
+static uint16_t *blkFree = NULL;
+
+/* Allusion to internal functions */
+
+static bool isFree (uint32_t nInode);
+
+/**
+ *  \brief Build the index of the free inodes of the mounted file system.
+ *
+ *  The table of inodes is read once.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBUSY, if the index is already built
+ *  \return -\c ENOMEM, if there is no memory for the index
+ *  \return -<em>other specific error</em> issued by \e soLoadSuperBlock or \e soLoadBlockInT
+ */
+
+int soOpenInodeIndex (void)
+{
+  soColorProbe (765, "07;31", "soOpenInodeIndex ()\n");
+
+  SOSuperBlock *p_sb;                            /* pointer to the superblock */
+  SOInode *p_blk;                                /* pointer to a block of the table of inodes */
+  uint32_t nBlk, i, n;                           /* number of a block, counting variable and number of an inode */
+  int stat;                                      /* status of operation */
+
+  soLockSuperBlock ();
+  if (nInodes != 0)
+     { soUnlockSuperBlock ();
+       return -EBUSY;
+     }
+  if ((stat = soLoadSuperBlock ()) != 0)
+     { soUnlockSuperBlock ();
+       return stat;
+     }
+  p_sb = soGetSuperBlock ();
+  freeMap = calloc ((p_sb->itotal + 7) / 8, 1);
+  blkFree = calloc (p_sb->itable_size, sizeof (uint16_t));
+  if ((freeMap == NULL) || (blkFree == NULL))
+     stat = -ENOMEM;
+
+  for (nBlk = 0; (stat == 0) && (nBlk < p_sb->itable_size); nBlk++)
+  { if ((stat = soLoadBlockInT (nBlk)) != 0) break;
+    if ((p_blk = soGetBlockInT ()) == NULL)
+       { stat = -ELIBBAD;
+         break;
+       }
+    for (i = 0; (i < IPB) && ((n = nBlk * IPB + i) < p_sb->itotal); i++)
+      if (p_blk[i].mode & INODE_FREE)
+         { freeMap[n / 8] |= 0x80 >> (n % 8);
+           blkFree[nBlk] += 1;
+         }
+  }
+  if (stat == 0)
+     { nInodes = p_sb->itotal;
+       nBlocks = p_sb->itable_size;
+     }
+     else { free (freeMap);
+            free (blkFree);
+            freeMap = NULL;
+            blkFree = NULL;
+          }
+  soUnlockSuperBlock ();
+
+  return stat;
+}
+
+/**
+ *  \brief Release the index.
+ *
+ *  Nothing is done if the index is not built.
+ */
+
+void soCloseInodeIndex (void)
+{
+  soColorProbe (766, "07;31", "soCloseInodeIndex ()\n");
+
+  soLockSuperBlock ();
+  nInodes = nBlocks = 0;
+  free (freeMap);
+  free (blkFree);
+  freeMap = NULL;
+  blkFree = NULL;
+  soUnlockSuperBlock ();
+}
+
+/**
+ *  \brief Find a free inode near a given one.
+ *
+ *  It is the first free inode of the block of the table of inodes where the given inode lies or, failing that, of the
+ *  nearest block which has any, up to \c INDEX_NEAR blocks away.
+ *
+ *  \param nInode number of the inode
+ *
+ *  \return the number of the free inode, or \c NULL_INODE, if the index is not built, the number of the inode is out
+ *          of range or there is no free inode near it
+ */
+
+uint32_t soFindFreeInodeNear (uint32_t nInode)
+{
+  uint32_t nBlk, d, i, n;                        /* number of the block, distance and counting variables */
+  int side;                                      /* side of the block, before or after it */
+
+  if (nInode >= nInodes) return NULL_INODE;
+
+  /* the block itself and then the blocks at increasing distance, the one before first */
+
+  for (d = 0; d <= INDEX_NEAR; d++)
+    for (side = -1; side <= 1; side += 2)
+    { if ((d == 0) && (side == 1)) continue;
+      if ((side < 0) ? (d > nInode / IPB) : (nInode / IPB + d >= nBlocks)) continue;
+      nBlk = (side < 0) ? nInode / IPB - d : nInode / IPB + d;
+      if (blkFree[nBlk] == 0) continue;
+      for (i = 0; (i < IPB) && ((n = nBlk * IPB + i) < nInodes); i++)
+        if (isFree (n)) return n;
+    }
+
+  return NULL_INODE;
+}
+
+/**
+ *  \brief Account for an inode which was allocated or freed.
+ *
+ *  Nothing is done if the index is not built.
+ *
+ *  \param nInode number of the inode
+ *  \param freed signals if the inode was freed, rather than allocated
+ */
+
+void soUpdateInodeIndex (uint32_t nInode, bool freed)
+{
+  if ((nInode >= nInodes) || (isFree (nInode) == freed)) return;
+
+  freeMap[nInode / 8] ^= 0x80 >> (nInode % 8);
+  if (freed)
+     blkFree[nInode / IPB] += 1;
+     else blkFree[nInode / IPB] -= 1;
+}
+
+/*
+ *  Internal functions
+ */
+
+/*
+ *  Check if an inode is free according to the index.
+ */
+
+static bool isFree (uint32_t nInode)
+{
+  return (freeMap[nInode / 8] & (0x80 >> (nInode % 8))) != 0;
+}
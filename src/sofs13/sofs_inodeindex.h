@@ -0,0 +1,83 @@
+/**
+ *  \file sofs_inodeindex.h (interface file)
+ *
+ *  \brief In-memory index of the free inodes.
+ *
+ *  The double-linked list of free inodes hands out the inodes in the order they were freed, wherever they lie in the
+ *  table of inodes. The index keeps in memory a bitmap of the free inodes and the number of free inodes of each block
+ *  of the table, built when the file system is mounted, so that a free inode lying in the same block as a given one,
+ *  or in a block nearby, is found without reading the table: the inode of a new file may then be allocated next to the
+ *  inode of its parent directory, and a block of the table read for a directory holds the inodes of its entries.
+ *
+ *  The index is only advisory: the list of free inodes stays the reference, the inode found being taken out of it
+ *  wherever it lies, and it is not written to the storage device.
+ *
+ *  All operations, but opening and closing the index, are supposed to be called with the lock of the superblock held.
+ *
+ *  The operations are:
+ *      \li build the index of the free inodes of the mounted file system
+ *      \li release the index
+ *      \li find a free inode near a given one
+ *      \li account for an inode which was allocated or freed.
+ *
+ *  \remarks In case an error occurs, all functions return a negative value which is the symmetric of the system error
+ *           that better represents the error cause.
+ *           (execute command <em>man errno</em> to get the list of system errors)
+ */
+
+#ifndef SOFS_INODEINDEX_H_
+#define SOFS_INODEINDEX_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/** \brief maximum distance, in blocks of the table of inodes, of a free inode from the one it should be near */
+#define INDEX_NEAR  16
+
+/**
+ *  \brief Build the index of the free inodes of the mounted file system.
+ *
+ *  The table of inodes is read once.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBUSY, if the index is already built
+ *  \return -\c ENOMEM, if there is no memory for the index
+ *  \return -<em>other specific error</em> issued by \e soLoadSuperBlock or \e soLoadBlockInT
+ */
+
+extern int soOpenInodeIndex (void);
+
+/**
+ *  \brief Release the index.
+ *
+ *  Nothing is done if the index is not built.
+ */
+
+extern void soCloseInodeIndex (void);
+
+/**
+ *  \brief Find a free inode near a given one.
+ *
+ *  It is the first free inode of the block of the table of inodes where the given inode lies or, failing that, of the
+ *  nearest block which has any, up to \c INDEX_NEAR blocks away.
+ *
+ *  \param nInode number of the inode
+ *
+ *  \return the number of the free inode, or \c NULL_INODE, if the index is not built, the number of the inode is out
+ *          of range or there is no free inode near it
+ */
+
+extern uint32_t soFindFreeInodeNear (uint32_t nInode);
+
+/**
+ *  \brief Account for an inode which was allocated or freed.
+ *
+ *  Nothing is done if the index is not built.
+ *
+ *  \param nInode number of the inode
+ *  \param freed signals if the inode was freed, rather than allocated
+ */
+
+extern void soUpdateInodeIndex (uint32_t nInode, bool freed);
+
+#endif /* SOFS_INODEINDEX_H_ */
@@ -0,0 +1,491 @@
+/**
+ *  \file sofs_journal.c (implementation file)
+ *
+ *  \brief Write-ahead journal of the updates of metadata.
+ *
+ *  The journal is written straight to the storage device, bypassing the buffercache. Its first block is the header and
+ *  the records follow it in succession, each one made of a descriptor block, the images of the blocks it logs and a
+ *  commit block, whose checksum covers all the others and whose sequence number is one more than the one of the
+ *  record before. The images are taken from the pinned blocks themselves, so that a whole record is transferred by a
+ *  single vectored write. Replay goes through the records from the one the header expects onwards, until a record which
+ *  is not complete, or does not follow in sequence, is found.
+ *
+ *  The physical numbers of the blocks logged since the last checkpoint are kept, so that, on checkpoint, they are
+ *  synchronized with the storage device before the header is rewritten with a sequence number greater than the one of
+ *  every record in the journal.
+ *
+ *  The operations are:
+ *      \li replay the committed records of the journal of a storage device
+ *      \li open the journal of the mounted file system
+ *      \li log a block in the running transaction
+ *      \li commit the running transaction
+ *      \li close the journal of the mounted file system
+ *      \li check if the journal is open.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/uio.h>
+
+#include "sofs_probe.h"
+#include "sofs_const.h"
+#include "sofs_rawdisk.h"
+#include "sofs_buffercache.h"
+#include "sofs_superblock.h"
+#include "sofs_basicoper.h"
+#include "sofs_journal.h"
+
+/*
+ *  Internal data structure
+ */
+
+/** \brief access lock to the journal */
+static pthread_mutex_t jnlCR = PTHREAD_MUTEX_INITIALIZER;
+/** \brief signals if the journal is open */
+static int jnlOpen = 0;
+/** \brief physical number of the first block of the journal */
+static uint32_t jnlStart;
+/** \brief number of blocks of the journal */
+static uint32_t jnlSize;
+/** \brief number of blocks of the file system proper */
+static uint32_t jnlLimit;
+/** \brief physical number of the block where the next record is to be written */
+static uint32_t jnlHead;
+/** \brief sequence number of the next record */
+static uint32_t jnlSeq;
+
+/** \brief descriptor block of the running transaction */
+static SOJournalDesc desc;
+/** \brief pointers to the contents of the pinned blocks logged in the running transaction */
+static void *img[JNL_MAX_BLOCKS];
+
+/** \brief physical numbers of the blocks logged since the last checkpoint */
+static uint32_t *ckpt = NULL;
+/** \brief number of blocks logged since the last checkpoint */
+static uint32_t nCkpt = 0;
+
+/** \brief storage area for the images of the blocks of a record being replayed */
+static unsigned char replayImg[JNL_MAX_BLOCKS][BLOCK_SIZE];
+
+/* Allusion to internal functions */
+
+static int replay (uint32_t bnmax, uint32_t *p_nrec);
+static int openJournal (void);
+static int logBlock (uint32_t n);
+static int commitRecord (void);
+static int checkpoint (uint32_t open);
+static int writeHeader (uint32_t seq, uint32_t open);
+static int hasJournal (SOSuperBlock *p_sb, uint32_t bnmax);
+static uint32_t checksum (uint32_t sum, const void *buf);
+
+/**
+ *  \brief Replay the committed records of the journal of a storage device.
+ *
+ *  It is meant to be called before the file system is mounted. If the journal was in use when the file system was last
+ *  mounted, and it was not properly unmounted, the images of the blocks of the records committed are written in place,
+ *  in order, and the file system is marked as properly unmounted. In any case, the journal is left empty.
+ *  Nothing is done if there is no journal.
+ *
+ *  \param devname absolute path to the Linux file that simulates the storage device
+ *  \param p_nrec pointer to a location where the number of records replayed is to be stored (nothing is stored, if
+ *                \c NULL)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the pointer to <em>device path</em> is \c NULL or the magic number of the superblock is not
+ *                      the one characteristic of SOFS13
+ *  \return -\c EBUSY, if the device is already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -<em>other specific error</em> issued by \e soOpenDevice
+ */
+
+int soReplayJournal (const char *devname, uint32_t *p_nrec)
+{
+  soColorProbe (796, "07;31", "soReplayJournal (\"%s\", %p)\n", devname, p_nrec);
+
+  uint32_t bnmax;                                /* number of blocks of the device */
+  uint32_t nrec;                                 /* number of records replayed */
+  int stat, st;                                  /* status of operation */
+
+  if (devname == NULL) return -EINVAL;
+  if ((stat = soOpenDevice (devname, &bnmax)) != 0) return stat;
+
+  nrec = 0;
+  stat = replay (bnmax, &nrec);
+  if (((st = soCloseDevice ()) != 0) && (stat == 0)) stat = st;
+  if ((stat == 0) && (p_nrec != NULL)) *p_nrec = nrec;
+
+  return stat;
+}
+
+/**
+ *  \brief Open the journal of the mounted file system.
+ *
+ *  The journal starts afresh and is marked as in use. Nothing is done if there is no journal, or the communication
+ *  channel with the storage device is unbuffered.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBUSY, if the journal is already open
+ *  \return -\c ENOMEM, if there is no memory to keep track of the blocks logged
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+int soOpenJournal (void)
+{
+  soColorProbe (797, "07;31", "soOpenJournal ()\n");
+
+  int stat;                                      /* status of operation */
+
+  pthread_mutex_lock (&jnlCR);                   /* enter critical region */
+  stat = openJournal ();
+  pthread_mutex_unlock (&jnlCR);                 /* exit critical region */
+
+  return stat;
+}
+
+/**
+ *  \brief Log a block in the running transaction.
+ *
+ *  It is meant to be called before the block is written into the buffercache: it is pinned there until the running
+ *  transaction is committed. The running transaction is committed first, if it already logs as many blocks as a record
+ *  may hold. Nothing is done if the journal is not open.
+ *
+ *  \param n physical number of the block
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>block number</em> is out of the file system
+ *  \return -<em>other specific error</em> issued by \e soPinCacheBlock or \e soJournalCommit
+ */
+
+int soJournalBlock (uint32_t n)
+{
+  soColorProbe (798, "07;31", "soJournalBlock (%"PRIu32")\n", n);
+
+  int stat;                                      /* status of operation */
+
+  pthread_mutex_lock (&jnlCR);                   /* enter critical region */
+  stat = jnlOpen ? logBlock (n) : 0;
+  pthread_mutex_unlock (&jnlCR);                 /* exit critical region */
+
+  return stat;
+}
+
+/**
+ *  \brief Commit the running transaction.
+ *
+ *  The record is appended to the journal and synchronized, and the blocks it logs are released. A checkpoint takes place
+ *  when there is no room left for another record as large as they may be. Nothing is done if the journal is not open,
+ *  or no block is logged in the running transaction.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EIO, if it fails on writing
+ *  \return -<em>other specific error</em> issued by \e soWriteRawBlocks, \e soSyncRawBlocks or \e soSyncCacheBlock
+ */
+
+int soJournalCommit (void)
+{
+  soColorProbe (799, "07;31", "soJournalCommit ()\n");
+
+  int stat;                                      /* status of operation */
+
+  pthread_mutex_lock (&jnlCR);                   /* enter critical region */
+  stat = jnlOpen ? commitRecord () : 0;
+  pthread_mutex_unlock (&jnlCR);                 /* exit critical region */
+
+  return stat;
+}
+
+/**
+ *  \brief Close the journal of the mounted file system.
+ *
+ *  The running transaction is committed, a checkpoint takes place and the journal is marked as not in use. Nothing is
+ *  done if the journal is not open.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -<em>other specific error</em> issued by \e soJournalCommit
+ */
+
+int soCloseJournal (void)
+{
+  soColorProbe (800, "07;31", "soCloseJournal ()\n");
+
+  int stat;                                      /* status of operation */
+
+  pthread_mutex_lock (&jnlCR);                   /* enter critical region */
+
+  stat = 0;
+  if (jnlOpen && ((stat = commitRecord ()) == 0) && ((stat = checkpoint (0)) == 0))
+     { free (ckpt);
+       ckpt = NULL;
+       jnlOpen = 0;
+     }
+
+  pthread_mutex_unlock (&jnlCR);                 /* exit critical region */
+
+  return stat;
+}
+
+/**
+ *  \brief Check if the journal is open.
+ *
+ *  \return \c true, if the updates of metadata are being logged, or \c false, otherwise
+ */
+
+bool soJournalInUse (void)
+{
+  bool open;                                     /* signals if the journal is open */
+
+  pthread_mutex_lock (&jnlCR);                   /* enter critical region */
+  open = (jnlOpen != 0);
+  pthread_mutex_unlock (&jnlCR);                 /* exit critical region */
+
+  return open;
+}
+
+/*
+ *  Internal functions
+ */
+
+/*
+ *  Implementation of soReplayJournal (the device is open and has bnmax blocks).
+ */
+
+static int replay (uint32_t bnmax, uint32_t *p_nrec)
+{
+  SOSuperBlock sb;                               /* contents of the superblock */
+  SOJournalHeader hdr;                           /* header of the journal */
+  SOJournalDesc d;                               /* descriptor block of a record */
+  SOJournalCommit c;                             /* commit block of a record */
+  struct iovec iov;                              /* buffer of the images of a record */
+  uint32_t pos, end, seq, sum, i;                /* position, sequence number and checksum of a record */
+  int stat;                                      /* status of operation */
+
+  if ((stat = soReadRawBlock (0, &sb)) != 0) return stat;
+  if (sb.magic != MAGIC_NUMBER) return -EINVAL;
+  if (!hasJournal (&sb, bnmax)) return 0;
+  jnlStart = sb.jnl_start;
+  if ((stat = soReadRawBlock (jnlStart, &hdr)) != 0) return stat;
+  if (hdr.magic != JNL_MAGIC) return 0;          /* the journal was never laid out */
+
+  /* go through the records committed */
+
+  seq = hdr.seq;
+  if (hdr.open && (sb.mstat == NPRU))
+     { end = jnlStart + sb.jnl_size;
+       for (pos = jnlStart + 1; pos + 2 <= end; pos += d.count + 2, seq++)
+       { if ((stat = soReadRawBlock (pos, &d)) != 0) return stat;
+         if ((d.magic != JNL_DESC_MAGIC) || (d.seq != seq) || (d.count == 0) || (d.count > JNL_MAX_BLOCKS) ||
+             (pos + d.count + 2 > end))
+            break;
+         iov.iov_base = replayImg;
+         iov.iov_len = d.count * BLOCK_SIZE;
+         if (((stat = soReadRawBlocks (pos + 1, 1, &iov)) != 0) ||
+             ((stat = soReadRawBlock (pos + d.count + 1, &c)) != 0))
+            return stat;
+         sum = checksum (seq, &d);
+         for (i = 0; i < d.count; i++)
+           sum = checksum (sum, replayImg[i]);
+         if ((c.magic != JNL_COMMIT_MAGIC) || (c.seq != seq) || (c.sum != sum)) break;
+         for (i = 0; i < d.count; i++)            /* the record is complete: its blocks are written in place */
+           if ((d.blk[i] < sb.ntotal) && ((stat = soWriteRawBlock (d.blk[i], replayImg[i])) != 0))
+              return stat;
+         *p_nrec += 1;
+       }
+
+       /* the metadata is consistent again */
+
+       if ((stat = soReadRawBlock (0, &sb)) != 0) return stat;
+       sb.mstat = PRU;
+       if (((stat = soWriteRawBlock (0, &sb)) != 0) || ((stat = soSyncRawBlocks (0, sb.ntotal)) != 0))
+          return stat;
+     }
+
+  /* the journal is left empty */
+
+  return writeHeader (seq + 1, 0);
+}
+
+/*
+ *  Implementation of soOpenJournal (the caller holds the access lock).
+ */
+
+static int openJournal (void)
+{
+  SOBufferCacheStats st;                         /* statistics of the buffercache */
+  SOSuperBlock *p_sb;                            /* pointer to the superblock */
+  SOJournalHeader hdr;                           /* header of the journal */
+  int stat;                                      /* status of operation */
+
+  if (jnlOpen) return -EBUSY;
+  if ((stat = soGetBufferCacheStats (&st)) != 0) return stat;
+  if (!st.inUse) return -EBADF;
+  if (st.nodes == 0) return 0;                   /* the communication channel is unbuffered */
+  if ((stat = soLoadSuperBlock ()) != 0) return stat;
+  p_sb = soGetSuperBlock ();
+  if (!hasJournal (p_sb, NULL_BLOCK)) return 0;
+  jnlStart = p_sb->jnl_start;
+  jnlSize = p_sb->jnl_size;
+  jnlLimit = p_sb->ntotal;
+  if ((stat = soReadRawBlock (jnlStart, &hdr)) != 0) return stat;
+  if (hdr.magic != JNL_MAGIC) return 0;          /* the journal was never laid out */
+
+  if ((ckpt = malloc (jnlSize * sizeof (uint32_t))) == NULL) return -ENOMEM;
+  jnlSeq = hdr.seq + 1;                          /* every record in the journal is stale */
+  if ((stat = writeHeader (jnlSeq, 1)) != 0)
+     { free (ckpt);
+       ckpt = NULL;
+       return stat;
+     }
+  jnlHead = jnlStart + 1;
+  desc.count = 0;
+  nCkpt = 0;
+  jnlOpen = 1;
+
+  return 0;
+}
+
+/*
+ *  Implementation of soJournalBlock (the caller holds the access lock and the journal is open).
+ */
+
+static int logBlock (uint32_t n)
+{
+  uint32_t i;                                    /* counting variable */
+  int stat;                                      /* status of operation */
+
+  if (n >= jnlLimit) return -EINVAL;
+  for (i = 0; i < desc.count; i++)
+    if (desc.blk[i] == n) return 0;              /* the block is already logged */
+
+  if ((desc.count == JNL_MAX_BLOCKS) && ((stat = commitRecord ()) != 0)) return stat;
+  if (((stat = soPinCacheBlock (n, &img[desc.count])) == -ENOBUFS) && (desc.count != 0))
+     { if ((stat = commitRecord ()) != 0) return stat;   /* release the blocks pinned and try again */
+       stat = soPinCacheBlock (n, &img[desc.count]);
+     }
+  if (stat == 0) desc.blk[desc.count++] = n;
+
+  return stat;
+}
+
+/*
+ *  Append the record of the running transaction to the journal and release the blocks it logs (the caller holds the
+ *  access lock). On failure, they are kept pinned, so that the commit may be tried again.
+ */
+
+static int commitRecord (void)
+{
+  SOJournalCommit c;                             /* commit block */
+  struct iovec iov[JNL_MAX_BLOCKS+2];            /* blocks of the record */
+  uint32_t i;                                    /* counting variable */
+  int stat;                                      /* status of operation */
+
+  if (desc.count == 0) return 0;
+
+  desc.magic = JNL_DESC_MAGIC;
+  desc.seq = jnlSeq;
+  memset (desc.blk + desc.count, 0, (JNL_MAX_BLOCKS - desc.count) * sizeof (uint32_t));
+  memset (&c, 0, sizeof (c));
+  c.magic = JNL_COMMIT_MAGIC;
+  c.seq = jnlSeq;
+  c.sum = checksum (jnlSeq, &desc);
+  iov[0].iov_base = &desc;
+  iov[0].iov_len = BLOCK_SIZE;
+  for (i = 0; i < desc.count; i++)
+  { c.sum = checksum (c.sum, img[i]);
+    iov[i+1].iov_base = img[i];
+    iov[i+1].iov_len = BLOCK_SIZE;
+  }
+  iov[desc.count+1].iov_base = &c;
+  iov[desc.count+1].iov_len = BLOCK_SIZE;
+
+  /* a single sequential write */
+
+  if (((stat = soWriteRawBlocks (jnlHead, desc.count + 2, iov)) != 0) ||
+      ((stat = soSyncRawBlocks (jnlHead, desc.count + 2)) != 0))
+     return stat;
+
+  /* the blocks may now be written in place */
+
+  for (i = 0; i < desc.count; i++)
+  { soUnpinCacheBlock (desc.blk[i]);
+    ckpt[nCkpt++] = desc.blk[i];
+  }
+  jnlHead += desc.count + 2;
+  jnlSeq += 1;
+  desc.count = 0;
+
+  if (jnlHead + JNL_MAX_BLOCKS + 2 > jnlStart + jnlSize)
+     return checkpoint (1);
+
+  return 0;
+}
+
+/*
+ *  Write in place the blocks logged since the last checkpoint and start the journal afresh (the caller holds the access
+ *  lock and no block is logged in the running transaction).
+ */
+
+static int checkpoint (uint32_t open)
+{
+  uint32_t i;                                    /* counting variable */
+  int stat;                                      /* status of operation */
+
+  for (i = 0; i < nCkpt; i++)
+    if ((stat = soSyncCacheBlock (ckpt[i])) != 0) return stat;
+  if ((stat = writeHeader (jnlSeq, open)) != 0) return stat;
+  jnlHead = jnlStart + 1;
+  nCkpt = 0;
+
+  return 0;
+}
+
+/*
+ *  Write and synchronize the header of the journal.
+ */
+
+static int writeHeader (uint32_t seq, uint32_t open)
+{
+  SOJournalHeader hdr;                           /* header of the journal */
+  int stat;                                      /* status of operation */
+
+  memset (&hdr, 0, sizeof (hdr));
+  hdr.magic = JNL_MAGIC;
+  hdr.seq = seq;
+  hdr.open = open;
+  if ((stat = soWriteRawBlock (jnlStart, &hdr)) != 0) return stat;
+
+  return soSyncRawBlocks (jnlStart, 1);
+}
+
+/*
+ *  Check if the superblock describes a journal which lies within a device of bnmax blocks: it must start right past
+ *  the file system proper (the reserved area of the superblock of older file systems is filled with other values).
+ */
+
+static int hasJournal (SOSuperBlock *p_sb, uint32_t bnmax)
+{
+  return (p_sb->jnl_size >= JNL_MIN_SIZE) && (p_sb->jnl_start == p_sb->ntotal) &&
+         (p_sb->jnl_size <= bnmax - p_sb->jnl_start);
+}
+
+/*
+ *  Fold the contents of a block into a checksum.
+ */
+
+static uint32_t checksum (uint32_t sum, const void *buf)
+{
+  const uint32_t *w = (const uint32_t *) buf;    /* words of the block */
+  uint32_t i;                                    /* counting variable */
+
+  for (i = 0; i < BLOCK_SIZE / sizeof (uint32_t); i++)
+    sum = ((sum << 5) | (sum >> 27)) ^ w[i];
+
+  return sum;
+}
@@ -0,0 +1,197 @@
+/**
+ *  \file sofs_journal.h (interface file)
+ *
+ *  \brief Write-ahead journal of the updates of metadata.
+ *
+ *  The journal is an optional region of the storage device, laid out by the formatting tool past the end of the file
+ *  system proper, where the blocks of the superblock and of the tables of inodes, of cluster-to-inode mapping and of
+ *  free data clusters are logged before they are written in place.
+ *
+ *  The blocks stored while the file system is in operation join the running transaction, shared by all threads, and
+ *  are pinned in the buffercache until it is committed, so that their new contents does not reach the storage device
+ *  beforehand. On commit, when no transaction of the file system is open any longer, a record with the images of all
+ *  of them is appended to the journal with a single sequential write; the blocks are then released and written in
+ *  place as the buffercache sees fit. When the journal is nearly full, the blocks logged are written in place and the
+ *  journal starts afresh (checkpoint).
+ *
+ *  After an unclean shutdown, the committed records are replayed, in order, before the file system is mounted, and it
+ *  is marked as properly unmounted, so that no consistency check is needed. Records that were not completely written
+ *  are told apart by their checksum and ignored. The clusters of the data zone are not logged: the contents of files
+ *  and directories is only as up to date as the buffercache managed to write it.
+ *
+ *  The journal is supposed to be opened after the file system is mounted and closed before it is unmounted. It is not
+ *  used when there is none in the storage device or the communication channel is unbuffered. The caller must exclude
+ *  stores of metadata concurrent with the operations that log a block or commit the running transaction.
+ *
+ *  The operations are:
+ *      \li replay the committed records of the journal of a storage device
+ *      \li open the journal of the mounted file system
+ *      \li log a block in the running transaction
+ *      \li commit the running transaction
+ *      \li close the journal of the mounted file system
+ *      \li check if the journal is open.
+ *
+ *  \remarks In case an error occurs, all functions return a negative value which is the symmetric of the system error
+ *           that better represents the error cause.
+ *           (execute command <em>man errno</em> to get the list of system errors)
+ */
+
+#ifndef SOFS_JOURNAL_H_
+#define SOFS_JOURNAL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sofs_const.h"
+
+/** \brief magic number of the header of the journal */
+#define JNL_MAGIC         (0x4A4E4C13)
+/** \brief magic number of the descriptor block of a record */
+#define JNL_DESC_MAGIC    (0x4A445343)
+/** \brief magic number of the commit block of a record */
+#define JNL_COMMIT_MAGIC  (0x4A434D54)
+
+/** \brief maximum number of blocks logged in a record */
+#define JNL_MAX_BLOCKS    ((BLOCK_SIZE - 3 * sizeof (uint32_t)) / sizeof (uint32_t))
+/** \brief minimum number of blocks of the journal: the header and two records as large as they may be */
+#define JNL_MIN_SIZE      (1 + 2 * (JNL_MAX_BLOCKS + 2))
+
+/**
+ *  \brief Definition of the header of the journal (its first block).
+ */
+
+typedef struct soJournalHeader
+{
+   /** \brief magic number (should be JNL_MAGIC macro value) */
+    uint32_t magic;
+   /** \brief sequence number of the record which is expected in the block following the header */
+    uint32_t seq;
+   /** \brief signals if the journal was in use when the file system was last mounted */
+    uint32_t open;
+   /** \brief reserved area */
+    unsigned char reserved[BLOCK_SIZE - 3 * sizeof (uint32_t)];
+} SOJournalHeader;
+
+/**
+ *  \brief Definition of the descriptor block of a record: it is followed by the images of the blocks and by the commit
+ *         block.
+ */
+
+typedef struct soJournalDesc
+{
+   /** \brief magic number (should be JNL_DESC_MAGIC macro value) */
+    uint32_t magic;
+   /** \brief sequence number of the record */
+    uint32_t seq;
+   /** \brief number of blocks logged */
+    uint32_t count;
+   /** \brief physical numbers of the blocks logged */
+    uint32_t blk[JNL_MAX_BLOCKS];
+} SOJournalDesc;
+
+/**
+ *  \brief Definition of the commit block of a record.
+ */
+
+typedef struct soJournalCommit
+{
+   /** \brief magic number (should be JNL_COMMIT_MAGIC macro value) */
+    uint32_t magic;
+   /** \brief sequence number of the record */
+    uint32_t seq;
+   /** \brief checksum of the descriptor block and of the images of the blocks */
+    uint32_t sum;
+   /** \brief reserved area */
+    unsigned char reserved[BLOCK_SIZE - 3 * sizeof (uint32_t)];
+} SOJournalCommit;
+
+/**
+ *  \brief Replay the committed records of the journal of a storage device.
+ *
+ *  It is meant to be called before the file system is mounted. If the journal was in use when the file system was last
+ *  mounted, and it was not properly unmounted, the images of the blocks of the records committed are written in place,
+ *  in order, and the file system is marked as properly unmounted. In any case, the journal is left empty.
+ *  Nothing is done if there is no journal.
+ *
+ *  \param devname absolute path to the Linux file that simulates the storage device
+ *  \param p_nrec pointer to a location where the number of records replayed is to be stored (nothing is stored, if
+ *                \c NULL)
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the pointer to <em>device path</em> is \c NULL or the magic number of the superblock is not
+ *                      the one characteristic of SOFS13
+ *  \return -\c EBUSY, if the device is already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -<em>other specific error</em> issued by \e soOpenDevice
+ */
+
+extern int soReplayJournal (const char *devname, uint32_t *p_nrec);
+
+/**
+ *  \brief Open the journal of the mounted file system.
+ *
+ *  The journal starts afresh and is marked as in use. Nothing is done if there is no journal, or the communication
+ *  channel with the storage device is unbuffered.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBUSY, if the journal is already open
+ *  \return -\c ENOMEM, if there is no memory to keep track of the blocks logged
+ *  \return -\c EBADF, if the device is not already opened
+ *  \return -\c EIO, if it fails on reading or writing
+ *  \return -\c ELIBBAD, if the buffercache is inconsistent
+ *  \return -<em>other specific error</em> issued by \e lseek system call
+ */
+
+extern int soOpenJournal (void);
+
+/**
+ *  \brief Log a block in the running transaction.
+ *
+ *  It is meant to be called before the block is written into the buffercache: it is pinned there until the running
+ *  transaction is committed. The running transaction is committed first, if it already logs as many blocks as a record
+ *  may hold. Nothing is done if the journal is not open.
+ *
+ *  \param n physical number of the block
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the <em>block number</em> is out of the file system
+ *  \return -<em>other specific error</em> issued by \e soPinCacheBlock or \e soJournalCommit
+ */
+
+extern int soJournalBlock (uint32_t n);
+
+/**
+ *  \brief Commit the running transaction.
+ *
+ *  The record is appended to the journal and synchronized, and the blocks it logs are released. A checkpoint takes place
+ *  when there is no room left for another record as large as they may be. Nothing is done if the journal is not open,
+ *  or no block is logged in the running transaction.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EIO, if it fails on writing
+ *  \return -<em>other specific error</em> issued by \e soWriteRawBlocks, \e soSyncRawBlocks or \e soSyncCacheBlock
+ */
+
+extern int soJournalCommit (void);
+
+/**
+ *  \brief Close the journal of the mounted file system.
+ *
+ *  The running transaction is committed, a checkpoint takes place and the journal is marked as not in use. Nothing is
+ *  done if the journal is not open.
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -<em>other specific error</em> issued by \e soJournalCommit
+ */
+
+extern int soCloseJournal (void);
+
+/**
+ *  \brief Check if the journal is open.
+ *
+ *  \return \c true, if the updates of metadata are being logged, or \c false, otherwise
+ */
+
+extern bool soJournalInUse (void);
+
+#endif /* SOFS_JOURNAL_H_ */
@@ -0,0 +1,394 @@
+/**
+ *  \file sofs_openfile.c (implementation file)
+ *
+ *  \brief Table of open files.
+ *
+ *  The table is a fixed array of elements, an element being assigned to each open-file handle, whose value is the
+ *  index of the element plus one (so that zero is never a valid handle). The table is accessed in mutual exclusion,
+ *  but the operations on the file itself are carried out outside the critical region, the caller holding the lock of
+ *  the inode associated to the file.
+ *
+ *  The operations are:
+ *      \li open a regular file, getting an open-file handle
+ *      \li get the number of the inode associated to an open-file handle
+ *      \li read data from an open file
+ *      \li write data into an open file
+ *      \li synchronize the contents of an open file with the storage device
+ *      \li synchronize the contents of a regular file with the storage device
+ *      \li close an open-file handle.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+
+#include "sofs_probe.h"
+#include "sofs_buffercache.h"
+#include "sofs_superblock.h"
+#include "sofs_inode.h"
+#include "sofs_datacluster.h"
+#include "sofs_basicoper.h"
+#include "sofs_ifuncs_2.h"
+#include "sofs_ifuncs_3.h"
+#include "sofs_clustmap.h"
+#include "sofs_extent.h"
+#include "sofs_compress.h"
+#include "sofs_openfile.h"
+
+/*
+ *  Internal data structure
+ */
+
+/** \brief element of the table of open files */
+typedef struct soOpenFile
+{
+  /** \brief signals if the element is assigned to an open-file handle */
+  bool used;
+  /** \brief number of the inode associated to the file */
+  uint32_t nInode;
+  /** \brief access mode the file was opened with */
+  int flags;
+  /** \brief signals if a map of the data clusters of the file is attached to the element */
+  bool mapped;
+} SOOpenFile;
+
+/** \brief table of open files */
+static SOOpenFile ofTable[OF_FILES];
+/** \brief access lock to the table of open files */
+static pthread_mutex_t ofCR = PTHREAD_MUTEX_INITIALIZER;
+
+/** \brief number of data clusters whose logical numbers are got at a time, when the file is synchronized */
+#define SYNC_RUN  64
+
+/* Allusion to internal functions */
+
+static int getOpenFile (uint32_t fh, SOOpenFile *p_of);
+
+/**
+ *  \brief Open a regular file, getting an open-file handle.
+ *
+ *  The file is supposed to have been opened by \e soOpen, which checks the access permissions.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param flags access mode the file was opened with (O_RDONLY, O_WRONLY, O_RDWR)
+ *  \param p_fh pointer to the location where the open-file handle is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c ENFILE, if the table of open files is full
+ */
+
+int soOpenFh (uint32_t nInode, int flags, uint32_t *p_fh)
+{
+  soColorProbe (791, "07;31", "soOpenFh (%"PRIu32", %d, %p)\n", nInode, flags, p_fh);
+
+  uint32_t i;                                    /* element index */
+
+  *p_fh = NULL_FH;
+  pthread_mutex_lock (&ofCR);
+  for (i = 0; (i < OF_FILES) && ofTable[i].used; i++);
+  if (i == OF_FILES)
+     { pthread_mutex_unlock (&ofCR);
+       return -ENFILE;
+     }
+  ofTable[i].used = true;
+  ofTable[i].nInode = nInode;
+  ofTable[i].flags = flags;
+  ofTable[i].mapped = (soClustMapAttach (nInode) == 0);  /* if not, the references are always read */
+  pthread_mutex_unlock (&ofCR);
+  *p_fh = i + 1;
+
+  return 0;
+}
+
+/**
+ *  \brief Get the number of the inode associated to an open-file handle.
+ *
+ *  \param fh open-file handle
+ *  \param p_nInode pointer to the location where the number of the inode is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if the open-file handle is not valid
+ */
+
+int soGetFhInode (uint32_t fh, uint32_t *p_nInode)
+{
+  SOOpenFile of;                                 /* element of the table of open files */
+  int stat;                                      /* status of operation */
+
+  if ((stat = getOpenFile (fh, &of)) != 0) return stat;
+  *p_nInode = of.nInode;
+
+  return 0;
+}
+
+/**
+ *  \brief Read data from an open file.
+ *
+ *  It tries to emulate <em>read</em> system call. The whole data clusters involved are read as a group.
+ *
+ *  \param fh open-file handle
+ *  \param buff pointer to the buffer where data to be read is to be stored
+ *  \param count number of bytes to be read
+ *  \param pos starting [byte] position in the file data continuum where data is to be read from
+ *
+ *  \return <em>number of bytes effectively read</em>, on success
+ *  \return -\c EBADF, if the open-file handle is not valid or the file was not opened for reading
+ *  \return -\c EISDIR, if the inode associated to the file is a directory
+ *  \return -<em>other specific error</em> issued by \e soReadInode, \e soReadFileCluster or \e soReadFileClusters
+ */
+
+int soReadFh (uint32_t fh, void *buff, uint32_t count, uint32_t pos)
+{
+  soColorProbe (792, "07;31", "soReadFh (%"PRIu32", %p, %"PRIu32", %"PRIu32")\n", fh, buff, count, pos);
+
+  SOOpenFile of;                                 /* element of the table of open files */
+  SOInode inode;                                 /* inode associated to the file */
+  unsigned char clust[BSLPC];                    /* contents of a data cluster */
+  uint32_t done, n;                              /* number of bytes read / to be read from a data cluster */
+  uint32_t clustInd, off;                        /* index of the data cluster and offset within it */
+  int stat;                                      /* status of operation */
+
+  if ((stat = getOpenFile (fh, &of)) != 0) return stat;
+  if ((of.flags & O_ACCMODE) == O_WRONLY) return -EBADF;
+  if ((stat = soReadInode (&inode, of.nInode, IUIN)) != 0) return stat;
+  if ((inode.mode & INODE_TYPE_MASK) == INODE_DIR) return -EISDIR;
+
+  if (pos >= inode.size) return 0;               /* the end of the file was reached */
+  if (count > inode.size - pos) count = inode.size - pos;
+
+  for (done = 0; done < count; done += n)
+  { clustInd = (pos + done) / BSLPC;
+    off = (pos + done) % BSLPC;
+    if ((off == 0) && (count - done >= BSLPC))   /* whole data clusters are read as a group */
+       { n = (count - done) / BSLPC;
+         if ((stat = soReadFileClusters (of.nInode, clustInd, n, (unsigned char *) buff + done)) != 0)
+            return stat;
+         n *= BSLPC;
+         continue;
+       }
+    n = (BSLPC - off < count - done) ? BSLPC - off : count - done;
+    if ((stat = soReadFileCluster (of.nInode, clustInd, clust)) != 0)
+       return stat;
+    memcpy ((unsigned char *) buff + done, clust + off, n);
+  }
+
+  return (int) count;
+}
+
+/**
+ *  \brief Write data into an open file.
+ *
+ *  It tries to emulate <em>write</em> system call. The whole data clusters involved are written as a group.
+ *
+ *  \param fh open-file handle
+ *  \param buff pointer to the buffer where data to be written is stored
+ *  \param count number of bytes to be written
+ *  \param pos starting [byte] position in the file data continuum where data is to be written into
+ *
+ *  \return <em>number of bytes effectively written</em>, on success
+ *  \return -\c EBADF, if the open-file handle is not valid or the file was not opened for writing
+ *  \return -\c EISDIR, if the inode associated to the file is a directory
+ *  \return -\c EFBIG, if the file may grow passing its maximum size
+ *  \return -<em>other specific error</em> issued by \e soReadInode, \e soWriteInode, \e soReadFileCluster,
+ *          \e soWriteFileCluster or \e soWriteFileClusters
+ */
+
+int soWriteFh (uint32_t fh, const void *buff, uint32_t count, uint32_t pos)
+{
+  soColorProbe (793, "07;31", "soWriteFh (%"PRIu32", %p, %"PRIu32", %"PRIu32")\n", fh, buff, count, pos);
+
+  SOOpenFile of;                                 /* element of the table of open files */
+  SOInode inode;                                 /* inode associated to the file */
+  unsigned char clust[BSLPC];                    /* contents of a data cluster */
+  uint32_t done, n;                              /* number of bytes written / to be written into a data cluster */
+  uint32_t clustInd, off;                        /* index of the data cluster and offset within it */
+  int stat;                                      /* status of operation */
+
+  if ((stat = getOpenFile (fh, &of)) != 0) return stat;
+  if ((of.flags & O_ACCMODE) == O_RDONLY) return -EBADF;
+  if ((stat = soReadInode (&inode, of.nInode, IUIN)) != 0) return stat;
+  if ((inode.mode & INODE_TYPE_MASK) == INODE_DIR) return -EISDIR;
+  if ((uint64_t) pos + count > MAX_FILE_SIZE) return -EFBIG;
+
+  for (done = 0; done < count; done += n)
+  { clustInd = (pos + done) / BSLPC;
+    off = (pos + done) % BSLPC;
+    if ((off == 0) && (count - done >= BSLPC))   /* whole data clusters are written as a group */
+       { n = (count - done) / BSLPC;
+         if ((stat = soWriteFileClusters (of.nInode, clustInd, n, (unsigned char *) buff + done)) != 0)
+            return stat;
+         n *= BSLPC;
+         continue;
+       }
+    n = (BSLPC - off < count - done) ? BSLPC - off : count - done;
+    if ((stat = soReadFileCluster (of.nInode, clustInd, clust)) != 0)
+       return stat;
+    memcpy (clust + off, (const unsigned char *) buff + done, n);
+    if ((stat = soWriteFileCluster (of.nInode, clustInd, clust)) != 0)
+       return stat;
+  }
+
+  /* the inode was changed meanwhile by the allocation of data clusters */
+
+  if ((stat = soReadInode (&inode, of.nInode, IUIN)) != 0) return stat;
+  if (pos + count > inode.size)
+     inode.size = pos + count;
+  if ((stat = soWriteInode (&inode, of.nInode, IUIN)) != 0) return stat;
+
+  return (int) count;
+}
+
+/**
+ *  \brief Synchronize the contents of an open file with the storage device.
+ *
+ *  It tries to emulate <em>fsync</em> system call: the data clusters of the file, its clusters of references (or the
+ *  nodes of its tree of extents), the block of the table of inodes where its inode is stored, the tables of allocation
+ *  of data clusters and the superblock are written to the storage device, if they were changed.
+ *
+ *  \param fh open-file handle
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if the open-file handle is not valid
+ *  \return -<em>other specific error</em> issued by \e soFsyncFile
+ */
+
+int soFsyncFh (uint32_t fh)
+{
+  soColorProbe (794, "07;31", "soFsyncFh (%"PRIu32")\n", fh);
+
+  SOOpenFile of;                                 /* element of the table of open files */
+  int stat;                                      /* status of operation */
+
+  if ((stat = getOpenFile (fh, &of)) != 0) return stat;
+
+  return soFsyncFile (of.nInode);
+}
+
+/**
+ *  \brief Synchronize the contents of a regular file with the storage device.
+ *
+ *  It is the same as \e soFsyncFh, for a file given by the number of its inode, whether it is open or not.
+ *
+ *  \param nInode number of the inode associated to the file
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -<em>other specific error</em> issued by \e soReadInode, \e soGetFileClusters, \e soExtentSync,
+ *          \e soFlushTransactions, \e soSyncCacheCluster or \e soSyncCacheBlock
+ */
+
+int soFsyncFile (uint32_t nInode)
+{
+  soColorProbe (778, "07;31", "soFsyncFile (%"PRIu32")\n", nInode);
+
+  SOInode inode;                                 /* inode associated to the file */
+  SOSuperBlock *p_sb;                            /* pointer to the superblock */
+  SODataClust clt, *p_clt;                       /* contents of the cluster of double indirect references */
+  uint32_t map[SYNC_RUN];                        /* logical numbers of a group of data clusters */
+  uint32_t nClusters, ind, k, i, h, nBlk, off;
+  int stat;                                      /* status of operation */
+
+  if ((stat = soReadInode (&inode, nInode, IUIN)) != 0) return stat;
+  if ((stat = soLoadSuperBlock ()) != 0) return stat;
+  p_sb = soGetSuperBlock ();
+
+  /* data clusters */
+
+  nClusters = (inode.size + BSLPC - 1) / BSLPC;
+  if (INODE_IS_COMPRESSED (inode.mode))          /* the last group may be stored past the end of the file */
+     { nClusters = (nClusters + COMPRESS_GROUP - 1) / COMPRESS_GROUP * COMPRESS_GROUP;
+       if (nClusters > MAX_FILE_CLUSTERS) nClusters = MAX_FILE_CLUSTERS;
+     }
+  for (ind = 0; ind < nClusters; ind += k)
+  { k = (nClusters - ind < SYNC_RUN) ? nClusters - ind : SYNC_RUN;
+    if ((stat = soGetFileClusters (nInode, ind, k, map)) != 0) return stat;
+    for (i = 0; i < k; i++)
+      if ((map[i] != NULL_CLUSTER) &&
+          ((stat = soSyncCacheCluster (p_sb->dzone_start + map[i] * BLOCKS_PER_CLUSTER)) != 0))
+         return stat;
+  }
+
+  /* clusters of references (or nodes of the tree of extents) */
+
+  if (inode.mode & INODE_EXTENTS)
+     { if ((stat = soExtentSync (&inode)) != 0) return stat;
+       inode.i1 = inode.i2 = NULL_CLUSTER;       /* they are part of the root of the tree */
+     }
+     else if (INODE_IS_INLINE (inode.mode))
+             inode.i1 = inode.i2 = NULL_CLUSTER; /* they hold the contents of the file */
+  if ((inode.i1 != NULL_CLUSTER) &&
+      ((stat = soSyncCacheCluster (p_sb->dzone_start + inode.i1 * BLOCKS_PER_CLUSTER)) != 0))
+     return stat;
+  if (inode.i2 != NULL_CLUSTER)
+     { if ((stat = soLoadRefClustH (p_sb->dzone_start + inode.i2 * BLOCKS_PER_CLUSTER, &h)) != 0) return stat;
+       if ((p_clt = soGetRefClustH (h)) == NULL) return -ELIBBAD;
+       clt = *p_clt;                             /* the references are copied, since other threads may load clusters */
+       for (i = 0; i < RPC; i++)
+         if ((clt.ref[i] != NULL_CLUSTER) &&
+             ((stat = soSyncCacheCluster (p_sb->dzone_start + clt.ref[i] * BLOCKS_PER_CLUSTER)) != 0))
+            return stat;
+       if ((stat = soSyncCacheCluster (p_sb->dzone_start + inode.i2 * BLOCKS_PER_CLUSTER)) != 0) return stat;
+     }
+
+  /* inode, tables of allocation of data clusters and superblock (whose store may have been put off) */
+
+  if ((stat = soFlushTransactions ()) != 0) return stat;
+  if ((stat = soConvertRefInT (nInode, &nBlk, &off)) != 0) return stat;
+  if ((stat = soSyncCacheBlock (p_sb->itable_start + nBlk)) != 0) return stat;
+  for (i = 0; i < p_sb->fctable_size; i++)
+    if ((stat = soSyncCacheBlock (p_sb->fctable_start + i)) != 0) return stat;
+  for (i = 0; i < p_sb->ciutable_size; i++)
+    if ((stat = soSyncCacheBlock (p_sb->ciutable_start + i)) != 0) return stat;
+
+  return soSyncCacheBlock (0);
+}
+
+/**
+ *  \brief Close an open-file handle.
+ *
+ *  \param fh open-file handle
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if the open-file handle is not valid
+ */
+
+int soCloseFh (uint32_t fh)
+{
+  soColorProbe (795, "07;31", "soCloseFh (%"PRIu32")\n", fh);
+
+  pthread_mutex_lock (&ofCR);
+  if ((fh == NULL_FH) || (fh > OF_FILES) || !ofTable[fh-1].used)
+     { pthread_mutex_unlock (&ofCR);
+       return -EBADF;
+     }
+  ofTable[fh-1].used = false;
+  if (ofTable[fh-1].mapped)
+     soClustMapDetach (ofTable[fh-1].nInode);
+  pthread_mutex_unlock (&ofCR);
+
+  return 0;
+}
+
+/*
+ *  Internal functions
+ */
+
+/*
+ *  Get a copy of the element of the table of open files assigned to an open-file handle.
+ */
+
+static int getOpenFile (uint32_t fh, SOOpenFile *p_of)
+{
+  pthread_mutex_lock (&ofCR);
+  if ((fh == NULL_FH) || (fh > OF_FILES) || !ofTable[fh-1].used)
+     { pthread_mutex_unlock (&ofCR);
+       return -EBADF;
+     }
+  *p_of = ofTable[fh-1];
+  pthread_mutex_unlock (&ofCR);
+
+  return 0;
+}
@@ -0,0 +1,145 @@
+/**
+ *  \file sofs_openfile.h (interface file)
+ *
+ *  \brief Table of open files.
+ *
+ *  When a regular file is opened, an element of the table is assigned to it, which holds the number of the inode
+ *  associated to the file and the access mode it was opened with. The index of the element, the open-file handle, is
+ *  kept by the caller, so that data may be read from and written into the file, and the file may be synchronized,
+ *  without the path to the file being resolved again.
+ *
+ *  Access permissions are checked when the file is opened (by \e soOpen), not on each operation. The caller must hold
+ *  the lock of the inode associated to the file, shared for reading and in exclusion for writing and synchronizing.
+ *
+ *  The operations are:
+ *      \li open a regular file, getting an open-file handle
+ *      \li get the number of the inode associated to an open-file handle
+ *      \li read data from an open file
+ *      \li write data into an open file
+ *      \li synchronize the contents of an open file with the storage device
+ *      \li synchronize the contents of a regular file with the storage device
+ *      \li close an open-file handle.
+ *
+ *  \remarks In case an error occurs, all functions return a negative value which is the symmetric of the system error
+ *           that better represents the error cause.
+ *           (execute command <em>man errno</em> to get the list of system errors)
+ */
+
+#ifndef SOFS_OPENFILE_H_
+#define SOFS_OPENFILE_H_
+
+#include <stdint.h>
+
+/** \brief maximum number of open-file handles */
+#define OF_FILES  256
+
+/** \brief null open-file handle (no handle was assigned) */
+#define NULL_FH   0
+
+/**
+ *  \brief Open a regular file, getting an open-file handle.
+ *
+ *  The file is supposed to have been opened by \e soOpen, which checks the access permissions.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param flags access mode the file was opened with (O_RDONLY, O_WRONLY, O_RDWR)
+ *  \param p_fh pointer to the location where the open-file handle is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c ENFILE, if the table of open files is full
+ */
+
+extern int soOpenFh (uint32_t nInode, int flags, uint32_t *p_fh);
+
+/**
+ *  \brief Get the number of the inode associated to an open-file handle.
+ *
+ *  \param fh open-file handle
+ *  \param p_nInode pointer to the location where the number of the inode is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if the open-file handle is not valid
+ */
+
+extern int soGetFhInode (uint32_t fh, uint32_t *p_nInode);
+
+/**
+ *  \brief Read data from an open file.
+ *
+ *  It tries to emulate <em>read</em> system call. The whole data clusters involved are read as a group.
+ *
+ *  \param fh open-file handle
+ *  \param buff pointer to the buffer where data to be read is to be stored
+ *  \param count number of bytes to be read
+ *  \param pos starting [byte] position in the file data continuum where data is to be read from
+ *
+ *  \return <em>number of bytes effectively read</em>, on success
+ *  \return -\c EBADF, if the open-file handle is not valid or the file was not opened for reading
+ *  \return -\c EISDIR, if the inode associated to the file is a directory
+ *  \return -<em>other specific error</em> issued by \e soReadInode, \e soReadFileCluster or \e soReadFileClusters
+ */
+
+extern int soReadFh (uint32_t fh, void *buff, uint32_t count, uint32_t pos);
+
+/**
+ *  \brief Write data into an open file.
+ *
+ *  It tries to emulate <em>write</em> system call. The whole data clusters involved are written as a group.
+ *
+ *  \param fh open-file handle
+ *  \param buff pointer to the buffer where data to be written is stored
+ *  \param count number of bytes to be written
+ *  \param pos starting [byte] position in the file data continuum where data is to be written into
+ *
+ *  \return <em>number of bytes effectively written</em>, on success
+ *  \return -\c EBADF, if the open-file handle is not valid or the file was not opened for writing
+ *  \return -\c EISDIR, if the inode associated to the file is a directory
+ *  \return -\c EFBIG, if the file may grow passing its maximum size
+ *  \return -<em>other specific error</em> issued by \e soReadInode, \e soWriteInode, \e soReadFileCluster,
+ *          \e soWriteFileCluster or \e soWriteFileClusters
+ */
+
+extern int soWriteFh (uint32_t fh, const void *buff, uint32_t count, uint32_t pos);
+
+/**
+ *  \brief Synchronize the contents of an open file with the storage device.
+ *
+ *  It tries to emulate <em>fsync</em> system call: the data clusters of the file, its clusters of references (or the
+ *  nodes of its tree of extents), the block of the table of inodes where its inode is stored, the tables of allocation
+ *  of data clusters and the superblock are written to the storage device, if they were changed.
+ *
+ *  \param fh open-file handle
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if the open-file handle is not valid
+ *  \return -<em>other specific error</em> issued by \e soFsyncFile
+ */
+
+extern int soFsyncFh (uint32_t fh);
+
+/**
+ *  \brief Synchronize the contents of a regular file with the storage device.
+ *
+ *  It is the same as \e soFsyncFh, for a file given by the number of its inode, whether it is open or not.
+ *
+ *  \param nInode number of the inode associated to the file
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -<em>other specific error</em> issued by \e soReadInode, \e soGetFileClusters, \e soExtentSync,
+ *          \e soFlushTransactions, \e soSyncCacheCluster or \e soSyncCacheBlock
+ */
+
+extern int soFsyncFile (uint32_t nInode);
+
+/**
+ *  \brief Close an open-file handle.
+ *
+ *  \param fh open-file handle
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EBADF, if the open-file handle is not valid
+ */
+
+extern int soCloseFh (uint32_t fh);
+
+#endif /* SOFS_OPENFILE_H_ */
@@ -0,0 +1,189 @@
+/**
+ *  \file sofs_readdir.c (implementation file)
+ *
+ *  \brief Batched reading of the entries of a directory.
+ *
+ *  The data clusters of the directory are read one at a time and the entries in use in each of them are found in a
+ *  single pass (see sofs_dirscan.h). The attributes of the file an entry refers to are got from its inode, as
+ *  <em>soStat</em> would report them.
+ *
+ *  The operations are:
+ *      \li read a group of directory entries from a directory, given its path
+ *      \li read a group of directory entries from a directory, given the number of its inode
+ *      \li get the attributes of the file associated to an inode.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "sofs_probe.h"
+#include "sofs_const.h"
+#include "sofs_inode.h"
+#include "sofs_direntry.h"
+#include "sofs_datacluster.h"
+#include "sofs_ifuncs_2.h"
+#include "sofs_ifuncs_3.h"
+#include "sofs_ifuncs_4.h"
+#include "sofs_dirscan.h"
+#include "sofs_readdir.h"
+
+/**
+ *  \brief Read a group of directory entries from a directory.
+ *
+ *  It extends <em>soReaddir</em> to many entries per call: the entries in use from position <tt>pos</tt> onwards
+ *  are handed, in order, to <tt>filler</tt>, the free ones being skipped.
+ *
+ *  The process that calls the operation must have execution (x) permission on all the components of the path with
+ *  exception of the rightmost one, and read (r) permission on the directory.
+ *
+ *  \param ePath path to the directory
+ *  \param pos starting [byte] position in the directory where entries are to be read from
+ *  \param filler pointer to the function each directory entry is handed to
+ *  \param data pointer to the data to be passed on to <tt>filler</tt>
+ *  \param plus signals that the attributes of the file each entry refers to are to be handed together with its name
+ *
+ *  \return <em>number of directory entries handed to <tt>filler</tt> and taken (0, if the end is reached)</em>,
+ *          on success
+ *  \return -\c EINVAL, if either of the pointers are \c NULL or <em>pos</em> value is not a multiple of the size of
+ *                      a <em>directory entry</em>
+ *  \return -\c EFBIG, if the <em>pos</em> value is beyond the maximum file size
+ *  \return -\c ENOTDIR, if any of the components of <tt>ePath</tt> is not a directory
+ *  \return -\c EPERM, if the process that calls the operation has not read permission on the directory described by
+ *                     <tt>ePath</tt>
+ *  \return -<em>other specific error</em> issued by \e soGetDirEntryByPath, \e soReadInode, \e soAccessGranted or
+ *          \e soReadFileCluster
+ */
+
+int soReaddirBatch (const char *ePath, uint32_t pos, SOReaddirFiller filler, void *data, bool plus)
+{
+  soColorProbe (808, "07;31", "soReaddirBatch (\"%s\", %"PRIu32", %p, %p, %d)\n", ePath, pos, filler, data, plus);
+
+  uint32_t nInodeDir;                            /* number of the inode associated to the directory */
+  int stat;                                      /* status of operation */
+
+  if ((ePath == NULL) || (filler == NULL)) return -EINVAL;
+
+  /* the path is resolved once */
+
+  if ((stat = soGetDirEntryByPath (ePath, NULL, &nInodeDir)) != 0) return stat;
+
+  return soReaddirBatchInode (nInodeDir, pos, filler, data, plus);
+}
+
+/**
+ *  \brief Read a group of directory entries from a directory, given the number of its inode.
+ *
+ *  It is equivalent to <em>soReaddirBatch</em>, but no path is resolved: the process that calls the operation must
+ *  have read (r) permission on the directory.
+ *
+ *  \param nInodeDir number of the inode associated to the directory
+ *  \param pos starting [byte] position in the directory where entries are to be read from
+ *  \param filler pointer to the function each directory entry is handed to
+ *  \param data pointer to the data to be passed on to <tt>filler</tt>
+ *  \param plus signals that the attributes of the file each entry refers to are to be handed together with its name
+ *
+ *  \return <em>number of directory entries handed to <tt>filler</tt> and taken (0, if the end is reached)</em>,
+ *          on success
+ *  \return -\c EINVAL, if the pointer to the function is \c NULL or <em>pos</em> value is not a multiple of the size
+ *                      of a <em>directory entry</em>
+ *  \return -\c EFBIG, if the <em>pos</em> value is beyond the maximum file size
+ *  \return -\c ENOTDIR, if the inode type is not a directory
+ *  \return -\c EPERM, if the process that calls the operation has not read permission on the directory
+ *  \return -<em>other specific error</em> issued by \e soReadInode, \e soAccessGranted or \e soReadFileCluster
+ */
+
+int soReaddirBatchInode (uint32_t nInodeDir, uint32_t pos, SOReaddirFiller filler, void *data, bool plus)
+{
+  soColorProbe (809, "07;31", "soReaddirBatchInode (%"PRIu32", %"PRIu32", %p, %p, %d)\n", nInodeDir, pos, filler, data,
+                plus);
+
+  SOInode inode;                                 /* inode associated to the directory */
+  SODataClust clust;                             /* contents of a data cluster of the directory */
+  struct stat st;                                /* attributes of the file an entry refers to */
+  char name[MAX_NAME+1];                         /* name of an entry */
+  uint32_t clustInd, idx;                        /* index of the data cluster and of the entry within it */
+  uint32_t first, g;                             /* index of the first entry to be read and of the first of a group */
+  uint32_t used;                                 /* mask of the entries in use of the group */
+  int nEnts;                                     /* number of entries taken */
+  int stat;                                      /* status of operation */
+
+  if (filler == NULL) return -EINVAL;
+  if ((pos % sizeof (SODirEntry)) != 0) return -EINVAL;
+  if (pos >= MAX_FILE_SIZE) return -EFBIG;
+  if ((stat = soReadInode (&inode, nInodeDir, IUIN)) != 0) return stat;
+  if ((inode.mode & INODE_TYPE_MASK) != INODE_DIR) return -ENOTDIR;
+  if ((stat = soAccessGranted (nInodeDir, R)) != 0)
+     return (stat == -EACCES) ? -EPERM : stat;
+
+  /* the data clusters are read in sequence from the one where position pos lies */
+
+  nEnts = 0;
+  first = (pos % BSLPC) / sizeof (SODirEntry);
+  for (clustInd = pos / BSLPC; clustInd < inode.size / BSLPC; clustInd++, first = 0)
+  { if ((stat = soReadFileCluster (nInodeDir, clustInd, &clust)) != 0) return stat;
+    for (g = first - first % DIRSCAN_ENTS; g < DPC; g += DIRSCAN_ENTS)
+    { soScanDirCluster (clust.de + g, NULL, NULL, NULL, &used);
+      if (first > g) used &= ~((1u << (first - g)) - 1);
+      for (; used != 0; used &= used - 1)
+      { idx = g + (uint32_t) __builtin_ctz (used);
+        memcpy (name, clust.de[idx].name, MAX_NAME);
+        name[MAX_NAME] = '\0';
+        if (plus && ((stat = soGetInodeAttr (clust.de[idx].nInode, &st)) != 0)) return stat;
+        if (filler (data, name, plus ? &st : NULL, (clustInd * DPC + idx + 1) * sizeof (SODirEntry)) != 0)
+           return nEnts;
+        nEnts += 1;
+      }
+    }
+  }
+
+  return nEnts;
+}
+
+/**
+ *  \brief Get the attributes of the file associated to an inode.
+ *
+ *  They are the ones <em>soStat</em> reports. The <em>inode number</em> reported is the number of the inode.
+ *
+ *  \param nInode number of the inode
+ *  \param st pointer to the stat structure where the attributes are to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -<em>other specific error</em> issued by \e soReadInode
+ */
+
+int soGetInodeAttr (uint32_t nInode, struct stat *st)
+{
+  soColorProbe (810, "07;31", "soGetInodeAttr (%"PRIu32", %p)\n", nInode, st);
+
+  SOInode inode;                                 /* inode associated to the file */
+  int stat;                                      /* status of operation */
+
+  if ((stat = soReadInode (&inode, nInode, IUIN)) != 0) return stat;
+
+  memset (st, 0, sizeof (struct stat));
+  st->st_ino = nInode;
+  switch (inode.mode & INODE_TYPE_MASK)
+  { case INODE_DIR:     st->st_mode = S_IFDIR;
+                        break;
+    case INODE_SYMLINK: st->st_mode = S_IFLNK;
+                        break;
+    default:            st->st_mode = S_IFREG;
+  }
+  st->st_mode |= inode.mode & (S_IRWXU | S_IRWXG | S_IRWXO);
+  st->st_nlink = inode.refcount;
+  st->st_uid = inode.owner;
+  st->st_gid = inode.group;
+  st->st_size = inode.size;
+  st->st_blksize = BSLPC;
+  st->st_blocks = (blkcnt_t) inode.clucount * (CLUSTER_SIZE / 512);
+  st->st_atime = inode.vD1.atime;
+  st->st_mtime = inode.vD2.mtime;
+  st->st_ctime = inode.vD2.mtime;
+
+  return 0;
+}
@@ -0,0 +1,113 @@
+/**
+ *  \file sofs_readdir.h (interface file)
+ *
+ *  \brief Batched reading of the entries of a directory.
+ *
+ *  The path to the directory is resolved once, unless the number of its inode is given, and its data clusters are read
+ *  in sequence, every entry in use being handed to a function supplied by the caller until either the directory is
+ *  exhausted or the function asks for the reading to stop (because the buffer where the entries are being stored is
+ *  full, for instance). The attributes of the file an entry refers to may be handed together with its name, so that
+ *  they need not be got afterwards.
+ *
+ *  The caller must hold the lock of the inode associated to the directory, shared at least. The attributes of the
+ *  files the entries refer to are got without their inodes being locked.
+ *
+ *  The operations are:
+ *      \li read a group of directory entries from a directory, given its path
+ *      \li read a group of directory entries from a directory, given the number of its inode
+ *      \li get the attributes of the file associated to an inode.
+ *
+ *  \remarks In case an error occurs, all functions return a negative value which is the symmetric of the system error
+ *           that better represents the error cause.
+ *           (execute command <em>man errno</em> to get the list of system errors)
+ */
+
+#ifndef SOFS_READDIR_H_
+#define SOFS_READDIR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/stat.h>
+
+/**
+ *  \brief Function which a directory entry is handed to.
+ *
+ *  \param data pointer to the data supplied by the caller of \e soReaddirBatch
+ *  \param name pointer to the string holding the name of the entry
+ *  \param st pointer to the attributes of the file the entry refers to (\c NULL, if they were not required)
+ *  \param next [byte] position in the directory where reading should resume after this entry
+ *
+ *  \return <tt>0 (zero)</tt>, if the reading is to go on, or a non-zero value, if it is to stop: the entry is then
+ *          supposed not to have been taken and will be handed again when reading resumes
+ */
+
+typedef int (*SOReaddirFiller) (void *data, const char *name, const struct stat *st, uint32_t next);
+
+/**
+ *  \brief Read a group of directory entries from a directory.
+ *
+ *  It extends <em>soReaddir</em> to many entries per call: the entries in use from position <tt>pos</tt> onwards
+ *  are handed, in order, to <tt>filler</tt>, the free ones being skipped.
+ *
+ *  The process that calls the operation must have execution (x) permission on all the components of the path with
+ *  exception of the rightmost one, and read (r) permission on the directory.
+ *
+ *  \param ePath path to the directory
+ *  \param pos starting [byte] position in the directory where entries are to be read from
+ *  \param filler pointer to the function each directory entry is handed to
+ *  \param data pointer to the data to be passed on to <tt>filler</tt>
+ *  \param plus signals that the attributes of the file each entry refers to are to be handed together with its name
+ *
+ *  \return <em>number of directory entries handed to <tt>filler</tt> and taken (0, if the end is reached)</em>,
+ *          on success
+ *  \return -\c EINVAL, if either of the pointers are \c NULL or <em>pos</em> value is not a multiple of the size of
+ *                      a <em>directory entry</em>
+ *  \return -\c EFBIG, if the <em>pos</em> value is beyond the maximum file size
+ *  \return -\c ENOTDIR, if any of the components of <tt>ePath</tt> is not a directory
+ *  \return -\c EPERM, if the process that calls the operation has not read permission on the directory described by
+ *                     <tt>ePath</tt>
+ *  \return -<em>other specific error</em> issued by \e soGetDirEntryByPath, \e soReadInode, \e soAccessGranted or
+ *          \e soReadFileCluster
+ */
+
+extern int soReaddirBatch (const char *ePath, uint32_t pos, SOReaddirFiller filler, void *data, bool plus);
+
+/**
+ *  \brief Read a group of directory entries from a directory, given the number of its inode.
+ *
+ *  It is equivalent to <em>soReaddirBatch</em>, but no path is resolved: the process that calls the operation must
+ *  have read (r) permission on the directory.
+ *
+ *  \param nInodeDir number of the inode associated to the directory
+ *  \param pos starting [byte] position in the directory where entries are to be read from
+ *  \param filler pointer to the function each directory entry is handed to
+ *  \param data pointer to the data to be passed on to <tt>filler</tt>
+ *  \param plus signals that the attributes of the file each entry refers to are to be handed together with its name
+ *
+ *  \return <em>number of directory entries handed to <tt>filler</tt> and taken (0, if the end is reached)</em>,
+ *          on success
+ *  \return -\c EINVAL, if the pointer to the function is \c NULL or <em>pos</em> value is not a multiple of the size
+ *                      of a <em>directory entry</em>
+ *  \return -\c EFBIG, if the <em>pos</em> value is beyond the maximum file size
+ *  \return -\c ENOTDIR, if the inode type is not a directory
+ *  \return -\c EPERM, if the process that calls the operation has not read permission on the directory
+ *  \return -<em>other specific error</em> issued by \e soReadInode, \e soAccessGranted or \e soReadFileCluster
+ */
+
+extern int soReaddirBatchInode (uint32_t nInodeDir, uint32_t pos, SOReaddirFiller filler, void *data, bool plus);
+
+/**
+ *  \brief Get the attributes of the file associated to an inode.
+ *
+ *  They are the ones <em>soStat</em> reports. The <em>inode number</em> reported is the number of the inode.
+ *
+ *  \param nInode number of the inode
+ *  \param st pointer to the stat structure where the attributes are to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -<em>other specific error</em> issued by \e soReadInode
+ */
+
+extern int soGetInodeAttr (uint32_t nInode, struct stat *st);
+
+#endif /* SOFS_READDIR_H_ */
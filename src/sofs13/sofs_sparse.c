@@ -0,0 +1,234 @@
+/**
+ *  \file sofs_sparse.c (implementation file)
+ *
+ *  \brief Holes in the information content of regular files.
+ *
+ *  The data clusters are handled one by one through the operations of the file clusters, so that the lists of
+ *  references, the trees of extents and the information content stored in the inode are all dealt with alike, and
+ *  the holes are found by getting the logical numbers of the data clusters of a file in groups, which are served by
+ *  the cluster map of an open file, when there is one. The data clusters of a compressed file are only read and written
+ *  through the operations of the file clusters, a group of them being data as long as any of them is allocated.
+ *
+ *  The operations are:
+ *      \li allocate the data clusters of a range of a file
+ *      \li free the data clusters of a range of a file (punch a hole)
+ *      \li find the next data or the next hole in a file.
+ */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#include "sofs_probe.h"
+#include "sofs_superblock.h"
+#include "sofs_inode.h"
+#include "sofs_datacluster.h"
+#include "sofs_basicoper.h"
+#include "sofs_ifuncs_2.h"
+#include "sofs_ifuncs_3.h"
+#include "sofs_compress.h"
+#include "sofs_sparse.h"
+
+/** \brief number of data clusters whose logical numbers are got at a time while looking for data or holes */
+#define SEEK_RUN  64
+
+/**
+ *  \brief Allocate the data clusters of a range of a file.
+ *
+ *  It tries to emulate <em>fallocate</em> system call: the holes within the range are filled with data clusters
+ *  holding zeros, while the data clusters already allocated are not changed. The size of the file grows to the end of
+ *  the range, unless it is to be kept. The data clusters of a compressed file are not allocated, since a group holding
+ *  only zeros is always a hole: just the size of the file may change.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param pos starting [byte] position of the range
+ *  \param len length of the range in bytes
+ *  \param keepSize signals if the size of the file is to be kept when the range goes past its end
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the length is zero
+ *  \return -\c EISDIR, if the inode associated to the file is a directory
+ *  \return -\c EFBIG, if the range goes past the maximum size of a file
+ *  \return -<em>other specific error</em> issued by \e soReadInode, \e soWriteInode, \e soHandleFileCluster or
+ *          \e soWriteFileCluster
+ */
+
+int soAllocFileRange (uint32_t nInode, uint32_t pos, uint32_t len, bool keepSize)
+{
+  soColorProbe (754, "07;31", "soAllocFileRange (%"PRIu32", %"PRIu32", %"PRIu32", %d)\n", nInode, pos, len,
+                keepSize);
+
+  SOInode inode;                                 /* inode associated to the file */
+  SODataClust zero;                              /* data cluster filled with zeros */
+  uint32_t ind, last, nClust;                    /* indexes of the data clusters and logical number of one */
+  int stat;                                      /* status of operation */
+
+  if (len == 0) return -EINVAL;
+  if ((uint64_t) pos + len > MAX_FILE_SIZE) return -EFBIG;
+  if ((stat = soReadInode (&inode, nInode, IUIN)) != 0) return stat;
+  if ((inode.mode & INODE_TYPE_MASK) == INODE_DIR) return -EISDIR;
+
+  /* the holes are written with zeros, which allocates them; the bytes stored in the inode are never a hole, and they
+   * are moved out as soon as another data cluster is written */
+
+  memset (&zero, 0, sizeof (zero));
+  last = (pos + len - 1) / BSLPC;
+  for (ind = pos / BSLPC; (ind <= last) && !INODE_IS_COMPRESSED (inode.mode); ind++)
+  { if ((ind == 0) && INODE_IS_INLINE (inode.mode)) continue;
+    if ((stat = soHandleFileCluster (nInode, ind, GET, &nClust)) != 0) return stat;
+    if ((nClust == NULL_CLUSTER) && ((stat = soWriteFileCluster (nInode, ind, &zero)) != 0))
+       return stat;
+  }
+
+  /* the inode was changed meanwhile by the allocation of data clusters */
+
+  if ((stat = soReadInode (&inode, nInode, IUIN)) != 0) return stat;
+  if (!keepSize && (pos + len > inode.size))
+     inode.size = pos + len;
+
+  return soWriteInode (&inode, nInode, IUIN);
+}
+
+/**
+ *  \brief Free the data clusters of a range of a file (punch a hole).
+ *
+ *  The data clusters wholly within the range are freed and the bytes of the range in the data clusters it only
+ *  partly covers are cleared, so that the whole range reads as zeros. The size of the file is not changed. The range of
+ *  a compressed file is cleared group by group, so that each group involved is compressed again once.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param pos starting [byte] position of the range
+ *  \param len length of the range in bytes
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the length is zero
+ *  \return -\c EISDIR, if the inode associated to the file is a directory
+ *  \return -<em>other specific error</em> issued by \e soReadInode, \e soHandleFileCluster, \e soReadFileCluster,
+ *          \e soWriteFileCluster, \e soReadFileClusters or \e soWriteFileClusters
+ */
+
+int soPunchFileHole (uint32_t nInode, uint32_t pos, uint32_t len)
+{
+  soColorProbe (755, "07;31", "soPunchFileHole (%"PRIu32", %"PRIu32", %"PRIu32")\n", nInode, pos, len);
+
+  SOInode inode;                                 /* inode associated to the file */
+  SODataClust clust;                             /* contents of a data cluster */
+  unsigned char group[COMPRESS_GROUP * BSLPC];   /* contents of the data clusters of a group */
+  uint64_t end, stop;                            /* [byte] positions past the end of the range and of a group part */
+  uint32_t ind, last, nClust;                    /* indexes of the data clusters and logical number of one */
+  uint32_t off, n;                               /* part of a data cluster within the range */
+  bool inl;                                      /* signals if the information content is stored in the inode */
+  int stat;                                      /* status of operation */
+
+  if (len == 0) return -EINVAL;
+  if ((stat = soReadInode (&inode, nInode, IUIN)) != 0) return stat;
+  if ((inode.mode & INODE_TYPE_MASK) == INODE_DIR) return -EISDIR;
+  if (pos >= MAX_FILE_SIZE) return 0;
+  end = ((uint64_t) pos + len > MAX_FILE_SIZE) ? MAX_FILE_SIZE : (uint64_t) pos + len;
+  inl = INODE_IS_INLINE (inode.mode);
+
+  last = (uint32_t) ((end - 1) / BSLPC);
+  if (INODE_IS_COMPRESSED (inode.mode))
+     { for (ind = pos / BSLPC; ind <= last; ind += n)
+       { n = COMPRESS_GROUP - ind % COMPRESS_GROUP;
+         if (ind + n > last + 1) n = last + 1 - ind;
+         if ((stat = soReadFileClusters (nInode, ind, n, group)) != 0) return stat;
+         off = (ind == pos / BSLPC) ? pos % BSLPC : 0;
+         stop = ((uint64_t) (ind + n) * BSLPC < end) ? (uint64_t) (ind + n) * BSLPC : end;
+         memset (group + off, 0, (size_t) (stop - (uint64_t) ind * BSLPC - off));
+         if ((stat = soWriteFileClusters (nInode, ind, n, group)) != 0) return stat;
+       }
+       return 0;
+     }
+
+  for (ind = pos / BSLPC; ind <= last; ind++)
+  { off = (ind == pos / BSLPC) ? pos % BSLPC : 0;
+    n = (ind == last) ? (uint32_t) (end - (uint64_t) ind * BSLPC) - off : BSLPC - off;
+    if (!inl || (ind != 0))
+       { if ((stat = soHandleFileCluster (nInode, ind, GET, &nClust)) != 0) return stat;
+         if (nClust == NULL_CLUSTER) continue;   /* it is already a hole */
+         if (n == BSLPC)
+            { if ((stat = soHandleFileCluster (nInode, ind, FREE_CLEAN, NULL)) != 0) return stat;
+              continue;
+            }
+       }
+
+    /* the data cluster is only partly within the range, or its bytes are stored in the inode, where clearing them
+     * keeps them */
+
+    if ((stat = soReadFileCluster (nInode, ind, &clust)) != 0) return stat;
+    memset (clust.data + off, 0, n);
+    if ((stat = soWriteFileCluster (nInode, ind, &clust)) != 0) return stat;
+  }
+
+  return 0;
+}
+
+/**
+ *  \brief Find the next data or the next hole in a file.
+ *
+ *  It tries to emulate <em>lseek</em> system call with \c SEEK_DATA or \c SEEK_HOLE, at the granularity of the data
+ *  clusters: there is always a hole at the end of the file.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param pos starting [byte] position of the search
+ *  \param hole signals if a hole, rather than data, is to be found
+ *  \param p_pos pointer to the location where the [byte] position that was found is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the pointer to the position is \c NULL
+ *  \return -\c EISDIR, if the inode associated to the file is a directory
+ *  \return -\c ENXIO, if the starting position is not before the end of the file, or there is no more data in it
+ *  \return -<em>other specific error</em> issued by \e soReadInode or \e soGetFileClusters
+ */
+
+int soSeekFileData (uint32_t nInode, uint32_t pos, bool hole, uint32_t *p_pos)
+{
+  soColorProbe (756, "07;31", "soSeekFileData (%"PRIu32", %"PRIu32", %d, %p)\n", nInode, pos, hole, p_pos);
+
+  SOInode inode;                                 /* inode associated to the file */
+  uint32_t map[SEEK_RUN];                        /* logical numbers of a group of data clusters */
+  uint32_t ind, nClusters, k, i, j;              /* index of the data clusters, number of them and counting variables */
+  uint32_t step;                                 /* number of data clusters which are data or a hole as a whole */
+  bool data;                                     /* signals if a group of data clusters is data */
+  int stat;                                      /* status of operation */
+
+  if (p_pos == NULL) return -EINVAL;
+  if ((stat = soReadInode (&inode, nInode, IUIN)) != 0) return stat;
+  if ((inode.mode & INODE_TYPE_MASK) == INODE_DIR) return -EISDIR;
+  if (pos >= inode.size) return -ENXIO;
+
+  if (INODE_IS_INLINE (inode.mode))              /* the bytes stored in the inode are data all along */
+     { *p_pos = hole ? inode.size : pos;
+       return 0;
+     }
+
+  /* the groups of a compressed file are searched as a whole (SEEK_RUN is a multiple of COMPRESS_GROUP) */
+
+  nClusters = (inode.size + BSLPC - 1) / BSLPC;
+  step = 1;
+  if (INODE_IS_COMPRESSED (inode.mode))
+     { step = COMPRESS_GROUP;
+       nClusters = (nClusters + step - 1) / step * step;
+       if (nClusters > MAX_FILE_CLUSTERS) nClusters = MAX_FILE_CLUSTERS;
+     }
+  for (ind = pos / BSLPC / step * step; ind < nClusters; ind += k)
+  { k = (nClusters - ind < SEEK_RUN) ? nClusters - ind : SEEK_RUN;
+    if ((stat = soGetFileClusters (nInode, ind, k, map)) != 0) return stat;
+    for (i = 0; i < k; i += step)
+    { for (j = i, data = false; (j < i + step) && (j < k) && !data; j++)
+        data = (map[j] != NULL_CLUSTER);
+      if (data != hole)
+         { *p_pos = ((ind + i) * BSLPC > pos) ? (ind + i) * BSLPC : pos;
+           if (*p_pos > inode.size) *p_pos = inode.size;
+           return 0;
+         }
+    }
+  }
+  if (!hole) return -ENXIO;
+  *p_pos = inode.size;
+
+  return 0;
+}
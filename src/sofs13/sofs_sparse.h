@@ -0,0 +1,101 @@
+/**
+ *  \file sofs_sparse.h (interface file)
+ *
+ *  \brief Holes in the information content of regular files.
+ *
+ *  A data cluster of a file which has not been allocated (its reference is \c NULL_CLUSTER) is a hole: it reads as a
+ *  cluster of zeros without any transfer to or from the storage device and takes no room in the data zone. Writing
+ *  past the end of a file, or growing it by truncation, only allocates the data clusters actually written, so the
+ *  others stay as holes.
+ *
+ *  These operations complement it by allowing the data clusters of a range of a file to be allocated in advance, or
+ *  freed, and by finding where the data and the holes of a file lie. A file whose information content is stored in
+ *  the inode is taken as data all along its size.
+ *
+ *  The caller must hold the lock of the inode, in exclusion for all the operations but finding data or holes, for
+ *  which it may be shared, and the data of the file which is buffered for delayed allocation must have been flushed.
+ *
+ *  The operations are:
+ *      \li allocate the data clusters of a range of a file
+ *      \li free the data clusters of a range of a file (punch a hole)
+ *      \li find the next data or the next hole in a file.
+ *
+ *  \remarks In case an error occurs, all functions return a negative value which is the symmetric of the system error
+ *           that better represents the error cause.
+ *           (execute command <em>man errno</em> to get the list of system errors)
+ */
+
+#ifndef SOFS_SPARSE_H_
+#define SOFS_SPARSE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/ioctl.h>
+
+/** \brief command of \e ioctl finding the next data in a file (the argument is a position, changed in place) */
+#define SOFS_IOC_SEEK_DATA  _IOWR ('S', 1, uint64_t)
+/** \brief command of \e ioctl finding the next hole in a file (the argument is a position, changed in place) */
+#define SOFS_IOC_SEEK_HOLE  _IOWR ('S', 2, uint64_t)
+
+/**
+ *  \brief Allocate the data clusters of a range of a file.
+ *
+ *  It tries to emulate <em>fallocate</em> system call: the holes within the range are filled with data clusters
+ *  holding zeros, while the data clusters already allocated are not changed. The size of the file grows to the end of
+ *  the range, unless it is to be kept.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param pos starting [byte] position of the range
+ *  \param len length of the range in bytes
+ *  \param keepSize signals if the size of the file is to be kept when the range goes past its end
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the length is zero
+ *  \return -\c EISDIR, if the inode associated to the file is a directory
+ *  \return -\c EFBIG, if the range goes past the maximum size of a file
+ *  \return -<em>other specific error</em> issued by \e soReadInode, \e soWriteInode, \e soHandleFileCluster or
+ *          \e soWriteFileCluster
+ */
+
+extern int soAllocFileRange (uint32_t nInode, uint32_t pos, uint32_t len, bool keepSize);
+
+/**
+ *  \brief Free the data clusters of a range of a file (punch a hole).
+ *
+ *  The data clusters wholly within the range are freed and the bytes of the range in the data clusters it only
+ *  partly covers are cleared, so that the whole range reads as zeros. The size of the file is not changed.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param pos starting [byte] position of the range
+ *  \param len length of the range in bytes
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the length is zero
+ *  \return -\c EISDIR, if the inode associated to the file is a directory
+ *  \return -<em>other specific error</em> issued by \e soReadInode, \e soHandleFileCluster, \e soReadFileCluster or
+ *          \e soWriteFileCluster
+ */
+
+extern int soPunchFileHole (uint32_t nInode, uint32_t pos, uint32_t len);
+
+/**
+ *  \brief Find the next data or the next hole in a file.
+ *
+ *  It tries to emulate <em>lseek</em> system call with \c SEEK_DATA or \c SEEK_HOLE, at the granularity of the data
+ *  clusters: there is always a hole at the end of the file.
+ *
+ *  \param nInode number of the inode associated to the file
+ *  \param pos starting [byte] position of the search
+ *  \param hole signals if a hole, rather than data, is to be found
+ *  \param p_pos pointer to the location where the [byte] position that was found is to be stored
+ *
+ *  \return <tt>0 (zero)</tt>, on success
+ *  \return -\c EINVAL, if the pointer to the position is \c NULL
+ *  \return -\c EISDIR, if the inode associated to the file is a directory
+ *  \return -\c ENXIO, if the starting position is not before the end of the file, or there is no more data in it
+ *  \return -<em>other specific error</em> issued by \e soReadInode or \e soGetFileClusters
+ */
+
+extern int soSeekFileData (uint32_t nInode, uint32_t pos, bool hole, uint32_t *p_pos);
+
+#endif /* SOFS_SPARSE_H_ */
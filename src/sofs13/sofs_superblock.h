@@ -35,6 +35,16 @@
 /** \brief reference to a null data block */
 #define NULL_BLOCK ((uint32_t)(~0UL))
 
+/** \brief signals if the data clusters of the file system described by a superblock have \c BLOCKS_PER_CLUSTER
+ *         blocks (the data zone takes up exactly the rest of the file system proper, so the geometry follows from its
+ *         layout) */
+#define SB_CLUST_FITS(p_sb) ((uint64_t) (p_sb)->dzone_start + (uint64_t) (p_sb)->dzone_total * BLOCKS_PER_CLUSTER == \
+                             (p_sb)->ntotal)
+
+/** \brief number of blocks of a data cluster of the file system described by a superblock */
+#define SB_CLUST_SIZE(p_sb) (((p_sb)->dzone_total == 0) ? 0 : \
+                             ((p_sb)->ntotal - (p_sb)->dzone_start) / (p_sb)->dzone_total)
+
 /** \brief size of cache */
 #define DZONE_CACHE_SIZE  (50)
 
@@ -75,7 +85,10 @@ struct fCNode
  *         storage of references (static structures resident within the superblock itself) and the location, size in number
  *         of blocks and search point index of the bitmap table to free data clusters, organized as an array of bits each
  *         pointing to the status of allocation of the corresponding data cluster (the search for a free data cluster should
- *         proceed in a circular way always starting at the search point index).
+ *         proceed in a circular way always starting at the search point index)
+ *     \li <em>journal metadata</em> - concerning the location and size in number of blocks of the optional region,
+ *         past the end of the file system proper, where the updates of metadata are logged before they are carried out
+ *         in place (see sofs_journal.h).
  */
 
 typedef struct soSuperBlock
@@ -145,10 +158,18 @@ typedef struct soSuperBlock
    /** \brief number of free data clusters */
     uint32_t dzone_free;
 
+  /* Journal metadata */
+
+   /** \brief physical number of the block where the journal starts (it lies past the blocks the file system comprises,
+    *         <tt>ntotal</tt>) */
+    uint32_t jnl_start;
+   /** \brief number of blocks of the journal (0, if there is none) */
+    uint32_t jnl_size;
+
   /* Padded area to ensure superblock structure is BLOCK_SIZE bytes long */
 
    /** \brief reserved area */
-    unsigned char reserved[BLOCK_SIZE - PARTITION_NAME_SIZE - 1 - 18 * sizeof(uint32_t) - 2 * sizeof(struct fCNode)];
+    unsigned char reserved[BLOCK_SIZE - PARTITION_NAME_SIZE - 1 - 20 * sizeof(uint32_t) - 2 * sizeof(struct fCNode)];
 } SOSuperBlock;
 
 #endif /* SOFS_SUPERBLOCK_H_ */
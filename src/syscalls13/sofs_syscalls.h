@@ -51,6 +51,14 @@
 #include <utime.h>
 #include <libgen.h>
 
+#include "sofs_const.h"
+
+/* The system calls are taken from a prebuilt library, whose buffers of a data cluster were compiled for the default
+   number of blocks per cluster, so the tools which call them may not be built for another one. */
+#if BLOCKS_PER_CLUSTER != 4
+#error "the prebuilt system calls only support 4 blocks per cluster (build without -DBLOCKS_PER_CLUSTER)"
+#endif
+
 /**
  *  \brief Mount the SOFS12 file system.
  *
@@ -591,7 +599,7 @@ extern int soRead (const char *ePath, void *buff, uint32_t count, int32_t pos);
  *  It tries to emulate <em>write</em> system call.
  *
  *  \param ePath path to the file
- *  \param buff pointer to the buffer where data to be written is stored
+ *  \param buff pointer to the buffer where data to be written is stored (it is not changed)
  *  \param count number of bytes to be written
  *  \param pos starting [byte] position in the file data continuum where data is to be written into
  *
@@ -615,7 +623,7 @@ extern int soRead (const char *ePath, void *buff, uint32_t count, int32_t pos);
  *  \return -<em>other specific error</em> issued by \e lseek system call
  */
 
-extern int soWrite (const char *ePath, void *buff, uint32_t count, int32_t pos);
+extern int soWrite (const char *ePath, const void *buff, uint32_t count, int32_t pos);
 
 /**
  *  \brief Truncate a regular file to a specified length.
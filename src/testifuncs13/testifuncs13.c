@@ -39,6 +39,7 @@
                    -b       --- set batch mode (default: not batch)
                    -l depth --- set log depth (default: 0,0)
                    -L file  --- log file (default: stdout)
+                   -m       --- map the storage device into memory (default: system calls)
                    -h       --- print this help.</PRE>
  *
  *  \author Artur Carneiro Pereira - October 2005
@@ -59,6 +60,7 @@
 
 #include "sofs_probe.h"
 #include "sofs_const.h"
+#include "sofs_rawdisk.h"
 #include "sofs_buffercache.h"
 #include "sofs_superblock.h"
 #include "sofs_inode.h"
@@ -70,6 +72,7 @@
 #define  IFUNCS_2
 #ifdef IFUNCS_2
 #include "sofs_ifuncs_2.h"
+#include "sofs_atime.h"
 #endif
 #define  IFUNCS_3
 #ifdef IFUNCS_3
@@ -197,7 +200,7 @@ int main (int argc, char *argv[])
   int opt;                                       /* selected option */
 
   do
-  { switch ((opt = getopt (argc, argv, "l:L:bh")))
+  { switch ((opt = getopt (argc, argv, "l:L:bmh")))
     { case 'l': /* log depth */
                 if (sscanf (optarg, "%d,%d", &lower, &higher) != 2)
                    { fprintf (stderr, "%s: Bad argument to l option.\n", basename (argv[0]));
@@ -217,6 +220,9 @@ int main (int argc, char *argv[])
       case 'b': /* batch mode */
                 batch = 1;                       /* set batch mode for processing: no input messages are issued */
                 break;
+      case 'm': /* memory-mapped device */
+                soSetDeviceBackend (RAW_MMAP);   /* it falls back to system calls, if the mapping fails */
+                break;
       case 'h': /* help mode */
                 printUsage (basename (argv[0]));
                 return EXIT_SUCCESS;
@@ -283,8 +289,12 @@ int main (int argc, char *argv[])
   }
 
 
-  /* close the unbuffered communication channel with the storage device */
+  /* write the times of last access still kept in internal storage and close the unbuffered communication channel
+     with the storage device */
 
+#ifdef IFUNCS_2
+  soAtimeSyncAll ();
+#endif
   if ((status = soCloseBufferCache ()) != 0)
      { printError (status, basename (argv[0]));
        return EXIT_FAILURE;
@@ -309,6 +319,7 @@ static void printUsage (char *cmd_name)
           "  -b       --- set batch mode (default: not batch)\n"
           "  -l depth --- set log depth (default: 0,0)\n"
           "  -L file  --- log file (default: stdout)\n"
+          "  -m       --- map the storage device into memory (default: system calls)\n"
           "  -h       --- print this help\n", cmd_name);
 }
 